@@ -0,0 +1,136 @@
+/*!
+ * @section LICENSE
+ *
+ * @copyright
+ * Copyright (c) 2015 Intel Corporation
+ *
+ * @copyright
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * @copyright
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * @copyright
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @section DESCRIPTION
+ *
+ * @file main.cpp
+ *
+ * @brief Clone copy benchmark, BlockCopy against the byte-wise stream copy
+ * used by LvmCloneTask before.
+ *
+ * Source and destination are block devices or files, e.g. loop devices:
+ *
+ *     truncate -s 1G master.img clone.img
+ *     dd if=/dev/urandom of=master.img bs=1M count=256 conv=notrunc
+ *     losetup -f --show master.img
+ *     losetup -f --show clone.img
+ *     block-copy-example /dev/loop0 /dev/loop1
+ *
+ * Page cache of the source is dropped before each copy when run as root.
+ * */
+#include "lvm/block_copy.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+using agent::storage::lvm::BlockCopy;
+
+namespace {
+
+void drop_caches() {
+    sync();
+    std::ofstream drop("/proc/sys/vm/drop_caches");
+    if (drop) {
+        drop << "3" << std::endl;
+    }
+}
+
+void stream_copy(const std::string& source_path, const std::string& dest_path) {
+    std::ifstream source(source_path, std::ios::binary);
+    std::ofstream dest(dest_path, std::ios::binary | std::ios::in);
+
+    std::istreambuf_iterator<char> begin_source(source);
+    std::istreambuf_iterator<char> end_source;
+    std::ostreambuf_iterator<char> begin_dest(dest);
+    std::copy(begin_source, end_source, begin_dest);
+    dest.flush();
+
+    const auto fd = open(dest_path.c_str(), O_WRONLY);
+    if (0 <= fd) {
+        fdatasync(fd);
+        close(fd);
+    }
+}
+
+template <typename T>
+double run(const T& copy) {
+    drop_caches();
+    const auto start = std::chrono::steady_clock::now();
+    copy();
+    return std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+double to_mib(const std::uint64_t bytes) {
+    return static_cast<double>(bytes) / (1024 * 1024);
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    if (3 > argc) {
+        std::cout << "Usage: " << argv[0]
+                  << " <source> <destination> [--no-stream]" << std::endl;
+        return -1;
+    }
+    const std::string source{argv[1]};
+    const std::string dest{argv[2]};
+    const bool stream = !(3 < argc && std::string{"--no-stream"} == argv[3]);
+
+    std::uint64_t total{};
+    std::uint64_t zeroed{};
+
+    try {
+        BlockCopy block_copy{source, dest};
+        block_copy.set_progress_callback(
+            [&total](std::uint64_t, std::uint64_t size) { total = size; });
+
+        const auto seconds = run([&block_copy]() { block_copy.run(); });
+        zeroed = block_copy.get_zeroed_bytes();
+        std::cout << "block copy:  " << to_mib(total) << " MiB ("
+                  << to_mib(zeroed) << " MiB zeroed) in " << seconds
+                  << " s, " << to_mib(total) / seconds << " MiB/s"
+                  << std::endl;
+    }
+    catch (const std::exception& e) {
+        std::cout << "Block copy failed: " << e.what() << std::endl;
+        return -1;
+    }
+
+    if (stream) {
+        const auto seconds = run([&source, &dest]() {
+            stream_copy(source, dest);
+        });
+        std::cout << "stream copy: " << to_mib(total) << " MiB in "
+                  << seconds << " s, " << to_mib(total) / seconds
+                  << " MiB/s" << std::endl;
+    }
+
+    return 0;
+}
@@ -28,11 +28,15 @@
 
 #include "agent-framework/discovery/discovery_manager.hpp"
 #include "agent-framework/module/module_manager.hpp"
+#include "agent-framework/eventing/event_msg.hpp"
 #include "agent-framework/logger_ext.hpp"
 
+#include <vector>
+
 using agent_framework::generic::Module;
 using agent_framework::generic::Submodule;
 using agent_framework::generic::ModuleManager;
+using agent_framework::generic::EventMsg;
 
 namespace agent {
 namespace storage {
@@ -69,6 +73,29 @@ public:
 
     void discover(Module & module) const override;
 
+    /*!
+     * @brief Update module hard drives with currently present block devices.
+     *
+     * Only added, removed or changed hard drives are touched.
+     *
+     * @param[in] module Module to be updated.
+     * @param[out] events Component events describing applied changes.
+     */
+    void rediscover_hard_drives(Module& module,
+                                std::vector<EventMsg>& events) const;
+
+    /*!
+     * @brief Update module logical drives with current LVM structure.
+     *
+     * Only added, removed or changed volume groups, physical volumes
+     * and logical volumes are touched.
+     *
+     * @param[in] module Module to be updated.
+     * @param[out] events Component events describing applied changes.
+     */
+    void rediscover_logical_drives(Module& module,
+                                   std::vector<EventMsg>& events) const;
+
 private:
     void discovery_hard_drives(Module& module) const;
     void discovery_iscsi_targets(Module& module) const;
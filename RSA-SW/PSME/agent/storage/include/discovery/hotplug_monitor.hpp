@@ -0,0 +1,98 @@
+/*!
+ * @copyright
+ * Copyright (c) 2015 Intel Corporation
+ *
+ * @copyright
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * @copyright
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * @copyright
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ * @file hotplug_monitor.hpp
+ *
+ * @brief Block device hotplug monitor driven by kernel uevents.
+ * */
+
+#ifndef HOTPLUG_MONITOR_HPP
+#define	HOTPLUG_MONITOR_HPP
+
+#include "discovery/discovery_manager.hpp"
+#include "agent-framework/eventing/event_publisher.hpp"
+
+#include <thread>
+#include <memory>
+
+namespace agent {
+namespace storage {
+namespace discovery {
+
+/*!
+ * @brief Listens for block and device-mapper kernel uevents.
+ *
+ * After a burst of uevents settles, hard drives and/or logical drives of the
+ * module are rediscovered incrementally and a component event is published
+ * for every added, removed or changed drive.
+ */
+class HotplugMonitor : public agent_framework::generic::EventPublisher {
+public:
+
+    /*!
+     * @brief Constructor.
+     * @param[in] discovery_manager Discovery manager used for rediscovery.
+     */
+    explicit HotplugMonitor(const DiscoveryManager& discovery_manager) :
+        m_discovery_manager{discovery_manager} {}
+
+    /*! @brief Copy constructor */
+    HotplugMonitor(const HotplugMonitor&) = delete;
+
+    /*! @brief Assignment operator */
+    HotplugMonitor& operator=(const HotplugMonitor&) = delete;
+
+    /*!
+     * @brief Destructor. Stops monitoring.
+     */
+    virtual ~HotplugMonitor();
+
+    /*!
+     * @brief Open uevent netlink socket and start monitoring thread.
+     */
+    void start();
+
+    /*!
+     * @brief Stop monitoring thread and close uevent netlink socket.
+     */
+    void stop();
+
+private:
+    const DiscoveryManager& m_discovery_manager;
+    std::thread m_thread{};
+    volatile bool m_running{false};
+    int m_socket{-1};
+
+    void m_task();
+    bool m_wait_for_uevents(int timeout_ms, bool& hard_drives_changed,
+                            bool& logical_drives_changed);
+    void m_parse_uevent(const char* buffer, size_t length,
+                        bool& hard_drives_changed,
+                        bool& logical_drives_changed);
+    void m_update(bool hard_drives_changed, bool logical_drives_changed);
+};
+
+/*! Hotplug monitor unique pointer */
+using HotplugMonitorUniquePtr = std::unique_ptr<HotplugMonitor>;
+
+}
+}
+}
+#endif	/* HOTPLUG_MONITOR_HPP */
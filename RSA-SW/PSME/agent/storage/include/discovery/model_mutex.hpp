@@ -0,0 +1,51 @@
+/*!
+ * @copyright
+ * Copyright (c) 2015 Intel Corporation
+ *
+ * @copyright
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * @copyright
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * @copyright
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ * @file model_mutex.hpp
+ *
+ * @brief Mutex guarding the storage model.
+ * */
+
+#ifndef MODEL_MUTEX_HPP
+#define	MODEL_MUTEX_HPP
+
+#include <mutex>
+
+namespace agent {
+namespace storage {
+namespace discovery {
+
+/*!
+ * @brief Get mutex guarding hard drives, logical drives and targets of the
+ * module.
+ *
+ * Hotplug monitor holds it while it rediscovers drives, commands hold it
+ * while they read or change the drive collections, so that a command never
+ * walks a collection being modified and a drive created by a command is in
+ * the model before rediscovery looks for it.
+ *
+ * @return Storage model mutex.
+ */
+std::mutex& get_model_mutex();
+
+}
+}
+}
+#endif	/* MODEL_MUTEX_HPP */
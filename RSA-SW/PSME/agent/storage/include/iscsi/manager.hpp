@@ -24,10 +24,11 @@
 #ifndef ISCSI_TGT_MANAGER_HPP
 #define	ISCSI_TGT_MANAGER_HPP
 
+#include "target_data.hpp"
+
 #include <cstdint>
 #include <string>
 #include <map>
-#include <mutex>
 
 namespace agent {
 namespace storage {
@@ -108,6 +109,25 @@ public:
      */
     Response show_targets() const;
 
+    /*!
+     * @brief Create target with its initiator binding and luns.
+     *
+     * Requests are executed in order without interleaving requests of
+     * other managers. When any of them fails, the partially created target
+     * is destroyed.
+     *
+     * @param target Target definition
+     * @return Response of the first failed request or of the last request
+     */
+    Response add_target(const TargetData& target) const;
+
+    /*!
+     * @brief Get targets parsed from show targets command
+     *
+     * @return Targets data list
+     */
+    TargetDataSVec get_targets() const;
+
 private:
     /*!
      * @brief Prepare create target request
@@ -170,12 +190,12 @@ private:
      */
     Request show_targets_request() const;
 
-
-    /**
-     * @brief Lock access to socket
+    /*!
+     * @brief Execute request in management session
+     * @param request Request to execute
+     * @return Response message object
      */
-    mutable std::mutex m_mutex{};
-
+    Response execute(Request& request) const;
 };
 
 }
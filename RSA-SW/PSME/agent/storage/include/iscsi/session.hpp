@@ -0,0 +1,91 @@
+/*!
+ * @copyright
+ * Copyright (c) 2015 Intel Corporation
+ *
+ * @copyright
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * @copyright
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * @copyright
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file session.hpp
+ * @brief tgt management session
+*/
+
+#ifndef ISCSI_TGT_SESSION_HPP
+#define	ISCSI_TGT_SESSION_HPP
+
+#include <mutex>
+#include <vector>
+
+namespace agent {
+namespace storage {
+namespace iscsi {
+namespace tgt {
+
+class Request;
+class Response;
+
+/*!
+ * @brief tgtd management session shared by all managers.
+ *
+ * tgtd closes the management connection after each response, so every
+ * request opens its own connection. The session serializes the requests
+ * of all managers and keeps a batch of requests from interleaving with
+ * the others.
+ */
+class Session {
+public:
+    /*!
+     * @brief Get session instance
+     * @return Session instance
+     */
+    static Session& get_instance();
+
+    /*! Disable copy */
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    ~Session();
+
+    /*!
+     * @brief Execute request, throw exception on connection error
+     * @param request Request to execute
+     * @return Response message object
+     */
+    Response execute(Request& request);
+
+    /*!
+     * @brief Execute requests in order without interleaving other requests.
+     *
+     * Execution stops at the first failed request. Connection errors are
+     * reported as failed responses.
+     *
+     * @param requests Requests to execute
+     * @return Responses of executed requests
+     */
+    std::vector<Response> execute(std::vector<Request>& requests);
+
+private:
+    Session();
+
+    Response m_execute(Request& request);
+
+    std::mutex m_mutex{};
+};
+
+}
+}
+}
+}
+
+#endif	/* ISCSI_TGT_SESSION_HPP */
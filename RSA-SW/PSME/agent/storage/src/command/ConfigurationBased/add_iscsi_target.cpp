@@ -28,11 +28,14 @@
 #include "agent-framework/exceptions/exception.hpp"
 #include "iscsi/manager.hpp"
 #include "iscsi/response.hpp"
+#include "iscsi/target_data.hpp"
 #include "iscsi/tgt/config/tgt_config.hpp"
+#include "discovery/model_mutex.hpp"
 
 using namespace agent_framework::command;
 using namespace agent_framework::generic;
 using namespace agent::storage::iscsi::tgt::config;
+using agent::storage::discovery::get_model_mutex;
 
 /*! AddISCSITarget implementation */
 class AddISCSITarget : public storage::AddISCSITarget {
@@ -42,6 +45,7 @@ public:
     using storage::AddISCSITarget::execute;
 
     void execute(const Request& request, Response& response) {
+        std::lock_guard<std::mutex> lock{get_model_mutex()};
         if (ModuleManager::get_modules().empty()) {
             THROW(agent_framework::exceptions::InvalidParameters,
                  "rpc", "Module not found!");
@@ -59,17 +63,26 @@ public:
         const auto target_id = target_manager.get_new_target_id();
         agent::storage::iscsi::tgt::Manager manager;
 
-        create_target(manager, target_id, request.get_target_iqn());
-        set_initiator_iqn(manager, target_id, request.get_initiator_iqn());
-
         const auto& iscsi_data = submodule->get_iscsi_data();
         auto target = create_target_obj(target_id,
                                         request,
                                         iscsi_data);
-        if (!create_luns(manager, target, request)) {
-            delete_target(manager, target_id);
+        agent::storage::iscsi::tgt::TargetData target_data{};
+        target_data.set_target_id(target_id);
+        target_data.set_target_iqn(request.get_target_iqn());
+        target_data.set_target_initiator(request.get_initiator_iqn());
+        if (!add_luns(target, target_data, request)) {
+            THROW(agent_framework::exceptions::InvalidParameters,
+                  "rpc", "Invalid logical drive uuid");
+        }
+
+        // target, initiator binding and luns are created in one pipeline
+        auto target_res = manager.add_target(target_data);
+        if (!target_res.is_valid()) {
             THROW(agent_framework::exceptions::ISCSIError,
-                  "rpc", "Create luns internal error");
+                  "rpc",
+                  agent::storage::iscsi::tgt::Errors::get_error_str(
+                                               target_res.get_error()));
         }
 
         target_manager.add_target(target);
@@ -88,49 +101,9 @@ public:
         response.set_oem_data({});
     }
 
-    void create_target(agent::storage::iscsi::tgt::Manager& manager,
-                                const std::int32_t target_id,
-                                const std::string& target_iqn) {
-        auto target_res = manager.create_target(target_id, target_iqn);
-        if (!target_res.is_valid()) {
-            THROW(agent_framework::exceptions::ISCSIError,
-                  "rpc",
-                  agent::storage::iscsi::tgt::Errors::get_error_str(
-                                               target_res.get_error()));
-        }
-    }
-
-    void delete_target(agent::storage::iscsi::tgt::Manager& manager,
-                                        const std::int32_t target_id) {
-        auto response = manager.destroy_target(target_id);
-
-        if (!response.is_valid()) {
-            log_error(GET_LOGGER("rpc"), "Destroy target error: " <<
-            agent::storage::iscsi::tgt::Errors::get_error_str(
-                                               response.get_error()));
-        }
-    }
-
-    void set_initiator_iqn(agent::storage::iscsi::tgt::Manager& manager,
-                                const std::int32_t target_id,
-                                const std::string& initiator) {
-        if (initiator.empty()) {
-            log_debug(GET_LOGGER("rpc"), "No target initiator set");
-            return;
-        }
-        agent::storage::iscsi::tgt::Manager::OptionMapper options;
-        options.emplace(std::make_pair("initiator-address", initiator));
-        auto response = manager.bind_target(target_id, options);
-        if (!response.is_valid()) {
-            log_error(GET_LOGGER("rpc"), "Cannot bind initiator to target " <<
-            agent::storage::iscsi::tgt::Errors::get_error_str(
-                                                        response.get_error()));
-        }
-    }
-
-    bool create_luns(agent::storage::iscsi::tgt::Manager& manager,
-                                                    TargetSharedPtr& target,
-                                                    const Request& request) {
+    bool add_luns(TargetSharedPtr& target,
+                  agent::storage::iscsi::tgt::TargetData& target_data,
+                  const Request& request) {
         for (const auto& target_lun : request.get_target_luns()) {
             auto drive =
                     ModuleManager::find_logical_drive(target_lun.get_drive());
@@ -140,15 +113,11 @@ public:
                 return false;
             }
 
-            auto lun_res = manager.create_lun(target->get_target_id(),
-                                              target_lun.get_lun(),
-                                            drive_ptr->get_device_path());
-            if (!lun_res.is_valid()) {
-                log_error(GET_LOGGER("rpc"), "Create lun error: " <<
-                agent::storage::iscsi::tgt::Errors::get_error_str(
-                                                    lun_res.get_error()));
-                return false;
-            }
+            auto lun_data = std::make_shared<agent::storage::iscsi::tgt::LunData>();
+            lun_data->set_lun(target_lun.get_lun());
+            lun_data->set_device_path(drive_ptr->get_device_path());
+            target_data.add_lun_data(lun_data);
+
             target->add_target_lun(create_lun_obj(
                         target_lun.get_lun(),
                         drive_ptr));
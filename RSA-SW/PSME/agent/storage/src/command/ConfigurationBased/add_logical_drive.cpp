@@ -29,11 +29,14 @@
 #include "lvm/lvm_api.hpp"
 #include "lvm/lvm_create_data.hpp"
 #include "lvm/lvm_clone_task.hpp"
+#include "configuration/configuration.hpp"
+#include "discovery/model_mutex.hpp"
 
 using namespace agent_framework::action;
 using namespace agent_framework::command;
 using namespace agent_framework::generic;
 using namespace agent::storage::lvm;
+using agent::storage::discovery::get_model_mutex;
 
 /*! AddLogicalDrive implementation */
 class AddLogicalDrive : public storage::AddLogicalDrive {
@@ -43,6 +46,7 @@ public:
     using storage::AddLogicalDrive::execute;
 
     void execute(const Request& request, Response& response) {
+        std::lock_guard<std::mutex> lock{get_model_mutex()};
         const auto master_drive =
                 ModuleManager::find_logical_drive(request.get_master()).lock();
 
@@ -69,17 +73,28 @@ public:
         Status lvm_status{};
         lvm_status.set_health("OK");
         LvmAPI lvm_api{};
+        try {
+            if (request.is_snapshot()) {
+                lvm_api.create_snapshot(volume_group_name.c_str(),
+                                        master_drive->get_name().c_str(),
+                                        name.c_str(),
+                                        request.get_capacity_bytes());
+            } else {
+                lvm_api.create_clone(volume_group_name.c_str(),
+                                     master_drive->get_name().c_str(),
+                                     name.c_str(),
+                                     request.get_capacity_bytes());
+            }
+        }
+        catch (...) {
+            LvmAPI::invalidate();
+            throw;
+        }
+        LvmAPI::invalidate();
+
         if (request.is_snapshot()) {
-            lvm_api.create_snapshot(volume_group_name.c_str(),
-                                                  master_drive->get_name().c_str(),
-                                                  name.c_str(),
-                                                  request.get_capacity_bytes());
             lvm_status.set_state("Enabled");
         } else {
-            lvm_api.create_clone(volume_group_name.c_str(),
-                                                  master_drive->get_name().c_str(),
-                                                  name.c_str(),
-                                                  request.get_capacity_bytes());
             lvm_status.set_state("Starting");
 
             LvmCreateData create_data{};
@@ -88,6 +103,7 @@ public:
             create_data.set_create_name(logical_drive->get_uuid());
             create_data.set_size(request.get_capacity_bytes());
             create_data.set_logical_volume(master_drive->get_name());
+            create_data.set_rate_limit(get_clone_rate_limit());
 
             TaskRunner::get_instance().run(LvmCloneTask{create_data});
         }
@@ -114,6 +130,20 @@ public:
     }
 
 
+    /*!
+     * @brief Read clone copy rate limit from configuration
+     * @return Rate limit in bytes per second, 0 means unlimited
+     * */
+    static std::uint64_t get_clone_rate_limit() {
+        const json::Value& configuration =
+            configuration::Configuration::get_instance().to_json();
+        const auto& rate_limit = configuration["lvm"]["clone-rate-limit-mbps"];
+        if (rate_limit.is_number()) {
+            return std::uint64_t{rate_limit.as_uint()} * 1000 * 1000;
+        }
+        return 0;
+    }
+
     ~AddLogicalDrive();
 };
 
@@ -28,10 +28,12 @@
 #include "iscsi/manager.hpp"
 #include "iscsi/response.hpp"
 #include "iscsi/tgt/config/tgt_config.hpp"
+#include "discovery/model_mutex.hpp"
 
 using namespace agent_framework::command;
 using namespace agent_framework::generic;
 using namespace agent::storage::iscsi::tgt::config;
+using agent::storage::discovery::get_model_mutex;
 
 /*! DeleteISCSITarget implementation */
 class DeleteISCSITarget : public storage::DeleteISCSITarget {
@@ -41,6 +43,7 @@ public:
     using storage::DeleteISCSITarget::execute;
 
     void execute(const Request& request, Response& response) {
+        std::lock_guard<std::mutex> lock{get_model_mutex()};
         const auto target_uuid = request.get_target();
         const auto target_obj = ModuleManager::find_target(target_uuid).lock();
         if (!target_obj) {
@@ -26,12 +26,14 @@
 #include "agent-framework/module/module_manager.hpp"
 #include "agent-framework/exceptions/exception.hpp"
 #include "lvm/lvm_api.hpp"
+#include "discovery/model_mutex.hpp"
 
 #include <string>
 
 using namespace agent_framework::command;
 using namespace agent_framework::generic;
 using namespace agent::storage::lvm;
+using agent::storage::discovery::get_model_mutex;
 
 /*! DeleteLogicalDrive implementation */
 class DeleteLogicalDrive : public storage::DeleteLogicalDrive {
@@ -42,6 +44,7 @@ public:
     bool has_target(const std::string& logical_drive_uuid);
 
     void execute(const Request& request, Response& response) {
+        std::lock_guard<std::mutex> lock{get_model_mutex()};
         const auto logical_drive_uuid = request.get_drive();
         const auto logical_drive = ModuleManager::find_logical_drive(logical_drive_uuid).lock();
         if (!logical_drive) {
@@ -90,9 +93,11 @@ public:
     void lvm_delete_volume(const LogicalDriveSharedPtr& logical_drive,
                            LogicalDriveSharedPtr& volume_group) {
         LvmAPI lvm_api;
-        if (false == lvm_api.remove_logical_volume(
+        const auto removed = lvm_api.remove_logical_volume(
                                 volume_group->get_name().c_str(),
-                                logical_drive->get_name().c_str())) {
+                                logical_drive->get_name().c_str());
+        LvmAPI::invalidate();
+        if (false == removed) {
             THROW(agent_framework::exceptions::LvmError,
                   "rpc", "Logical drive object not removed.");
         }
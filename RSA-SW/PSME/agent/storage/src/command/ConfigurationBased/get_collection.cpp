@@ -25,11 +25,13 @@
 
 #include "agent-framework/command/storage/get_collection.hpp"
 #include "agent-framework/module/module_manager.hpp"
+#include "discovery/model_mutex.hpp"
 
 using std::vector;
 
 using namespace agent_framework::command;
 using namespace agent_framework::generic;
+using agent::storage::discovery::get_model_mutex;
 
 /*! GetCollection implementation */
 class GetCollection : public storage::GetCollection {
@@ -39,6 +41,7 @@ public:
     using storage::GetCollection::execute;
 
     void execute(const Request& request, Response& response) {
+        std::lock_guard<std::mutex> lock{get_model_mutex()};
 
         auto uuid = request.get_component();
         auto collection_name = request.get_name();
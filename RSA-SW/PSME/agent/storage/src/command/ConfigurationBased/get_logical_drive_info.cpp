@@ -25,11 +25,33 @@
 #include "agent-framework/command/storage/get_logical_drive_info.hpp"
 #include "agent-framework/module/module_manager.hpp"
 #include "agent-framework/action/task_status_manager.hpp"
+#include "discovery/model_mutex.hpp"
 
 #include <algorithm>
 
 using namespace agent_framework::generic;
 using namespace agent_framework::command;
+using agent::storage::discovery::get_model_mutex;
+
+namespace {
+
+/*! Clone progress of a logical drive in Starting state */
+class CloneProgressOEMData : public OEMData {
+public:
+    explicit CloneProgressOEMData(const std::uint8_t percent) :
+        m_percent{percent} {}
+
+    Json::Value to_json() const override {
+        Json::Value json{Json::objectValue};
+        json["cloneProgress"] = Json::UInt{m_percent};
+        return json;
+    }
+
+private:
+    std::uint8_t m_percent{};
+};
+
+}
 
 /*! GetLogicalDriveInfo implementation */
 class GetLogicalDriveInfo : public storage::GetLogicalDriveInfo {
@@ -40,6 +62,7 @@ public:
     using LogicalDriveSharedPtr = LogicalDrive::LogicalDriveSharedPtr;
 
     void execute(const Request& request, Response& response) {
+        std::lock_guard<std::mutex> lock{get_model_mutex()};
         auto drive_uuid = request.get_drive();
         auto& module = ModuleManager::get_modules().front();
         if (!module->get_submodules().size()) {
@@ -53,7 +76,7 @@ public:
             log_warning(GET_LOGGER("rpc"), "LogicalDrive '" << drive_uuid << "' not found.");
             throw exception::NotFound();
         }
-        check_clone_status(drive_uuid, drive_found);
+        check_clone_status(drive_uuid, drive_found, response);
 
         response.set_type(drive_found->get_type());
         response.set_mode(drive_found->get_mode());
@@ -109,7 +132,8 @@ public:
         return {};
     }
 
-    void check_clone_status(const std::string& uuid, LogicalDriveSharedPtr drive) {
+    void check_clone_status(const std::string& uuid, LogicalDriveSharedPtr drive,
+                            Response& response) {
         using namespace agent_framework::action;
         bool found{false};
         auto status = TaskStatusManager::get_instance().get_status(uuid);
@@ -126,6 +150,10 @@ public:
         if (found) {
             TaskStatusManager::get_instance().remove_status(uuid);
         }
+        else if ("Starting" == drive->get_status().get_state()) {
+            response.set_oem(new CloneProgressOEMData{
+                TaskStatusManager::get_instance().get_progress(uuid)});
+        }
     }
 
     ~GetLogicalDriveInfo();
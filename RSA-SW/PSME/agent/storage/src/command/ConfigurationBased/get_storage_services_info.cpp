@@ -25,11 +25,13 @@
 
 #include "agent-framework/command/storage/get_storage_services_info.hpp"
 #include "agent-framework/module/module_manager.hpp"
+#include "discovery/model_mutex.hpp"
 
 using namespace agent_framework::command;
 using namespace agent_framework::generic;
 
 using std::out_of_range;
+using agent::storage::discovery::get_model_mutex;
 
 /*! GetStorageServicesInfo implementation */
 class GetStorageServicesInfo : public storage::GetStorageServicesInfo {
@@ -40,6 +42,7 @@ public:
     using storage::GetStorageServicesInfo::execute;
 
     void execute(const Request& request, Response& response) {
+        std::lock_guard<std::mutex> lock{get_model_mutex()};
         auto services = request.get_services();
 
         auto submodule = ModuleManager::get_submodule(services);
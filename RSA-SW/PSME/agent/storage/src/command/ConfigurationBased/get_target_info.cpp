@@ -24,9 +24,11 @@
 
 #include "agent-framework/command/storage/get_target_info.hpp"
 #include "agent-framework/module/module_manager.hpp"
+#include "discovery/model_mutex.hpp"
 
 using namespace agent_framework::command;
 using namespace agent_framework::generic;
+using agent::storage::discovery::get_model_mutex;
 
 /*! Dummy GetTargetInfo implementation */
 class GetTargetInfo : public storage::GetTargetInfo {
@@ -36,6 +38,7 @@ public:
     using storage::GetTargetInfo::execute;
 
     void execute(const Request& request, Response& response) {
+        std::lock_guard<std::mutex> lock{get_model_mutex()};
        const auto target = ModuleManager::find_target(
                                                 request.get_target()).lock();
         if (!target) {
@@ -26,12 +26,11 @@
  * @brief ...
  * */
 #include "discovery/discovery_manager.hpp"
+#include "discovery/model_mutex.hpp"
 #include "discovery/dependency_resolver/storage_dependency_resolver.hpp"
 #include "sysfs/sysfs_api.hpp"
 #include "lvm/lvm_api.hpp"
 #include "iscsi/manager.hpp"
-#include "iscsi/response.hpp"
-#include "iscsi/target_parser.hpp"
 
 #include "agent-framework/module/hard_drive.hpp"
 #include "agent-framework/module/hard_drive_partition.hpp"
@@ -39,6 +38,8 @@
 #include "agent-framework/module/logical_drive.hpp"
 
 #include <mutex>
+#include <cmath>
+#include <algorithm>
 #include <condition_variable>
 
 using namespace agent::storage::discovery;
@@ -51,6 +52,109 @@ using HardDrivePartition = agent_framework::generic::HardDrivePartition;
 using FruInfo = agent_framework::generic::FruInfo;
 using LogicalDrive = agent_framework::generic::LogicalDrive;
 using Target = agent_framework::generic::Target;
+using ModuleState = agent_framework::generic::ModuleState;
+using Transition = agent_framework::generic::StateMachineTransition::Transition;
+
+namespace {
+
+constexpr const char LVM_TYPE_NAME[] = "LVM";
+
+void read_hard_drive(const SysfsAPI::HardDrive& bd_drive, HardDrive& hard_drive) {
+    hard_drive.set_name(bd_drive.get_name());
+    hard_drive.set_device_path(bd_drive.get_device_path());
+    hard_drive.set_capacity_gb(bd_drive.get_capacity_gb());
+    hard_drive.set_type(bd_drive.get_type());
+    hard_drive.set_interface(bd_drive.get_interface());
+    hard_drive.set_rpm(bd_drive.get_rpm());
+
+    FruInfo fru_info;
+    fru_info.set_manufacturer(bd_drive.get_manufacturer());
+    fru_info.set_model_number(bd_drive.get_model());
+    fru_info.set_serial_number(bd_drive.get_serial_number());
+    hard_drive.set_fru_info(fru_info);
+
+    hard_drive.set_status({"Enabled", "OK"});
+}
+
+bool is_hard_drive_changed(const SysfsAPI::HardDrive& bd_drive,
+                           const HardDrive& hard_drive) {
+    return bd_drive.get_capacity_gb() != hard_drive.get_capacity_gb() ||
+        bd_drive.get_serial_number() !=
+            hard_drive.get_fru_info().get_serial_number() ||
+        bd_drive.get_model() != hard_drive.get_fru_info().get_model_number();
+}
+
+void read_volume_group(const LvmAPI::VolumeGroup& volume_group,
+                       LogicalDrive& logical_drive) {
+    logical_drive.set_bootable(false);
+    logical_drive.set_name(volume_group.get_name());
+    logical_drive.set_mode(LogicalDrive::LvmTypes::VOLUME_GROUP);
+    logical_drive.set_type(LVM_TYPE_NAME);
+    logical_drive.set_capacity_gb(volume_group.get_capacity_gb());
+    logical_drive.set_device_path("/dev/" + volume_group.get_name());
+    logical_drive.set_protected(volume_group.get_protection_status());
+    logical_drive.set_status({volume_group.get_status(), volume_group.get_health()});
+}
+
+void read_physical_volume(const LvmAPI::PhysicalVolume& physical_volume,
+                          LogicalDrive& physical_drive) {
+    physical_drive.set_name(physical_volume.get_name());
+    physical_drive.set_capacity_gb(physical_volume.get_capacity_gb());
+    physical_drive.set_type(LVM_TYPE_NAME);
+    physical_drive.set_protected(physical_volume.get_protection_status());
+    physical_drive.set_device_path(physical_volume.get_name());
+    physical_drive.set_mode(LogicalDrive::LvmTypes::PHYSICAL_VOLUME);
+    physical_drive.set_status({physical_volume.get_status(), physical_volume.get_health()});
+}
+
+void read_logical_volume(const LvmAPI::VolumeGroup& volume_group,
+                         const LvmAPI::LogicalVolume& logical_volume,
+                         LogicalDrive& logical_drive) {
+    logical_drive.set_name(logical_volume.get_name());
+    logical_drive.set_protected(logical_volume.get_protection_status());
+    logical_drive.set_snapshot(logical_volume.get_snapshot_status());
+    logical_drive.set_mode(LogicalDrive::LvmTypes::LOGICAL_VOLUME);
+    logical_drive.set_capacity_gb(logical_volume.get_capacity_gb());
+    logical_drive.set_type(LVM_TYPE_NAME);
+    logical_drive.set_device_path("/dev/" + volume_group.get_name()
+                                  + "/" + logical_volume.get_name());
+    logical_drive.set_status({logical_volume.get_status(), logical_volume.get_health()});
+}
+
+bool is_capacity_changed(const double capacity_gb, const float lvm_capacity_gb) {
+    static constexpr double CAPACITY_EPSILON_GB = 0.001;
+    return std::abs(capacity_gb - static_cast<double>(lvm_capacity_gb))
+        > CAPACITY_EPSILON_GB;
+}
+
+template <typename T>
+LogicalDrive::LogicalDriveSharedPtr find_by_device_path(const T& drives,
+        const std::string& mode, const std::string& device_path) {
+    for (const auto& drive : drives) {
+        if (drive->get_mode() == mode && drive->get_device_path() == device_path) {
+            return drive;
+        }
+    }
+    return nullptr;
+}
+
+void drop_hard_drive_references(Submodule& submodule, const std::string& uuid) {
+    for (const auto& volume_group : submodule.get_logical_drives()) {
+        for (const auto& drive : volume_group->get_logical_drives()) {
+            drive->delete_hard_drive(uuid);
+        }
+    }
+    for (const auto& target : submodule.get_target_manager().get_targets()) {
+        target->delete_hard_drive(uuid);
+    }
+}
+
+}
+
+std::mutex& agent::storage::discovery::get_model_mutex() {
+    static std::mutex model_mutex{};
+    return model_mutex;
+}
 
 struct DiscoveryManager::DiscoveryComplete {
     void notify_discovery_complete() {
@@ -105,22 +209,69 @@ void DiscoveryManager::discovery_hard_drives(Module& module) const {
 
         auto hard_drive = std::make_shared<HardDrive>();
 
-        hard_drive->set_name(bd_drive.get_name());
-        hard_drive->set_device_path(bd_drive.get_device_path());
-        hard_drive->set_capacity_gb(bd_drive.get_capacity_gb());
-        hard_drive->set_type(bd_drive.get_type());
-        hard_drive->set_interface(bd_drive.get_interface());
-        hard_drive->set_rpm(bd_drive.get_rpm());
+        read_hard_drive(bd_drive, *hard_drive);
+
+        storage_controller->add_hard_drive(std::move(hard_drive));
+    }
+}
 
-        FruInfo fru_info;
-        fru_info.set_manufacturer(bd_drive.get_manufacturer());
-        fru_info.set_model_number(bd_drive.get_model());
-        fru_info.set_serial_number(bd_drive.get_serial_number());
-        hard_drive->set_fru_info(fru_info);
+void DiscoveryManager::rediscover_hard_drives(Module& module,
+        std::vector<EventMsg>& events) const {
+    if (!module.get_submodules().size()) {
+        log_error(GET_LOGGER("storage"), "Submodules empty!");
+        return;
+    }
+    auto& submodule = module.get_submodules().front();
+    auto& storage_controller = submodule->get_storage_controllers().front();
+    std::vector<SysfsAPI::HardDrive> bd_drives;
+    std::vector<std::string> removed_drives;
 
-        hard_drive->set_status({"Enabled", "OK"});
+    SysfsAPI::get_instance()->get_hard_drives(bd_drives);
 
-        storage_controller->add_hard_drive(std::move(hard_drive));
+    for (const auto& hard_drive : storage_controller->get_hard_drives()) {
+        const auto& device_path = hard_drive->get_device_path();
+        if (std::none_of(bd_drives.cbegin(), bd_drives.cend(),
+                [&device_path](const SysfsAPI::HardDrive& bd_drive) {
+                    return bd_drive.get_device_path() == device_path;
+                })) {
+            removed_drives.push_back(hard_drive->get_uuid());
+        }
+    }
+
+    for (const auto& uuid : removed_drives) {
+        // physical volumes and targets must not keep the removed drive alive
+        drop_hard_drive_references(*submodule, uuid);
+        storage_controller->delete_hard_drive(uuid);
+        events.emplace_back(uuid, ModuleState::State::OFFLINE,
+                            Transition::EXTRACTION);
+        log_info(GET_LOGGER("storage"), "Hard drive removed: " << uuid);
+    }
+
+    for (const auto& bd_drive : bd_drives) {
+        const auto& hard_drives = storage_controller->get_hard_drives();
+        auto it = std::find_if(hard_drives.cbegin(), hard_drives.cend(),
+                [&bd_drive](const HardDrive::HardDriveSharedPtr& hard_drive) {
+                    return bd_drive.get_device_path() ==
+                        hard_drive->get_device_path();
+                });
+
+        if (hard_drives.cend() == it) {
+            auto hard_drive = std::make_shared<HardDrive>();
+            read_hard_drive(bd_drive, *hard_drive);
+            events.emplace_back(hard_drive->get_uuid(),
+                    ModuleState::State::ENABLED, Transition::INSERTION);
+            log_info(GET_LOGGER("storage"), "Hard drive added: "
+                    << hard_drive->get_uuid() << " "
+                    << hard_drive->get_device_path());
+            storage_controller->add_hard_drive(std::move(hard_drive));
+        }
+        else if (is_hard_drive_changed(bd_drive, **it)) {
+            read_hard_drive(bd_drive, **it);
+            events.emplace_back((*it)->get_uuid(),
+                    ModuleState::State::ENABLED, Transition::IDLE);
+            log_info(GET_LOGGER("storage"), "Hard drive changed: "
+                    << (*it)->get_uuid());
+        }
     }
 }
 
@@ -135,18 +286,7 @@ void DiscoveryManager::discovery_iscsi_targets(Module& module) const {
     const auto& iscsi_data = submodule->get_iscsi_data();
 
     Manager manager;
-    auto response = manager.show_targets();
-    if (!response.is_valid()) {
-        log_error(GET_LOGGER("storage"),
-                "ISCSI show target invalid response!" +
-                Errors::get_error_str(response.get_error()));
-        return;
-    }
-
-    auto& extra_data = response.get_extra_data();
-    TargetParser parser{};
-    std::string iscsi_text(extra_data.cbegin(), extra_data.cend());
-    const auto targets = parser.parse(iscsi_text);
+    const auto targets = manager.get_targets();
     for (const auto& target : targets) {
         auto target_data = Target::make_target();
         target_data->set_target_id(target->get_target_id());
@@ -177,33 +317,18 @@ void DiscoveryManager::discovery_logical_drives(Module& module) const {
 
     LvmAPI lvm_api;
 
-    static constexpr const char lvm_type_name[] = "LVM";
-
     std::vector<LvmAPI::VolumeGroup> volume_groups;
     lvm_api.discover_volume_groups_structure(volume_groups);
 
     for(const auto& volume_group : volume_groups) {
         auto logical_drive = LogicalDrive::make_logical_drive();
 
-        logical_drive->set_bootable(false);
-        logical_drive->set_name(volume_group.get_name());
-        logical_drive->set_mode(LogicalDrive::LvmTypes::VOLUME_GROUP);
-        logical_drive->set_type(lvm_type_name);
-        logical_drive->set_capacity_gb(volume_group.get_capacity_gb());
-        logical_drive->set_device_path("/dev/" + volume_group.get_name());
-        logical_drive->set_protected(volume_group.get_protection_status());
-        logical_drive->set_status({volume_group.get_status(), volume_group.get_health()});
+        read_volume_group(volume_group, *logical_drive);
 
         for (const auto& physical_volume : volume_group.physical_volumes) {
             auto physical_drive = LogicalDrive::make_logical_drive();
 
-            physical_drive->set_name(physical_volume.get_name());
-            physical_drive->set_capacity_gb(physical_volume.get_capacity_gb());
-            physical_drive->set_type(lvm_type_name);
-            physical_drive->set_protected(physical_volume.get_protection_status());
-            physical_drive->set_device_path(physical_volume.get_name());
-            physical_drive->set_mode(LogicalDrive::LvmTypes::PHYSICAL_VOLUME);
-            physical_drive->set_status({physical_volume.get_status(), physical_volume.get_health()});
+            read_physical_volume(physical_volume, *physical_drive);
 
             logical_drive->add_logical_drive(physical_drive);
         }
@@ -211,15 +336,7 @@ void DiscoveryManager::discovery_logical_drives(Module& module) const {
         for (const auto& logical_volume : volume_group.logical_volumes) {
             auto logical_drive_child = LogicalDrive::make_logical_drive();
 
-            logical_drive_child->set_name(logical_volume.get_name());
-            logical_drive_child->set_protected(logical_volume.get_protection_status());
-            logical_drive_child->set_snapshot(logical_volume.get_snapshot_status());
-            logical_drive_child->set_mode(LogicalDrive::LvmTypes::LOGICAL_VOLUME);
-            logical_drive_child->set_capacity_gb(logical_volume.get_capacity_gb());
-            logical_drive_child->set_type(lvm_type_name);
-            logical_drive_child->set_device_path("/dev/" + volume_group.get_name()
-                                                + "/" + logical_volume.get_name());
-            logical_drive_child->set_status({logical_volume.get_status(), logical_volume.get_health()});
+            read_logical_volume(volume_group, logical_volume, *logical_drive_child);
 
             logical_drive->add_logical_drive(logical_drive_child);
         }
@@ -227,3 +344,143 @@ void DiscoveryManager::discovery_logical_drives(Module& module) const {
         submodule->add_logical_drive(logical_drive);
     }
 }
+
+void DiscoveryManager::rediscover_logical_drives(Module& module,
+        std::vector<EventMsg>& events) const {
+    if (!module.get_submodules().size()) {
+        log_error(GET_LOGGER("storage"), "Submodules empty!");
+        return;
+    }
+    auto& submodule = module.get_submodules().front();
+    const auto hard_drives = submodule->get_hard_drives();
+
+    LvmAPI lvm_api;
+
+    std::vector<LvmAPI::VolumeGroup> volume_groups;
+    lvm_api.discover_volume_groups_structure(volume_groups);
+
+    auto add_child = [&events](LogicalDrive::LogicalDriveSharedPtr& volume_group,
+                               LogicalDrive::LogicalDriveSharedPtr child) {
+        volume_group->add_logical_drive(child);
+        events.emplace_back(child->get_uuid(), ModuleState::State::ENABLED,
+                            Transition::INSERTION);
+        log_info(GET_LOGGER("storage"), "Logical drive added: "
+                 << child->get_uuid() << " " << child->get_device_path());
+    };
+
+    auto remove_drive = [&events](LogicalDrive::LogicalDriveSharedPtr& drive) {
+        for (const auto& child : drive->get_logical_drives()) {
+            events.emplace_back(child->get_uuid(), ModuleState::State::OFFLINE,
+                                Transition::EXTRACTION);
+        }
+        events.emplace_back(drive->get_uuid(), ModuleState::State::OFFLINE,
+                            Transition::EXTRACTION);
+        log_info(GET_LOGGER("storage"), "Logical drive removed: "
+                 << drive->get_uuid() << " " << drive->get_device_path());
+    };
+
+    // drop volume groups which are gone
+    std::vector<LogicalDrive::LogicalDriveSharedPtr> top_drives{};
+    for (const auto& drive : submodule->get_logical_drives()) {
+        if (drive->get_mode() == LogicalDrive::LvmTypes::VOLUME_GROUP) {
+            top_drives.push_back(drive);
+        }
+    }
+    for (auto& drive : top_drives) {
+        if (std::none_of(volume_groups.cbegin(), volume_groups.cend(),
+                [&drive](const LvmAPI::VolumeGroup& volume_group) {
+                    return "/dev/" + volume_group.get_name() ==
+                        drive->get_device_path();
+                })) {
+            if (submodule->delete_logical_drive(drive->get_uuid())) {
+                remove_drive(drive);
+            }
+        }
+    }
+
+    for (const auto& volume_group : volume_groups) {
+        auto vg_drive = find_by_device_path(submodule->get_logical_drives(),
+                LogicalDrive::LvmTypes::VOLUME_GROUP,
+                "/dev/" + volume_group.get_name());
+
+        if (nullptr == vg_drive) {
+            vg_drive = LogicalDrive::make_logical_drive();
+            read_volume_group(volume_group, *vg_drive);
+            submodule->add_logical_drive(vg_drive);
+            events.emplace_back(vg_drive->get_uuid(),
+                    ModuleState::State::ENABLED, Transition::INSERTION);
+            log_info(GET_LOGGER("storage"), "Volume group added: "
+                     << vg_drive->get_uuid() << " " << vg_drive->get_name());
+        }
+        else if (is_capacity_changed(vg_drive->get_capacity_gb(),
+                                     volume_group.get_capacity_gb())) {
+            vg_drive->set_capacity_gb(volume_group.get_capacity_gb());
+            events.emplace_back(vg_drive->get_uuid(),
+                    ModuleState::State::ENABLED, Transition::IDLE);
+        }
+
+        // drop physical and logical volumes which are gone
+        std::vector<LogicalDrive::LogicalDriveSharedPtr> children{
+            vg_drive->get_logical_drives()};
+        for (auto& child : children) {
+            const auto& device_path = child->get_device_path();
+            bool present = false;
+            if (child->get_mode() == LogicalDrive::LvmTypes::PHYSICAL_VOLUME) {
+                present = std::any_of(volume_group.physical_volumes.cbegin(),
+                        volume_group.physical_volumes.cend(),
+                        [&device_path](const LvmAPI::PhysicalVolume& pv) {
+                            return pv.get_name() == device_path;
+                        });
+            }
+            else {
+                present = std::any_of(volume_group.logical_volumes.cbegin(),
+                        volume_group.logical_volumes.cend(),
+                        [&](const LvmAPI::LogicalVolume& lv) {
+                            return "/dev/" + volume_group.get_name() + "/"
+                                + lv.get_name() == device_path;
+                        });
+            }
+            if (!present && vg_drive->delete_logical_drive(child->get_uuid())) {
+                remove_drive(child);
+            }
+        }
+
+        for (const auto& physical_volume : volume_group.physical_volumes) {
+            auto pv_drive = find_by_device_path(vg_drive->get_logical_drives(),
+                    LogicalDrive::LvmTypes::PHYSICAL_VOLUME,
+                    physical_volume.get_name());
+            if (nullptr != pv_drive) {
+                continue;
+            }
+
+            pv_drive = LogicalDrive::make_logical_drive();
+            read_physical_volume(physical_volume, *pv_drive);
+            for (const auto& hard_drive : hard_drives) {
+                if (hard_drive->get_device_path() == pv_drive->get_name()) {
+                    pv_drive->add_hard_drive(hard_drive);
+                }
+            }
+            add_child(vg_drive, pv_drive);
+        }
+
+        for (const auto& logical_volume : volume_group.logical_volumes) {
+            auto lv_drive = find_by_device_path(vg_drive->get_logical_drives(),
+                    LogicalDrive::LvmTypes::LOGICAL_VOLUME,
+                    "/dev/" + volume_group.get_name() + "/"
+                    + logical_volume.get_name());
+            if (nullptr == lv_drive) {
+                lv_drive = LogicalDrive::make_logical_drive();
+                read_logical_volume(volume_group, logical_volume, *lv_drive);
+                lv_drive->set_volume_group(vg_drive);
+                add_child(vg_drive, lv_drive);
+            }
+            else if (is_capacity_changed(lv_drive->get_capacity_gb(),
+                                         logical_volume.get_capacity_gb())) {
+                // status is left intact, clone tasks own it until they finish
+                lv_drive->set_capacity_gb(logical_volume.get_capacity_gb());
+                events.emplace_back(lv_drive->get_uuid(),
+                        ModuleState::State::ENABLED, Transition::IDLE);
+            }
+        }
+    }
+}
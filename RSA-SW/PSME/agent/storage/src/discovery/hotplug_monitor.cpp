@@ -0,0 +1,240 @@
+/*!
+ * @section LICENSE
+ *
+ * @copyright
+ * Copyright (c) 2015 Intel Corporation
+ *
+ * @copyright
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * @copyright
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * @copyright
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @section DESCRIPTION
+ *
+ * @file hotplug_monitor.cpp
+ *
+ * @brief Block device hotplug monitor driven by kernel uevents.
+ * */
+#include "discovery/hotplug_monitor.hpp"
+#include "discovery/model_mutex.hpp"
+#include "lvm/lvm_api.hpp"
+
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+
+using namespace agent::storage::discovery;
+using agent::storage::lvm::LvmAPI;
+
+namespace {
+
+/*! Multicast group of uevents sent by the kernel */
+constexpr unsigned int KERNEL_UEVENT_GROUP = 1;
+
+/*! Poll timeout used to check if monitor is still running */
+constexpr int POLL_TIMEOUT_MS = 1000;
+
+/*! Quiet time after which a burst of uevents is considered complete */
+constexpr int SETTLE_TIME_MS = 500;
+
+constexpr size_t UEVENT_BUFFER_SIZE = 8192;
+
+constexpr const char SUBSYSTEM_BLOCK[] = "SUBSYSTEM=block";
+constexpr const char DEVTYPE_DISK[] = "DEVTYPE=disk";
+constexpr const char DEVNAME_DM[] = "DEVNAME=dm-";
+
+}
+
+HotplugMonitor::~HotplugMonitor() {
+    stop();
+}
+
+void HotplugMonitor::start() {
+    if (m_running) {
+        return;
+    }
+
+    m_socket = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC,
+                      NETLINK_KOBJECT_UEVENT);
+    if (0 > m_socket) {
+        log_error(GET_LOGGER("storage"), "Cannot open uevent socket: "
+                  << strerror(errno));
+        return;
+    }
+
+    struct sockaddr_nl address;
+    memset(&address, 0, sizeof(address));
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = KERNEL_UEVENT_GROUP;
+
+    if (0 != bind(m_socket, reinterpret_cast<struct sockaddr*>(&address),
+                  sizeof(address))) {
+        log_error(GET_LOGGER("storage"), "Cannot bind uevent socket: "
+                  << strerror(errno));
+        close(m_socket);
+        m_socket = -1;
+        return;
+    }
+
+    m_running = true;
+    m_thread = std::thread(&HotplugMonitor::m_task, this);
+}
+
+void HotplugMonitor::stop() {
+    if (m_running) {
+        m_running = false;
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+    if (0 <= m_socket) {
+        close(m_socket);
+        m_socket = -1;
+    }
+}
+
+void HotplugMonitor::m_task() {
+    log_info(GET_LOGGER("storage"), "Starting hotplug monitor thread...");
+
+    while (m_running) {
+        bool hard_drives_changed = false;
+        bool logical_drives_changed = false;
+
+        if (!m_wait_for_uevents(POLL_TIMEOUT_MS, hard_drives_changed,
+                                logical_drives_changed)) {
+            continue;
+        }
+
+        // let the burst of uevents (e.g. lvcreate, disk with partitions) settle
+        while (m_running && m_wait_for_uevents(SETTLE_TIME_MS,
+                    hard_drives_changed, logical_drives_changed)) {}
+
+        if (m_running) {
+            m_update(hard_drives_changed, logical_drives_changed);
+        }
+    }
+
+    log_debug(GET_LOGGER("storage"), "Hotplug monitor thread stopped.");
+}
+
+bool HotplugMonitor::m_wait_for_uevents(int timeout_ms,
+                                        bool& hard_drives_changed,
+                                        bool& logical_drives_changed) {
+    struct pollfd poll_fd;
+    poll_fd.fd = m_socket;
+    poll_fd.events = POLLIN;
+    poll_fd.revents = 0;
+
+    if (0 >= poll(&poll_fd, 1, timeout_ms)) {
+        return false;
+    }
+
+    char buffer[UEVENT_BUFFER_SIZE];
+    struct sockaddr_nl sender;
+    socklen_t sender_length = sizeof(sender);
+    bool received = false;
+
+    for (;;) {
+        sender_length = sizeof(sender);
+        ssize_t length = recvfrom(m_socket, buffer, sizeof(buffer) - 1,
+                MSG_DONTWAIT, reinterpret_cast<struct sockaddr*>(&sender),
+                &sender_length);
+        if (0 >= length) {
+            break;
+        }
+        // accept uevents sent by the kernel only
+        if (0 != sender.nl_pid) {
+            continue;
+        }
+        buffer[length] = '\0';
+        m_parse_uevent(buffer, static_cast<size_t>(length),
+                       hard_drives_changed, logical_drives_changed);
+        received = true;
+    }
+
+    return received;
+}
+
+void HotplugMonitor::m_parse_uevent(const char* buffer, size_t length,
+                                    bool& hard_drives_changed,
+                                    bool& logical_drives_changed) {
+    bool is_block = false;
+    bool is_disk = false;
+    bool is_dm = false;
+
+    // "ACTION@DEVPATH" header followed by "KEY=VALUE" strings
+    for (size_t pos = 0; pos < length; pos += strlen(buffer + pos) + 1) {
+        const std::string entry{buffer + pos};
+        if (SUBSYSTEM_BLOCK == entry) {
+            is_block = true;
+        }
+        else if (DEVTYPE_DISK == entry) {
+            is_disk = true;
+        }
+        else if (0 == entry.compare(0, sizeof(DEVNAME_DM) - 1, DEVNAME_DM)) {
+            is_dm = true;
+        }
+    }
+
+    if (!is_block || !is_disk) {
+        return;
+    }
+
+    log_debug(GET_LOGGER("storage"), "Block device uevent: " << buffer);
+
+    if (is_dm) {
+        logical_drives_changed = true;
+    }
+    else {
+        // physical volumes may appear or vanish with the disk
+        hard_drives_changed = true;
+        logical_drives_changed = true;
+    }
+}
+
+void HotplugMonitor::m_update(bool hard_drives_changed,
+                              bool logical_drives_changed) {
+    auto& modules = ModuleManager::get_modules();
+    if (modules.empty()) {
+        return;
+    }
+
+    std::vector<EventMsg> events{};
+
+    // events are sent after the model is unlocked, the commands are not held
+    std::unique_lock<std::mutex> lock{get_model_mutex()};
+    try {
+        if (hard_drives_changed) {
+            m_discovery_manager.rediscover_hard_drives(*modules.front(), events);
+        }
+        if (logical_drives_changed) {
+            LvmAPI::rescan();
+            m_discovery_manager.rediscover_logical_drives(*modules.front(), events);
+        }
+    }
+    catch (const std::exception& e) {
+        log_error(GET_LOGGER("storage"), "Hotplug rediscovery failed: "
+                  << e.what());
+    }
+    lock.unlock();
+
+    for (const auto& event : events) {
+        notify_all(event);
+    }
+}
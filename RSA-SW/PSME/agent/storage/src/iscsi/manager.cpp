@@ -25,150 +25,117 @@
 #include "iscsi/manager.hpp"
 #include "iscsi/request.hpp"
 #include "iscsi/response.hpp"
-#include "iscsi/socket.hpp"
+#include "iscsi/session.hpp"
 #include "iscsi/errors.hpp"
+#include "iscsi/target_parser.hpp"
 #include "logger/logger_factory.hpp"
 #include <stdexcept>
 #include <cstring>
 
 using namespace agent::storage::iscsi::tgt;
 
-Response Manager::create_target(const std::int32_t target_id,
-                                        const std::string& target_name) const {
-    Response response;
-    try {
-        Socket socket;
-        auto request = create_target_request(target_id, target_name);
-
-        std::lock_guard<std::mutex> lock(m_mutex);
-
-        socket.connect();
-        socket.send(request.get_request_data());
+namespace {
+constexpr const char INITIATOR_ADDRESS[] = "initiator-address";
+}
 
-        socket.recive(response.data(), response.get_response_pod_size());
+Response Manager::execute(Request& request) const {
+    try {
+        return Session::get_instance().execute(request);
     } catch (const std::runtime_error& e) {
         log_error(GET_LOGGER("tgt"), e.what());
     }
-    return response;
+    return Response{};
+}
+
+Response Manager::create_target(const std::int32_t target_id,
+                                        const std::string& target_name) const {
+    auto request = create_target_request(target_id, target_name);
+    return execute(request);
 }
 
 Response Manager::create_lun(const std::int32_t target_id,
                                         const std::uint64_t lun_id,
                                         const std::string& device_path) const {
-    Response response;
-    try {
-        Socket socket;
-        auto request = create_lun_request(target_id, lun_id, device_path);
-
-        std::lock_guard<std::mutex> lock(m_mutex);
-
-        socket.connect();
-        socket.send(request.get_request_data());
-
-        socket.recive(response.data(), response.get_response_pod_size());
-    } catch (const std::runtime_error& e) {
-        log_error(GET_LOGGER("tgt"), e.what());
-    }
-    return response;
+    auto request = create_lun_request(target_id, lun_id, device_path);
+    return execute(request);
 }
 
 Response Manager::bind_target(const std::int32_t target_id,
                          const Manager::OptionMapper& options) const {
-    Response response;
-    try {
-        Socket socket;
-        auto request = bind_target_request(target_id, options);
-
-        std::lock_guard<std::mutex> lock(m_mutex);
-
-        socket.connect();
-        socket.send(request.get_request_data());
-
-        socket.recive(response.data(), response.get_response_pod_size());
-    } catch (const std::runtime_error& e) {
-        log_error(GET_LOGGER("tgt"), e.what());
-    }
-    return response;
+    auto request = bind_target_request(target_id, options);
+    return execute(request);
 }
 
 Response Manager::unbind_target(const std::int32_t target_id,
                          const Manager::OptionMapper& options) const {
-    Response response;
-    try {
-        Socket socket;
-        auto request = unbind_target_request(target_id, options);
-
-        std::lock_guard<std::mutex> lock(m_mutex);
-
-        socket.connect();
-        socket.send(request.get_request_data());
-
-        socket.recive(response.data(), response.get_response_pod_size());
-    } catch (const std::runtime_error& e) {
-        log_error(GET_LOGGER("tgt"), e.what());
-    }
-    return response;
+    auto request = unbind_target_request(target_id, options);
+    return execute(request);
 }
 
 Response Manager::update_target(const std::int32_t target_id,
                          const Manager::OptionMapper& options) const {
-    Response response;
-    try {
-        Socket socket;
-        auto request = update_target_request(target_id, options);
-
-        std::lock_guard<std::mutex> lock(m_mutex);
-
-        socket.connect();
-        socket.send(request.get_request_data());
-
-        socket.recive(response.data(), response.get_response_pod_size());
-    } catch (const std::runtime_error& e) {
-        log_error(GET_LOGGER("tgt"), e.what());
-    }
-    return response;
+    auto request = update_target_request(target_id, options);
+    return execute(request);
 }
 
 Response Manager::destroy_target(const std::int32_t target_id) const {
-    Response response;
-    try {
-        Socket socket;
-        auto request = destroy_target_request(target_id);
+    auto request = destroy_target_request(target_id);
+    return execute(request);
+}
 
-        std::lock_guard<std::mutex> lock(m_mutex);
+Response Manager::show_targets() const {
+    auto request = show_targets_request();
+    return execute(request);
+}
 
-        socket.connect();
-        socket.send(request.get_request_data());
+Response Manager::add_target(const TargetData& target) const {
+    const auto target_id = target.get_target_id();
+    std::vector<Request> requests{};
 
-        socket.recive(response.data(), response.get_response_pod_size());
-    } catch (const std::runtime_error& e) {
-        log_error(GET_LOGGER("tgt"), e.what());
+    requests.push_back(create_target_request(target_id,
+                                             target.get_target_iqn()));
+    if (!target.get_target_initiator().empty()) {
+        OptionMapper options{};
+        options.emplace(INITIATOR_ADDRESS, target.get_target_initiator());
+        requests.push_back(bind_target_request(target_id, options));
+    }
+    for (const auto& lun : target.get_luns()) {
+        requests.push_back(create_lun_request(target_id, lun->get_lun(),
+                                              lun->get_device_path()));
     }
-    return response;
-}
-
-Response Manager::show_targets() const {
-    Response response;
-    try {
-        Socket socket;
-        auto request = show_targets_request();
 
-        std::lock_guard<std::mutex> lock(m_mutex);
+    auto responses = Session::get_instance().execute(requests);
 
-        socket.connect();
-        socket.send(request.get_request_data());
+    if (responses.size() == requests.size() && responses.back().is_valid()) {
+        return responses.back();
+    }
 
-        socket.recive(response.data(), response.get_response_pod_size());
-        if (response.is_valid() && response.get_length()) {
-            auto& extra_data = response.get_extra_data();
-            extra_data.resize(response.get_length());
-            socket.read(extra_data);
+    // roll back partially created target
+    if (1 < responses.size()) {
+        auto response = destroy_target(target_id);
+        if (!response.is_valid()) {
+            // partially created target is left in tgtd
+            log_error(GET_LOGGER("tgt"), "Destroy target error: " <<
+                      Errors::get_error_str(response.get_error()));
         }
-    } catch (const std::runtime_error& e) {
-        log_error(GET_LOGGER("tgt"), e.what());
     }
 
-    return response;
+    return responses.empty() ? Response{} : responses.back();
+}
+
+TargetDataSVec Manager::get_targets() const {
+    TargetDataSVec targets{};
+    auto response = show_targets();
+    if (!response.is_valid()) {
+        log_error(GET_LOGGER("tgt"), "ISCSI show target invalid response! " <<
+                  Errors::get_error_str(response.get_error()));
+        return targets;
+    }
+
+    const auto& extra_data = response.get_extra_data();
+    TargetParser parser{};
+    std::string iscsi_text(extra_data.cbegin(), extra_data.cend());
+    return parser.parse(iscsi_text);
 }
 
 Request Manager::create_target_request(const std::int32_t target_id,
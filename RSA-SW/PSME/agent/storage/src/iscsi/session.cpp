@@ -0,0 +1,82 @@
+/*!
+ * @section LICENSE
+ *
+ * @copyright
+ * Copyright (c) 2015 Intel Corporation
+ *
+ * @copyright
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * @copyright
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * @copyright
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @section DESCRIPTION
+*/
+
+#include "iscsi/session.hpp"
+#include "iscsi/socket.hpp"
+#include "iscsi/request.hpp"
+#include "iscsi/response.hpp"
+#include "logger/logger_factory.hpp"
+
+#include <stdexcept>
+
+using namespace agent::storage::iscsi::tgt;
+
+Session& Session::get_instance() {
+    static Session session;
+    return session;
+}
+
+Session::Session() {}
+
+Session::~Session() {}
+
+Response Session::execute(Request& request) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_execute(request);
+}
+
+std::vector<Response> Session::execute(std::vector<Request>& requests) {
+    std::vector<Response> responses{};
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto& request : requests) {
+        try {
+            responses.push_back(m_execute(request));
+        } catch (const std::runtime_error& e) {
+            log_error(GET_LOGGER("tgt"), e.what());
+            responses.emplace_back();
+        }
+        if (!responses.back().is_valid()) {
+            break;
+        }
+    }
+    return responses;
+}
+
+Response Session::m_execute(Request& request) {
+    Response response;
+
+    // tgtd serves one request per connection and closes it after response
+    Socket socket{};
+    socket.connect();
+    socket.send(request.get_request_data());
+    socket.recive(response.data(), response.get_response_pod_size());
+    if (response.is_valid() && response.get_length()) {
+        auto& extra_data = response.get_extra_data();
+        extra_data.resize(response.get_length());
+        socket.read(extra_data);
+    }
+
+    return response;
+}
@@ -75,7 +75,7 @@ void Socket::connect() {
 }
 
 void Socket::send(const std::vector<char>& in) const {
-    auto write_size = ::write(m_fd, &in[0], in.size());
+    auto write_size = ::send(m_fd, &in[0], in.size(), MSG_NOSIGNAL);
     if (0 > write_size || in.size() != static_cast<std::size_t>(write_size)) {
         throw std::runtime_error("Cannot write data to socket");
     }
@@ -84,8 +84,8 @@ void Socket::send(const std::vector<char>& in) const {
 void Socket::read(std::vector<char>& out) const {
     std::size_t all = 0;
     while (all < out.size()) {
-        auto read_size = ::read(m_fd, &out[0], out.size());
-        if (0 > read_size) {
+        auto read_size = ::read(m_fd, &out[all], out.size() - all);
+        if (0 >= read_size) {
             throw std::runtime_error(
                 "Cannot read data from socket" + std::to_string(read_size));
         }
@@ -0,0 +1,359 @@
+/*!
+ * @section LICENSE
+ *
+ * @copyright
+ * Copyright (c) 2015 Intel Corporation
+ *
+ * @copyright
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * @copyright
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * @copyright
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @section DESCRIPTION
+ *
+ * @file block_copy.cpp
+ * @brief Block device data copy used by lvm clone
+ * */
+
+#include "block_copy.hpp"
+#include "agent-framework/eventing/event_queue.hpp"
+#include "logger/logger_factory.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+using namespace agent::storage::lvm;
+using agent_framework::generic::EventQueue;
+
+namespace {
+
+constexpr std::size_t CHUNK_SIZE = 1024 * 1024;
+constexpr std::size_t QUEUE_DEPTH = 8;
+constexpr std::size_t BUFFER_ALIGNMENT = 4096;
+
+std::string error_string(const std::string& message) {
+    return message + ": " + strerror(errno);
+}
+
+/*! RAII file descriptor, opened for direct I/O when supported */
+class File {
+public:
+    File(const std::string& path, int flags) {
+        m_fd = open(path.c_str(), flags | O_DIRECT);
+        if (0 > m_fd && EINVAL == errno) {
+            m_fd = open(path.c_str(), flags);
+        }
+        if (0 > m_fd) {
+            throw std::runtime_error(error_string("Cannot open " + path));
+        }
+    }
+
+    ~File() {
+        close(m_fd);
+    }
+
+    File(const File&) = delete;
+    File& operator=(const File&) = delete;
+
+    int get() const {
+        return m_fd;
+    }
+
+    bool is_block_device() const {
+        struct stat file_stat;
+        return 0 == fstat(m_fd, &file_stat) && S_ISBLK(file_stat.st_mode);
+    }
+
+    std::uint64_t get_size() const {
+        if (is_block_device()) {
+            std::uint64_t size{};
+            if (0 != ioctl(m_fd, BLKGETSIZE64, &size)) {
+                throw std::runtime_error(error_string("ioctl(BLKGETSIZE64)"));
+            }
+            return size;
+        }
+        struct stat file_stat;
+        if (0 != fstat(m_fd, &file_stat)) {
+            throw std::runtime_error(error_string("fstat"));
+        }
+        return static_cast<std::uint64_t>(file_stat.st_size);
+    }
+
+    void disable_direct_io() {
+        const int flags = fcntl(m_fd, F_GETFL);
+        if (0 <= flags) {
+            fcntl(m_fd, F_SETFL, flags & ~O_DIRECT);
+        }
+    }
+
+private:
+    int m_fd{-1};
+};
+
+/*! Piece of data passed from reader to writer */
+struct Chunk {
+    std::uint64_t offset{};
+    std::uint64_t length{};
+    char* buffer{nullptr};
+    bool zero{false};
+    bool last{false};
+    std::string error{};
+};
+
+bool is_zero(const char* data, std::size_t length) {
+    return 0 == length ||
+        (0 == data[0] && 0 == memcmp(data, data + 1, length - 1));
+}
+
+/*! Length of hole at offset, in whole chunks, 0 if there is data */
+std::uint64_t get_hole_length(int fd, std::uint64_t offset,
+                              std::uint64_t total) {
+    std::uint64_t data_offset = total;
+    const auto ret = lseek(fd, static_cast<off_t>(offset), SEEK_DATA);
+    if (0 <= ret) {
+        data_offset = std::min(total, static_cast<std::uint64_t>(ret));
+    }
+    else if (ENXIO != errno) {
+        // SEEK_DATA not supported, e.g. by block devices
+        return 0;
+    }
+    if (total == data_offset) {
+        return total - offset;
+    }
+    return (data_offset - offset) / CHUNK_SIZE * CHUNK_SIZE;
+}
+
+void read_all(int fd, char* buffer, std::size_t length,
+              std::uint64_t offset) {
+    // direct I/O needs aligned length, reading past the end is truncated
+    const std::size_t request_length =
+        (length + BUFFER_ALIGNMENT - 1) / BUFFER_ALIGNMENT * BUFFER_ALIGNMENT;
+    std::size_t done = 0;
+    while (done < length) {
+        const auto ret = pread(fd, buffer + done, request_length - done,
+                               static_cast<off_t>(offset + done));
+        if (0 > ret && EINTR == errno) {
+            continue;
+        }
+        if (0 >= ret) {
+            throw std::runtime_error(error_string("Cannot read source"));
+        }
+        done += static_cast<std::size_t>(ret);
+    }
+}
+
+void write_all(File& file, const char* buffer, std::size_t length,
+               std::uint64_t offset) {
+    if (0 != length % BUFFER_ALIGNMENT) {
+        file.disable_direct_io();
+    }
+    std::size_t done = 0;
+    while (done < length) {
+        const auto ret = pwrite(file.get(), buffer + done, length - done,
+                                static_cast<off_t>(offset + done));
+        if (0 > ret && EINTR == errno) {
+            continue;
+        }
+        if (0 >= ret) {
+            throw std::runtime_error(error_string("Cannot write destination"));
+        }
+        done += static_cast<std::size_t>(ret);
+    }
+}
+
+void zero_range(File& file, std::uint64_t offset, std::uint64_t length,
+                const char* zeros) {
+    if (file.is_block_device()) {
+        std::uint64_t range[2] = {offset, length};
+        if (0 == ioctl(file.get(), BLKZEROOUT, range)) {
+            return;
+        }
+    }
+    else if (0 == fallocate(file.get(),
+                FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                static_cast<off_t>(offset), static_cast<off_t>(length))) {
+        return;
+    }
+
+    // zeroing offload not supported
+    while (0 < length) {
+        const auto size = std::min<std::uint64_t>(length, CHUNK_SIZE);
+        write_all(file, zeros, static_cast<std::size_t>(size), offset);
+        offset += size;
+        length -= size;
+    }
+}
+
+}
+
+BlockCopy::BlockCopy(const std::string& source, const std::string& dest) :
+    m_source{source}, m_dest{dest} {}
+
+void BlockCopy::run() {
+    File source{m_source, O_RDONLY};
+    File dest{m_dest, O_WRONLY};
+
+    const std::uint64_t total = source.get_size();
+    if (dest.get_size() < total) {
+        throw std::runtime_error("Destination is smaller than source");
+    }
+
+    // queue buffers followed by one zero-filled buffer
+    void* memory = nullptr;
+    if (0 != posix_memalign(&memory, BUFFER_ALIGNMENT,
+                            (QUEUE_DEPTH + 1) * CHUNK_SIZE)) {
+        throw std::runtime_error("Cannot allocate copy buffers");
+    }
+    std::unique_ptr<char, decltype(&free)> buffers{
+        static_cast<char*>(memory), &free};
+    char* zeros = buffers.get() + QUEUE_DEPTH * CHUNK_SIZE;
+    memset(zeros, 0, CHUNK_SIZE);
+
+    EventQueue<char*> free_buffers{};
+    EventQueue<Chunk> chunks{};
+    std::atomic<bool> cancelled{false};
+
+    for (std::size_t index = 0; index < QUEUE_DEPTH; ++index) {
+        free_buffers.push_back(buffers.get() + index * CHUNK_SIZE);
+    }
+
+    std::thread reader([&]() {
+        std::uint64_t offset = 0;
+        while (offset < total && !cancelled) {
+            Chunk chunk{};
+            chunk.offset = offset;
+
+            const auto hole_length = get_hole_length(source.get(), offset, total);
+            if (0 < hole_length) {
+                chunk.length = hole_length;
+                chunk.zero = true;
+            }
+            else {
+                chunk.length = std::min<std::uint64_t>(CHUNK_SIZE, total - offset);
+                free_buffers.wait_and_pop(chunk.buffer);
+                try {
+                    const auto length = static_cast<std::size_t>(chunk.length);
+                    read_all(source.get(), chunk.buffer, length, offset);
+                    chunk.zero = is_zero(chunk.buffer, length);
+                }
+                catch (const std::exception& e) {
+                    chunk.error = e.what();
+                    chunks.push_back(std::move(chunk));
+                    break;
+                }
+            }
+            offset += chunk.length;
+            chunks.push_back(std::move(chunk));
+        }
+        Chunk last{};
+        last.last = true;
+        chunks.push_back(std::move(last));
+    });
+
+    const auto start = std::chrono::steady_clock::now();
+    std::uint64_t copied = 0;
+    std::uint64_t written = 0;
+    std::uint64_t zero_offset = 0;
+    std::uint64_t zero_length = 0;
+    std::string error{};
+
+    auto flush_zeros = [&]() {
+        if (0 < zero_length) {
+            zero_range(dest, zero_offset, zero_length, zeros);
+            m_zeroed_bytes += zero_length;
+            zero_length = 0;
+        }
+    };
+
+    for (;;) {
+        Chunk chunk{};
+        chunks.wait_and_pop(chunk);
+        if (chunk.last) {
+            break;
+        }
+        if (error.empty() && !chunk.error.empty()) {
+            error = chunk.error;
+        }
+        if (error.empty()) {
+            try {
+                if (chunk.zero) {
+                    if (zero_offset + zero_length != chunk.offset) {
+                        flush_zeros();
+                        zero_offset = chunk.offset;
+                    }
+                    zero_length += chunk.length;
+                }
+                else {
+                    flush_zeros();
+                    write_all(dest, chunk.buffer,
+                              static_cast<std::size_t>(chunk.length),
+                              chunk.offset);
+                    written += chunk.length;
+                    if (0 != m_rate_limit) {
+                        const std::chrono::microseconds expected{
+                            written * 1000000 / m_rate_limit};
+                        const auto elapsed = std::chrono::steady_clock::now() - start;
+                        if (expected > elapsed) {
+                            std::this_thread::sleep_for(expected - elapsed);
+                        }
+                    }
+                }
+                copied += chunk.length;
+                if (m_progress_callback) {
+                    m_progress_callback(copied, total);
+                }
+            }
+            catch (const std::exception& e) {
+                error = e.what();
+                cancelled = true;
+            }
+        }
+        if (nullptr != chunk.buffer) {
+            free_buffers.push_back(chunk.buffer);
+        }
+    }
+    reader.join();
+
+    if (error.empty()) {
+        try {
+            flush_zeros();
+        }
+        catch (const std::exception& e) {
+            error = e.what();
+        }
+    }
+    if (error.empty() && 0 != fdatasync(dest.get())) {
+        error = error_string("Cannot sync destination");
+    }
+    if (!error.empty()) {
+        throw std::runtime_error(error);
+    }
+
+    const auto seconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    log_info(GET_LOGGER("lvm"), "Copied " << total << " bytes ("
+             << m_zeroed_bytes << " zeroed) in " << seconds << " ms");
+}
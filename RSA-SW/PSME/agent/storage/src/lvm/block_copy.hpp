@@ -0,0 +1,96 @@
+/*!
+ * @copyright
+ * Copyright (c) 2015 Intel Corporation
+ *
+ * @copyright
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * @copyright
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * @copyright
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ * @file block_copy.hpp
+ * @brief Block device data copy used by lvm clone
+ * */
+
+#ifndef PSME_STORAGE_LVM_BLOCK_COPY_HPP
+#define PSME_STORAGE_LVM_BLOCK_COPY_HPP
+
+#include <string>
+#include <cstdint>
+#include <functional>
+
+namespace agent {
+namespace storage {
+namespace lvm {
+
+/*!
+ * @brief Copies source block device (or file) to destination.
+ *
+ * Data is read and written with O_DIRECT through a queue of aligned buffers,
+ * reading runs in its own thread ahead of writing. Holes (SEEK_HOLE) and
+ * zero-filled chunks of the source are not written but zeroed on the
+ * destination with BLKZEROOUT (block devices) or hole punching (files).
+ */
+class BlockCopy {
+public:
+    /*! Progress callback, called with copied and total bytes */
+    using ProgressCallback = std::function<void(std::uint64_t, std::uint64_t)>;
+
+    /*!
+     * @brief Constructor
+     * @param source Source device path
+     * @param dest Destination device path
+     */
+    BlockCopy(const std::string& source, const std::string& dest);
+
+    /*!
+     * @brief Set copy rate limit
+     * @param rate_limit Rate limit in bytes per second, 0 means unlimited
+     */
+    void set_rate_limit(const std::uint64_t rate_limit) {
+        m_rate_limit = rate_limit;
+    }
+
+    /*!
+     * @brief Set progress callback
+     * @param callback Called after every copied chunk
+     */
+    void set_progress_callback(const ProgressCallback& callback) {
+        m_progress_callback = callback;
+    }
+
+    /*!
+     * @brief Copy whole source to destination, throw exception on error
+     */
+    void run();
+
+    /*!
+     * @brief Get number of bytes zeroed instead of written
+     * @return Zeroed bytes
+     */
+    std::uint64_t get_zeroed_bytes() const {
+        return m_zeroed_bytes;
+    }
+
+private:
+    std::string m_source{};
+    std::string m_dest{};
+    std::uint64_t m_rate_limit{};
+    std::uint64_t m_zeroed_bytes{};
+    ProgressCallback m_progress_callback{};
+};
+
+}
+}
+}
+#endif	/* PSME_STORAGE_LVM_BLOCK_COPY_HPP */
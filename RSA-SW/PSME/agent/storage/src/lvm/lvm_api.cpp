@@ -29,12 +29,139 @@
 #include "agent-framework/logger_ext.hpp"
 #include "agent-framework/exceptions/exception.hpp"
 
+#include <mutex>
 
 using namespace agent::storage::lvm;
 
 #ifdef LVM2APP_FOUND
 #define KB_TO_GB 1024 / 1024 / 1024
 
+namespace {
+
+/*!
+ * Long-lived liblvm handle shared by all LvmAPI objects. lvm_init scans
+ * all block devices, so discovery keeps the handle until a command changing
+ * volumes invalidates it or hotplug rescans.
+ * liblvm is not thread safe, all calls are made under the session mutex.
+ * */
+class Session {
+public:
+    static Session& get_instance() {
+        static Session session{};
+        return session;
+    }
+
+    std::mutex& get_mutex() {
+        return m_mutex;
+    }
+
+    /*! Get LVM handle, initialize it if needed. Requires session mutex. */
+    lvm_t get_handle() {
+        if (nullptr == m_handle) {
+            m_handle = lvm_init(nullptr);
+            if (nullptr == m_handle) {
+                log_error(GET_LOGGER("lvm"), "Could not open handle to LVM.");
+            }
+        }
+        return m_handle;
+    }
+
+    /*! Close LVM handle and drop cached volume groups */
+    void invalidate() {
+        if (nullptr != m_handle) {
+            lvm_quit(m_handle);
+            m_handle = nullptr;
+        }
+        invalidate_volume_groups();
+    }
+
+    /*! Rescan devices on open LVM handle and drop cached volume groups */
+    void rescan() {
+        if (nullptr != m_handle && 0 != lvm_scan(m_handle)) {
+            log_error(GET_LOGGER("lvm"), "Could not rescan devices: "
+                    << lvm_errmsg(m_handle));
+            invalidate();
+        }
+        invalidate_volume_groups();
+    }
+
+    bool has_volume_groups() const {
+        return m_volume_groups_valid;
+    }
+
+    const vector<LvmAPI::VolumeGroup>& get_volume_groups() const {
+        return m_volume_groups;
+    }
+
+    void set_volume_groups(const vector<LvmAPI::VolumeGroup>& volume_groups) {
+        m_volume_groups = volume_groups;
+        m_volume_groups_valid = true;
+    }
+
+    void invalidate_volume_groups() {
+        m_volume_groups.clear();
+        m_volume_groups_valid = false;
+    }
+
+    ~Session() {
+        if (nullptr != m_handle) {
+            lvm_quit(m_handle);
+        }
+    }
+
+private:
+    Session() = default;
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    std::mutex m_mutex{};
+    lvm_t m_handle{nullptr};
+    bool m_volume_groups_valid{false};
+    vector<LvmAPI::VolumeGroup> m_volume_groups{};
+};
+
+/*! Volume group opened on session handle, closed when out of scope */
+class VolumeGroupHandle {
+public:
+    VolumeGroupHandle(lvm_t lvm_handle, const char* name,
+                      const char* mode, uint32_t flags) :
+        m_handle{lvm_vg_open(lvm_handle, name, mode, flags)} {}
+
+    ~VolumeGroupHandle() {
+        if (nullptr != m_handle) {
+            lvm_vg_close(m_handle);
+        }
+    }
+
+    VolumeGroupHandle(const VolumeGroupHandle&) = delete;
+    VolumeGroupHandle& operator=(const VolumeGroupHandle&) = delete;
+
+    vg_t& get() {
+        return m_handle;
+    }
+
+    explicit operator bool() const {
+        return nullptr != m_handle;
+    }
+
+private:
+    vg_t m_handle{nullptr};
+};
+
+}
+
+void LvmAPI::invalidate() {
+    auto& session = Session::get_instance();
+    std::lock_guard<std::mutex> lock{session.get_mutex()};
+    session.invalidate();
+}
+
+void LvmAPI::rescan() {
+    auto& session = Session::get_instance();
+    std::lock_guard<std::mutex> lock{session.get_mutex()};
+    session.rescan();
+}
+
 bool LvmAPI::remove_logical_volume(const char *vg_name, const char *lv_name) {
 
     if (nullptr == vg_name || nullptr == lv_name) {
@@ -42,54 +169,41 @@ bool LvmAPI::remove_logical_volume(const char *vg_name, const char *lv_name) {
         return false;
     }
 
-    vg_t vg_handle = nullptr;
-    lv_t lv_handle = nullptr;
-    lvm_t lvm_handle = nullptr;
-    int ret = 0;
+    auto& session = Session::get_instance();
+    std::lock_guard<std::mutex> lock{session.get_mutex()};
 
-    lvm_handle = lvm_init(nullptr);
+    lvm_t lvm_handle = session.get_handle();
     if (nullptr == lvm_handle) {
-        log_error(GET_LOGGER("lvm"), "Could not open handle to LVM.");
         return false;
     }
 
-    vg_handle = lvm_vg_open(lvm_handle, vg_name, WRITE_MODE, flags);
-    if (nullptr == vg_handle) {
+    VolumeGroupHandle vg_handle{lvm_handle, vg_name, WRITE_MODE, flags};
+    if (!vg_handle) {
         log_error(GET_LOGGER("lvm"), "Could not open volume group: "
                 << lvm_errmsg(lvm_handle));
-        lvm_quit(lvm_handle);
         return false;
     }
+    session.invalidate_volume_groups();
 
-    lv_handle = lvm_lv_from_name(vg_handle, lv_name);
+    lv_t lv_handle = lvm_lv_from_name(vg_handle.get(), lv_name);
     if (nullptr == lv_handle) {
         log_error(GET_LOGGER("lvm"), "Could not open logical volume: "
                 << lvm_errmsg(lvm_handle));
-        lvm_vg_close(vg_handle);
-        lvm_quit(lvm_handle);
         return false;
     }
 
-    ret = lvm_vg_remove_lv(lv_handle);
-    if (0 != ret) {
+    if (0 != lvm_vg_remove_lv(lv_handle)) {
         log_error(GET_LOGGER("lvm"), "Could not remove logical volume: "
                 << lvm_errmsg(lvm_handle));
-        lvm_vg_close(vg_handle);
-        lvm_quit(lvm_handle);
         return false;
     }
 
-    ret = lvm_vg_write(vg_handle);
-    if (0 != ret) {
+    if (0 != lvm_vg_write(vg_handle.get())) {
         log_error(GET_LOGGER("lvm"), "Could not save changes to volume group: "
                 << lvm_errmsg(lvm_handle));
-        lvm_vg_close(vg_handle);
-        lvm_quit(lvm_handle);
         return false;
     }
 
-    lvm_vg_close(vg_handle);
-    lvm_quit(lvm_handle);
     return true;
 }
 
@@ -105,43 +219,36 @@ bool LvmAPI::create_snapshot(const char *vg_name, const char *lv_name, const cha
             "Snapshot size must be above 0.");
     }
 
-    vg_t vg_handle = nullptr;
-    lvm_t lvm_handle = nullptr;
-    lv_t lv_handle = nullptr, snapshot_handle = nullptr;
-    lvm_handle = lvm_init(nullptr);
+    auto& session = Session::get_instance();
+    std::lock_guard<std::mutex> lock{session.get_mutex()};
 
+    lvm_t lvm_handle = session.get_handle();
     if (nullptr == lvm_handle) {
         THROW(agent_framework::exceptions::LvmError, "lvm",
             "Could not open handle to LVM");
     }
 
-    vg_handle = lvm_vg_open(lvm_handle, vg_name, WRITE_MODE, flags);
-    if (nullptr == vg_handle) {
-        lvm_quit(lvm_handle);
+    VolumeGroupHandle vg_handle{lvm_handle, vg_name, WRITE_MODE, flags};
+    if (!vg_handle) {
         THROW(agent_framework::exceptions::LvmError, "lvm",
             "Could not open volume group");
     }
+    session.invalidate_volume_groups();
 
-    lv_handle = lvm_lv_from_name(vg_handle, lv_name);
+    lv_t lv_handle = lvm_lv_from_name(vg_handle.get(), lv_name);
     if (nullptr == lv_handle) {
-        lvm_vg_close(vg_handle);
-        lvm_quit(lvm_handle);
         THROW(agent_framework::exceptions::LvmError, "lvm",
             "Could not open logical volume");
     }
 
-    snapshot_handle = lvm_lv_snapshot(lv_handle, snapshot_name, size_bytes);
+    lv_t snapshot_handle = lvm_lv_snapshot(lv_handle, snapshot_name, size_bytes);
     if (nullptr == snapshot_handle) {
         log_error(GET_LOGGER("lvm"), "Could not create snapshot: "
                 << lvm_errmsg(lvm_handle));
-        lvm_vg_close(vg_handle);
-        lvm_quit(lvm_handle);
         THROW(agent_framework::exceptions::LvmError, "lvm",
             "Could not create snapshot");
     }
 
-    lvm_vg_close(vg_handle);
-    lvm_quit(lvm_handle);
     return true;
 }
 
@@ -152,63 +259,71 @@ bool LvmAPI::create_clone(const char *vg_name, const char *lv_name, const char *
             "Could not read create parameters");
     }
 
-    vg_t vg_handle = nullptr;
-    lvm_t lvm_handle = nullptr;
-    lv_t lv_handle = nullptr, clone_handle = nullptr;
-    lvm_handle = lvm_init(nullptr);
+    auto& session = Session::get_instance();
+    std::lock_guard<std::mutex> lock{session.get_mutex()};
 
+    lvm_t lvm_handle = session.get_handle();
     if (nullptr == lvm_handle) {
         THROW(agent_framework::exceptions::LvmError, "lvm",
             "Could not open handle to LVM");
     }
 
-    vg_handle = lvm_vg_open(lvm_handle, vg_name, WRITE_MODE, flags);
-    if (nullptr == vg_handle) {
-        lvm_quit(lvm_handle);
+    VolumeGroupHandle vg_handle{lvm_handle, vg_name, WRITE_MODE, flags};
+    if (!vg_handle) {
         THROW(agent_framework::exceptions::LvmError, "lvm",
             "Could not open volume group");
     }
 
-    lv_handle = lvm_lv_from_name(vg_handle, lv_name);
+    lv_t lv_handle = lvm_lv_from_name(vg_handle.get(), lv_name);
     if (nullptr == lv_handle) {
-        lvm_vg_close(vg_handle);
-        lvm_quit(lvm_handle);
         THROW(agent_framework::exceptions::LvmError, "lvm",
             "Could not open logical volume");
     }
 
     if (size_bytes < lvm_lv_get_size(lv_handle)) {
-        lvm_vg_close(vg_handle);
-        lvm_quit(lvm_handle);
         THROW(agent_framework::exceptions::LvmError, "lvm",
             "Could not create clone size is smaller than source size.");
     }
 
-    clone_handle = lvm_vg_create_lv_linear(vg_handle, clone_name, size_bytes);
+    session.invalidate_volume_groups();
+    lv_t clone_handle = lvm_vg_create_lv_linear(vg_handle.get(), clone_name, size_bytes);
     if (nullptr == clone_handle) {
-        lvm_vg_close(vg_handle);
-        lvm_quit(lvm_handle);
         THROW(agent_framework::exceptions::LvmError, "lvm",
             "Could not create clone.");
     }
 
-    lvm_vg_close(vg_handle);
-    lvm_quit(lvm_handle);
-
     return true;
 }
 
-void LvmAPI::m_discover_physical_volumes(LvmAPI::VolumeGroup& volume_group, vg_t& vg_handle, lvm_t& lvm_handle) {
-    struct dm_list* pvnames = nullptr;
-    struct lvm_pv_list* pv_list = nullptr;
-    pvnames = lvm_vg_list_pvs(vg_handle);
-    if (nullptr == pvnames) {
-        log_error(GET_LOGGER("lvm"), "Could not open physical volumes list: "
-                << lvm_errmsg(lvm_handle));
-        lvm_list_pvs_free(pvnames);
+void LvmAPI::m_discover_volume_group(LvmAPI::VolumeGroup& volume_group, vg_t& vg_handle, lvm_t& lvm_handle) {
+    volume_group.set_capacity_gb(static_cast<float> (lvm_vg_get_size(vg_handle)) / KB_TO_GB);
+    lvm_property_value vg_prop = lvm_vg_get_property(vg_handle, vg_attr_property);
+    volume_group.set_protection_status(vg_prop.value.string[vg_rw_attr] == *WRITE_MODE ? false : true);
+    if (vg_prop.value.string[vg_status_health_attr] == *HEALTH_CRITICAL) {
+        volume_group.set_health(health_critical);
+        volume_group.set_status(state_disabled);
+    } else {
+        volume_group.set_health(health_ok);
+        volume_group.set_status(state_enabled);
+    }
+
+    log_debug(GET_LOGGER("lvm"), "Found volume group " << volume_group.get_name());
+    log_debug(GET_LOGGER("lvm"), "Capacity: " << volume_group.get_capacity_gb());
+    log_debug(GET_LOGGER("lvm"), "Is protected: " << volume_group.get_protection_status());
+    log_debug(GET_LOGGER("lvm"), "Health: " << volume_group.get_health());
+    log_debug(GET_LOGGER("lvm"), "Status: " << volume_group.get_status());
+
+    // physical and logical volumes come from the metadata read by vg open,
+    // one attribute string is read for each of them
+    struct dm_list* pvnames = lvm_vg_list_pvs(vg_handle);
+    struct dm_list* lvnames = lvm_vg_list_lvs(vg_handle);
+    if (nullptr == pvnames || nullptr == lvnames) {
+        log_error(GET_LOGGER("lvm"), "Could not open volumes list of "
+                << volume_group.get_name() << ": " << lvm_errmsg(lvm_handle));
         return;
     }
 
+    struct lvm_pv_list* pv_list = nullptr;
     dm_list_iterate_items(pv_list, pvnames) {
         PhysicalVolume physical_volume;
         physical_volume.set_name(lvm_pv_get_name(pv_list->pv));
@@ -221,7 +336,7 @@ void LvmAPI::m_discover_physical_volumes(LvmAPI::VolumeGroup& volume_group, vg_t
             physical_volume.set_health(health_ok);
             physical_volume.set_status(state_enabled);
         }
-        physical_volume.set_volume_group(lvm_vg_get_name(vg_handle));
+        physical_volume.set_volume_group(volume_group.get_name());
 
         log_debug(GET_LOGGER("lvm"), "Found physical volume " << physical_volume.get_name());
         log_debug(GET_LOGGER("lvm"), "Capacity: " << physical_volume.get_capacity_gb());
@@ -232,19 +347,8 @@ void LvmAPI::m_discover_physical_volumes(LvmAPI::VolumeGroup& volume_group, vg_t
 
         volume_group.physical_volumes.push_back(physical_volume);
     }
-    lvm_list_pvs_free(pvnames);
-}
 
-void LvmAPI::m_discover_logical_volumes(LvmAPI::VolumeGroup& volume_group, vg_t& vg_handle, lvm_t& lvm_handle) {
-    struct dm_list* lvnames = nullptr;
     struct lvm_lv_list* lv_list = nullptr;
-    lvnames = lvm_vg_list_lvs(vg_handle);
-    if (nullptr == lvnames) {
-        log_error(GET_LOGGER("lvm"), "Could not open logical volumes list: "
-                << lvm_errmsg(lvm_handle));
-        return;
-    }
-
     dm_list_iterate_items(lv_list, lvnames) {
         lv_t lv_handle = lv_list->lv;
 
@@ -259,7 +363,7 @@ void LvmAPI::m_discover_logical_volumes(LvmAPI::VolumeGroup& volume_group, vg_t&
         logical_volume.set_health(lv_prop.value.string[lv_health_attr] == *HEALTH_CRITICAL ? health_critical : health_ok);
         logical_volume.set_status(lv_prop.value.string[lv_status_attr] == *STATE_ACTIVE ? state_enabled : state_disabled);
         logical_volume.set_snapshot_status(lv_prop.value.string[lv_type_attr] == *LV_SNAPSHOT_TYPE ? true : false);
-        logical_volume.set_volume_group(lvm_vg_get_name(vg_handle));
+        logical_volume.set_volume_group(volume_group.get_name());
 
         log_debug(GET_LOGGER("lvm"), "Found logical volume " << logical_volume.get_name());
         log_debug(GET_LOGGER("lvm"), "Capacity: " << logical_volume.get_capacity_gb());
@@ -275,15 +379,20 @@ void LvmAPI::m_discover_logical_volumes(LvmAPI::VolumeGroup& volume_group, vg_t&
 
 void LvmAPI::discover_volume_groups_structure(vector<LvmAPI::VolumeGroup>& volume_groups) {
 
-    lvm_t handle = nullptr;
-    handle = lvm_init(nullptr);
+    auto& session = Session::get_instance();
+    std::lock_guard<std::mutex> lock{session.get_mutex()};
 
+    if (session.has_volume_groups()) {
+        const auto& cached = session.get_volume_groups();
+        volume_groups.insert(volume_groups.end(), cached.cbegin(), cached.cend());
+        return;
+    }
+
+    lvm_t handle = session.get_handle();
     if (nullptr == handle) {
-        log_error(GET_LOGGER("lvm"), "Could not open handle to LVM.");
         return;
     }
 
-    vg_t vg = nullptr;
     struct dm_list* vgnames = nullptr;
     struct lvm_str_list* str_list = nullptr;
 
@@ -291,45 +400,26 @@ void LvmAPI::discover_volume_groups_structure(vector<LvmAPI::VolumeGroup>& volum
     if (nullptr == vgnames) {
         log_error(GET_LOGGER("lvm"), "Could not open volume group list: "
                 << lvm_errmsg(handle));
-        lvm_quit(handle);
         return;
     }
 
+    vector<VolumeGroup> discovered{};
     dm_list_iterate_items(str_list, vgnames) {
-        vg = lvm_vg_open(handle, str_list->str, READ_MODE, flags);
-        if (nullptr == vg) {
-            log_error(GET_LOGGER("lvm"), "Could not open volume group: "
-                    << lvm_errmsg(handle));
-            lvm_quit(handle);
-            return;
+        VolumeGroupHandle vg{handle, str_list->str, READ_MODE, flags};
+        if (!vg) {
+            log_error(GET_LOGGER("lvm"), "Could not open volume group "
+                    << str_list->str << ": " << lvm_errmsg(handle));
+            continue;
         }
         VolumeGroup volume_group;
         volume_group.set_name(str_list->str);
-        volume_group.set_capacity_gb(static_cast<float> (lvm_vg_get_size(vg)) / KB_TO_GB);
-        lvm_property_value vg_prop = lvm_vg_get_property(vg, vg_attr_property);
-        volume_group.set_protection_status(vg_prop.value.string[vg_rw_attr] == *WRITE_MODE ? false : true);
-        if (vg_prop.value.string[vg_status_health_attr] == *HEALTH_CRITICAL) {
-            volume_group.set_health(health_critical);
-            volume_group.set_status(state_disabled);
-        } else {
-            volume_group.set_health(health_ok);
-            volume_group.set_status(state_enabled);
-        }
-
-        log_debug(GET_LOGGER("lvm"), "Found volume group " << volume_group.get_name());
-        log_debug(GET_LOGGER("lvm"), "Capacity: " << volume_group.get_capacity_gb());
-        log_debug(GET_LOGGER("lvm"), "Is protected: " << volume_group.get_protection_status());
-        log_debug(GET_LOGGER("lvm"), "Health: " << volume_group.get_health());
-        log_debug(GET_LOGGER("lvm"), "Status: " << volume_group.get_status());
-
-        m_discover_physical_volumes(volume_group, vg, handle);
-        m_discover_logical_volumes(volume_group, vg, handle);
+        m_discover_volume_group(volume_group, vg.get(), handle);
 
-        lvm_vg_close(vg);
-        volume_groups.push_back(volume_group);
+        discovered.push_back(volume_group);
     }
-    lvm_quit(handle);
 
+    session.set_volume_groups(discovered);
+    volume_groups.insert(volume_groups.end(), discovered.cbegin(), discovered.cend());
 }
 
 #endif
@@ -403,7 +403,8 @@ public:
     };
 
     /*!
-     * @brief Discover volume groups with their physical and logical volumes
+     * @brief Discover volume groups with their physical and logical volumes.
+     * Result is cached until volume group is modified or rescan is called.
      * @param[in] volume_groups Vector of volume groups to be filled.
      * */
     void discover_volume_groups_structure(vector<VolumeGroup>& volume_groups);
@@ -436,10 +437,21 @@ public:
      * */
     bool remove_logical_volume(const char *vg_name, const char *lv_name);
 
+    /*!
+     * @brief Close shared LVM handle and drop cached volume groups, next
+     * operation reinitializes LVM. Called by commands changing volumes.
+     * */
+    static void invalidate();
+
+    /*!
+     * @brief Rescan block devices and drop cached volume groups.
+     * Must be called when devices are added or removed.
+     * */
+    static void rescan();
+
 private:
 #ifdef LVM2APP_FOUND
-    void m_discover_physical_volumes(LvmAPI::VolumeGroup& volume_group, vg_t& vg_handle, lvm_t& lvm_handle);
-    void m_discover_logical_volumes(LvmAPI::VolumeGroup& volume_group, vg_t& vg_handle, lvm_t& lvm_handle);
+    void m_discover_volume_group(LvmAPI::VolumeGroup& volume_group, vg_t& vg_handle, lvm_t& lvm_handle);
 #endif
 
     string m_boot_device{};
@@ -27,11 +27,10 @@
  * */
 
 #include "lvm_clone_task.hpp"
+#include "block_copy.hpp"
 #include "agent-framework/action/task_status_manager.hpp"
 #include "logger/logger_factory.hpp"
 
-#include <fstream>
-
 using namespace agent::storage::lvm;
 
 LvmCloneTask::LvmCloneTask(const LvmCreateData& create_data) :
@@ -45,16 +44,22 @@ void LvmCloneTask::operator()() {
 
     bool status{true};
     try {
-        std::ifstream source(get_source(), std::ios::binary);
-        std::ofstream dest(get_dest(), std::ios::binary);
-
-        std::istreambuf_iterator<char> begin_source(source);
-        std::istreambuf_iterator<char> end_source;
-        std::ostreambuf_iterator<char> begin_dest(dest);
-        std::copy(begin_source, end_source, begin_dest);
+        const auto& uuid = m_create_data.get_uuid();
+        std::uint8_t last_percent{};
+        TaskStatusManager::get_instance().set_progress(uuid, last_percent);
 
-        source.close();
-        dest.close();
+        BlockCopy block_copy{get_source(), get_dest()};
+        block_copy.set_rate_limit(m_create_data.get_rate_limit());
+        block_copy.set_progress_callback(
+            [&uuid, &last_percent](std::uint64_t copied, std::uint64_t total) {
+                const auto percent = static_cast<std::uint8_t>(
+                        0 == total ? 100 : copied * 100 / total);
+                if (percent != last_percent) {
+                    last_percent = percent;
+                    TaskStatusManager::get_instance().set_progress(uuid, percent);
+                }
+            });
+        block_copy.run();
     } catch (std::exception const& err) {
         log_error(GET_LOGGER("lvm"), "Could not copy data to clone: "
                 << err.what());
@@ -26,6 +26,7 @@
 #define PSME_STORAGE_LVM_LVM_CREATE_DATA_HPP
 
 #include <string>
+#include <cstdint>
 
 namespace agent {
 namespace storage {
@@ -110,8 +111,25 @@ public:
     const std::string& get_create_name() const {
         return m_create_name;
     }
+
+    /*!
+     * @brief Set clone copy rate limit
+     * @param rate_limit Rate limit in bytes per second, 0 means unlimited
+     */
+    void set_rate_limit(const std::uint64_t rate_limit) {
+        m_rate_limit = rate_limit;
+    }
+
+    /*!
+     * @brief Get clone copy rate limit
+     * @return Rate limit in bytes per second, 0 means unlimited
+     */
+    std::uint64_t get_rate_limit() const {
+        return m_rate_limit;
+    }
 private:
     std::uint64_t m_size{};
+    std::uint64_t m_rate_limit{};
     std::string m_uuid{};
     std::string m_volume_group{};
     std::string m_logical_volume{};
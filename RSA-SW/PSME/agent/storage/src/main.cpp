@@ -45,6 +45,8 @@
 #include "default_configuration.hpp"
 
 #include "discovery/discovery_manager.hpp"
+#include "discovery/hotplug_monitor.hpp"
+#include "sysfs/sysfs_api.hpp"
 
 #include <jsonrpccpp/server/connectors/httpserver.h>
 
@@ -123,6 +125,12 @@ int main(int argc, char* argv[]) {
         log_error(GET_LOGGER("storage-agent"), "Cannot read server port " << e.what());
     }
 
+    const auto& loop_devices = configuration["discovery"]["loop-devices"];
+    if (loop_devices.is_boolean()) {
+        agent::storage::sysfs::SysfsAPI::get_instance()->set_loop_devices(
+            loop_devices.as_bool());
+    }
+
     RegistrationManager reg_manager;
     RegistrationData reg_data;
 
@@ -161,6 +169,11 @@ int main(int argc, char* argv[]) {
     /* Wait for discovery to complete */
     discovery_manager.wait_for_discovery_complete();
 
+    /* Track block device changes after initial discovery */
+    agent::storage::discovery::HotplugMonitor hotplug_monitor{discovery_manager};
+    hotplug_monitor.subscribe(client.get());
+    hotplug_monitor.start();
+
     /* Register agent to rest application server */
     reg_manager.register_agent(reg_data);
 
@@ -171,6 +184,7 @@ int main(int argc, char* argv[]) {
     wait_for_interrupt();
 
     server.stop();
+    hotplug_monitor.stop();
 
     log_info(GET_LOGGER("storage-agent"), "Stopping PSME Storage...\n");
 
@@ -35,17 +35,24 @@
 #include <unistd.h>
 #include <sys/vfs.h>
 #include <sys/ioctl.h>
+#include <sys/sysmacros.h>
 #include <scsi/sg.h>
 #include <linux/hdreg.h>
 
 #include <mutex>
+#include <atomic>
 #include <thread>
+#include <fstream>
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
 
 using namespace agent::storage::sysfs;
 
 constexpr const char SysfsAPI::ROOT_FS[];
 constexpr const char SysfsAPI::BOOT_FS[];
+constexpr const char SysfsAPI::UEVENT_SEQNUM_PATH[];
+constexpr const char* SysfsAPI::UNIQUE_ID_ATTRIBUTES[];
 
 constexpr const char SysfsAPI::HardDrive::TYPE_SSD[];
 constexpr const char SysfsAPI::HardDrive::TYPE_HDD[];
@@ -66,24 +73,18 @@ void SysfsAPI::get_hard_drives(vector<HardDrive>& hard_drives) {
     struct sysfs_class* block = nullptr;
     struct sysfs_device* device = nullptr;
     struct dlist* devices_list = nullptr;
-    std::list<std::thread> threads{};
-    std::mutex push_back_mutex{};
-
-    auto discover_device = [&](struct sysfs_device* dev) {
-        HardDrive hard_drive{};
-
-        m_read_block_device_attributes(dev, hard_drive);
-
-        std::lock_guard<std::mutex> guard(push_back_mutex);
-
-        hard_drives.push_back(hard_drive);
-
-        log_debug(GET_LOGGER("storage-agent"), "Found block device "
-              << hard_drive.get_device_path());
-        log_debug(GET_LOGGER("storage-agent"), "Model: "
-              << hard_drive.get_model());
-        log_debug(GET_LOGGER("storage-agent"), "Capacity: "
-              << hard_drive.get_capacity_gb());
+    std::vector<struct sysfs_device*> devices{};
+    std::vector<HardDrive> discovered_drives{};
+    std::vector<dev_t> device_numbers{};
+    std::vector<std::thread> threads{};
+    std::atomic<size_t> next_device{0};
+
+    auto discover_devices = [&]() {
+        for (size_t index = next_device++; index < devices.size();
+                index = next_device++) {
+            m_read_block_device_attributes(devices[index],
+                    discovered_drives[index], device_numbers[index]);
+        }
     };
 
     block = sysfs_open_class(SYSFS_BLOCK_NAME);
@@ -95,17 +96,39 @@ void SysfsAPI::get_hard_drives(vector<HardDrive>& hard_drives) {
     dlist_for_each_data(devices_list, device, struct sysfs_device) {
         if (nullptr != device && !m_is_virtual_device(device)
                 && !m_is_boot_device(device)) {
-
-            // discover hard drives simultaneously
-            threads.emplace_back(discover_device, device);
+            devices.push_back(device);
         }
     }
 
+    discovered_drives.resize(devices.size());
+    device_numbers.resize(devices.size());
+    m_uevent_seqnum = m_read_uevent_seqnum();
+
+    // discover hard drives simultaneously, using a bounded number of threads
+    const size_t threads_count =
+        std::min(devices.size(), static_cast<size_t>(MAX_PROBE_THREADS));
+    for (size_t thread = 0; thread < threads_count; ++thread) {
+        threads.emplace_back(discover_devices);
+    }
+
     // join all threads
     std::for_each(std::begin(threads), std::end(threads),
             std::mem_fun_ref(&std::thread::join));
 
     sysfs_close_class(block);
+
+    m_prune_identity_cache(device_numbers);
+
+    for (const auto& hard_drive : discovered_drives) {
+        log_debug(GET_LOGGER("storage-agent"), "Found block device "
+              << hard_drive.get_device_path());
+        log_debug(GET_LOGGER("storage-agent"), "Model: "
+              << hard_drive.get_model());
+        log_debug(GET_LOGGER("storage-agent"), "Capacity: "
+              << hard_drive.get_capacity_gb());
+
+        hard_drives.push_back(hard_drive);
+    }
 }
 
 void SysfsAPI::get_partitions(const HardDrive& drive,
@@ -149,7 +172,17 @@ void SysfsAPI::get_partitions(const HardDrive& drive,
 
 bool SysfsAPI::m_is_virtual_device(const struct sysfs_device* device) {
     string path{device->path};
-    return string::npos != path.find("/virtual/");
+    if (string::npos == path.find("/virtual/")) {
+        return false;
+    }
+    return !(m_loop_devices && m_is_loop_device(device));
+}
+
+bool SysfsAPI::m_is_loop_device(const struct sysfs_device* device) {
+    // unused loop devices have no backing file and no capacity
+    string path{device->path};
+    return 0 == string{device->name}.find("loop") &&
+        0 == access((path + "/loop/backing_file").c_str(), F_OK);
 }
 
 bool SysfsAPI::m_is_boot_device(const struct sysfs_device* device) {
@@ -215,15 +248,25 @@ void SysfsAPI::m_detect_boot_device() {
 }
 
 void SysfsAPI::m_read_block_device_attributes(struct sysfs_device* device,
-                                              HardDrive& hard_drive) {
+                                              HardDrive& hard_drive,
+                                              dev_t& device_number) {
     unsigned long long capacity_bytes = 0;
+    unsigned int major_number = 0;
+    unsigned int minor_number = 0;
     string model = "";
+    string dev = "";
 
     m_read_attribute(capacity_bytes, device, "size");
     m_read_attribute(model, device, "device/model");
+    m_read_attribute(dev, device, "dev");
 
     m_trim(model);
 
+    device_number = 0;
+    if (2 == sscanf(dev.c_str(), "%u:%u", &major_number, &minor_number)) {
+        device_number = makedev(major_number, minor_number);
+    }
+
     hard_drive.set_name(device->name);
     hard_drive.set_sysfs_path(device->path);
     hard_drive.set_device_path(m_get_device_path(device));
@@ -231,7 +274,107 @@ void SysfsAPI::m_read_block_device_attributes(struct sysfs_device* device,
         static_cast<uint32_t>(capacity_bytes / SECTORS_TO_GB));
     hard_drive.set_model(model);
 
+    m_read_identity(device, device_number, hard_drive);
+}
+
+void SysfsAPI::m_read_identity(struct sysfs_device* device,
+                               const dev_t device_number,
+                               HardDrive& hard_drive) {
+    string signature = "";
+    string size = "";
+
+    m_read_attribute(signature, device, "uevent");
+    m_read_attribute(size, device, "size");
+    signature += size;
+
+    // uevent and size of a new disk may equal those of the removed one,
+    // disk sequence number and world wide id tell them apart
+    for (const auto& attribute_name : UNIQUE_ID_ATTRIBUTES) {
+        const struct sysfs_attribute* attribute =
+            sysfs_get_device_attr(device, attribute_name);
+        if (nullptr != attribute && nullptr != attribute->value) {
+            signature += attribute->value;
+        }
+    }
+
+    if (m_read_cached_identity(device_number, signature, hard_drive)) {
+        log_debug(GET_LOGGER("storage-agent"), "Using cached identity of "
+                  << hard_drive.get_device_path());
+        return;
+    }
+
     m_read_ata_attributes(device, hard_drive);
+
+    if (0 != device_number) {
+        std::lock_guard<std::mutex> guard(m_identity_cache_mutex);
+
+        auto& entry = m_identity_cache[device_number];
+        entry.uevent_seqnum = m_uevent_seqnum;
+        entry.signature = signature;
+        entry.identity = hard_drive;
+    }
+}
+
+bool SysfsAPI::m_read_cached_identity(const dev_t device_number,
+                                      const string& signature,
+                                      HardDrive& hard_drive) {
+    if (0 == device_number) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(m_identity_cache_mutex);
+
+    auto it = m_identity_cache.find(device_number);
+    if (m_identity_cache.end() == it) {
+        return false;
+    }
+
+    auto& entry = it->second;
+
+    // Without any uevent since the last probe the device cannot have changed,
+    // otherwise its uevent attributes, size and unique ids have to match.
+    if (m_uevent_seqnum.empty() || entry.uevent_seqnum != m_uevent_seqnum) {
+        if (entry.signature != signature) {
+            return false;
+        }
+        entry.uevent_seqnum = m_uevent_seqnum;
+    }
+
+    const auto& identity = entry.identity;
+    hard_drive.set_rpm(identity.get_rpm());
+    hard_drive.set_type(identity.get_type());
+    hard_drive.set_serial_number(identity.get_serial_number());
+    hard_drive.set_manufacturer(identity.get_manufacturer());
+    hard_drive.set_interface(identity.get_interface());
+
+    return true;
+}
+
+void SysfsAPI::m_prune_identity_cache(const vector<dev_t>& present_devices) {
+    std::lock_guard<std::mutex> guard(m_identity_cache_mutex);
+
+    for (auto it = m_identity_cache.begin(); it != m_identity_cache.end();) {
+        if (std::find(present_devices.cbegin(), present_devices.cend(),
+                      it->first) == present_devices.cend()) {
+            it = m_identity_cache.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+string SysfsAPI::m_read_uevent_seqnum() {
+    string seqnum = "";
+    std::ifstream seqnum_file(UEVENT_SEQNUM_PATH);
+
+    if (!(seqnum_file >> seqnum)) {
+        log_debug(GET_LOGGER("storage-agent"), "Cannot read "
+                  << UEVENT_SEQNUM_PATH);
+        return "";
+    }
+
+    return seqnum;
 }
 
 void SysfsAPI::m_read_attribute(string& value,
@@ -305,20 +448,22 @@ void SysfsAPI::m_read_ata_attributes(const struct sysfs_device* device,
         uint32_t rpm{};
         string serial_number{};
         string manufacturer{};
+        // each probe owns its buffer, as devices are probed concurrently
+        std::unique_ptr<uint16_t[]> ata_data{new uint16_t[ATA_DATA_SIZE/2]};
 
         try {
-            m_perform_sg_io(device);
+            m_perform_sg_io(device, ata_data.get());
         }
         catch (const std::exception& error) {
             log_warning(GET_LOGGER("storage-agent"),
                         "Cannot perform SG_IO ioctl. " <<
                         "Falling back to HDIO_DRIVE_CMD. " << error.what());
-            m_perform_hdio_drive_cmd(device);
+            m_perform_hdio_drive_cmd(device, ata_data.get());
         }
 
-        m_read_rpm(rpm);
-        m_read_serial_number(serial_number);
-        m_read_manufacturer(manufacturer);
+        m_read_rpm(ata_data.get(), rpm);
+        m_read_serial_number(ata_data.get(), serial_number);
+        m_read_manufacturer(ata_data.get(), manufacturer);
 
         if (SSD_RPM_VALUE == rpm) {
             hard_drive.set_type(HardDrive::TYPE_SSD);
@@ -338,29 +483,26 @@ void SysfsAPI::m_read_ata_attributes(const struct sysfs_device* device,
     }
 }
 
-void SysfsAPI::m_perform_hdio_drive_cmd(const struct sysfs_device* device) {
+void SysfsAPI::m_perform_hdio_drive_cmd(const struct sysfs_device* device,
+                                        uint16_t* ata_data) {
 
     static constexpr uint8_t ATA_OP_IDENTIFY = 0xec;
     static constexpr uint8_t ATA_OP_PIDENTIFY = 0xa1;
 
     string dev_path = m_get_device_path(device);
 
-    if (nullptr == m_hdio_data.get()) {
-        m_hdio_data.reset(new uint16_t[ATA_DATA_SIZE/2]);
-    }
-
     int fd = open(dev_path.c_str(), O_RDONLY | O_NONBLOCK);
     if (0 > fd) {
         throw std::runtime_error("open");
     }
 
-    memset(m_hdio_data.get(), 0, ATA_DATA_SIZE);
+    memset(ata_data, 0, ATA_DATA_SIZE);
 
-    uint8_t* hdio_data = reinterpret_cast<uint8_t*>(m_hdio_data.get());
+    uint8_t* hdio_data = reinterpret_cast<uint8_t*>(ata_data);
     hdio_data[0] = ATA_OP_IDENTIFY;
     hdio_data[3] = 1;
     if (0 != ioctl(fd, HDIO_DRIVE_CMD, hdio_data)) {
-        memset(m_hdio_data.get(), 0, ATA_DATA_SIZE);
+        memset(ata_data, 0, ATA_DATA_SIZE);
         hdio_data[0] = ATA_OP_PIDENTIFY;
         hdio_data[3] = 1;
         if (0 != ioctl(fd, HDIO_DRIVE_CMD, hdio_data)) {
@@ -372,7 +514,8 @@ void SysfsAPI::m_perform_hdio_drive_cmd(const struct sysfs_device* device) {
     close(fd);
 }
 
-void SysfsAPI::m_perform_sg_io(const struct sysfs_device* device) {
+void SysfsAPI::m_perform_sg_io(const struct sysfs_device* device,
+                               uint16_t* ata_data) {
 
     static constexpr const size_t COMMAND_BUFFER_SIZE = 16;
     static constexpr const size_t SENSE_BUFFER_SIZE = 32;
@@ -387,13 +530,9 @@ void SysfsAPI::m_perform_sg_io(const struct sysfs_device* device) {
 
     string dev_path = m_get_device_path(device);
 
-    if (nullptr == m_hdio_data.get()) {
-        m_hdio_data.reset(new uint16_t[ATA_DATA_SIZE/2]);
-    }
-
     uint8_t command_buffer[COMMAND_BUFFER_SIZE];
     uint8_t sense_buffer[SENSE_BUFFER_SIZE];
-    uint8_t* data_buffer = reinterpret_cast<uint8_t*>(m_hdio_data.get() + 2);
+    uint8_t* data_buffer = reinterpret_cast<uint8_t*>(ata_data + 2);
     sg_io_hdr_t io_hdr;
 
     int fd = open(dev_path.c_str(), O_RDONLY | O_NONBLOCK);
@@ -404,7 +543,7 @@ void SysfsAPI::m_perform_sg_io(const struct sysfs_device* device) {
     memset(&io_hdr, 0, sizeof(io_hdr));
     memset(command_buffer, 0, COMMAND_BUFFER_SIZE);
     memset(sense_buffer, 0, SENSE_BUFFER_SIZE);
-    memset(m_hdio_data.get(), 0, ATA_DATA_SIZE);
+    memset(ata_data, 0, ATA_DATA_SIZE);
 
     command_buffer[0] = SG_ATA_16;
     command_buffer[1] = SG_ATA_PROTO_PIO_IN;
@@ -432,38 +571,41 @@ void SysfsAPI::m_perform_sg_io(const struct sysfs_device* device) {
     close(fd);
 }
 
-void SysfsAPI::m_read_ata_string(string& value, size_t offset, size_t length) {
-    if (0 == m_hdio_data[offset]) {
+void SysfsAPI::m_read_ata_string(const uint16_t* ata_data, string& value,
+                                 size_t offset, size_t length) {
+    if (0 == ata_data[offset]) {
         return;
     }
     value.resize(length * 2);
     for (size_t pos = 0; pos < length; ++pos) {
-        uint16_t data_word = m_hdio_data[offset + pos];
+        uint16_t data_word = ata_data[offset + pos];
         value[pos * 2] = static_cast<char>((data_word >> 8) & 0xff);
         value[pos * 2 + 1] = static_cast<char>(data_word & 0xff);
     }
     m_trim(value);
 }
 
-void SysfsAPI::m_read_serial_number(string& serial_number) {
+void SysfsAPI::m_read_serial_number(const uint16_t* ata_data,
+                                    string& serial_number) {
     static constexpr const uint32_t SERIAL_OFFSET = 12;
     static constexpr const uint32_t SERIAL_LENGTH = 10;
 
-    m_read_ata_string(serial_number, SERIAL_OFFSET, SERIAL_LENGTH);
+    m_read_ata_string(ata_data, serial_number, SERIAL_OFFSET, SERIAL_LENGTH);
 }
 
-void SysfsAPI::m_read_manufacturer(string& manufacturer) {
+void SysfsAPI::m_read_manufacturer(const uint16_t* ata_data,
+                                   string& manufacturer) {
     static constexpr const uint32_t MANUFACTURER_OFFSET = 198;
     static constexpr const uint32_t MANUFACTURER_LENGTH = 10;
 
-    m_read_ata_string(manufacturer, MANUFACTURER_OFFSET, MANUFACTURER_LENGTH);
+    m_read_ata_string(ata_data, manufacturer, MANUFACTURER_OFFSET, MANUFACTURER_LENGTH);
 }
 
-void SysfsAPI::m_read_rpm(uint32_t& rpm) {
+void SysfsAPI::m_read_rpm(const uint16_t* ata_data, uint32_t& rpm) {
     /* Nominal Media Rotation Rate */
     static constexpr uint32_t NMRR = 219;
 
-    rpm = m_hdio_data[NMRR];
+    rpm = ata_data[NMRR];
     log_debug(GET_LOGGER("storage-agent"), "Nominal Media Rotation Rate: " <<
               rpm);
 }
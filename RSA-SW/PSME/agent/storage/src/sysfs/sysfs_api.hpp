@@ -28,6 +28,10 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <sys/types.h>
 
 struct sysfs_device;
 
@@ -298,6 +302,15 @@ public:
      * */
     static SysfsAPI* get_instance();
 
+    /*!
+     * @brief Report loop devices with a backing file as hard drives.
+     * Other virtual block devices are never reported.
+     * @param[in] loop_devices Loop devices are reported if true
+     * */
+    void set_loop_devices(bool loop_devices) {
+        m_loop_devices = loop_devices;
+    }
+
     /*!
      * @brief Get hard drives
      * @param[in] drives Vector of hard drives to be filled.
@@ -319,15 +332,29 @@ public:
 private:
     SysfsAPI() {}
 
+    /*! ATA identity of a block device cached between discoveries */
+    struct IdentityCacheEntry {
+        string uevent_seqnum{};
+        string signature{};
+        HardDrive identity{};
+    };
+
     string m_boot_device{};
+    std::atomic<bool> m_loop_devices{false};
+
+    std::mutex m_identity_cache_mutex{};
+    std::map<dev_t, IdentityCacheEntry> m_identity_cache{};
+    string m_uevent_seqnum{};
 
     bool m_is_virtual_device(const struct sysfs_device* device);
+    bool m_is_loop_device(const struct sysfs_device* device);
     bool m_is_boot_device(const struct sysfs_device* device);
 
     void m_detect_boot_device();
 
     void m_read_block_device_attributes(struct sysfs_device* device,
-                                        HardDrive& hard_drive);
+                                        HardDrive& hard_drive,
+                                        dev_t& device_number);
 
     void m_read_attribute(unsigned long long& value,
                           struct sysfs_device* device,
@@ -341,14 +368,25 @@ private:
                           struct sysfs_device* device,
                           const string& attribute_name);
 
+    void m_read_identity(struct sysfs_device* device,
+                         const dev_t device_number,
+                         HardDrive& hard_drive);
+    bool m_read_cached_identity(const dev_t device_number,
+                                const string& signature,
+                                HardDrive& hard_drive);
+    void m_prune_identity_cache(const std::vector<dev_t>& present_devices);
+    string m_read_uevent_seqnum();
+
     void m_read_ata_attributes(const struct sysfs_device* device,
                                HardDrive& hard_drive);
-    void m_perform_sg_io(const struct sysfs_device* device);
-    void m_perform_hdio_drive_cmd(const struct sysfs_device* device);
-    void m_read_ata_string(string& value, size_t offset, size_t length);
-    void m_read_rpm(uint32_t& rpm);
-    void m_read_serial_number(string& serial_number);
-    void m_read_manufacturer(string& manufacturer);
+    void m_perform_sg_io(const struct sysfs_device* device, uint16_t* ata_data);
+    void m_perform_hdio_drive_cmd(const struct sysfs_device* device,
+                                  uint16_t* ata_data);
+    void m_read_ata_string(const uint16_t* ata_data, string& value,
+                           size_t offset, size_t length);
+    void m_read_rpm(const uint16_t* ata_data, uint32_t& rpm);
+    void m_read_serial_number(const uint16_t* ata_data, string& serial_number);
+    void m_read_manufacturer(const uint16_t* ata_data, string& manufacturer);
 
     string m_get_device_path(const struct sysfs_device* device);
 
@@ -357,9 +395,18 @@ private:
     static constexpr uint32_t SECTORS_TO_GB = 2*1024*1024;
     static constexpr const char ROOT_FS[] = "/";
     static constexpr const char BOOT_FS[] = "/boot";
+    static constexpr const char UEVENT_SEQNUM_PATH[] =
+        "/sys/kernel/uevent_seqnum";
+
+    /*! Optional attributes which identify a disk, not only its device node */
+    static constexpr const char* UNIQUE_ID_ATTRIBUTES[] = {
+        "diskseq", "wwid", "device/wwid", "device/serial"
+    };
+
+    /*! Upper bound of threads probing block devices at the same time */
+    static constexpr uint32_t MAX_PROBE_THREADS = 4;
 
     static constexpr uint32_t ATA_DATA_SIZE = 512+4;
-    std::unique_ptr<uint16_t[]> m_hdio_data{};
 };
 
 }
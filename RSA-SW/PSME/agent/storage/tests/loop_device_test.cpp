@@ -0,0 +1,295 @@
+/*!
+ * @section LICENSE
+ *
+ * @copyright
+ * Copyright (c) 2015 Intel Corporation
+ *
+ * @copyright
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * @copyright
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * @copyright
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @section DESCRIPTION
+ *
+ * @file loop_device_test.cpp
+ *
+ * @brief Hard drive and LVM rediscovery against loop devices.
+ *
+ * Tests attach loop devices, so they do nothing unless run as root with
+ * losetup available. LVM tests also need lvm2app and the lvm2 tools.
+ * */
+
+#include "storage_config.hpp"
+#include "discovery/discovery_manager.hpp"
+#include "sysfs/sysfs_api.hpp"
+#include "lvm/lvm_api.hpp"
+
+#include "agent-framework/module/module.hpp"
+#include "agent-framework/module/submodule.hpp"
+#include "agent-framework/module/storage_controller.hpp"
+#include "agent-framework/module/logical_drive.hpp"
+#include "agent-framework/module/target.hpp"
+
+#include "gtest/gtest.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using agent::storage::discovery::DiscoveryManager;
+using agent::storage::sysfs::SysfsAPI;
+using agent::storage::lvm::LvmAPI;
+using agent_framework::generic::Module;
+using agent_framework::generic::Submodule;
+using agent_framework::generic::StorageController;
+using agent_framework::generic::HardDrive;
+using agent_framework::generic::LogicalDrive;
+using agent_framework::generic::Target;
+using agent_framework::generic::EventMsg;
+
+namespace {
+
+using Transition =
+    agent_framework::generic::StateMachineTransition::Transition;
+
+std::string run(const std::string& command) {
+    std::string output{};
+    FILE* pipe = popen(command.c_str(), "r");
+    if (nullptr == pipe) {
+        return output;
+    }
+    char buffer[256];
+    while (nullptr != fgets(buffer, sizeof(buffer), pipe)) {
+        output += buffer;
+    }
+    pclose(pipe);
+    output.erase(output.find_last_not_of(" \n") + 1);
+    return output;
+}
+
+bool has_tool(const std::string& name) {
+    return 0 == std::system(("which " + name + " >/dev/null 2>&1").c_str());
+}
+
+/*! Loop device backed by a sparse file, detached when out of scope */
+class LoopDevice {
+public:
+    explicit LoopDevice(const std::string& size) {
+        char path[] = "/tmp/psme-storage-loop-XXXXXX";
+        const int fd = mkstemp(path);
+        if (0 > fd) {
+            return;
+        }
+        close(fd);
+        m_file = path;
+        run("truncate -s " + size + " " + m_file);
+        m_device = run("losetup -f --show " + m_file + " 2>/dev/null");
+    }
+
+    ~LoopDevice() {
+        detach();
+        if (!m_file.empty()) {
+            unlink(m_file.c_str());
+        }
+    }
+
+    LoopDevice(const LoopDevice&) = delete;
+    LoopDevice& operator=(const LoopDevice&) = delete;
+
+    void detach() {
+        if (!m_device.empty()) {
+            run("losetup -d " + m_device);
+            m_device.clear();
+        }
+    }
+
+    const std::string& get_device() const {
+        return m_device;
+    }
+
+private:
+    std::string m_file{};
+    std::string m_device{};
+};
+
+bool has_hard_drive(const std::string& device_path) {
+    std::vector<SysfsAPI::HardDrive> drives{};
+    SysfsAPI::get_instance()->get_hard_drives(drives);
+    return std::any_of(drives.cbegin(), drives.cend(),
+            [&device_path](const SysfsAPI::HardDrive& drive) {
+                return drive.get_device_path() == device_path;
+            });
+}
+
+bool has_event(const std::vector<EventMsg>& events, const std::string& id,
+               const Transition transition) {
+    return std::any_of(events.cbegin(), events.cend(),
+            [&id, transition](const EventMsg& event) {
+                return event.get_id() == id &&
+                    event.get_transition() == transition;
+            });
+}
+
+HardDrive::HardDriveSharedPtr find_hard_drive(const Submodule& submodule,
+        const std::string& device_path) {
+    for (const auto& drive :
+            submodule.get_storage_controllers().front()->get_hard_drives()) {
+        if (drive->get_device_path() == device_path) {
+            return drive;
+        }
+    }
+    return nullptr;
+}
+
+}
+
+class LoopDeviceTest : public ::testing::Test {
+protected:
+    bool m_enabled{false};
+    Module m_module{};
+
+    virtual void SetUp() {
+        m_enabled = 0 == geteuid() && has_tool("losetup");
+        if (!m_enabled) {
+            std::cout << "Needs root and losetup, test skipped." << std::endl;
+            return;
+        }
+
+        auto submodule = Submodule::make_submodule();
+        submodule->add_storage_controller(
+            StorageController::StorageControllerUniquePtr{
+                new StorageController()});
+        m_module.add_submodule(std::move(submodule));
+        SysfsAPI::get_instance()->set_loop_devices(true);
+    }
+
+    virtual void TearDown() {
+        SysfsAPI::get_instance()->set_loop_devices(false);
+    }
+
+    Submodule& get_submodule() {
+        return *m_module.get_submodules().front();
+    }
+
+    virtual ~LoopDeviceTest();
+};
+
+LoopDeviceTest::~LoopDeviceTest() {}
+
+TEST_F(LoopDeviceTest, LoopDevicesAreReportedOnlyWhenEnabled) {
+    if (!m_enabled) {
+        return;
+    }
+    LoopDevice loop{"64M"};
+    ASSERT_FALSE(loop.get_device().empty());
+
+    EXPECT_TRUE(has_hard_drive(loop.get_device()));
+    SysfsAPI::get_instance()->set_loop_devices(false);
+    EXPECT_FALSE(has_hard_drive(loop.get_device()));
+}
+
+TEST_F(LoopDeviceTest, DetachedLoopDeviceIsDroppedFromModel) {
+    if (!m_enabled) {
+        return;
+    }
+    DiscoveryManager discovery_manager{};
+    std::vector<EventMsg> events{};
+
+    LoopDevice loop{"64M"};
+    ASSERT_FALSE(loop.get_device().empty());
+
+    discovery_manager.rediscover_hard_drives(m_module, events);
+    const auto hard_drive = find_hard_drive(get_submodule(), loop.get_device());
+    ASSERT_NE(nullptr, hard_drive);
+    const auto uuid = hard_drive->get_uuid();
+    EXPECT_TRUE(has_event(events, uuid, Transition::INSERTION));
+
+    // a target and a physical volume referencing the drive must let it go
+    auto target = Target::make_target();
+    target->add_hard_drive(hard_drive);
+    get_submodule().get_target_manager().add_target(target);
+    auto volume_group = LogicalDrive::make_logical_drive();
+    auto physical_volume = LogicalDrive::make_logical_drive();
+    physical_volume->add_hard_drive(hard_drive);
+    volume_group->add_logical_drive(physical_volume);
+    get_submodule().add_logical_drive(volume_group);
+
+    loop.detach();
+    events.clear();
+    discovery_manager.rediscover_hard_drives(m_module, events);
+
+    EXPECT_EQ(nullptr, find_hard_drive(get_submodule(), hard_drive->get_device_path()));
+    EXPECT_TRUE(has_event(events, uuid, Transition::EXTRACTION));
+    EXPECT_TRUE(target->get_hard_drives().empty());
+    EXPECT_TRUE(physical_volume->get_hard_drives().empty());
+}
+
+#ifdef LVM2APP_FOUND
+TEST_F(LoopDeviceTest, LogicalVolumeOnLoopDeviceIsRediscovered) {
+    if (!m_enabled || !has_tool("vgcreate")) {
+        return;
+    }
+    static const std::string VG_NAME{"psme-test-vg"};
+    static const std::string LV_NAME{"psme-test-lv"};
+    DiscoveryManager discovery_manager{};
+    std::vector<EventMsg> events{};
+
+    LoopDevice loop{"64M"};
+    ASSERT_FALSE(loop.get_device().empty());
+    run("vgcreate -q " + VG_NAME + " " + loop.get_device() + " 2>&1");
+    run("lvcreate -q -an -Zn -L 8M -n " + LV_NAME + " " + VG_NAME + " 2>&1");
+    LvmAPI::rescan();
+
+    discovery_manager.rediscover_hard_drives(m_module, events);
+    discovery_manager.rediscover_logical_drives(m_module, events);
+
+    LogicalDrive::LogicalDriveSharedPtr vg_drive{};
+    for (const auto& drive : get_submodule().get_logical_drives()) {
+        if (drive->get_device_path() == "/dev/" + VG_NAME) {
+            vg_drive = drive;
+        }
+    }
+    ASSERT_NE(nullptr, vg_drive);
+
+    const auto& children = vg_drive->get_logical_drives();
+    const auto lv_drive = std::find_if(children.cbegin(), children.cend(),
+            [](const LogicalDrive::LogicalDriveSharedPtr& drive) {
+                return drive->get_device_path() ==
+                    "/dev/" + VG_NAME + "/" + LV_NAME;
+            });
+    ASSERT_NE(children.cend(), lv_drive);
+    const auto lv_uuid = (*lv_drive)->get_uuid();
+    EXPECT_TRUE(std::any_of(children.cbegin(), children.cend(),
+            [&loop](const LogicalDrive::LogicalDriveSharedPtr& drive) {
+                return drive->get_device_path() == loop.get_device() &&
+                    1 == drive->get_hard_drives().size();
+            }));
+
+    LvmAPI lvm_api{};
+    EXPECT_TRUE(lvm_api.remove_logical_volume(VG_NAME.c_str(), LV_NAME.c_str()));
+    LvmAPI::invalidate();
+
+    events.clear();
+    discovery_manager.rediscover_logical_drives(m_module, events);
+    EXPECT_TRUE(has_event(events, lv_uuid, Transition::EXTRACTION));
+
+    run("vgremove -q -f " + VG_NAME + " 2>&1");
+    run("pvremove -q -f " + loop.get_device() + " 2>&1");
+    LvmAPI::rescan();
+}
+#endif
@@ -27,6 +27,8 @@
 #define AGENT_FRAMEWORK_ACTION_TASK_STATUS_MANAGER_HPP
 
 #include <mutex>
+#include <string>
+#include <cstdint>
 #include <unordered_map>
 
 namespace agent_framework {
@@ -71,6 +73,22 @@ public:
      */
     void remove_status(const std::string& uuid);
 
+    /*!
+     * @brief Set progress of running task
+     *
+     * @param uuid Task uuid
+     * @param percent Task progress in percents
+     */
+    void set_progress(const std::string& uuid, const std::uint8_t percent);
+
+    /*!
+     * @brief Get progress of running task
+     *
+     * @param uuid Task uuid
+     * @return Task progress in percents, 0 if task is unknown
+     */
+    std::uint8_t get_progress(const std::string& uuid) const;
+
     /*!
      * @brief Singleton pattern. Return global TaskStatusManager object
      * @return TaskStatusManager object
@@ -94,6 +112,7 @@ private:
 
     mutable std::mutex m_mutex{};
     std::unordered_map<std::string, Status> m_status{};
+    std::unordered_map<std::string, std::uint8_t> m_progress{};
 };
 
 }
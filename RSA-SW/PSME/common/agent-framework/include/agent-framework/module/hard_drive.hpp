@@ -181,6 +181,16 @@ public:
         return m_partitions;
     }
 
+    /*!
+     * @brief Delete hard drive with given UUID from collection of a storage
+     * controller, logical drive or target
+     * @param[in] hard_drives Hard drives collection
+     * @param[in] uuid Hard drive UUID
+     * @return true if deleted successfuly, false otherwise
+     * */
+    static bool delete_from(std::vector<HardDriveSharedPtr>& hard_drives,
+                            const std::string& uuid);
+
     ~HardDrive();
 
 };
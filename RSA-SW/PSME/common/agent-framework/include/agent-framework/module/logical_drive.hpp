@@ -263,6 +263,13 @@ public:
         return m_hard_drives;
     }
 
+    /*!
+     * @brief Delete hard drive with given UUID
+     * @param[in] uuid Hard drive UUID
+     * @return true if deleted successfuly, false otherwise
+     * */
+    bool delete_hard_drive(const std::string& uuid);
+
     /*!
      * @brief Return collection object.
      *
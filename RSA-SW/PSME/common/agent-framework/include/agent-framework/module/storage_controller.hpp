@@ -107,6 +107,13 @@ public:
      * */
     HardDriveWeakPtr find_hard_drive(const string& uuid) const;
 
+    /*!
+     * @brief Delete hard drive with given UUID
+     * @param[in] uuid Hard drive UUID
+     * @return true if deleted successfuly, false otherwise
+     * */
+    bool delete_hard_drive(const string& uuid);
+
     /*!
      * @brief Returns FRUInfo.
      *
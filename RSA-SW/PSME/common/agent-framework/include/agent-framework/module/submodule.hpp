@@ -239,6 +239,13 @@ public:
      * */
     const std::vector<LogicalDriveSharedPtr> get_logical_drives() const;
 
+    /*!
+     * @brief Delete top level logical drive with given UUID
+     * @param[in] uuid Logical drive UUID
+     * @return true if deleted successfuly, false otherwise
+     * */
+    bool delete_logical_drive(const std::string& uuid);
+
     /*!
      * @brief Returns vector of targets.
      *
@@ -281,6 +281,13 @@ public:
         return m_hard_drives;
     }
 
+    /*!
+     * @brief Delete hard drive with given UUID
+     * @param[in] uuid Hard drive UUID
+     * @return true if deleted successfuly, false otherwise
+     * */
+    bool delete_hard_drive(const std::string& uuid);
+
 private:
     Status m_status{};
     LunVec m_target_lun{};
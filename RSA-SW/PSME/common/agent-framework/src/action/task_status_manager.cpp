@@ -59,6 +59,24 @@ void
 TaskStatusManager::remove_status(const std::string& uuid) {
     std::lock_guard<std::mutex> lock{m_mutex};
     m_status.erase(uuid);
+    m_progress.erase(uuid);
+}
+
+void
+TaskStatusManager::set_progress(const std::string& uuid,
+                                const std::uint8_t percent) {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_progress[uuid] = percent;
+}
+
+std::uint8_t
+TaskStatusManager::get_progress(const std::string& uuid) const {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    const auto elem = m_progress.find(uuid);
+    if (elem != m_progress.cend()) {
+        return elem->second;
+    }
+    return 0;
 }
 
 TaskStatusManager& TaskStatusManager::get_instance() {
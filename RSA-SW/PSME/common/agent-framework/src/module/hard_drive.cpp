@@ -25,6 +25,8 @@
 
 #include "agent-framework/module/hard_drive.hpp"
 
+#include <algorithm>
+
 using namespace agent_framework::generic;
 
 namespace {
@@ -57,4 +59,19 @@ void HardDrive::read_configuration(const json::Value& drive_configuration) {
     }
 }
 
+bool HardDrive::delete_from(std::vector<HardDriveSharedPtr>& hard_drives,
+                            const std::string& uuid) {
+
+    auto it = std::remove_if(hard_drives.begin(), hard_drives.end(),
+            [&uuid](HardDriveSharedPtr & hd) {
+                return uuid == hd->get_uuid();
+            });
+
+    bool ret = (it != hard_drives.end());
+
+    hard_drives.erase(it, hard_drives.end());
+
+    return ret;
+}
+
 HardDrive::~HardDrive(){}
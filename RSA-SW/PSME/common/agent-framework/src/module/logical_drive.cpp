@@ -64,3 +64,7 @@ bool LogicalDrive::delete_logical_drive(const std::string& uuid) {
 
     return ret;
 }
+
+bool LogicalDrive::delete_hard_drive(const std::string& uuid) {
+    return HardDrive::delete_from(m_hard_drives, uuid);
+}
@@ -26,6 +26,8 @@
 #include "agent-framework/module/storage_controller.hpp"
 #include "json/json.hpp"
 
+#include <algorithm>
+
 using namespace agent_framework::generic;
 
 void StorageController::read_configuration(const json::Value& controller_configuration) {
@@ -68,3 +70,7 @@ HardDriveWeakPtr StorageController::find_hard_drive(const std::string& uuid) con
     }
     return {};
 }
+
+bool StorageController::delete_hard_drive(const std::string& uuid) {
+    return HardDrive::delete_from(m_hard_drives, uuid);
+}
@@ -224,6 +224,20 @@ const std::vector<LogicalDriveSharedPtr> Submodule::get_logical_drives() const {
     return result;
 }
 
+bool Submodule::delete_logical_drive(const std::string& uuid) {
+
+    auto it = std::remove_if(m_logical_drives.begin(), m_logical_drives.end(),
+            [&uuid](LogicalDriveSharedPtr & ld) {
+                return uuid == ld->get_uuid();
+            });
+
+    bool ret = (it != m_logical_drives.end());
+
+    m_logical_drives.erase(it, m_logical_drives.end());
+
+    return ret;
+}
+
 HardDriveWeakPtr Submodule::find_hard_drive(const std::string& uuid) const {
 
     const auto& storage_controllers = get_storage_controllers();
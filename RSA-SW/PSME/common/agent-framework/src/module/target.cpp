@@ -28,3 +28,7 @@
 using namespace agent_framework::generic;
 
 Target::~Target() {}
+
+bool Target::delete_hard_drive(const std::string& uuid) {
+    return HardDrive::delete_from(m_hard_drives, uuid);
+}
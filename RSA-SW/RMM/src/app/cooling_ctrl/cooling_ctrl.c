@@ -13,8 +13,85 @@
  */
 
 
+#include <time.h>
+
+#include "libjsonrpcapi/libjsonrpcapi.h"
 #include "cooling_ctrl.h"
 
+static char *sample_names[] = {CHASSIS_TEMP_STR, CCTRL_TRAY_PWM_STR};
+
+static unsigned long long now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+static int policy_is(struct cooling_ctrl *ctrl, char *policy)
+{
+	return strncmp(ctrl->policy, policy, strlen(policy)) == 0;
+}
+
+static void load_loop_cfg(struct cooling_ctrl *ctrl)
+{
+	char agg[16] = {0};
+	int kp, ki, kd, target, rate;
+
+	ctrl->period_ms = rmm_cfg_get_cooling_period();
+	if (ctrl->period_ms <= 0)
+		ctrl->period_ms = COOLING_DFLT_PERIOD_MS;
+
+	target = rmm_cfg_get_cooling_target();
+	if (target <= 0)
+		target = COOLING_DFLT_TARGET;
+
+	rate = rmm_cfg_get_cooling_rate();
+	if (rate < 0)
+		rate = COOLING_DFLT_RATE;
+
+	if (rmm_cfg_get_cooling_pid(&kp, &ki, &kd) != 0) {
+		kp = COOLING_DFLT_KP;
+		ki = COOLING_DFLT_KI;
+		kd = COOLING_DFLT_KD;
+	}
+
+	ctrl->agg = COOLING_AGG_MAX;
+	if (rmm_cfg_get_cooling_aggregation(agg, sizeof(agg)) == 0 &&
+		cooling_agg_parse(agg, &ctrl->agg, &ctrl->pct) != 0)
+		rmm_log(ERROR, "unknown aggregation %s, max is used\n", agg);
+
+	cooling_pid_init(&ctrl->pid_cfg, kp, ki, kd, target, rate);
+
+	rmm_log(INFO, "cooling loop every %d ms, target %d, kp %d ki %d kd %d, rate %d\n",
+			ctrl->period_ms, target, kp, ki, kd, rate);
+}
+
+static struct cm_node *add_cm(struct cooling_ctrl *ctrl, memdb_integer node_id)
+{
+	struct cm_node *cm;
+
+	list_for_each_entry(cm, &ctrl->cm_head, list) {
+		if (cm->node_id == node_id) {
+			rmm_log(ERROR, "subcribed already\n");
+			return NULL;
+		}
+	}
+
+	cm = malloc(sizeof(*cm));
+	if (cm == NULL) {
+		rmm_log(ERROR, "cm out of memory\n");
+		return NULL;
+	}
+	bzero(cm, sizeof(*cm));
+	cm->node_id = node_id;
+	cm->output_pwm = -1;
+	cm->pid = ctrl->pid_cfg;
+	list_add_tail(&cm->list, &ctrl->cm_head);
+
+	return cm;
+}
+
 struct cooling_ctrl* cooling_allocate()
 {
 	struct cooling_ctrl *ctrl = (struct cooling_ctrl *)malloc(sizeof(struct cooling_ctrl));
@@ -30,7 +107,10 @@ struct cooling_ctrl* cooling_allocate()
 void cooling_init(struct cooling_ctrl *ctrl)
 {
 	struct cm_attr * attr;
+	struct node_info *subnode;
+	memdb_integer cms[MAX_CM_NUM];
 	char policy[128] = {0};
+	int i, num = 0;
 	libdb_attr_get_string(DB_RMM, MC_TYPE_RMC, COOLING_POLICY, policy, 128, LOCK_ID_NULL);
 
 	if(strlen(policy) == 0) {
@@ -51,6 +131,15 @@ void cooling_init(struct cooling_ctrl *ctrl)
 	INIT_LIST_HEAD(&ctrl->tmc_head);
 	INIT_LIST_HEAD(&ctrl->attr_head);
 
+	load_loop_cfg(ctrl);
+
+	/* the CMs there before the subscription */
+	subnode = libdb_list_subnode_by_type(DB_RMM, MC_TYPE_RMC, MC_TYPE_CM, &num, NULL, LOCK_ID_NULL);
+	for (i = 0; subnode != NULL && i < num && i < MAX_CM_NUM; i++)
+		cms[i] = subnode[i].node_id;
+	for (i = 0; subnode != NULL && i < num && i < MAX_CM_NUM; i++)
+		add_cm(ctrl, cms[i]);
+
 	attr = malloc(sizeof(*attr));
 	if (attr == NULL) {
 		rmm_log(ERROR, "attr out of memory\n");
@@ -76,32 +165,9 @@ static int policy_changed(struct cooling_ctrl *ctrl, struct event_info *evt)
 	return 0;
 }
 
-static void subscribe_attr(struct cooling_ctrl * ctrl, memdb_integer node_id)
-{
-	struct cm_attr  * attr;
-	
-	if (strncmp(ctrl->policy, POLICY_FIXED_PWM_STR, strlen(POLICY_FIXED_PWM_STR)) != 0) {
-		attr = malloc(sizeof(*attr));
-		if (attr == NULL) {
-			rmm_log(ERROR, "attr out of memory\n");
-			return;
-		}
-		if (strncmp(ctrl->policy, POLICY_AGGREGATED_THERMAL_STR, strlen(POLICY_AGGREGATED_THERMAL_STR)) == 0) {
-			attr->prefix_handler = libdb_subscribe_attr_by_prefix(DB_RMM, node_id, CHASSIS_TEMP_STR, LOCK_ID_NULL);
-		}
-		else if (strncmp(ctrl->policy, POLICY_AGGREGATED_PWM_STR, strlen(POLICY_AGGREGATED_PWM_STR)) == 0) {
-			attr->prefix_handler = libdb_subscribe_attr_by_prefix(DB_RMM, node_id, FAN_PWM_STR, LOCK_ID_NULL);
-		}
-
-		attr->node_id = node_id;
-		list_add_tail(&attr->list, &ctrl->attr_head);
-	}
-}
-
 static int node_delete_action(struct event_info *evt, struct cooling_ctrl * ctrl)
 {
 	struct cm_node  * cm;
-	struct cm_attr  * attr;
 	struct tmc_node * tmc;
 	
 	if (evt->ntype == MC_TYPE_CM) {
@@ -122,14 +188,6 @@ static int node_delete_action(struct event_info *evt, struct cooling_ctrl * ctrl
 				break;
 			}
 		}
-		list_for_each_entry(attr, &ctrl->attr_head, list) {
-			if(attr->node_id == evt->nnodeid) {
-				libdb_unsubscribe_event(DB_RMM, attr->prefix_handler, LOCK_ID_NULL);
-				list_del(&attr->list);
-				free(attr);
-				break;
-			}
-		}
 		return 0;
 	}
 	
@@ -138,25 +196,12 @@ static int node_delete_action(struct event_info *evt, struct cooling_ctrl * ctrl
 
 static int node_create_action(struct event_info *evt, struct cooling_ctrl * ctrl)
 {
-	struct cm_node  * cm;
 	struct tmc_node * tmc;
 	
 	if (evt->ntype == MC_TYPE_CM) {
-		list_for_each_entry(cm, &ctrl->cm_head, list) {
-			if (cm->node_id == evt->nnodeid) {
-				rmm_log(ERROR, "subcribed already\n");
-				return -1;
-			}
-		}
-
-		cm = malloc(sizeof(*cm));
-		if (cm == NULL) {
-			rmm_log(ERROR, "cm out of memory\n");
+		if (add_cm(ctrl, evt->nnodeid) == NULL)
 			return -1;
-		}
-		cm->node_id = evt->nnodeid;
-		list_add_tail(&cm->list, &ctrl->cm_head);
-		
+
 		return 0;
 	}
 	else if (evt->ntype == MC_TYPE_DRAWER) {
@@ -175,7 +220,7 @@ static int node_create_action(struct event_info *evt, struct cooling_ctrl * ctrl
 		tmc->node_id = evt->nnodeid;
 		list_add_tail(&tmc->list, &ctrl->tmc_head);
 
-		subscribe_attr(ctrl, evt->nnodeid);
+		/* its readings are sampled with the other trays of its CM */
 		rmm_log(INFO, "current policy is %s\n", ctrl->policy);
 
 		return 0;
@@ -183,49 +228,20 @@ static int node_create_action(struct event_info *evt, struct cooling_ctrl * ctrl
 	return 0;
 }
 
+/*
+ * Only the policy is subscribed, the tray readings are sampled by
+ * cooling_run() for all the trays of a CM at once.
+ */
 static int attr_change_action(struct event_info *evt, struct cooling_ctrl * ctrl)
 {
-	struct tmc_node  * tmc;
-	struct cm_attr  * attr, *attr_policy,*attr_safe;
-	int aggregated_thermal, aggregated_pwm;
-	
-	list_for_each_entry(attr, &ctrl->attr_head, list) {
-		if (attr->node_id == MC_TYPE_RMC && policy_changed(ctrl, evt)) {
-			rmm_log(INFO, "policy changed, new policy is %s\n", ctrl->policy);
-			/* unsubscribe old attribute belong to CM and TMC */
-			list_for_each_entry_safe(attr_policy, attr_safe, &ctrl->attr_head, list) {
-				if (attr_policy->node_id != MC_TYPE_RMC) {
-					libdb_unsubscribe_event(DB_RMM, attr_policy->prefix_handler, LOCK_ID_NULL);
-					list_del(&attr_policy->list);
-					free(attr_policy);
-				}
-			}
-			/* subscribe attribute for new poicy */
-			list_for_each_entry(tmc, &ctrl->tmc_head, list) {
-				subscribe_attr(ctrl, tmc->node_id);
-			}
-			return 0;
-		}
-		else if (attr->node_id == evt->anodeid) {
-			if (strncmp(ctrl->policy, POLICY_AGGREGATED_THERMAL_STR, strlen(POLICY_AGGREGATED_THERMAL_STR)) == 0) {
-				libdb_attr_get_int(DB_RMM, evt->anodeid, CHASSIS_TEMP_STR, &aggregated_thermal, LOCK_ID_NULL);
-
-				if(attr->aggregated_thermal != aggregated_thermal && aggregated_thermal != -1) {
-					rmm_log(INFO, "aggregated_thermal changed from %d to %d on node %lu\n", attr->aggregated_thermal, aggregated_thermal, attr->node_id);
-					attr->aggregated_thermal = aggregated_thermal;
-				}
-			}
-			else if (strncmp(ctrl->policy, POLICY_AGGREGATED_PWM_STR, strlen(POLICY_AGGREGATED_PWM_STR)) == 0) {
-				libdb_attr_get_int(DB_RMM, evt->anodeid, "aggregated_pwm0", &aggregated_pwm, LOCK_ID_NULL);
-				
-				if(attr->aggregated_pwm[0] != aggregated_pwm && aggregated_pwm != -1) {
-					rmm_log(INFO, "aggregated_pwm changed from %d to %d on node %lu\n", attr->aggregated_pwm, aggregated_pwm, attr->node_id);
-					attr->aggregated_pwm[0] = aggregated_pwm;
-				}
-			}
-			return 0;
-		}
+	struct cm_node *cm;
+
+	if (evt->anodeid == MC_TYPE_RMC && policy_changed(ctrl, evt)) {
+		rmm_log(INFO, "policy changed, new policy is %s\n", ctrl->policy);
+		list_for_each_entry(cm, &ctrl->cm_head, list)
+			cooling_pid_reset(&cm->pid);
 	}
+
 	return 0;
 }
 
@@ -249,3 +265,185 @@ void cooling_event_ops(struct event_info *evt, void *cb_data)
 		rmm_log(ERROR, "Unknown event!\n");
 	}
 }
+
+/**
+ * @brief: read the fans of the thermal zone of a CM, and the CM address.
+ */
+static void refresh_fans(struct cm_node *cm)
+{
+	memdb_integer attrs[CMDBUFSIZ/sizeof(long)];
+	char *names[] = {WRAP_LOC_ID_STR};
+	struct node_info *subnode;
+	char *data;
+	int size = sizeof(attrs);
+	int i, num = 0;
+
+	cm->fan_num = 0;
+
+	if (libdb_attr_get_int(DB_RMM, cm->node_id, MBP_IP_ADDR_STR, &cm->host, LOCK_ID_NULL) != 0)
+		return;
+
+	subnode = libdb_list_subnode_by_type(DB_RMM, cm->node_id, MC_TYPE_TZONE, &num, NULL, LOCK_ID_NULL);
+	if (subnode == NULL || num == 0)
+		return;
+	cm->tzone_node_id = subnode[0].node_id;
+
+	subnode = libdb_list_subnode_by_type(DB_RMM, cm->tzone_node_id, MC_TYPE_FAN, &num, NULL, LOCK_ID_NULL);
+	for (i = 0; subnode != NULL && i < num && i < COOLING_FAN_MAX; i++)
+		cm->fan_node_id[i] = subnode[i].node_id;
+	if (subnode == NULL)
+		return;
+	num = i;
+
+	/* the lids of all the fans in one read */
+	if (libdb_attr_get_multi(DB_RMM, cm->tzone_node_id, names, 1, 1, attrs, &size, LOCK_ID_NULL) != 0)
+		return;
+
+	for (i = 0; i < num; i++) {
+		data = libdb_attr_find(attrs, size, cm->fan_node_id[i], WRAP_LOC_ID_STR);
+		if (data == NULL || atoi(data) <= 0)
+			continue;
+
+		cm->fan_node_id[cm->fan_num] = cm->fan_node_id[i];
+		cm->fan_lid[cm->fan_num] = atoi(data);
+		cm->fan_num++;
+	}
+}
+
+/**
+ * @brief: fill the dense arrays of a zone with the temperature and the
+ * PWM asked by each tray of the CM, in one read of the CM subtree.
+ */
+static void sample_zone(struct cm_node *cm)
+{
+	memdb_integer attrs[CMDBUFSIZ/sizeof(long)];
+	struct attr_info *info;
+	int size = sizeof(attrs);
+	int offset, value;
+
+	cm->tray_num = 0;
+	cm->pwm_num = 0;
+
+	if (libdb_attr_get_multi(DB_RMM, cm->node_id, sample_names,
+							 sizeof(sample_names) / sizeof(sample_names[0]), 1,
+							 attrs, &size, LOCK_ID_NULL) != 0)
+		return;
+
+	foreach_attr_info(info, offset, attrs, size) {
+		/* 0 or -1 until the tray reports */
+		value = atoi((char *)attr_data(info));
+		if (info->node == cm->node_id || value <= 0)
+			continue;
+
+		if (strcmp(attr_name(info), CHASSIS_TEMP_STR) == 0) {
+			if (cm->tray_num < COOLING_TRAY_MAX)
+				cm->temp[cm->tray_num++] = value;
+		} else if (cm->pwm_num < COOLING_TRAY_MAX) {
+			cm->pwm[cm->pwm_num++] = value;
+		}
+	}
+}
+
+static int set_pwm_cb(int result, unsigned char *rsp, int rsp_len, void *cb_data)
+{
+	if (result == -1 || rsp[0] != IPMI_CC_OK)
+		rmm_log(ERROR, "set fan pwm fail\n");
+
+	return 0;
+}
+
+/**
+ * @brief: send a new PWM to all the fans of a zone at once, and store it
+ * in memdb in one write.
+ */
+static void write_zone_pwm(struct cm_node *cm, int pwm)
+{
+	struct attr_set_entry entries[COOLING_FAN_MAX];
+	char data[16];
+	struct jipmi_msg req;
+	int i;
+
+	if (pwm == cm->output_pwm || cm->fan_num == 0)
+		return;
+
+	for (i = 0; i < cm->fan_num; i++) {
+		memset(&req, 0, sizeof(req));
+		req.data[0] = cm->fan_lid[i] - 1;
+		req.data[1] = pwm;
+
+		FILL_INT(req.netfn,		IPMI_CM_NETFN);
+		FILL_INT(req.cmd,		SET_DEFAULT_PWM_CMD);
+		FILL_INT(req.data_len,	2);
+
+		libjipmi_rmcp_cmd(cm->host, IPMI_RMCP_PORT, &req, set_pwm_cb, NULL, JIPMI_NON_SYNC);
+	}
+
+	snprintf(data, sizeof(data), "%d", pwm);
+	for (i = 0; i < cm->fan_num; i++) {
+		entries[i].name = FAN_DESIRED_SPD_PWM_STR;
+		entries[i].data = data;
+		entries[i].cookie = 0;
+		entries[i].node = cm->fan_node_id[i];
+	}
+	if (libdb_attr_set_multi(DB_RMM, cm->tzone_node_id, entries, cm->fan_num,
+							 SNAPSHOT_NEED_NOT, LOCK_ID_NULL) == -1)
+		rmm_log(ERROR, "memdb set fan pwm fail\n");
+
+	rmm_log(INFO, "zone of cm %llu: pwm %d to %d\n", cm->node_id, cm->output_pwm, pwm);
+	cm->output_pwm = pwm;
+}
+
+static void run_zone(struct cooling_ctrl *ctrl, struct cm_node *cm, double dt)
+{
+	int scratch[COOLING_TRAY_MAX];
+	int value, pwm;
+
+	/* pick up fans added or removed, and send the PWM again */
+	if (cm->refresh-- <= 0) {
+		refresh_fans(cm);
+		cm->refresh = COOLING_FAN_REFRESH;
+		cm->output_pwm = -1;
+	}
+
+	sample_zone(cm);
+
+	if (policy_is(ctrl, POLICY_AGGREGATED_PWM_STR)) {
+		value = cooling_aggregate(ctrl->agg, ctrl->pct, cm->pwm, cm->pwm_num, scratch);
+		if (value < 0)
+			return;
+		pwm = cooling_pid_follow(&cm->pid, value, dt);
+	} else {
+		value = cooling_aggregate(ctrl->agg, ctrl->pct, cm->temp, cm->tray_num, scratch);
+		if (value < 0)
+			return;
+		pwm = cooling_pid_step(&cm->pid, value, dt);
+	}
+
+	write_zone_pwm(cm, pwm);
+}
+
+/**
+ * @brief: run the control loop of all the zones if a period is over.
+ * Return the time to the next period in ms.
+ */
+int cooling_run(struct cooling_ctrl *ctrl)
+{
+	struct cm_node *cm;
+	unsigned long long now = now_ms();
+	double dt;
+
+	if (now < ctrl->next_ms)
+		return (int)(ctrl->next_ms - now);
+
+	dt = ctrl->last_ms ? (now - ctrl->last_ms) / 1000.0 : ctrl->period_ms / 1000.0;
+	ctrl->last_ms = now;
+	ctrl->next_ms = now + ctrl->period_ms;
+
+	if (policy_is(ctrl, POLICY_FIXED_PWM_STR))
+		return ctrl->period_ms;
+
+	list_for_each_entry(cm, &ctrl->cm_head, list)
+		run_zone(ctrl, cm, dt);
+
+	return ctrl->period_ms;
+}
@@ -26,6 +26,8 @@
 #include "librmmlog/rmmlog.h"
 #include "libmemdb/memdb.h"
 #include "libutils/string.h"
+#include "libwrap/wrap.h"
+#include "cooling_pid.h"
 
 #define ASSET_MON_DEBUG 1
 #define ASSET_MON_INFO  1
@@ -46,6 +48,7 @@
 #define CCTRL_SHELF_PRESENT_STR   "shelf_present"
 #define CCTRL_CM_THERMAL_STR      "cm-thermal"
 #define CCTRL_TMC_THERMAL_STR     "tmc-thermal"
+#define CCTRL_TRAY_PWM_STR        "aggregated_pwm0"
 
 
 #define COOLING_POLICY            "cooling_policy"
@@ -60,10 +63,30 @@
 #define DEFAULT_FAN_PRESENT        0x01
 #define DEFAULT_SHELF_PRESENT      0x03
 
+#define COOLING_FAN_MAX            16
+#define COOLING_FAN_REFRESH        30	/* samples between two reads of the fans */
+
+/*
+ * A CM and its thermal zone: the readings of the trays of the CM in dense
+ * arrays, refilled at each sample, and the PID driving the fans.
+ */
 struct cm_node {
 	struct list_head list;
 	memdb_integer node_id;
-	int output_pwm;
+	int output_pwm;				/* last PWM sent to the fans, -1 for none */
+
+	int host;
+	memdb_integer tzone_node_id;
+	int fan_num;
+	memdb_integer fan_node_id[COOLING_FAN_MAX];
+	int fan_lid[COOLING_FAN_MAX];
+	int refresh;				/* samples before the fans are read again */
+
+	int tray_num;
+	int temp[COOLING_TRAY_MAX];
+	int pwm_num;
+	int pwm[COOLING_TRAY_MAX];
+	struct cooling_pid pid;
 };
 
 struct tmc_node {
@@ -90,6 +113,13 @@ struct cooling_ctrl {
 	
 	memdb_integer tmc_create_handler;
 	memdb_integer tmc_delete_handler;
+
+	int period_ms;
+	int agg;
+	int pct;
+	struct cooling_pid pid_cfg;	/* copied in each new zone */
+	unsigned long long last_ms;
+	unsigned long long next_ms;
 };
 
 enum cooling_policy {
@@ -101,5 +131,6 @@ enum cooling_policy {
 struct cooling_ctrl* cooling_allocate();
 void cooling_init(struct cooling_ctrl *ctrl);
 void cooling_event_ops(struct event_info *evt, void *cb_data);
+int cooling_run(struct cooling_ctrl *ctrl);
 
 #endif /* ifndef __COOLING_CONTRL_H__ */
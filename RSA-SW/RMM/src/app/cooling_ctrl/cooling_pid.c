@@ -0,0 +1,202 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cooling_pid.h"
+
+int cooling_agg_parse(const char *name, int *agg, int *pct)
+{
+	char *end = NULL;
+	long value;
+
+	if (strcmp(name, "max") == 0) {
+		*agg = COOLING_AGG_MAX;
+		return 0;
+	}
+
+	if (strcmp(name, "avg") == 0) {
+		*agg = COOLING_AGG_AVG;
+		return 0;
+	}
+
+	if (name[0] == 'p') {
+		value = strtol(name + 1, &end, 10);
+		if (end != name + 1 && *end == '\0' && value >= 0 && value <= 100) {
+			*agg = COOLING_AGG_PCT;
+			*pct = (int)value;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * The loops below have no early exit and no branch in their body, the
+ * compiler turns them into vector max/add over the dense arrays.
+ */
+static int agg_max(const int *v, int n)
+{
+	int max = v[0];
+	int i;
+
+	for (i = 1; i < n; i++)
+		max = v[i] > max ? v[i] : max;
+
+	return max;
+}
+
+static int agg_avg(const int *v, int n)
+{
+	long long sum = 0;
+	int i;
+
+	for (i = 0; i < n; i++)
+		sum += v[i];
+
+	return (int)(sum / n);
+}
+
+/* nearest rank, a zone has a few dozens of trays so a sort is cheap */
+static int agg_pct(const int *v, int n, int pct, int *scratch)
+{
+	int i, j, tmp, rank;
+
+	memcpy(scratch, v, n * sizeof(int));
+	for (i = 1; i < n; i++) {
+		tmp = scratch[i];
+		for (j = i; j > 0 && scratch[j - 1] > tmp; j--)
+			scratch[j] = scratch[j - 1];
+		scratch[j] = tmp;
+	}
+
+	rank = (pct * n + 99) / 100;
+	if (rank < 1)
+		rank = 1;
+
+	return scratch[rank - 1];
+}
+
+int cooling_aggregate(int agg, int pct, const int *v, int n, int *scratch)
+{
+	if (n <= 0)
+		return -1;
+
+	switch (agg) {
+	case COOLING_AGG_AVG:
+		return agg_avg(v, n);
+	case COOLING_AGG_PCT:
+		return agg_pct(v, n, pct, scratch);
+	default:
+		return agg_max(v, n);
+	}
+}
+
+void cooling_pid_init(struct cooling_pid *pid, int kp, int ki, int kd,
+					  int target, int rate)
+{
+	memset(pid, 0, sizeof(*pid));
+	pid->kp = kp / 1000.0;
+	pid->ki = ki / 1000.0;
+	pid->kd = kd / 1000.0;
+	pid->target = target;
+	pid->rate = rate;
+	pid->out_min = COOLING_PWM_MIN;
+	pid->out_max = COOLING_PWM_MAX;
+	cooling_pid_reset(pid);
+}
+
+void cooling_pid_reset(struct cooling_pid *pid)
+{
+	pid->integral = pid->out_min;
+	pid->prev = 0;
+	pid->output = pid->out_min;
+	pid->primed = 0;
+}
+
+static double clamp(double value, double min, double max)
+{
+	if (value < min)
+		return min;
+	if (value > max)
+		return max;
+	return value;
+}
+
+static int limit_output(struct cooling_pid *pid, double output, double dt)
+{
+	double step;
+
+	output = clamp(output, pid->out_min, pid->out_max);
+
+	/* the first output is not limited, the fans start where they must */
+	if (pid->primed && pid->rate > 0) {
+		step = pid->rate * dt;
+		output = clamp(output, pid->output - step, pid->output + step);
+	}
+
+	pid->output = output;
+	return (int)(output + 0.5);
+}
+
+int cooling_pid_step(struct cooling_pid *pid, double measure, double dt)
+{
+	double error, integral, derivative = 0, output;
+	int rc;
+
+	if (dt <= 0)
+		dt = 1;
+
+	/* positive when too hot, the fans must speed up */
+	error = measure - pid->target;
+
+	/* on the measure, not on the error, no kick when the target changes */
+	if (pid->primed)
+		derivative = pid->kd * (measure - pid->prev) / dt;
+
+	/*
+	 * Anti-windup: do not integrate further while the output is saturated
+	 * in the direction of the error, and keep the integral term itself in
+	 * the output range.
+	 */
+	integral = pid->integral + pid->ki * error * dt;
+	output = pid->kp * error + integral + derivative;
+	if ((output > pid->out_max && error > 0) || (output < pid->out_min && error < 0))
+		integral = pid->integral;
+	pid->integral = clamp(integral, pid->out_min, pid->out_max);
+
+	output = pid->kp * error + pid->integral + derivative;
+	rc = limit_output(pid, output, dt);
+
+	pid->prev = measure;
+	pid->primed = 1;
+
+	return rc;
+}
+
+int cooling_pid_follow(struct cooling_pid *pid, double target, double dt)
+{
+	int rc;
+
+	if (dt <= 0)
+		dt = 1;
+
+	rc = limit_output(pid, target, dt);
+	pid->primed = 1;
+
+	return rc;
+}
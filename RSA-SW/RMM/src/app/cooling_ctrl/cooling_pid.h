@@ -0,0 +1,88 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __COOLING_PID_H__
+#define __COOLING_PID_H__
+
+/*
+ * The control loop of a thermal zone, without any memdb or IPMI access so
+ * that coolingsim replays recorded traces through the very same code.
+ *
+ * The tray readings of a zone are kept in dense int arrays and reduced to
+ * one value (max, average or a percentile), then a PID turns the distance
+ * to the target temperature into the PWM of the fans of the zone.
+ */
+#define COOLING_TRAY_MAX		64
+
+/* gains are in thousandths, kp 4000 is 4 PWM % per degree over the target */
+#define COOLING_DFLT_PERIOD_MS	2000
+#define COOLING_DFLT_TARGET		45
+#define COOLING_DFLT_KP			4000
+#define COOLING_DFLT_KI			200
+#define COOLING_DFLT_KD			1000
+#define COOLING_DFLT_RATE		10		/* PWM % per second */
+#define COOLING_PWM_MIN			20
+#define COOLING_PWM_MAX			100
+
+enum cooling_agg {
+	COOLING_AGG_MAX = 0,
+	COOLING_AGG_AVG,
+	COOLING_AGG_PCT,
+};
+
+struct cooling_pid {
+	double kp;
+	double ki;
+	double kd;
+	double target;
+	double out_min;
+	double out_max;
+	double rate;			/* max output change per second, 0 for none */
+
+	double integral;
+	double prev;			/* previous measure */
+	double output;
+	int primed;
+};
+
+/**
+ * @brief: parse an aggregation name, "max", "avg" or "pNN" (p90 is the
+ * 90th percentile). Return -1 if unknown.
+ */
+extern int cooling_agg_parse(const char *name, int *agg, int *pct);
+
+/**
+ * @brief: reduce 'n' readings to one value, 'scratch' holds 'n' ints for
+ * the percentile. Return -1 if 'n' is 0.
+ */
+extern int cooling_aggregate(int agg, int pct, const int *v, int n, int *scratch);
+
+extern void cooling_pid_init(struct cooling_pid *pid, int kp, int ki, int kd,
+							 int target, int rate);
+extern void cooling_pid_reset(struct cooling_pid *pid);
+
+/**
+ * @brief: run the PID for a new measure, 'dt' seconds after the last one.
+ * Return the new output, clamped and rate limited.
+ */
+extern int cooling_pid_step(struct cooling_pid *pid, double measure, double dt);
+
+/**
+ * @brief: move the output toward 'target' as fast as the rate limit allows,
+ * for the policies without a PID. Return the new output.
+ */
+extern int cooling_pid_follow(struct cooling_pid *pid, double target, double dt);
+
+#endif
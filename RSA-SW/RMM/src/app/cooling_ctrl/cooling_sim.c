@@ -0,0 +1,197 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cooling_pid.h"
+
+/*
+ * Replay a recorded trace of tray temperatures through the control loop
+ * of coolingctrl, to tune the gains and the aggregation offline. A line
+ * of the trace is a sample of a zone, '#' starts a comment:
+ *
+ *     <time in ms> <zone> <tray temperature> [<tray temperature> ...]
+ *
+ * Each sample prints the aggregated temperature and the PWM of the zone,
+ * a summary per zone follows.
+ *
+ *     coolingsim [-a max|avg|pNN] [-t target] [-k kp,ki,kd] [-r rate] [-q] [trace]
+ */
+#define SIM_ZONE_MAX		32
+#define SIM_LINE_LEN		4096
+
+struct sim_zone {
+	int id;
+	long long last_ms;
+	struct cooling_pid pid;
+
+	unsigned long samples;
+	unsigned long writes;		/* samples that changed the PWM */
+	int last_pwm;
+	int max_temp;
+	double pwm_sum;
+	double over_s;				/* time above the target */
+};
+
+static void usage(char *name)
+{
+	printf("usage: %s [-a max|avg|pNN] [-t target] [-k kp,ki,kd] [-r rate] [-q] [trace]\n", name);
+	printf("       gains in thousandths, rate in PWM %% per second\n");
+	exit(-1);
+}
+
+static struct sim_zone *find_zone(struct sim_zone *zones, int *num, int id,
+								  struct cooling_pid *pid_cfg)
+{
+	int i;
+
+	for (i = 0; i < *num; i++) {
+		if (zones[i].id == id)
+			return &zones[i];
+	}
+
+	if (*num == SIM_ZONE_MAX)
+		return NULL;
+
+	memset(&zones[*num], 0, sizeof(zones[0]));
+	zones[*num].id = id;
+	zones[*num].last_ms = -1;
+	zones[*num].last_pwm = -1;
+	zones[*num].pid = *pid_cfg;
+	return &zones[(*num)++];
+}
+
+int main(int argc, char **argv)
+{
+	static struct sim_zone zones[SIM_ZONE_MAX];
+	struct cooling_pid pid_cfg;
+	struct sim_zone *zone;
+	char line[SIM_LINE_LEN];
+	char *p, *end;
+	int temp[COOLING_TRAY_MAX];
+	int scratch[COOLING_TRAY_MAX];
+	int agg = COOLING_AGG_MAX, pct = 0;
+	int kp = COOLING_DFLT_KP, ki = COOLING_DFLT_KI, kd = COOLING_DFLT_KD;
+	int target = COOLING_DFLT_TARGET, rate = COOLING_DFLT_RATE;
+	int quiet = 0, zone_num = 0, line_num = 0;
+	int opt, id, n, value, pwm, i;
+	long long ms;
+	double dt;
+	FILE *trace = stdin;
+
+	while ((opt = getopt(argc, argv, "a:t:k:r:q")) != -1) {
+		switch (opt) {
+		case 'a':
+			if (cooling_agg_parse(optarg, &agg, &pct) != 0)
+				usage(argv[0]);
+			break;
+		case 't':
+			target = atoi(optarg);
+			break;
+		case 'k':
+			if (sscanf(optarg, "%d,%d,%d", &kp, &ki, &kd) != 3)
+				usage(argv[0]);
+			break;
+		case 'r':
+			rate = atoi(optarg);
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (optind < argc) {
+		trace = fopen(argv[optind], "r");
+		if (trace == NULL) {
+			perror(argv[optind]);
+			return -1;
+		}
+	}
+
+	cooling_pid_init(&pid_cfg, kp, ki, kd, target, rate);
+
+	if (!quiet)
+		printf("# ms zone trays temp pwm\n");
+
+	while (fgets(line, sizeof(line), trace) != NULL) {
+		line_num++;
+		p = strchr(line, '#');
+		if (p != NULL)
+			*p = '\0';
+
+		ms = strtoll(line, &end, 10);
+		if (end == line)
+			continue;
+
+		p = end;
+		id = (int)strtol(p, &end, 10);
+		if (end == p) {
+			printf("line %d: no zone\n", line_num);
+			return -1;
+		}
+
+		for (n = 0, p = end; n < COOLING_TRAY_MAX; n++, p = end) {
+			value = (int)strtol(p, &end, 10);
+			if (end == p)
+				break;
+			temp[n] = value;
+		}
+
+		zone = find_zone(zones, &zone_num, id, &pid_cfg);
+		if (zone == NULL) {
+			printf("line %d: more than %d zones\n", line_num, SIM_ZONE_MAX);
+			return -1;
+		}
+
+		value = cooling_aggregate(agg, pct, temp, n, scratch);
+		if (value < 0)
+			continue;
+
+		dt = zone->last_ms < 0 ? 0 : (ms - zone->last_ms) / 1000.0;
+		pwm = cooling_pid_step(&zone->pid, value, dt);
+
+		if (zone->last_ms >= 0 && value > target)
+			zone->over_s += dt;
+		zone->last_ms = ms;
+		zone->samples++;
+		zone->pwm_sum += pwm;
+		if (value > zone->max_temp)
+			zone->max_temp = value;
+		if (pwm != zone->last_pwm)
+			zone->writes++;
+		zone->last_pwm = pwm;
+
+		if (!quiet)
+			printf("%lld %d %d %d %d\n", ms, id, n, value, pwm);
+	}
+
+	printf("# zone samples max_temp over_target_s avg_pwm pwm_writes\n");
+	for (i = 0; i < zone_num; i++) {
+		zone = &zones[i];
+		printf("# %d %lu %d %.1f %.1f %lu\n", zone->id, zone->samples, zone->max_temp,
+			   zone->over_s, zone->samples ? zone->pwm_sum / zone->samples : 0, zone->writes);
+	}
+
+	if (trace != stdin)
+		fclose(trace);
+
+	return 0;
+}
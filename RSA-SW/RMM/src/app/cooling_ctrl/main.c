@@ -26,7 +26,9 @@ int main()
 {
 	int rc;
 	int max_fd;
+	int timeout_ms;
 	fd_set rfds;
+	struct timeval tv;
 	struct cooling_ctrl *ctrl;
 	int port;
 
@@ -51,12 +53,16 @@ int main()
 	rmm_log(INFO, "cooling ctrl default init success!\n");
 
 	for (;;) {
+		timeout_ms = cooling_run(ctrl);
+		tv.tv_sec = timeout_ms / 1000;
+		tv.tv_usec = (timeout_ms % 1000) * 1000;
+
 		max_fd = -1;
 		FD_ZERO(&rfds);
 
 		libjsonrpcapi_callback_selectfds(&rfds, &max_fd);
 
-		rc = select(max_fd + 1, &rfds, NULL, NULL, NULL);
+		rc = select(max_fd + 1, &rfds, NULL, NULL, &tv);
 		if (rc <= 0)
 			continue;
 
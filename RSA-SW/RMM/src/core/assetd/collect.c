@@ -0,0 +1,604 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+
+#include "libassetd/assetd_jrpc_def.h"
+#include "libjsonrpcapi/libjsonrpcapi.h"
+#include "libjipmi/libjipmi.h"
+#include "libjipmi/common.h"
+#include "libmemdb/memdb.h"
+#include "librmmlog/rmmlog.h"
+#include "librmmcfg/rmm_cfg.h"
+#include "libwrap/wrap.h"
+#include "libutils/rack.h"
+#include "libutils/rmm.h"
+#include "collect.h"
+
+/*
+ * A round collects all the sensors of a zone, the fans of a thermal zone or
+ * the PSUs of a power zone: the IPMI commands of every sensor are sent to
+ * the CM of the zone at once, and the callback of the last response stores
+ * all the values in one memdb write. Rounds of several zones, so of
+ * several CMs, run at the same time. The rounds run on request, and every
+ * CollectInterval seconds, with some jitter not to hit all the CMs in
+ * step with other pollers.
+ */
+#define COLLECT_ZONE_MAX		32
+#define COLLECT_SENSOR_MAX		64		/* commands of a round */
+#define COLLECT_TIMEOUT_MS		2000
+#define COLLECT_JITTER			10		/* percent of the interval */
+#define COLLECT_REPORT_MS		60000	/* log the zone metrics that often */
+#define COLLECT_VALUE_LEN		16
+
+struct collect_sensor {
+	int cmd;
+	int data_len;
+	unsigned char op;		/* PSU_READ_WORD for the PSU commands */
+	unsigned char reg;		/* PMBus command */
+	char *attr;
+	int (*decode)(unsigned char *rsp, int rsp_len, int *value);
+};
+
+struct collect_zone {
+	memdb_integer node_id;	/* 0 if the slot is free */
+	int requested;
+	int busy;				/* a round is in flight */
+
+	unsigned long rounds;
+	unsigned long sensors;
+	unsigned long failures;
+	unsigned long long total_ms;
+	unsigned int last_ms;
+	unsigned int max_ms;
+	unsigned int last_sensors;
+	unsigned long period_sensors;	/* since the last report */
+};
+
+struct collect_round;
+
+struct collect_cmd {
+	struct collect_round *round;
+	struct collect_sensor *sensor;
+	memdb_integer node_id;
+	int lid;
+	int ok;
+	int value;
+};
+
+struct collect_round {
+	struct collect_zone *zone;
+	struct timespec start;
+	int num;
+	int pending;			/* responses still to come */
+	struct collect_cmd cmds[COLLECT_SENSOR_MAX];
+};
+
+static int decode_byte(unsigned char *rsp, int rsp_len, int *value);
+static int decode_word(unsigned char *rsp, int rsp_len, int *value);
+static int decode_linear11(unsigned char *rsp, int rsp_len, int *value);
+
+static struct collect_sensor fan_sensors[] = {
+	{FAN_TACH_METER_CMD,	1, 0, 0, FAN_TACH_READ_STR,			decode_word},
+	{GET_FAN_PWM_CMD,		1, 0, 0, FAN_DESIRED_SPD_PWM_STR,	decode_byte},
+};
+
+static struct collect_sensor psu_sensors[] = {
+	{SEND_PSU_CMD,	3, PSU_READ_WORD, POWER_IN_CMD,		PSU_TT_PWR_IN_STR,		decode_linear11},
+	{SEND_PSU_CMD,	3, PSU_READ_WORD, CURRENT_OUT_CMD,	PSU_TT_CURRENT_OUT_STR,	decode_linear11},
+};
+
+static pthread_mutex_t collect_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t collect_cond;
+static struct collect_zone zones[COLLECT_ZONE_MAX];
+static int collect_all;
+static int collect_kick;	/* a request came since the last scan */
+static int collect_interval_ms;
+
+
+static unsigned long long now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+static int decode_byte(unsigned char *rsp, int rsp_len, int *value)
+{
+	if (rsp_len < 2)
+		return -1;
+
+	*value = rsp[1];
+	return 0;
+}
+
+static int decode_word(unsigned char *rsp, int rsp_len, int *value)
+{
+	if (rsp_len < 3)
+		return -1;
+
+	*value = rsp[1] | (rsp[2] << 8);
+	return 0;
+}
+
+/**
+ * @brief: PMBus LINEAR11, a 5 bit exponent and a 11 bit mantissa, both
+ * signed.
+ */
+static int decode_linear11(unsigned char *rsp, int rsp_len, int *value)
+{
+	int word, mantissa, exponent;
+
+	if (rsp_len < 3)
+		return -1;
+
+	word = rsp[1] | (rsp[2] << 8);
+	mantissa = word & 0x7FF;
+	if (mantissa & 0x400)
+		mantissa -= 0x800;
+	exponent = (word >> 11) & 0x1F;
+	if (exponent & 0x10)
+		exponent -= 0x20;
+
+	if (exponent >= 0)
+		*value = mantissa * (1 << exponent);
+	else
+		*value = mantissa / (1 << -exponent);
+
+	return 0;
+}
+
+/* collect_mutex held */
+static struct collect_zone *find_zone(memdb_integer node_id)
+{
+	int i;
+
+	for (i = 0; i < COLLECT_ZONE_MAX; i++) {
+		if (zones[i].node_id == node_id)
+			return &zones[i];
+	}
+
+	return NULL;
+}
+
+/* collect_mutex held */
+static struct collect_zone *add_zone(memdb_integer node_id)
+{
+	struct collect_zone *zone = find_zone(node_id);
+
+	if (zone != NULL)
+		return zone;
+
+	zone = find_zone(0);
+	if (zone == NULL)
+		return NULL;
+
+	memset(zone, 0, sizeof(*zone));
+	zone->node_id = node_id;
+	return zone;
+}
+
+/**
+ * @brief: store the values of a round in one memdb write, and account it
+ * to its zone.
+ */
+static void collect_done(struct collect_round *round)
+{
+	struct attr_set_entry entries[COLLECT_SENSOR_MAX];
+	char values[COLLECT_SENSOR_MAX][COLLECT_VALUE_LEN];
+	struct collect_zone *zone = round->zone;
+	struct collect_cmd *cmd;
+	struct timespec end;
+	unsigned int ms;
+	int i, count = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	ms = (end.tv_sec - round->start.tv_sec) * 1000 +
+		 (end.tv_nsec - round->start.tv_nsec) / 1000000;
+
+	for (i = 0; i < round->num; i++) {
+		cmd = &round->cmds[i];
+		if (!cmd->ok)
+			continue;
+
+		snprintf(values[count], COLLECT_VALUE_LEN, "%d", cmd->value);
+		entries[count].name = cmd->sensor->attr;
+		entries[count].data = values[count];
+		entries[count].cookie = 0;
+		entries[count].node = cmd->node_id;
+		count++;
+	}
+
+	if (count > 0 &&
+		libdb_attr_set_multi(DB_RMM, zone->node_id, entries, count,
+							 SNAPSHOT_NEED_NOT, LOCK_ID_NULL) == -1) {
+		rmm_log(ERROR, "memdb set sensors of zone %llu fail\n", zone->node_id);
+		count = 0;
+	}
+
+	pthread_mutex_lock(&collect_mutex);
+	zone->rounds++;
+	zone->sensors += count;
+	zone->failures += round->num - count;
+	zone->total_ms += ms;
+	zone->last_ms = ms;
+	if (ms > zone->max_ms)
+		zone->max_ms = ms;
+	zone->last_sensors = count;
+	zone->period_sensors += count;
+	zone->busy = 0;
+	pthread_mutex_unlock(&collect_mutex);
+
+	free(round);
+}
+
+static int collect_cb(int result, unsigned char *rsp, int rsp_len, void *cb_arg)
+{
+	struct collect_cmd *cmd = (struct collect_cmd *)cb_arg;
+	struct collect_round *round = cmd->round;
+	int last;
+
+	if (result != -1 && rsp_len > 0 && rsp[0] == IPMI_CC_OK &&
+		cmd->sensor->decode(rsp, rsp_len, &cmd->value) == 0)
+		cmd->ok = 1;
+
+	/* the timeouts may call back from another thread */
+	pthread_mutex_lock(&collect_mutex);
+	last = (--round->pending == 0);
+	pthread_mutex_unlock(&collect_mutex);
+
+	if (last)
+		collect_done(round);
+
+	return 0;
+}
+
+/**
+ * @brief: send the commands of all the sensors of a zone. The node and the
+ * list returned by libdb are in buffers of the collect thread, the handlers
+ * running meanwhile do not overwrite them.
+ */
+static int collect_start(struct collect_zone *zone)
+{
+	struct collect_round *round;
+	struct collect_sensor *sensors;
+	struct collect_cmd *cmd;
+	struct node_info *info;
+	struct node_info *subnode;
+	struct jipmi_msg req;
+	memdb_integer cm_node_id;
+	int sensor_num, sub_type, num = 0, host = 0;
+	int i, j;
+
+	info = libdb_get_node_by_node_id(DB_RMM, zone->node_id, LOCK_ID_NULL);
+	if (info == NULL)
+		return -1;
+
+	if (info->type == MC_TYPE_TZONE) {
+		sensors = fan_sensors;
+		sensor_num = sizeof(fan_sensors) / sizeof(fan_sensors[0]);
+		sub_type = MC_TYPE_FAN;
+	} else if (info->type == MC_TYPE_PZONE) {
+		sensors = psu_sensors;
+		sensor_num = sizeof(psu_sensors) / sizeof(psu_sensors[0]);
+		sub_type = MC_TYPE_PSU;
+	} else {
+		return -1;
+	}
+	cm_node_id = info->parent;
+
+	if (libdb_attr_get_int(DB_RMM, cm_node_id, MBP_IP_ADDR_STR, &host, LOCK_ID_NULL) != 0)
+		return -1;
+
+	round = (struct collect_round *)malloc(sizeof(struct collect_round));
+	if (round == NULL)
+		return -1;
+	memset(round, 0, sizeof(struct collect_round));
+	round->zone = zone;
+
+	subnode = libdb_list_subnode_by_type(DB_RMM, zone->node_id, sub_type, &num, NULL, LOCK_ID_NULL);
+	for (i = 0; subnode != NULL && i < num; i++) {
+		for (j = 0; j < sensor_num && round->num < COLLECT_SENSOR_MAX; j++) {
+			cmd = &round->cmds[round->num++];
+			cmd->round = round;
+			cmd->sensor = &sensors[j];
+			cmd->node_id = subnode[i].node_id;
+		}
+	}
+
+	/* the lid of each item, after the list buffer is not needed anymore */
+	for (i = 0; i < round->num; i++) {
+		cmd = &round->cmds[i];
+		if (i > 0 && cmd->node_id == round->cmds[i - 1].node_id)
+			cmd->lid = round->cmds[i - 1].lid;
+		else
+			libdb_attr_get_int(DB_RMM, cmd->node_id, WRAP_LOC_ID_STR, &cmd->lid, LOCK_ID_NULL);
+	}
+
+	if (round->num == 0) {
+		free(round);
+		return 0;
+	}
+
+	pthread_mutex_lock(&collect_mutex);
+	zone->busy = 1;
+	round->pending = round->num;
+	pthread_mutex_unlock(&collect_mutex);
+
+	/* every command calls back, on its response or on its timeout */
+	clock_gettime(CLOCK_MONOTONIC, &round->start);
+	num = round->num;
+	for (i = 0; i < num; i++) {
+		cmd = &round->cmds[i];
+
+		memset(&req, 0, sizeof(req));
+		req.data[0] = cmd->lid - 1;
+		req.data[1] = cmd->sensor->op;
+		req.data[2] = cmd->sensor->reg;
+
+		FILL_INT(req.netfn,		IPMI_CM_NETFN);
+		FILL_INT(req.cmd,		cmd->sensor->cmd);
+		FILL_INT(req.data_len,	cmd->sensor->data_len);
+
+		libjipmi_rmcp_cmd_timeout(host, IPMI_RMCP_PORT, &req, collect_cb, cmd,
+								  COLLECT_TIMEOUT_MS, JIPMI_NON_SYNC);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief: list the thermal and power zones of all the CMs, keep the
+ * metrics of the zones still there.
+ */
+static void refresh_zones(void)
+{
+	memdb_integer found[COLLECT_ZONE_MAX];
+	memdb_integer cms[MAX_CM_NUM];
+	struct node_info *subnode;
+	int types[] = {MC_TYPE_TZONE, MC_TYPE_PZONE};
+	int cm_num = 0, found_num = 0, num = 0;
+	int i, j, k;
+
+	subnode = libdb_list_subnode_by_type(DB_RMM, MC_TYPE_RMC, MC_TYPE_CM, &num, NULL, LOCK_ID_NULL);
+	for (i = 0; subnode != NULL && i < num && cm_num < MAX_CM_NUM; i++)
+		cms[cm_num++] = subnode[i].node_id;
+
+	for (i = 0; i < cm_num; i++) {
+		for (j = 0; j < sizeof(types) / sizeof(types[0]); j++) {
+			subnode = libdb_list_subnode_by_type(DB_RMM, cms[i], types[j], &num, NULL, LOCK_ID_NULL);
+			for (k = 0; subnode != NULL && k < num && found_num < COLLECT_ZONE_MAX; k++)
+				found[found_num++] = subnode[k].node_id;
+		}
+	}
+
+	pthread_mutex_lock(&collect_mutex);
+	for (i = 0; i < COLLECT_ZONE_MAX; i++) {
+		if (zones[i].node_id == 0 || zones[i].busy)
+			continue;
+
+		for (k = 0; k < found_num; k++) {
+			if (found[k] == zones[i].node_id)
+				break;
+		}
+		if (k == found_num)
+			zones[i].node_id = 0;
+	}
+
+	for (k = 0; k < found_num; k++) {
+		if (add_zone(found[k]) == NULL)
+			rmm_log(ERROR, "too many zones to collect, zone %llu skipped\n", found[k]);
+	}
+	pthread_mutex_unlock(&collect_mutex);
+}
+
+/* collect_mutex held */
+static void report_zones(unsigned long long period_ms)
+{
+	struct collect_zone *zone;
+	int i;
+
+	for (i = 0; i < COLLECT_ZONE_MAX; i++) {
+		zone = &zones[i];
+		if (zone->node_id == 0 || zone->rounds == 0)
+			continue;
+
+		rmm_log(INFO, "zone %llu: %lu rounds, %lu sensors/s, latency last %u avg %llu max %u ms, "
+				"%lu failures\n", zone->node_id, zone->rounds,
+				(unsigned long)(zone->period_sensors * 1000 / period_ms), zone->last_ms,
+				zone->total_ms / zone->rounds, zone->max_ms, zone->failures);
+		zone->period_sensors = 0;
+	}
+}
+
+/**
+ * @brief: the next periodic round, the interval give or take
+ * COLLECT_JITTER percent.
+ */
+static unsigned long long next_round(unsigned long long now, unsigned int *seed)
+{
+	int jitter = collect_interval_ms / 100 * COLLECT_JITTER;
+
+	if (jitter == 0)
+		return now + collect_interval_ms;
+
+	return now + collect_interval_ms - jitter + rand_r(seed) % (2 * jitter);
+}
+
+static void *collect_thread(void *unused)
+{
+	struct collect_zone *todo[COLLECT_ZONE_MAX];
+	unsigned long long now, next = 0, report, last_report, deadline;
+	unsigned int seed = (unsigned int)time(NULL);
+	struct timespec ts;
+	int all, i, num;
+
+	prctl(PR_SET_NAME, "collect_thread");
+
+	now = now_ms();
+	last_report = now;
+	report = now + COLLECT_REPORT_MS;
+
+	/* do not start in step with the other daemons polling the CMs */
+	if (collect_interval_ms > 0)
+		next = now + rand_r(&seed) % collect_interval_ms;
+
+	pthread_mutex_lock(&collect_mutex);
+	for (;;) {
+		now = now_ms();
+		all = collect_all;
+		collect_all = 0;
+		collect_kick = 0;
+		if (collect_interval_ms > 0 && now >= next) {
+			all = 1;
+			next = next_round(now, &seed);
+		}
+
+		if (all) {
+			pthread_mutex_unlock(&collect_mutex);
+			refresh_zones();
+			pthread_mutex_lock(&collect_mutex);
+		}
+
+		num = 0;
+		for (i = 0; i < COLLECT_ZONE_MAX; i++) {
+			if (zones[i].node_id == 0 || zones[i].busy ||
+				(!all && !zones[i].requested))
+				continue;
+
+			zones[i].requested = 0;
+			todo[num++] = &zones[i];
+		}
+
+		if (num > 0) {
+			pthread_mutex_unlock(&collect_mutex);
+			for (i = 0; i < num; i++) {
+				if (collect_start(todo[i]) != 0)
+					rmm_log(ERROR, "collect zone %llu fail\n", todo[i]->node_id);
+			}
+			pthread_mutex_lock(&collect_mutex);
+		}
+
+		if (now >= report) {
+			report_zones(now - last_report);
+			last_report = now;
+			report = now + COLLECT_REPORT_MS;
+		}
+
+		deadline = report;
+		if (collect_interval_ms > 0 && next < deadline)
+			deadline = next;
+
+		ts.tv_sec = deadline / 1000;
+		ts.tv_nsec = (deadline % 1000) * 1000000;
+		if (!collect_kick)
+			pthread_cond_timedwait(&collect_cond, &collect_mutex, &ts);
+	}
+	pthread_mutex_unlock(&collect_mutex);
+
+	return NULL;
+}
+
+int collect_init(void)
+{
+	pthread_condattr_t attr;
+	pthread_t tid;
+	int interval;
+
+	interval = rmm_cfg_get_collect_interval();
+	if (interval > 0)
+		collect_interval_ms = interval * 1000;
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&collect_cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	if (pthread_create(&tid, NULL, collect_thread, NULL) != 0) {
+		rmm_log(ERROR, "Failed to create collect thread!\n");
+		return -1;
+	}
+
+	rmm_log(INFO, "collect zone sensors every %d s\n", interval > 0 ? interval : 0);
+	return 0;
+}
+
+int collect_zone_request(memdb_integer zone)
+{
+	struct collect_zone *entry;
+	int rc = 0;
+
+	pthread_mutex_lock(&collect_mutex);
+	collect_kick = 1;
+	if (zone == 0) {
+		collect_all = 1;
+	} else {
+		entry = add_zone(zone);
+		if (entry != NULL)
+			entry->requested = 1;
+		else
+			rc = -1;
+	}
+	pthread_cond_signal(&collect_cond);
+	pthread_mutex_unlock(&collect_mutex);
+
+	return rc;
+}
+
+void collect_zone_metrics(memdb_integer zone, json_t *resp)
+{
+	struct collect_zone *entry;
+	json_t *array;
+	json_t *obj;
+	int i;
+
+	array = json_array();
+	if (array == NULL)
+		return;
+
+	pthread_mutex_lock(&collect_mutex);
+	for (i = 0; i < COLLECT_ZONE_MAX; i++) {
+		entry = &zones[i];
+		if (entry->node_id == 0 || (zone != 0 && entry->node_id != zone))
+			continue;
+
+		obj = json_object();
+		if (obj == NULL)
+			break;
+
+		json_object_add(obj, JRPC_NODE_ID, json_integer(entry->node_id));
+		json_object_add(obj, JRPC_COLLECT_ROUNDS, json_integer(entry->rounds));
+		json_object_add(obj, JRPC_COLLECT_SENSORS, json_integer(entry->sensors));
+		json_object_add(obj, JRPC_COLLECT_FAILURES, json_integer(entry->failures));
+		json_object_add(obj, JRPC_COLLECT_LAST_MS, json_integer(entry->last_ms));
+		json_object_add(obj, JRPC_COLLECT_AVG_MS,
+						json_integer(entry->rounds ? entry->total_ms / entry->rounds : 0));
+		json_object_add(obj, JRPC_COLLECT_MAX_MS, json_integer(entry->max_ms));
+		json_object_add(obj, JRPC_COLLECT_RATE,
+						json_integer(entry->last_ms ? entry->last_sensors * 1000 / entry->last_ms
+									 : entry->last_sensors));
+		json_array_add(array, obj);
+	}
+	pthread_mutex_unlock(&collect_mutex);
+
+	json_object_add(resp, JRPC_COLLECT_ZONES, array);
+}
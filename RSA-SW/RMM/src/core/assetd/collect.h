@@ -0,0 +1,47 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __ASSETD_COLLECT_H__
+#define __ASSETD_COLLECT_H__
+
+#include "libjson/json.h"
+#include "libmemdb/memdb.h"
+
+/**
+ * @brief start the thread collecting the zone sensors, every
+ *        CollectInterval seconds if set.
+ *
+ */
+extern int collect_init(void);
+
+/**
+ * @brief collect the sensors of a zone now, the fans of a thermal zone
+ *        or the PSUs of a power zone.
+ *
+ * @param  zone			node_id of the zone, 0 for all the zones.
+ *
+ */
+extern int collect_zone_request(memdb_integer zone);
+
+/**
+ * @brief add the collection metrics of a zone to a response.
+ *
+ * @param  zone			node_id of the zone, 0 for all the zones.
+ * @param  resp			response.
+ *
+ */
+extern void collect_zone_metrics(memdb_integer zone, json_t *resp);
+
+#endif
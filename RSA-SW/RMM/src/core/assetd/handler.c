@@ -30,6 +30,7 @@
 #include "handler.h"
 #include "attribute.h"
 #include "map.h"
+#include "collect.h"
 
 struct reset_param {
 	int host;
@@ -66,6 +67,7 @@ static int post_psu_by_node_id(jrpc_req_pkg_t *req, json_t *resp);
 static int peripheral_hard_reset(jrpc_req_pkg_t *req, json_t *resp);
 #endif
 static int rmm_factory_reset(jrpc_req_pkg_t *req, json_t *resp);
+static int collect_zone(jrpc_req_pkg_t *req, json_t *resp);
 
 static cmd_handle_fn cmd_handles[MAX_EVT] = {
 	[ADD_EVT]				= on_add,
@@ -82,7 +84,8 @@ static cmd_handle_fn cmd_handles[MAX_EVT] = {
 	[RESET_HARD_RESET]		= peripheral_hard_reset,
 	[POST_PSU_BY_NODE_ID]	= post_psu_by_node_id,
 	#endif
-	[RMM_FACTORY_RESET]		= rmm_factory_reset
+	[RMM_FACTORY_RESET]		= rmm_factory_reset,
+	[COLLECT_ZONE]			= collect_zone
 };
 
 typedef struct cmd_func_map {
@@ -130,7 +133,6 @@ static void remove_node(memdb_integer node_id, memdb_integer parent, memdb_integ
 		rmm_log(ERROR, "memdb get uuid fail\n");
 		return;
 	}
-	nmap_remove_by_node_id(node_id);
 
 	if (msg_sn != 0) {
 		rc = libdb_attr_get_string(DB_RMM, node_id, WRAP_LOC_ID_STR, lid_str, sizeof(lid_str), LOCK_ID_NULL);
@@ -224,7 +226,6 @@ int on_cm_add(char *uuid, char *parent_uuid, json_t *req, json_t *resp)
 		rmm_log(ERROR, "memdb set mbp uuid attr fail\n");
 		return -1;
 	}
-	nmap_add(uuid, node_id);
 
 	return 0;
 }
@@ -328,7 +329,6 @@ int on_pzone_add(char *uuid, char *parent_uuid, json_t *req, json_t *resp)
 		rmm_log(ERROR, "memdb set uuid fail\n");
 		return -1;
 	}
-	nmap_add(uuid, pz_nid);
 
 	return 0;
 }
@@ -413,7 +413,6 @@ int on_tzone_add(char *uuid, char *parent_uuid, json_t *req, json_t *resp)
 		rmm_log(ERROR, "memdb set uuid fail\n");
 		return -1;
 	}
-	nmap_add(uuid, tz_nid);
 	return 0;
 }
 
@@ -497,7 +496,6 @@ int on_dzone_add(char *uuid, char *parent_uuid, json_t *req, json_t *resp)
 		rmm_log(ERROR, "memdb set uuid fail\n");
 		return -1;
 	}
-	nmap_add(uuid, dz_nid);
 	return 0;
 }
 
@@ -588,7 +586,6 @@ int on_psu_add(char *uuid, char *parent_uuid, json_t *req, json_t *resp)
 		rmm_log(ERROR, "memdb set uuid fail\n");
 		return -1;
 	}
-	nmap_add(uuid, psu_nid);
 	return 0;
 }
 
@@ -733,7 +730,6 @@ int on_drawer_add(char *uuid, char *present_uuid, json_t *req, json_t *resp)
 		rmm_log(ERROR, "memdb set uuid fail\n");
 		return -1;
 	}
-	nmap_add(uuid, drawer_nid);
 	return 0;
 }
 
@@ -832,7 +828,6 @@ int on_fan_add(char *uuid, char *present_uuid, json_t *req, json_t *resp)
 		return -1;
 	}
 
-	nmap_add(uuid, fan_nid);
 	return 0;
 }
 
@@ -1473,6 +1468,26 @@ int on_change(jrpc_req_pkg_t *req, json_t *resp)
 	return 0;
 }
 
+/**
+ * collect all the sensors of a zone, all the zones without node_id. The
+ * values go to memdb when the zone answers, the response has the metrics
+ * of the rounds before.
+ */
+static int collect_zone(jrpc_req_pkg_t *req, json_t *resp)
+{
+	int64 node_id = 0;
+
+	if (jrpc_get_named_param_value(req->json, JRPC_NODE_ID, JSON_INTEGER, &node_id) != JSONRPC_SUCCESS)
+		node_id = 0;
+
+	if (collect_zone_request((memdb_integer)node_id) != 0)
+		rmm_log(ERROR, "collect zone %lld fail\n", node_id);
+
+	collect_zone_metrics((memdb_integer)node_id, resp);
+
+	return 0;
+}
+
 int process_req(int func_id, jrpc_req_pkg_t *req, json_t *resp)
 {
 	return cmd_handles[func_id](req, resp);
@@ -41,6 +41,7 @@
 #include "libinit/libinit.h"
 #include "handler.h"
 #include "attribute.h"
+#include "collect.h"
 #include "libjsonrpcapi/parser.h"
 
 static void *ipmi_cb_thread(void *unused)
@@ -227,6 +228,9 @@ int main(int argc, char **argv)
 		return -1;
 	}
 
+	if (collect_init() != 0)
+		return -1;
+
 	main_loop(fd);
 	return 0;
 }
@@ -13,60 +13,20 @@
  */
 
 
-#include <stdlib.h>
 #include "map.h"
-#include "libutils/list.h"
-#include "libutils/string.h"
 #include "libwrap/wrap.h"
 
-typedef struct un_map_item {
-	struct list_head list;
-	char uuid[UUID_MAX_LEN];
-	memdb_integer node_id;
-} un_map_item_t;
-
-
-struct list_head node_list = LIST_HEAD_INIT(node_list);
-
-void nmap_add(char* uuid, memdb_integer node_id)
-{
-	un_map_item_t *item = NULL;
-
-	item = (un_map_item_t *)malloc(sizeof(un_map_item_t));
-	if (item == NULL)
-		return;
-
-	memset(item, 0, sizeof(un_map_item_t));
-
-	strncpy_safe(item->uuid, uuid, UUID_MAX_LEN, UUID_MAX_LEN - 1);
-	item->node_id = node_id;
-
-	list_add_tail(&item->list, &node_list);
-}
-
-void nmap_remove_by_node_id(memdb_integer node_id)
-{
-	un_map_item_t *item;
-
-	list_for_each_entry(item, &node_list, list) {
-		if(item->node_id == node_id) {
-			list_del(&item->list);
-			free(item);
-			break;
-		}
-	}
-	
-}
-
+/**
+ * @brief: memdb indexes the uuid attribute, so there is no need to keep
+ *         a map of our own.
+ */
 int nmap_get_node_id_by_uuid(memdb_integer *node_id, char *uuid)
 {
-	un_map_item_t *item;
+	struct node_info node;
+
+	if (libdb_find_node_by_attr(DB_RMM, WRAP_UUID_STR, uuid, &node, LOCK_ID_NULL) != 0)
+		return -1;
 
-	list_for_each_entry(item, &node_list, list) {
-		if (strcmp((char *)uuid, item->uuid) == 0) {
-			*node_id = item->node_id;
-			return 0;
-		}
-	}
-	return -1;
+	*node_id = node.node_id;
+	return 0;
 }
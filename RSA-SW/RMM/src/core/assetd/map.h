@@ -20,8 +20,6 @@
 #include "libutils/rmm.h"
 #include "libmemdb/memdb.h"
 
-void nmap_add(char* uuid, memdb_integer node_id);
-void nmap_remove_by_node_id(memdb_integer node_id);
 int nmap_get_node_id_by_uuid(memdb_integer *node_id, char *uuid);
 
 #endif
@@ -0,0 +1,139 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "libmemdb/memdb.h"
+#include "libutils/rmm.h"
+
+/*
+ * Request rate of memdbd over JSON-RPC/UDP and over the binary transport
+ * of libmemdb/memdb_tlv.h. Reads use libdb_attr_get_multi() as the other
+ * getters may be served from the shared snapshot without memdbd. The
+ * logged sets measure the memdb log write path as well, the finds the
+ * uuid index of memdbd.
+ *
+ *     memdbbench [requests]
+ */
+#define DEFAULT_REQUESTS	20000
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int run(char *transport, memdb_integer node, int requests)
+{
+	char attrs[1024];
+	char value[32];
+	char *name = "bench_value";
+	char *uuid = "00000000-0000-0000-0000-62656e636800";
+	struct node_info found;
+	double start, set_sec, log_sec, get_sec, find_sec;
+	int size;
+	int i;
+
+	start = now_sec();
+	for (i = 0; i < requests; i++) {
+		snprintf(value, sizeof(value), "%d", i);
+		if (libdb_attr_set_string(DB_RMM, node, name, 0, value, SNAPSHOT_NEED_NOT, LOCK_ID_NULL) != 0) {
+			printf("%s: attr set failed at request %d\n", transport, i);
+			return -1;
+		}
+	}
+	set_sec = now_sec() - start;
+
+	/* the same with the memdb log written for every set */
+	start = now_sec();
+	for (i = 0; i < requests; i++) {
+		snprintf(value, sizeof(value), "%d", i);
+		if (libdb_attr_set_string(DB_RMM, node, name, 0, value, SNAPSHOT_NEED, LOCK_ID_NULL) != 0) {
+			printf("%s: logged attr set failed at request %d\n", transport, i);
+			return -1;
+		}
+	}
+	log_sec = now_sec() - start;
+
+	start = now_sec();
+	for (i = 0; i < requests; i++) {
+		size = sizeof(attrs);
+		if (libdb_attr_get_multi(DB_RMM, node, &name, 1, 0, attrs, &size, LOCK_ID_NULL) != 0) {
+			printf("%s: attr get failed at request %d\n", transport, i);
+			return -1;
+		}
+	}
+	get_sec = now_sec() - start;
+
+	if (libdb_attr_set_string(DB_RMM, node, "uuid", 0, uuid, SNAPSHOT_NEED_NOT, LOCK_ID_NULL) != 0) {
+		printf("%s: uuid set failed\n", transport);
+		return -1;
+	}
+
+	start = now_sec();
+	for (i = 0; i < requests; i++) {
+		if (libdb_find_node_by_attr(DB_RMM, "uuid", uuid, &found, LOCK_ID_NULL) != 0 ||
+			found.node_id != node) {
+			printf("%s: find by uuid failed at request %d\n", transport, i);
+			return -1;
+		}
+	}
+	find_sec = now_sec() - start;
+
+	printf("%-8s set %8.0f req/s  logged set %8.0f req/s  get %8.0f req/s  find %8.0f req/s\n",
+		   transport, requests / set_sec, requests / log_sec, requests / get_sec, requests / find_sec);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int requests = DEFAULT_REQUESTS;
+	memdb_integer node;
+	int rc = 0;
+
+	if (argc > 1)
+		requests = atoi(argv[1]);
+	if (requests <= 0) {
+		printf("usage: %s [requests]\n", argv[0]);
+		return -1;
+	}
+
+	libdb_init();
+
+	node = libdb_create_node(DB_RMM, MC_NODE_ROOT, MC_TYPE_CM,
+							 SNAPSHOT_NEED_NOT, LOCK_ID_NULL);
+	if (node == 0) {
+		printf("failed to create the bench node!\n");
+		return -1;
+	}
+
+	libdb_set_binary_transport(0);
+	rc |= run("json", node, requests);
+
+	libdb_set_binary_transport(1);
+	rc |= run("binary", node, requests);
+
+	/* do not leave the bench node in the snapshot */
+	libdb_destroy_node(DB_RMM, node, LOCK_ID_NULL);
+	libdb_exit_memdb();
+
+	return rc;
+}
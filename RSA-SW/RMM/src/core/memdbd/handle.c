@@ -17,6 +17,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <limits.h>
 #include <sys/time.h>
 
 #include "librmmlog/rmmlog.h"
@@ -24,8 +25,10 @@
 #include "libmemdb/event.h"
 #include "libmemdb/command.h"
 #include "libmemdb/memdb_jrpc.h"
+#include "libmemdb/memdb_tlv.h"
 #include "libutils/rack.h"
 #include "memdb.h"
+#include "memdb_shm.h"
 
 struct list_head pending_cmd_list = LIST_HEAD_INIT(pending_cmd_list);
 
@@ -267,31 +270,52 @@ static int handle_node_get_by_node_id(struct request_pkg *req, json_t *resp)
 {
 	struct node *n;
 	struct node_info info;
-	struct list_head *which_node = &node_list;
 
-	if (DB_POD == req->db_name)
-		which_node = &pod_node_list;
+	n = find_node_by_node_id(req->db_name, req->node_id);
+	if (!n)
+		return MEMDB_INTERNAL_ERR;
 
-	list_for_each_entry(n, which_node, list) {
-		if (n->node_id == req->node_id) {
-			info.parent = n->parent != NULL ? n->parent->node_id : 0UL;
-			info.node_id   = n->node_id;
-			info.type   = n->type;
-
-			json_t *node = json_object();
-
-			if (NULL == node ||
-				JSON_SUCCESS != json_object_add(node, "parent", json_integer(info.parent)) ||
-				JSON_SUCCESS != json_object_add(node, "node_id", json_integer(info.node_id)) ||
-				JSON_SUCCESS != json_object_add(node, "type", json_string(mc_type_str[info.type])) ||
-				JSON_SUCCESS != json_object_add(resp, "r_node", node)) {
-				return MEMDB_INTERNAL_ERR;
-			} else {
-				return MEMDB_HANDLE_SUCCESS;
-			}
-		}
-	}
-	return MEMDB_INTERNAL_ERR;
+	info.parent = n->parent != NULL ? n->parent->node_id : 0UL;
+	info.node_id   = n->node_id;
+	info.type   = n->type;
+
+	json_t *node = json_object();
+
+	if (NULL == node ||
+		JSON_SUCCESS != json_object_add(node, "parent", json_integer(info.parent)) ||
+		JSON_SUCCESS != json_object_add(node, "node_id", json_integer(info.node_id)) ||
+		JSON_SUCCESS != json_object_add(node, "type", json_string(mc_type_str[info.type])) ||
+		JSON_SUCCESS != json_object_add(resp, "r_node", node))
+		return MEMDB_INTERNAL_ERR;
+
+	return MEMDB_HANDLE_SUCCESS;
+}
+
+static int handle_node_find_by_attr(struct request_pkg *req, json_t *resp)
+{
+	struct node *n;
+	jrpc_data_string p_name = NULL;
+	jrpc_data_string p_data = NULL;
+
+	if (jrpc_get_named_param_value(req->jrpc_pkg.json, "p_name", JSON_STRING, &p_name) ||
+		jrpc_get_named_param_value(req->jrpc_pkg.json, "p_data", JSON_STRING, &p_data))
+		return MEMDB_INVALID_PARAMS;
+
+	n = find_node_by_attr(req->db_name, (char *)p_name,
+						  (unsigned char *)p_data, strlen((char *)p_data) + 1);
+	if (!n)
+		return MEMDB_OEM_NODE_NOTFOUND;
+
+	json_t *node = json_object();
+
+	if (NULL == node ||
+		JSON_SUCCESS != json_object_add(node, "parent", json_integer(n->parent != NULL ? n->parent->node_id : 0UL)) ||
+		JSON_SUCCESS != json_object_add(node, "node_id", json_integer(n->node_id)) ||
+		JSON_SUCCESS != json_object_add(node, "type", json_string(mc_type_str[n->type])) ||
+		JSON_SUCCESS != json_object_add(resp, "r_node", node))
+		return MEMDB_INTERNAL_ERR;
+
+	return MEMDB_HANDLE_SUCCESS;
 }
 
 static int handle_attr_set(struct request_pkg *req, json_t *resp)
@@ -365,6 +389,200 @@ static int handle_attr_get(struct request_pkg *req, json_t *resp)
 	return MEMDB_HANDLE_SUCCESS;
 }
 
+/* Reply must fit in one JSON-RPC datagram, keep room for the envelope. */
+#define MULTI_RSP_MAX_LEN	(JSONRPC_MAX_STRING_LEN - 1024)
+/* Approximate JSON text of one attribute besides its name and data. */
+#define MULTI_ATTR_OVERHEAD	64
+
+static int add_multi_attr(json_t *array, memdb_integer node_id, memdb_integer cookie,
+						  char *name, char *data, int *rsp_len)
+{
+	json_t *element = NULL;
+
+	/* only codes below JSON_RPC_MAX_ERR with an err_st_t entry reach the client */
+	*rsp_len += strlen(name) + strlen(data) + MULTI_ATTR_OVERHEAD;
+	if (*rsp_len > MULTI_RSP_MAX_LEN)
+		return MEMDB_OEM_HANDLE_ERR;
+
+	element = json_object();
+	if (NULL == element ||
+		JSON_SUCCESS != json_object_add(element, "node", json_integer(node_id)) ||
+		JSON_SUCCESS != json_object_add(element, "cookie", json_integer(cookie)) ||
+		JSON_SUCCESS != json_object_add(element, "name", json_string(name)) ||
+		JSON_SUCCESS != json_object_add(element, "data", json_string(data)) ||
+		JSON_SUCCESS != json_array_add(array, element))
+		return MEMDB_INTERNAL_ERR;
+
+	return MEMDB_HANDLE_SUCCESS;
+}
+
+/**
+ * @brief: Collect the attributes named in @names (all attributes if
+ *         @names is empty) of node @n, and of its descendants if
+ *         @subtree is set. Missing attributes are skipped.
+ */
+static int collect_multi_attrs(struct node *n, json_t *names, int subtree,
+							   json_t *array, int *rsp_len)
+{
+	int i, rc;
+	int names_num = json_array_size(names);
+	char *name = NULL;
+	char *data = NULL;
+	memdb_integer cookie = 0;
+	struct node_attr *pa;
+	struct node *child;
+
+	if (names_num <= 0) {
+		list_for_each_entry(pa, &n->attrs, group) {
+			rc = add_multi_attr(array, n->node_id, pa->cookie, pa->name,
+								(char *)pa->data, rsp_len);
+			if (rc)
+				return rc;
+		}
+	} else {
+		for (i = 0; i < names_num; i++) {
+			name = json_string_value(json_array_get(names, i));
+			if (NULL == name)
+				return MEMDB_INVALID_PARAMS;
+
+			if (0 != get_node_attr(n, (unsigned char *)name, strlen(name)+1, &cookie, &data))
+				continue;
+
+			rc = add_multi_attr(array, n->node_id, cookie, name, data, rsp_len);
+			if (rc)
+				return rc;
+		}
+	}
+
+	if (!subtree)
+		return MEMDB_HANDLE_SUCCESS;
+
+	list_for_each_entry(child, &n->children, sibling) {
+		rc = collect_multi_attrs(child, names, subtree, array, rsp_len);
+		if (rc)
+			return rc;
+	}
+
+	return MEMDB_HANDLE_SUCCESS;
+}
+
+static int handle_attr_get_multi(struct request_pkg *req, json_t *resp)
+{
+	struct node *n;
+	json_t *names = NULL;
+	json_t *array = NULL;
+	jrpc_data_integer p_subtree = 0;
+	int rsp_len = 0;
+	int rc;
+
+	n = find_node_by_node_id(req->db_name, req->node_id);
+	if (!n)
+		return MEMDB_OEM_NODE_NOTFOUND;
+
+	if (jrpc_get_named_param_value(req->jrpc_pkg.json, "p_names", JSON_ARRAY, &names) ||
+		jrpc_get_named_param_value(req->jrpc_pkg.json, "p_subtree", JSON_INTEGER, &p_subtree))
+		return MEMDB_INVALID_PARAMS;
+
+	array = json_array();
+	if (NULL == array)
+		return MEMDB_INTERNAL_ERR;
+
+	rc = collect_multi_attrs(n, names, p_subtree != 0, array, &rsp_len);
+	if (rc) {
+		json_free(array);
+		return rc;
+	}
+
+	if (JSON_SUCCESS != json_object_add(resp, "r_attrs", array) ||
+		JSON_SUCCESS != json_object_add(resp, "node_id", json_integer(n->node_id)))
+		return MEMDB_INTERNAL_ERR;
+
+	return MEMDB_HANDLE_SUCCESS;
+}
+
+static int handle_attr_set_multi(struct request_pkg *req, json_t *resp)
+{
+	struct node *n;
+	struct node **targets = NULL;
+	json_t *attrs = NULL;
+	json_t *node_id = NULL;
+	json_t *element = NULL;
+	jrpc_data_integer p_snap = 0;
+	memdb_integer cookie = 0;
+	char *name = NULL;
+	char *data = NULL;
+	int count = 0;
+	int rc = MEMDB_HANDLE_SUCCESS;
+	int i;
+
+	n = find_node_by_node_id(req->db_name, req->node_id);
+	if (!n)
+		return MEMDB_OEM_NODE_NOTFOUND;
+
+	if (jrpc_get_named_param_value(req->jrpc_pkg.json, "p_snapshot_flag", JSON_INTEGER, &p_snap) ||
+		jrpc_get_named_param_value(req->jrpc_pkg.json, "p_attrs", JSON_ARRAY, &attrs))
+		return MEMDB_INVALID_PARAMS;
+
+	count = json_array_size(attrs);
+	if (count > 0) {
+		targets = malloc(count * sizeof(struct node *));
+		if (targets == NULL)
+			return MEMDB_INTERNAL_ERR;
+	}
+
+	/*
+	 * Check every entry and find its node before storing any, so that a
+	 * bad entry leaves all the attributes of the request untouched.
+	 */
+	for (i = 0; i < count; i++) {
+		element = json_array_get(attrs, i);
+		if (NULL == element ||
+			NULL == (name = json_string_value(json_object_get(element, "name"))) ||
+			NULL == (data = json_string_value(json_object_get(element, "data"))) ||
+			strlen(name) >= USHRT_MAX || strlen(data) >= USHRT_MAX) {
+			rc = MEMDB_INVALID_PARAMS;
+			goto out;
+		}
+
+		/* an entry may be for another node */
+		targets[i] = n;
+		node_id = json_object_get(element, "node_id");
+		if (node_id != NULL) {
+			targets[i] = find_node_by_node_id(req->db_name, json_integer_value(node_id));
+			if (!targets[i]) {
+				rc = MEMDB_OEM_NODE_NOTFOUND;
+				goto out;
+			}
+		}
+	}
+
+	/* only running out of memory fails from here on */
+	for (i = 0; i < count; i++) {
+		element = json_array_get(attrs, i);
+		name = json_string_value(json_object_get(element, "name"));
+		data = json_string_value(json_object_get(element, "data"));
+		cookie = json_integer_value(json_object_get(element, "cookie"));
+
+		if (set_node_attr(req->db_name, targets[i], cookie,
+						  (unsigned char *)name, strlen(name)+1,
+						  (unsigned char *)data, strlen(data)+1,
+						  (memdb_integer)p_snap, TYPE_STRING) != 0) {
+			rc = MEMDB_OEM_HANDLE_ERR;
+			goto out;
+		}
+
+		/* notify and log every attribute as a single set does */
+		publish_subscription();
+	}
+
+	if (JSON_SUCCESS != json_object_add(resp, "node_id", json_integer(n->node_id)))
+		rc = MEMDB_INTERNAL_ERR;
+
+out:
+	free(targets);
+	return rc;
+}
+
 static int handle_attr_remove(struct request_pkg *req, json_t *resp)
 {
 	struct node *n;
@@ -584,6 +802,7 @@ static int handle_db_lock(struct request_pkg *req, json_t *resp)
 
 	id = alloc_lock_id();
 	cur_lock_id = id;
+	memdb_shm_set_locked(1);
 
 	if (JSON_SUCCESS != json_object_add(resp, "r_lock_id", json_integer(id)))
 		return MEMDB_INTERNAL_ERR;
@@ -599,6 +818,7 @@ static int handle_db_unlock(struct request_pkg *req, json_t *resp)
 		return MEMDB_OEM_HANDLE_ERR;
 
 	cur_lock_id = LOCK_ID_STARTER;
+	memdb_shm_set_locked(0);
 
 	/* unset timer */
 	value.it_value.tv_sec = 0;
@@ -633,6 +853,11 @@ static command_handle_fn handles[CMD_MAX] = {
 
 	[CMD_LOCK] = handle_db_lock,
 	[CMD_UNLOCK] = handle_db_unlock,
+
+	[CMD_ATTRBUTE_GET_MULTI]    = handle_attr_get_multi,
+	[CMD_ATTRBUTE_SET_MULTI]    = handle_attr_set_multi,
+
+	[CMD_NODE_FIND_BY_ATTR]     = handle_node_find_by_attr,
 };
 
 void pend_command(int fd, struct request_pkg *req, struct sockaddr *addr, socklen_t addrlen)
@@ -647,21 +872,67 @@ void pend_command(int fd, struct request_pkg *req, struct sockaddr *addr, sockle
 
 	cmd->fd = fd;
 	cmd->addrlen = addrlen;
-	memcpy(&cmd->addr, addr, sizeof(struct sockaddr));
+	if (addr != NULL)
+		memcpy(&cmd->addr, addr, sizeof(struct sockaddr));
 	memcpy(&cmd->pkg, req, sizeof(struct request_pkg));
 
 	list_add_tail(&cmd->list, &pending_cmd_list);
 }
 
 #define MEMDB_REQ_TIMEOUT (-32000)	/* timeout rsp code. need to confirm */
-void process_command(int fd, struct request_pkg *req, struct sockaddr *addr, socklen_t addrlen)
+static void process_tlv_command(int fd, struct request_pkg *req)
 {
 	json_t *rsp = json_object();
+	int64 code = 0;
+	int rc = 0;
+	command_handle_fn fn;
+
+	if (NULL == rsp) {
+		code = JSONRPC_INTERNAL_ERR;
+	} else if (req->lock_id && (req->lock_id < (candi_lock_id - 1) || cur_lock_id == LOCK_ID_STARTER)) {
+		rmm_log(INFO, "\nreq lock id %lld timeout. return -1.\n", req->lock_id);
+		code = MEMDB_REQ_TIMEOUT;
+	} else if (req->cmd < CMD_MAX) {
+		fn = handles[req->cmd];
+		if (fn)
+			rc = fn(req, rsp);
+	}
+
+	if (rc) {
+		if ((rc > 0) && (rc < JSON_RPC_MAX_ERR))
+			code = err_st_t[rc].err_code;
+		if (code == 0)
+			code = JSONRPC_INTERNAL_ERR;
+	}
+
+	if (code)
+		memdb_tlv_send_rsp(fd, MEMDB_TLV_ERR, req->cmd, req->jrpc_pkg.id, code, NULL);
+	else
+		memdb_tlv_send_rsp(fd, MEMDB_TLV_RSP, req->cmd, req->jrpc_pkg.id, 0, rsp);
+
+	if (rsp)
+		json_free(rsp);
+	if (req->jrpc_pkg.json) {
+		json_free(req->jrpc_pkg.json);
+		req->jrpc_pkg.json = NULL;
+	}
+}
+
+void process_command(int fd, struct request_pkg *req, struct sockaddr *addr, socklen_t addrlen)
+{
+	json_t *rsp = NULL;
 	json_t *rsp_rc_json = NULL;
 	int rc = 0;
-	char *rsp_str = malloc(JSONRPC_MAX_STRING_LEN);
+	char *rsp_str = NULL;
 	command_handle_fn fn;
 
+	if (req->binary) {
+		process_tlv_command(fd, req);
+		return;
+	}
+
+	rsp = json_object();
+	rsp_str = malloc(JSONRPC_MAX_STRING_LEN);
 	if (rsp_str == NULL)
 		goto send_rsp;
 	else
@@ -719,9 +990,28 @@ void dispose_command(int fd, struct request_pkg *req, struct sockaddr *addr, soc
 	}
 }
 
+/**
+ * @brief: Forget the pending commands of a client of MEMDB_TLV_SOCK
+ *         which has gone, its fd may be reused by the next one.
+ */
+void drop_pending_cmds(int fd)
+{
+	struct pending_cmd *cmd, *tmp;
+
+	list_for_each_entry_safe(cmd, tmp, &pending_cmd_list, list) {
+		if (cmd->fd == fd && cmd->pkg.binary) {
+			list_del(&cmd->list);
+			if (cmd->pkg.jrpc_pkg.json)
+				json_free(cmd->pkg.jrpc_pkg.json);
+			free(cmd);
+		}
+	}
+}
+
 void db_timeout(void)
 {
 	cur_lock_id = LOCK_ID_STARTER;
+	memdb_shm_set_locked(0);
 }
 
 void process_pending_cmds(void)
@@ -0,0 +1,199 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "libutils/rack.h"
+#include "libmemdb/node.h"
+#include "memdb.h"
+
+/*
+ * Cost of the node and attribute lookups of memdbd, in process, as the
+ * database grows. Each step adds fully populated racks: the power zones
+ * with their PSUs, the thermal zones with their fans, the drawer zones
+ * with their drawers and the MBPs, every node with the attributes of a
+ * real rack. The lookups hit random nodes and attributes of the whole
+ * database. The hashed lookups should cost about the same at any size,
+ * up to a few NODE_HASH_SIZE nodes, where the walk of node_list that
+ * find_node_by_node_id used to do grows with the node count.
+ *
+ *     memdblookupbench [racks] [lookups]
+ */
+#define DEFAULT_RACKS		32
+#define DEFAULT_LOOKUPS		1000000
+
+#define ZONE_NUM			4
+#define ZONE_CHILD_NUM		6
+#define MBP_NUM				2
+
+static char *attr_names[] = {
+	"uuid", "loc_id", "name", "description", "create_date", "update_date",
+	"health_state", "presence", "fw_version", "aggregated_thermal",
+	"desired_pwm_spd", "aggregated_pwm0", "power_in", "power_out",
+};
+
+#define ATTR_NUM	(sizeof(attr_names) / sizeof(attr_names[0]))
+
+static memdb_integer *node_ids;
+static int node_num;
+static int node_max;
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static struct node *add_node(struct node *parent, int type)
+{
+	char name[64];
+	char value[64];
+	struct node *n;
+	int i;
+
+	n = insert_node(DB_RMM, parent, type, SNAPSHOT_NEED_NOT);
+	if (n == NULL) {
+		printf("insert_node failed\n");
+		exit(-1);
+	}
+
+	for (i = 0; i < ATTR_NUM; i++) {
+		/* set_node_attr terminates the name in place */
+		snprintf(name, sizeof(name), "%s", attr_names[i]);
+		snprintf(value, sizeof(value), "%lld-%d", n->node_id, i);
+		set_node_attr(DB_RMM, n, 0, (unsigned char *)name, strlen(name) + 1,
+					  (unsigned char *)value, strlen(value) + 1, SNAPSHOT_NEED_NOT, TYPE_STRING);
+	}
+
+	if (node_num == node_max) {
+		node_max = node_max ? node_max * 2 : 1024;
+		node_ids = realloc(node_ids, node_max * sizeof(memdb_integer));
+		if (node_ids == NULL) {
+			printf("realloc failed\n");
+			exit(-1);
+		}
+	}
+	node_ids[node_num++] = n->node_id;
+
+	return n;
+}
+
+static void add_zones(struct node *rack, int zone_type, int child_type, int child_num)
+{
+	struct node *zone;
+	int i, j;
+
+	for (i = 0; i < ZONE_NUM; i++) {
+		zone = add_node(rack, zone_type);
+		for (j = 0; j < child_num; j++)
+			add_node(zone, child_type);
+	}
+}
+
+static void add_rack(struct node *root)
+{
+	struct node *rack;
+	int i;
+
+	rack = add_node(root, MC_TYPE_RMC);
+	add_zones(rack, MC_TYPE_PZONE, MC_TYPE_PSU, ZONE_CHILD_NUM);
+	add_zones(rack, MC_TYPE_TZONE, MC_TYPE_FAN, ZONE_CHILD_NUM);
+	add_zones(rack, MC_TYPE_DZONE, MC_TYPE_DRAWER, ZONE_NUM);
+	for (i = 0; i < MBP_NUM; i++)
+		add_node(rack, MC_TYPE_CM);
+}
+
+/* the lookup before the node hash, for comparison */
+static struct node *walk_node_list(memdb_integer node_id)
+{
+	struct node *n;
+
+	list_for_each_entry(n, &node_list, list) {
+		if (n->node_id == node_id)
+			return n;
+	}
+
+	return NULL;
+}
+
+static void run(int racks, int lookups)
+{
+	struct node *n;
+	memdb_integer cookie;
+	char *name, *data;
+	double start, node_ns, attr_ns, list_ns;
+	unsigned int seed = 1;
+	int i, misses = 0;
+
+	start = now_sec();
+	for (i = 0; i < lookups; i++) {
+		if (find_node_by_node_id(DB_RMM, node_ids[rand_r(&seed) % node_num]) == NULL)
+			misses++;
+	}
+	node_ns = (now_sec() - start) * 1e9 / lookups;
+
+	start = now_sec();
+	for (i = 0; i < lookups; i++) {
+		n = find_node_by_node_id(DB_RMM, node_ids[rand_r(&seed) % node_num]);
+		name = attr_names[rand_r(&seed) % ATTR_NUM];
+		if (n == NULL || get_node_attr(n, (unsigned char *)name, strlen(name) + 1, &cookie, &data) != 0)
+			misses++;
+	}
+	attr_ns = (now_sec() - start) * 1e9 / lookups;
+
+	/* the walk is slow, a tenth of the lookups is enough */
+	start = now_sec();
+	for (i = 0; i < lookups / 10; i++) {
+		if (walk_node_list(node_ids[rand_r(&seed) % node_num]) == NULL)
+			misses++;
+	}
+	list_ns = (now_sec() - start) * 1e9 / (lookups / 10);
+
+	printf("%6d %8d %10.1f %12.1f %10.1f %6d\n", racks, node_num, node_ns, attr_ns, list_ns, misses);
+}
+
+int main(int argc, char **argv)
+{
+	int racks = DEFAULT_RACKS;
+	int lookups = DEFAULT_LOOKUPS;
+	struct node *root;
+	int step, added = 0;
+
+	if (argc > 1)
+		racks = atoi(argv[1]);
+	if (argc > 2)
+		lookups = atoi(argv[2]);
+	if (racks <= 0 || lookups < 10) {
+		printf("usage: %s [racks] [lookups]\n", argv[0]);
+		return -1;
+	}
+
+	int_node_module();
+	root = find_node_by_node_id(DB_RMM, 0);
+
+	printf("# racks nodes node_ns attr_get_ns list_walk_ns misses\n");
+	for (step = 1; step <= racks; step *= 2) {
+		for (; added < step; added++)
+			add_rack(root);
+		run(step, lookups);
+	}
+
+	return 0;
+}
@@ -15,6 +15,7 @@
 
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
@@ -23,18 +24,21 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
 #include <stdlib.h>
 #include "libutils/dump.h"
 
 #include "snap.h"
 #include "memdb.h"
 #include "memdb_log.h"
+#include "memdb_shm.h"
 #include "libmemdb/command.h"
 #include "libmemdb/event.h"
 #include "libmemdb/node.h"
 #include "libmemdb/memdb.h"
 #include "libutils/sock.h"
 #include "libmemdb/memdb_jrpc.h"
+#include "libmemdb/memdb_tlv.h"
 #include "librmmcfg/rmm_cfg.h"
 #include "libinit/libinit.h"
 
@@ -49,6 +53,8 @@ static void handle_signal(int sig)
 
 		while (snapshot_in_progress || (0 == memdb_log_get_status()))
 			usleep(10 * 1000);
+
+		memdb_log_shutdown();
 	}
 
 	exit(0);
@@ -100,10 +106,117 @@ static int create_listen_socket(int *fd)
 	return 0;
 }
 
+#define MAX_TLV_CLIENTS		64
+
+static int tlv_clients[MAX_TLV_CLIENTS];
+
+/**
+ * @brief: Create the socket for the clients using the binary transport,
+ *         see libmemdb/memdb_tlv.h. memdbd still works without it.
+ */
+static int create_tlv_socket(void)
+{
+	struct sockaddr_un addr = {};
+	int fd;
+	int i;
+
+	for (i = 0; i < MAX_TLV_CLIENTS; i++)
+		tlv_clients[i] = -1;
+
+	fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	if (fd < 0)
+		return -1;
+
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, MEMDB_TLV_SOCK, sizeof(addr.sun_path) - 1);
+	unlink(MEMDB_TLV_SOCK);
+
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+		listen(fd, MAX_TLV_CLIENTS) < 0) {
+		MEMDB_ERR("create %s error: %s\n", MEMDB_TLV_SOCK, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static void accept_tlv_client(int listenfd)
+{
+	int fd;
+	int i;
+
+	fd = accept(listenfd, NULL, NULL);
+	if (fd < 0)
+		return;
+
+	for (i = 0; i < MAX_TLV_CLIENTS; i++) {
+		if (tlv_clients[i] == -1) {
+			tlv_clients[i] = fd;
+			return;
+		}
+	}
+
+	/* the client falls back to UDP */
+	close(fd);
+}
+
+static void close_tlv_client(int idx)
+{
+	sigset_t mask;
+
+	mask = block_timer_signal();
+	drop_pending_cmds(tlv_clients[idx]);
+	unblock_timer_signal(mask);
+
+	close(tlv_clients[idx]);
+	tlv_clients[idx] = -1;
+}
+
+static void handle_tlv_client(int idx, char *buf, int size)
+{
+	struct memdb_tlv_hdr hdr;
+	struct request_pkg req = {};
+	sigset_t mask;
+	int fd = tlv_clients[idx];
+	int rc;
+
+	rc = recv(fd, buf, size, 0);
+	if (rc < (int)sizeof(hdr)) {
+		close_tlv_client(idx);
+		return;
+	}
+
+	memcpy(&hdr, buf, sizeof(hdr));
+	if (hdr.type == MEMDB_TLV_HELLO) {
+		memdb_tlv_send_rsp(fd, MEMDB_TLV_HELLO, 0, hdr.id, 0, NULL);
+		return;
+	}
+
+	rc = memdb_tlv_parse_req(buf, rc, &req);
+	if (rc) {
+		if ((rc > 0) && (rc < JSON_RPC_MAX_ERR))
+			rc = err_st_t[rc].err_code;
+		else
+			rc = JSONRPC_INVALID_REQ;
+		memdb_tlv_send_rsp(fd, MEMDB_TLV_ERR, hdr.cmd, hdr.id, rc, NULL);
+		return;
+	}
+
+	mask = block_timer_signal();
+	dispose_command(fd, &req, NULL, 0);
+	unblock_timer_signal(mask);
+
+	publish_subscription();
+}
+
 int main(int argc, char **argv)
 {
 	int rc;
 	int fd;
+	int tlvfd;
+	int max_fd;
+	int i;
 	
 	char *rsp_str;
 	fd_set fds;
@@ -112,6 +225,10 @@ int main(int argc, char **argv)
 	struct request_pkg req;
 	char cmd_string[JSONRPC_MAX_STRING_LEN] = {0};
 	sigset_t mask;
+	struct timeval timeo;
+	int wait_ms;
+	int log_ms;
+	struct timespec load_start, load_end;
 
 	if (rmm_modules_init(MODULEINIT_COREDUMP | MODULEINIT_LOG, 0, 0))
 		exit(-1);
@@ -121,6 +238,7 @@ int main(int argc, char **argv)
 	int_event_module();
 	
 	create_listen_socket(&fd);
+	tlvfd = create_tlv_socket();
 
 	addrlen = sizeof(addr);
 
@@ -129,14 +247,20 @@ int main(int argc, char **argv)
 	signal(SIGTERM, handle_signal);
 	signal(SIGALRM , handle_timeout);
 
-	/* Load the existed memdb first. */
-	memdb_node_load(FILE_SNAP, DB_RMM);
-
-	/* Load the latest memdb from the logfile */
-	memdb_log_load(DB_RMM, MEMDB_LOG_RMM_FILE);
+	/* Load the existed memdb, then the changes logged after it. */
+	clock_gettime(CLOCK_MONOTONIC, &load_start);
+	memdb_log_recover(DB_RMM, FILE_SNAP);
+	clock_gettime(CLOCK_MONOTONIC, &load_end);
+	MEMDB_INFO("memdb loaded in %ld ms\n",
+			   (load_end.tv_sec - load_start.tv_sec) * 1000 +
+			   (load_end.tv_nsec - load_start.tv_nsec) / 1000000);
 
 	/* clear pending status from existed memdb logfile/snapshot */
 	publish_subscription();
+
+	/* read-only snapshot for the clients, see libmemdb/memdb_shm.h */
+	if (memdb_shm_init() != 0)
+		MEMDB_ERR("memdb snapshot is not available, clients use the socket only\n");
 	rsp_str = malloc(JSONRPC_MAX_STRING_LEN);
 	for (;;) {
 		mask = block_timer_signal();
@@ -145,9 +269,40 @@ int main(int argc, char **argv)
 
 		FD_ZERO(&fds);
 		FD_SET(fd, &fds);
+		max_fd = fd;
+
+		if (tlvfd >= 0) {
+			FD_SET(tlvfd, &fds);
+			max_fd = (tlvfd > max_fd) ? tlvfd : max_fd;
+		}
+
+		for (i = 0; i < MAX_TLV_CLIENTS; i++) {
+			if (tlv_clients[i] < 0)
+				continue;
+			FD_SET(tlv_clients[i], &fds);
+			max_fd = (tlv_clients[i] > max_fd) ? tlv_clients[i] : max_fd;
+		}
+
+		wait_ms = memdb_shm_publish();
+		log_ms = memdb_log_commit();
+		if (wait_ms < 0 || (log_ms >= 0 && log_ms < wait_ms))
+			wait_ms = log_ms;
+		timeo.tv_sec = wait_ms / 1000;
+		timeo.tv_usec = (wait_ms % 1000) * 1000;
+
+		rc = select(max_fd + 1, &fds, NULL, NULL, (wait_ms < 0) ? NULL : &timeo);
+		if (rc <= 0)
+			continue;
+
+		for (i = 0; i < MAX_TLV_CLIENTS; i++) {
+			if (tlv_clients[i] >= 0 && FD_ISSET(tlv_clients[i], &fds))
+				handle_tlv_client(i, cmd_string, sizeof(cmd_string));
+		}
+
+		if (tlvfd >= 0 && FD_ISSET(tlvfd, &fds))
+			accept_tlv_client(tlvfd);
 
-		rc = select(fd + 1, &fds, NULL, NULL, NULL);
-		if (rc < 0)
+		if (!FD_ISSET(fd, &fds))
 			continue;
 		memset(cmd_string, 0, JSONRPC_MAX_STRING_LEN);
 		rc = recvfrom(fd, cmd_string, sizeof(cmd_string), 0, (struct sockaddr *)&addr, &addrlen);
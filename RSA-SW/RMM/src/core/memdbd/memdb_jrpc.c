@@ -13,10 +13,13 @@
  */
 
 
+#include <sys/socket.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "libmemdb/memdb_jrpc.h"
+#include "libmemdb/memdb_tlv.h"
 #include "libmemdb/node.h"
 #include "memdb.h"
 #include "memdb_log.h"
@@ -44,6 +47,7 @@ int memdb_parse_req(char *string, struct request_pkg *req)
 
 	req->lock_id = (lock_id_t)p_lock_id;
 	req->node_id = (memdb_integer)p_node_id;
+	req->binary = 0;
 
 	/* analyze db name */
 	for (i = 0; i <= DB_MAX; i++) {
@@ -73,3 +77,87 @@ int memdb_parse_req(char *string, struct request_pkg *req)
 	return JSONRPC_METHOD_NOTFOUND;
 }
 
+
+/**
+ * @brief: Parse a MEMDB_TLV_REQ packet. The decoded parameters are put
+ *         under "params", so the command handles read them the same way
+ *         as the ones of a JSON-RPC request.
+ */
+int memdb_tlv_parse_req(char *data, int len, struct request_pkg *req)
+{
+	struct memdb_tlv_hdr hdr;
+	json_t *params = NULL;
+
+	if (NULL == data || NULL == req || len < sizeof(hdr))
+		return MEMDB_OEM_HANDLE_ERR;
+
+	memcpy(&hdr, data, sizeof(hdr));
+	if (hdr.version != MEMDB_TLV_VERSION || hdr.type != MEMDB_TLV_REQ)
+		return MEMDB_INVALID_REQ;
+
+	if (hdr.cmd >= CMD_MAX)
+		return MEMDB_METHOD_NOTFOUND;
+
+	if (hdr.db_name < 0 || hdr.db_name >= DB_MAX)
+		return MEMDB_INVALID_PARAMS;
+
+	req->jrpc_pkg.json = json_object();
+	params = memdb_tlv_get_object(data + sizeof(hdr), len - sizeof(hdr));
+	if (NULL == req->jrpc_pkg.json || NULL == params ||
+		JSON_SUCCESS != json_object_add(req->jrpc_pkg.json, "params", params)) {
+		if (params)
+			json_free(params);
+		if (req->jrpc_pkg.json)
+			json_free(req->jrpc_pkg.json);
+		req->jrpc_pkg.json = NULL;
+		return MEMDB_INVALID_PARAMS;
+	}
+
+	req->cmd = hdr.cmd;
+	req->db_name = hdr.db_name;
+	req->node_id = hdr.node_id;
+	req->lock_id = hdr.lock_id;
+	req->binary = 1;
+	req->jrpc_pkg.req_type = JSONRPC_REQ_NORMAL;
+	req->jrpc_pkg.id_type = JSONRPC_ID_TYPE_NORMAL;
+	req->jrpc_pkg.id = hdr.id;
+
+	return 0;
+}
+
+/**
+ * @brief: Send a MEMDB_TLV_HELLO/RSP/ERR packet, 'result' is encoded as
+ *         the body of a MEMDB_TLV_RSP and is not freed here.
+ */
+int memdb_tlv_send_rsp(int fd, int type, int cmd, int64 id, int64 code, json_t *result)
+{
+	struct memdb_tlv_hdr hdr = {};
+	struct memdb_tlv_buf buf;
+	int rc;
+
+	buf.data = malloc(MEMDB_TLV_MAX_LEN);
+	if (NULL == buf.data)
+		return -1;
+	buf.len = sizeof(hdr);
+	buf.size = MEMDB_TLV_MAX_LEN;
+
+	hdr.version = MEMDB_TLV_VERSION;
+	hdr.type = type;
+	hdr.cmd = cmd;
+	hdr.id = id;
+
+	if (type == MEMDB_TLV_RSP && result != NULL &&
+		memdb_tlv_put_members(&buf, result) != 0) {
+		/* reply does not fit in one packet */
+		hdr.type = MEMDB_TLV_ERR;
+		hdr.code = err_st_t[MEMDB_OEM_HANDLE_ERR].err_code;
+		buf.len = sizeof(hdr);
+	} else if (type == MEMDB_TLV_ERR)
+		hdr.code = code;
+
+	memcpy(buf.data, &hdr, sizeof(hdr));
+	rc = send(fd, buf.data, buf.len, MSG_NOSIGNAL);
+	free(buf.data);
+
+	return (rc == buf.len) ? 0 : -1;
+}
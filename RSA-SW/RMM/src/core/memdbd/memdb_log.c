@@ -16,12 +16,18 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <time.h>
 #include <sys/time.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 
 #include "memdb.h"
 #include "memdb_log.h"
+#include "snap.h"
 #include "libmemdb/node.h"
 #include "libutils/string.h"
 
@@ -33,11 +39,41 @@
 #define MEMDB_LOG_NAME_PREFIX_LEN	7
 #define MEMDB_LOG_DATA_PREFIX_LEN	7
 
+#define MEMDB_LOG_COPY_SIZE			(64 * 1024)
+
+/* poll interval for the end of a compaction */
+#define MEMDB_LOG_COMPACT_POLL_MS	100
+
 static int var_memdb_log_ok = 1;
 
 static int memdb_log_rmm_number;
 static int memdb_log_pod_number;
 
+struct memdb_wal {
+	const char *file;
+	char *snap_file;
+	int fd;
+	uint64 lsn;					/* of the last record */
+
+	int unsynced;				/* records not fsync'ed yet */
+	struct timespec first_unsynced;
+
+	pid_t compact_pid;			/* child writing the snapshot */
+	uint64 compact_lsn;			/* included in that snapshot */
+	off_t compact_off;			/* log size when it was forked */
+};
+
+static struct memdb_wal wal[DB_MAX] = {
+	[DB_RMM] = {MEMDB_LOG_RMM_FILE, FILE_SNAP, -1},
+	[DB_POD] = {MEMDB_LOG_POD_FILE, FILE_POD_SNAP, -1},
+};
+
+/* set while the log is replayed, so it is not logged again */
+static int wal_replaying;
+
+static unsigned char *rec_buf;
+static int rec_buf_size;
+
 int memdb_log_get_status(void)
 {
 	return var_memdb_log_ok;
@@ -63,128 +99,11 @@ void memdb_log_set_pod_number(int var)
 	memdb_log_pod_number = var;
 }
 
-static int get_local_time(char *output)
-{
-	struct tm *tm;
-	time_t timep;
-	char timestamp[128] = {0};
-
-	if (NULL == output)
-		return -1;
-
-	time(&timep);
-	tm = localtime(&timep);
-
-	snprintf(timestamp, sizeof(timestamp), "%d-%02d-%02dT%02d:%02d:%02d",
-				(tm->tm_year + 1900), (tm->tm_mon + 1), tm->tm_mday,
-				tm->tm_hour, tm->tm_min, tm->tm_sec);
-
-	memcpy(output, timestamp, 128);
-
-	return 0;
-}
-
 /**
- * @brief: when add/modify/remove node/attribute, write the operation to
- *         log file first.
+ * @brief: write the node and attributes read from a text log file of
+ *         the previous releases to the memdb.
  */
-int memdb_log(memdb_integer db_name, const char *file,
-			  void *param, int action)
-{
-	if (NULL == param)
-		return -1;
-
-	var_memdb_log_ok = 0;
-
-	int fd = -1;
-	char buf[MEMDB_LOG_MAX_LINE_SIZE] = {0};
-	int rc = -1;
-	int cnt = 0;
-	char cur_time[128] = {0};
-	struct node *node = NULL;
-	struct node_attr *attr = NULL;
-
-	if (DB_RMM == db_name) {
-		++memdb_log_rmm_number;
-	} else if (DB_POD == db_name) {
-		++memdb_log_pod_number;
-	} else {
-		MEMDB_ERR("Unknown memdb name\n");
-		var_memdb_log_ok = 1;
-		return -1;
-	}
-
-	fd = open(file, O_RDWR | O_CREAT | O_APPEND, S_IRWXU);
-	if (fd < 0) {
-		var_memdb_log_ok = 1;
-		return -1;
-	}
-
-	get_local_time(cur_time);
-
-	switch (action) {
-	case MEMDB_LOG_CREATE_NODE:
-		node = (struct node *)param;
-		cnt = snprintf(buf, sizeof(buf), "%s %d %lld %lld %lld\n",
-					  cur_time, action, node->node_id, node->parent->node_id, node->type);
-		break;
-	case MEMDB_LOG_DESTROY_NODE:
-		node = (struct node *)param;
-		cnt = snprintf(buf, sizeof(buf), "%s %d %lld\n", cur_time, action, node->node_id);
-		break;
-	case MEMDB_LOG_SET_ATTR:
-		attr = (struct node_attr *)param;
-		cnt = snprintf(buf, sizeof(buf), "%s %d %lld %lld %lld %lld %lld [name:]",
-					  cur_time, action, attr->node->node_id, attr->cookie,
-					  attr->type, attr->namelen, attr->datalen);
-		memcpy(buf + cnt, attr->name, attr->namelen);
-		cnt += attr->namelen;
-		strncpy_safe(buf + cnt, "[data:]", sizeof(buf) - cnt, 7);
-		cnt += 7;
-		memcpy(buf + cnt, attr->data, attr->datalen);
-		cnt += attr->datalen;
-
-		strncpy_safe(buf + cnt, "\n", sizeof(buf) - cnt, 1);
-		cnt += 1;
-
-		break;
-	case MEMDB_LOG_REMOVE_ATTR:
-		attr = (struct node_attr *)param;
-		cnt = snprintf(buf, sizeof(buf), "%s %d %lld %lld [name:]", cur_time, action, attr->node->node_id,
-					  attr->namelen);
-		memcpy(buf + cnt, attr->name, attr->namelen);
-		cnt += attr->namelen;
-
-		strncpy_safe(buf + cnt, "\n", sizeof(buf) - cnt, 1);
-		cnt += 1;
-		break;
-	default:
-		MEMDB_ERR("memdb log Unknown action\n");
-		break;
-	}
-
-	if (cnt <= 0)
-		goto err;
-
-	rc = write(fd, buf, cnt);
-	if (rc <= 0)
-		goto err;
-
-	close(fd);
-	var_memdb_log_ok = 1;
-	return 0;
-
-err:
-	close(fd);
-	var_memdb_log_ok = 1;
-
-	return -1;
-}
-
-/**
- * @brief: write the node and attributes read from the log file to the memdb.
- */
-int memdb_log_load(memdb_integer db_name, const char *file)
+static int memdb_log_load_text(memdb_integer db_name, const char *file)
 {
 	FILE *fp = NULL;
 	int rc = -1;
@@ -283,9 +202,491 @@ int memdb_log_load(memdb_integer db_name, const char *file)
 			MEMDB_ERR("Unknown action\n");
 			break;
 		}
+
+		/* apply the deferred destroy/remove */
+		publish_subscription();
 	}
 
 	fclose(fp);
 
 	return 0;
 }
+
+uint32 memdb_log_crc32(uint32 crc, const void *buf, int len)
+{
+	static uint32 table[256];
+	const unsigned char *p = buf;
+	uint32 c;
+	int i, k;
+
+	if (table[1] == 0) {
+		for (i = 0; i < 256; i++) {
+			c = i;
+			for (k = 0; k < 8; k++)
+				c = (c & 1) ? (0xedb88320 ^ (c >> 1)) : (c >> 1);
+			table[i] = c;
+		}
+	}
+
+	crc = ~crc;
+	while (len-- > 0)
+		crc = table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+	return ~crc;
+}
+
+static int ms_since(struct timespec *then)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - then->tv_sec) * 1000 +
+		   (now.tv_nsec - then->tv_nsec) / 1000000;
+}
+
+static int wal_write_hdr(int fd)
+{
+	struct memdb_log_file_hdr hdr = {MEMDB_LOG_MAGIC, MEMDB_LOG_VERSION};
+
+	return (write(fd, &hdr, sizeof(hdr)) == sizeof(hdr)) ? 0 : -1;
+}
+
+static int wal_open(memdb_integer db_name)
+{
+	struct memdb_wal *w = &wal[db_name];
+	struct memdb_log_file_hdr hdr = {};
+	struct stat sb;
+	int fd;
+
+	if (w->fd >= 0)
+		return 0;
+
+	fd = open(w->file, O_RDWR | O_CREAT | O_APPEND, S_IRWXU);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &sb) == 0 && sb.st_size > 0 &&
+		(pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+		 hdr.magic != MEMDB_LOG_MAGIC)) {
+		/* a text log which has not been replayed, it can not be appended */
+		MEMDB_ERR("discard unknown memdb log %s\n", w->file);
+		if (ftruncate(fd, 0) != 0)
+			goto err;
+		sb.st_size = 0;
+	}
+
+	if (sb.st_size == 0 && wal_write_hdr(fd) != 0)
+		goto err;
+
+	w->fd = fd;
+	return 0;
+
+err:
+	close(fd);
+	return -1;
+}
+
+static void wal_sync(struct memdb_wal *w)
+{
+	struct stat sb;
+
+	if (w->fd >= 0 && w->unsynced > 0)
+		fdatasync(w->fd);
+
+	w->unsynced = 0;
+
+	/* removed by a reset to defaults, start a new one */
+	if (w->fd >= 0 && w->compact_pid <= 0 &&
+		fstat(w->fd, &sb) == 0 && sb.st_nlink == 0) {
+		close(w->fd);
+		w->fd = -1;
+	}
+}
+
+/**
+ * @brief: when add/modify/remove node/attribute, write the operation to
+ *         log file first.
+ */
+int memdb_log(memdb_integer db_name, const char *file,
+			  void *param, int action)
+{
+	struct memdb_wal *w;
+	struct memdb_log_rec *rec;
+	struct node *node = NULL;
+	struct node_attr *attr = NULL;
+	int len = sizeof(*rec);
+	int rc = -1;
+
+	if (NULL == param || wal_replaying)
+		return wal_replaying ? 0 : -1;
+
+	if (DB_RMM == db_name) {
+		++memdb_log_rmm_number;
+	} else if (DB_POD == db_name) {
+		++memdb_log_pod_number;
+	} else {
+		MEMDB_ERR("Unknown memdb name\n");
+		return -1;
+	}
+
+	w = &wal[db_name];
+	w->file = file;
+
+	var_memdb_log_ok = 0;
+
+	if (action == MEMDB_LOG_SET_ATTR || action == MEMDB_LOG_REMOVE_ATTR) {
+		attr = (struct node_attr *)param;
+		len += attr->namelen + ((action == MEMDB_LOG_SET_ATTR) ? attr->datalen : 0);
+	} else
+		node = (struct node *)param;
+
+	if (len > rec_buf_size) {
+		unsigned char *p = realloc(rec_buf, len);
+
+		if (NULL == p)
+			goto out;
+		rec_buf = p;
+		rec_buf_size = len;
+	}
+
+	rec = (struct memdb_log_rec *)rec_buf;
+	memset(rec, 0, sizeof(*rec));
+	rec->len = len;
+	rec->lsn = w->lsn + 1;
+	rec->action = action;
+
+	switch (action) {
+	case MEMDB_LOG_CREATE_NODE:
+		rec->node_id = node->node_id;
+		rec->arg = node->parent->node_id;
+		rec->type = node->type;
+		break;
+	case MEMDB_LOG_DESTROY_NODE:
+		rec->node_id = node->node_id;
+		break;
+	case MEMDB_LOG_SET_ATTR:
+		rec->datalen = attr->datalen;
+		memcpy(rec->elems + attr->namelen, attr->data, attr->datalen);
+		/* fall through */
+	case MEMDB_LOG_REMOVE_ATTR:
+		rec->node_id = attr->node->node_id;
+		rec->arg = attr->cookie;
+		rec->type = attr->type;
+		rec->namelen = attr->namelen;
+		memcpy(rec->elems, attr->name, attr->namelen);
+		break;
+	default:
+		MEMDB_ERR("memdb log Unknown action\n");
+		goto out;
+	}
+
+	rec->crc = memdb_log_crc32(0, &rec->len, len - sizeof(rec->crc));
+
+	if (wal_open(db_name) != 0 || write(w->fd, rec, len) != len) {
+		MEMDB_ERR("write memdb log %s failed\n", file);
+		goto out;
+	}
+
+	w->lsn = rec->lsn;
+	if (w->unsynced++ == 0)
+		clock_gettime(CLOCK_MONOTONIC, &w->first_unsynced);
+	if (w->unsynced >= MEMDB_LOG_COMMIT_BATCH)
+		wal_sync(w);
+	rc = 0;
+
+out:
+	var_memdb_log_ok = 1;
+	return rc;
+}
+
+/**
+ * @brief: Drop the records included in the snapshot just written: the
+ *         records logged since the compaction started are copied to a
+ *         new log which replaces the current one.
+ */
+static int wal_trim(struct memdb_wal *w)
+{
+	char tmp_file[128];
+	char *buf = NULL;
+	off_t off = w->compact_off;
+	int fd = -1;
+	int cnt;
+
+	snprintf(tmp_file, sizeof(tmp_file), "%s.tmp", w->file);
+
+	buf = malloc(MEMDB_LOG_COPY_SIZE);
+	fd = open(tmp_file, O_RDWR | O_CREAT | O_TRUNC, S_IRWXU);
+	if (NULL == buf || fd < 0 || wal_write_hdr(fd) != 0)
+		goto err;
+
+	while ((cnt = pread(w->fd, buf, MEMDB_LOG_COPY_SIZE, off)) > 0) {
+		if (write(fd, buf, cnt) != cnt)
+			goto err;
+		off += cnt;
+	}
+
+	if (cnt < 0 || fdatasync(fd) != 0 || rename(tmp_file, w->file) != 0)
+		goto err;
+
+	close(w->fd);
+	w->fd = fd;
+	w->unsynced = 0;
+	lseek(fd, 0, SEEK_END);
+	/* O_APPEND was left out for the copy */
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_APPEND);
+	free(buf);
+
+	return 0;
+
+err:
+	MEMDB_ERR("trim memdb log %s failed\n", w->file);
+	if (fd >= 0) {
+		close(fd);
+		unlink(tmp_file);
+	}
+	free(buf);
+
+	return -1;
+}
+
+/**
+ * @brief: Write a snapshot of the memdb in a forked child, so that the
+ *         request processing goes on while it is written. The log is
+ *         trimmed when memdb_log_commit() sees the child has finished.
+ */
+int memdb_log_compact(memdb_integer db_name)
+{
+	struct memdb_wal *w;
+	struct stat sb;
+	pid_t pid;
+
+	if (db_name != DB_RMM && db_name != DB_POD)
+		return -1;
+
+	w = &wal[db_name];
+	if (w->compact_pid > 0 || wal_open(db_name) != 0 || fstat(w->fd, &sb) != 0)
+		return -1;
+
+	if (DB_RMM == db_name)
+		memdb_log_rmm_number = 0;
+	else
+		memdb_log_pod_number = 0;
+
+	w->compact_lsn = w->lsn;
+	w->compact_off = sb.st_size;
+
+	pid = fork();
+	if (pid == 0)
+		_exit(memdb_node_snap(w->snap_file, db_name, w->compact_lsn) < 0 ? 1 : 0);
+
+	if (pid < 0) {
+		MEMDB_ERR("fork failed, write the snapshot in place\n");
+		if (memdb_node_snap(w->snap_file, db_name, w->compact_lsn) < 0)
+			return -1;
+		return wal_trim(w);
+	}
+
+	w->compact_pid = pid;
+	return 0;
+}
+
+static void wal_reap(struct memdb_wal *w, int options)
+{
+	int status;
+
+	if (w->compact_pid <= 0 || waitpid(w->compact_pid, &status, options) != w->compact_pid)
+		return;
+
+	w->compact_pid = 0;
+	if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+		wal_trim(w);
+	else
+		MEMDB_ERR("memdb snapshot %s failed\n", w->snap_file);
+}
+
+/**
+ * @brief: Called from the request loop: fsync the logs whose oldest
+ *         record waits for MEMDB_LOG_COMMIT_MS and finish the compactions.
+ *         Return the ms until it needs to be called again, -1 if idle.
+ */
+int memdb_log_commit(void)
+{
+	struct memdb_wal *w;
+	int wait_ms = -1;
+	int left;
+	int db;
+
+	for (db = 0; db < DB_MAX; db++) {
+		w = &wal[db];
+
+		wal_reap(w, WNOHANG);
+		if (w->compact_pid > 0)
+			wait_ms = MEMDB_LOG_COMPACT_POLL_MS;
+
+		if (w->unsynced == 0)
+			continue;
+
+		left = MEMDB_LOG_COMMIT_MS - ms_since(&w->first_unsynced);
+		if (left <= 0) {
+			wal_sync(w);
+			continue;
+		}
+
+		if (wait_ms < 0 || left < wait_ms)
+			wait_ms = left;
+	}
+
+	return wait_ms;
+}
+
+/**
+ * @brief: Make the log durable and let a running compaction finish,
+ *         before memdbd exits.
+ */
+void memdb_log_shutdown(void)
+{
+	int db;
+
+	for (db = 0; db < DB_MAX; db++) {
+		wal_sync(&wal[db]);
+		wal_reap(&wal[db], 0);
+	}
+}
+
+static int apply_rec(memdb_integer db_name, struct memdb_log_rec *rec)
+{
+	struct node *parent = NULL;
+	struct node *node = NULL;
+
+	if (rec->action == MEMDB_LOG_CREATE_NODE) {
+		parent = find_node_by_node_id(db_name, rec->arg);
+		if (NULL == parent)
+			return -1;
+		if (NULL == insert_node_with_node_id(db_name, parent, rec->node_id,
+											 rec->type, SNAPSHOT_NEED))
+			return -1;
+		return 0;
+	}
+
+	node = find_node_by_node_id(db_name, rec->node_id);
+	if (NULL == node)
+		return -1;
+
+	switch (rec->action) {
+	case MEMDB_LOG_DESTROY_NODE:
+		destroy_node(db_name, node);
+		break;
+	case MEMDB_LOG_SET_ATTR:
+		if (set_node_attr(db_name, node, rec->arg,
+						  rec->elems, rec->namelen,
+						  rec->elems + rec->namelen, rec->datalen,
+						  SNAPSHOT_NEED, rec->type) != 0)
+			return -1;
+		break;
+	case MEMDB_LOG_REMOVE_ATTR:
+		remove_node_attr(db_name, node, rec->elems, rec->namelen);
+		break;
+	default:
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief: Replay the records after 'snap_lsn'. The log is cut after the
+ *         last good record, a torn one at the end is left by a crash.
+ */
+static int memdb_log_load(memdb_integer db_name, const char *file, uint64 snap_lsn)
+{
+	struct memdb_wal *w = &wal[db_name];
+	struct memdb_log_file_hdr *hdr;
+	struct memdb_log_rec *rec;
+	unsigned char *map;
+	struct stat sb;
+	off_t off;
+	int fd;
+
+	w->lsn = snap_lsn;
+
+	fd = open(file, O_RDWR);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &sb) != 0 || sb.st_size < sizeof(*hdr)) {
+		close(fd);
+		return -1;
+	}
+
+	map = mmap(NULL, sb.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		close(fd);
+		return -1;
+	}
+
+	hdr = (struct memdb_log_file_hdr *)map;
+	if (hdr->magic != MEMDB_LOG_MAGIC) {
+		munmap(map, sb.st_size);
+		close(fd);
+
+		/* written by a previous release, keep it in a snapshot instead */
+		wal_replaying = 1;
+		memdb_log_load_text(db_name, file);
+		wal_replaying = 0;
+		if (memdb_node_snap(w->snap_file, db_name, w->lsn) >= 0)
+			unlink(file);
+		return 0;
+	}
+
+	wal_replaying = 1;
+	for (off = sizeof(*hdr); off + sizeof(*rec) <= sb.st_size; off += rec->len) {
+		rec = (struct memdb_log_rec *)(map + off);
+		if (rec->len < sizeof(*rec) || rec->len > sb.st_size - off ||
+			rec->len < sizeof(*rec) + rec->namelen + rec->datalen ||
+			rec->crc != memdb_log_crc32(0, &rec->len, rec->len - sizeof(rec->crc)))
+			break;
+
+		if (rec->lsn > w->lsn)
+			w->lsn = rec->lsn;
+		if (rec->lsn <= snap_lsn)
+			continue;
+
+		if (apply_rec(db_name, rec) != 0)
+			MEMDB_ERR("memdb log record %llu not applied\n", rec->lsn);
+
+		/* apply the deferred destroy/remove */
+		publish_subscription();
+	}
+	wal_replaying = 0;
+
+	if (off != sb.st_size) {
+		MEMDB_ERR("memdb log %s cut at %ld of %ld\n", file, (long)off, (long)sb.st_size);
+		if (ftruncate(fd, off) != 0)
+			MEMDB_ERR("truncate %s failed\n", file);
+	}
+
+	munmap(map, sb.st_size);
+	close(fd);
+
+	return 0;
+}
+
+/**
+ * @brief: Load the snapshot of a memdb, then the log records after it.
+ */
+int memdb_log_recover(memdb_integer db_name, char *snap_file)
+{
+	uint64 snap_lsn = 0;
+
+	if (db_name != DB_RMM && db_name != DB_POD)
+		return -1;
+
+	wal[db_name].snap_file = snap_file;
+
+	wal_replaying = 1;
+	memdb_node_load(snap_file, db_name, &snap_lsn);
+	publish_subscription();
+	wal_replaying = 0;
+
+	return memdb_log_load(db_name, wal[db_name].file, snap_lsn);
+}
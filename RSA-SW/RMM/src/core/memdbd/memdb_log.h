@@ -26,7 +26,41 @@
 #define MEMDB_LOG_RMM_FILE			"/var/memdb/memdb_rmm_update.log"
 #define MEMDB_LOG_POD_FILE			"/var/memdb/memdb_pod_update.log"
 
-#define MEMDB_LOG_MAX_NUMBER		20
+/* records logged before the snapshot is rewritten and the log trimmed */
+#define MEMDB_LOG_MAX_NUMBER		4096
+
+/*
+ * Records are written when they are logged, the fsync of the log is
+ * shared by up to MEMDB_LOG_COMMIT_BATCH records or MEMDB_LOG_COMMIT_MS.
+ */
+#define MEMDB_LOG_COMMIT_BATCH		64
+#define MEMDB_LOG_COMMIT_MS			50
+
+#define MEMDB_LOG_MAGIC				0x4d44424c	/* "MDBL" */
+#define MEMDB_LOG_VERSION			1
+
+struct memdb_log_file_hdr {
+	uint32 magic;
+	uint32 version;
+};
+
+/*
+ * The log is the file header followed by these records. 'lsn' grows by
+ * one per record, a snapshot records the last lsn it includes so that
+ * the records before it are skipped when the log is replayed.
+ */
+struct memdb_log_rec {
+	uint32 crc;				/* crc32 of the record from 'len' on */
+	uint32 len;				/* of the whole record */
+	uint64 lsn;
+	uint32 action;
+	uint16 namelen;
+	uint16 datalen;
+	memdb_integer node_id;
+	memdb_integer arg;		/* parent of a node, cookie of an attribute */
+	memdb_integer type;
+	unsigned char elems[0];	/* name, then data */
+};
 
 extern int memdb_log_get_status(void);
 extern int memdb_log_get_rmm_number(void);
@@ -35,6 +69,10 @@ extern void memdb_log_set_rmm_number(int var);
 extern void memdb_log_set_pod_number(int var);
 extern int memdb_log(memdb_integer db_name, const char *file,
 					 void *param, int action);
-extern int memdb_log_load(memdb_integer db_name, const char *file);
+extern int memdb_log_recover(memdb_integer db_name, char *snap_file);
+extern int memdb_log_compact(memdb_integer db_name);
+extern int memdb_log_commit(void);
+extern void memdb_log_shutdown(void);
+extern uint32 memdb_log_crc32(uint32 crc, const void *buf, int len);
 
 #endif
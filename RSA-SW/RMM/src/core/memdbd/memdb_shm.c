@@ -0,0 +1,270 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "memdb.h"
+#include "memdb_shm.h"
+#include "libmemdb/node.h"
+#include "libmemdb/memdb_shm.h"
+
+static struct memdb_shm_hdr *shm;
+static unsigned long failed_gen;
+static struct timespec last_publish;
+
+/**
+ * @brief: Map the snapshot segment. An existing segment is reused, so
+ *         clients which mapped it before a memdbd restart keep working.
+ */
+int memdb_shm_init(void)
+{
+	int fd;
+
+	fd = shm_open(MEMDB_SHM_NAME, O_CREAT | O_RDWR, 0644);
+	if (fd < 0) {
+		MEMDB_ERR("shm_open %s failed\n", MEMDB_SHM_NAME);
+		return -1;
+	}
+
+	if (ftruncate(fd, MEMDB_SHM_SIZE) < 0) {
+		MEMDB_ERR("ftruncate %s failed\n", MEMDB_SHM_NAME);
+		close(fd);
+		return -1;
+	}
+
+	shm = mmap(NULL, MEMDB_SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (shm == MAP_FAILED) {
+		MEMDB_ERR("mmap %s failed\n", MEMDB_SHM_NAME);
+		shm = NULL;
+		return -1;
+	}
+
+	/* nothing is readable until the first snapshot is published */
+	shm->active = -1;
+	__sync_synchronize();
+	shm->magic = MEMDB_SHM_MAGIC;
+	shm->buf_size = MEMDB_SHM_BUF_SIZE;
+	shm->locked = 0;
+	shm->write_gen++;
+
+	return 0;
+}
+
+/**
+ * @brief: Called before replying to any request that changes memdb,
+ *         it makes the published snapshot stale for every reader.
+ */
+void memdb_shm_touch(void)
+{
+	if (shm == NULL)
+		return;
+
+	shm->write_gen++;
+	__sync_synchronize();
+}
+
+void memdb_shm_set_locked(int locked)
+{
+	if (shm == NULL)
+		return;
+
+	shm->locked = locked;
+	__sync_synchronize();
+}
+
+static int cmp_node_id(const void *a, const void *b)
+{
+	const struct node *na = *(struct node * const *)a;
+	const struct node *nb = *(struct node * const *)b;
+
+	if (na->node_id < nb->node_id)
+		return -1;
+
+	return na->node_id > nb->node_id;
+}
+
+static void *buf_alloc(struct memdb_shm_buf *b, unsigned int size)
+{
+	void *p;
+
+	size = MEMDB_SHM_ALIGN(size);
+	if (b->used + size > MEMDB_SHM_BUF_SIZE)
+		return NULL;
+
+	p = b->data + b->used;
+	b->used += size;
+
+	return p;
+}
+
+static int build_node(struct memdb_shm_buf *b, struct memdb_shm_node *sn, struct node *n)
+{
+	struct node_attr *pa;
+	struct node *child;
+	struct memdb_shm_attr *sa;
+	memdb_integer *ids;
+	unsigned int size;
+
+	sn->node_id = n->node_id;
+	sn->parent = n->parent ? n->parent->node_id : 0;
+	sn->type = n->type;
+	sn->snapshot_flag = n->snapshot_flag;
+
+	sn->attr_off = b->used;
+	sn->attr_num = 0;
+	list_for_each_entry(pa, &n->attrs, group) {
+		size = MEMDB_SHM_ALIGN(sizeof(*sa) + pa->namelen + pa->datalen);
+		sa = buf_alloc(b, size);
+		if (sa == NULL)
+			return -1;
+
+		sa->cookie = pa->cookie;
+		sa->next_offset = size;
+		sa->namelen = pa->namelen;
+		sa->datalen = pa->datalen;
+		memcpy(sa->elems, pa->name, pa->namelen);
+		memcpy(sa->elems + pa->namelen, pa->data, pa->datalen);
+		sn->attr_num++;
+	}
+
+	sn->child_num = 0;
+	list_for_each_entry(child, &n->children, sibling)
+		sn->child_num++;
+
+	ids = buf_alloc(b, sn->child_num * sizeof(memdb_integer));
+	if (ids == NULL)
+		return -1;
+	sn->child_off = (char *)ids - b->data;
+
+	list_for_each_entry(child, &n->children, sibling)
+		*ids++ = child->node_id;
+
+	return 0;
+}
+
+static int build_db(struct memdb_shm_buf *b, int db_name)
+{
+	struct list_head *which_node = (DB_POD == db_name) ? &pod_node_list : &node_list;
+	struct memdb_shm_node *table;
+	struct node **nodes;
+	struct node *n;
+	int num = 0;
+	int i;
+	int rc = 0;
+
+	list_for_each_entry(n, which_node, list)
+		num++;
+
+	nodes = malloc((num ? num : 1) * sizeof(struct node *));
+	if (nodes == NULL)
+		return -1;
+
+	i = 0;
+	list_for_each_entry(n, which_node, list)
+		nodes[i++] = n;
+	qsort(nodes, num, sizeof(struct node *), cmp_node_id);
+
+	table = buf_alloc(b, num * sizeof(struct memdb_shm_node));
+	if (table == NULL) {
+		free(nodes);
+		return -1;
+	}
+	b->node_off[db_name] = (char *)table - b->data;
+	b->node_num[db_name] = num;
+
+	for (i = 0; i < num; i++) {
+		rc = build_node(b, &table[i], nodes[i]);
+		if (rc != 0)
+			break;
+	}
+
+	free(nodes);
+	return rc;
+}
+
+static long ms_since(struct timespec *ts)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - ts->tv_sec) * 1000 + (now.tv_nsec - ts->tv_nsec) / 1000000;
+}
+
+/**
+ * @brief: Rebuild the inactive buffer from the current memdb and make
+ *         it active, at most once per MEMDB_SHM_PUBLISH_MS.
+ *
+ * @return: -1 if the snapshot is up to date, otherwise the number of
+ *          milliseconds to wait before calling again.
+ */
+int memdb_shm_publish(void)
+{
+	struct memdb_shm_buf *b;
+	unsigned long gen;
+	long elapsed;
+	int idx;
+	int db;
+	int rc = 0;
+
+	if (shm == NULL)
+		return -1;
+
+	gen = shm->write_gen;
+	if ((shm->active >= 0 && shm->buf[shm->active].gen == gen) || failed_gen == gen)
+		return -1;
+
+	elapsed = ms_since(&last_publish);
+	if (elapsed >= 0 && elapsed < MEMDB_SHM_PUBLISH_MS)
+		return MEMDB_SHM_PUBLISH_MS - elapsed;
+
+	idx = (shm->active == 0) ? 1 : 0;
+	b = &shm->buf[idx];
+
+	b->seq++;
+	__sync_synchronize();
+
+	b->used = 0;
+	for (db = 0; db < DB_MAX; db++) {
+		rc = build_db(b, db);
+		if (rc != 0)
+			break;
+	}
+	b->gen = gen;
+
+	__sync_synchronize();
+	b->seq++;
+
+	clock_gettime(CLOCK_MONOTONIC, &last_publish);
+
+	if (rc != 0) {
+		/* readers keep falling back to the socket until memdb changes */
+		MEMDB_ERR("memdb snapshot exceeds %d bytes\n", MEMDB_SHM_BUF_SIZE);
+		failed_gen = gen;
+		return -1;
+	}
+
+	shm->active = idx;
+	__sync_synchronize();
+
+	return -1;
+}
@@ -0,0 +1,125 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "libmemdb/memdb.h"
+#include "libutils/rmm.h"
+
+/*
+ * attrbute_set_multi and attrbute_get_multi against a running memdbd. A
+ * set_multi with an entry for a missing node must not store any of its
+ * attributes, the entries before the bad one included.
+ *
+ *     memdbmultitest
+ */
+#define MISSING_NODE	((memdb_integer)0x7fffffff)
+
+static int check_attr(memdb_integer node, char *name, char *expected)
+{
+	char attrs[1024];
+	char *data = NULL;
+	int size = sizeof(attrs);
+
+	if (libdb_attr_get_multi(DB_RMM, node, &name, 1, 0, attrs, &size, LOCK_ID_NULL) != 0) {
+		printf("FAIL: get_multi of %s\n", name);
+		return -1;
+	}
+
+	data = libdb_attr_find(attrs, size, node, name);
+	if (expected == NULL && data == NULL)
+		return 0;
+	if (expected == NULL || data == NULL || strcmp(data, expected) != 0) {
+		printf("FAIL: %s is \"%s\", expected \"%s\"\n", name,
+			   data ? data : "(none)", expected ? expected : "(none)");
+		return -1;
+	}
+
+	return 0;
+}
+
+static int test_set_multi(memdb_integer node, memdb_integer child)
+{
+	struct attr_set_entry entries[] = {
+		{"multi_a", "1", 0, 0},
+		{"multi_b", "2", 0, 0},
+		{"multi_c", "3", 0, 0},
+	};
+
+	entries[2].node = child;
+	if (libdb_attr_set_multi(DB_RMM, node, entries, 3, SNAPSHOT_NEED_NOT, LOCK_ID_NULL) != 0) {
+		printf("FAIL: set_multi\n");
+		return -1;
+	}
+
+	if (check_attr(node, "multi_a", "1") || check_attr(node, "multi_b", "2") ||
+		check_attr(child, "multi_c", "3") || check_attr(node, "multi_c", NULL))
+		return -1;
+
+	return 0;
+}
+
+static int test_set_multi_missing_node(memdb_integer node)
+{
+	struct attr_set_entry entries[] = {
+		{"multi_a", "10", 0, 0},
+		{"multi_b", "20", 0, 0},
+		{"multi_d", "40", 0, 0},
+	};
+
+	entries[2].node = MISSING_NODE;
+	if (libdb_attr_set_multi(DB_RMM, node, entries, 3, SNAPSHOT_NEED_NOT, LOCK_ID_NULL) == 0) {
+		printf("FAIL: set_multi with a missing node succeeded\n");
+		return -1;
+	}
+
+	if (check_attr(node, "multi_a", "1") || check_attr(node, "multi_b", "2") ||
+		check_attr(node, "multi_d", NULL))
+		return -1;
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	memdb_integer node;
+	memdb_integer child;
+	int rc = 0;
+
+	libdb_init();
+
+	node = libdb_create_node(DB_RMM, MC_NODE_ROOT, MC_TYPE_CM,
+							 SNAPSHOT_NEED_NOT, LOCK_ID_NULL);
+	child = libdb_create_node(DB_RMM, node, MC_TYPE_CM,
+							  SNAPSHOT_NEED_NOT, LOCK_ID_NULL);
+	if (node == 0 || child == 0) {
+		printf("FAIL: cannot create the test nodes\n");
+		return -1;
+	}
+
+	rc = test_set_multi(node, child);
+	if (rc == 0)
+		rc = test_set_multi_missing_node(node);
+	if (rc == 0)
+		printf("PASS\n");
+
+	/* do not leave the test nodes in the snapshot */
+	libdb_destroy_node(DB_RMM, node, LOCK_ID_NULL);
+	libdb_exit_memdb();
+
+	return rc;
+}
@@ -21,6 +21,7 @@
 #include "memdb.h"
 #include "snap.h"
 #include "memdb_log.h"
+#include "memdb_shm.h"
 #include "libutils/types.h"
 #include "libmemdb/event.h"
 #include "libmemdb/node.h"
@@ -43,6 +44,24 @@ struct list_head pod_attr_list = LIST_HEAD_INIT(pod_attr_list);
 
 static unsigned long g_node_number = 10000000;
 
+/* Node ids are allocated sequentially, so the low bits spread them evenly. */
+#define NODE_HASH_SIZE		1024
+
+static struct list_head node_hash[DB_MAX][NODE_HASH_SIZE];
+
+/*
+ * Secondary index of the attributes named in 'indexed_attrs', keyed by
+ * name and value, so that find_node_by_attr() does not have to walk
+ * every attribute. It follows set_node_attr() and the attribute removal.
+ */
+#define ATTR_INDEX_SIZE		1024
+
+static char *indexed_attrs[] = {
+	"uuid",
+};
+
+static struct list_head attr_index[DB_MAX][ATTR_INDEX_SIZE];
+
 struct node rmm_root = {
 	.node_id	= 0,
 	.type		= 0,
@@ -63,6 +82,68 @@ struct node pod_root = {
 	.attrs		= LIST_HEAD_INIT(pod_root.attrs),
 };
 
+static inline struct list_head *node_hash_bucket(memdb_integer db_name,
+												 memdb_integer node_id)
+{
+	return &node_hash[db_name][(unsigned long long)node_id & (NODE_HASH_SIZE - 1)];
+}
+
+static unsigned int attr_name_hash(const char *name)
+{
+	unsigned int hash = 5381;
+
+	while (*name)
+		hash = hash * 33 + (unsigned char)*name++;
+
+	return hash;
+}
+
+static unsigned int attr_value_hash(unsigned int name_hash,
+									unsigned char *data, int datalen)
+{
+	unsigned int hash = name_hash;
+	int i;
+
+	for (i = 0; i < datalen; i++)
+		hash = hash * 33 + data[i];
+
+	return hash;
+}
+
+static int attr_is_indexed(struct node_attr *pa)
+{
+	int i;
+
+	for (i = 0; i < sizeof(indexed_attrs) / sizeof(indexed_attrs[0]); i++) {
+		if (strcmp(pa->name, indexed_attrs[i]) == 0)
+			return 1;
+	}
+
+	return 0;
+}
+
+/* the value of 'pa' has changed, move it to its new bucket */
+static void index_attr(memdb_integer db_name, struct node_attr *pa)
+{
+	unsigned int h;
+
+	list_del(&pa->index);
+	INIT_LIST_HEAD(&pa->index);
+	if (!attr_is_indexed(pa))
+		return;
+
+	h = attr_value_hash(pa->name_hash, pa->data, pa->datalen);
+	list_add_tail(&pa->index, &attr_index[db_name][h & (ATTR_INDEX_SIZE - 1)]);
+}
+
+static void init_attr_hash(struct node *n)
+{
+	int i;
+
+	for (i = 0; i < NODE_ATTR_HASH_SIZE; i++)
+		INIT_LIST_HEAD(&n->attr_hash[i]);
+}
+
 static void type_int2str(memdb_integer type, char *type_str, uint32 len)
 {
 	if (type > MC_TYPE_END || type < MC_TYPE_RMC)
@@ -260,11 +341,14 @@ static void delete_node(memdb_integer db_name, struct node *root)
 
 		list_del(&pa->group);
 		list_del(&pa->list);
+		list_del(&pa->hash);
+		list_del(&pa->index);
 		free(pa);
 	}
 
 	list_del(&root->list);
 	list_del(&root->sibling);
+	list_del(&root->hash);
 
 	node_delete_notify(db_name, root);
 
@@ -307,15 +391,19 @@ struct node *insert_node(memdb_integer db_name, struct node *parent, memdb_integ
 
 	INIT_LIST_HEAD(&n->attrs);
 	INIT_LIST_HEAD(&n->children);
+	init_attr_hash(n);
+	memdb_shm_touch();
 
 	if (DB_RMM == db_name) {
 		list_add_tail(&n->list, &node_list);
 		list_add_tail(&n->sibling, &parent->children);
+		list_add_tail(&n->hash, node_hash_bucket(db_name, n->node_id));
 
 		new_node = n;
 	} else if (DB_POD == db_name) {
 		list_add_tail(&n->list, &pod_node_list);
 		list_add_tail(&n->sibling, &parent->children);
+		list_add_tail(&n->hash, node_hash_bucket(db_name, n->node_id));
 
 		new_pod_node = n;
 	} else {
@@ -339,6 +427,7 @@ struct node *insert_node_with_node_id(memdb_integer db_name, struct node *parent
 
 	n = find_node_by_node_id(db_name, node_id);
 	if (NULL != n) {
+		memdb_shm_touch();
 		n->snapshot_flag = snapshot_flag;
 		if (SNAPSHOT_NEED == snapshot_flag)
 			update_node_snapshot_mask(n->parent);
@@ -364,15 +453,19 @@ struct node *insert_node_with_node_id(memdb_integer db_name, struct node *parent
 
 	INIT_LIST_HEAD(&n->attrs);
 	INIT_LIST_HEAD(&n->children);
+	init_attr_hash(n);
+	memdb_shm_touch();
 
 	if (DB_RMM == db_name) {
 		list_add_tail(&n->list, &node_list);
 		list_add_tail(&n->sibling, &parent->children);
+		list_add_tail(&n->hash, node_hash_bucket(db_name, n->node_id));
 
 		new_node = n;
 	} else if (DB_POD == db_name) {
 		list_add_tail(&n->list, &pod_node_list);
 		list_add_tail(&n->sibling, &parent->children);
+		list_add_tail(&n->hash, node_hash_bucket(db_name, n->node_id));
 
 		new_pod_node = n;
 	} else {
@@ -386,6 +479,8 @@ struct node *insert_node_with_node_id(memdb_integer db_name, struct node *parent
 
 void destroy_node(memdb_integer db_name, struct node *root)
 {
+	memdb_shm_touch();
+
 	if (DB_RMM == db_name)
 		freeing_node = root;
 	else if (DB_POD == db_name)
@@ -514,18 +609,13 @@ void dump_all_nodes(memdb_integer db_name)
 struct node *find_node_by_node_id(memdb_integer db_name, memdb_integer node_id)
 {
 	struct node *n;
-	struct list_head *node_list_search = NULL;
 
-	if (DB_RMM == db_name) {
-		node_list_search = &node_list;
-	} else if (DB_POD == db_name) {
-		node_list_search = &pod_node_list;
-	} else {
+	if (DB_RMM != db_name && DB_POD != db_name) {
 		MEMDB_ERR("No matched DB to find thd node\n");
 		return NULL;
 	}
 
-	list_for_each_entry(n, node_list_search, list) {
+	list_for_each_entry(n, node_hash_bucket(db_name, node_id), hash) {
 		if (n->node_id == node_id)
 			return n;
 	}
@@ -533,14 +623,63 @@ struct node *find_node_by_node_id(memdb_integer db_name, memdb_integer node_id)
 	return NULL;
 }
 
+/**
+ * @brief: Find the node which has attribute 'name' set to 'data'. The
+ *         indexed names are looked up in the index, the others by walking
+ *         all the attributes.
+ */
+struct node *find_node_by_attr(memdb_integer db_name, char *name,
+							   unsigned char *data, unsigned short datalen)
+{
+	struct node_attr *pa;
+	struct list_head *which_attr = &attr_list;
+	unsigned int name_hash = attr_name_hash(name);
+	unsigned int h;
+	int i;
+
+	if (DB_RMM != db_name && DB_POD != db_name) {
+		MEMDB_ERR("No matched DB to find the node\n");
+		return NULL;
+	}
+
+	for (i = 0; i < sizeof(indexed_attrs) / sizeof(indexed_attrs[0]); i++) {
+		if (strcmp(name, indexed_attrs[i]) != 0)
+			continue;
+
+		h = attr_value_hash(name_hash, data, datalen);
+		list_for_each_entry(pa, &attr_index[db_name][h & (ATTR_INDEX_SIZE - 1)], index) {
+			if (pa->name_hash == name_hash && pa->datalen == datalen &&
+				strcmp(pa->name, name) == 0 &&
+				memcmp(pa->data, data, datalen) == 0)
+				return pa->node;
+		}
+
+		return NULL;
+	}
+
+	if (DB_POD == db_name)
+		which_attr = &pod_attr_list;
+
+	list_for_each_entry(pa, which_attr, list) {
+		if (pa->name_hash == name_hash && pa->datalen == datalen &&
+			strcmp(pa->name, name) == 0 &&
+			memcmp(pa->data, data, datalen) == 0)
+			return pa->node;
+	}
+
+	return NULL;
+}
+
 
 static inline struct node_attr *find_attr_item(struct node *node, char *name,
 		unsigned short namelen)
 {
 	struct node_attr *pa;
+	unsigned int h = attr_name_hash(name);
 
-	list_for_each_entry(pa, &node->attrs, group) {
-		if (pa->namelen == namelen &&
+	list_for_each_entry(pa, &node->attr_hash[h & (NODE_ATTR_HASH_SIZE - 1)], hash) {
+		if (pa->name_hash == h &&
+		    pa->namelen == namelen &&
 		    strcmp(pa->name, name) == 0)
 			return pa;
 	}
@@ -568,6 +707,8 @@ int set_node_attr(memdb_integer db_name, struct node *node, memdb_integer cookie
 
 	name[namelen - 1] = '\0';	/* paranoia ;-) */
 
+	memdb_shm_touch();
+
 	if (DB_RMM == db_name) {
 		curr_attr_action = EVENT_ATTR_ACTION_MOD;
 		if (node->node_id == 0) {
@@ -600,7 +741,11 @@ int set_node_attr(memdb_integer db_name, struct node *node, memdb_integer cookie
 		pa->snapshot_flag = snapshot_flag;
 		pa->type = type;
 		memcpy(pa->name, name, namelen);
+		pa->name_hash = attr_name_hash(pa->name);
+		INIT_LIST_HEAD(&pa->index);
 		list_add_tail(&pa->group, &node->attrs);
+		list_add_tail(&pa->hash,
+			&node->attr_hash[pa->name_hash & (NODE_ATTR_HASH_SIZE - 1)]);
 
 		if (DB_RMM == db_name) {
 			list_add_tail(&pa->list, &attr_list);
@@ -632,6 +777,7 @@ int set_node_attr(memdb_integer db_name, struct node *node, memdb_integer cookie
 
 	pa->cookie = cookie;
 	memcpy(pa->data, data, datalen);
+	index_attr(db_name, pa);
 
 	if (DB_RMM == db_name)
 		curr_attr = pa;
@@ -671,6 +817,8 @@ static void del_node_attr(struct node_attr *pa)
 
 	list_del(&pa->group);
 	list_del(&pa->list);
+	list_del(&pa->hash);
+	list_del(&pa->index);
 	free(pa);
 }
 
@@ -679,25 +827,23 @@ int remove_node_attr(memdb_integer db_name, struct node *node, unsigned char *na
 {
 	struct node_attr *pa;
 
-	list_for_each_entry(pa, &node->attrs, group) {
-		if (pa->namelen != namelen || strcmp(pa->name, (char *)name) != 0)
-			continue;
-
-		clock_gettime(CLOCK_MONOTONIC, &(node->create_time));
+	pa = find_attr_item(node, (char *)name, namelen);
+	if (pa == NULL)
+		return 0;
 
-		if (DB_RMM == db_name) {
-			curr_attr = pa;
-			curr_attr_action = EVENT_ATTR_ACTION_DEL;
-		} else if (DB_POD == db_name) {
-			curr_pod_attr = pa;
-			curr_pod_attr_action = EVENT_ATTR_ACTION_DEL;
-		} else
-			return 0;
+	clock_gettime(CLOCK_MONOTONIC, &(node->create_time));
+	memdb_shm_touch();
 
-		return 1;
-	}
+	if (DB_RMM == db_name) {
+		curr_attr = pa;
+		curr_attr_action = EVENT_ATTR_ACTION_DEL;
+	} else if (DB_POD == db_name) {
+		curr_pod_attr = pa;
+		curr_pod_attr_action = EVENT_ATTR_ACTION_DEL;
+	} else
+		return 0;
 
-	return 0;
+	return 1;
 }
 
 void publish_subscription(void)
@@ -785,21 +931,29 @@ void publish_subscription(void)
 		curr_pod_attr_action = 0;
 	}
 
-	if (MEMDB_LOG_MAX_NUMBER <= memdb_log_get_rmm_number()) {
-		memdb_node_snap(FILE_SNAP, DB_RMM);
-		unlink(MEMDB_LOG_RMM_FILE);
-		memdb_log_set_rmm_number(0);
-	}
+	if (MEMDB_LOG_MAX_NUMBER <= memdb_log_get_rmm_number())
+		memdb_log_compact(DB_RMM);
 
-	if (MEMDB_LOG_MAX_NUMBER <= memdb_log_get_pod_number()) {
-		memdb_node_snap(FILE_POD_SNAP, DB_POD);
-		unlink(MEMDB_LOG_POD_FILE);
-		memdb_log_set_pod_number(0);
-	}
+	if (MEMDB_LOG_MAX_NUMBER <= memdb_log_get_pod_number())
+		memdb_log_compact(DB_POD);
 }
 
 void int_node_module(void)
 {
+	int db, i;
+
+	for (db = 0; db < DB_MAX; db++) {
+		for (i = 0; i < NODE_HASH_SIZE; i++)
+			INIT_LIST_HEAD(&node_hash[db][i]);
+		for (i = 0; i < ATTR_INDEX_SIZE; i++)
+			INIT_LIST_HEAD(&attr_index[db][i]);
+	}
+
+	init_attr_hash(&rmm_root);
+	init_attr_hash(&pod_root);
+	list_add_tail(&rmm_root.hash, node_hash_bucket(DB_RMM, rmm_root.node_id));
+	list_add_tail(&pod_root.hash, node_hash_bucket(DB_POD, pod_root.node_id));
+
 	clock_gettime(CLOCK_MONOTONIC, &(rmm_root.create_time));
 	clock_gettime(CLOCK_MONOTONIC, &(pod_root.create_time));
 
@@ -14,12 +14,14 @@
 
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <errno.h>
 #include <netinet/in.h>
@@ -33,35 +35,31 @@
 
 bool snapshot_in_progress = false;
 
-#define MAX_WRITE_SIZE	256
-#define MAX_READ_SIZE	MAX_WRITE_SIZE
-#define MAX_ATTR_SIZE	1024
+#define SNAP_WRITE_BUF_SIZE	(64 * 1024)
 
-#define NODE_ATTR_HEAD_LEN	(sizeof(struct list_head) + \
-							 sizeof(struct list_head) + \
-							 sizeof(struct node *))
+/* 'struct node_attr' from 'cookie' on matches 'struct node_attr_param' */
+#define NODE_ATTR_HEAD_LEN	offsetof(struct node_attr, cookie)
 
 #define PARAM_ATTR_LEN	(sizeof(struct node_info) + \
 						 sizeof(unsigned char))
 
 /**
- *@brief:  Store the memdb for snapshoting.
+ *@brief:  Store the memdb for snapshoting. The snapshot is written to a
+ *         temporary file which replaces the previous one when complete.
  */
-int memdb_node_snap(char *filename, unsigned char db_name)
+int memdb_node_snap(char *filename, unsigned char db_name, uint64 lsn)
 {
+	struct snap_file_hdr hdr = {SNAP_MAGIC, SNAP_VERSION, lsn};
 	struct node *node = NULL;
 	struct node_attr *attr = NULL;
-	int cnt = -1;
 	unsigned char buf[PARAM_ATTR_LEN] = {0};
-	int fd = -1;
 	unsigned char attr_cnt = 0;
-	unsigned char *attr_data = NULL;
-	int buf_rest_size = 0;
-	int buf_assigned_size = 0;
 	struct node_info nodeinfo = {0};
 	struct list_head *which_node = &node_list;
-	int offset = 0;
 	char full_filename[128] = {0};
+	char tmp_filename[136] = {0};
+	char *wbuf = NULL;
+	FILE *fp = NULL;
 	struct stat sb;
 
 	snapshot_in_progress = true;
@@ -74,18 +72,26 @@ int memdb_node_snap(char *filename, unsigned char db_name)
 	}
 
 	snprintf(full_filename, sizeof(full_filename), "%s%s", DIR_FOR_SNAP, filename);
+	snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", full_filename);
 
-	fd = open(full_filename, O_RDWR | O_CREAT, S_IRWXU);
-	if (fd == -1) {
-		perror("open");
+	wbuf = malloc(SNAP_WRITE_BUF_SIZE);
+	fp = fopen(tmp_filename, "w");
+	if (fp == NULL || wbuf == NULL) {
 		MEMDB_ERR("open file failed\n");
-		return -1;
+		goto err;
 	}
+	setvbuf(fp, wbuf, _IOFBF, SNAP_WRITE_BUF_SIZE);
+
+	if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1)
+		goto err;
 
 	list_for_each_entry(node, which_node, list) {
 		if ((node->parent == NULL) && (node->node_id != 0))
 			continue;
 
+		if (SNAPSHOT_NEED_NOT == node->snapshot_flag)
+			continue;
+
 		if (node->node_id != 0)
 			nodeinfo.parent = (node->parent)->node_id;
 		else
@@ -95,107 +101,82 @@ int memdb_node_snap(char *filename, unsigned char db_name)
 		nodeinfo.snapshot_flag = node->snapshot_flag;
 		nodeinfo.type = node->type;
 
-		if (SNAPSHOT_NEED_NOT == node->snapshot_flag)
-			continue;
-
-		memset(buf, 0, PARAM_ATTR_LEN);
-		memcpy(buf, &nodeinfo, sizeof(struct node_info));
-
 		attr_cnt = 0;
-		offset = 0;
-		buf_rest_size = 0;
-		buf_assigned_size = 0;
-
 		list_for_each_entry(attr, &node->attrs, group) {
-			if (attr->snapshot_flag == SNAPSHOT_NEED_NOT)
-				continue;
-
-			if (attr->node == node) {
+			if (attr->snapshot_flag != SNAPSHOT_NEED_NOT && attr->node == node)
 				attr_cnt++;
-
-				if (buf_rest_size < (sizeof(struct node_attr_param)
-								 + attr->namelen + attr->datalen)) {
-					attr_data = (unsigned char *)realloc(attr_data, buf_assigned_size + MAX_ATTR_SIZE);
-					if (NULL == attr_data) {
-						MEMDB_ERR("malloc failed\n");
-						goto err;
-					}
-					buf_rest_size += MAX_ATTR_SIZE;
-					buf_assigned_size += MAX_ATTR_SIZE;
-				}
-
-				memcpy(attr_data + offset, (char *)attr + NODE_ATTR_HEAD_LEN,
-					   sizeof(struct node_attr_param));
-				offset += sizeof(struct node_attr_param);
-
-				memcpy(attr_data + offset, attr->name, attr->namelen);
-				offset += attr->namelen;
-
-				memcpy(attr_data + offset, attr->data, attr->datalen);
-				offset += attr->datalen;
-
-				buf_rest_size -= (sizeof(struct node_attr_param)
-								  + attr->namelen + attr->datalen);
-			}
 		}
 
+		memset(buf, 0, PARAM_ATTR_LEN);
+		memcpy(buf, &nodeinfo, sizeof(struct node_info));
 		memcpy(buf + sizeof(struct node_info), (unsigned char *)&attr_cnt,
 			   sizeof(unsigned char));
 
-		cnt = write(fd, buf, PARAM_ATTR_LEN);
-		if (cnt != PARAM_ATTR_LEN) {
+		if (fwrite(buf, PARAM_ATTR_LEN, 1, fp) != 1) {
 			MEMDB_ERR("write node info failed\n");
 			goto err;
 		}
 
-		if (attr_cnt > 0) {
-			cnt = write(fd, attr_data, offset);
-			if (cnt != offset) {
+		list_for_each_entry(attr, &node->attrs, group) {
+			if (attr->snapshot_flag == SNAPSHOT_NEED_NOT || attr->node != node)
+				continue;
+
+			if (fwrite((char *)attr + NODE_ATTR_HEAD_LEN, sizeof(struct node_attr_param), 1, fp) != 1 ||
+				fwrite(attr->name, attr->namelen, 1, fp) != 1 ||
+				fwrite(attr->data, attr->datalen, 1, fp) != 1) {
 				MEMDB_ERR("write node attr failed\n");
 				goto err;
 			}
 		}
-
-		if (NULL != attr_data) {
-			free(attr_data);
-			attr_data = NULL;
-		}
 	}
 
-	close(fd);
+	if (fflush(fp) != 0 || fsync(fileno(fp)) != 0)
+		goto err;
+	fclose(fp);
+	free(wbuf);
+
+	if (rename(tmp_filename, full_filename) != 0) {
+		MEMDB_ERR("rename snapshot failed\n");
+		unlink(tmp_filename);
+		snapshot_in_progress = false;
+		return -1;
+	}
 
 	snapshot_in_progress = false;
 
-	return cnt;
+	return 0;
 
 err:
-	if (NULL != attr_data) {
-		free(attr_data);
-		attr_data = NULL;
+	if (fp != NULL) {
+		fclose(fp);
+		unlink(tmp_filename);
 	}
+	free(wbuf);
 
-	close(fd);
+	snapshot_in_progress = false;
 	return -1;
 }
 
 /**
- * @brief: Load the snapshot file to the memdb.
+ * @brief: Load the snapshot file to the memdb, '*lsn' is set to the last
+ *         log record included in it.
  */
-struct node *memdb_node_load(char *filename, unsigned char db_name)
+struct node *memdb_node_load(char *filename, unsigned char db_name, uint64 *lsn)
 {
-	int cnt = -1;
 	int fd = -1;
-	unsigned char buf[PARAM_ATTR_LEN] = {0};
-	unsigned char attr_data[MAX_ATTR_SIZE] = {0};
 	unsigned char attr_cnt = 0;
-	unsigned char *data = NULL;
+	unsigned char *map = NULL;
 	struct node *n = NULL;
 	struct node_info *node_info = NULL;
 	struct node_attr_param *attr = NULL;
+	struct snap_file_hdr *hdr = NULL;
 	int i = 0;
 	struct node *parent = NULL;
 	char full_filename[128] = {0};
-	char new_filename[128] = {0};
+	struct stat sb;
+	size_t off = 0;
+
+	*lsn = 0;
 
 	if (chdir(DIR_FOR_SNAP) == 0) {
 		snprintf(full_filename, sizeof(full_filename), "%s%s", DIR_FOR_SNAP, filename);
@@ -207,67 +188,69 @@ struct node *memdb_node_load(char *filename, unsigned char db_name)
 		return NULL;
 	}
 
-	do {
-		memset(buf, 0, PARAM_ATTR_LEN);
+	if (fstat(fd, &sb) != 0 || sb.st_size == 0) {
+		close(fd);
+		return NULL;
+	}
+
+	/* private and writable: set_node_attr() terminates the names in place */
+	map = mmap(NULL, sb.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		MEMDB_ERR("memdb load mmap snapshot file failed\n");
+		return NULL;
+	}
+
+	hdr = (struct snap_file_hdr *)map;
+	if (sb.st_size >= sizeof(*hdr) && hdr->magic == SNAP_MAGIC) {
+		*lsn = hdr->lsn;
+		off = sizeof(*hdr);
+	}
 
-		cnt = read(fd, buf, PARAM_ATTR_LEN);
-		if (cnt == PARAM_ATTR_LEN) {
-			node_info = (struct node_info *)buf;
-
-			memcpy(&attr_cnt, buf + sizeof(struct node_info), sizeof(attr_cnt));
-
-			if ((parent = find_node_by_node_id(db_name, node_info->parent)) != NULL) {
-				if ((n = insert_node_with_node_id(db_name, parent,
-											   node_info->node_id,
-											   node_info->type,
-											   SNAPSHOT_NEED)) == NULL) {
-					MEMDB_ERR("insert node failed\n");
-					goto err;
-				}
-			} else {
-				MEMDB_ERR("find node failed\n");
+	while (off + PARAM_ATTR_LEN <= sb.st_size) {
+		node_info = (struct node_info *)(map + off);
+		memcpy(&attr_cnt, map + off + sizeof(struct node_info), sizeof(attr_cnt));
+		off += PARAM_ATTR_LEN;
+
+		if ((parent = find_node_by_node_id(db_name, node_info->parent)) != NULL) {
+			if ((n = insert_node_with_node_id(db_name, parent,
+										   node_info->node_id,
+										   node_info->type,
+										   SNAPSHOT_NEED)) == NULL) {
+				MEMDB_ERR("insert node failed\n");
 				goto err;
 			}
+		} else {
+			MEMDB_ERR("find node failed\n");
+			goto err;
+		}
 
-			if (attr_cnt == 0)
-				continue;
+		for (i = 0; i < attr_cnt; i++) {
+			if (off + sizeof(struct node_attr_param) > sb.st_size)
+				goto err;
+
+			attr = (struct node_attr_param *)(map + off);
+			off += sizeof(struct node_attr_param);
+
+			if (attr->namelen < 0 || attr->datalen < 0 ||
+				off + attr->namelen + attr->datalen > sb.st_size)
+				goto err;
 
-			for (i = 0; i < attr_cnt; i++) {
-				cnt = read(fd, attr_data, sizeof(struct node_attr_param));
-				if (cnt != sizeof(struct node_attr_param))
-					goto err;
-
-				attr = (struct node_attr_param *)attr_data;
-
-				data = (unsigned char *)malloc(attr->datalen + attr->namelen);
-				if (NULL == data) {
-					MEMDB_ERR("malloc failed\n");
-					goto err;
-				}
-
-				memset(data, 0, attr->datalen + attr->namelen);
-
-				cnt = read(fd, data, attr->datalen + attr->namelen);
-				if (cnt == (attr->datalen + attr->namelen)) {
-					if (set_node_attr(DB_RMM, n, attr->cookie,
-									  data, attr->namelen,
-									  data + attr->namelen, attr->datalen,
-									  SNAPSHOT_NEED, attr->type) != 0) {
-						free(data);
-						MEMDB_ERR("set node attr failed\n");
-						goto err;
-					}
-				}
-				free(data);
+			if (set_node_attr(db_name, n, attr->cookie,
+							  map + off, attr->namelen,
+							  map + off + attr->namelen, attr->datalen,
+							  SNAPSHOT_NEED, attr->type) != 0) {
+				MEMDB_ERR("set node attr failed\n");
+				goto err;
 			}
-		} /* End of if (cnt == PARAM_ATTR_LEN) */
-	} while (cnt > 0);
+			off += attr->namelen + attr->datalen;
+		}
+	}
 
-	close(fd);
+	munmap(map, sb.st_size);
 	return n;
 
 err:
-	close(fd);
+	munmap(map, sb.st_size);
 	return NULL;
 }
-
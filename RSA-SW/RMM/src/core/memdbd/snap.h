@@ -20,8 +20,23 @@
 #define FILE_SNAP		"memdb_upgrade.snapshot"
 #define FILE_POD_SNAP	"memdb_pod_upgrade.snapshot"
 
-int memdb_node_snap(char *filename, unsigned char db_name);
+#include "libutils/types.h"
 
-struct node *memdb_node_load(char *filename, unsigned char db_name);
+#define SNAP_MAGIC		0x4d445350	/* "MDSP" */
+#define SNAP_VERSION	1
+
+/*
+ * Header of the snapshot file, followed by the node records. A snapshot
+ * without it was written by a previous release and includes no log.
+ */
+struct snap_file_hdr {
+	uint32 magic;
+	uint32 version;
+	uint64 lsn;			/* last memdb log record included */
+};
+
+int memdb_node_snap(char *filename, unsigned char db_name, uint64 lsn);
+
+struct node *memdb_node_load(char *filename, unsigned char db_name, uint64 *lsn);
 
 #endif
@@ -25,10 +25,12 @@
 #include "librmmcfg/rmm_cfg.h"
 #include "rf_memdb.h"
 #include "rf_log.h"
-#include "libutils/curl_ref.h"
+#include "rf_deliver.h"
 #include "libutils/string.h"
 #include "libinit/libinit.h"
 
+#define MAX_EVT_DEST_NUM	64
+
 static void record_rmm_log(int32 level, int8 *module_name, int8 *func_name, int8 *msg)
 {
 	rmm_log_ex(module_name, func_name, level, "%s", msg);
@@ -58,16 +60,19 @@ static void record_rf_log(int32 level, int32 msg_num, int8 *str_args)
 *
 * Diagram for step 3:
 * .------------------.   .-----------------------.   .------------------.
-* |query msg identity|-->|query listeners via map|-->|post redfish event|
-* `------------------'   `-----------------------'   `------------------'
+* |query msg identity|-->|query listeners via map|-->|queue redfish event|
+* `------------------'   `-----------------------'   `-------------------'
+*
+* The listeners are cached until memdb reports a change, the events are
+* posted asynchronously by rf_deliver from the main loop.
 */
 static int32 rf_msg_handler(struct rf_log_req_info *req_info)
 {
 	int32 location_idx = 0;
 	int8 msg_id_str[256] = {0};
-	struct dest_info *listener;
-	struct dest_info *tmp;
-	struct dest_info *tmp2;
+	int8 *dests[MAX_EVT_DEST_NUM];
+	int32 dest_num = 0;
+	int32 i = 0;
 	int8 msg[256] = {0};
 
 	int32 msg_sn = req_info->data.fmt1.msg_sn;
@@ -85,27 +90,12 @@ static int32 rf_msg_handler(struct rf_log_req_info *req_info)
 			req_info->data.fmt1.func_name,
 			msg);
 
-	/*If the request is event, post event to destination*/
+	/*If the request is event, queue it for its listeners, posted from the main loop*/
 	if (req_info->data.fmt1.is_event == RF_EVENT) {
 		msg_reg_get_msg_id_str(msg_id_str, 256, msg_sn);
-		listener = (struct dest_info *)malloc(sizeof(struct dest_info));
-		if (listener == NULL) {
-			rmm_log(ERROR, "malloc failed\n");
-			return -1;
-		}
-
-		memset(listener, 0, sizeof(struct dest_info));
-
-		rf_memdb_get_listeners(msg_id_str, location_idx, listener);
-		tmp = listener;
-		while (tmp) {
-			if (strstr(tmp->dest, "http") != NULL){
-				curl_post_msg(tmp->dest, msg);
-			}
-			tmp2 = tmp->pnext;
-			free(tmp);
-			tmp = tmp2;
-		}
+		dest_num = rf_memdb_get_listeners(msg_id_str, location_idx, dests, MAX_EVT_DEST_NUM);
+		for (i = 0; i < dest_num; i++)
+			rf_deliver_post(dests[i], msg);
 	}
 
 	return 0;
@@ -204,7 +194,12 @@ int main(int32 argc, int8 **argv)
 {
 	int32 rc;
 	int32 fd;
-	fd_set fds;
+	int32 max_fd;
+	int32 timeout_ms;
+	fd_set rfds;
+	fd_set wfds;
+	fd_set efds;
+	struct timeval tv;
 	int32 port;
 	socklen_t addrlen;
 	struct sockaddr_in addr_from;
@@ -234,18 +229,34 @@ int main(int32 argc, int8 **argv)
 	/*Redfish MessageRegistry init, load default config file.*/
 	msg_reg_init(NULL);
 	rf_memdb_event_node_init();
-	curl_init();
+	if (rf_deliver_init() != 0)
+		exit(-1);
 
 	set_socket_addr(&addr_from, port);
 	addrlen = sizeof(addr_from);
 	for (;;) {
-		FD_ZERO(&fds);
-		FD_SET(fd, &fds);
-
-		rc = select(fd + 1, &fds, NULL, NULL, NULL);
+		FD_ZERO(&rfds);
+		FD_ZERO(&wfds);
+		FD_ZERO(&efds);
+		FD_SET(fd, &rfds);
+		max_fd = fd;
+
+		libdb_event_selectfds(&rfds, &max_fd);
+		rf_deliver_selectfds(&rfds, &wfds, &efds, &max_fd);
+		timeout_ms = rf_deliver_timeout();
+		tv.tv_sec = timeout_ms / 1000;
+		tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+		rc = select(max_fd + 1, &rfds, &wfds, &efds, timeout_ms < 0 ? NULL : &tv);
 		if (rc < 0)
 			continue;
 
+		/* drop the cached listeners before the events that use them */
+		libdb_event_processfds(&rfds);
+		rf_deliver_process();
+		if (!FD_ISSET(fd, &rfds))
+			continue;
+
 		rc = recvfrom(fd, &req_info, sizeof(struct rf_log_req_info), 0, (struct sockaddr *)&addr_from, &addrlen);
 		if (rc <= 0)
 			continue;
@@ -263,7 +274,7 @@ int main(int32 argc, int8 **argv)
 	}
 
 	close(fd);
-	curl_uninit();
+	rf_deliver_uninit();
 	return 0;
 }
 
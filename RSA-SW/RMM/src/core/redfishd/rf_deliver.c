@@ -0,0 +1,400 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <curl/curl.h>
+
+#include "libredfish/rf_types.h"
+#include "librmmcfg/rmm_cfg.h"
+#include "librmmlog/rmmlog.h"
+#include "libutils/curl_ref.h"
+#include "rf_deliver.h"
+
+#define RF_DEST_MAX				64
+#define RF_DEST_IDLE_MS			(5 * 60 * 1000)	/* close the connection of an idle listener */
+#define RF_CONNECT_TIMEOUT_MS	2000
+#define RF_POST_TIMEOUT_MS		5000
+#define RF_BACKOFF_MIN_MS		500
+#define RF_BACKOFF_MAX_MS		60000
+#define RF_RESOLVE_WAIT_MS		100		/* curl has no socket to wait on yet */
+
+/**
+ * @brief a destination url and its pending messages.
+ *
+ */
+struct rf_dest {
+	int8 url[256];
+	CURL *curl;						//!< persistent, keeps the connection alive
+	int32 busy;						//!< a post is in flight
+	int8 (*queue)[RF_MSG_MAX_LEN];
+	int32 head;
+	int32 count;
+	int32 batch;					//!< messages from head in flight
+	int8 *body;
+	int32 tries;					//!< posts of the messages at head
+	int32 failures;					//!< failed posts in a row
+	int32 overflow;					//!< a drop was logged since the last success
+	unsigned long long next_ms;		//!< backoff, no post before
+	unsigned long long last_ms;
+	unsigned long long sent;
+	unsigned long long dropped;
+};
+
+static CURLM *multi;
+static struct curl_slist *headers;
+static struct rf_dest *dests[RF_DEST_MAX];
+static int32 queue_len = RF_DELIVER_QUEUE_LEN;
+static int32 batch_max = RF_DELIVER_BATCH;
+static int32 retry_max = RF_DELIVER_RETRY_MAX;
+static int32 blind;
+
+static unsigned long long now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+static size_t discard_resp(void *data, size_t size, size_t nmemb, void *arg)
+{
+	return size * nmemb;
+}
+
+static void free_dest(struct rf_dest *d)
+{
+	if (d->curl) {
+		if (d->busy)
+			curl_multi_remove_handle(multi, d->curl);
+		curl_easy_cleanup(d->curl);
+	}
+	free(d->queue);
+	free(d->body);
+	free(d);
+}
+
+static struct rf_dest *new_dest(const int8 *url)
+{
+	struct rf_dest *d = NULL;
+
+	d = (struct rf_dest *)calloc(1, sizeof(struct rf_dest));
+	if (d == NULL)
+		return NULL;
+
+	snprintf(d->url, sizeof(d->url), "%s", url);
+	d->queue = calloc(queue_len, RF_MSG_MAX_LEN);
+	d->body = malloc(batch_max * RF_MSG_MAX_LEN);
+	d->curl = curl_easy_init();
+	if (d->queue == NULL || d->body == NULL || d->curl == NULL) {
+		free_dest(d);
+		return NULL;
+	}
+
+	curl_easy_setopt(d->curl, CURLOPT_URL, d->url);
+	curl_easy_setopt(d->curl, CURLOPT_PRIVATE, d);
+	curl_easy_setopt(d->curl, CURLOPT_HTTPHEADER, headers);
+	curl_easy_setopt(d->curl, CURLOPT_NOSIGNAL, 1L);
+	curl_easy_setopt(d->curl, CURLOPT_TCP_KEEPALIVE, 1L);
+	curl_easy_setopt(d->curl, CURLOPT_CONNECTTIMEOUT_MS, (long)RF_CONNECT_TIMEOUT_MS);
+	curl_easy_setopt(d->curl, CURLOPT_TIMEOUT_MS, (long)RF_POST_TIMEOUT_MS);
+	curl_easy_setopt(d->curl, CURLOPT_WRITEFUNCTION, discard_resp);
+	d->last_ms = now_ms();
+
+	return d;
+}
+
+static struct rf_dest *get_dest(const int8 *url)
+{
+	int32 i = 0;
+	int32 free_slot = -1;
+
+	for (i = 0; i < RF_DEST_MAX; i++) {
+		if (dests[i] == NULL) {
+			if (free_slot < 0)
+				free_slot = i;
+			continue;
+		}
+		if (strcmp(dests[i]->url, url) == 0)
+			return dests[i];
+	}
+
+	if (free_slot < 0) {
+		rmm_log(ERROR, "too many event listeners, drop event to %s\n", url);
+		return NULL;
+	}
+
+	dests[free_slot] = new_dest(url);
+	return dests[free_slot];
+}
+
+/* the messages at head of the queue, one per line when batched */
+static void start_post(struct rf_dest *d)
+{
+	int8 *msg = NULL;
+	int32 len = 0;
+	int32 msg_len = 0;
+	int32 i = 0;
+
+	d->batch = d->count < batch_max ? d->count : batch_max;
+	for (i = 0; i < d->batch; i++) {
+		msg = d->queue[(d->head + i) % queue_len];
+		msg_len = strlen(msg);
+		if (i > 0)
+			d->body[len++] = '\n';
+		memcpy(d->body + len, msg, msg_len);
+		len += msg_len;
+	}
+
+	curl_easy_setopt(d->curl, CURLOPT_POSTFIELDSIZE, (long)len);
+	curl_easy_setopt(d->curl, CURLOPT_POSTFIELDS, d->body);
+	if (curl_multi_add_handle(multi, d->curl) != CURLM_OK) {
+		d->batch = 0;
+		d->next_ms = now_ms() + RF_BACKOFF_MIN_MS;
+		return;
+	}
+
+	d->busy = 1;
+	d->tries++;
+}
+
+static void pop_batch(struct rf_dest *d)
+{
+	d->head = (d->head + d->batch) % queue_len;
+	d->count -= d->batch;
+	d->batch = 0;
+	d->tries = 0;
+}
+
+static unsigned long long backoff_ms(int32 failures)
+{
+	unsigned long long ms = RF_BACKOFF_MAX_MS;
+
+	if (failures < 16)
+		ms = (unsigned long long)RF_BACKOFF_MIN_MS << (failures - 1);
+	if (ms > RF_BACKOFF_MAX_MS)
+		ms = RF_BACKOFF_MAX_MS;
+
+	/* +-25%, the listeners that failed together do not retry together */
+	return ms - ms / 4 + rand() % (ms / 2 + 1);
+}
+
+static void finish_post(struct rf_dest *d, CURLcode res, long code)
+{
+	unsigned long long now = now_ms();
+
+	curl_multi_remove_handle(multi, d->curl);
+	d->busy = 0;
+	d->last_ms = now;
+
+	if (res == CURLE_OK && code < 400) {
+		d->sent += d->batch;
+		d->failures = 0;
+		d->overflow = 0;
+		d->next_ms = 0;
+		pop_batch(d);
+		return;
+	}
+
+	d->failures++;
+	d->next_ms = now + backoff_ms(d->failures);
+
+	/* the listener refuses the events, posting them again is useless */
+	if (res == CURLE_OK && code < 500 && code != 408 && code != 429) {
+		rmm_log(ERROR, "listener %s rejected %d events: http %ld\n", d->url, d->batch, code);
+		d->dropped += d->batch;
+		pop_batch(d);
+		return;
+	}
+
+	if (d->tries > retry_max) {
+		rmm_log(ERROR, "drop %d events to %s after %d tries: %s, http %ld\n",
+				d->batch, d->url, d->tries, curl_easy_strerror(res), code);
+		d->dropped += d->batch;
+		pop_batch(d);
+		return;
+	}
+
+	d->batch = 0;
+}
+
+static void schedule(void)
+{
+	unsigned long long now = now_ms();
+	struct rf_dest *d = NULL;
+	int32 i = 0;
+
+	for (i = 0; i < RF_DEST_MAX; i++) {
+		d = dests[i];
+		if (d == NULL || d->busy)
+			continue;
+
+		if (d->count > 0) {
+			if (now >= d->next_ms)
+				start_post(d);
+		} else if (now - d->last_ms > RF_DEST_IDLE_MS) {
+			free_dest(d);
+			dests[i] = NULL;
+		}
+	}
+}
+
+int32 rf_deliver_init(void)
+{
+	int32 value = 0;
+
+	value = rmm_cfg_get_event_queue_len();
+	if (value > 0)
+		queue_len = value;
+
+	value = rmm_cfg_get_event_batch();
+	if (value > 0)
+		batch_max = value < queue_len ? value : queue_len;
+
+	value = rmm_cfg_get_event_retry_max();
+	if (value >= 0)
+		retry_max = value;
+
+	curl_init();
+
+	multi = curl_multi_init();
+	if (multi == NULL) {
+		rmm_log(ERROR, "curl_multi_init failed\n");
+		return -1;
+	}
+	curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, (long)RF_DEST_MAX);
+
+	/* no 100-continue round trip before the body of a large batch */
+	headers = curl_slist_append(NULL, "Expect:");
+	srand(time(NULL));
+
+	return 0;
+}
+
+int32 rf_deliver_post(const int8 *url, const int8 *msg)
+{
+	struct rf_dest *d = NULL;
+	int8 *slot = NULL;
+	int32 len = 0;
+
+	d = get_dest(url);
+	if (d == NULL)
+		return -1;
+
+	if (d->count == queue_len) {
+		d->dropped++;
+		if (!d->overflow) {
+			rmm_log(ERROR, "event queue of %s is full, drop events\n", d->url);
+			d->overflow = 1;
+		}
+		return -1;
+	}
+
+	slot = d->queue[(d->head + d->count) % queue_len];
+	snprintf(slot, RF_MSG_MAX_LEN, "%s", msg);
+	len = strlen(slot);
+	if (len > 0 && slot[len - 1] == '\n')
+		slot[len - 1] = '\0';
+	d->count++;
+	d->last_ms = now_ms();
+
+	if (!d->busy && d->last_ms >= d->next_ms)
+		start_post(d);
+
+	return 0;
+}
+
+void rf_deliver_selectfds(fd_set *rfds, fd_set *wfds, fd_set *efds, int32 *max_fd)
+{
+	int32 fd = -1;
+	int32 running = 0;
+	int32 i = 0;
+
+	curl_multi_fdset(multi, rfds, wfds, efds, &fd);
+	if (fd > *max_fd)
+		*max_fd = fd;
+
+	for (i = 0; i < RF_DEST_MAX; i++) {
+		if (dests[i] && dests[i]->busy)
+			running = 1;
+	}
+	blind = (fd < 0 && running);
+}
+
+int32 rf_deliver_timeout(void)
+{
+	unsigned long long now = now_ms();
+	struct rf_dest *d = NULL;
+	long timeout = -1;
+	long wait = 0;
+	int32 i = 0;
+
+	curl_multi_timeout(multi, &timeout);
+	if (blind && (timeout < 0 || timeout > RF_RESOLVE_WAIT_MS))
+		timeout = RF_RESOLVE_WAIT_MS;
+
+	for (i = 0; i < RF_DEST_MAX; i++) {
+		d = dests[i];
+		if (d == NULL || d->busy || d->count == 0)
+			continue;
+
+		wait = d->next_ms > now ? (long)(d->next_ms - now) : 0;
+		if (timeout < 0 || wait < timeout)
+			timeout = wait;
+	}
+
+	return (int32)timeout;
+}
+
+void rf_deliver_process(void)
+{
+	struct rf_dest *d = NULL;
+	CURLMsg *m = NULL;
+	int running = 0;
+	int left = 0;
+	long code = 0;
+
+	curl_multi_perform(multi, &running);
+
+	while ((m = curl_multi_info_read(multi, &left)) != NULL) {
+		if (m->msg != CURLMSG_DONE)
+			continue;
+
+		code = 0;
+		curl_easy_getinfo(m->easy_handle, CURLINFO_PRIVATE, (char **)&d);
+		curl_easy_getinfo(m->easy_handle, CURLINFO_RESPONSE_CODE, &code);
+		finish_post(d, m->data.result, code);
+	}
+
+	schedule();
+}
+
+void rf_deliver_uninit(void)
+{
+	int32 i = 0;
+
+	for (i = 0; i < RF_DEST_MAX; i++) {
+		if (dests[i]) {
+			free_dest(dests[i]);
+			dests[i] = NULL;
+		}
+	}
+
+	curl_multi_cleanup(multi);
+	curl_slist_free_all(headers);
+	curl_uninit();
+}
@@ -0,0 +1,80 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __RF_DELIVER_H__
+#define __RF_DELIVER_H__
+
+#include <sys/select.h>
+#include "libutils/types.h"
+
+/*
+ * Asynchronous delivery of the redfish events to the listeners.
+ *
+ * Each destination url owns a persistent curl handle driven by a curl
+ * multi handle, so the connection is kept alive between the events and a
+ * slow or dead listener never blocks the message handler. Events wait in
+ * a bounded queue per destination and are posted one per request, as
+ * listeners expect one event message per post. A failed post is retried
+ * with an exponential backoff, then dropped.
+ *
+ * Setting "EventBatch" of redfishd in rmm.cfg above 1 is an opt-in for
+ * listeners that split the body on new lines: the events queued while a
+ * post is in flight then go out together in the next post, one message
+ * per line.
+ */
+#define RF_DELIVER_QUEUE_LEN		64
+#define RF_DELIVER_BATCH			1
+#define RF_DELIVER_RETRY_MAX		5
+
+/**
+ * @brief init the delivery engine, read the queue length, the batch size
+ * and the retry count from rmm.cfg.
+ *
+ * @return 0			success.
+ * 		   -1			fail
+ */
+int32 rf_deliver_init(void);
+
+/**
+ * @brief queue a message for a destination, never blocks.
+ *
+ * @param  url			destination url.
+ * @param  msg			message to post.
+ *
+ * @return 0			queued.
+ * 		   -1			dropped, the queue of the destination is full.
+ */
+int32 rf_deliver_post(const int8 *url, const int8 *msg);
+
+/**
+ * @brief add the sockets of the posts in flight to the select sets.
+ */
+void rf_deliver_selectfds(fd_set *rfds, fd_set *wfds, fd_set *efds, int32 *max_fd);
+
+/**
+ * @brief time in ms until rf_deliver_process must run, -1 if no post is
+ * pending.
+ */
+int32 rf_deliver_timeout(void);
+
+/**
+ * @brief move the posts in flight forward, complete the finished ones and
+ * start the next ones. Call it after each select.
+ */
+void rf_deliver_process(void);
+
+void rf_deliver_uninit(void);
+
+#endif
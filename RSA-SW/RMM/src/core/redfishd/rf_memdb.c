@@ -32,6 +32,7 @@
 #define MAX_EVT_ACTION_NUM	5
 #define MAX_EVT_SOURCE_NUM	10
 #define MAX_RF_EVT_NUM		(MAX_EVT_ACTION_NUM*MAX_EVT_SOURCE_NUM)
+#define MAX_LISTENER_NUM	64
 
 typedef rf_node_msg_id_map_t		*p_rf_node_msg_id_map;
 static rf_node_msg_id_map_t			g_rf_node_msg_id_map[MAX_RF_EVT_NUM];
@@ -197,44 +198,138 @@ static memdb_integer create_memdb_rf_event_nodes(void)
 	return node_id;
 }
 
-static void get_listeners_by_nid(memdb_integer nid, int location_idx, struct dest_info *listeners)
+static struct rf_listener *find_listener(struct rf_listener *listeners, int32 num, memdb_integer node_id)
 {
-	struct node_info *subnode = NULL;
-	int32 subnode_num = 0;
-	int32 mask = 0;
-	int32 lds_idx = 0;
 	int32 i = 0;
-	struct dest_info *tmp;
-	int32 is_listen_validate_flag = 1;
-	int64 error_code = 0;
-
-	subnode = libdb_list_subnode_by_type(DB_RMM, nid, MC_REDFISH_LISTENER, &subnode_num, NULL, LOCK_ID_NULL);
-	for (i = 0; i < subnode_num; i++) {
-		if (location_idx != INVAILD_IDX) {
-			error_code = libdb_attr_get_int(DB_RMM, subnode[i].node_id, RF_EVENT_LISTENER_INDEXES_STR, &mask, LOCK_ID_NULL);
-			if (error_code != 0)
-				continue;
-			if (location_idx < 1)
-				continue;
-			if ((mask & (1<<(location_idx - 1))) == 0)
-				is_listen_validate_flag = 0;
-			else
-				is_listen_validate_flag = 1;
-		} else
-			is_listen_validate_flag = 1;
-
-		if (is_listen_validate_flag == 1) {
-			error_code = libdb_attr_get_string(DB_RMM, subnode[i].node_id, RF_EVENT_LISTENER_DEST_STR, listeners->dest, 256, LOCK_ID_NULL);
-			if (error_code == 0) {
-				tmp = (struct dest_info *)malloc(sizeof(struct dest_info));
-				if (tmp == NULL)
-					continue;
-				listeners->pnext = tmp;
-				listeners = tmp;
-				listeners->pnext = NULL;
-			}
+
+	for (i = 0; i < num; i++) {
+		if (listeners[i].node_id == node_id)
+			return &listeners[i];
+	}
+
+	return NULL;
+}
+
+static void unsubscribe_listeners(struct rf_listener *listeners, int32 num)
+{
+	int32 i = 0;
+
+	for (i = 0; i < num; i++) {
+		if (listeners[i].sub != 0)
+			libdb_unsubscribe_event(DB_RMM, listeners[i].sub, LOCK_ID_NULL);
+	}
+}
+
+/**
+ * @brief Read the dest and indexes of all the listeners of an event type
+ * in one request. The attribute subscriptions of the listeners known in
+ * 'prev' move to the new table, 'fresh' is set if a listener had to be
+ * subscribed to.
+ *
+ */
+static int32 read_listeners(memdb_integer nid, struct rf_listener *prev, int32 prev_num,
+							struct rf_listener *listeners, int32 *fresh)
+{
+	memdb_integer attrs[CMDBUFSIZ/sizeof(long)];
+	int8 *names[] = {RF_EVENT_LISTENER_DEST_STR, RF_EVENT_LISTENER_INDEXES_STR};
+	struct attr_info *info;
+	struct rf_listener *l, *old;
+	int32 size = sizeof(attrs);
+	int32 offset = 0;
+	int32 num = 0;
+	int8 *data;
+
+	*fresh = 0;
+	if (libdb_attr_get_multi(DB_RMM, nid, names, 2, 1, attrs, &size, LOCK_ID_NULL) != 0)
+		return -1;
+
+	foreach_attr_info(info, offset, attrs, size) {
+		if (strcmp(attr_name(info), RF_EVENT_LISTENER_DEST_STR) != 0)
+			continue;
+		if (num == MAX_LISTENER_NUM) {
+			rmm_log(ERROR, "too many listeners of node %lld\n", nid);
+			break;
+		}
+
+		l = &listeners[num++];
+		l->node_id = info->node;
+		snprintf(l->dest, sizeof(l->dest), "%s", (int8 *)attr_data(info));
+
+		data = libdb_attr_find(attrs, size, info->node, RF_EVENT_LISTENER_INDEXES_STR);
+		l->has_mask = (data != NULL);
+		l->mask = data ? atoi(data) : 0;
+
+		old = find_listener(prev, prev_num, l->node_id);
+		if (old != NULL && old->sub != 0) {
+			l->sub = old->sub;
+			old->sub = 0;
+		} else {
+			l->sub = libdb_subscribe_attr_by_node(DB_RMM, l->node_id, LOCK_ID_NULL);
+			*fresh = 1;
+		}
+	}
+
+	return num;
+}
+
+/**
+ * @brief Load the listeners of an event type into the cache. A listener
+ * seen for the first time is read again once subscribed to, a change made
+ * between the read and the subscription is not lost.
+ *
+ */
+static void load_listeners(p_rf_node_msg_id_map map)
+{
+	struct rf_listener *listeners = NULL;
+	struct rf_listener *again = NULL;
+	int32 num = 0;
+	int32 again_num = 0;
+	int32 fresh = 0;
+
+	listeners = (struct rf_listener *)calloc(MAX_LISTENER_NUM, sizeof(struct rf_listener));
+	if (listeners == NULL)
+		return;
+
+	num = read_listeners(map->node_id, map->listeners, map->listener_num, listeners, &fresh);
+	if (num >= 0 && fresh) {
+		again = (struct rf_listener *)calloc(MAX_LISTENER_NUM, sizeof(struct rf_listener));
+		if (again != NULL) {
+			again_num = read_listeners(map->node_id, listeners, num, again, &fresh);
+			if (again_num >= 0) {
+				unsubscribe_listeners(listeners, num);
+				free(listeners);
+				listeners = again;
+				num = again_num;
+			} else
+				free(again);
 		}
 	}
+
+	/* keep the stale table if memdb did not answer, retry next event */
+	if (num < 0) {
+		free(listeners);
+		return;
+	}
+
+	unsubscribe_listeners(map->listeners, map->listener_num);
+	free(map->listeners);
+	map->listeners = listeners;
+	map->listener_num = num;
+	map->cached = 1;
+}
+
+static int32 listener_match(struct rf_listener *l, int32 location_idx)
+{
+	if (strstr(l->dest, "http") == NULL)
+		return 0;
+
+	if (location_idx == INVAILD_IDX)
+		return 1;
+
+	if (!l->has_mask || location_idx < 1)
+		return 0;
+
+	return (l->mask & (1 << (location_idx - 1))) != 0;
 }
 
 void rf_memdb_event_node_init(void)
@@ -248,18 +343,65 @@ void rf_memdb_event_node_init(void)
 	}
 
 	node_msg_id_map_size = gen_node_msg_id_map(g_rf_node_msg_id_map);
+
+	if (libdb_init_subscription(NOTIFY_BY_SELECT, rf_memdb_event_handler, NULL) < 0) {
+		rmm_log(ERROR, "failed to init select subscribe mode\n");
+		return;
+	}
+
+	libdb_subscribe_node_create_by_type(DB_RMM, MC_REDFISH_LISTENER, LOCK_ID_NULL);
+	libdb_subscribe_node_delete_by_type(DB_RMM, MC_REDFISH_LISTENER, LOCK_ID_NULL);
 }
 
-int32 rf_memdb_get_listeners(int8 *msg_id_str, int32 location_idx, struct dest_info *listener)
+int32 rf_memdb_get_listeners(int8 *msg_id_str, int32 location_idx, int8 **dests, int32 max)
 {
+	p_rf_node_msg_id_map map = NULL;
+	int32 num = 0;
 	int32 i = 0;
 
 	for (i = 0; i < node_msg_id_map_size; i++) {
-
 		if (memcmp(msg_id_str, g_rf_node_msg_id_map[i].msg_id_str, MSG_ID_STR_LEN) == 0) {
-			get_listeners_by_nid(g_rf_node_msg_id_map[i].node_id, location_idx, listener);
+			map = &g_rf_node_msg_id_map[i];
 			break;
 		}
 	}
-	return 0;
-}
\ No newline at end of file
+
+	if (map == NULL)
+		return 0;
+
+	if (!map->cached)
+		load_listeners(map);
+
+	for (i = 0; i < map->listener_num && num < max; i++) {
+		if (listener_match(&map->listeners[i], location_idx))
+			dests[num++] = map->listeners[i].dest;
+	}
+
+	return num;
+}
+
+void rf_memdb_event_handler(struct event_info *evt, void *cb_data)
+{
+	int32 i = 0;
+
+	switch (evt->event) {
+	case EVENT_NODE_CREATE:
+	case EVENT_NODE_DELETE:
+		if (evt->ntype != MC_REDFISH_LISTENER)
+			return;
+		for (i = 0; i < node_msg_id_map_size; i++) {
+			if (g_rf_node_msg_id_map[i].node_id == evt->nparent)
+				g_rf_node_msg_id_map[i].cached = 0;
+		}
+		break;
+	case EVENT_NODE_ATTR:
+		for (i = 0; i < node_msg_id_map_size; i++) {
+			if (find_listener(g_rf_node_msg_id_map[i].listeners,
+							  g_rf_node_msg_id_map[i].listener_num, evt->anodeid) != NULL)
+				g_rf_node_msg_id_map[i].cached = 0;
+		}
+		break;
+	default:
+		break;
+	}
+}
@@ -17,41 +17,59 @@
 #define __RFMEMDB_H__
 
 #include "libutils/types.h"
+#include "libmemdb/memdb.h"
 
 #define MSG_ID_KEY			"MsgID"
 #define MSG_ID_STR_LEN		256
 
-/** The destination url linked list
+/** A listener of an event type, cached until memdb reports a change.
  */
-struct dest_info {
-	char dest[256];				//!< dest url
-	struct dest_info *pnext;
+struct rf_listener {
+	memdb_integer	node_id;		//!< node id of the listener.
+	memdb_integer	sub;			//!< attribute subscription of the node.
+	int				mask;			//!< location indexes listened to.
+	int				has_mask;
+	char			dest[256];		//!< dest url
 };
 
 typedef struct rf_node_msg_id_map {
 	char				msg_id_str[MSG_ID_STR_LEN];		//!< msg id of redfish.
 	memdb_integer		node_id;						//!< node id of the msg.
+	int					cached;							//!< listeners are up to date.
+	int					listener_num;
+	struct rf_listener	*listeners;
 } rf_node_msg_id_map_t;
 
 /**
 * @brief Initialize redfish event node in memdb.
 *
-* If the event node exit, load event node info to cache.
+* If the event node exit, load event node info to cache. Subscribe to the
+* changes of the listeners, the memdb events are read by the select loop.
 */
 extern void rf_memdb_event_node_init(void);
 
 /**
  * @brief get destination urls by msg id
  *
+ * The listeners of a msg id are read from memdb once and cached until a
+ * listener is added, removed or changed.
+ *
  * @param  id 			msg id of the redfish.
  * @param  location_idx	location idx of event source collection
  *						(such as pus idx of psu collection.)
+ * @param  dests		filled with the urls, valid until the next
+ *						memdb event is processed.
+ * @param  max			size of dests.
  *
- * @return 0			success.
- * 		   -1			fail
+ * @return 				number of urls.
  *
  */
-extern int rf_memdb_get_listeners(char *id, int location_idx, struct dest_info *lds_header);
+extern int rf_memdb_get_listeners(char *id, int location_idx, char **dests, int max);
 
-#endif
+/**
+ * @brief memdb event callback, drop the cached listeners of the event
+ * type whose listener changed.
+ */
+extern void rf_memdb_event_handler(struct event_info *evt, void *cb_data);
 
+#endif
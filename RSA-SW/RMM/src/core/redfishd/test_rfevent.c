@@ -0,0 +1,283 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "libutils/rack.h"
+#include "libredfish/rf_types.h"
+#include "libredfish/msg_reg.h"
+#include "librmmlog/rmmlog.h"
+#include "rf_memdb.h"
+#include "rf_deliver.h"
+
+/*
+ * Event delivery of redfishd end to end, against a running memdbd: a
+ * listener is added to memdb the way restd subscribes one, its events are
+ * looked up through the listener cache of rf_memdb and posted by
+ * rf_deliver to a local http listener. The dest of the listener is then
+ * changed, the next event must reach the new dest once the memdb event
+ * has dropped the cached listener. Needs memdbd and /etc/rmm/rmm.cfg.
+ *
+ *     test_rfevent
+ */
+#define WAIT_LOOPS		100		/* 100 ms each */
+#define MAX_DESTS		8
+
+struct http_listener {
+	int32 fd;
+	int32 port;
+	int8 body[RF_MSG_MAX_LEN];
+	int32 posts;
+};
+
+static int32 listener_open(struct http_listener *l)
+{
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+
+	memset(l, 0, sizeof(*l));
+	l->fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (l->fd < 0)
+		return -1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(l->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+		listen(l->fd, 4) < 0 ||
+		getsockname(l->fd, (struct sockaddr *)&addr, &len) < 0) {
+		close(l->fd);
+		return -1;
+	}
+	l->port = ntohs(addr.sin_port);
+
+	return 0;
+}
+
+/* one post per connection is enough for the test, the reply closes it */
+static void listener_accept(struct http_listener *l)
+{
+	static const int8 reply[] = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+	int8 buf[4096];
+	int8 *body = NULL;
+	int8 *p = NULL;
+	int32 fd = -1;
+	int32 len = 0;
+	int32 rc = 0;
+	int32 body_len = -1;
+
+	fd = accept(l->fd, NULL, NULL);
+	if (fd < 0)
+		return;
+
+	while (len < sizeof(buf) - 1) {
+		rc = recv(fd, buf + len, sizeof(buf) - 1 - len, 0);
+		if (rc <= 0)
+			break;
+		len += rc;
+		buf[len] = 0;
+
+		body = strstr(buf, "\r\n\r\n");
+		if (body == NULL)
+			continue;
+		body += 4;
+		p = strcasestr(buf, "Content-Length:");
+		body_len = p ? atoi(p + strlen("Content-Length:")) : 0;
+		if (buf + len - body >= body_len)
+			break;
+	}
+
+	if (body != NULL && body_len >= 0) {
+		snprintf(l->body, sizeof(l->body), "%.*s", body_len, body);
+		l->posts++;
+	}
+
+	send(fd, reply, strlen(reply), MSG_NOSIGNAL);
+	close(fd);
+}
+
+/* run the loop of redfishd until the listener got a post */
+static int32 wait_post(struct http_listener *l, int32 posts)
+{
+	fd_set rfds, wfds, efds;
+	struct timeval tv;
+	int32 max_fd = 0;
+	int32 timeout_ms = 0;
+	int32 i = 0;
+
+	for (i = 0; i < WAIT_LOOPS && l->posts < posts; i++) {
+		FD_ZERO(&rfds);
+		FD_ZERO(&wfds);
+		FD_ZERO(&efds);
+		FD_SET(l->fd, &rfds);
+		max_fd = l->fd;
+
+		libdb_event_selectfds(&rfds, &max_fd);
+		rf_deliver_selectfds(&rfds, &wfds, &efds, &max_fd);
+		timeout_ms = rf_deliver_timeout();
+		if (timeout_ms < 0 || timeout_ms > 100)
+			timeout_ms = 100;
+		tv.tv_sec = 0;
+		tv.tv_usec = timeout_ms * 1000;
+
+		if (select(max_fd + 1, &rfds, &wfds, &efds, &tv) < 0)
+			continue;
+
+		libdb_event_processfds(&rfds);
+		rf_deliver_process();
+		if (FD_ISSET(l->fd, &rfds))
+			listener_accept(l);
+	}
+
+	return l->posts >= posts ? 0 : -1;
+}
+
+/* let the memdb events of a change reach the listener cache */
+static void process_memdb_events(void)
+{
+	fd_set rfds;
+	struct timeval tv;
+	int32 max_fd = -1;
+	int32 i = 0;
+
+	for (i = 0; i < 5; i++) {
+		FD_ZERO(&rfds);
+		libdb_event_selectfds(&rfds, &max_fd);
+		tv.tv_sec = 0;
+		tv.tv_usec = 100 * 1000;
+		if (select(max_fd + 1, &rfds, NULL, NULL, &tv) > 0)
+			libdb_event_processfds(&rfds);
+	}
+}
+
+static memdb_integer get_psu_change_node(int8 *msg_id_str)
+{
+	struct node_info *coll = NULL;
+	struct node_info *change = NULL;
+	memdb_integer nid = 0;
+	int32 num = 0;
+
+	coll = libdb_list_node_by_type(DB_RMM, MC_REDFISH_PSU_COLL, MC_REDFISH_PSU_COLL, &num, NULL, LOCK_ID_NULL);
+	if (coll == NULL || num != 1) {
+		libdb_free_node(coll);
+		return 0;
+	}
+
+	change = libdb_list_subnode_by_type(DB_RMM, coll[0].node_id, MC_REDFISH_CHANGE, &num, NULL, LOCK_ID_NULL);
+	if (change != NULL && num == 1) {
+		nid = change[0].node_id;
+		libdb_attr_get_string(DB_RMM, nid, MSG_ID_KEY, msg_id_str, MSG_ID_STR_LEN, LOCK_ID_NULL);
+	}
+
+	libdb_free_node(change);
+	libdb_free_node(coll);
+	return nid;
+}
+
+static int32 send_event(int8 *msg_id_str, int8 *msg)
+{
+	int8 *dests[MAX_DESTS];
+	int32 num = 0;
+	int32 i = 0;
+
+	num = rf_memdb_get_listeners(msg_id_str, INVAILD_IDX, dests, MAX_DESTS);
+	for (i = 0; i < num; i++)
+		rf_deliver_post(dests[i], msg);
+
+	return num;
+}
+
+int main(int argc, char **argv)
+{
+	struct http_listener first;
+	struct http_listener second;
+	int8 msg_id_str[MSG_ID_STR_LEN] = {0};
+	int8 dest[256] = {0};
+	memdb_integer evt_nid = 0;
+	memdb_integer listener_nid = 0;
+	int32 rc = -1;
+
+	if (listener_open(&first) != 0 || listener_open(&second) != 0) {
+		printf("FAIL: cannot open the http listeners\n");
+		return -1;
+	}
+
+	/* rmm_log exits when it has no rmm_logd to send to */
+	if (rmm_log_init() != 0) {
+		printf("FAIL: rmm_log_init\n");
+		return -1;
+	}
+
+	rf_memdb_event_node_init();
+	if (rf_deliver_init() != 0) {
+		printf("FAIL: rf_deliver_init\n");
+		return -1;
+	}
+
+	evt_nid = get_psu_change_node(msg_id_str);
+	if (evt_nid == 0) {
+		printf("FAIL: no psu change event node in memdb\n");
+		goto out;
+	}
+
+	listener_nid = libdb_create_node(DB_RMM, evt_nid, MC_REDFISH_LISTENER, SNAPSHOT_NEED_NOT, LOCK_ID_NULL);
+	snprintf(dest, sizeof(dest), "http://127.0.0.1:%d/events", first.port);
+	libdb_attr_set_string(DB_RMM, listener_nid, RF_EVENT_LISTENER_DEST_STR, 0, dest, SNAPSHOT_NEED_NOT, LOCK_ID_NULL);
+	process_memdb_events();
+
+	if (send_event(msg_id_str, "psu 1 changed") != 1 || wait_post(&first, 1) != 0) {
+		printf("FAIL: first event not delivered to %s\n", dest);
+		goto out;
+	}
+	if (strcmp(first.body, "psu 1 changed") != 0) {
+		printf("FAIL: first listener got \"%s\"\n", first.body);
+		goto out;
+	}
+	printf("first event delivered to %s\n", dest);
+
+	/* the cached listener must follow the change of its dest */
+	snprintf(dest, sizeof(dest), "http://127.0.0.1:%d/events", second.port);
+	libdb_attr_set_string(DB_RMM, listener_nid, RF_EVENT_LISTENER_DEST_STR, 0, dest, SNAPSHOT_NEED_NOT, LOCK_ID_NULL);
+	process_memdb_events();
+
+	if (send_event(msg_id_str, "psu 2 changed") != 1 || wait_post(&second, 1) != 0) {
+		printf("FAIL: second event not delivered to %s\n", dest);
+		goto out;
+	}
+	if (strcmp(second.body, "psu 2 changed") != 0 || first.posts != 1) {
+		printf("FAIL: second listener got \"%s\", first got %d posts\n", second.body, first.posts);
+		goto out;
+	}
+	printf("second event delivered to %s\n", dest);
+
+	printf("PASS\n");
+	rc = 0;
+
+out:
+	if (listener_nid != 0)
+		libdb_destroy_node(DB_RMM, listener_nid, LOCK_ID_NULL);
+	rf_deliver_uninit();
+	close(first.fd);
+	close(second.fd);
+	return rc;
+}
@@ -0,0 +1,386 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define _GNU_SOURCE
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/time.h>
+
+/*
+ * Load generator for the REST API of restd. Every client thread sends
+ * GET requests on its own connection and the request rate and latency
+ * percentiles of all of them are reported.
+ *
+ *     restbench [-a addr] [-p port] [-c clients] [-n requests] [-d depth] [-C] [path]
+ *
+ *     -c  concurrent connections, one thread each
+ *     -n  requests per connection
+ *     -d  requests sent before the replies are read (pipelining)
+ *     -C  a new connection per request, as with "Connection: close"
+ */
+#define DEFAULT_ADDR		"127.0.0.1"
+#define DEFAULT_PORT		8090
+#define DEFAULT_PATH		"/v1/rack"
+#define DEFAULT_CLIENTS		16
+#define DEFAULT_REQUESTS	2000
+#define MAX_DEPTH			64
+#define RSP_BUFF_SIZE		(256 * 1024)
+#define RSP_TIMEOUT			5	/* seconds to wait for a reply */
+
+struct bench_client {
+	pthread_t tid;
+	double *latency;	/* seconds, one per request */
+	int done;
+	int errors;
+
+	char *buff;			/* replies read but not consumed yet */
+	int sz;
+};
+
+static struct sockaddr_in server;
+static char request[512];
+static int request_len;
+static int requests = DEFAULT_REQUESTS;
+static int depth = 1;
+static int keep_alive = 1;
+
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int connect_server(void)
+{
+	int fd;
+	int val = 1;
+	struct timeval timo = { RSP_TIMEOUT, 0 };
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+
+	if (connect(fd, (struct sockaddr *)&server, sizeof(server)) < 0) {
+		close(fd);
+		return -1;
+	}
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val));
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timo, sizeof(timo));
+
+	return fd;
+}
+
+static int send_all(int fd, const char *data, int len)
+{
+	int rc;
+	int offset = 0;
+
+	while (offset < len) {
+		rc = write(fd, data + offset, len - offset);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		offset += rc;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief: Size of a chunked body starting at 'body', 0 if it is not
+ *         complete yet, -1 if it is malformed.
+ */
+static int chunked_size(struct bench_client *c, char *body)
+{
+	char *cp = body, *line;
+	char *last = c->buff + c->sz;
+	long len;
+
+	for (;;) {
+		line = memmem(cp, last - cp, "\r\n", 2);
+		if (line == NULL)
+			return 0;
+
+		len = strtol(cp, NULL, 16);
+		if (len < 0 || len > RSP_BUFF_SIZE)
+			return -1;
+
+		cp = line + 2 + len + 2;	/* chunk data and its CRLF */
+		if (cp > last)
+			return 0;
+		if (len == 0)
+			return cp - body;
+	}
+}
+
+/**
+ * @brief: Size of the reply at the head of the client buffer, 0 if it is
+ *         not complete yet, -1 if it is malformed.
+ */
+static int reply_size(struct bench_client *c, int eof)
+{
+	char *end, *cl;
+	long len;
+	int chunked;
+
+	c->buff[c->sz] = '\0';
+	end = memmem(c->buff, c->sz, "\r\n\r\n", 4);
+	if (end == NULL)
+		return 0;
+	*end = '\0';
+
+	if (strncmp(c->buff, "HTTP/1.1 2", 10) != 0) {
+		*end = '\r';
+		return -1;
+	}
+
+	cl = strcasestr(c->buff, "\nContent-Length:");
+	chunked = strcasestr(c->buff, "\nTransfer-Encoding: chunked") != NULL;
+	*end = '\r';
+	if (chunked) {
+		len = chunked_size(c, end + 4);
+		return len > 0 ? end + 4 - c->buff + len : len;
+	}
+	if (cl == NULL)
+		return eof ? c->sz : 0;	/* delimited by the end of the connection */
+
+	len = atol(cl + 16);
+	if (len < 0 || end + 4 - c->buff + len > RSP_BUFF_SIZE - 1)
+		return -1;
+	if (end + 4 - c->buff + len > c->sz)
+		return 0;
+
+	return end + 4 - c->buff + len;
+}
+
+static int read_reply(struct bench_client *c, int fd)
+{
+	int size, r;
+	int eof = 0;
+
+	for (;;) {
+		size = reply_size(c, eof);
+		if (size != 0)
+			break;
+		if (eof || c->sz >= RSP_BUFF_SIZE - 1)
+			return -1;
+
+		r = read(fd, c->buff + c->sz, RSP_BUFF_SIZE - 1 - c->sz);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r < 0)
+			return -1;
+		if (r == 0)
+			eof = 1;
+		c->sz += r;
+	}
+
+	if (size < 0)
+		return -1;
+
+	c->sz -= size;
+	memmove(c->buff, c->buff + size, c->sz);
+	return 0;
+}
+
+static void *client_thread(void *args)
+{
+	struct bench_client *c = (struct bench_client *)args;
+	char batch[sizeof(request) * MAX_DEPTH];
+	double start;
+	int fd = -1;
+	int n, i;
+
+	for (i = 0; i < depth; i++)
+		memcpy(batch + i * request_len, request, request_len);
+
+	while (c->done + c->errors < requests) {
+		n = requests - c->done - c->errors;
+		if (n > depth)
+			n = depth;
+
+		start = now_sec();
+		if (fd < 0) {
+			c->sz = 0;
+			fd = connect_server();
+			if (fd < 0) {
+				c->errors += n;
+				continue;
+			}
+		}
+
+		if (send_all(fd, batch, n * request_len) != 0) {
+			c->errors += n;
+			close(fd);
+			fd = -1;
+			continue;
+		}
+
+		for (i = 0; i < n; i++) {
+			if (read_reply(c, fd) != 0)
+				break;
+			c->latency[c->done++] = now_sec() - start;
+		}
+
+		if (i < n || !keep_alive) {
+			c->errors += n - i;
+			close(fd);
+			fd = -1;
+		}
+	}
+
+	if (fd >= 0)
+		close(fd);
+
+	return NULL;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+static void usage(char *name)
+{
+	printf("usage: %s [-a addr] [-p port] [-c clients] [-n requests] [-d depth] [-C] [path]\n", name);
+	exit(-1);
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_client *clients;
+	char *addr = DEFAULT_ADDR;
+	char *path = DEFAULT_PATH;
+	int port = DEFAULT_PORT;
+	int nclients = DEFAULT_CLIENTS;
+	double *all, sum, start, elapsed;
+	int total, errors;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "a:p:c:n:d:C")) != -1) {
+		switch (opt) {
+		case 'a':
+			addr = optarg;
+			break;
+		case 'p':
+			port = atoi(optarg);
+			break;
+		case 'c':
+			nclients = atoi(optarg);
+			break;
+		case 'n':
+			requests = atoi(optarg);
+			break;
+		case 'd':
+			depth = atoi(optarg);
+			break;
+		case 'C':
+			keep_alive = 0;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind < argc)
+		path = argv[optind];
+
+	if (nclients <= 0 || requests <= 0 || depth <= 0 || depth > MAX_DEPTH)
+		usage(argv[0]);
+	if (!keep_alive)
+		depth = 1;
+
+	memset(&server, 0, sizeof(server));
+	server.sin_family = AF_INET;
+	server.sin_port = htons(port);
+	if (inet_pton(AF_INET, addr, &server.sin_addr) != 1)
+		usage(argv[0]);
+
+	request_len = snprintf(request, sizeof(request),
+						   "GET %s HTTP/1.1\r\n"
+						   "Host: %s:%d\r\n"
+						   "Connection: %s\r\n"
+						   "\r\n",
+						   path, addr, port, keep_alive ? "keep-alive" : "close");
+
+	clients = calloc(nclients, sizeof(*clients));
+	all = malloc(sizeof(double) * nclients * requests);
+	if (clients == NULL || all == NULL) {
+		printf("no memory\n");
+		return -1;
+	}
+
+	for (i = 0; i < nclients; i++) {
+		clients[i].latency = all + i * requests;
+		clients[i].buff = malloc(RSP_BUFF_SIZE);
+		if (clients[i].buff == NULL) {
+			printf("no memory\n");
+			return -1;
+		}
+	}
+
+	start = now_sec();
+	for (i = 0; i < nclients; i++) {
+		if (pthread_create(&clients[i].tid, NULL, client_thread, &clients[i]) != 0) {
+			printf("failed to create client thread %d\n", i);
+			return -1;
+		}
+	}
+
+	total = 0;
+	errors = 0;
+	for (i = 0; i < nclients; i++) {
+		pthread_join(clients[i].tid, NULL);
+		/* pack the latencies of all clients */
+		memmove(all + total, clients[i].latency, sizeof(double) * clients[i].done);
+		total += clients[i].done;
+		errors += clients[i].errors;
+	}
+	elapsed = now_sec() - start;
+
+	printf("GET %s, %d clients, %s, pipeline depth %d\n", path, nclients,
+		   keep_alive ? "keep-alive" : "connection per request", depth);
+	printf("%d requests, %d errors in %.2f s: %.0f requests/s\n",
+		   total, errors, elapsed, total / elapsed);
+
+	if (total > 0) {
+		qsort(all, total, sizeof(double), cmp_double);
+		for (sum = 0, i = 0; i < total; i++)
+			sum += all[i];
+
+		printf("latency ms: avg %.3f  p50 %.3f  p99 %.3f  max %.3f\n",
+			   sum / total * 1000, all[total / 2] * 1000,
+			   all[(int)(total * 0.99)] * 1000, all[total - 1] * 1000);
+	}
+
+	return errors ? 1 : 0;
+}
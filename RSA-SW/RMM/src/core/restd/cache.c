@@ -0,0 +1,312 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <pthread.h>
+
+#include "http.h"
+#include "cache.h"
+#include "memdb_event.h"
+
+#define CACHE_HASH_INIT		2166136261U
+#define CACHE_HASH_PRIME	16777619U
+
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct list_head cache_lru = LIST_HEAD_INIT(cache_lru);
+static struct rest_cache_entry *cache_table[REST_CACHE_BUCKETS];
+static int32 cache_num;
+static int32 cache_enabled;
+
+/* bumped on every memdb event, a reply rendered across one is not kept */
+static uint64 cache_gen;
+
+
+static uint32 cache_hash(const int8 *data, int32 len)
+{
+	uint32 hash = CACHE_HASH_INIT;
+	int32 i;
+
+	for (i = 0; i < len; i++)
+		hash = (hash ^ (uint8)data[i]) * CACHE_HASH_PRIME;
+
+	return hash;
+}
+
+static time_t cache_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec;
+}
+
+static void free_entry(struct rest_cache_entry *entry)
+{
+	free(entry->body);
+	free(entry->deps);
+	free(entry);
+}
+
+/* cache_mutex held */
+static void unlink_entry(struct rest_cache_entry *entry)
+{
+	struct rest_cache_entry **pp = &cache_table[entry->hash & (REST_CACHE_BUCKETS - 1)];
+
+	while (*pp != entry)
+		pp = &(*pp)->next;
+	*pp = entry->next;
+
+	list_del(&entry->list);
+	cache_num--;
+
+	if (--entry->refcnt == 0)
+		free_entry(entry);
+}
+
+static int32 depends_on(const struct rest_cache_entry *entry, memdb_integer node_id)
+{
+	int32 i;
+
+	for (i = 0; i < entry->num_deps; i++) {
+		if (entry->deps[i] == node_id)
+			return 1;
+	}
+
+	return 0;
+}
+
+static void cache_event(struct event_info *evt, void *unused)
+{
+	struct rest_cache_entry *entry, *n;
+	int32 hit;
+
+	pthread_mutex_lock(&cache_mutex);
+	cache_gen++;
+
+	list_for_each_entry_safe(entry, n, &cache_lru, list) {
+		if (evt->event == EVENT_NODE_ATTR)
+			hit = depends_on(entry, evt->anodeid);
+		else
+			hit = entry->any_node || depends_on(entry, evt->nnodeid) ||
+				  depends_on(entry, evt->nparent);
+
+		if (hit)
+			unlink_entry(entry);
+	}
+
+	pthread_mutex_unlock(&cache_mutex);
+}
+
+int32 rest_cache_init(void)
+{
+	if (memdb_event_listen(cache_event, NULL) != 0)
+		return -1;
+
+	cache_enabled = 1;
+	return 0;
+}
+
+/**
+ * @brief: Build the cache key of a request, return -1 if it is too long
+ *         to be cached. The host is part of it as the replies hold links.
+ */
+int32 rest_cache_key(int8 *key, int32 sz, const int8 *host, const int8 *path, const int8 *query)
+{
+	int32 len;
+
+	len = snprintf(key, sz, "%s %s?%s", host ? : "", path, query ? : "");
+
+	return (len < sz) ? 0 : -1;
+}
+
+struct rest_cache_entry *rest_cache_get(const int8 *key)
+{
+	struct rest_cache_entry *entry;
+	uint32 hash;
+
+	if (!cache_enabled)
+		return NULL;
+
+	hash = cache_hash(key, strlen(key));
+
+	pthread_mutex_lock(&cache_mutex);
+	for (entry = cache_table[hash & (REST_CACHE_BUCKETS - 1)]; entry != NULL; entry = entry->next) {
+		if (entry->hash == hash && strcmp(entry->key, key) == 0)
+			break;
+	}
+
+	if (entry != NULL) {
+		if (entry->expire <= cache_now()) {
+			unlink_entry(entry);
+			entry = NULL;
+		} else {
+			list_del(&entry->list);
+			list_add(&entry->list, &cache_lru);
+			entry->refcnt++;
+		}
+	}
+	pthread_mutex_unlock(&cache_mutex);
+
+	return entry;
+}
+
+void rest_cache_put(struct rest_cache_entry *entry)
+{
+	int32 refcnt;
+
+	pthread_mutex_lock(&cache_mutex);
+	refcnt = --entry->refcnt;
+	pthread_mutex_unlock(&cache_mutex);
+
+	if (refcnt == 0)
+		free_entry(entry);
+}
+
+static void record_read(unsigned char db_name, memdb_integer node, void *arg)
+{
+	struct rest_cache_render *render = (struct rest_cache_render *)arg;
+	int32 i;
+
+	/* only the nodes of DB_RMM are subscribed */
+	if (db_name != DB_RMM || node == LIBDB_READ_ANY) {
+		render->cacheable = 0;
+		return;
+	}
+
+	if (node == LIBDB_READ_NODES) {
+		render->any_node = 1;
+		return;
+	}
+
+	for (i = render->num_deps - 1; i >= 0; i--) {
+		if (render->deps[i] == node)
+			return;
+	}
+
+	if (render->num_deps == REST_CACHE_MAX_DEPS) {
+		render->cacheable = 0;
+		return;
+	}
+	render->deps[render->num_deps++] = node;
+}
+
+void rest_cache_render_begin(struct rest_cache_render *render)
+{
+	render->cacheable = cache_enabled;
+	render->any_node = 0;
+	render->num_deps = 0;
+
+	pthread_mutex_lock(&cache_mutex);
+	render->gen = cache_gen;
+	pthread_mutex_unlock(&cache_mutex);
+
+	libdb_set_read_hook(record_read, render);
+}
+
+void rest_cache_render_end(struct rest_cache_render *render)
+{
+	libdb_set_read_hook(NULL, NULL);
+}
+
+/**
+ * @brief: Subscribe the attribute events of the nodes 'render' depends
+ *         on, return 0 if all of them were subscribed before it started.
+ */
+static int32 watch_deps(const struct rest_cache_render *render)
+{
+	int32 rc = 0;
+	int32 i;
+
+	for (i = 0; i < render->num_deps; i++) {
+		if (memdb_event_watch_node(render->deps[i]) != 0)
+			rc = -1;
+	}
+
+	return rc;
+}
+
+struct rest_cache_entry *rest_cache_add(const int8 *key, struct rest_cache_render *render,
+										int8 *body, int32 body_len, int32 status, const int8 *title)
+{
+	struct rest_cache_entry *entry, *old;
+	struct rest_cache_entry **bucket;
+	int32 keylen = strlen(key);
+
+	entry = malloc(sizeof(*entry) + keylen + 1);
+	if (entry == NULL) {
+		free(body);
+		return NULL;
+	}
+	memset(entry, 0, sizeof(*entry));
+	memcpy(entry->key, key, keylen + 1);
+
+	entry->hash = cache_hash(key, keylen);
+	entry->refcnt = 1;
+	entry->status = status;
+	entry->title = title;
+	entry->body = body;
+	entry->body_len = body_len;
+	snprintf(entry->etag, sizeof(entry->etag), "\"%08x-%x\"",
+			 cache_hash(body, body_len), (uint32)body_len);
+
+	/* a change before a node was subscribed is missed, cache the next one */
+	if (!render->cacheable || watch_deps(render) != 0)
+		return entry;
+
+	if (render->num_deps > 0) {
+		entry->deps = malloc(render->num_deps * sizeof(*entry->deps));
+		if (entry->deps == NULL)
+			return entry;
+		memcpy(entry->deps, render->deps, render->num_deps * sizeof(*entry->deps));
+	}
+	entry->num_deps = render->num_deps;
+	entry->any_node = render->any_node;
+	entry->expire = cache_now() + REST_CACHE_TTL;
+
+	pthread_mutex_lock(&cache_mutex);
+	if (render->gen != cache_gen)
+		goto out;
+
+	bucket = &cache_table[entry->hash & (REST_CACHE_BUCKETS - 1)];
+	for (old = *bucket; old != NULL; old = old->next) {
+		if (old->hash == entry->hash && strcmp(old->key, key) == 0) {
+			unlink_entry(old);
+			break;
+		}
+	}
+
+	if (cache_num >= REST_CACHE_MAX)
+		unlink_entry(list_entry(cache_lru.prev, struct rest_cache_entry, list));
+
+	entry->next = *bucket;
+	*bucket = entry;
+	list_add(&entry->list, &cache_lru);
+	entry->refcnt++;
+	cache_num++;
+
+out:
+	pthread_mutex_unlock(&cache_mutex);
+	return entry;
+}
+
+void rest_cache_flush(void)
+{
+	struct rest_cache_entry *entry, *n;
+
+	pthread_mutex_lock(&cache_mutex);
+	cache_gen++;
+	list_for_each_entry_safe(entry, n, &cache_lru, list)
+		unlink_entry(entry);
+	pthread_mutex_unlock(&cache_mutex);
+}
@@ -0,0 +1,89 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include "libutils/list.h"
+#include "libutils/rmm.h"
+#include "libmemdb/memdb.h"
+#include "libutils/types.h"
+
+/*
+ * Cache of the JSON replies of GET handlers, keyed by host, path and
+ * query of the request. While a reply is rendered the memdb nodes read
+ * are recorded through the libdb read hook; the reply is dropped as soon
+ * as memdb reports an attribute change, creation or deletion of one of
+ * them. Replies that read what can not be tracked are not kept, and an
+ * entry expires after REST_CACHE_TTL in case an event was lost.
+ */
+#define REST_CACHE_MAX		512		/* replies kept */
+#define REST_CACHE_BUCKETS	1024	/* power of 2 */
+#define REST_CACHE_TTL		10		/* seconds */
+#define REST_CACHE_MAX_DEPS	256		/* nodes a cached reply may depend on */
+#define REST_CACHE_KEY_LEN	(MAX_URL * 2)
+
+struct rest_cache_entry {
+	struct list_head list;			/* LRU, most recent first */
+	struct rest_cache_entry *next;	/* in the hash bucket */
+	uint32 hash;
+	int32 refcnt;
+	time_t expire;
+
+	int32 status;
+	const int8 *title;
+	int8 etag[24];
+	int8 *body;
+	int32 body_len;
+
+	int32 any_node;					/* depends on the nodes listed by type */
+	int32 num_deps;
+	memdb_integer *deps;
+
+	int8 key[0];
+};
+
+/* what a GET handler reads from memdb while its reply is rendered */
+struct rest_cache_render {
+	uint64 gen;
+	int32 cacheable;
+	int32 any_node;
+	int32 num_deps;
+	memdb_integer deps[REST_CACHE_MAX_DEPS];
+};
+
+extern int32 rest_cache_init(void);
+extern int32 rest_cache_key(int8 *key, int32 sz, const int8 *host, const int8 *path, const int8 *query);
+
+extern struct rest_cache_entry *rest_cache_get(const int8 *key);
+extern void rest_cache_put(struct rest_cache_entry *entry);
+
+extern void rest_cache_render_begin(struct rest_cache_render *render);
+extern void rest_cache_render_end(struct rest_cache_render *render);
+
+/**
+ * @brief: Make an entry of the reply 'body' rendered by 'render', which
+ *         is owned by the entry then, and keep it if nothing it depends
+ *         on changed meanwhile. The entry is returned referenced.
+ */
+extern struct rest_cache_entry *rest_cache_add(const int8 *key, struct rest_cache_render *render,
+											   int8 *body, int32 body_len, int32 status, const int8 *title);
+
+/**
+ * @brief: Drop all the replies, after restd itself changed memdb.
+ */
+extern void rest_cache_flush(void);
+
+#endif
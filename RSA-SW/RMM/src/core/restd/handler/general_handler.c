@@ -136,22 +136,23 @@ static bool get_index_by_uuid(const int8 *uuid, const int32 type, int32 *index)
 
 int32 get_asset_idx(const struct rest_uri_param *param, const int8 *name, int32 type)
 {
-	int8 *p_id = NULL;
+	const struct rest_param_key *key;
 	int32 index;
 
-	p_id = rest_path_value(param, name);
-	if (p_id == NULL) {
+	key = rest_path_key(param, name);
+	if (key == NULL) {
 		HTTPD_ERR("get value fail\n");
 		return -1;
 	}
 
-	if (TRUE == is_str_uuid((const int8 *)p_id)) {
-		if (FALSE == get_index_by_uuid((const int8 *)p_id, type, &index)) {
-			HTTPD_ERR("uuid %s error!\n", p_id);
+	/* the router classified the value when it matched the path */
+	if (key->type == REST_VAR_UUID) {
+		if (FALSE == get_index_by_uuid((const int8 *)key->value, type, &index)) {
+			HTTPD_ERR("uuid %s error!\n", key->value);
 			return -1;
 		}
 	} else
-		index = (uint32)str2int(p_id);
+		index = key->id;
 
 	return index;
 }
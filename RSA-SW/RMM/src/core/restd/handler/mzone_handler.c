@@ -711,6 +711,7 @@ static struct rest_handler mbp_coll_handler = {
 	.get    = mbp_coll_get,
 	.put    = mbp_coll_put,
 	.post   = mbp_coll_post,
+	.cache  = 1,
 };
 
 static struct rest_handler mbp_handler = {
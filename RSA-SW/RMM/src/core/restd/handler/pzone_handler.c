@@ -888,12 +888,14 @@ static struct rest_handler pzone_coll_handler = {
 	.get    = pzone_coll_get,
 	.put    = pzone_coll_put,
 	.post   = pzone_coll_post,
+	.cache  = 1,
 };
 
 static struct rest_handler pzone_handler = {
 	.get    = pzone_get,
 	.put    = pzone_put,
 	.post   = pzone_post,
+	.cache  = 1,
 };
 
 
@@ -901,12 +903,14 @@ static struct rest_handler psu_coll_handler = {
 	.get    = psu_coll_get,
 	.put    = psu_coll_put,
 	.post   = psu_coll_post,
+	.cache  = 1,
 };
 
 static struct rest_handler psu_handler = {
 	.get    = psu_get,
 	.put    = psu_put,
 	.post   = psu_post,
+	.cache  = 1,
 };
 
 static struct rest_handler pzone_coll_evt_handler = {
@@ -1050,6 +1050,7 @@ static struct rest_handler rack_handler = {
 	.get	= rack_get,
 	.put	= rack_put,
 	.post	= rack_post,
+	.cache	= 1,
 };
 
 static struct rest_handler rack_evt_handler = {
@@ -1088,6 +1089,7 @@ static struct rest_handler rack_platform_handler = {
 	.get	= rack_platform_get,
 	.put	= NULL,
 	.post	= NULL,
+	.cache	= 1,
 };
 
 
@@ -21,15 +21,16 @@
 #include "librmmcfg/rmm_cfg.h"
 
 
-static int32 add_headers(int8 *buf, int32 status, const int8 *title, const int8 *extra_header,
-			const int8 *mime_type);
+static int32 add_headers(struct http_request *req, int8 *buf, int32 status, const int8 *title,
+			const int8 *extra_header, const int8 *mime_type, int64 content_length);
 static int8 *file_mime_type(const int8 *name);
 static void decode_url(struct http_request *req, int8 *url);
 static int32 http_method(const int8 *method);
-static int8 *parse_reqline(int32 fd, int8 *str);
+static int8 *parse_reqline(int8 *str);
+static int32 get_http_head_sz(struct http_request *req);
+static int32 parse_header(struct http_request *req);
 static int8 *get_request_line(struct http_request *req);
-static uint32 get_json_pointer(struct http_request *req);
-static int32 re_alloc_buff(struct http_request *req);
+static int32 re_alloc_buff(struct http_request *req, int32 size);
 
 
 
@@ -83,95 +84,149 @@ int32 http_write(int32 fd, const int8 *data, int32 len)
 	return offset;
 }
 
+/**
+ * @brief: Write all of 'iov' in as few system calls as possible, 'iov' is
+ *         consumed on the way.
+ */
+int32 http_writev(int32 fd, struct iovec *iov, int32 cnt)
+{
+	ssize_t rc;
+	int32 total = 0;
+
+	while (cnt > 0) {
+		rc = writev(fd, iov, cnt);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		total += rc;
+
+		while (cnt > 0 && rc >= iov->iov_len) {
+			rc -= iov->iov_len;
+			iov++;
+			cnt--;
+		}
+		if (cnt > 0) {
+			iov->iov_base = (int8 *)iov->iov_base + rc;
+			iov->iov_len -= rc;
+		}
+	}
+
+	return total;
+}
 
-void send_error(int32 fd, int32 status, const int8 *title, const int8 *extra_header, const int8 *text)
+
+void send_error(struct http_request *req, int32 status, const int8 *title, const int8 *extra_header, const int8 *text)
 {
 	int32 len = 0;
-	int32 str_len = 0;
+	int32 body_len = 0;
 	int8 buf[BUFFSIZ];
+	int8 body[BUFFSIZ - MAX_HEADER_LEN];
+
+	/* 204 has no message body, a client would take it as the next reply */
+	if (status != 204) {
+		body_len = snprintf(body, sizeof(body),
+					"<HTML>"
+					"<HEAD><TITLE>%d %s</TITLE></HEAD>\n"
+					"<BODY BGCOLOR=\"#cc9999\">"
+					"<H4>%d %s</H4>\n"
+					"%s\n"
+					"</BODY></HTML>\n",
+					status, title, status, title, text);
+		if (body_len >= sizeof(body))
+			body_len = sizeof(body) - 1;
+	}
+
+	len = add_headers(req, buf, status, title, extra_header, "text/html", body_len);
+	memcpy(&buf[len], body, body_len);
+	len += body_len;
 
-	len += add_headers(buf, status, title, extra_header, "text/html");
-	str_len = len;
-	len += snprintf(&buf[len], (BUFFSIZ - str_len), 
-				"<HTML>"
-				"<HEAD><TITLE>%d %s</TITLE></HEAD>\n"
-				"<BODY BGCOLOR=\"#cc9999\">"
-				"<H4>%d %s</H4>\n",
-				status, title, status, title);
-	str_len = len;
-	len += snprintf(&buf[len], (BUFFSIZ - str_len), "%s\n", text);
-	str_len = len;
-	len += snprintf(&buf[len], (BUFFSIZ - str_len), "</BODY></HTML>\n");
-
-	http_write(fd, buf, len);
+	http_write(req->fd, buf, len);
 }
 
 
-void *http_process(void *args)
+/**
+ * @brief: Parse the request at the head of req->buff, which holds req->sz
+ *         bytes. The header is split in place the first time it is found
+ *         complete, later calls only wait for the rest of the body.
+ */
+int32 http_parse_request(struct http_request *req)
 {
-	int32		fd;
-	struct	http_request *req;
-	int8 *cp = NULL;
-	int8 *line = NULL;
-	int8 *method = NULL;
-	int8 *url = NULL;
-	int8 *protocol = NULL;
-	struct timeval timo;
-	int32 optval = 1;
-	int32 rc, rc_r, rc_s;
-	int32 r = 0;
+	int32 need;
+
+	if (req->hd_sz == 0) {
+		if (get_http_head_sz(req) == 0) {
+			/* leave room for the '\0' after the data */
+			if (req->sz >= req->buff_size - 1)
+				return HTTP_PARSE_ERROR;
+			return HTTP_PARSE_AGAIN;
+		}
 
-	if (NULL == args)
-		return NULL;
+		if (parse_header(req) != 0)
+			return HTTP_PARSE_ERROR;
+	}
 
-	req = (struct http_request *)args;
-	fd = req->fd;
+	need = req->hd_sz + req->content_length;
+	if (need >= req->buff_size && re_alloc_buff(req, need + 1) != 0)
+		return HTTP_PARSE_ERROR;
 
-	req->buff = malloc(BUFFSIZ);
-	req->buff_size = BUFFSIZ;
-	if (NULL == req->buff) {
-		HTTPD_ERR("get_request_line malloc %d fail\n", BUFFSIZ);
-		free(args);
-		return NULL;
-	}
-	memset(req->buff, 0, BUFFSIZ);
+	if (req->sz < need)
+		return HTTP_PARSE_AGAIN;
 
-	rc = setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval));
-	if (rc < 0)
-		HTTPD_ERR("setsockopt error rc=%d errno=%d %s\n", rc, errno, strerror(errno));
+	return HTTP_PARSE_DONE;
+}
 
-	timo.tv_sec  = HTTPD_TIMO;
-	timo.tv_usec = 0;
+/**
+ * @brief: Drop the request just served and move any pipelined data
+ *         behind it to the head of the buffer.
+ */
+void http_next_request(struct http_request *req)
+{
+	struct http_request next;
+	int32 used = req->hd_sz + req->content_length;
+	int32 left = req->sz - used;
+
+	if (left > 0)
+		memmove(req->buff, req->buff + used, left);
+	else
+		left = 0;
+
+	memset(&next, 0, sizeof(next));
+	next.fd = req->fd;
+	next.from = req->from;
+	next.tid_rest_req = req->tid_rest_req;
+	next.buff = req->buff;
+	next.buff_size = req->buff_size;
+	next.sz = left;
+
+	*req = next;
+}
 
-	rc_r = setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timo, sizeof(timo));
-	rc_s = setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timo, sizeof(timo));
-	if (rc_r < 0 || rc_s < 0)
-		HTTPD_ERR("setsockopt error fd=%d rc=%d rc_r=%d rc_s=%d errno=%d %s\n", fd, rc, rc_r, rc_s, errno, strerror(errno));
+static int32 parse_header(struct http_request *req)
+{
+	int8 *cp = NULL;
+	int8 *line = NULL;
+	int8 *method = NULL;
+	int8 *url = NULL;
+	int8 *protocol = NULL;
 
 	/* GET / HTTP/1.1 */
 	method = get_request_line(req);
 	if (method == NULL)
-		goto close_task;
+		return -1;
 
-	url = parse_reqline(fd, method);
+	url = parse_reqline(method);
 	if (url == NULL)
-		goto close_task;
+		return -1;
 
-	protocol = parse_reqline(fd, url);
+	protocol = parse_reqline(url);
 	if (protocol == NULL)
-		goto close_task;
+		return -1;
 
 	req->method = http_method(method);
-
-	if (req->method == M_OPTIONS) {
-		send_error(fd, 204, "No Content", NULL, "Method OPTIONS.");
-		goto close_task;
-	}
-
-	if (req->method == M_UNKNOWN) {
-		send_error(fd, 400, "Bad Request", NULL, "Method Not Support.");
-		goto close_task;
-	}
+	req->is_http11 = (strcasecmp(protocol, HTTPD_PROTOCOL) == 0);
+	req->keep_alive = req->is_http11;
 
 	decode_url(req, url);
 
@@ -194,6 +249,10 @@ void *http_process(void *args)
 			/* Firefox: [Connection: keep-alive, Upgrade] */
 			if (strcasestr(cp, "Upgrade") != NULL)
 				req->is_connection_upgrade = 1;
+			if (strcasestr(cp, "close") != NULL)
+				req->keep_alive = 0;
+			else if (strcasestr(cp, "keep-alive") != NULL)
+				req->keep_alive = 1;
 		} else if (strncasecmp(line, "Sec-WebSocket-Key:", 18) == 0) {
 			cp = &line[18];
 			cp += strspn(cp, " \t");
@@ -211,11 +270,8 @@ void *http_process(void *args)
 			cp += strspn(cp, " \t");
 			req->content_length = atol(cp);
 
-			if ((BUFFSIZ < req->content_length + MAX_HEADER_LEN) &&
-				(req->buff_size != req->content_length + MAX_HEADER_LEN) + 1) {
-				re_alloc_buff(req);
-				memset(req->buff + BUFFSIZ, 0, req->buff_size - BUFFSIZ);
-			}
+			if (req->content_length < 0 || req->content_length > HTTPD_MAX_BODY)
+				return -1;
 		} else if (strncasecmp(line, "Content-Type:", 13) == 0) {
 			cp = &line[13];
 			cp += strspn(cp, " \t");
@@ -224,91 +280,93 @@ void *http_process(void *args)
 			cp = &line[5];
 			cp += strspn(cp, " \t");
 			req->host = cp;
+		} else if (strncasecmp(line, "If-None-Match:", 14) == 0) {
+			cp = &line[14];
+			cp += strspn(cp, " \t");
+			req->if_none_match = cp;
 		}
 	}
 
 	HTTPD_INFO("Left %d bytes HTTP data with Content-Length: %ld req->sz[%d] req->pos[%d]\n",
 			req->sz - req->pos, req->content_length, req->sz, req->pos);
 
-	if (line == NULL || req->path[0] != '/')
-		send_error(fd, 400, "Bad Request", NULL, "Bad Request!");
+	return 0;
+}
 
-	if ((0 != req->content_length) && (req->sz != req->hd_sz + req->content_length)) {
-		while ((r = http_read(req->fd, req->buff + req->sz, req->buff_size - req->sz)) > 0) {
-			req->sz += r;
-			if (req->sz == req->hd_sz + req->content_length)
-				break;
-		}
+void http_process(struct http_request *req)
+{
+	uint32 i = 0;
+	int8 *file = NULL;
+	int8 *path = req->path;
+	int8 *pTmp = path;
+	int8 prefix[MAX_URL] = {0};
+	int8 new_link[MAX_URL + 8] = {0};
+	int8 *end = req->buff + req->hd_sz + req->content_length;
+	int8 next = *end;
+
+	if (req->method == M_OPTIONS) {
+		send_error(req, 204, "No Content", NULL, "Method OPTIONS.");
+		return;
 	}
 
-	if (req->is_websocket)
-		ws_process(req);
-	else {
-		uint32 i = 0;
-		int8 *file = NULL;
-		int8 *path = req->path;
-		int8 *pTmp = path;
-		int8 prefix[MAX_URL] = {0};
-		int8 new_link[MAX_URL + 8] = {0};
-
-		rmm_cfg_get_rest_prefix(prefix, MAX_URL);
-		snprintf(new_link, (MAX_URL + 8), "%s%s", prefix, "/rack");
-
-		/*TODO: move to correct place */
-		get_json_pointer(req);
-
-		/* remove redundant '/' */
-		for (; *(path+i) != '\0'; i++) {
-			if ((*(path+i) == '/') && (*(path+i+1) == '/'))
-				continue;
-			*pTmp++ = *(path+i);
-		}
-		*pTmp = '\0';
-		if ((path[1] == '\0')
-			|| (strncasecmp(path, new_link, strlen(new_link)) == 0))
-			file = NULL;
-		else
-			file = path;
-
-		if (file != NULL)
-			send_file(req->fd, file);
-		else
-			rest_process(req);
+	if (req->method == M_UNKNOWN) {
+		send_error(req, 400, "Bad Request", NULL, "Method Not Support.");
+		return;
 	}
 
-close_task:
-	close(fd);
-	if (NULL != req->buff) {
-		free(req->buff);
-		req->buff = NULL;
+	if (req->path[0] != '/') {
+		send_error(req, 400, "Bad Request", NULL, "Bad Request!");
+		return;
+	}
+
+	rmm_cfg_get_rest_prefix(prefix, MAX_URL);
+	snprintf(new_link, (MAX_URL + 8), "%s%s", prefix, "/rack");
+
+	/* remove redundant '/' */
+	for (; *(path+i) != '\0'; i++) {
+		if ((*(path+i) == '/') && (*(path+i+1) == '/'))
+			continue;
+		*pTmp++ = *(path+i);
 	}
-	free(args);
-	HTTPD_INFO("\nrest_req_thread[%lld] exit, fd[%d], errno:%d %s\n", (uint64)(req->tid_rest_req), fd, errno, strerror(errno));
-	return NULL;
+	*pTmp = '\0';
+	if ((path[1] == '\0')
+		|| (strncasecmp(path, new_link, strlen(new_link)) == 0))
+		file = NULL;
+	else
+		file = path;
+
+	/* handlers parse the body as a string, a pipelined request may follow it */
+	*end = '\0';
+
+	if (file != NULL)
+		send_file(req, file);
+	else
+		rest_process(req);
+
+	*end = next;
 }
 
 /* @name starts from "/", such as "/index.html" */
-void send_file(int32 sockfd, const int8 *name)
+void send_file(struct http_request *req, const int8 *name)
 {
 	int32 fd;
 	int32 r, len;
+	int32 sockfd = req->fd;
 	int64 filesize;
 	struct stat st;
-	int8 path[1024], contentlen[128], buf[BUFFSIZ];
+	int8 path[1024], buf[BUFFSIZ];
 
 	snprintf(path, sizeof(path), "%s%s", HTTPD_WORK_DIR, name);
 
 	if (stat(path, &st) < 0 || (fd = open(path, O_RDONLY)) < 0) {
-		send_error(sockfd, 404, "Not Found", NULL, "File not Found.");
-		close(sockfd);
+		send_error(req, 404, "Not Found", NULL, "File not Found.");
 		HTTPD_ERR("Not found file %s\n", path);
 		return;
 	}
 
 	filesize = st.st_size;
-	snprintf(contentlen, sizeof(contentlen), "Content-Length: %lld", filesize);
 
-	len = add_headers(buf, 200, "OK", contentlen, file_mime_type(name));
+	len = add_headers(req, buf, 200, "OK", NULL, file_mime_type(name), filesize);
 	http_write(sockfd, buf, len);
 
 	while (filesize > 0) {
@@ -322,6 +380,10 @@ void send_file(int32 sockfd, const int8 *name)
 		filesize -= r;
 	}
 
+	/* the reply is short of Content-Length, the connection is out of sync */
+	if (filesize > 0)
+		req->keep_alive = 0;
+
 	close(fd);
 }
 
@@ -362,8 +424,8 @@ static int8 *file_mime_type(const int8 *name)
 }
 
 
-static int32 add_headers(int8 *buf, int32 status, const int8 *title, const int8 *extra_header,
-			const int8 *mime_type)
+static int32 add_headers(struct http_request *req, int8 *buf, int32 status, const int8 *title,
+			const int8 *extra_header, const int8 *mime_type, int64 content_length)
 {
 	int32 len = 0;
 	time_t now;
@@ -383,13 +445,19 @@ static int32 add_headers(int8 *buf, int32 status, const int8 *title, const int8
 		len += snprintf(&buf[len], (BUFFSIZ - len), "%s\r\n", extra_header);
 	if (mime_type != NULL)
 		len += snprintf(&buf[len], (BUFFSIZ - len), "Content-Type: %s\r\n", mime_type);
+	if (content_length >= 0)
+		len += snprintf(&buf[len], (BUFFSIZ - len), "Content-Length: %lld\r\n", content_length);
 
 	len += snprintf(&buf[len], (BUFFSIZ - len), "Access-Control-Allow-Origin: *\r\n");        /* Allow swagger json access */
 	len += snprintf(&buf[len], (BUFFSIZ - len), "Access-Control-Allow-Headers:Content-Type, api_key, Authorization\r\n");    /* Allow swagger to allow method POSe */
 	len += snprintf(&buf[len], (BUFFSIZ - len), "Access-Control-Allow-Methods: GET,PUT,POST,DELETE\r\n");
 	len += snprintf(&buf[len], (BUFFSIZ - len), "Allow:OPTIONS,POST,PUT\r\n");
 	len += snprintf(&buf[len], (BUFFSIZ - len), "Proxy-Connection: Keep-Alive\r\n");
-	len += snprintf(&buf[len], (BUFFSIZ - len), "Connection: close\r\n");
+	if (req->keep_alive)
+		len += snprintf(&buf[len], (BUFFSIZ - len), "Connection: keep-alive\r\n"
+						"Keep-Alive: timeout=%d\r\n", HTTPD_KEEPALIVE_TIMO);
+	else
+		len += snprintf(&buf[len], (BUFFSIZ - len), "Connection: close\r\n");
 	len += snprintf(&buf[len], (BUFFSIZ - len), "\r\n");
 
 	return len;
@@ -442,14 +510,12 @@ static int32 http_method(const int8 *method)
 	return M_UNKNOWN;
 }
 
-static int8 *parse_reqline(int32 fd, int8 *str)
+static int8 *parse_reqline(int8 *str)
 {
 	int8 *cp;
 
 	cp = strpbrk(str, " \t");
-	if (cp == NULL) {
-		send_error(fd, 400, "Bad Request", NULL, "Can't parse HTTP Request.");
-	} else {
+	if (cp != NULL) {
 		*cp++ = '\0';
 		cp += strspn(cp, " \t");
 	}
@@ -466,10 +532,17 @@ static int32 get_http_head_sz(struct http_request *req)
 
 	buf = req->buff;
 
-	for (i = 0; i < req->sz; i++) {
-		if ((i+3 < req->sz) &&
-			(0 == memcmp(&buf[i], "\r\n\r\n", 4))) {
-			req->hd_sz = i+3+1;
+	/* the header ends with an empty line, be lenient with bare '\n' */
+	for (i = 0; i + 1 < req->sz; i++) {
+		if (buf[i] != '\n')
+			continue;
+
+		if (buf[i+1] == '\n') {
+			req->hd_sz = i+1+1;
+			break;
+		}
+		if ((i+2 < req->sz) && (0 == memcmp(&buf[i+1], "\r\n", 2))) {
+			req->hd_sz = i+2+1;
 			break;
 		}
 	}
@@ -481,16 +554,13 @@ static int8 *get_request_line(struct http_request *req)
 	if (NULL == req)
 		return NULL;
 
-	int32 r = 0;
 	int32 i = req->pos;
 	int8 *buf = NULL;
 	int8 ch, *line = NULL;
 
 	buf = req->buff;
 
-
-again:
-	for (; req->pos < req->sz; req->pos++) {
+	for (; req->pos < req->hd_sz; req->pos++) {
 		ch = buf[req->pos];
 
 		if (ch == '\r') {
@@ -502,78 +572,13 @@ again:
 		}
 	}
 
-	if ((line == NULL)
-		&& (r = http_read(req->fd, buf + req->sz, req->buff_size - req->sz)) > 0) {
-		req->sz += r;
-		get_http_head_sz(req);
-		goto again;
-	}
-
 	return line;
 }
 
 
-static uint32 get_json_pointer(struct http_request *req)
-{
-	uint32 i = 0;
-	uint32 first_matched = 0;
-	uint8 starter = 0;
-	int32 checker_brace = 0;   /* checker of '{' '}'*/
-	int32 checker_bracket = 0; /* checker of '['  ']' */
-	int32 checker_quote = 0;   /* checked of '"' */
-
-	for (i = 0; i < req->sz; i++) {
-		switch (req->buff[i]) {
-		case '{':
-			checker_brace++;
-			if ((0 == first_matched)) {
-				req->json_start = i;
-				starter = '{';
-				first_matched = 1;
-			}
-			break;
-		case '}':
-			checker_brace--;
-			if (starter == '{')
-				req->json_end = i;
-			break;
-		case '[':
-			checker_bracket++;
-			if ((0 == first_matched)) {
-				req->json_start = i;
-				starter = '[';
-				first_matched = 1;
-			}
-			break;
-		case ']':
-			checker_bracket--;
-			if (starter == '[')
-				req->json_end = i;
-			break;
-		case '"':
-			checker_quote++;
-			break;
-
-		default:
-			break;
-		}
-	}
-
-	if (checker_brace || checker_bracket || (checker_quote%2 != 0) ||
-		(0 == req->json_start) || (0 == req->json_end) || (req->json_start > req->json_end)) {
-		printf("brace[%d] bracket[%d] quote[%d] content_length[%lld] hd_sz[%d] sz[%d] json_start[%d] json_end[%d]\n",
-			checker_brace, checker_bracket, checker_quote, req->content_length, req->hd_sz, req->sz, req->json_start, req->json_end);
-		return 0;
-	}
-	HTTPD_DEBUG("content_length[%ld] hd_sz[%d] sz[%d] json_start[%d] json_end[%d]\n",
-		req->content_length, req->hd_sz, req->sz, req->json_start, req->json_end);
-	return (req->json_end-req->json_start + 1);
-
-}
-
-static int32 re_alloc_buff(struct http_request *req)
+static int32 re_alloc_buff(struct http_request *req, int32 size)
 {
-	int8 *orig = req->buff;
+	int8 *buff = NULL;
 
 	if (NULL != req->sec_websocket_key)
 		req->sec_websocket_key_offset = (int32)(req->sec_websocket_key - req->buff);
@@ -583,18 +588,22 @@ static int32 re_alloc_buff(struct http_request *req)
 		req->content_type_offset = (int32)(req->content_type - req->buff);
 	if (NULL != req->host)
 		req->host_offset = (int32)(req->host - req->buff);
+	if (NULL != req->if_none_match)
+		req->if_none_match_offset = (int32)(req->if_none_match - req->buff);
 	if (NULL != req->path)
 		req->path_offset = (int32)(req->path - req->buff);
 	if (NULL != req->query)
 		req->query_offset = (int32)(req->query - req->buff);
 
-	req->buff_size = req->content_length + MAX_HEADER_LEN + 1;
-	req->buff = (int8 *)realloc(req->buff, req->content_length + MAX_HEADER_LEN + 1);
-	if (NULL == req->buff)
+	buff = (int8 *)realloc(req->buff, size);
+	if (NULL == buff) {
+		HTTPD_ERR("realloc buffer size from %d to %d fail\n", req->buff_size, size);
 		return -1;
+	}
 
-	if (orig != req->buff)
-		HTTPD_DEBUG("\nrealloc buffer size from %d to %ld\n", BUFFSIZ, req->content_length + MAX_HEADER_LEN);
+	HTTPD_DEBUG("\nrealloc buffer size from %d to %d\n", req->buff_size, size);
+	req->buff = buff;
+	req->buff_size = size;
 
 	if (NULL != req->sec_websocket_key)
 		req->sec_websocket_key = req->buff + req->sec_websocket_key_offset;
@@ -604,10 +613,11 @@ static int32 re_alloc_buff(struct http_request *req)
 		req->content_type = req->buff + req->content_type_offset;
 	if (NULL != req->host)
 		req->host = req->buff + req->host_offset;
+	if (NULL != req->if_none_match)
+		req->if_none_match = req->buff + req->if_none_match_offset;
 	if (NULL != req->path)
 		req->path = req->buff + req->path_offset;
 	if (NULL != req->query)
 		req->query = req->buff + req->query_offset;
 	return 0;
 }
-
@@ -34,12 +34,17 @@
 #include <errno.h>
 #include <ctype.h>
 #include <time.h>
+#include <sys/uio.h>
 
 #define HTTPD_WORK_DIR		"/var/rmm/web"
 #define HTTPD_SERVER_NAME	"ChinaRack RESTful HTTP Server"
 #define HTTPD_PROTOCOL		"HTTP/1.1"
 #define HTTPD_RFC1123FMT	"%a, %d %b %Y %H:%M:%S GMT"
 #define HTTPD_TIMO			1	/* snd & rcv timeout in seconds, 1s */
+#define HTTPD_KEEPALIVE_TIMO	5	/* idle keep-alive connection timeout, 5s */
+#define HTTPD_WORKERS		8	/* threads serving the connections */
+#define HTTPD_MAX_CONNS		256	/* open client connections */
+#define HTTPD_BUFF_POOL		64	/* free request buffers kept for reuse */
 
 
 #include "librmmlog/rmmlog.h"
@@ -59,6 +64,7 @@ typedef union {
 
 #define MAX_HEADER_LEN	1024
 #define BUFFSIZ			8192
+#define HTTPD_MAX_BODY	(16 << 20)	/* largest Content-Length accepted */
 
 enum {
 	M_GET = 1,
@@ -70,12 +76,20 @@ enum {
 	M_UNKNOWN
 };
 
+enum {
+	HTTP_PARSE_ERROR = -1,
+	HTTP_PARSE_AGAIN,	/* request is not complete in the buffer yet */
+	HTTP_PARSE_DONE
+};
+
 struct http_request {
 	int32 fd;
 
 	int32 hd_sz;  /*http header size*/
 	int32 sz;		/* how many we read */
 	int32 pos;	/* how many we consume */
+	int32 keep_alive;	/* connection is kept open after the reply */
+	int32 is_http11;
 
 	pthread_t tid_rest_req;
 	int32 method;
@@ -96,12 +110,12 @@ struct http_request {
 	int32 content_type_offset;
 	int8 *host;
 	int32 host_offset;
+	int8 *if_none_match;
+	int32 if_none_match_offset;
 
 	usockaddr from;
 
 	int8 *buff;
-	uint32 json_start;
-	uint32 json_end;
 	int32 buff_size;
 };
 
@@ -109,12 +123,19 @@ extern int32 hexit(int8 c);
 
 extern int32 http_read(int32 fd, int8 *buff, int32 len);
 extern int32 http_write(int32 fd, const int8 *data, int32 len);
+extern int32 http_writev(int32 fd, struct iovec *iov, int32 cnt);
 
-extern void send_file(int32 sockfd, const int8 *name);
-extern void send_error(int32 fd, int32 status, const int8 *title, const int8 *extra_header, const int8 *text);
+extern void send_file(struct http_request *req, const int8 *name);
+extern void send_error(struct http_request *req, int32 status, const int8 *title, const int8 *extra_header, const int8 *text);
 extern void *rest_req_thread(void *args);
 extern void build_rack_urls(void);
 
-extern void *http_process(void *args);
+extern int32 http_parse_request(struct http_request *req);
+extern void http_next_request(struct http_request *req);
+extern void http_process(struct http_request *req);
+
+extern int32 http_server_run(int32 listen_fd);
+extern int8 *http_buff_get(void);
+extern void http_buff_put(int8 *buff, int32 size);
 
 #endif
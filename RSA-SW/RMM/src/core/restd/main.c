@@ -23,6 +23,9 @@
 
 #include "http.h"
 #include "rest.h"
+#include "cache.h"
+#include "memdb_event.h"
+#include "websocket.h"
 #include "handler/handler.h"
 #include "libjsonrpcapi/libjsonrpcapi.h"
 #include "libjsonrpcapi/assetd_socket.h"
@@ -72,7 +75,7 @@ static int32 open_listen_socket(uint16 port)
 	}
 	setsockopt(fd, SOL_SOCKET, SO_LINGER, &linger_opt, sizeof(linger_opt));
 
-	if (listen(fd, 1) < 0) {
+	if (listen(fd, SOMAXCONN) < 0) {
 		HTTPD_ERR("Fail at socket listen: %s\n", strerror(errno));
 		goto fail;
 	}
@@ -110,15 +113,9 @@ static void *ipmi_cb_thread(void *unused)
 
 static int32 main_loop()
 {
-	int32 		rc = 0;
-	int32 		conn_fd = -1;
 	int32 		listen_fd = -1;
-	fd_set		rfds;
-	socklen_t	addrlen = 0;
-	usockaddr	usa;
 	pthread_t	tid_ipmi_cb;
 	struct sigaction	sa;
-	struct http_request *request = NULL;
 	int32 port  = 0;
 
 	/* ingore sigpipe */
@@ -127,6 +124,13 @@ static int32 main_loop()
 	
 	rest_register_handlers();
 
+	/* memdb events drop the cached replies and go to the websocket clients */
+	if (memdb_event_init() != 0 || rest_cache_init() != 0)
+		HTTPD_ERR("Failed to listen to memdb events, replies are not cached!\n");
+
+	if (ws_hub_init() != 0)
+		HTTPD_ERR("Failed to start the websocket hub!\n");
+
 	port = rmm_cfg_get_port(RESTD_PORT);
 	listen_fd = open_listen_socket(port);
 	if (listen_fd == -1) {
@@ -143,33 +147,11 @@ static int32 main_loop()
 		return -1;
 	}
 
-	for (;;) {
-			FD_ZERO(&rfds);
-			FD_SET(listen_fd, &rfds);
-			rc = select(listen_fd + 1, &rfds, NULL, NULL, NULL);
-			if (rc <= 0)
-				continue;
-	
-			addrlen = sizeof(usa);
-			conn_fd = accept(listen_fd, &usa.sa, &addrlen);
-			if (conn_fd < 0)
-				continue;
-			HTTPD_INFO("restd accepted a new connection: fd = %d\n", conn_fd);
-	
-			request = malloc(sizeof(struct http_request));
-			if (NULL == request) {
-				HTTPD_ERR("Malloc error: %s\n", strerror(errno));
-				return -1;
-			}
-			memset(request, 0, sizeof(struct http_request));
-			request->fd = conn_fd;
-			request->from = usa;
-	
-			if (pthread_create(&request->tid_rest_req, NULL, http_process, (void *)request) != 0) {
-				HTTPD_ERR("Failed to create rest_req_thread!\n");
-				return -1;
-			}
-		}
+	if (http_server_run(listen_fd) != 0) {
+		close(listen_fd);
+		HTTPD_ERR("HTTP server exit!\n");
+		return -1;
+	}
 
 	return 0;
 }
@@ -0,0 +1,174 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <sys/prctl.h>
+#include <sys/select.h>
+#include <pthread.h>
+
+#include "http.h"
+#include "memdb_event.h"
+
+struct event_listener {
+	memdb_event_fn fn;
+	void *arg;
+};
+
+/* held while the listeners run, so none runs once it is unlistened */
+static pthread_mutex_t listen_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct event_listener listeners[MEMDB_EVENT_LISTENERS];
+
+/* nodes whose attribute events are subscribed, sorted by id */
+static pthread_mutex_t watch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static memdb_integer *watched;
+static int32 num_watched;
+static int32 max_watched;
+
+
+static void dispatch_event(struct event_info *evt, void *unused)
+{
+	int32 i;
+
+	pthread_mutex_lock(&listen_mutex);
+	for (i = 0; i < MEMDB_EVENT_LISTENERS; i++) {
+		if (listeners[i].fn != NULL)
+			listeners[i].fn(evt, listeners[i].arg);
+	}
+	pthread_mutex_unlock(&listen_mutex);
+}
+
+static void *memdb_event_thread(void *unused)
+{
+	int32 max_fd;
+	fd_set rfds;
+
+	prctl(PR_SET_NAME, "memdb_event_thread");
+	for (;;) {
+		max_fd = -1;
+		FD_ZERO(&rfds);
+		libdb_event_selectfds(&rfds, &max_fd);
+		if (select(max_fd + 1, &rfds, NULL, NULL, NULL) <= 0)
+			continue;
+
+		libdb_event_processfds(&rfds);
+	}
+
+	return NULL;
+}
+
+int32 memdb_event_init(void)
+{
+	pthread_t tid;
+
+	if (libdb_init_subscription(NOTIFY_BY_SELECT, dispatch_event, NULL) < 0) {
+		HTTPD_ERR("Failed to init memdb subscription!\n");
+		return -1;
+	}
+
+	if (libdb_subscribe_node_create(DB_RMM, LOCK_ID_NULL) < 0 ||
+		libdb_subscribe_node_delete(DB_RMM, LOCK_ID_NULL) < 0) {
+		HTTPD_ERR("Failed to subscribe memdb node events!\n");
+		return -1;
+	}
+
+	if (pthread_create(&tid, NULL, memdb_event_thread, NULL) != 0) {
+		HTTPD_ERR("Failed to create memdb event thread!\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+int32 memdb_event_listen(memdb_event_fn fn, void *arg)
+{
+	int32 i;
+
+	pthread_mutex_lock(&listen_mutex);
+	for (i = 0; i < MEMDB_EVENT_LISTENERS; i++) {
+		if (listeners[i].fn == NULL) {
+			listeners[i].fn = fn;
+			listeners[i].arg = arg;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&listen_mutex);
+
+	if (i == MEMDB_EVENT_LISTENERS) {
+		HTTPD_ERR("Too many memdb event listeners!\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+void memdb_event_unlisten(memdb_event_fn fn, void *arg)
+{
+	int32 i;
+
+	pthread_mutex_lock(&listen_mutex);
+	for (i = 0; i < MEMDB_EVENT_LISTENERS; i++) {
+		if (listeners[i].fn == fn && listeners[i].arg == arg) {
+			listeners[i].fn = NULL;
+			listeners[i].arg = NULL;
+		}
+	}
+	pthread_mutex_unlock(&listen_mutex);
+}
+
+int32 memdb_event_watch_node(memdb_integer node_id)
+{
+	memdb_integer *ids;
+	int32 lo = 0, hi, mid;
+	int32 size;
+	int32 rc = -1;
+
+	pthread_mutex_lock(&watch_mutex);
+
+	hi = num_watched;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (watched[mid] == node_id) {
+			rc = 0;
+			goto out;
+		}
+		if (watched[mid] < node_id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (num_watched == max_watched) {
+		size = max_watched ? max_watched * 2 : 64;
+		ids = realloc(watched, size * sizeof(*ids));
+		if (ids == NULL)
+			goto out;
+		watched = ids;
+		max_watched = size;
+	}
+
+	/* memdbd keeps the subscription for the node id once it is deleted */
+	if (libdb_subscribe_attr_by_node(DB_RMM, node_id, LOCK_ID_NULL) < 0) {
+		HTTPD_ERR("Failed to subscribe attributes of node %lld\n", node_id);
+		goto out;
+	}
+
+	memmove(&watched[lo + 1], &watched[lo], (num_watched - lo) * sizeof(*watched));
+	watched[lo] = node_id;
+	num_watched++;
+	rc = 1;
+
+out:
+	pthread_mutex_unlock(&watch_mutex);
+	return rc;
+}
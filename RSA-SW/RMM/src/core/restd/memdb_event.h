@@ -0,0 +1,43 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __MEMDB_EVENT_H__
+#define __MEMDB_EVENT_H__
+
+#include "libmemdb/memdb.h"
+#include "libutils/types.h"
+
+/*
+ * The memdb events of restd are received by one thread, which owns the
+ * subscription socket of libdb and passes every event to the listeners.
+ * Node create and delete events of all types are subscribed once, and
+ * the attribute events of a node the first time it is watched, so that
+ * memdbd sends every event to restd once whoever is interested in it.
+ */
+#define MEMDB_EVENT_LISTENERS	4
+
+typedef void (*memdb_event_fn)(struct event_info *evt, void *arg);
+
+extern int32 memdb_event_init(void);
+extern int32 memdb_event_listen(memdb_event_fn fn, void *arg);
+extern void memdb_event_unlisten(memdb_event_fn fn, void *arg);
+
+/**
+ * @brief: Subscribe the attribute events of 'node_id' if it is not yet,
+ *         return 1 if it is subscribed now, 0 if it was, -1 on failure.
+ */
+extern int32 memdb_event_watch_node(memdb_integer node_id);
+
+#endif
@@ -14,6 +14,7 @@
 
 
 #include "rest.h"
+#include "cache.h"
 #include "libjson/json.h"
 #include "handler/handler.h"
 #include "librmmcfg/rmm_cfg.h"
@@ -28,10 +29,19 @@ static struct rest_uri_node root_uri_node = {
 	.list    = LIST_HEAD_INIT(root_uri_node.list),
 	.subnode = LIST_HEAD_INIT(root_uri_node.subnode),
 
-	.isvar   = 0,
+	.isvar   = REST_VAR_NONE,
 	.rest_handler  = NULL,
 };
 
+/* FNV-1a over the case folded name of a path segment */
+#define REST_HASH_INIT		2166136261U
+#define REST_HASH_PRIME		16777619U
+#define REST_FOLD(c)			((uint8)((c) - 'A') < 26 ? (uint8)(c) | 0x20 : (uint8)(c))
+#define REST_HASH_STEP(h, c)	(((h) ^ REST_FOLD(c)) * REST_HASH_PRIME)
+
+/* bit of a name length in the len_mask of a node */
+#define REST_LEN_BIT(len)		(1U << ((len) < 31 ? (len) : 31))
+
 static const struct http_response_status http_resp[] = {
 	{HTTP_SUCCESS, "Success"},
 	{HTTP_CREATED, "Created"},
@@ -48,9 +58,12 @@ static void compile_rest_uri(int32 num, int8 *ids[], const struct rest_handler *
 static int32 split_path(int8 *path, int8 *ids[]);
 static int32 parse_query_params(int8 *query, struct rest_param_key *params);
 static struct rest_uri_node *create_rest_node(int8 *name,
-											  struct list_head *parent);
-static void send_json_reply(int32 fd, int32 status, const int8 *title, const int8 *json, int32 jsonlen);
-static struct rest_handler *lookup_rest_handle(struct rest_uri_param *param);
+											  struct rest_uri_node *parent);
+static void send_json_reply(struct http_request *req, int32 status, const int8 *title, const int8 *json, int32 jsonlen);
+static void send_json_result(struct http_request *req, int32 status, const int8 *title, json_t *result);
+static struct rest_cache_entry *cache_json_result(const int8 *key, struct rest_cache_render *render,
+												  int32 status, const int8 *title, json_t *result);
+static void send_cached_reply(struct http_request *req, const struct rest_cache_entry *entry);
 static json_t *handle_rest_req(const struct rest_uri_param *param, const struct rest_handler *handler);
 
 
@@ -82,22 +95,33 @@ void register_handler(const int8 *url, const struct rest_handler *handler)
 	compile_rest_uri(num, ids, handler);
 }
 
-int8 *rest_path_value(const struct rest_uri_param *param, const int8 *name)
+const struct rest_param_key *rest_path_key(const struct rest_uri_param *param, const int8 *name)
 {
 	int32 i;
 
 	for (i = 0; i < param->num_path_keys; i++) {
 		if (strcasecmp(param->path_keys[i].name, name) == 0)
-			return param->path_keys[i].value;
+			return &param->path_keys[i];
 	}
 
-	return "";
+	return NULL;
+}
+
+int8 *rest_path_value(const struct rest_uri_param *param, const int8 *name)
+{
+	const struct rest_param_key *key = rest_path_key(param, name);
+
+	return key != NULL ? key->value : "";
 }
 
 int8 *rest_query_value(struct rest_uri_param *param, int8 *name)
 {
 	int32 i;
 
+	/* most handlers never look at the query, split it on first use */
+	if (param->num_query_keys < 0)
+		param->num_query_keys = parse_query_params(param->query, param->query_keys);
+
 	for (i = 0; i < param->num_query_keys; i++) {
 		if (strcasecmp(param->query_keys[i].name, name) == 0)
 			return param->query_keys[i].value;
@@ -116,56 +140,71 @@ void rest_process(struct http_request *req)
 	json_t *result = NULL;
 	struct rest_handler *handle;
 	struct rest_uri_param param;
+	struct rest_cache_entry *entry = NULL;
+	struct rest_cache_render render;
+	int8 key[REST_CACHE_KEY_LEN];
 	int32 i = 0;
 
 	param.httpmethod     = req->method;
 	param.content_length = req->content_length;
 	param.fd             = req->fd;
-	param.num_nodes      = split_path(req->path, param.nodes);
-	param.num_query_keys = parse_query_params(req->query, param.query_keys);
+	param.query          = req->query;
+	param.num_query_keys = -1;
 	param.status         = HTTP_ACCEPTED;
 	param.host           = req->host;
 
-	param.json_data_sz = req->json_end - req->json_start + 1;
-	param.json_data = req->buff + req->json_start;
-
-	handle = lookup_rest_handle(&param);
-	if (handle != NULL)
+	/* the body is terminated by http_process() */
+	param.json_data_sz = req->content_length;
+	param.json_data = req->buff + req->hd_sz;
+
+	/* the key is taken before the lookup splits the path */
+	if (req->method != M_GET ||
+		rest_cache_key(key, sizeof(key), req->host, req->path, req->query) != 0)
+		key[0] = '\0';
+
+	handle = rest_lookup_handler(&param, req->path);
+	if (handle != NULL && handle->cache && key[0] != '\0') {
+		entry = rest_cache_get(key);
+		if (entry == NULL) {
+			rest_cache_render_begin(&render);
+			result = handle_rest_req(&param, handle);
+			rest_cache_render_end(&render);
+		}
+	} else if (handle != NULL) {
 		result = handle_rest_req(&param, handle);
-	else
-		result = NULL;
-
-	if (result != NULL) {
-		int32 sz;
-		int8 body[100*1024];
+		if (req->method != M_GET)
+			rest_cache_flush();
+	}
 
-		sz = json_format(result, body, sizeof(body));
+	for (i = 0; i < sizeof(http_resp)/sizeof(struct http_response_status); i++) {
+		if (param.status == http_resp[i].status)
+			break;
+	}
 
-		for (i = 0; i < sizeof(http_resp)/sizeof(struct http_response_status); i++) {
-			if (param.status == http_resp[i].status) {
-				send_json_reply(req->fd, http_resp[i].status,
-								http_resp[i].title, body, sz);
+	/* GET handlers leave the status alone on success */
+	if (entry == NULL && result != NULL && key[0] != '\0' && handle->cache &&
+		param.status == HTTP_ACCEPTED && i < sizeof(http_resp)/sizeof(struct http_response_status))
+		entry = cache_json_result(key, &render, http_resp[i].status, http_resp[i].title, result);
+
+	if (entry != NULL) {
+		send_cached_reply(req, entry);
+		rest_cache_put(entry);
+		if (result != NULL)
+			json_free(result);
+	} else if (result != NULL) {
+		if (i < sizeof(http_resp)/sizeof(struct http_response_status))
+			send_json_result(req, http_resp[i].status, http_resp[i].title, result);
+		else
+			send_json_result(req, 200, "OK", result);
 
-				json_free(result);
-				return;
-			}
-		}
-
-		send_json_reply(req->fd, 200, "OK", body, sz);
+		json_free(result);
 	} else {
-		for (i = 0; i < sizeof(http_resp)/sizeof(struct http_response_status); i++) {
-			if (param.status == http_resp[i].status) {
-				send_json_reply(req->fd, http_resp[i].status,
-								http_resp[i].title, NULL, 0);
-				return;
-			}
-		}
-
-		send_json_reply(req->fd, 400, "Invalid REST request", "{}", 2);
+		if (i < sizeof(http_resp)/sizeof(struct http_response_status))
+			send_json_reply(req, http_resp[i].status,
+							http_resp[i].title, NULL, 0);
+		else
+			send_json_reply(req, 400, "Invalid REST request", "{}", 2);
 	}
-
-	if (NULL != result)
-		json_free(result);
 }
 
 
@@ -200,21 +239,89 @@ static int32 split_path(int8 *path, int8 *ids[])
 
 static int8 *decode_node(int8 *node, int32 *isvar)
 {
-	*isvar = 0;
+	int8 *tmp;
 
-	if (*node == '{') {
-		int8 *tmp;
+	*isvar = REST_VAR_NONE;
 
-		*isvar = 1;
+	if (*node == '{') {
+		*isvar = REST_VAR_ANY;
 
 		tmp = strchr(++node, '}');
 		if (tmp != NULL)
 			*tmp = '\0';
+
+		/* {name:type} */
+		tmp = strchr(node, ':');
+		if (tmp != NULL) {
+			*tmp++ = '\0';
+			if (strcasecmp(tmp, "id") == 0)
+				*isvar = REST_VAR_ID;
+			else if (strcasecmp(tmp, "uuid") == 0)
+				*isvar = REST_VAR_UUID;
+			else {
+				HTTPD_ERR("unknown REST URI variable type %s\n", tmp);
+				FATAL("Unknown REST URI variable type!\n");
+			}
+		}
 	}
 
 	return node;
 }
 
+static uint32 rest_node_hash(const int8 *name, int32 len)
+{
+	uint32 hash = REST_HASH_INIT;
+	int32 i;
+
+	for (i = 0; i < len; i++)
+		hash = REST_HASH_STEP(hash, name[i]);
+
+	return hash;
+}
+
+/**
+ * @brief: Rebuild the lookup tables of a node after a subnode is added,
+ *         fixed subnodes go to an open addressing table at most half full.
+ */
+static void compile_rest_node(struct rest_uri_node *node)
+{
+	struct rest_uri_node *n;
+	uint32 size = 4;
+	int32 num = 0;
+	uint32 i;
+
+	list_for_each_entry(n, &node->subnode, list) {
+		if (n->isvar == REST_VAR_NONE)
+			num++;
+	}
+	while (size < num * 2)
+		size <<= 1;
+
+	free(node->table);
+	free(node->vars);
+	node->table = calloc(size, sizeof(*node->table));
+	node->vars = calloc(MAX_URI_NODES, sizeof(*node->vars));
+	if (node->table == NULL || node->vars == NULL)
+		FATAL("No memory for restd REST, exiting ...\n");
+
+	node->table_mask = size - 1;
+	node->len_mask = 0;
+	node->num_vars = 0;
+	list_for_each_entry(n, &node->subnode, list) {
+		if (n->isvar != REST_VAR_NONE) {
+			if (node->num_vars >= MAX_URI_NODES)
+				FATAL("Too many REST URI variables!\n");
+			node->vars[node->num_vars++] = n;
+			continue;
+		}
+
+		for (i = n->hash & node->table_mask; node->table[i] != NULL; i = (i + 1) & node->table_mask)
+			;
+		node->table[i] = n;
+		node->len_mask |= REST_LEN_BIT(n->namelen);
+	}
+}
+
 static struct rest_uri_node *alloc_rest_uri_node(const int8 *id, int32 isvar)
 {
 	int32 idlen;
@@ -230,7 +337,14 @@ static struct rest_uri_node *alloc_rest_uri_node(const int8 *id, int32 isvar)
 	INIT_LIST_HEAD(&node->subnode);
 
 	node->isvar  = isvar;
+	node->hash   = rest_node_hash(id, idlen);
+	node->namelen = idlen;
 	node->rest_handler = NULL;
+	node->table = NULL;
+	node->table_mask = 0;
+	node->len_mask = 0;
+	node->vars = NULL;
+	node->num_vars = 0;
 
 	memcpy(node->name, id, idlen);
 	node->name[idlen] = '\0';
@@ -239,20 +353,25 @@ static struct rest_uri_node *alloc_rest_uri_node(const int8 *id, int32 isvar)
 }
 
 static struct rest_uri_node *create_rest_node(int8 *name,
-											  struct list_head *parent)
+											  struct rest_uri_node *parent)
 {
 	int32 isvar;
 	int8 *id;
 	struct rest_uri_node *n;
 
 	id = decode_node(name, &isvar);
-	list_for_each_entry(n, parent, list) {
-		if (strcasecmp(n->name, id) == 0)
+	list_for_each_entry(n, &parent->subnode, list) {
+		if ((n->isvar == REST_VAR_NONE) == (isvar == REST_VAR_NONE) &&
+			strcasecmp(n->name, id) == 0) {
+			if (n->isvar != isvar)
+				FATAL("REST URI variable with different types!\n");
 			return n;
+		}
 	}
 
 	n = alloc_rest_uri_node(id, isvar);
-	list_add_tail(&n->list, parent);
+	list_add_tail(&n->list, &parent->subnode);
+	compile_rest_node(parent);
 
 	return n;
 }
@@ -265,7 +384,7 @@ static void compile_rest_uri(int32 num, int8 *ids[], const struct rest_handler *
 	leaf   = NULL;
 	parent = &root_uri_node;
 	for (i = 0; i < num; i++) {
-		leaf = create_rest_node(ids[i], &parent->subnode);
+		leaf = create_rest_node(ids[i], parent);
 		parent = leaf;
 	}
 
@@ -321,67 +440,428 @@ static int32 parse_query_params(int8 *query, struct rest_param_key *params)
 	return i;
 }
 
-static void send_json_reply(int32 fd, int32 status, const int8 *title, const int8 *json, int32 jsonlen)
+/**
+ * @brief: Format the reply header, without Content-Length the body is
+ *         sent chunked, or up to the connection close for HTTP/1.0.
+ */
+static int32 json_reply_header(struct http_request *req, int8 *header, int32 sz,
+							   int32 status, const int8 *title, int64 content_length,
+							   const int8 *etag)
 {
 	int32 len;
-	int8 header[1024];
+	int8 length[64];
+	int8 tag[64];
+
+	if (content_length >= 0)
+		snprintf(length, sizeof(length), "Content-Length: %lld", content_length);
+	else if (req->is_http11)
+		snprintf(length, sizeof(length), "Transfer-Encoding: chunked");
+	else {
+		length[0] = '\0';
+		req->keep_alive = 0;
+	}
+
+	tag[0] = '\0';
+	if (etag != NULL)
+		snprintf(tag, sizeof(tag), "ETag: %s\r\n", etag);
 
-	len = snprintf(header, sizeof(header),
+	len = snprintf(header, sz,
 			"%s %d %s\r\n"
 			"Server: %s\r\n"
 			"Access-Control-Allow-Origin: *\r\n"
 			"Content-Type: application/json\r\n"
+			"%s%s%s"
 			"Access-Control-Allow-Methods: GET,PUT,POST,DELETE\r\n"
 			"Access-Control-Allow-Headers: Content-Type\r\n"
 			"Proxy-Connection: Keep-Alive\r\n"
-			"Connection: close\r\n"
+			"Connection: %s\r\n"
 			"\r\n",
-			HTTPD_PROTOCOL, status, title, HTTPD_SERVER_NAME);
+			HTTPD_PROTOCOL, status, title, HTTPD_SERVER_NAME,
+			length, length[0] != '\0' ? "\r\n" : "", tag,
+			req->keep_alive ? "keep-alive" : "close");
+
+	return len < sz ? len : sz - 1;
+}
+
+static void send_json_reply(struct http_request *req, int32 status, const int8 *title, const int8 *json, int32 jsonlen)
+{
+	struct iovec iov[2];
+	int8 header[1024];
+
+	if ((json == NULL) || (jsonlen <= 0)) {
+		json = "{}";
+		jsonlen = 2;
+	}
+
+	iov[0].iov_base = header;
+	iov[0].iov_len = json_reply_header(req, header, sizeof(header), status, title, jsonlen, NULL);
+	iov[1].iov_base = (int8 *)json;
+	iov[1].iov_len = jsonlen;
+
+	http_writev(req->fd, iov, 2);
+}
+
+/*
+ * The JSON result is formatted into buffers from the request buffer pool.
+ * Up to REST_REPLY_BUFFS of them are held and sent in one writev() along
+ * with the header. A larger result is sent chunked, REST_REPLY_BUFFS
+ * buffers at a time, while it is formatted.
+ */
+#define REST_REPLY_BUFFS	16
+
+struct json_reply {
+	struct http_request *req;
+	int32 status;
+	const int8 *title;
 
-	http_write(fd, header, len);
+	int8 *cur;			/* buffer being formatted into */
+	int32 num;			/* full buffers held in iov */
+	int32 chunked;		/* the header and first chunks are sent */
+	struct iovec iov[REST_REPLY_BUFFS + 1];
+};
 
-	if ((json != NULL) && (jsonlen > 0))
-		http_write(fd, json, jsonlen);
-	else
-		http_write(fd, "{}", 2);
+static void json_reply_put(struct json_reply *jr)
+{
+	int32 i;
+
+	for (i = 0; i < jr->num; i++)
+		http_buff_put(jr->iov[i].iov_base, BUFFSIZ);
+	jr->num = 0;
 }
 
-static inline struct rest_uri_node *find_rest_node(const int8 *name, struct list_head *parent)
+/**
+ * @brief: Send the held buffers and 'data' as chunks, the header is sent
+ *         with the first ones. 'last' ends the chunked body.
+ */
+static int32 json_reply_chunks(struct json_reply *jr, int8 *data, int32 len, int32 last)
 {
-	struct rest_uri_node *n, *var = NULL;
+	struct http_request *req = jr->req;
+	struct iovec iov[(REST_REPLY_BUFFS + 1) * 3 + 2];
+	int8 size[REST_REPLY_BUFFS + 1][16];
+	int8 header[1024];
+	int32 cnt = 0;
+	int32 rc, i;
 
-	list_for_each_entry(n, parent, list) {
-		if (strcasecmp(n->name, name) == 0)
-			return n;
-		else if (n->isvar == 1)
-			var = n;
+	if (!jr->chunked) {
+		iov[cnt].iov_base = header;
+		iov[cnt++].iov_len = json_reply_header(req, header, sizeof(header),
+											   jr->status, jr->title, -1, NULL);
+	}
+
+	jr->iov[jr->num].iov_base = data;
+	jr->iov[jr->num].iov_len = len;
+	for (i = 0; i <= jr->num; i++) {
+		if (jr->iov[i].iov_len == 0)
+			continue;
+
+		if (req->is_http11) {
+			iov[cnt].iov_base = size[i];
+			iov[cnt++].iov_len = snprintf(size[i], sizeof(size[i]), "%zx\r\n", jr->iov[i].iov_len);
+		}
+		iov[cnt++] = jr->iov[i];
+		if (req->is_http11) {
+			iov[cnt].iov_base = "\r\n";
+			iov[cnt++].iov_len = 2;
+		}
+	}
+	if (last && req->is_http11) {
+		iov[cnt].iov_base = "0\r\n\r\n";
+		iov[cnt++].iov_len = 5;
+	}
+
+	rc = http_writev(req->fd, iov, cnt);
+
+	json_reply_put(jr);
+	jr->chunked = 1;
+
+	return rc < 0 ? -1 : 0;
+}
+
+static char *json_reply_flush(void *arg, char *data, int len, int *sz)
+{
+	struct json_reply *jr = (struct json_reply *)arg;
+
+	*sz = BUFFSIZ;
+
+	if (jr->num < REST_REPLY_BUFFS) {
+		jr->iov[jr->num].iov_base = data;
+		jr->iov[jr->num].iov_len = len;
+		jr->num++;
+
+		jr->cur = http_buff_get();
+		return jr->cur;
 	}
 
-	return var;
+	/* send out what is held and go on in this buffer */
+	if (json_reply_chunks(jr, data, len, 0) != 0)
+		return NULL;
+
+	return data;
 }
 
-static struct rest_handler *lookup_rest_handle(struct rest_uri_param *param)
+/**
+ * @brief: Send the JSON result with Content-Length in one write if it fits
+ *         in the held buffers, chunked otherwise.
+ */
+static void send_json_result(struct http_request *req, int32 status, const int8 *title, json_t *result)
 {
+	struct json_reply jr;
+	struct iovec iov[REST_REPLY_BUFFS + 2];
+	int8 header[1024];
+	int64 total = 0;
+	int32 sz;
 	int32 i;
-	int32 num_keys = 0;
-	struct rest_uri_node *leaf, *parent;
 
-	leaf   = NULL;
-	parent = &root_uri_node;
-	for (i = 0; i < param->num_nodes; i++) {
-		if ((leaf = find_rest_node(param->nodes[i], &parent->subnode)) == NULL)
-			break;
+	memset(&jr, 0, sizeof(jr));
+	jr.req = req;
+	jr.status = status;
+	jr.title = title;
 
-		parent = leaf;
-		if (leaf->isvar) {
-			param->path_keys[num_keys].name = leaf->name;
-			param->path_keys[num_keys].value = param->nodes[i];
-			num_keys++;
+	jr.cur = http_buff_get();
+	if (jr.cur == NULL) {
+		HTTPD_ERR("json buffer malloc %d fail\n", BUFFSIZ);
+		send_json_reply(req, HTTP_APPLICATION_ERROR, "Application Error", NULL, 0);
+		return;
+	}
+
+	sz = json_format_stream(result, jr.cur, BUFFSIZ, json_reply_flush, &jr);
+	if (sz < 0) {
+		HTTPD_ERR("format json reply fail\n");
+		/* the client can only see a cut reply when part of it is out */
+		if (jr.chunked)
+			req->keep_alive = 0;
+		else
+			send_json_reply(req, status, title, NULL, 0);
+	} else if (jr.chunked) {
+		if (json_reply_chunks(&jr, jr.cur, sz, 1) != 0)
+			req->keep_alive = 0;
+	} else {
+		jr.iov[jr.num].iov_base = jr.cur;
+		jr.iov[jr.num].iov_len = sz;
+		for (i = 0; i <= jr.num; i++) {
+			iov[i + 1] = jr.iov[i];
+			total += jr.iov[i].iov_len;
+		}
+
+		iov[0].iov_base = header;
+		iov[0].iov_len = json_reply_header(req, header, sizeof(header), status, title, total, NULL);
+
+		http_writev(req->fd, iov, jr.num + 2);
+	}
+
+	json_reply_put(&jr);
+	http_buff_put(jr.cur, BUFFSIZ);
+}
+
+/*
+ * A result to cache is formatted in one buffer, doubled as it fills up.
+ */
+struct json_body {
+	int8 *buff;
+	int32 used;			/* bytes of the flushed parts */
+	int32 size;
+};
+
+static char *json_body_flush(void *arg, char *data, int len, int *sz)
+{
+	struct json_body *jb = (struct json_body *)arg;
+	int8 *buff;
+
+	jb->used += len;
+	buff = realloc(jb->buff, jb->size * 2);
+	if (buff == NULL)
+		return NULL;
+	jb->buff = buff;
+	jb->size *= 2;
+
+	*sz = jb->size - jb->used;
+	return jb->buff + jb->used;
+}
+
+static struct rest_cache_entry *cache_json_result(const int8 *key, struct rest_cache_render *render,
+												  int32 status, const int8 *title, json_t *result)
+{
+	struct json_body jb;
+	int32 sz;
+
+	jb.used = 0;
+	jb.size = BUFFSIZ;
+	jb.buff = malloc(jb.size);
+	if (jb.buff == NULL)
+		return NULL;
+
+	sz = json_format_stream(result, jb.buff, jb.size, json_body_flush, &jb);
+	if (sz < 0) {
+		free(jb.buff);
+		return NULL;
+	}
+
+	return rest_cache_add(key, render, jb.buff, jb.used + sz, status, title);
+}
+
+/**
+ * @brief: Send a cached reply, or 304 if the client holds the same one.
+ */
+static void send_cached_reply(struct http_request *req, const struct rest_cache_entry *entry)
+{
+	struct iovec iov[2];
+	int8 header[1024];
+	int32 len;
+
+	if (req->if_none_match != NULL &&
+		(strcmp(req->if_none_match, "*") == 0 || strstr(req->if_none_match, entry->etag) != NULL)) {
+		len = snprintf(header, sizeof(header),
+				"%s 304 Not Modified\r\n"
+				"Server: %s\r\n"
+				"ETag: %s\r\n"
+				"Access-Control-Allow-Origin: *\r\n"
+				"Connection: %s\r\n"
+				"\r\n",
+				HTTPD_PROTOCOL, HTTPD_SERVER_NAME, entry->etag,
+				req->keep_alive ? "keep-alive" : "close");
+		http_write(req->fd, header, len < sizeof(header) ? len : sizeof(header) - 1);
+		return;
+	}
+
+	iov[0].iov_base = header;
+	iov[0].iov_len = json_reply_header(req, header, sizeof(header), entry->status,
+									   entry->title, entry->body_len, entry->etag);
+	iov[1].iov_base = entry->body;
+	iov[1].iov_len = entry->body_len;
+
+	http_writev(req->fd, iov, 2);
+}
+
+/**
+ * @brief: Classify a path variable value the same way as is_str_uuid().
+ */
+static int32 rest_var_type(const int8 *value, int32 len)
+{
+	int32 i;
+
+	if (len > ID_STR_MAX_LEN)
+		return REST_VAR_UUID;
+
+	for (i = 0; i < len; i++) {
+		if ((uint8)(value[i] - '0') >= 10 && value[i] != '+' && value[i] != '-')
+			return REST_VAR_UUID;
+	}
+
+	return REST_VAR_ID;
+}
+
+static struct rest_uri_node *find_rest_node(const struct rest_uri_node *parent,
+											const int8 *name, int32 len, int32 *type)
+{
+	struct rest_uri_node *n;
+	uint32 hash;
+	uint32 i;
+	int32 j;
+
+	/* ids and UUIDs are usually longer than any fixed name beside them */
+	if (parent->len_mask & REST_LEN_BIT(len)) {
+		hash = rest_node_hash(name, len);
+		for (i = hash & parent->table_mask; (n = parent->table[i]) != NULL;
+			 i = (i + 1) & parent->table_mask) {
+			if (n->hash == hash && n->namelen == len &&
+				strncasecmp(n->name, name, len) == 0)
+				return n;
+		}
+	}
+
+	/* a fixed segment always wins over a variable */
+	if (len == 0 || parent->num_vars == 0)
+		return NULL;
+
+	*type = rest_var_type(name, len);
+	for (j = 0; j < parent->num_vars; j++) {
+		n = parent->vars[j];
+		if (n->isvar == REST_VAR_ANY || n->isvar == *type)
+			return n;
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief: Split 'path' in place and walk the compiled URI tree in the
+ *         same pass, filling the nodes and path keys of 'param'.
+ */
+struct rest_handler *rest_lookup_handler(struct rest_uri_param *param, int8 *path)
+{
+	struct rest_uri_node *node = &root_uri_node;
+	struct rest_param_key *key;
+	int8 *cp = path;
+	int8 *seg;
+	int32 type = REST_VAR_NONE;
+
+	param->num_nodes = 0;
+	param->num_path_keys = 0;
+
+	if (*cp != '/')
+		return NULL;
+
+	for (cp++; ; ) {
+		if (param->num_nodes >= MAX_URI_NODES)
+			return NULL;
+
+		seg = cp;
+		cp = strchrnul(cp, '/');
+		param->nodes[param->num_nodes++] = seg;
+
+		node = find_rest_node(node, seg, cp - seg, &type);
+		if (*cp == '/')
+			*cp++ = '\0';
+		if (node == NULL)
+			return NULL;
+
+		if (node->isvar != REST_VAR_NONE) {
+			key = &param->path_keys[param->num_path_keys++];
+			key->name = node->name;
+			key->value = seg;
+			key->type = type;
+			key->id = type == REST_VAR_ID ? str2int(seg) : 0;
 		}
+
+		if (*cp == '\0')	/* end of path */
+			break;
+	}
+
+	return node->rest_handler;
+}
+
+static void walk_rest_node(const struct rest_uri_node *node, int8 *url, int32 len,
+						   void (*fn)(const int8 *url, const struct rest_handler *handler, void *arg),
+						   void *arg)
+{
+	const struct rest_uri_node *n;
+	int32 sz;
+
+	if (node->rest_handler != NULL)
+		fn(url, node->rest_handler, arg);
+
+	list_for_each_entry(n, &node->subnode, list) {
+		if (n->isvar == REST_VAR_NONE)
+			sz = snprintf(url + len, MAX_URL - len, "/%s", n->name);
+		else
+			sz = snprintf(url + len, MAX_URL - len, "/{%s%s}", n->name,
+						  n->isvar == REST_VAR_ID ? ":id" :
+						  n->isvar == REST_VAR_UUID ? ":uuid" : "");
+		if (sz < MAX_URL - len)
+			walk_rest_node(n, url, len + sz, fn, arg);
+		url[len] = '\0';
 	}
-	param->num_path_keys = num_keys;
+}
+
+/**
+ * @brief: Call 'fn' for every registered handler with its URL, as it was
+ *         registered with the REST prefix.
+ */
+void rest_walk_handlers(void (*fn)(const int8 *url, const struct rest_handler *handler, void *arg), void *arg)
+{
+	int8 url[MAX_URL] = {0};
 
-	return leaf != NULL ? leaf->rest_handler : NULL;
+	walk_rest_node(&root_uri_node, url, 0, fn, arg);
 }
 
 static json_t *handle_rest_req(const struct rest_uri_param *param, const struct rest_handler *handler)
@@ -39,9 +39,23 @@ struct json_result {
 	json_t *json;
 };
 
+/*
+ * Path variables are registered as "{name}", which matches any segment,
+ * or typed as "{name:id}" and "{name:uuid}", which only match an index
+ * or a UUID. The value of a matched variable is classified the same way.
+ */
+enum {
+	REST_VAR_NONE = 0,	/* a fixed segment */
+	REST_VAR_ANY,
+	REST_VAR_ID,
+	REST_VAR_UUID,
+};
+
 struct rest_param_key {
 	int8 *name;
 	int8 *value;
+	int32 type;		/* REST_VAR_ID or REST_VAR_UUID, path keys only */
+	int32 id;		/* value as an index, for REST_VAR_ID */
 };
 
 struct rest_uri_param {
@@ -49,13 +63,14 @@ struct rest_uri_param {
 	int64 content_length;
 	int32 fd;
 	int32 num_path_keys;
-	int32 num_query_keys;
+	int32 num_query_keys;	/* -1 until the query is parsed */
 	int8 *json_data;
 	uint32 json_data_sz;
 	int32 num_nodes;
 	struct rest_param_key path_keys[MAX_KEYS_NUM];
 	struct rest_param_key query_keys[MAX_KEYS_NUM];
 	int8 *nodes[MAX_URI_NODES];
+	int8 *query;
 	int8 *host;
 	int32 status;
 };
@@ -65,6 +80,9 @@ struct rest_handler {
 	json_t* (*get)(struct rest_uri_param *req);
 	json_t* (*post)(struct rest_uri_param *req);
 	json_t* (*put)(struct rest_uri_param *req);
+
+	/* the GET reply only depends on memdb and may be cached, see cache.h */
+	int32 cache;
 };
 
 
@@ -72,8 +90,18 @@ struct rest_uri_node {
 	struct list_head list;
 	struct list_head subnode;
 
-	int32  isvar;
+	int32  isvar;		/* REST_VAR_* */
+	uint32 hash;		/* of the case folded name */
+	int32  namelen;
 	struct rest_handler *rest_handler;
+
+	/* subnodes compiled for lookup: fixed ones hashed, variables in order */
+	struct rest_uri_node **table;
+	uint32 table_mask;
+	uint32 len_mask;	/* bit n set for a fixed subnode name of n chars, 31 for longer */
+	struct rest_uri_node **vars;
+	int32  num_vars;
+
 	int8 name[0];
 };
 
@@ -85,6 +113,10 @@ extern void rest_process(struct http_request *req);
 
 extern int8 *rest_path_value(const struct rest_uri_param *param, const int8 *name);
 extern int8 *rest_query_value(struct rest_uri_param *param, int8 *name);
+extern const struct rest_param_key *rest_path_key(const struct rest_uri_param *param, const int8 *name);
+
+extern struct rest_handler *rest_lookup_handler(struct rest_uri_param *param, int8 *path);
+extern void rest_walk_handlers(void (*fn)(const int8 *url, const struct rest_handler *handler, void *arg), void *arg);
 
 
 #endif
@@ -0,0 +1,186 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "http.h"
+#include "rest.h"
+
+/*
+ * Microbenchmark of the restd URI dispatch. Every handler registered by
+ * rest_register_handlers() is looked up by a concrete path built from
+ * its URL, with an index and with a UUID for the path variables, and the
+ * average lookup time of each is reported.
+ *
+ *     routebench [-n loops]
+ */
+#define DEFAULT_LOOPS		200000
+#define MAX_ROUTES			256
+
+#define BENCH_ID			"1"
+#define BENCH_UUID			"8ce8d6b8-5b9a-11e5-9d70-feff819cdc9f"
+
+struct bench_route {
+	int8 url[MAX_URL];
+	int8 path[MAX_URL];
+	int32 len;
+	const struct rest_handler *handler;
+};
+
+static struct bench_route routes[MAX_ROUTES];
+static int32 num_routes;
+
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief: Build the path of 'url' with 'value' for the variables that
+ *         accept it, return -1 if one of them does not.
+ */
+static int32 build_path(const int8 *url, int8 *path, int32 sz, const int8 *value, int32 is_uuid)
+{
+	const int8 *cp = url;
+	const int8 *end;
+	int32 len = 0;
+	int32 n;
+
+	while (*cp != '\0') {
+		if (*cp != '{') {
+			if (len >= sz - 1)
+				return -1;
+			path[len++] = *cp++;
+			continue;
+		}
+
+		end = strchr(cp, '}');
+		if (end == NULL)
+			return -1;
+		if ((is_uuid && memmem(cp, end - cp, ":id", 3) != NULL) ||
+			(!is_uuid && memmem(cp, end - cp, ":uuid", 5) != NULL))
+			return -1;
+
+		n = snprintf(path + len, sz - len, "%s", value);
+		if (n >= sz - len)
+			return -1;
+		len += n;
+		cp = end + 1;
+	}
+	path[len] = '\0';
+
+	return len;
+}
+
+static void add_route(const int8 *url, const struct rest_handler *handler, const int8 *value, int32 is_uuid)
+{
+	struct bench_route *r;
+	int32 i;
+
+	if (num_routes >= MAX_ROUTES)
+		return;
+
+	r = &routes[num_routes];
+	r->len = build_path(url, r->path, sizeof(r->path), value, is_uuid);
+	if (r->len < 0)
+		return;
+
+	/* a URL without variables is only benchmarked once */
+	for (i = 0; i < num_routes; i++) {
+		if (strcmp(routes[i].path, r->path) == 0)
+			return;
+	}
+
+	snprintf(r->url, sizeof(r->url), "%s", url);
+	r->handler = handler;
+	num_routes++;
+}
+
+static void collect_route(const int8 *url, const struct rest_handler *handler, void *arg)
+{
+	add_route(url, handler, BENCH_ID, 0);
+	add_route(url, handler, BENCH_UUID, 1);
+}
+
+static const struct rest_handler *lookup(const struct bench_route *r, struct rest_uri_param *param)
+{
+	int8 path[MAX_URL];
+
+	/* the path is split in place, as it is in the request buffer */
+	memcpy(path, r->path, r->len + 1);
+	return rest_lookup_handler(param, path);
+}
+
+static void usage(int8 *name)
+{
+	printf("usage: %s [-n loops]\n", name);
+	exit(-1);
+}
+
+int32 main(int32 argc, int8 **argv)
+{
+	struct rest_uri_param param;
+	const struct rest_handler *volatile found;
+	double start, elapsed, total = 0;
+	int32 loops = DEFAULT_LOOPS;
+	int32 opt, i, j;
+
+	while ((opt = getopt(argc, argv, "n:")) != -1) {
+		switch (opt) {
+		case 'n':
+			loops = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (loops <= 0)
+		usage(argv[0]);
+
+	rest_register_handlers();
+	rest_walk_handlers(collect_route, NULL);
+
+	for (i = 0; i < num_routes; i++) {
+		if (lookup(&routes[i], &param) != routes[i].handler) {
+			printf("%s: %s is dispatched to another handler\n", routes[i].url, routes[i].path);
+			return -1;
+		}
+	}
+
+	printf("%d paths of the registered handlers, %d lookups each\n", num_routes, loops);
+	for (i = 0; i < num_routes; i++) {
+		start = now_sec();
+		for (j = 0; j < loops; j++)
+			found = lookup(&routes[i], &param);
+		elapsed = now_sec() - start;
+		total += elapsed;
+
+		printf("%8.1f ns  %s\n", elapsed / loops * 1e9, routes[i].path);
+	}
+	(void)found;
+
+	if (num_routes > 0)
+		printf("average %.1f ns per lookup\n", total / loops / num_routes * 1e9);
+
+	return 0;
+}
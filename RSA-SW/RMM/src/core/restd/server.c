@@ -0,0 +1,416 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define _GNU_SOURCE
+#include <sys/epoll.h>
+#include <sys/prctl.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+
+#include "http.h"
+#include "websocket.h"
+
+/*
+ * Client connections are served by a fixed pool of workers. The main
+ * thread waits on the listen socket and every idle connection with epoll,
+ * and queues a readable connection to the workers. A connection is armed
+ * with EPOLLONESHOT, so only one worker owns it at a time. The worker
+ * serves every complete request in the connection buffer (pipelining),
+ * then closes the connection or arms it again for the next request
+ * (keep-alive). A websocket leaves the pool once upgraded, the socket is
+ * handed over to the websocket hub.
+ */
+
+#define HTTPD_MAX_EVENTS	64
+
+enum {
+	CONN_FREE,
+	CONN_IDLE,		/* waiting in epoll for the next request */
+	CONN_BUSY		/* queued to or served by a worker */
+};
+
+struct http_conn {
+	struct http_request req;
+	int32 state;
+	time_t last_active;
+	struct http_conn *next_free;
+};
+
+static int32 epoll_fd = -1;
+
+static struct http_conn conns[HTTPD_MAX_CONNS];
+static struct http_conn *free_conns;
+static pthread_mutex_t conn_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* a connection is queued at most once, while it is CONN_BUSY */
+static struct http_conn *work_queue[HTTPD_MAX_CONNS];
+static int32 work_head;
+static int32 work_num;
+static pthread_mutex_t work_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+
+static int8 *buff_pool[HTTPD_BUFF_POOL];
+static int32 buff_num;
+static pthread_mutex_t buff_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+static time_t now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec;
+}
+
+int8 *http_buff_get(void)
+{
+	int8 *buff = NULL;
+
+	pthread_mutex_lock(&buff_mutex);
+	if (buff_num > 0)
+		buff = buff_pool[--buff_num];
+	pthread_mutex_unlock(&buff_mutex);
+
+	if (buff == NULL)
+		buff = malloc(BUFFSIZ);
+
+	return buff;
+}
+
+/**
+ * @brief: Keep a buffer of the default size for the next request, buffers
+ *         grown for a large body are freed.
+ */
+void http_buff_put(int8 *buff, int32 size)
+{
+	if (buff == NULL)
+		return;
+
+	pthread_mutex_lock(&buff_mutex);
+	if (size == BUFFSIZ && buff_num < HTTPD_BUFF_POOL) {
+		buff_pool[buff_num++] = buff;
+		buff = NULL;
+	}
+	pthread_mutex_unlock(&buff_mutex);
+
+	free(buff);
+}
+
+static struct http_conn *conn_alloc(int32 fd, usockaddr *from)
+{
+	struct http_conn *conn;
+
+	pthread_mutex_lock(&conn_mutex);
+	conn = free_conns;
+	if (conn != NULL) {
+		free_conns = conn->next_free;
+		memset(conn, 0, sizeof(*conn));
+		conn->req.fd = fd;
+		conn->req.from = *from;
+		conn->state = CONN_BUSY;
+	}
+	pthread_mutex_unlock(&conn_mutex);
+
+	return conn;
+}
+
+/* called with conn_mutex held */
+static void conn_release(struct http_conn *conn)
+{
+	if (conn->req.fd >= 0)
+		close(conn->req.fd);
+	http_buff_put(conn->req.buff, conn->req.buff_size);
+
+	conn->req.fd = -1;
+	conn->req.buff = NULL;
+	conn->state = CONN_FREE;
+	conn->next_free = free_conns;
+	free_conns = conn;
+}
+
+static void conn_close(struct http_conn *conn)
+{
+	pthread_mutex_lock(&conn_mutex);
+	conn_release(conn);
+	pthread_mutex_unlock(&conn_mutex);
+}
+
+/**
+ * @brief: Wait in epoll for the next request on this connection. The state
+ *         and the epoll registration change together, so the main thread
+ *         never expires a connection a worker is arming.
+ */
+static void conn_idle(struct http_conn *conn, int32 op)
+{
+	struct epoll_event ev;
+	struct http_request *req = &conn->req;
+
+	/* an idle connection keeps its buffer only for a partly read request */
+	if (req->sz == 0) {
+		http_buff_put(req->buff, req->buff_size);
+		req->buff = NULL;
+		req->buff_size = 0;
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+	ev.data.ptr = conn;
+
+	pthread_mutex_lock(&conn_mutex);
+	conn->state = CONN_IDLE;
+	conn->last_active = now_sec();
+	if (epoll_ctl(epoll_fd, op, req->fd, &ev) < 0) {
+		HTTPD_ERR("epoll_ctl fd %d fail: %s\n", req->fd, strerror(errno));
+		conn_release(conn);
+	}
+	pthread_mutex_unlock(&conn_mutex);
+}
+
+static void conn_expire(time_t now)
+{
+	int32 i;
+
+	pthread_mutex_lock(&conn_mutex);
+	for (i = 0; i < HTTPD_MAX_CONNS; i++) {
+		if (conns[i].state == CONN_IDLE &&
+			now - conns[i].last_active >= HTTPD_KEEPALIVE_TIMO)
+			conn_release(&conns[i]);
+	}
+	pthread_mutex_unlock(&conn_mutex);
+}
+
+static void conn_detach(struct http_conn *conn)
+{
+	pthread_mutex_lock(&conn_mutex);
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->req.fd, NULL);
+	pthread_mutex_unlock(&conn_mutex);
+
+	conn->req.keep_alive = 0;
+	if (ws_attach(&conn->req) == 0)
+		conn->req.fd = -1;	/* owned by the websocket hub now */
+
+	conn_close(conn);
+}
+
+/**
+ * @brief: Read what the client has sent and serve every complete request,
+ *         the connection is closed or waits in epoll again when done.
+ */
+static void conn_serve(struct http_conn *conn)
+{
+	struct http_request *req = &conn->req;
+	int32 room;
+	int32 rc, r;
+
+	if (req->buff == NULL) {
+		req->buff = http_buff_get();
+		req->buff_size = BUFFSIZ;
+		if (req->buff == NULL) {
+			HTTPD_ERR("request buffer malloc %d fail\n", BUFFSIZ);
+			conn_close(conn);
+			return;
+		}
+	}
+
+	for (;;) {
+		/* leave room for the '\0' after the data */
+		room = req->buff_size - req->sz - 1;
+		if (room <= 0) {
+			conn_close(conn);
+			return;
+		}
+
+		r = recv(req->fd, req->buff + req->sz, room, MSG_DONTWAIT);
+		if (r == 0) {
+			conn_close(conn);
+			return;
+		} else if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				conn_close(conn);
+				return;
+			}
+		} else {
+			req->sz += r;
+		}
+
+		while ((rc = http_parse_request(req)) == HTTP_PARSE_DONE) {
+			if (req->is_websocket) {
+				conn_detach(conn);
+				return;
+			}
+
+			http_process(req);
+
+			if (!req->keep_alive) {
+				conn_close(conn);
+				return;
+			}
+			http_next_request(req);
+		}
+
+		if (rc == HTTP_PARSE_ERROR) {
+			req->keep_alive = 0;
+			send_error(req, 400, "Bad Request", NULL, "Can't parse HTTP Request.");
+			conn_close(conn);
+			return;
+		}
+
+		/* socket drained, wait for the rest of the request */
+		if (r < 0)
+			break;
+	}
+
+	conn_idle(conn, EPOLL_CTL_MOD);
+}
+
+static void *http_worker(void *unused)
+{
+	struct http_conn *conn;
+
+	prctl(PR_SET_NAME, "http_worker");
+	for (;;) {
+		pthread_mutex_lock(&work_mutex);
+		while (work_num == 0)
+			pthread_cond_wait(&work_cond, &work_mutex);
+		conn = work_queue[work_head];
+		work_head = (work_head + 1) % HTTPD_MAX_CONNS;
+		work_num--;
+		pthread_mutex_unlock(&work_mutex);
+
+		conn_serve(conn);
+	}
+
+	return NULL;
+}
+
+static void conn_ready(struct http_conn *conn)
+{
+	pthread_mutex_lock(&conn_mutex);
+	conn->state = CONN_BUSY;
+	pthread_mutex_unlock(&conn_mutex);
+
+	pthread_mutex_lock(&work_mutex);
+	work_queue[(work_head + work_num) % HTTPD_MAX_CONNS] = conn;
+	work_num++;
+	pthread_cond_signal(&work_cond);
+	pthread_mutex_unlock(&work_mutex);
+}
+
+static void accept_conns(int32 listen_fd)
+{
+	int32 fd;
+	int32 val = 1;
+	socklen_t addrlen;
+	usockaddr usa;
+	struct timeval timo;
+	struct http_conn *conn;
+
+	for (;;) {
+		addrlen = sizeof(usa);
+		fd = accept4(listen_fd, &usa.sa, &addrlen, SOCK_CLOEXEC);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				HTTPD_ERR("accept fail: %s\n", strerror(errno));
+			return;
+		}
+		HTTPD_INFO("restd accepted a new connection: fd = %d\n", fd);
+
+		conn = conn_alloc(fd, &usa);
+		if (conn == NULL) {
+			HTTPD_ERR("Too many connections, drop fd %d\n", fd);
+			close(fd);
+			continue;
+		}
+
+		/* header and body are separate writes, do not wait for the ACK */
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val));
+
+		timo.tv_sec  = HTTPD_TIMO;
+		timo.tv_usec = 0;
+		if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timo, sizeof(timo)) < 0 ||
+			setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timo, sizeof(timo)) < 0)
+			HTTPD_ERR("setsockopt error fd=%d errno=%d %s\n", fd, errno, strerror(errno));
+
+		conn_idle(conn, EPOLL_CTL_ADD);
+	}
+}
+
+int32 http_server_run(int32 listen_fd)
+{
+	int32 i, n;
+	time_t now, last_expire = 0;
+	pthread_t tid;
+	struct epoll_event ev;
+	struct epoll_event events[HTTPD_MAX_EVENTS];
+
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd < 0) {
+		HTTPD_ERR("epoll_create fail: %s\n", strerror(errno));
+		return -1;
+	}
+
+	fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL) | O_NONBLOCK);
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) < 0) {
+		HTTPD_ERR("epoll_ctl listen fd fail: %s\n", strerror(errno));
+		goto fail;
+	}
+
+	for (i = HTTPD_MAX_CONNS - 1; i >= 0; i--) {
+		conns[i].state = CONN_FREE;
+		conns[i].next_free = free_conns;
+		free_conns = &conns[i];
+	}
+
+	for (i = 0; i < HTTPD_WORKERS; i++) {
+		if (pthread_create(&tid, NULL, http_worker, NULL) != 0) {
+			HTTPD_ERR("Failed to create http_worker!\n");
+			goto fail;
+		}
+	}
+
+	for (;;) {
+		n = epoll_wait(epoll_fd, events, HTTPD_MAX_EVENTS, 1000);
+		if (n < 0 && errno != EINTR) {
+			HTTPD_ERR("epoll_wait fail: %s\n", strerror(errno));
+			goto fail;
+		}
+
+		for (i = 0; i < n; i++) {
+			if (events[i].data.ptr == NULL)
+				accept_conns(listen_fd);
+			else
+				conn_ready((struct http_conn *)events[i].data.ptr);
+		}
+
+		now = now_sec();
+		if (now != last_expire) {
+			conn_expire(now);
+			last_expire = now;
+		}
+	}
+
+fail:
+	close(epoll_fd);
+	epoll_fd = -1;
+	return -1;
+}
@@ -14,6 +14,11 @@
 
 
 /* http://tools.ietf.org/rfc/rfc6455.txt */
+#define _GNU_SOURCE
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/prctl.h>
+#include <sys/uio.h>
 #include <pthread.h>
 #include <openssl/sha.h>
 
@@ -27,12 +32,24 @@
 #include "libjson/json.h"
 #include "libutils/base64.h"
 #include "websocket.h"
+#include "memdb_event.h"
+
+/*
+ * All the websocket clients are served by one hub thread, which waits on
+ * their sockets with epoll and does every read and write. An event is
+ * encoded into a frame once, and the frame is queued by reference to each
+ * client whose topics and filters match it. The queue of a client is
+ * bounded: a client too slow to take WS_QUEUE_LEN frames is dropped, and
+ * resyncs by subscribing again when it reconnects.
+ */
 
 #define SHA1_DIGEST_BYTES	20
 #define WS_KEEP_TIME	120		/* 2 min */
 #define WS_FRAMESZ		0x4000	/* MAX Frame size we support: 16KB */
 #define WS_MSGSZ		0xFFFF	/* MAX Message size we support: 64KB, -1 for '\0' */
 #define WS_SECRET		"258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define WS_MAX_EVENTS	16
+#define WS_MAX_IOV		16		/* frames sent by one writev */
 
 enum ws_state {
 	WS_STATE_ERROR,
@@ -49,181 +66,606 @@ enum ws_frame_type {
 	WS_FRAME_PONG	= 0x0A
 };
 
+enum ws_topic {
+	WS_TOPIC_NODE_ADD	= 0x01,
+	WS_TOPIC_NODE_DEL	= 0x02,
+	WS_TOPIC_HOST_STATE	= 0x04
+};
+
 struct ws_msg {
 	int32 type;
 	int32 payload_sz;
 	uint8 payload[WS_MSGSZ + 1];
 };
 
+/* an encoded frame, shared by the queues of all the clients it goes to */
+struct ws_frame {
+	int32 refcnt;
+	int32 sz;
+	uint8 data[0];
+};
+
+struct ws_client {
+	int32 fd;
+	uint32 id;				/* unique, for the replies of async commands */
+
+	/* what the client wants, changed under hub_mutex */
+	uint32 topics;			/* WS_TOPIC_* */
+	uint32 zone;			/* 0 for all the zones */
+	int32 type;				/* MC_TYPE_* of node events, -1 for all */
 
-static struct ws_msg ws_client_msg;
-static int32 ws_fd;
-static memdb_integer sub_node_add_handle = -1;
-static memdb_integer sub_node_del_handle = -1;
-static memdb_integer sub_host_state_handle = -1;
+	/* outbound queue, under hub_mutex */
+	struct ws_frame *queue[WS_QUEUE_LEN];
+	int32 q_head;
+	int32 q_num;
+	int32 q_off;			/* bytes of the head frame already sent */
+	int32 dropped;			/* queue overflowed, closed by the hub */
+	int32 want_out;
+
+	struct ws_client *next;	/* in the attaching list, under hub_mutex */
+
+	/* only touched by the hub thread */
+	time_t last_rx;
+	int32 alive;
+	uint32 count;
+	int32 sz;
+	uint8 frame[WS_FRAMESZ];
+	struct ws_msg msg;
+};
+
+/*
+ * clients[] only changes on the hub thread, under hub_mutex, so the hub
+ * reads it without the lock. ws_attach hands the new clients over in the
+ * attaching list, client_num counts them too.
+ */
+static pthread_mutex_t hub_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct ws_client *clients[WS_MAX_CLIENTS];
+static struct ws_client *attaching;
+static int32 client_num;
+static uint32 client_ids;
+static int32 hub_epfd = -1;
+static int32 hub_evfd = -1;
+
+/* the PSU node holding the host states, its attributes are watched */
+static memdb_integer host_state_psu;
 
 static enum ws_state ws_parse_frame(uint8 *frame, int32 *psz, struct ws_msg *msg);
-static int32 ws_send_frame(int32 fd, int32 type, const uint8 *payload, int32 sz);
-static void ws_process_cmd(const json_t *json);
+static void ws_process_cmd(struct ws_client *c, const json_t *json);
 static int32 ws_compute_handshake(const int8 *key, int8 *out, int32 *out_sz);
-static void ws_handshake_reply(struct http_request *req);
+static int32 ws_handshake_reply(struct http_request *req);
 static void ws_node_event_callback_fn(struct event_info *evt, void *cb_data);
 
 
-int32 mutex_cond_init(mutex_cond_t *mutex_cond)
+static time_t ws_now(void)
 {
-	int32 rs = 0;
+	struct timespec ts;
 
-	rs = pthread_mutex_init(&(mutex_cond->mutex_cb), NULL);
-	if (0 != rs) {
-		HTTPD_IPMI_PRINT("%s:%d:%s error %d\n", __FILE__, __LINE__, __func__, rs);
-		return rs;
-	}
-	rs = pthread_cond_init(&(mutex_cond->cond_cb), NULL);
-	if (0 != rs) {
-		HTTPD_IPMI_PRINT("%s:%d:%s error %d\n", __FILE__, __LINE__, __func__, rs);
-		return rs;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec;
+}
+
+static struct ws_frame *ws_frame_new(int32 type, const uint8 *payload, int32 sz)
+{
+	struct ws_frame *frame;
+	int32 hdrsz;
+
+	if (sz > 0xFFFF)
+		return NULL;
+
+	hdrsz = (sz <= 125) ? 2 : 4;
+	frame = malloc(sizeof(*frame) + hdrsz + sz);
+	if (frame == NULL)
+		return NULL;
+
+	frame->refcnt = 1;
+	frame->sz = hdrsz + sz;
+	frame->data[0] = 0x80 | (type & 0x0F);
+	if (sz <= 125) {
+		frame->data[1] = (uint8) sz;
+	} else {
+		frame->data[1] = 126;
+		frame->data[2] = (uint8)((sz >> 8) & 0xFF);
+		frame->data[3] = (uint8)((sz) & 0xFF);
 	}
-	return 0;
+	if (sz != 0)
+		memcpy(frame->data + hdrsz, payload, sz);
+
+	return frame;
+}
+
+static void ws_frame_put(struct ws_frame *frame)
+{
+	if (__sync_sub_and_fetch(&frame->refcnt, 1) == 0)
+		free(frame);
 }
 
-int32 mutex_cond_destroy(mutex_cond_t *mutex_cond)
+static void ws_wake_hub(void)
 {
-	int32 rs = 0;
+	uint64 one = 1;
 
-	rs = pthread_mutex_destroy(&(mutex_cond->mutex_cb));
-	if (0 != rs)	{
-		HTTPD_IPMI_PRINT("%s:%d:%s error %d\n", __FILE__, __LINE__, __func__, rs);
-		return rs;
+	if (write(hub_evfd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+		HTTPD_ERR("websocket hub wakeup fail: %s\n", strerror(errno));
+}
+
+/**
+ * @brief: Queue a reference to 'frame' to the client, return 1 if it is
+ *         the first frame queued, so the hub has to be woken. hub_mutex held.
+ */
+static int32 ws_queue_frame(struct ws_client *c, struct ws_frame *frame)
+{
+	if (c->dropped)
+		return 0;
+
+	if (c->q_num == WS_QUEUE_LEN) {
+		HTTPD_ERR("websocket client fd %d is too slow, dropped\n", c->fd);
+		c->dropped = 1;
+		return 1;
 	}
-	rs = pthread_cond_destroy(&(mutex_cond->cond_cb));
-	if (0 != rs) {
-		HTTPD_IPMI_PRINT("%s:%d:%s error %d\n", __FILE__, __LINE__, __func__, rs);
-		return rs;
+
+	__sync_add_and_fetch(&frame->refcnt, 1);
+	c->queue[(c->q_head + c->q_num) % WS_QUEUE_LEN] = frame;
+	c->q_num++;
+
+	return c->q_num == 1;
+}
+
+/* send to one client, from the hub thread which flushes it afterwards */
+static void ws_send(struct ws_client *c, int32 type, const uint8 *payload, int32 sz)
+{
+	struct ws_frame *frame;
+
+	frame = ws_frame_new(type, payload, sz);
+	if (frame == NULL)
+		return;
+
+	pthread_mutex_lock(&hub_mutex);
+	ws_queue_frame(c, frame);
+	pthread_mutex_unlock(&hub_mutex);
+
+	ws_frame_put(frame);
+}
+
+/**
+ * @brief: Queue 'frame' to every client subscribed to 'topic' whose filters
+ *         match the zone and node type of the event, type -1 matches all.
+ */
+static void ws_publish(struct ws_frame *frame, uint32 topic, uint32 zone, int32 type)
+{
+	struct ws_client *c;
+	int32 wake = 0;
+	int32 i;
+
+	pthread_mutex_lock(&hub_mutex);
+	for (i = 0; i < WS_MAX_CLIENTS; i++) {
+		c = clients[i];
+		if (c == NULL || !(c->topics & topic))
+			continue;
+		if (c->zone != 0 && c->zone != zone)
+			continue;
+		if (c->type >= 0 && type >= 0 && c->type != type)
+			continue;
+
+		wake |= ws_queue_frame(c, frame);
 	}
-	return 0;
+	pthread_mutex_unlock(&hub_mutex);
+
+	ws_frame_put(frame);
+	if (wake)
+		ws_wake_hub();
 }
 
-int32 mutex_cond_signal(mutex_cond_t *mutex_cond)
+static int32 ws_topic_wanted(uint32 topic)
 {
-	pthread_mutex_lock(&(mutex_cond->mutex_cb));
-	pthread_cond_signal(&(mutex_cond->cond_cb));
-	pthread_mutex_unlock(&(mutex_cond->mutex_cb));
-	return 0;
+	int32 wanted = 0;
+	int32 i;
+
+	pthread_mutex_lock(&hub_mutex);
+	for (i = 0; i < WS_MAX_CLIENTS && !wanted; i++)
+		wanted = clients[i] != NULL && (clients[i]->topics & topic);
+	pthread_mutex_unlock(&hub_mutex);
+
+	return wanted;
+}
+
+static void ws_set_out(struct ws_client *c, int32 want_out)
+{
+	struct epoll_event ev;
+
+	if (c->want_out == want_out)
+		return;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLRDHUP | (want_out ? EPOLLOUT : 0);
+	ev.data.ptr = c;
+	if (epoll_ctl(hub_epfd, EPOLL_CTL_MOD, c->fd, &ev) == 0)
+		c->want_out = want_out;
 }
 
-int32 mutex_cond_wait(mutex_cond_t *mutex_cond)
+/**
+ * @brief: Write the queued frames until the socket is full, then wait for
+ *         EPOLLOUT. Return -1 if the client has to be closed.
+ */
+static int32 ws_flush(struct ws_client *c)
 {
-	pthread_mutex_lock(&(mutex_cond->mutex_cb));
-	pthread_cond_wait(&(mutex_cond->cond_cb), &(mutex_cond->mutex_cb));
-	pthread_mutex_unlock(&(mutex_cond->mutex_cb));
+	struct iovec iov[WS_MAX_IOV];
+	struct ws_frame *frame;
+	int32 i, n, off;
+	ssize_t rc;
+
+	pthread_mutex_lock(&hub_mutex);
+	if (c->dropped) {
+		pthread_mutex_unlock(&hub_mutex);
+		return -1;
+	}
+
+	while (c->q_num > 0) {
+		n = (c->q_num < WS_MAX_IOV) ? c->q_num : WS_MAX_IOV;
+		off = c->q_off;
+		for (i = 0; i < n; i++) {
+			frame = c->queue[(c->q_head + i) % WS_QUEUE_LEN];
+			iov[i].iov_base = frame->data + off;
+			iov[i].iov_len = frame->sz - off;
+			off = 0;
+		}
+
+		rc = writev(c->fd, iov, n);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			pthread_mutex_unlock(&hub_mutex);
+			return -1;
+		}
+
+		while (rc > 0) {
+			frame = c->queue[c->q_head];
+			if (rc < frame->sz - c->q_off) {
+				c->q_off += rc;
+				break;
+			}
+
+			rc -= frame->sz - c->q_off;
+			c->queue[c->q_head] = NULL;
+			c->q_head = (c->q_head + 1) % WS_QUEUE_LEN;
+			c->q_num--;
+			c->q_off = 0;
+			ws_frame_put(frame);
+		}
+	}
+	n = c->q_num;
+	pthread_mutex_unlock(&hub_mutex);
+
+	ws_set_out(c, n > 0);
 	return 0;
 }
 
-void ws_process(struct http_request *req)
+static void ws_close(struct ws_client *c)
 {
-	int32 fd;
-	int32 maxfd;
-	int32 alive;
-	int32 rc, sz;
-	fd_set rfds;
-	uint32 count;
-	struct ws_msg *msg;
-	struct timeval timo;
+	int32 i;
+
+	pthread_mutex_lock(&hub_mutex);
+	for (i = 0; i < WS_MAX_CLIENTS; i++) {
+		if (clients[i] == c)
+			clients[i] = NULL;
+	}
+	client_num--;
+	pthread_mutex_unlock(&hub_mutex);
+
+	/* no one else refers to the client now */
+	for (; c->q_num > 0; c->q_num--) {
+		ws_frame_put(c->queue[c->q_head]);
+		c->q_head = (c->q_head + 1) % WS_QUEUE_LEN;
+	}
+
+	epoll_ctl(hub_epfd, EPOLL_CTL_DEL, c->fd, NULL);
+	close(c->fd);
+	free(c);
+}
+
+/**
+ * @brief: Handle the complete frames in the input buffer, return -1 if the
+ *         connection is done.
+ */
+static int32 ws_input(struct ws_client *c)
+{
+	struct ws_msg *msg = &c->msg;
 	enum ws_state state;
-	uint8 frame[WS_FRAMESZ];
 
-	ws_handshake_reply(req);
+	while (c->sz != 0) {
+		state = ws_parse_frame(c->frame, &c->sz, msg);
+		if (state == WS_STATE_ERROR)
+			return -1;
+		if (state == WS_STATE_READING)
+			break;
+		if (state != WS_STATE_MSG_COMPLETE)
+			continue;
+
+		if (msg->type == WS_FRAME_CLOSE) {
+			ws_send(c, WS_FRAME_CLOSE, NULL, 0);
+			ws_flush(c);
+			return -1;
+		}
+		if (msg->type == WS_FRAME_PING) {
+			ws_send(c, WS_FRAME_PONG, msg->payload, msg->payload_sz);
+		} else if (msg->type == WS_FRAME_TEXT) {
+			json_t *json;
+
+			msg->payload[msg->payload_sz] = '\0';
+			json = json_parse((int8 *)msg->payload);
+			if (json != NULL) {
+				ws_process_cmd(c, json);
+				json_free(json);
+			}
+		}
 
-	if (libdb_init_subscription(NOTIFY_BY_SELECT, ws_node_event_callback_fn, NULL) < 0) {
-		printf("Failed to init select subscirbe mode!\n");
-		exit(-1);
+		msg->type = 0;
+		msg->payload_sz = 0;
 	}
 
-	sz = 0;
-	alive = 1;
-	count = 0;
-	fd = req->fd;
-	msg = &ws_client_msg;
-	msg->type = 0;
-	msg->payload_sz = 0;
+	return 0;
+}
 
-	ws_fd = fd;
+/**
+ * @brief: Read and handle what the client sent, return -1 if the
+ *         connection is done.
+ */
+static int32 ws_read(struct ws_client *c)
+{
+	int32 rc;
 
 	for (;;) {
-		FD_ZERO(&rfds);
-		FD_SET(fd, &rfds);
-		maxfd = fd;
-		libdb_event_selectfds(&rfds, &maxfd);
-
-		timo.tv_sec  = WS_KEEP_TIME;
-		timo.tv_usec = 0;
-		rc = select(maxfd + 1, &rfds, NULL, NULL, &timo);
-		if (rc < 0)
-			break;
+		if (c->sz == WS_FRAMESZ)
+			return -1;	/* a frame larger than we support */
+
+		rc = recv(c->fd, c->frame + c->sz, WS_FRAMESZ - c->sz, MSG_DONTWAIT);
+		if (rc == 0)
+			return -1;
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			return -1;
+		}
+		c->sz += rc;
+		c->alive = 1;
+		c->last_rx = ws_now();
+
+		if (ws_input(c) < 0)
+			return -1;
+	}
+}
 
-		libdb_event_processfds(&rfds);
+static void ws_keepalive(time_t now)
+{
+	struct ws_client *c;
+	int32 i;
 
-		if (rc == 0) {
-			if (alive == 0)
-				break;
+	for (i = 0; i < WS_MAX_CLIENTS; i++) {
+		c = clients[i];
+		if (c == NULL || now - c->last_rx < WS_KEEP_TIME)
+			continue;
 
-			alive = 0;
-			count++;
-			ws_send_frame(fd, WS_FRAME_PING, (void *)&count, sizeof(count));
+		if (c->alive == 0) {
+			ws_close(c);
 			continue;
 		}
 
-		if (!FD_ISSET(fd, &rfds))
+		c->alive = 0;
+		c->last_rx = now;
+		c->count++;
+		ws_send(c, WS_FRAME_PING, (void *)&c->count, sizeof(c->count));
+		if (ws_flush(c) < 0)
+			ws_close(c);
+	}
+}
+
+/**
+ * @brief: Register the clients handed over by ws_attach, and handle the
+ *         frames they sent behind the upgrade request.
+ */
+static void ws_adopt(void)
+{
+	struct epoll_event ev;
+	struct ws_client *list, *c;
+	int32 i;
+
+	pthread_mutex_lock(&hub_mutex);
+	list = attaching;
+	attaching = NULL;
+	pthread_mutex_unlock(&hub_mutex);
+
+	while (list != NULL) {
+		c = list;
+		list = c->next;
+		c->next = NULL;
+
+		/* client_num kept a free slot for it */
+		pthread_mutex_lock(&hub_mutex);
+		for (i = 0; clients[i] != NULL; i++)
+			;
+		clients[i] = c;
+		pthread_mutex_unlock(&hub_mutex);
+
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN | EPOLLRDHUP;
+		ev.data.ptr = c;
+		if (epoll_ctl(hub_epfd, EPOLL_CTL_ADD, c->fd, &ev) < 0) {
+			HTTPD_ERR("websocket epoll_ctl fd %d fail: %s\n", c->fd, strerror(errno));
+			ws_close(c);
 			continue;
+		}
 
-		rc = read(fd, frame + sz, WS_FRAMESZ - sz);
-		if (rc <= 0)
-			break;
-		sz += rc;
-		alive = 1;
+		if (ws_input(c) < 0 || ws_flush(c) < 0)
+			ws_close(c);
+	}
+}
 
-again:
-		state = ws_parse_frame(frame, &sz, msg);
-		if (state == WS_STATE_ERROR)
-			break;
-		if (state == WS_STATE_READING)
+static void *ws_hub_thread(void *unused)
+{
+	struct epoll_event events[WS_MAX_EVENTS];
+	struct ws_client *c;
+	time_t now, last_keepalive = 0;
+	uint64 wakeups;
+	int32 i, n, flush_all;
+
+	prctl(PR_SET_NAME, "ws_hub_thread");
+	for (;;) {
+		n = epoll_wait(hub_epfd, events, WS_MAX_EVENTS, 1000);
+		if (n < 0 && errno != EINTR) {
+			HTTPD_ERR("websocket epoll_wait fail: %s\n", strerror(errno));
 			continue;
-		if (state == WS_STATE_MSG_COMPLETE) {
-			if (msg->type == WS_FRAME_CLOSE) {
-				ws_send_frame(fd, WS_FRAME_CLOSE, NULL, 0);
-				break;
-			}
-			if (msg->type == WS_FRAME_PING) {
-				if (!ws_send_frame(fd, WS_FRAME_PONG, msg->payload, msg->payload_sz))
-					break;
-			} else if (msg->type == WS_FRAME_TEXT) {
-				json_t *json;
-
-				msg->payload[msg->payload_sz] = '\0';
-				json = json_parse((int8 *)msg->payload);
-				if (json != NULL) {
-					ws_process_cmd(json);
-					json_free(json);
+		}
+
+		flush_all = 0;
+		for (i = 0; i < n; i++) {
+			c = (struct ws_client *)events[i].data.ptr;
+			if (c == NULL) {
+				if (read(hub_evfd, &wakeups, sizeof(wakeups)) > 0) {
+					ws_adopt();
+					flush_all = 1;
 				}
+				continue;
 			}
 
-			msg->type = 0;
-			msg->payload_sz = 0;
+			if ((events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) &&
+				ws_read(c) < 0) {
+				ws_close(c);
+				continue;
+			}
+
+			/* replies to what was read, or room for what is queued */
+			if (ws_flush(c) < 0)
+				ws_close(c);
 		}
 
-		if (sz != 0)
-			goto again;
+		/* the clients list only changes on this thread */
+		if (flush_all) {
+			for (i = 0; i < WS_MAX_CLIENTS; i++) {
+				c = clients[i];
+				if (c != NULL && !c->want_out && ws_flush(c) < 0)
+					ws_close(c);
+			}
+		}
+
+		now = ws_now();
+		if (now != last_keepalive) {
+			ws_keepalive(now);
+			last_keepalive = now;
+		}
 	}
 
-	if (sub_node_add_handle != -1)
-		libdb_unsubscribe_event(DB_RMM, sub_node_add_handle, LOCK_ID_NULL);
-	if (sub_node_del_handle != -1)
-		libdb_unsubscribe_event(DB_RMM, sub_node_del_handle, LOCK_ID_NULL);
-	if (sub_host_state_handle != -1)
-		libdb_unsubscribe_event(DB_RMM, sub_host_state_handle, LOCK_ID_NULL);
+	return NULL;
+}
 
-	libdb_exit_memdb();
+int32 ws_hub_init(void)
+{
+	struct epoll_event ev;
+	pthread_t tid;
+
+	hub_evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	hub_epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (hub_evfd < 0 || hub_epfd < 0) {
+		HTTPD_ERR("websocket hub init fail: %s\n", strerror(errno));
+		goto fail;
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	if (epoll_ctl(hub_epfd, EPOLL_CTL_ADD, hub_evfd, &ev) < 0) {
+		HTTPD_ERR("websocket hub epoll_ctl fail: %s\n", strerror(errno));
+		goto fail;
+	}
+
+	if (memdb_event_listen(ws_node_event_callback_fn, NULL) != 0)
+		goto fail;
+
+	if (pthread_create(&tid, NULL, ws_hub_thread, NULL) != 0) {
+		HTTPD_ERR("Failed to create ws_hub_thread!\n");
+		memdb_event_unlisten(ws_node_event_callback_fn, NULL);
+		goto fail;
+	}
+
+	return 0;
+
+fail:
+	if (hub_epfd >= 0)
+		close(hub_epfd);
+	if (hub_evfd >= 0)
+		close(hub_evfd);
+	hub_epfd = -1;
+	hub_evfd = -1;
+	return -1;
+}
+
+int32 ws_attach(struct http_request *req)
+{
+	struct ws_client *c = NULL;
+	int32 used = req->hd_sz + req->content_length;
+	int32 left = req->sz - used;
+	int32 full;
+
+	if (hub_epfd < 0) {
+		send_error(req, 503, "Service Unavailable", NULL, "WebSocket is not available!");
+		return -1;
+	}
+
+	pthread_mutex_lock(&hub_mutex);
+	full = (client_num == WS_MAX_CLIENTS);
+	if (!full)
+		client_num++;
+	pthread_mutex_unlock(&hub_mutex);
+
+	if (full) {
+		send_error(req, 503, "Service Unavailable", NULL, "Too many WebSocket clients!");
+		return -1;
+	}
+
+	/* frames the client sent behind the upgrade request */
+	if (left > WS_FRAMESZ) {
+		HTTPD_ERR("websocket fd %d sent %d bytes with the upgrade request\n", req->fd, left);
+		goto fail;
+	}
+
+	c = malloc(sizeof(*c));
+	if (c == NULL) {
+		HTTPD_ERR("websocket client malloc fail\n");
+		goto fail;
+	}
+	memset(c, 0, sizeof(*c));
+	c->fd = req->fd;
+	c->type = -1;
+	c->alive = 1;
+	c->last_rx = ws_now();
+
+	if (ws_handshake_reply(req) != 0)
+		goto fail;
+
+	if (left > 0) {
+		memcpy(c->frame, req->buff + used, left);
+		c->sz = left;
+	}
+
+	fcntl(c->fd, F_SETFL, fcntl(c->fd, F_GETFL) | O_NONBLOCK);
+
+	/* the hub publishes it in clients[] and waits on its socket */
+	pthread_mutex_lock(&hub_mutex);
+	c->id = ++client_ids;
+	c->next = attaching;
+	attaching = c;
+	pthread_mutex_unlock(&hub_mutex);
+	ws_wake_hub();
+
+	return 0;
+
+fail:
+	pthread_mutex_lock(&hub_mutex);
+	client_num--;
+	pthread_mutex_unlock(&hub_mutex);
+	free(c);
+	return -1;
 }
 
 
@@ -247,7 +689,7 @@ static int32 ws_compute_handshake(const int8 *key, int8 *out, int32 *out_sz)
 	return 1;
 }
 
-static void ws_handshake_reply(struct http_request *req)
+static int32 ws_handshake_reply(struct http_request *req)
 {
 	int32  fd = req->fd;
 	int32  handshake_sz, reply_sz;
@@ -258,13 +700,13 @@ static void ws_handshake_reply(struct http_request *req)
 		req->is_connection_upgrade == 0 ||
 		req->sec_websocket_key == NULL ||
 		req->sec_websocket_version != WS_RFC6455_VERSION) {
-		send_error(fd, 400, "Bad Request", NULL, "Not a valid WebSocket request!");
-		return;
+		send_error(req, 400, "Bad Request", NULL, "Not a valid WebSocket request!");
+		return -1;
 	}
 
 	if (!ws_compute_handshake(req->sec_websocket_key, handshake, &handshake_sz)) {
-		send_error(fd, 400, "Bad Request", NULL, "Sec-WebSocket-key is too long!");
-		return;
+		send_error(req, 400, "Bad Request", NULL, "Sec-WebSocket-key is too long!");
+		return -1;
 	}
 
 	reply_sz = snprintf(reply, sizeof(reply),
@@ -274,7 +716,9 @@ static void ws_handshake_reply(struct http_request *req)
 					"Sec-WebSocket-Accept: %s\r\n"
 					"\r\n", handshake);
 	if (http_write(fd, reply, reply_sz) != reply_sz)
-		exit(-1);
+		return -1;
+
+	return 0;
 }
 
 static inline void ws_msg_add(struct ws_msg *m, const uint8 *p, int32 len,
@@ -332,7 +776,7 @@ static enum ws_state ws_parse_frame(uint8 *frame, int32 *psz, struct ws_msg *msg
 
 	*psz = sz;
 	if (sz != 0)
-		memcpy(frame, data + len, sz);	/* More Frame, next loop to process. */
+		memmove(frame, data + len, sz);	/* More Frame, next loop to process. */
 
 	if (last)
 		return WS_STATE_MSG_COMPLETE;
@@ -340,35 +784,10 @@ static enum ws_state ws_parse_frame(uint8 *frame, int32 *psz, struct ws_msg *msg
 		return WS_STATE_FRAME_COMPLETE;
 }
 
-static int32 ws_send_frame(int32 fd, int32 type, const uint8 *payload, int32 sz)
-{
-	int32 hdrsz;
-	uint8 hdr[4];
-
-	hdr[0] = 0x80 | (type & 0x0F);
-	if (sz <= 125) {
-		hdrsz  = 2;
-		hdr[1] = (uint8) sz;
-	} else if (sz <= 0xFFFF) {
-		hdrsz = 4;
-		hdr[1] = 126;
-		hdr[2] = (uint8)((sz >> 8) & 0xFF);
-		hdr[3] = (uint8)((sz) & 0xFF);
-	} else {
-		return 0;
-	}
-
-	if (http_write(fd, (int8 *)hdr, hdrsz) != hdrsz ||
-	    http_write(fd, (int8 *)payload, sz) != sz)
-		return 0;
-
-	return 1;
-}
-
 /*************************************************************/
 
 
-static void pub_node_event(memdb_integer node_id, int32 add, uint8 usize)
+static struct ws_frame *node_event_frame(memdb_integer node_id, int32 add, uint8 usize)
 {
 	uint32 zoneId, trayId, nodeId;
 	uint8 height, width;
@@ -400,10 +819,10 @@ static void pub_node_event(memdb_integer node_id, int32 add, uint8 usize)
 			zoneId, trayId, nodeId);
 	}
 
-	ws_send_frame(ws_fd, WS_FRAME_TEXT, (const uint8 *)msg, msglen);
+	return ws_frame_new(WS_FRAME_TEXT, (const uint8 *)msg, msglen);
 }
 
-static void pub_host_state(uint32 addr, int32 on)
+static struct ws_frame *host_state_frame(uint32 addr, int32 on)
 {
 	uint32 zoneId, trayId, nodeId;
 	int32  msglen;
@@ -423,29 +842,44 @@ static void pub_host_state(uint32 addr, int32 on)
 			 on ? "hostStateOn" : "hostStateOff",
 			 zoneId, trayId, nodeId);
 
-	ws_send_frame(ws_fd, WS_FRAME_TEXT, (uint8 *)msg, msglen);
+	return ws_frame_new(WS_FRAME_TEXT, (uint8 *)msg, msglen);
 }
 
 static void ws_node_event_callback_fn(struct event_info *evt, void *cb_data)
 {
+	struct ws_frame *frame;
 	int64 error_code = 0;
 
 	if (evt->event == EVENT_NODE_CREATE || evt->event == EVENT_NODE_DELETE) {
+		int32 add = (evt->event == EVENT_NODE_CREATE);
 		int8 usize = 0;
 
-		if (evt->event == EVENT_NODE_CREATE) {
+		if (evt->ntype < MC_TYPE_DRAWER || evt->ntype > MC_TYPE_BMC)
+			return;
+		if (!ws_topic_wanted(add ? WS_TOPIC_NODE_ADD : WS_TOPIC_NODE_DEL))
+			return;
+
+		if (add) {
 			error_code = libdb_attr_get_char(DB_RMM, evt->nnodeid, MC_U_SIZE, &usize, LOCK_ID_NULL);
 			if (error_code != 0) {
 				HTTPD_IPMI_PRINT("%s:%d: error code:%d\n", __FUNCTION__, __LINE__, (int32)error_code);
 			}
 		}
-		pub_node_event(evt->nnodeid , evt->event == EVENT_NODE_CREATE, (uint8)usize);
+
+		frame = node_event_frame(evt->nnodeid, add, (uint8)usize);
+		if (frame != NULL)
+			ws_publish(frame, add ? WS_TOPIC_NODE_ADD : WS_TOPIC_NODE_DEL,
+					   ZONE_ID(evt->nnodeid), evt->ntype);
 	} else if (evt->event == EVENT_NODE_ATTR) {
 		int32 on;
 		uint32 addr;
 		int8 *name, *data;
 
 		name = event_attr_name(evt);
+		if (host_state_psu == 0 || evt->anodeid != host_state_psu ||
+			strncmp(name, PSU_HOSTSTATE_PREFIX, sizeof(PSU_HOSTSTATE_PREFIX) - 1) != 0)
+			return;
+
 		addr = (uint32) atoi(&name[sizeof(PSU_HOSTSTATE_PREFIX) - 1]);
 		data = event_attr_data(evt);
 		if (evt->aaction != EVENT_ATTR_ACTION_DEL &&
@@ -453,35 +887,39 @@ static void ws_node_event_callback_fn(struct event_info *evt, void *cb_data)
 			on = 1;
 		else
 			on = 0;
-		pub_host_state(addr, on);
+
+		frame = host_state_frame(addr, on);
+		if (frame != NULL)
+			ws_publish(frame, WS_TOPIC_HOST_STATE, ZONE_ID(addr), -1);
 	}
 }
 
-static void show_host_state(void)
+/* replay to a client what it subscribed to, under its filters */
+static void ws_replay(struct ws_client *c, struct ws_frame *frame, uint32 zone, int32 type)
+{
+	if (frame == NULL)
+		return;
+
+	pthread_mutex_lock(&hub_mutex);
+	if ((c->zone == 0 || c->zone == zone) &&
+		(c->type < 0 || type < 0 || c->type == type))
+		ws_queue_frame(c, frame);
+	pthread_mutex_unlock(&hub_mutex);
+
+	ws_frame_put(frame);
+}
+
+static void show_host_state(struct ws_client *c)
 {
 	int32 on;
 	uint32 addr;
 
 	int32 offset, size;
-	memdb_integer psu;
-	int32 psu_num;
 	void *attr;
 	int8 *name, *data;
 	struct attr_info *info;
-	struct node_info *node;
-
-	node = libdb_list_node_by_type(DB_RMM, MC_TYPE_PSU,
-								   MC_TYPE_PSU, &psu_num, NULL, LOCK_ID_NULL);
-
-	if (node == NULL) {
-		libdb_free_node(node);
-		return;
-	}
-	/* hc add for debug */
-	psu = node[0].node_id;
-	libdb_free_node(node);
 
-	attr = libdb_list_attrs_by_node(DB_RMM, psu, &size, LOCK_ID_NULL);
+	attr = libdb_list_attrs_by_node(DB_RMM, host_state_psu, &size, LOCK_ID_NULL);
 	if (attr == NULL)
 		return;
 
@@ -496,77 +934,94 @@ static void show_host_state(void)
 			on = 1;
 		else
 			on = 0;
-		pub_host_state(addr, on);
+		ws_replay(c, host_state_frame(addr, on), ZONE_ID(addr), -1);
 	}
 }
 
+static void show_nodes(struct ws_client *c)
+{
+	int32 i;
+	int32 nodenum;
+	int8 usize;
+	int64 error_code = 0;
+	struct node_info *nodeinfo;
+
+	/* Node has been added */
+	nodeinfo = libdb_list_node_by_type(DB_RMM, MC_TYPE_DRAWER, MC_TYPE_BMC, &nodenum, NULL, LOCK_ID_NULL);
+	if (nodeinfo == NULL)
+		return;
+
+	for (i = 0; i < nodenum; i++) {
+		usize = 0;
+		error_code = libdb_attr_get_char(DB_RMM, nodeinfo[i].node_id, MC_U_SIZE, &usize, LOCK_ID_NULL);
+		if (error_code != 0) {
+			HTTPD_IPMI_PRINT("%s:%d: error code:%d\n", __FUNCTION__, __LINE__, (int32)error_code);
+		}
+		ws_replay(c, node_event_frame(nodeinfo[i].node_id, 1, (uint8)usize),
+				  ZONE_ID(nodeinfo[i].node_id), nodeinfo[i].type);
+	}
+	libdb_free_node(nodeinfo);
+}
+
+/* the reply comes on the IPMI callback thread, the client may be gone */
 static int32 ws_dev_id_resp_handler(int32 result, uint8 *rsp, int32 rsp_len,
 			void *cb_data)
 {
-	get_dev_id_cb_data_t *p_get_dev_id_cb_data = (get_dev_id_cb_data_t *)cb_data;
-	mutex_cond_t *p_mutex_cond = (mutex_cond_t *)cb_data;
-	uint8 *dev_id = (uint8 *)&(p_get_dev_id_cb_data->rsp);
-	int32 data_len = 0;
+	const int8 *text = "test ipmi respond OK";
+	uint32 id = *(uint32 *)cb_data;
+	struct ws_frame *frame;
+	int32 wake = 0;
 	int32 i;
 
-	HTTPD_IPMI_PRINT("%s:%d:%s enter\n", __FILE__, __LINE__, __func__);
-	if (NULL == cb_data)
-		return -1;
-
-	printf("DEVID RSP RCV'D: ");
-	for (i = 0; i < rsp_len; i++)
-		printf("%02X ", rsp[i]);
-	printf("\n");
+	free(cb_data);
 
-	if (rsp[0] != IPMI_CC_OK)
+	if (rsp_len > 0 && rsp[0] != IPMI_CC_OK)
 		HTTPD_IPMI_PRINT("rsp error, rsp cc is %02x\n", rsp[0]);
 	else
 		HTTPD_IPMI_PRINT("rsp OK, len[%d]\n", rsp_len);
 
-	data_len = ((LEN_GET_DEV_ID_RSP > rsp_len)?rsp_len:LEN_GET_DEV_ID_RSP);
-	memcpy(dev_id, rsp, data_len);
+	frame = ws_frame_new(WS_FRAME_TEXT, (const uint8 *)text, strlen(text));
+	if (frame == NULL)
+		return 0;
+
+	pthread_mutex_lock(&hub_mutex);
+	for (i = 0; i < WS_MAX_CLIENTS; i++) {
+		if (clients[i] != NULL && clients[i]->id == id)
+			wake = ws_queue_frame(clients[i], frame);
+	}
+	pthread_mutex_unlock(&hub_mutex);
 
-	mutex_cond_signal(p_mutex_cond);
+	ws_frame_put(frame);
+	if (wake)
+		ws_wake_hub();
 
-	ws_send_frame(ws_fd, WS_FRAME_TEXT, (uint8 *)"test ipmi respond OK", strlen("test ipmi respond OK"));
-	HTTPD_IPMI_PRINT("%s:%d:%s exit\n", __FILE__, __LINE__, __func__);
 	return 0;
 }
 
-static int32 handle_ipmi_cmd(int32 host)
+static int32 handle_ipmi_cmd(struct ws_client *c, int32 host)
 {
 	struct jipmi_msg req = {};
-	get_dev_id_cb_data_t *p_cb_data = NULL;
-	mutex_cond_t *p_mutex_cond = NULL;
+	uint32 *id;
 
-	HTTPD_IPMI_PRINT("%s:%d:%s enter\n", __FILE__, __LINE__, __func__);
-	p_cb_data = malloc(sizeof(get_dev_id_cb_data_t));
-	if (NULL == p_cb_data) {
-		HTTPD_IPMI_PRINT("%s:%d:%s error\n", __FILE__, __LINE__, __func__);
+	id = malloc(sizeof(*id));
+	if (id == NULL)
 		return RESULT_MALLOC_ERR;
-	}
-	memset(p_cb_data, 0, sizeof(get_dev_id_cb_data_t));
-
-	p_mutex_cond = (mutex_cond_t *)p_cb_data;
-	mutex_cond_init(p_mutex_cond);
-
+	*id = c->id;
 
 	FILL_INT(req.netfn,		HTTPD_APP_IPMI_NETFN);
 	FILL_INT(req.cmd,		GET_DEVICE_ID_CMD);
 	FILL_INT(req.data_len,	0);
 
-	libjipmi_rmcp_cmd(host, IPMI_RMCP_PORT, &req, ws_dev_id_resp_handler, (void *)p_cb_data, JIPMI_NON_SYNC);
-
-	mutex_cond_wait(p_mutex_cond);
-	mutex_cond_destroy(p_mutex_cond);
+	/* never wait for the reply on the hub thread */
+	if (libjipmi_rmcp_cmd(host, IPMI_RMCP_PORT, &req, ws_dev_id_resp_handler, (void *)id, JIPMI_NON_SYNC) != 0) {
+		free(id);
+		return -1;
+	}
 
-	free(p_cb_data);
-	HTTPD_IPMI_PRINT("%s:%d:%s exit\n", __FILE__, __LINE__, __func__);
 	return 0;
-
 }
 
-static int32 handle_memdb_cmd(void)
+static int32 handle_memdb_cmd(struct ws_client *c)
 {
 	memdb_integer node;
 	int8 output[128] = {0};
@@ -589,11 +1044,44 @@ static int32 handle_memdb_cmd(void)
 		HTTPD_IPMI_PRINT("%s:%d: error code:%d\n", __FUNCTION__, __LINE__, (int32)error_code);
 		return (int32)error_code;
 	} else
-		ws_send_frame(ws_fd, WS_FRAME_TEXT, (uint8 *)(output), strlen(output));
+		ws_send(c, WS_FRAME_TEXT, (uint8 *)(output), strlen(output));
 
 	return 0;
 }
 
+static void ws_subscribe(struct ws_client *c, uint32 topic, int32 on)
+{
+	pthread_mutex_lock(&hub_mutex);
+	if (on)
+		c->topics |= topic;
+	else
+		c->topics &= ~topic;
+	pthread_mutex_unlock(&hub_mutex);
+}
+
+/* { "filter" : { "zone" : 1, "type" : "DRAWER" } }, a missing key matches all */
+static void ws_set_filter(struct ws_client *c, const json_t *filter)
+{
+	json_t *zone, *type;
+	const int8 *name;
+	int32 type_id = -1;
+	int32 i;
+
+	zone = json_object_get(filter, "zone");
+	type = json_object_get(filter, "type");
+
+	if (type != NULL && (name = json_string_value(type)) != NULL) {
+		for (i = MC_TYPE_DRAWER; i <= MC_TYPE_BMC; i++) {
+			if (strcasecmp(name, mc_type_str[i]) == 0)
+				type_id = i;
+		}
+	}
+
+	pthread_mutex_lock(&hub_mutex);
+	c->zone = (zone != NULL) ? (uint32)json_integer_value(zone) : 0;
+	c->type = type_id;
+	pthread_mutex_unlock(&hub_mutex);
+}
 
 /*
  * 1. { "nodeAdded" : "subscribe" }
@@ -602,15 +1090,20 @@ static int32 handle_memdb_cmd(void)
  * 4. { "nodeRemoved" : "unsubscribe" }
  * 5. { "hostState" : "subscribe" }
  * 6. { "hostState" : "unsubscribe" }
+ * 7. { "filter" : { "zone" : 1, "type" : "DRAWER" } }
  */
-static void ws_process_cmd(const json_t *json)
+static void ws_process_cmd(struct ws_client *c, const json_t *json)
 {
 	json_t *target;
 	int8   *command;
-	int8    usize;
 	int32 psu_num;
 	struct node_info *node;
-	int64 error_code = 0;
+
+	target = json_object_get(json, "filter");
+	if (target != NULL) {
+		ws_set_filter(c, target);
+		return;
+	}
 
 	target = json_object_get(json, "nodeAdded");
 	if (target != NULL) {
@@ -618,31 +1111,13 @@ static void ws_process_cmd(const json_t *json)
 			return;
 
 		if (strcmp(command, "subscribe") == 0) {
-			int32 i;
-			int32 nodenum;
-			struct node_info *nodeinfo;
-
-			if (sub_node_add_handle != -1)
+			if (c->topics & WS_TOPIC_NODE_ADD)
 				return;
 
-			sub_node_add_handle = libdb_subscribe_type_of_node_create(DB_RMM, MC_TYPE_DRAWER,
-										MC_TYPE_BMC, LOCK_ID_NULL);
-
-			/* Node has been added */
-			nodeinfo = libdb_list_node_by_type(DB_RMM, MC_TYPE_DRAWER, MC_TYPE_BMC, &nodenum, NULL,LOCK_ID_NULL);
-			for (i = 0; i < nodenum; i++) {
-				error_code = libdb_attr_get_char(DB_RMM, nodeinfo[i].node_id, MC_U_SIZE, &usize, LOCK_ID_NULL);
-				if (error_code != 0) {
-					HTTPD_IPMI_PRINT("%s:%d: error code:%d\n", __FUNCTION__, __LINE__, (int32)error_code);
-				}
-				pub_node_event(nodeinfo[i].node_id, 1, (uint8)usize);
-			}
-			libdb_free_node(nodeinfo);
+			ws_subscribe(c, WS_TOPIC_NODE_ADD, 1);
+			show_nodes(c);
 		} else if (strcmp(command, "unsubscribe") == 0) {
-			if (sub_node_add_handle != -1) {
-				libdb_unsubscribe_event(DB_RMM, sub_node_add_handle, LOCK_ID_NULL);
-				sub_node_add_handle = -1;
-			}
+			ws_subscribe(c, WS_TOPIC_NODE_ADD, 0);
 		}
 
 		return;
@@ -654,16 +1129,9 @@ static void ws_process_cmd(const json_t *json)
 			return;
 
 		if (strcmp(command, "subscribe") == 0) {
-			if (sub_node_del_handle != -1)
-				return;
-
-			sub_node_del_handle = libdb_subscribe_type_of_node_delete(DB_RMM, MC_TYPE_DRAWER,
-										MC_TYPE_BMC, LOCK_ID_NULL);
+			ws_subscribe(c, WS_TOPIC_NODE_DEL, 1);
 		} else if (strcmp(command, "unsubscribe") == 0) {
-			if (sub_node_del_handle != -1) {
-				libdb_unsubscribe_event(DB_RMM, sub_node_del_handle, LOCK_ID_NULL);
-				sub_node_del_handle = -1;
-			}
+			ws_subscribe(c, WS_TOPIC_NODE_DEL, 0);
 		}
 
 		return;
@@ -675,18 +1143,24 @@ static void ws_process_cmd(const json_t *json)
 			return;
 
 		if (strcmp(command, "subscribe") == 0) {
-			if (sub_host_state_handle != -1)
+			if (c->topics & WS_TOPIC_HOST_STATE)
 				return;
-			/* hc add for debug */
-			node = libdb_list_node_by_type(DB_RMM, MC_TYPE_PSU, MC_TYPE_PSU, &psu_num, NULL, LOCK_ID_NULL);
-			sub_host_state_handle = libdb_subscribe_attr_by_prefix(DB_RMM, node[0].node_id, PSU_HOSTSTATE_PREFIX, LOCK_ID_NULL);
-			libdb_free_node(node);
-			show_host_state();	/* hostState has been added */
-		} else if (strcmp(command, "unsubscribe") == 0) {
-			if (sub_host_state_handle != -1) {
-				libdb_unsubscribe_event(DB_RMM, sub_host_state_handle, LOCK_ID_NULL);
-				sub_host_state_handle = -1;
+			if (host_state_psu == 0) {
+				/* hc add for debug */
+				node = libdb_list_node_by_type(DB_RMM, MC_TYPE_PSU, MC_TYPE_PSU, &psu_num, NULL, LOCK_ID_NULL);
+				if (node == NULL)
+					return;
+				if (memdb_event_watch_node(node[0].node_id) < 0) {
+					libdb_free_node(node);
+					return;
+				}
+				host_state_psu = node[0].node_id;
+				libdb_free_node(node);
 			}
+			ws_subscribe(c, WS_TOPIC_HOST_STATE, 1);
+			show_host_state(c);	/* hostState has been added */
+		} else if (strcmp(command, "unsubscribe") == 0) {
+			ws_subscribe(c, WS_TOPIC_HOST_STATE, 0);
 		}
 		return;
 	}
@@ -697,7 +1171,7 @@ static void ws_process_cmd(const json_t *json)
 			return;
 
 		if (strcmp(command, "test") == 0)
-			handle_ipmi_cmd(inet_addr("192.168.10.4"));
+			handle_ipmi_cmd(c, inet_addr("192.168.10.4"));
 	}
 
 	target = json_object_get(json, "memdb");
@@ -706,8 +1180,7 @@ static void ws_process_cmd(const json_t *json)
 			return;
 
 		if (strcmp(command, "test") == 0)
-			handle_memdb_cmd();
+			handle_memdb_cmd(c);
 	}
 }
 /*************************************************************/
-
@@ -28,18 +28,16 @@
 #define HTTPD_APP_IPMI_NETFN    0x06
 
 
-typedef struct mutex_cond {
-	pthread_mutex_t mutex_cb;
-	pthread_cond_t cond_cb;
-} mutex_cond_t, *mutex_cond_p;
-
-#define LEN_GET_DEV_ID_RSP	16
-typedef struct get_dev_id_cb_data {
-	mutex_cond_t mutex_cond_cb;
-	uint8 rsp[LEN_GET_DEV_ID_RSP];
-} get_dev_id_cb_data_t, *get_dev_id_cb_data_p;
-
-extern void ws_process(struct http_request *req);
+#define WS_MAX_CLIENTS		32
+#define WS_QUEUE_LEN		512		/* frames queued to a client before it is dropped */
+
+extern int32 ws_hub_init(void);
+
+/**
+ * @brief: Reply the handshake and hand the connection over to the hub,
+ *         which owns the socket if 0 is returned.
+ */
+extern int32 ws_attach(struct http_request *req);
 
 #endif
 
@@ -16,17 +16,80 @@
 #include "libjson/json.h"
 #include "libutils/log.h"
 #include "libutils/string.h"
+#include "libutils/log_level.h"
 #include "librmmcfg/rmm_cfg.h"
 #include "log_manager.h"
 
 #define LOG_MODULES_MAX_NUM		(12)
+#define LOG_NAMES_HASH_SIZE		(64)	/* power of 2 */
 
 struct log_module {
 	long handler;
 	char name[128];
 };
 
+/**
+ * @brief: the module of a name sent by the clients, -1 if none.
+ *
+ * The clients send their process name, truncated by the kernel, so the
+ * module is the first whose name contains it. The answer is kept in an
+ * open addressing table, the modules are scanned once per name.
+ */
+struct log_name {
+	char name[EVT_MODULE_LEN];
+	int module;
+};
+
 static struct log_module log_modules[LOG_MODULES_MAX_NUM];
+static int log_module_num;
+static struct log_name log_names[LOG_NAMES_HASH_SIZE];
+
+static unsigned int hash_name(const char *name)
+{
+	unsigned int hash = 5381;
+
+	while (*name)
+		hash = hash * 33 + (unsigned char)*name++;
+
+	return hash;
+}
+
+static int scan_module(const char *name)
+{
+	int index = 0;
+
+	for (index = 0; index < log_module_num; index++) {
+		if (strstr(log_modules[index].name, name) != 0)
+			return index;
+	}
+
+	return -1;
+}
+
+static int find_module(const char *name)
+{
+	unsigned int slot = hash_name(name) & (LOG_NAMES_HASH_SIZE - 1);
+	struct log_name *entry = NULL;
+	int i = 0;
+
+	if (name[0] == '\0' || strlen(name) >= EVT_MODULE_LEN)
+		return scan_module(name);
+
+	for (i = 0; i < LOG_NAMES_HASH_SIZE; i++) {
+		entry = &log_names[slot];
+		if (entry->name[0] == '\0') {
+			snprintf(entry->name, sizeof(entry->name), "%s", name);
+			entry->module = scan_module(name);
+			return entry->module;
+		}
+		if (strcmp(entry->name, name) == 0)
+			return entry->module;
+		slot = (slot + 1) & (LOG_NAMES_HASH_SIZE - 1);
+	}
+
+	/* the table is full */
+	return scan_module(name);
+}
 
 int log_mgr_init(void)
 {
@@ -41,6 +104,9 @@ int log_mgr_init(void)
 		exit(-1);
 	}
 
+	if (module_cnt > LOG_MODULES_MAX_NUM)
+		module_cnt = LOG_MODULES_MAX_NUM;
+
 	for (index = 0; index < module_cnt; index++) {
 		handler = log_init(rmm_log_modules[index].name);
 		log_set_level(handler, rmm_log_modules[index].level);
@@ -52,30 +118,35 @@ int log_mgr_init(void)
 					RMM_LOG_MODULE_NAME_LEN,
 					RMM_LOG_MODULE_NAME_LEN - 1);
 	}
+	log_module_num = module_cnt;
 
 	return 0;
 }
 
 void log_mgr_put(char *module_name, int level, const char *func_name, char *msg)
 {
-	int index = 0;
+	int index = find_module(module_name);
 
-	for (index = 0; index < LOG_MODULES_MAX_NUM; index++) {
-		if (strstr(log_modules[index].name, module_name) != 0) {
-				log_put(log_modules[index].handler, level, func_name, msg);
-			break;
-		}
-	}
+	if (index >= 0)
+		log_put(log_modules[index].handler, level, func_name, msg);
 }
 
-void log_mgr_get(char *module_name, int count, char *data)
+int log_mgr_get(char *module_name, int count, char *data)
 {
-	int index = 0;
+	int index = find_module(module_name);
 
-	for (index = 0; index < LOG_MODULES_MAX_NUM; index++) {
-		if (strstr(log_modules[index].name, module_name) != 0) {
-			log_get(log_modules[index].handler, count, data);
-			break;
-		}
-	}
+	if (index < 0)
+		return 0;
+
+	return log_get(log_modules[index].handler, count, data);
+}
+
+int log_mgr_get_range(char *module_name, time_t from, time_t to, int count, char *data)
+{
+	int index = find_module(module_name);
+
+	if (index < 0)
+		return 0;
+
+	return log_get_range(log_modules[index].handler, from, to, count, data);
 }
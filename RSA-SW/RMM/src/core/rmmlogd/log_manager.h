@@ -16,6 +16,8 @@
 #ifndef __LOG_MANAGER_H__
 #define __LOG_MANAGER_H__
 
+#include <time.h>
+
 /**
 * @brief Initilize log mgr.
 *
@@ -35,12 +37,27 @@ int log_mgr_init(void);
 void log_mgr_put(char *module_name, int level, const char *func_name, char *msg);
 
 /**
- * @brief write log to the log file.
+ * @brief read the last lines of a module.
  *
  * @param  module_name 	log mudule name(as the same as process name)
  * @param  count		the count of lines.
- * @param  data			the pointer of data.
+ * @param  data			the pointer of data, LOG_LINE_SIZE bytes per line.
+ *
+ * @return 				the count of lines read.
+ */
+int log_mgr_get(char *module_name, int count, char *data);
+
+/**
+ * @brief read the lines of a module logged in [from, to).
+ *
+ * @param  module_name 	log mudule name(as the same as process name)
+ * @param  from			start time.
+ * @param  to			end time.
+ * @param  count		the max count of lines.
+ * @param  data			the pointer of data, LOG_LINE_SIZE bytes per line.
+ *
+ * @return 				the count of lines read, the oldest first.
  */
-void log_mgr_get(char *module_name, int count, char *data);
+int log_mgr_get_range(char *module_name, time_t from, time_t to, int count, char *data);
 
-#endif
\ No newline at end of file
+#endif
@@ -13,8 +13,10 @@
  */
 
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
 
@@ -24,20 +26,49 @@
 #include "librmmcfg/rmm_cfg.h"
 #include "libutils/dump.h"
 
+/* datagrams read by one recvmmsg, written before the next select */
+#define LOG_EVT_BATCH		32
+
+static struct log_evt evts[LOG_EVT_BATCH];
+static struct mmsghdr msgs[LOG_EVT_BATCH];
+static struct iovec iovs[LOG_EVT_BATCH];
+
+/* the clients send the message up to its end only */
+static void handle_evt(struct log_evt *evt, unsigned int len)
+{
+	unsigned int msg_len;
+
+	if (len <= offsetof(struct log_evt, msg))
+		return;
+
+	msg_len = len - offsetof(struct log_evt, msg);
+	if (msg_len > EVT_MSG_LEN - 1)
+		msg_len = EVT_MSG_LEN - 1;
+	evt->msg[msg_len] = '\0';
+	evt->module_name[EVT_MODULE_LEN - 1] = '\0';
+	evt->fn_name[EVT_FN_LEN - 1] = '\0';
+
+	if (evt->type == EVT_WRITE_LOG)
+		log_mgr_put(evt->module_name, evt->level, evt->fn_name, evt->msg);
+}
+
 int main(int argc, char **argv)
 {
 	int rc;
 	int fd;
+	int i;
 	fd_set fds;
-	socklen_t addrlen;
 	int rmm_logd_port = 0;
 
-	struct sockaddr_in addr;
-	struct log_evt evt;
-
 	printf("RMM log daemon is Running ...\n");
 	enable_core_dump();
-	addrlen = sizeof(addr);
+
+	for (i = 0; i < LOG_EVT_BATCH; i++) {
+		iovs[i].iov_base = &evts[i];
+		iovs[i].iov_len = sizeof(struct log_evt);
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
 
 	rmm_logd_port = rmm_cfg_get_port(LOGD_PORT);
 	if (rmm_logd_port == 0) {
@@ -59,12 +90,12 @@ int main(int argc, char **argv)
 		if (rc < 0)
 			continue;
 
-		rc = recvfrom(fd, &evt, sizeof(struct log_evt), 0, (struct sockaddr *)&addr, &addrlen);
-		if (rc <= 0)
-			continue;
-
-		if (evt.type == EVT_WRITE_LOG)
-			log_mgr_put(evt.module_name, evt.level, evt.fn_name, evt.msg);
+		/* drain the socket, the logs of a burst are read a batch at a time */
+		do {
+			rc = recvmmsg(fd, msgs, LOG_EVT_BATCH, MSG_DONTWAIT, NULL);
+			for (i = 0; i < rc; i++)
+				handle_evt(&evts[i], msgs[i].msg_len);
+		} while (rc == LOG_EVT_BATCH);
 	}
 
 	close(fd);
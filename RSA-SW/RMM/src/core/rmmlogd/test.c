@@ -15,24 +15,32 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <time.h>
 
+#include "libutils/log.h"
 #include "log_manager.h"
 
 int main(int argc, char **argv)
 {
 	int i = 1;
+	int count = 0;
 	char *data;
+	time_t now = time(NULL);
 
 	log_mgr_init();
 
 	for (i = 1; i < 1200; i++)
 		log_mgr_put("memdbd", 1, "call_test", "test log message.........\n");
 
-	data = (char *)malloc(256 * 10);
+	data = (char *)malloc(LOG_LINE_SIZE * 10);
 
-	log_mgr_get("memdbd", 10, data);
-	for (i = 0; i < 10; i++)
-		printf("data: %s", data + 256 * i);
+	count = log_mgr_get("memdbd", 10, data);
+	for (i = 0; i < count; i++)
+		printf("data: %s", data + LOG_LINE_SIZE * i);
+
+	count = log_mgr_get_range("memdbd", now, now + 2, 10, data);
+	for (i = 0; i < count; i++)
+		printf("range: %s", data + LOG_LINE_SIZE * i);
 
 	free(data);
 
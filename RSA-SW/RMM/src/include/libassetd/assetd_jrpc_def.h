@@ -109,6 +109,15 @@
 #define JRPC_ACTION_HARD_RESET				"peripheral_hard_reset"
 #define JRPC_ACTION_POST_PSU				"post_psu_by_node_id"
 
+#define JRPC_COLLECT_ZONES			"zones"
+#define JRPC_COLLECT_ROUNDS			"rounds"
+#define JRPC_COLLECT_SENSORS		"sensors"
+#define JRPC_COLLECT_FAILURES		"failures"
+#define JRPC_COLLECT_LAST_MS		"last_ms"
+#define JRPC_COLLECT_AVG_MS			"avg_ms"
+#define JRPC_COLLECT_MAX_MS			"max_ms"
+#define JRPC_COLLECT_RATE			"sensors_per_sec"
+
 
 
 
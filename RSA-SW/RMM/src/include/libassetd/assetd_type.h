@@ -45,6 +45,7 @@ enum AD_EVT_TYPE {
 	#endif
 	RMM_FACTORY_RESET,
 	UART_SWITCH,
+	COLLECT_ZONE,
 	MAX_EVT
 };
 
@@ -67,7 +68,8 @@ static cmd_map_t am_cmd_map[] = {
 			{GET_TRAY_POWER, "get_tray_power"},
 			#endif
 			{UART_SWITCH, "uart_switch"},
-			{RMM_FACTORY_RESET, "rmm_factory_reset"}
+			{RMM_FACTORY_RESET, "rmm_factory_reset"},
+			{COLLECT_ZONE, "collect_zone"}
 			};
 
 enum MODULE_TYPE {
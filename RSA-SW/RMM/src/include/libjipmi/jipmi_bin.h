@@ -0,0 +1,88 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __LIBJIPMI_JIPMI_BIN_H__
+#define __LIBJIPMI_JIPMI_BIN_H__
+
+#include "libutils/types.h"
+#include "libjipmi/common.h"
+
+/*
+ * Binary transport of the IPMI requests between libjipmi and ipmi_module,
+ * an alternative to JSON-RPC text over UDP. Each message is one datagram
+ * on the unix socket JIPMI_BIN_SOCK, sent from an abstract address the
+ * client binds:
+ *
+ *     request:  struct jipmi_bin_hdr | struct jipmi_bin_target | data
+ *     response: struct jipmi_bin_hdr | data
+ *
+ * with the raw IPMI request and response bytes as data. ipmi_module keeps
+ * JIPMI_BIN_ADDR_MARK followed by the client address as the method of the
+ * request header, and sends the response there.
+ *
+ * A client sends JIPMI_BIN_HELLO first and uses the binary transport only
+ * if ipmi_module answers with the same version; JIPMI_TRANSPORT=json keeps
+ * it on JSON-RPC, e.g. to trace the requests.
+ */
+#define JIPMI_BIN_SOCK			"/var/run/ipmi_module.sock"
+#define JIPMI_BIN_VERSION		1
+#define JIPMI_BIN_ADDR_MARK		'@'
+#define JIPMI_BIN_ADDR_MAX		(JRPC_METHOD_MAX - 2)
+
+enum {
+	JIPMI_BIN_HELLO = 1,
+	JIPMI_BIN_REQ,
+	JIPMI_BIN_RSP
+};
+
+/* the JSON-RPC methods */
+enum {
+	JIPMI_BIN_IPMB = 1,
+	JIPMI_BIN_RMCP,
+	JIPMI_BIN_SERIAL_OP,
+	JIPMI_BIN_SERIAL_CMD,
+	JIPMI_BIN_RMCP_BR
+};
+
+struct jipmi_bin_hdr {
+	uint8 version;
+	uint8 type;
+	uint8 method;
+	uint8 netfn;
+	uint8 cmd;
+	uint8 rsvd;
+	uint16 data_len;
+	int64 id;
+};
+
+struct jipmi_bin_target {
+	uint32 host;				/* network order */
+	uint16 port;				/* host order */
+	uint8 ipmb_sa;
+	uint8 serial_flag;
+	int32 serial_fd;
+	int32 bridge_level;
+	uint32 target_addr;
+	uint32 transit_addr;
+	uint16 target_ch;
+	uint16 transit_ch;
+	int8 name[RMCP_USERNAME_LEN];
+	int8 password[RMCP_PASSWORD_LEN];
+};
+
+#define JIPMI_BIN_MAX_LEN		\
+	(sizeof(struct jipmi_bin_hdr) + sizeof(struct jipmi_bin_target) + IPMI_MAX_MSG_LENGTH)
+
+#endif
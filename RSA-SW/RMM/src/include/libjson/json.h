@@ -74,6 +74,13 @@ typedef struct {
 } json_integer_t;
 
 
+/*
+ * Takes the full buffer 'data' holding 'len' bytes of formatted text, and
+ * returns the buffer to go on with and its size in '*sz' ('data' again
+ * once its text is used up), or NULL to stop formatting.
+ */
+typedef char *(*json_flush_fn)(void *arg, char *data, int len, int *sz);
+
 #define json_to_object(json_)	((json_object_t *)(json_))
 #define json_to_array(json_)	((json_array_t *)(json_))
 #define json_to_string(json_)	((json_string_t *)(json_))
@@ -106,6 +113,13 @@ extern json_t *json_null(void);
 extern json_t *json_parse(char *string);
 extern json_t *json_parse_with_len(char *string, int len);
 extern int     json_format(json_t *json, char *output, int sz);
+/*
+ * Like json_format(), but when 'output' is full it is passed to 'flush'
+ * and formatting goes on in the buffer 'flush' returns, so a JSON of any
+ * size is formatted in buffers of a bounded size. Returns the length of
+ * the text in the last buffer ('\0' terminated), or -1 on failure.
+ */
+extern int     json_format_stream(json_t *json, char *output, int sz, json_flush_fn flush, void *arg);
 extern void    json_print(json_t *json);
 
 
@@ -29,6 +29,7 @@ int assetd_get_fan_pwm_by_id(memdb_integer* cm_node_id, memdb_integer* fan_node_
 int assetd_set_fan_pwm(int64 tzone_idx, int64 fan_idx, int64 pwm);
 int assetd_peripheral_hard_reset(int64 cm_idx, int64 peripheral_id, int32 * result);
 int assetd_rmm_factory_rest(int32 * result);
+int assetd_collect_zone(memdb_integer *node_id);
 
 int assetd_set_id_field(memdb_integer *node_id, int64 field_type, int64 field_instance, int64 byte_num, int32 *data);
 int assetd_get_id_field(memdb_integer *node_id, int64 field_instance);
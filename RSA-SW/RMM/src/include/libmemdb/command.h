@@ -54,6 +54,11 @@ enum {
 	CMD_LOCK,
 	CMD_UNLOCK,
 
+	CMD_ATTRBUTE_GET_MULTI,
+	CMD_ATTRBUTE_SET_MULTI,
+
+	CMD_NODE_FIND_BY_ATTR,
+
 	CMD_MAX
 };
 
@@ -75,7 +80,10 @@ static struct _cmd_st {
 			{CMD_NODE_GET_BY_NODE_ID, "node_get_by_node_id"},
 			{CMD_NODE_CREATE_WITH_NODE_ID, "node_create_with_node_id"},
 			{CMD_LOCK, "lock"},
-			{CMD_UNLOCK, "unlock"} };
+			{CMD_UNLOCK, "unlock"},
+			{CMD_ATTRBUTE_GET_MULTI, "attrbute_get_multi"},
+			{CMD_ATTRBUTE_SET_MULTI, "attrbute_set_multi"},
+			{CMD_NODE_FIND_BY_ATTR, "node_find_by_attr"} };
 
 
 enum {
@@ -185,6 +193,7 @@ struct request_pkg {
 	memdb_integer	db_name;
 	memdb_integer	node_id;
 	lock_id_t		lock_id;
+	int				binary;		/* received on MEMDB_TLV_SOCK */
 
 	jrpc_req_pkg_t jrpc_pkg;
 };
@@ -202,6 +211,7 @@ struct response_pkg {
 
 extern void dispose_command(int fd, struct request_pkg *req, struct sockaddr *addr, socklen_t addrlen);
 extern void process_pending_cmds(void);
+extern void drop_pending_cmds(int fd);
 extern void db_timeout(void);
 
 #endif
@@ -34,6 +34,21 @@ enum event_mode {
 typedef int (*filter_callback)(memdb_integer nodeid);
 
 extern void libdb_init(void);
+extern void libdb_set_binary_transport(int enable);
+
+/*
+ * @@ libdb_set_read_hook installs @@hook for the calling thread, it is
+ * called on every read of memdb until it is reset with NULL. @@node is
+ * the node whose attributes or subnodes are read, LIBDB_READ_NODES when
+ * nodes are listed by type, or LIBDB_READ_ANY when the attributes of
+ * nodes not known in advance are read.
+ */
+#define LIBDB_READ_NODES	((memdb_integer)0)
+#define LIBDB_READ_ANY		((memdb_integer)-1)
+
+typedef void (*libdb_read_hook)(unsigned char db_name, memdb_integer node, void *arg);
+
+extern void libdb_set_read_hook(libdb_read_hook hook, void *arg);
 
 #ifndef LOCK_ID_NULL
 typedef memdb_integer lock_id_t;
@@ -53,6 +68,15 @@ extern memdb_integer libdb_create_node_with_node_id(unsigned char db_name,
 extern struct node_info *libdb_get_node_by_node_id(unsigned char db_name,
 												 memdb_integer node_id, lock_id_t lock_id);
 
+/*
+ * @@ libdb_find_node_by_attr fills @@node with the node whose attribute
+ * @@name is @@data, returns 0 if found. memdbd keeps an index of the
+ * values of some attributes (such as "uuid") to find them in O(1), the
+ * others are searched through all the attributes.
+ */
+extern memdb_integer libdb_find_node_by_attr(unsigned char db_name, char *name, char *data,
+											 struct node_info *node, lock_id_t lock_id);
+
 extern memdb_integer libdb_destroy_node(unsigned char db_name, memdb_integer node, lock_id_t lock_id);
 
 extern struct node_info *libdb_list_subnode(unsigned char db_name,
@@ -117,6 +141,37 @@ extern memdb_integer   libdb_attr_get_string(unsigned char db_name, memdb_intege
 extern void *libdb_list_attrs_by_node(unsigned char db_name, memdb_integer node, int *size, lock_id_t lock_id);
 extern void *libdb_list_attrs_by_cookie(unsigned char db_name, unsigned int cmask, int *size, lock_id_t lock_id);
 
+/*
+ * @@ libdb_attr_get_multi fetches the attributes in @@names (all of them
+ * if @@count is 0) of @@node, and of its descendants if @@subtree is set,
+ * in one round trip. The result is packed as 'struct attr_info' into the
+ * caller's buffer @@attrs; '*size' is the buffer length on input and the
+ * packed length on output. Missing attributes are skipped. It fails if
+ * the reply does not fit in one datagram or in @@attrs.
+ *
+ * @@ libdb_attr_find returns the data of attribute @@name of @@node in a
+ * buffer filled by libdb_attr_get_multi, or NULL if it is not there.
+ *
+ * @@ libdb_attr_set_multi stores @@count string attributes of @@node in
+ * one round trip. An entry with a non zero @@node is stored in that node
+ * instead, so the attributes of several nodes go in one write. No entry
+ * is stored if one of them is invalid or its node does not exist.
+ */
+struct attr_set_entry {
+	char *name;
+	char *data;
+	unsigned int cookie;
+	memdb_integer node;
+};
+
+extern memdb_integer libdb_attr_get_multi(unsigned char db_name, memdb_integer node,
+										  char **names, int count, int subtree,
+										  void *attrs, int *size, lock_id_t lock_id);
+extern char *libdb_attr_find(void *attrs, int size, memdb_integer node, char *name);
+extern memdb_integer libdb_attr_set_multi(unsigned char db_name, memdb_integer node,
+										  struct attr_set_entry *entries, int count,
+										  unsigned char snapshot_flag, lock_id_t lock_id);
+
 
 extern int  libdb_init_subscription(enum event_mode mode,
 									void (*callback)(struct event_info *, void*),
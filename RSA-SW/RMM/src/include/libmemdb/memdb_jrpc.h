@@ -19,5 +19,7 @@
 #include "libmemdb/command.h"
 
 extern int memdb_parse_req(char *string, struct request_pkg *req);
+extern int memdb_tlv_parse_req(char *data, int len, struct request_pkg *req);
+extern int memdb_tlv_send_rsp(int fd, int type, int cmd, int64 id, int64 code, json_t *result);
 
 #endif
@@ -0,0 +1,108 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __LIBMEMDB_MEMDB_SHM_H__
+#define __LIBMEMDB_MEMDB_SHM_H__
+
+#include "libmemdb/node.h"
+#include "libutils/types.h"
+
+/*
+ * Read-only snapshot of the memdb nodes and attributes, published by
+ * memdbd in a shared memory segment so that clients can serve reads
+ * without a round trip to the daemon. Writes still go through memdbd.
+ *
+ * The segment holds two buffers. memdbd rebuilds the inactive one and
+ * then makes it active; every buffer is guarded by its own sequence
+ * counter (odd while being written), so a reader retries or falls back
+ * to the socket if the buffer changed under it.
+ *
+ * 'write_gen' is bumped by memdbd before it replies to any request that
+ * changes the database, and a buffer records the 'write_gen' it was
+ * built from. A reader only trusts a buffer whose 'gen' equals the
+ * current 'write_gen', so a client always reads its own writes.
+ */
+#define MEMDB_SHM_NAME			"/memdb_snapshot"
+#define MEMDB_SHM_MAGIC			0x4d444253	/* "MDBS" */
+#define MEMDB_SHM_BUF_SIZE		(4 << 20)	/* 4MB per buffer */
+
+/* Minimum interval between two snapshots while memdb keeps changing. */
+#define MEMDB_SHM_PUBLISH_MS	10
+
+#define MEMDB_SHM_ALIGN(s)		(((s) + 7) & ~7)
+
+struct memdb_shm_node {
+	memdb_integer node_id;
+	memdb_integer parent;
+	memdb_integer type;
+	memdb_integer snapshot_flag;
+
+	unsigned int attr_off;		/* first 'struct memdb_shm_attr' */
+	unsigned int attr_num;
+	unsigned int child_off;		/* array of children node ids */
+	unsigned int child_num;
+};
+
+struct memdb_shm_attr {
+	memdb_integer cookie;
+
+	unsigned int next_offset;	/* size of memdb_shm_attr + name + data + pad */
+	unsigned short namelen;		/* including '\0' */
+	unsigned short datalen;		/* including '\0' */
+
+	char elems[0];				/* name, then data */
+};
+
+struct memdb_shm_buf {
+	volatile unsigned int seq;
+	unsigned int used;
+	volatile unsigned long gen;
+
+	/* array of 'struct memdb_shm_node' sorted by node id, per db */
+	unsigned int node_off[DB_MAX];
+	unsigned int node_num[DB_MAX];
+
+	char data[MEMDB_SHM_BUF_SIZE];
+};
+
+struct memdb_shm_hdr {
+	unsigned int magic;
+	unsigned int buf_size;
+
+	volatile unsigned long write_gen;
+	volatile int locked;		/* memdb is locked by a client */
+	volatile int active;		/* index of the readable buffer, -1 if none */
+
+	struct memdb_shm_buf buf[2];
+};
+
+#define MEMDB_SHM_SIZE			sizeof(struct memdb_shm_hdr)
+
+/*
+ * Client side readers, used by libdb for requests without a lock id.
+ * They return -1 when the snapshot can not be used and the request
+ * has to go to memdbd, otherwise the MEMDB_* code memdbd would reply.
+ */
+extern int memdb_shm_attr_get(unsigned char db_name, memdb_integer node,
+							  char *name, char *output, int len);
+extern int memdb_shm_get_node(unsigned char db_name, memdb_integer node,
+							  struct node_info *info);
+extern int memdb_shm_list_subnode(unsigned char db_name, memdb_integer node,
+								  int type_match, memdb_integer type_value,
+								  struct node_info *infos, int max, int *nodenum);
+extern int memdb_shm_list_attrs(unsigned char db_name, memdb_integer node,
+								void *attrs, int max, int *size);
+
+#endif
@@ -0,0 +1,71 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __LIBMEMDB_MEMDB_TLV_H__
+#define __LIBMEMDB_MEMDB_TLV_H__
+
+#include "libutils/types.h"
+#include "libjson/json.h"
+
+/*
+ * Binary transport for memdb commands, an alternative to JSON-RPC text
+ * over UDP. Each message is one SOCK_SEQPACKET packet on the unix socket
+ * MEMDB_TLV_SOCK: a 'struct memdb_tlv_hdr' followed by the parameters
+ * (requests) or the result members (replies), every one encoded as
+ *
+ *     u8 json_type | u8 namelen | name | value
+ *
+ * where the value of JSON_INTEGER/JSON_REAL is 8 bytes, of JSON_STRING a
+ * u32 length and the bytes, of JSON_OBJECT/JSON_ARRAY a u32 count and
+ * the members (array elements have no name), and is empty otherwise.
+ *
+ * A client opens the socket, sends MEMDB_TLV_HELLO and uses the binary
+ * transport only if memdbd answers with the same version.
+ */
+#define MEMDB_TLV_SOCK			"/var/memdb/memdb_tlv.sock"
+#define MEMDB_TLV_VERSION		1
+#define MEMDB_TLV_MAX_LEN		JSONRPC_MAX_STRING_LEN
+
+enum {
+	MEMDB_TLV_HELLO = 1,
+	MEMDB_TLV_REQ,
+	MEMDB_TLV_RSP,
+	MEMDB_TLV_ERR
+};
+
+struct memdb_tlv_hdr {
+	uint8 version;
+	uint8 type;
+	uint16 cmd;
+	int32 code;				/* JSON-RPC error code of MEMDB_TLV_ERR */
+	int64 id;
+	int64 db_name;
+	int64 node_id;
+	int64 lock_id;
+};
+
+struct memdb_tlv_buf {
+	char *data;
+	int len;
+	int size;
+};
+
+extern int memdb_tlv_put_int(struct memdb_tlv_buf *buf, char *name, int64 value);
+extern int memdb_tlv_put_string(struct memdb_tlv_buf *buf, char *name, char *value);
+extern int memdb_tlv_put_json(struct memdb_tlv_buf *buf, char *name, json_t *value);
+extern int memdb_tlv_put_members(struct memdb_tlv_buf *buf, json_t *object);
+extern json_t *memdb_tlv_get_object(char *data, int len);
+
+#endif
@@ -73,6 +73,8 @@ static inline void *attr_data(struct attr_info *i)
 
 /***********************************************************************************/
 
+#define NODE_ATTR_HASH_SIZE		16
+
 struct node {
 	memdb_integer node_id;
 
@@ -88,11 +90,16 @@ struct node {
 	struct list_head attrs;		/* list with node_attr's group */
 	struct list_head children;	/* list of my children */
 	struct list_head sibling;	/* linkage in my parent's children list */
+	struct list_head hash;		/* linkage in node id hash bucket */
+	struct list_head attr_hash[NODE_ATTR_HASH_SIZE];	/* node_attr's hash buckets */
 };
 
 struct node_attr {
 	struct list_head group;	/* linkage in node's attrs list */
 	struct list_head list;  /* linkage in global search list */
+	struct list_head hash;	/* linkage in node's attr hash bucket */
+	struct list_head index;	/* linkage in the value index, if the name is indexed */
+	unsigned int name_hash;
 
 	struct node *node;
 
@@ -153,6 +160,8 @@ extern void dump_all_subscribes(memdb_integer db_name);
 
 extern struct node *find_node_by_node_id(memdb_integer db_name,
 									  memdb_integer node_id);
+extern struct node *find_node_by_attr(memdb_integer db_name, char *name,
+									  unsigned char *data, unsigned short datalen);
 
 extern int set_node_attr(memdb_integer db_name, struct node *node,
 						 memdb_integer cookie,
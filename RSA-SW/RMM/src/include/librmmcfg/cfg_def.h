@@ -31,6 +31,7 @@
 #define PROC_SENSORD			"sensord"
 #define PROC_RMM_KEEPERD		"rmm_keeperd"
 #define PROC_AUTO_TEST			"auto_test"
+#define PROC_COOLING_CTRL		"cooling_ctrl"
 
 #define ATTR_VM_HEADER			"vm" 
 #define ATTR_VM_ROOT_PASSWORD	"root_password"
@@ -47,6 +48,17 @@
 #define ATTR_KEEPER_DDB_PORT	"KeeperDdbPort"
 #define ATTR_SNAPSHOT_SYNC_PORT	"SnapshotSyncPort"
 #define ATTR_REST_PREFIX     	"restful_prefix"
+#define ATTR_COLLECT_INTERVAL	"CollectInterval"
+#define ATTR_COOLING_PERIOD		"SamplePeriodMs"
+#define ATTR_COOLING_TARGET		"TargetTemp"
+#define ATTR_COOLING_AGGREGATION	"Aggregation"
+#define ATTR_COOLING_KP			"PidKp"
+#define ATTR_COOLING_KI			"PidKi"
+#define ATTR_COOLING_KD			"PidKd"
+#define ATTR_COOLING_RATE		"PwmRate"
+#define ATTR_EVENT_QUEUE_LEN	"EventQueueLen"
+#define ATTR_EVENT_BATCH		"EventBatch"
+#define ATTR_EVENT_RETRY_MAX	"EventRetryMax"
 
 #define ATTR_RACK_PLATFORM		"Platform"
 #define ATTR_RACK_PLATFORM_BDCA	"BDC-A"
@@ -57,6 +69,9 @@
 #define ATTR_IPMID_SERIAL_STOPBITS 		"SerialStopBits"
 #define ATTR_IPMID_SERIAL_PARITY 		"SerialParity"
 #define ATTR_IPMID_SERIAL_FLOWCONTROL 	"SerialFlowControl"
+#define ATTR_IPMID_SERIAL_FRAMING 		"SerialFraming"
+#define ATTR_IPMID_SERIAL_WINDOW 		"SerialWindow"
+#define ATTR_IPMID_IPMB_WINDOW 			"IpmbWindow"
 
 #define ATTR_IPMI_RMCP_CLIENT_PORT 		"RmcpClientPort"
 #define ATTR_IPMI_IPMB_UDP_PORT 		"IpmbPort"
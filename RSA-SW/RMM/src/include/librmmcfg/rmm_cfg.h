@@ -88,6 +88,18 @@ unsigned char rmm_cfg_get_databits(void);
 unsigned char rmm_cfg_get_stopbits(void);
 unsigned char rmm_cfg_get_parity(void);
 unsigned char rmm_cfg_get_flow_control(void);
+int rmm_cfg_get_serial_framing(char *framing, int max_len);
+int rmm_cfg_get_serial_window(void);
+int rmm_cfg_get_ipmb_window(void);
+int rmm_cfg_get_collect_interval(void);
+int rmm_cfg_get_cooling_period(void);
+int rmm_cfg_get_cooling_target(void);
+int rmm_cfg_get_cooling_aggregation(char *agg, int max_len);
+int rmm_cfg_get_cooling_pid(int *kp, int *ki, int *kd);
+int rmm_cfg_get_cooling_rate(void);
+int rmm_cfg_get_event_queue_len(void);
+int rmm_cfg_get_event_batch(void);
+int rmm_cfg_get_event_retry_max(void);
 
 int rmm_cfg_get_rmcp_username(char *username, int max_len);
 int rmm_cfg_get_rmcp_password(char *password, int max_len);
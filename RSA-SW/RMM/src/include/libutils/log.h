@@ -47,22 +47,61 @@ static char *log_severity[5] = {EVT_SEVERITY_CRITICAL,
 								EVT_SEVERITY_INFO,
 								EVT_SEVERITY_DBG};
 
+/*
+ * The log of a module is a ring of fixed size records in a file mapped in
+ * memory, /var/log/<module>/logring. A record holds the formatted line and
+ * its time, the record of sequence number 'seq' is at slot seq % capacity,
+ * so the last lines and the lines of a time range are found without
+ * reading the file.
+ */
+#define LOG_RING_MAGIC			0x474c4d52		/* "RMLG" */
+#define LOG_RING_VERSION		1
+#define LOG_RING_HDR_SIZE		4096
+#define LOG_RECORD_SIZE			512
+#define LOG_LINE_SIZE			256				/* a line returned by log_get */
+#define LOG_DFLT_MAX_LINES		10000
+
+struct log_ring_hdr {
+	unsigned int magic;
+	unsigned int version;
+	unsigned int record_size;
+	unsigned int capacity;
+	unsigned long long next_seq;	/* the first record is 1 */
+};
+
+struct log_record {
+	unsigned long long seq;			/* 0 while the record is written */
+	long long ts_us;				/* wall clock, us */
+	int level;
+	int len;
+	char text[LOG_RECORD_SIZE - 24];
+};
+
 struct loginfo {
 	char module[MAX_PATH_SIZE];
-	char logfile_curr[MAX_PATH_SIZE];
-	char logfile_tmp[MAX_PATH_SIZE];
-	char logfile_old[MAX_PATH_SIZE];
+	char logfile[MAX_PATH_SIZE];
 	int  level;
 	int  max_lines;
-	int  fd;
-	unsigned int curr_index;
+	struct log_ring_hdr *ring;
+	size_t ring_size;
 };
 
 long log_init(const char *module_name);
 void log_set_level(long hander, int level);
 void log_set_max_lines(long handler, int max_lines);
-void log_put(long handler, const int level, const const char *func, const char *msg);
+void log_put(long handler, const int level, const char *func, const char *msg);
+
+/**
+ * @brief: copy the last 'last_count' lines, oldest first, to 'data', one
+ * line every LOG_LINE_SIZE bytes. Return the number of lines.
+ */
 int log_get(long handler, int last_count, char *data);
 
+/**
+ * @brief: copy at most 'max_count' lines logged in [from, to), oldest
+ * first, like log_get. Return the number of lines.
+ */
+int log_get_range(long handler, time_t from, time_t to, int max_count, char *data);
+
 void log_close(long handler);
 #endif
@@ -551,6 +551,10 @@ typedef struct {
 	char *data;			/* pointer to write from */
 	int   data_avail;	/* bytes available in data buffer */
 	char *buff;			/* start of data buffer */
+	int   size;			/* size of data buffer */
+
+	json_flush_fn flush;	/* takes the data buffer when it is full */
+	void *arg;
 } strbuff_t;
 
 static char *strbuf_alloc(strbuff_t *strbuf, int size)
@@ -569,17 +573,49 @@ static void strbuf_init(strbuff_t *strbuf, char *buf, int sz)
 {
 	strbuf->buff = buf;
 	strbuf->data = buf;
+	strbuf->size = sz;
 	strbuf->data_avail = sz - 1; /* Reserve one for '\0' */
+	strbuf->flush = NULL;
+	strbuf->arg = NULL;
 }
 
-static int strbuf_append(strbuff_t *strbuf, char *str, int len)
+static int strbuf_flush(strbuff_t *strbuf)
 {
-	char *ptr;
+	char *buf;
+	int sz = 0;
+
+	if (strbuf->flush == NULL)
+		return 0;
 
-	ptr = strbuf_alloc(strbuf, len);
-	if (ptr == NULL)
+	buf = strbuf->flush(strbuf->arg, strbuf->buff, strbuf->data - strbuf->buff, &sz);
+	if (buf == NULL || sz < 2)
 		return 0;
 
+	strbuf->buff = buf;
+	strbuf->data = buf;
+	strbuf->size = sz;
+	strbuf->data_avail = sz - 1;
+	return 1;
+}
+
+static int strbuf_append(strbuff_t *strbuf, char *str, int len)
+{
+	char *ptr;
+	int part;
+
+	while ((ptr = strbuf_alloc(strbuf, len)) == NULL) {
+		/* fill up the buffer, the rest goes to the next one */
+		part = strbuf->data_avail;
+		memcpy(strbuf->data, str, part);
+		strbuf->data += part;
+		strbuf->data_avail = 0;
+		str += part;
+		len -= part;
+
+		if (!strbuf_flush(strbuf))
+			return 0;
+	}
+
 	memcpy(ptr, str, len);
 	return 1;
 }
@@ -752,6 +788,26 @@ int json_format(json_t *json, char *output, int sz)
 	return strbuf.data - strbuf.buff;
 }
 
+int json_format_stream(json_t *json, char *output, int sz, json_flush_fn flush, void *arg)
+{
+	strbuff_t strbuf;
+
+	if ((sz < 3) || (flush == NULL) ||
+		(json->type != JSON_OBJECT && json->type != JSON_ARRAY))
+		return -1;
+
+	strbuf_init(&strbuf, output, sz);
+	strbuf.flush = flush;
+	strbuf.arg = arg;
+
+	if (!do_format(json, &strbuf))
+		return -1;
+
+	strbuf_finish(&strbuf);
+
+	return strbuf.data - strbuf.buff;
+}
+
 void json_print(json_t *json)
 {
 	switch (json->type) {
@@ -59,6 +59,15 @@ int assetd_rmm_factory_rest(int32 * result)
 	return *result;
 }
 
+int assetd_collect_zone(memdb_integer *node_id)
+{
+	jrpc_req_pkg_t req_pkg = {};
+
+	fill_param(&req_pkg, JRPC_NODE_ID, node_id, JSON_INTEGER);
+
+	return send_msg_to_assetd(&req_pkg, COLLECT_ZONE);
+}
+
 /*
 int assetd_post_psu_by_node_id(int64 pzone_idx, int64 psu_idx, int64 request_enabled_state)
 {
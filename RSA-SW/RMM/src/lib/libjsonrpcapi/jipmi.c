@@ -17,6 +17,9 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
+#include <sys/un.h>
+#include <sys/uio.h>
+#include <stddef.h>
 #include <unistd.h>
 #include <pthread.h>
 #include <errno.h>
@@ -30,6 +33,7 @@
 #include "libutils/rmm.h"
 #include "libjipmi/libjipmi.h"
 #include "libjipmi/jrpc_ipmi.h"
+#include "libjipmi/jipmi_bin.h"
 #include "libutils/sock.h"
 #include "libjson/json.h"
 #include "libjsonrpc/jsonrpc.h"
@@ -37,9 +41,14 @@
 #include "librmmcfg/rmm_cfg.h"
 
 #define MAX_RPC_LEN     20
+#define RSP_HNDL_HASH_SIZE	256	/* power of 2 */
+
+/* sendmsg() failed, the request goes on JSON RPC */
+#define JIPMI_BIN_NOT_SENT	1
 
 struct jipmi_rsp_hndl {
 	struct list_head list;
+	struct list_head hash;	/* in the bucket of jrpc_id */
 
 	unsigned int timeout;
 	int          broadcast;
@@ -54,39 +63,108 @@ static int async_jipmi_fd = -1;
 static int sync_jipmi_fd = -1;
 static unsigned short user_port;
 
+/* binary transport, see libjipmi/jipmi_bin.h */
+static int async_bin_fd = -1;
+static int sync_bin_fd = -1;
+static int bin_ready;
+static time_t bin_last_try;
+static pthread_mutex_t bin_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static struct list_head rsp_hndl_head = LIST_HEAD_INIT(rsp_hndl_head);
+static struct list_head rsp_hndl_hash[RSP_HNDL_HASH_SIZE];
 static struct list_head req_hndl_head = LIST_HEAD_INIT(req_hndl_head);
 
 static pthread_mutex_t libjipmi_lock = PTHREAD_MUTEX_INITIALIZER;
 
 
+static inline struct list_head *rsp_hndl_bucket(unsigned int jrpc_id)
+{
+	return &rsp_hndl_hash[jrpc_id & (RSP_HNDL_HASH_SIZE - 1)];
+}
+
+static struct jipmi_rsp_hndl *find_resp_hndl(unsigned int jrpc_id)
+{
+	struct jipmi_rsp_hndl *hndl;
+
+	list_for_each_entry(hndl, rsp_hndl_bucket(jrpc_id), hash) {
+		if (hndl->jrpc_id == jrpc_id)
+			return hndl;
+	}
+
+	return NULL;
+}
+
 static int64 gen_req_jrpc_id(void)
 {
 	static unsigned int jrpc_id;
-	struct jipmi_rsp_hndl *hndl;
 
-again:
-	if (++jrpc_id == 0)
-		jrpc_id = 1;
+	do {
+		if (++jrpc_id == 0)
+			jrpc_id = 1;
+	} while (find_resp_hndl(jrpc_id) != NULL);
 
-	list_for_each_entry(hndl, &rsp_hndl_head, list) {
-		if (hndl->jrpc_id == jrpc_id)
-			goto again;
+	return jrpc_id;
+}
+
+static void add_resp_hndl(struct jipmi_rsp_hndl *hndl)
+{
+	list_add_tail(&hndl->list, &rsp_hndl_head);
+	list_add_tail(&hndl->hash, rsp_hndl_bucket(hndl->jrpc_id));
+}
+
+static void del_resp_hndl(struct jipmi_rsp_hndl *hndl)
+{
+	list_del(&hndl->list);
+	list_del(&hndl->hash);
+}
+
+/**
+ * @brief: Call the handler of the response 'jrpc_id', whichever transport
+ *         it came on.
+ */
+static int dispatch_jipmi_rsp(int jrpc_id, int ret, unsigned char *rsp_data, int data_len)
+{
+	struct jipmi_rsp_hndl *hndl = NULL;
+	jipmi_rsp_callback_fn rsp_cb_fn;
+	void                *rsp_cb_arg = NULL;
+
+	pthread_mutex_lock(&libjipmi_lock);
+	hndl = find_resp_hndl(jrpc_id);
+	if (hndl == NULL) {
+		pthread_mutex_unlock(&libjipmi_lock);
+		IPMI_DEBUG("jipmi: No handle for this IPMI response!\n");
+		return -1;
+	}
+	rsp_cb_fn  = hndl->cb_fn;
+	rsp_cb_arg = hndl->cb_arg;
+
+	if (!hndl->broadcast) {
+		del_resp_hndl(hndl);
 	}
+	else
+		hndl = NULL; /* Free until timeout for broadcast */
+
+	pthread_mutex_unlock(&libjipmi_lock);
+
+	rsp_cb_fn(ret, rsp_data, data_len, rsp_cb_arg);
+
+	if (hndl != NULL)
+		free(hndl);
 
 	return jrpc_id;
 }
 
-static struct jipmi_rsp_hndl *find_resp_hndl(unsigned int jrpc_id)
+static int handle_jipmi_bin_msg(unsigned char *msg, int len)
 {
-	struct jipmi_rsp_hndl *hndl;
+	struct jipmi_bin_hdr *hdr = (struct jipmi_bin_hdr *)msg;
 
-	list_for_each_entry(hndl, &rsp_hndl_head, list) {
-		if (hndl->jrpc_id == jrpc_id)
-			return hndl;
+	if (len < (int)sizeof(*hdr) || hdr->version != JIPMI_BIN_VERSION ||
+		hdr->type != JIPMI_BIN_RSP || len != (int)sizeof(*hdr) + hdr->data_len) {
+		IPMI_DEBUG("jipmi: invalid binary response!\n");
+		return -1;
 	}
 
-	return NULL;
+	return dispatch_jipmi_rsp((int)hdr->id, 0, (unsigned char *)(hdr + 1), hdr->data_len);
 }
 
 static int handle_jipmi_msg(char *msg)
@@ -95,14 +173,10 @@ static int handle_jipmi_msg(char *msg)
 	json_t *result = NULL;
 	int ret = 0;
 	int jrpc_id = 0;
-	int netfn, cmd = 0;
 	int64 err_code = 0;
 	unsigned char *rsp_data = NULL;
 	char* origin_data = NULL;
 	int  data_len = 0;
-	struct jipmi_rsp_hndl *hndl = NULL;
-	jipmi_rsp_callback_fn rsp_cb_fn;
-	void                *rsp_cb_arg = NULL;
 	
 	rsp = json_parse(msg);
 
@@ -143,32 +217,9 @@ static int handle_jipmi_msg(char *msg)
 	}
 
 	jrpc_id = json_integer_value(json_object_get(rsp, STR_JRPC_ID));
-	
-	pthread_mutex_lock(&libjipmi_lock);
-	hndl = find_resp_hndl(jrpc_id);
-	if (hndl == NULL) {
-		pthread_mutex_unlock(&libjipmi_lock);
-		IPMI_DEBUG("jipmi: No handle for this IPMI response!\n");
-		jrpc_id = -1;
-		goto end;
-	}
-	rsp_cb_fn  = hndl->cb_fn;
-	rsp_cb_arg = hndl->cb_arg;
-
-	if (!hndl->broadcast) {
-		list_del(&hndl->list);
-	}
-	else
-		hndl = NULL; /* Free until timeout for broadcast */
-
-	pthread_mutex_unlock(&libjipmi_lock);
-
-	rsp_cb_fn(ret, rsp_data, data_len, rsp_cb_arg);
+	jrpc_id = dispatch_jipmi_rsp(jrpc_id, ret, rsp_data, data_len);
 
 end:
-	if (hndl != NULL)
-		free(hndl);
-
 	if (rsp_data)
 		free(rsp_data);
 
@@ -181,15 +232,72 @@ end:
 
 
 
-static int send_jmsg_to_ipmid(char *msg, int msg_id, unsigned int timeout, sync_mode_t mode, bool bridge_level)
+/**
+ * @brief: Wait on 'fd' for the response of a sync mode request, JSON RPC or
+ *         binary as 'bin' says.
+ */
+static int wait_sync_rsp(int fd, int bin, int msg_id, unsigned int timeout, bool bridge_level)
 {
-	struct sockaddr_in dest;
-	int port;
+	char rsp_string[IPMI_JSONRPC_MAX_MSG_LEN] = {0};
 	struct timeval timeo;
 	int rc, rc_id, retries = 2;	/* only allow 2 retries */
 	fd_set fds;
 	int bridge_cnt = 1;
 
+	for (;;) {
+		if (--retries < 0)
+			break;
+		
+		FD_ZERO(&fds);
+		FD_SET(fd, &fds);
+
+		if(timeout > IPMI_MAX_SYNC_TIMEOUT_MS) {
+			timeo.tv_sec = IPMI_MAX_SYNC_TIMEOUT_MS/1000;
+			timeo.tv_usec = (IPMI_MAX_SYNC_TIMEOUT_MS%1000)*1000;
+		}
+		else {
+			timeo.tv_sec = timeout/1000;
+			timeo.tv_usec = (timeout%1000)*1000;
+		}
+
+		rc = select(fd + 1, &fds, NULL, NULL, &timeo);
+		if (rc < 0) 
+			break;
+		
+		rc = recv(fd, rsp_string, sizeof(rsp_string) - 1, 0);
+
+		if (rc <= 0)
+			break;
+
+		if (bin)
+			rc_id = handle_jipmi_bin_msg((unsigned char *)rsp_string, rc);
+		else {
+			rsp_string[rc] = '\0';
+			rc_id = handle_jipmi_msg(rsp_string);
+		}
+		
+		if (rc_id != msg_id) {
+			printf("received rc_id %d, expect %d.\n", rc_id, msg_id);
+			continue;
+		}
+		else {
+			if (bridge_level && bridge_cnt) {
+				bridge_cnt --;
+				continue;;
+			}
+			return 0;
+		}
+	}
+
+	printf("sync mode command process fail!");
+	return -1;
+}
+
+static int send_jmsg_to_ipmid(char *msg, int msg_id, unsigned int timeout, sync_mode_t mode, bool bridge_level)
+{
+	struct sockaddr_in dest;
+	int port;
+
 	port = rmm_cfg_get_port(IPMIJSONRPC_SERVER_PORT);
 	if (port == 0) {
 		printf("Failed to call rmm_cfg_get_ipmi_json_rpc_server_port!\n");
@@ -209,57 +317,124 @@ static int send_jmsg_to_ipmid(char *msg, int msg_id, unsigned int timeout, sync_
 
 		return 0;
 	} else {
-		char rsp_string[IPMI_JSONRPC_MAX_MSG_LEN] = {0};
-
 		sendto(sync_jipmi_fd, msg, IPMI_JSONRPC_MAX_MSG_LEN, 0, (struct sockaddr *)&dest, sizeof(dest));
-		
-		for (;;) {
-			if (--retries < 0)
-				break;
-			
-			FD_ZERO(&fds);
-			FD_SET(sync_jipmi_fd, &fds);
 
-			if(timeout > IPMI_MAX_SYNC_TIMEOUT_MS) {
-				timeo.tv_sec = IPMI_MAX_SYNC_TIMEOUT_MS/1000;
-				timeo.tv_usec = (IPMI_MAX_SYNC_TIMEOUT_MS%1000)*1000;
-			}
-			else {
-				timeo.tv_sec = timeout/1000;
-				timeo.tv_usec = (timeout%1000)*1000;
-			}
+		return wait_sync_rsp(sync_jipmi_fd, 0, msg_id, timeout, bridge_level);
+	}
 
-			rc = select(sync_jipmi_fd + 1, &fds, NULL, NULL, &timeo);
-			if (rc < 0) 
-				break;
-			
-			rc = recv(sync_jipmi_fd, rsp_string, sizeof(rsp_string), 0);
+	return 0;
+}
 
-			if (rc <= 0)
-				break;
+/**
+ * @brief: Check that ipmi_module takes binary requests, at most once a
+ *         second while it does not, e.g. until it is started.
+ */
+static int jipmi_bin_connect(void)
+{
+	struct sockaddr_un addr;
+	struct jipmi_bin_hdr hdr;
+	struct timeval timeo = {0, 50 * 1000};
+	fd_set fds;
+	time_t now;
+	int rc = -1;
 
-			rsp_string[rc] = '\0';
+	if (bin_ready)
+		return 0;
+	if (async_bin_fd == -1 || sync_bin_fd == -1)
+		return -1;
 
-			rc_id = handle_jipmi_msg(rsp_string);
-			
-			if (rc_id != msg_id) {
-				printf("received rc_id %d, expect %d.\n", rc_id, msg_id);
-				continue;
-			}
-			else {
-				if (bridge_level && bridge_cnt) {
-					bridge_cnt --;
-					continue;;
-				}
-				return 0;
-			}
-		}
+	pthread_mutex_lock(&bin_lock);
 
-		printf("sync mode command process fail!");
-		return -1;
+	now = time(NULL);
+	if (bin_ready || now == bin_last_try)
+		goto end;
+	bin_last_try = now;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, JIPMI_BIN_SOCK, sizeof(addr.sun_path) - 1);
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.version = JIPMI_BIN_VERSION;
+	hdr.type = JIPMI_BIN_HELLO;
+
+	/* connect again, ipmi_module may have been restarted */
+	if (connect(async_bin_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+		connect(sync_bin_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+		send(sync_bin_fd, &hdr, sizeof(hdr), 0) != sizeof(hdr))
+		goto end;
+
+	/* do not wait long for an ipmi_module without the binary transport */
+	FD_ZERO(&fds);
+	FD_SET(sync_bin_fd, &fds);
+	if (select(sync_bin_fd + 1, &fds, NULL, NULL, &timeo) <= 0 ||
+		recv(sync_bin_fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+		hdr.version != JIPMI_BIN_VERSION || hdr.type != JIPMI_BIN_HELLO)
+		goto end;
+
+	bin_ready = 1;
+	rc = 0;
+
+end:
+	pthread_mutex_unlock(&bin_lock);
+	return rc;
+}
+
+static void jipmi_bin_set_base_info(struct jipmi_bin_hdr *hdr, struct jipmi_bin_target *target,
+									int method, int64 jrpc_id, jipmi_msg_t *req)
+{
+	int data_len = atoi(req->data_len);
+
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->version = JIPMI_BIN_VERSION;
+	hdr->type = JIPMI_BIN_REQ;
+	hdr->method = method;
+	hdr->netfn = atoi(req->netfn);
+	hdr->cmd = atoi(req->cmd);
+	hdr->data_len = (data_len > 0 && data_len <= IPMI_MAX_DATA_LENGTH) ? data_len : 0;
+	hdr->id = jrpc_id;
+
+	/*
+	 * name and password are fixed width fields, not terminated when full;
+	 * ipmi_bin.c copies them to terminated buffers.
+	 */
+	memset(target, 0, sizeof(*target));
+	memcpy(target->name, req->name, strnlen(req->name, sizeof(target->name)));
+	memcpy(target->password, req->password, strnlen(req->password, sizeof(target->password)));
+}
+
+/**
+ * @brief: Send a binary request, the header, the target and the raw data in
+ *         one datagram without copy.
+ */
+static int send_bmsg_to_ipmid(struct jipmi_bin_hdr *hdr, struct jipmi_bin_target *target, char *data,
+							  unsigned int timeout, sync_mode_t mode, bool bridge_level)
+{
+	struct iovec iov[3];
+	struct msghdr mh;
+	int fd = (mode == JIPMI_NON_SYNC) ? async_bin_fd : sync_bin_fd;
+
+	iov[0].iov_base = hdr;
+	iov[0].iov_len = sizeof(*hdr);
+	iov[1].iov_base = target;
+	iov[1].iov_len = sizeof(*target);
+	iov[2].iov_base = data;
+	iov[2].iov_len = hdr->data_len;
+
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = iov;
+	mh.msg_iovlen = 3;
+
+	if (sendmsg(fd, &mh, 0) < 0) {
+		/* ipmi_module is gone, check it again before the next request */
+		bin_ready = 0;
+		return JIPMI_BIN_NOT_SENT;
 	}
 
-	return 0;
+	if (mode == JIPMI_NON_SYNC)
+		return 0;
+
+	return wait_sync_rsp(fd, 1, hdr->id, timeout, bridge_level);
 }
 
 
@@ -292,7 +467,7 @@ static void *libjipmi_time_thread(void *unused)
 			if (hndl->timeout > 0)
 				continue;
 
-			list_del(&hndl->list);
+			del_resp_hndl(hndl);
 			list_add_tail(&hndl->list, &timeout);
 		}
 		pthread_mutex_unlock(&libjipmi_lock);
@@ -308,13 +483,40 @@ static void *libjipmi_time_thread(void *unused)
 	return NULL;
 }
 
+static int jipmi_bin_socket(int flags, char mode)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | flags, 0);
+	if (fd < 0)
+		return -1;
+
+	/* ipmi_module sends the responses to this abstract address */
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	snprintf(addr.sun_path + 1, sizeof(addr.sun_path) - 1, "jipmi.%d.%c", getpid(), mode);
+
+	if (bind(fd, (struct sockaddr *)&addr,
+			 offsetof(struct sockaddr_un, sun_path) + 1 + strlen(addr.sun_path + 1)) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
 int libjipmi_init(unsigned short async_listen_port)
 {
 	int fd;
-	int rc, val;
+	int i;
 	int jipmi_port;
+	char *env;
 	pthread_t tid;
 
+	for (i = 0; i < RSP_HNDL_HASH_SIZE; i++)
+		INIT_LIST_HEAD(&rsp_hndl_hash[i]);
+
 	/* create async mode fd */
 	fd = create_udp_listen(INADDR_LOOPBACK, async_listen_port, 0, 1);
 	if(fd == -1)
@@ -341,6 +543,14 @@ int libjipmi_init(unsigned short async_listen_port)
 		return -1;
 	}
 
+	/* JSON RPC only, e.g. to trace the requests */
+	env = getenv("JIPMI_TRANSPORT");
+	if (env == NULL || strcmp(env, "json") != 0) {
+		async_bin_fd = jipmi_bin_socket(SOCK_NONBLOCK, 'a');
+		sync_bin_fd = jipmi_bin_socket(0, 's');
+		jipmi_bin_connect();
+	}
+
 	fprintf(stderr, "LibIPMI init is OK, listen on port:%u. nonsync mode enabled.\n", async_listen_port);
 	
 	return 1;
@@ -356,6 +566,12 @@ void libjipmi_callback_selectfds(fd_set *rfds, int *max_fd)
 	FD_SET(async_jipmi_fd, rfds);
 	if (async_jipmi_fd > *max_fd)
 		*max_fd = async_jipmi_fd;
+
+	if (async_bin_fd != -1) {
+		FD_SET(async_bin_fd, rfds);
+		if (async_bin_fd > *max_fd)
+			*max_fd = async_bin_fd;
+	}
 }
 
 void libjipmi_callback_processfds(fd_set *rfds)
@@ -364,11 +580,21 @@ void libjipmi_callback_processfds(fd_set *rfds)
 	int fd = async_jipmi_fd;
 	char msg[IPMI_JSONRPC_MAX_MSG_LEN] = {0};
 
+	if (async_bin_fd != -1 && FD_ISSET(async_bin_fd, rfds)) {
+		for (;;) {
+			rc = recv(async_bin_fd, &msg, sizeof(msg), 0);
+			if (rc <= 0)
+				break;
+
+			handle_jipmi_bin_msg((unsigned char *)msg, rc);
+		}
+	}
+
 	if (fd == -1 || !FD_ISSET(fd, rfds))
 		return;
 
 	for (;;) {
-		rc = recv(fd, &msg, sizeof(msg), 0);
+		rc = recv(fd, &msg, sizeof(msg) - 1, 0);
 		if (rc <= 0)
 			break;
 
@@ -412,7 +638,7 @@ static void send_msg_payload_callback_handler(jipmi_br_msg_t* req, unsigned int
 	pthread_mutex_lock(&libjipmi_lock);
 
 	hndl_br->jrpc_id  = req->br_rpcid;
-	list_add_tail(&hndl_br->list, &rsp_hndl_head);
+	add_resp_hndl(hndl_br);
 
 
 	pthread_mutex_unlock(&libjipmi_lock);
@@ -472,7 +698,7 @@ static int64 join_handle_list(jipmi_rsp_callback_fn cb_fn, void *cb_arg,
 
 	jrpc_id = gen_req_jrpc_id();
 	hndl->jrpc_id  = jrpc_id;
-	list_add_tail(&hndl->list, &rsp_hndl_head);
+	add_resp_hndl(hndl);
 
 	pthread_mutex_unlock(&libjipmi_lock);
 
@@ -550,6 +776,25 @@ static int jipmi_br_cmd_timeout(unsigned int host, unsigned int port, jipmi_br_m
 	jrpc_id = join_handle_list(cb_fn, cb_arg, timeo, 0);
 	req->br_rpcid = jrpc_id;
 
+	if (jipmi_bin_connect() == 0) {
+		struct jipmi_bin_hdr hdr;
+		struct jipmi_bin_target target;
+		int rc;
+
+		jipmi_bin_set_base_info(&hdr, &target, JIPMI_BIN_RMCP_BR, jrpc_id, &(req->msg_base));
+		target.host = host;
+		target.port = port;
+		target.target_addr = req->target_addr;
+		target.target_ch = req->target_channel;
+		target.transit_addr = req->transit_addr;
+		target.transit_ch = req->transit_channel;
+		target.bridge_level = req->bridge_level;
+
+		rc = send_bmsg_to_ipmid(&hdr, &target, req->msg_base.data, timeo, mode, true);
+		if (rc != JIPMI_BIN_NOT_SENT)
+			return rc;
+	}
+
 	net_addr.s_addr = host;
 	ip_addr = inet_ntoa(net_addr);
 	param[i].name = STR_TARGET_IP;
@@ -618,6 +863,20 @@ static int jipmi_rmcp_cmd_timeout(unsigned int host, unsigned int port, jipmi_ms
 
 	jrpc_id = join_handle_list(cb_fn, cb_arg, timeo, 0);
 
+	if (jipmi_bin_connect() == 0) {
+		struct jipmi_bin_hdr hdr;
+		struct jipmi_bin_target target;
+		int rc;
+
+		jipmi_bin_set_base_info(&hdr, &target, JIPMI_BIN_RMCP, jrpc_id, req);
+		target.host = host;
+		target.port = port;
+
+		rc = send_bmsg_to_ipmid(&hdr, &target, req->data, timeo, mode, false);
+		if (rc != JIPMI_BIN_NOT_SENT)
+			return rc;
+	}
+
 	net_addr.s_addr = host;
 	ip_addr = inet_ntoa(net_addr);
 	param[i].name = STR_TARGET_IP;
@@ -655,6 +914,23 @@ static int jipmi_serial_cmd_timeout(jipmi_serial_msg_t *req,
 
 	jrpc_id = join_handle_list(cb_fn, cb_arg, timeo, 0);
 
+	if (jipmi_bin_connect() == 0 && (IPMI_SERIAL_OPEN_DEV == req->serial_flag
+		|| IPMI_SERIAL_CLOSE_DEV == req->serial_flag || IPMI_SERIAL_OPERATION == req->serial_flag)) {
+		struct jipmi_bin_hdr hdr;
+		struct jipmi_bin_target target;
+		int rc;
+
+		jipmi_bin_set_base_info(&hdr, &target,
+								(IPMI_SERIAL_OPERATION == req->serial_flag) ? JIPMI_BIN_SERIAL_CMD : JIPMI_BIN_SERIAL_OP,
+								jrpc_id, &(req->msg_base));
+		target.serial_flag = req->serial_flag;
+		target.serial_fd = req->serial_fd;
+
+		rc = send_bmsg_to_ipmid(&hdr, &target, req->msg_base.data, timeo, mode, false);
+		if (rc != JIPMI_BIN_NOT_SENT)
+			return rc;
+	}
+
 	jipmi_set_base_info(param, &i, &(req->msg_base));
 
 
@@ -705,6 +981,19 @@ static int jipmi_ipmb_cmd_timeout(unsigned char sa, jipmi_msg_t *req,
 
 	jrpc_id = join_handle_list(cb_fn, cb_arg, timeo, is_ipmb_addr_bcast(sa));
 
+	if (jipmi_bin_connect() == 0) {
+		struct jipmi_bin_hdr hdr;
+		struct jipmi_bin_target target;
+		int rc;
+
+		jipmi_bin_set_base_info(&hdr, &target, JIPMI_BIN_IPMB, jrpc_id, req);
+		target.ipmb_sa = sa;
+
+		rc = send_bmsg_to_ipmid(&hdr, &target, req->data, timeo, mode, false);
+		if (rc != JIPMI_BIN_NOT_SENT)
+			return rc;
+	}
+
 	param[i].name = STR_IPMB_SRC_ADDR;
 	FILL_INT(str_ipmb_src, sa);
 	param[i].value = (void *)&(str_ipmb_src);
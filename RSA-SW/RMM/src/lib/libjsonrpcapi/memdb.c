@@ -15,6 +15,7 @@
 
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
@@ -25,9 +26,12 @@
 #include <pthread.h>
 #include <errno.h>
 #include <assert.h>
+#include <time.h>
 
 #include "libmemdb/memdb.h"
 #include "libmemdb/command.h"
+#include "libmemdb/memdb_shm.h"
+#include "libmemdb/memdb_tlv.h"
 #include "libutils/sock.h"
 #include "librmmcfg/rmm_cfg.h"
 #include "libutils/rack.h"
@@ -38,6 +42,11 @@
 
 static int cmdfd = -1;	/* fd used for send commands */
 static int subfd = -1;	/* fd used for subscribe events */
+static int tlvfd = -1;	/* fd of MEMDB_TLV_SOCK, commands go to cmdfd if not connected */
+
+static int    tlv_enabled = 1;
+static time_t tlv_last_try;
+static pid_t  tlv_pid;
 
 static unsigned short subport;
 static int            subpid;
@@ -45,6 +54,38 @@ static int            subpid;
 static void (* event_cb)(struct event_info *, void *);
 static void *memdb_cb_data;
 
+static __thread libdb_read_hook read_hook;
+static __thread void *read_hook_arg;
+
+static inline void report_read(unsigned char db_name, memdb_integer node)
+{
+	if (read_hook != NULL)
+		read_hook(db_name, node, read_hook_arg);
+}
+
+/*
+ * The calls returning a node or a list keep it in a buffer of their own,
+ * valid until the next call. Each thread has its own buffers, allocated on
+ * its first call, so the threads of a daemon do not overwrite each other.
+ */
+enum {
+	RESULT_NODE,
+	RESULT_SUBNODE,
+	RESULT_NODE_ATTRS,
+	RESULT_COOKIE_ATTRS,
+	RESULT_BUF_NUM
+};
+
+static __thread memdb_integer *result_bufs[RESULT_BUF_NUM];
+
+static memdb_integer *result_buf(int id)
+{
+	if (result_bufs[id] == NULL)
+		result_bufs[id] = malloc(CMDBUFSIZ / sizeof(long) * sizeof(memdb_integer));
+
+	return result_bufs[id];
+}
+
 
 static int type_str2int(memdb_integer *type, char *type_str)
 {
@@ -279,6 +320,31 @@ void libdb_exit_memdb(void)
 		close(subfd);
 		subfd = -1;
 	}
+
+	if (tlvfd >= 0) {
+		close(tlvfd);
+		tlvfd = -1;
+	}
+}
+
+/**
+ * @brief: Choose the binary transport (default, unless the environment
+ *         sets MEMDB_TRANSPORT=json) or JSON-RPC over UDP for the commands.
+ */
+void libdb_set_binary_transport(int enable)
+{
+	tlv_enabled = enable;
+	tlv_last_try = 0;
+	if (!enable && tlvfd >= 0) {
+		close(tlvfd);
+		tlvfd = -1;
+	}
+}
+
+void libdb_set_read_hook(libdb_read_hook hook, void *arg)
+{
+	read_hook = hook;
+	read_hook_arg = arg;
 }
 
 static int libdb_fill_param(struct request_pkg * req, char * name, void * value, json_type type)
@@ -340,6 +406,233 @@ int libdb_parse_rsp(char *string, struct response_pkg *rsp)
 	return 0;
 }
 
+static void tlv_close(void)
+{
+	close(tlvfd);
+	tlvfd = -1;
+}
+
+/**
+ * @brief: Connect to MEMDB_TLV_SOCK and check that memdbd speaks our
+ *         version, trying at most once per second while it does not.
+ */
+static int tlv_connect(void)
+{
+	struct sockaddr_un addr = {};
+	struct memdb_tlv_hdr hdr = {};
+	struct timeval timeo = {0, 50 * 1000};
+	char *env;
+	time_t now;
+	int fd;
+
+	if (tlvfd >= 0 && tlv_pid == getpid())
+		return 0;
+
+	/* a forked child must not read the replies of its parent */
+	if (tlvfd >= 0)
+		tlv_close();
+
+	env = getenv("MEMDB_TRANSPORT");
+	if (!tlv_enabled || (env != NULL && strcmp(env, "json") == 0))
+		return -1;
+
+	now = time(NULL);
+	if (now == tlv_last_try)
+		return -1;
+	tlv_last_try = now;
+
+	fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	if (fd < 0)
+		return -1;
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, MEMDB_TLV_SOCK, sizeof(addr.sun_path) - 1);
+
+	hdr.version = MEMDB_TLV_VERSION;
+	hdr.type = MEMDB_TLV_HELLO;
+
+	/* do not wait long for a memdbd without the binary transport */
+	if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeo, sizeof(timeo)) < 0 ||
+		connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+		send(fd, &hdr, sizeof(hdr), MSG_NOSIGNAL) != sizeof(hdr) ||
+		recv(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+		hdr.version != MEMDB_TLV_VERSION || hdr.type != MEMDB_TLV_HELLO)
+		goto err;
+
+	/* replies may be delayed by a lock, wait as long as on cmdfd */
+	timeo.tv_usec = 0;
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeo, sizeof(timeo));
+
+	tlvfd = fd;
+	tlv_pid = getpid();
+	return 0;
+
+err:
+	close(fd);
+	return -1;
+}
+
+static int tlv_put_param(struct memdb_tlv_buf *buf, jrpc_param_t *param)
+{
+	json_t *value = NULL;
+	int rc;
+
+	switch (param->value_type) {
+	case JSON_STRING:
+		return memdb_tlv_put_string(buf, param->name, (char *)param->value);
+	case JSON_INTEGER:
+		return memdb_tlv_put_int(buf, param->name, *(int64 *)param->value);
+	case JSON_OBJECT:
+	case JSON_ARRAY:
+		return memdb_tlv_put_json(buf, param->name, (json_t *)param->value);
+	case JSON_REAL:
+		value = json_real(*(double *)param->value);
+		break;
+	case JSON_TRUE:
+		value = json_true();
+		break;
+	case JSON_FALSE:
+		value = json_false();
+		break;
+	case JSON_NULL:
+		value = json_null();
+		break;
+	default:
+		return -1;
+	}
+
+	if (value == NULL)
+		return -1;
+
+	rc = memdb_tlv_put_json(buf, param->name, value);
+	json_free(value);
+
+	return rc;
+}
+
+static void tlv_free_params(struct request_pkg *req)
+{
+	int i;
+
+	/* owned by the request, as jrpc_create_req_string() does */
+	for (i = 0; i < req->jrpc_pkg.num_of_params; i++) {
+		if (req->jrpc_pkg.params[i].value_type == JSON_OBJECT ||
+			req->jrpc_pkg.params[i].value_type == JSON_ARRAY)
+			json_free((json_t *)req->jrpc_pkg.params[i].value);
+	}
+	req->jrpc_pkg.num_of_params = 0;
+}
+
+static int tlv_parse_rsp(char *data, int len, struct response_pkg *rsp)
+{
+	struct memdb_tlv_hdr hdr;
+	json_t *result = NULL;
+
+	memcpy(&hdr, data, sizeof(hdr));
+	rsp->jrpc_pkg.id = hdr.id;
+	rsp->jrpc_pkg.id_type = JSONRPC_ID_TYPE_NORMAL;
+
+	if (hdr.type == MEMDB_TLV_ERR) {
+		rsp->jrpc_pkg.rsp_type = JSONRPC_RSP_ERROR;
+		rsp->jrpc_pkg.data.error.code = hdr.code;
+		rsp->rcode = get_memdb_errno(hdr.code);
+		if (rsp->rcode == MEMDB_HANDLE_SUCCESS)
+			rsp->rcode = MEMDB_OEM_HANDLE_ERR;
+		return 0;
+	}
+
+	if (hdr.type != MEMDB_TLV_RSP)
+		return -1;
+
+	rsp->jrpc_pkg.json = json_object();
+	result = memdb_tlv_get_object(data + sizeof(hdr), len - sizeof(hdr));
+	if (rsp->jrpc_pkg.json == NULL || result == NULL ||
+		JSON_SUCCESS != json_object_add(rsp->jrpc_pkg.json, "result", result)) {
+		if (result)
+			json_free(result);
+		jrpc_rsp_pkg_free(&rsp->jrpc_pkg);
+		return -1;
+	}
+
+	rsp->jrpc_pkg.rsp_type = JSONRPC_RSP_RESULT;
+	rsp->jrpc_pkg.data.result.value_obj = result;
+	jrpc_get_named_result_value(rsp->jrpc_pkg.json, "node_id", JSON_INTEGER, &rsp->node_id);
+
+	return 0;
+}
+
+/**
+ * @brief: Send the command on MEMDB_TLV_SOCK, called with the socket
+ *         mutex held. Return -1 if it was not sent, so it can go to
+ *         cmdfd instead, otherwise the result like libdb_process_cmd().
+ */
+static int tlv_process_cmd(struct request_pkg *req, struct response_pkg *rsp)
+{
+	struct memdb_tlv_hdr hdr = {};
+	struct memdb_tlv_buf buf;
+	int i;
+	int rc;
+
+	if (req->db_name >= DB_MAX || req->db_name < DB_RMM || tlv_connect() != 0)
+		return -1;
+
+	buf.data = malloc(MEMDB_TLV_MAX_LEN);
+	if (buf.data == NULL)
+		return -1;
+	buf.len = sizeof(hdr);
+	buf.size = MEMDB_TLV_MAX_LEN;
+
+	hdr.version = MEMDB_TLV_VERSION;
+	hdr.type = MEMDB_TLV_REQ;
+	hdr.cmd = req->cmd;
+	hdr.id = req->jrpc_pkg.id;
+	hdr.db_name = req->db_name;
+	hdr.node_id = req->node_id;
+	hdr.lock_id = req->lock_id;
+	memcpy(buf.data, &hdr, sizeof(hdr));
+
+	for (i = 0; i < req->jrpc_pkg.num_of_params; i++) {
+		if (tlv_put_param(&buf, &req->jrpc_pkg.params[i]) != 0) {
+			free(buf.data);
+			return -1;
+		}
+	}
+
+	if (send(tlvfd, buf.data, buf.len, MSG_NOSIGNAL) != buf.len) {
+		rmm_log(WARNING, "memdb binary transport lost, use JSON-RPC.\n");
+		tlv_close();
+		free(buf.data);
+		return -1;
+	}
+	tlv_free_params(req);
+
+	for (;;) {
+		rc = recv(tlvfd, buf.data, buf.size, 0);
+		if (rc < (int)sizeof(hdr)) {
+			rmm_log(ERROR, "fail at recv from %s.\n", MEMDB_TLV_SOCK);
+			tlv_close();
+			rsp->rcode = LIBDB_RECV_ERROR;
+			break;
+		}
+
+		if (tlv_parse_rsp(buf.data, rc, rsp) != 0) {
+			rsp->rcode = LIBDB_PARSE_ERROR;
+			break;
+		}
+
+		if (rsp->jrpc_pkg.id == req->jrpc_pkg.id)
+			break;
+
+		/* reply of a command given up before */
+		jrpc_rsp_pkg_free(&rsp->jrpc_pkg);
+		rsp->rcode = 0;
+	}
+
+	free(buf.data);
+	return rsp->rcode;
+}
+
 static memdb_integer libdb_process_cmd(struct request_pkg *req, struct response_pkg *rsp)
 {
 	static unsigned int seqnum = 0;
@@ -357,6 +650,12 @@ static memdb_integer libdb_process_cmd(struct request_pkg *req, struct response_
 	pthread_mutex_lock(&socket_mutex);
 	req->jrpc_pkg.id = ++seqnum;
 
+	rc = tlv_process_cmd(req, rsp);
+	if (rc >= 0) {
+		pthread_mutex_unlock(&socket_mutex);
+		return rc;
+	}
+
 	if (libdb_fill_general_params(req)) {
 		rmm_log(ERROR, "fail at libdb_fill_general_params.\n");
 		goto failed;
@@ -567,8 +866,18 @@ struct node_info *libdb_get_node_by_node_id(unsigned char db_name, memdb_integer
 	struct response_pkg rsp = {};
 	struct request_pkg req = {};
 	memdb_integer rc = 0;
-	/* FIXME: not thread safe */
-	static memdb_integer nodeinfo[CMDBUFSIZ/sizeof(long)];
+	memdb_integer *nodeinfo = result_buf(RESULT_NODE);
+
+	if (nodeinfo == NULL)
+		return NULL;
+
+	report_read(db_name, node_id);
+
+	if (lock_id == LOCK_ID_NULL) {
+		rc = memdb_shm_get_node(db_name, node_id, (struct node_info *)nodeinfo);
+		if (rc >= 0)
+			return rc == 0 ? (struct node_info *)nodeinfo : NULL;
+	}
 
 	req.db_name = db_name;
 	req.cmd = CMD_NODE_GET_BY_NODE_ID;
@@ -594,6 +903,43 @@ struct node_info *libdb_get_node_by_node_id(unsigned char db_name, memdb_integer
 	return NULL;
 }
 
+memdb_integer libdb_find_node_by_attr(unsigned char db_name, char *name, char *data,
+									  struct node_info *node, lock_id_t lock_id)
+{
+	struct response_pkg rsp = {};
+	struct request_pkg req = {};
+	json_t *r_node = NULL;
+	memdb_integer rc = 0;
+
+	req.db_name = db_name;
+	req.cmd = CMD_NODE_FIND_BY_ATTR;
+	req.lock_id = lock_id;
+	libdb_fill_param(&req, "p_name", name, JSON_STRING);
+	libdb_fill_param(&req, "p_data", data, JSON_STRING);
+
+	rc = libdb_process_cmd(&req, &rsp);
+	if (rc != 0) {
+		/* another node may get the value later */
+		report_read(db_name, LIBDB_READ_ANY);
+		goto out;
+	}
+
+	if (JSONRPC_SUCCESS != jrpc_get_named_result_value(rsp.jrpc_pkg.json, "r_node", JSON_OBJECT, &r_node) ||
+		-1 == (node->parent = json_integer_value(json_object_get(r_node, "parent"))) ||
+		-1 == (node->node_id = json_integer_value(json_object_get(r_node, "node_id"))) ||
+		-1 == type_str2int(&node->type, json_string_value(json_object_get(r_node, "type")))) {
+		rc = -1;
+		goto out;
+	}
+
+	report_read(db_name, LIBDB_READ_NODES);
+	report_read(db_name, node->node_id);
+
+out:
+	jrpc_rsp_pkg_free(&(rsp.jrpc_pkg));
+	return rc;
+}
+
 
 memdb_integer libdb_destroy_node(unsigned char db_name, memdb_integer node, lock_id_t lock_id)
 {
@@ -620,8 +966,7 @@ static struct node_info *list_subnode(unsigned char db_name,
 {
 	struct response_pkg rsp = {};
 	struct request_pkg req = {};
-	/* FIXME: not thread safe */
-	static memdb_integer nodeinfo[CMDBUFSIZ/sizeof(long)];
+	memdb_integer *nodeinfo = result_buf(RESULT_SUBNODE);
 	struct node_info *pinfo = NULL;
 	*nodenum = 0;
 	memdb_integer rc = 0;
@@ -631,6 +976,32 @@ static struct node_info *list_subnode(unsigned char db_name,
 	req.lock_id = lock_id;
 	int node_cnt = 0;
 
+	if (nodeinfo == NULL)
+		return NULL;
+
+	report_read(db_name, node);
+
+	if (lock_id == LOCK_ID_NULL) {
+		struct node_info *info = (struct node_info *)nodeinfo;
+		int i;
+
+		rc = memdb_shm_list_subnode(db_name, node, param->type_match, param->type_value,
+									info, CMDBUFSIZ/sizeof(struct node_info), &node_cnt);
+		if (rc > 0)
+			return NULL;
+
+		if (rc == 0) {
+			for (i = 0; i < node_cnt; i++) {
+				if ((filter != NULL) && ((*filter)(info[i].node_id) == 1))
+					continue;
+				info[(*nodenum)++] = info[i];
+			}
+
+			return info;
+		}
+		node_cnt = 0;
+	}
+
 	if (libdb_fill_param(&req, "p_type_match", &param->type_match, JSON_INTEGER) ||
 		libdb_fill_param(&req, "p_type_value", mc_type_str[param->type_value], JSON_STRING))
 		goto end;
@@ -715,6 +1086,8 @@ static struct node_info *list_node(unsigned char db_name, int *nodenum,
 	req.node_id = 0;
 	req.lock_id = lock_id;
 
+	report_read(db_name, LIBDB_READ_NODES);
+
 	if (param->type_min < MC_TYPE_RMC || param->type_max > MC_TYPE_END ||
 		libdb_fill_param(&req, "p_type_max", mc_type_str[param->type_max], JSON_STRING) ||
 		libdb_fill_param(&req, "p_type_min", mc_type_str[param->type_min], JSON_STRING))
@@ -849,6 +1222,14 @@ static memdb_integer get_attr_data(unsigned char db_name, memdb_integer node,
 	req.node_id = node;
 	req.lock_id = lock_id;
 
+	report_read(db_name, node);
+
+	if (lock_id == LOCK_ID_NULL) {
+		rc = memdb_shm_attr_get(db_name, node, name, output, len);
+		if (rc >= 0)
+			return rc;
+	}
+
 	jrpc_data_string p_name = name;
 	if (libdb_fill_param(&req, "p_name", p_name, JSON_STRING))
 		return JSONRPC_FILL_PARAM_ERR;
@@ -1010,11 +1391,60 @@ memdb_integer libdb_attr_get_string(unsigned char db_name, memdb_integer node, c
 	return 0;
 }
 
+/**
+ * @brief: Pack the "r_attrs" array of a response into consecutive
+ *         'struct attr_info' records, at most @max bytes.
+ *
+ * @return: 0 if all attributes fit, -1 on malformed data, 1 if the
+ *          buffer was too small; '*size' holds the packed length.
+ */
+static int pack_attr_array(json_t *attr_array, void *attrs, int max, int *size)
+{
+	unsigned short off = 0;
+	int i = 0;
+	struct node_attr pa = {};
+	struct attr_info *info = (struct attr_info *)attrs;
+	int attr_array_size = json_array_size(attr_array);
+
+	*size = 0;
+
+	for (i = 0; i < attr_array_size; i++) {
+		json_t * element = json_array_get(attr_array, i);
+		unsigned short next_offset;
+
+		if (NULL == element ||
+			-1 == (info->node = json_integer_value(json_object_get(element, "node"))) ||
+			-1 == (info->cookie = json_integer_value(json_object_get(element, "cookie"))) ||
+			NULL == (pa.name_ptr = json_string_value(json_object_get(element, "name"))) ||
+			NULL == (pa.data_ptr = json_string_value(json_object_get(element, "data"))))
+			return -1;
+
+		pa.namelen = strlen(pa.name_ptr)+1;
+		pa.datalen = strlen(pa.data_ptr)+1;
+		next_offset = sizeof(*info) + pa.namelen + pa.datalen;
+		next_offset = DB_ALIGN(next_offset);
+		if (off + next_offset > max)
+			return 1;
+
+		info->next_offset = next_offset;
+		info->data_offset = pa.namelen;
+		info->data_len = pa.datalen;
+		memcpy(&info->elems[0], pa.name_ptr, pa.namelen);
+		memcpy(&info->elems[pa.namelen], pa.data_ptr, pa.datalen);
+
+		off += next_offset;
+		*size = off;
+		info = (void *)info + next_offset;
+	}
+
+	return 0;
+}
+
 void *libdb_list_attrs_by_node(unsigned char db_name, memdb_integer node, int *size, lock_id_t lock_id)
 {
 	struct response_pkg rsp = {};
 	struct request_pkg req = {};
-	static memdb_integer attrs[CMDBUFSIZ/sizeof(long)];
+	memdb_integer *attrs = result_buf(RESULT_NODE_ATTRS);
 	void *ret = NULL;
 	memdb_integer rc = 0;
 
@@ -1024,61 +1454,171 @@ void *libdb_list_attrs_by_node(unsigned char db_name, memdb_integer node, int *s
 	req.lock_id = lock_id;
 	*size = 0;
 
+	if (attrs == NULL)
+		return NULL;
+
+	report_read(db_name, node);
+
+	if (lock_id == LOCK_ID_NULL) {
+		rc = memdb_shm_list_attrs(db_name, node, attrs, CMDMAXDATALEN, size);
+		if (rc >= 0)
+			return rc == 0 ? attrs : NULL;
+	}
+
 	rc = libdb_process_cmd(&req, &rsp);
 	if (rc == 0) {
-		unsigned short off = 0;
-		int i = 0;
-		struct node *n = NULL;
-		struct node_attr pa = {};
-		struct attr_info * info = NULL;
-	
 		json_t * attr_array = NULL;
-		int attr_array_size = 0; 
 
 		if(JSONRPC_SUCCESS != jrpc_get_named_result_value(rsp.jrpc_pkg.json, "r_attrs", JSON_ARRAY, &attr_array))
 			goto end;
 
-		off  = 0;
-		info = (struct attr_info *)attrs;
-		attr_array_size = json_array_size(attr_array);
+		rc = pack_attr_array(attr_array, attrs, CMDMAXDATALEN, size);
+		if (rc < 0) {
+			*size = 0;
+			goto end;
+		}
+		if (rc > 0)
+			printf("CMDMAXDATALEN is too small!\n");
 
-		for (i=0; i<attr_array_size; i++) {
-			json_t * element = json_array_get(attr_array, i);
-			unsigned short next_offset;
+		ret = attrs;
+	}
 
-			if (NULL == element || 
-				-1 == (info->node = json_integer_value(json_object_get(element, "node"))) ||
-				-1 == (info->cookie = json_integer_value(json_object_get(element, "cookie"))) ||
-				NULL == (pa.name_ptr = json_string_value(json_object_get(element, "name"))) ||
-				NULL == (pa.data_ptr = json_string_value(json_object_get(element, "data"))))
-				goto end;
+end:
+	jrpc_rsp_pkg_free(&(rsp.jrpc_pkg));
+	return ret;
+}
 
-			pa.namelen = strlen(pa.name_ptr)+1;
-			pa.datalen = strlen(pa.data_ptr)+1;
-			next_offset = sizeof(*info) + pa.namelen + pa.datalen;
-			next_offset = DB_ALIGN(next_offset);
-			if (off + next_offset > CMDMAXDATALEN) {
-				printf("CMDMAXDATALEN is too small!\n");
-				break;
-			}
+memdb_integer libdb_attr_get_multi(unsigned char db_name, memdb_integer node,
+								   char **names, int count, int subtree,
+								   void *attrs, int *size, lock_id_t lock_id)
+{
+	struct response_pkg rsp = {};
+	struct request_pkg req = {};
+	memdb_integer rc = 0;
+	jrpc_data_integer p_subtree = subtree;
+	json_t *p_names = NULL;
+	json_t *attr_array = NULL;
+	int max = 0;
+	int i;
 
-			info->next_offset = next_offset;
-			info->data_offset = pa.namelen;
-			info->data_len = pa.datalen;
-			memcpy(&info->elems[0], pa.name_ptr, pa.namelen);
-			memcpy(&info->elems[pa.namelen], pa.data_ptr, pa.datalen);
+	if (NULL == attrs || NULL == size || *size <= 0)
+		return -1;
 
-			off += next_offset;
-			info = (void *)info + next_offset;
+	max = *size;
+	*size = 0;
+
+	req.db_name = db_name;
+	req.cmd = CMD_ATTRBUTE_GET_MULTI;
+	req.node_id = node;
+	req.lock_id = lock_id;
+
+	report_read(db_name, subtree ? LIBDB_READ_ANY : node);
+
+	p_names = json_array();
+	if (NULL == p_names)
+		return -1;
+
+	for (i = 0; i < count; i++) {
+		if (JSON_SUCCESS != json_array_add(p_names, json_string(names[i]))) {
+			json_free(p_names);
+			return -1;
 		}
+	}
 
-		*size = off;
-		ret = attrs;
+	/* p_names is owned by the request once it has been filled. */
+	if (libdb_fill_param(&req, "p_names", p_names, JSON_ARRAY)) {
+		json_free(p_names);
+		return -1;
 	}
+	if (libdb_fill_param(&req, "p_subtree", &p_subtree, JSON_INTEGER))
+		return -1;
+
+	rc = libdb_process_cmd(&req, &rsp);
+	if (rc != 0)
+		return rc;
+
+	if (JSONRPC_SUCCESS != jrpc_get_named_result_value(rsp.jrpc_pkg.json, "r_attrs", JSON_ARRAY, &attr_array))
+		rc = -1;
+	else if (pack_attr_array(attr_array, attrs, max, size) != 0)
+		rc = MEMDB_OEM_STRING_LEN_EXCEED;
 
-end:
 	jrpc_rsp_pkg_free(&(rsp.jrpc_pkg));
-	return ret;
+	return rc;
+}
+
+char *libdb_attr_find(void *attrs, int size, memdb_integer node, char *name)
+{
+	struct attr_info *info;
+	int offset;
+
+	if (NULL == attrs || NULL == name)
+		return NULL;
+
+	foreach_attr_info(info, offset, attrs, size) {
+		if (info->node == node && strcmp(attr_name(info), name) == 0)
+			return attr_data(info);
+	}
+
+	return NULL;
+}
+
+memdb_integer libdb_attr_set_multi(unsigned char db_name, memdb_integer node,
+								   struct attr_set_entry *entries, int count,
+								   unsigned char snapshot_flag, lock_id_t lock_id)
+{
+	struct response_pkg rsp = {};
+	struct request_pkg req = {};
+	memdb_integer rc = 0;
+	jrpc_data_integer p_snap = snapshot_flag;
+	json_t *p_attrs = NULL;
+	json_t *element = NULL;
+	int i;
+
+	if (NULL == entries || count <= 0)
+		return -1;
+
+	req.db_name = db_name;
+	req.cmd = CMD_ATTRBUTE_SET_MULTI;
+	req.node_id = node;
+	req.lock_id = lock_id;
+
+	p_attrs = json_array();
+	if (NULL == p_attrs)
+		return -1;
+
+	for (i = 0; i < count; i++) {
+		element = json_object();
+		if (NULL == element ||
+			JSON_SUCCESS != json_object_add(element, "cookie", json_integer(entries[i].cookie)) ||
+			JSON_SUCCESS != json_object_add(element, "name", json_string(entries[i].name)) ||
+			JSON_SUCCESS != json_object_add(element, "data", json_string(entries[i].data)) ||
+			(entries[i].node != 0 &&
+			 JSON_SUCCESS != json_object_add(element, "node_id", json_integer(entries[i].node))) ||
+			JSON_SUCCESS != json_array_add(p_attrs, element)) {
+			/* the element is only owned by p_attrs once it is added */
+			if (NULL != element)
+				json_free(element);
+			json_free(p_attrs);
+			return -1;
+		}
+	}
+
+	if (libdb_fill_param(&req, "p_snapshot_flag", &p_snap, JSON_INTEGER)) {
+		json_free(p_attrs);
+		return -1;
+	}
+	/* p_attrs is owned by the request once it has been filled. */
+	if (libdb_fill_param(&req, "p_attrs", p_attrs, JSON_ARRAY)) {
+		json_free(p_attrs);
+		return -1;
+	}
+
+	rc = libdb_process_cmd(&req, &rsp);
+	if (rc != 0)
+		return -1;
+
+	jrpc_rsp_pkg_free(&(rsp.jrpc_pkg));
+	return 0;
 }
 
 /*
@@ -1130,7 +1670,7 @@ void *libdb_list_attrs_by_cookie(unsigned char db_name, unsigned int cmask, int
 {
 	struct response_pkg rsp = {};
 	struct request_pkg req = {};
-	static memdb_integer attrs[CMDBUFSIZ/sizeof(long)];
+	memdb_integer *attrs = result_buf(RESULT_COOKIE_ATTRS);
 	void *ret = NULL;
 	*size = 0;
 	memdb_integer rc = 0;
@@ -1140,6 +1680,11 @@ void *libdb_list_attrs_by_cookie(unsigned char db_name, unsigned int cmask, int
 	req.node_id = 0;
 	req.lock_id = lock_id;
 
+	if (attrs == NULL)
+		return NULL;
+
+	report_read(db_name, LIBDB_READ_ANY);
+
 	jrpc_data_integer p_cmask = cmask;
 
 	if (libdb_fill_param(&req, "p_cmask", &p_cmask, JSON_INTEGER))
@@ -0,0 +1,397 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "libmemdb/memdb.h"
+#include "libmemdb/command.h"
+#include "libmemdb/memdb_shm.h"
+
+#define DB_ALIGN(s)		(((s) + 7) & ~7)
+
+/* times a read is retried while memdbd rewrites the buffer under it */
+#define SHM_READ_RETRY	3
+
+static struct memdb_shm_hdr *shm_hdr;
+
+/**
+ * @brief: Map the snapshot published by memdbd, trying at most once
+ *         per second while it does not exist yet.
+ */
+static struct memdb_shm_hdr *shm_map(void)
+{
+	static pthread_mutex_t map_mutex = PTHREAD_MUTEX_INITIALIZER;
+	static time_t last_try;
+	struct memdb_shm_hdr *hdr;
+	time_t now;
+	int fd;
+
+	if (shm_hdr != NULL)
+		return shm_hdr;
+
+	now = time(NULL);
+	pthread_mutex_lock(&map_mutex);
+	if (shm_hdr != NULL || now == last_try)
+		goto out;
+	last_try = now;
+
+	fd = shm_open(MEMDB_SHM_NAME, O_RDONLY, 0);
+	if (fd < 0)
+		goto out;
+
+	hdr = mmap(NULL, MEMDB_SHM_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (hdr == MAP_FAILED)
+		goto out;
+
+	if (hdr->magic != MEMDB_SHM_MAGIC || hdr->buf_size != MEMDB_SHM_BUF_SIZE) {
+		munmap(hdr, MEMDB_SHM_SIZE);
+		goto out;
+	}
+
+	__sync_synchronize();
+	shm_hdr = hdr;
+
+out:
+	pthread_mutex_unlock(&map_mutex);
+	return shm_hdr;
+}
+
+static struct memdb_shm_buf *shm_read_begin(unsigned int *seq)
+{
+	struct memdb_shm_hdr *hdr = shm_map();
+	struct memdb_shm_buf *b;
+	int idx;
+
+	if (hdr == NULL || hdr->locked)
+		return NULL;
+
+	idx = hdr->active;
+	if (idx != 0 && idx != 1)
+		return NULL;
+
+	b = &hdr->buf[idx];
+	*seq = b->seq;
+	__sync_synchronize();
+
+	if ((*seq & 1) || b->gen != hdr->write_gen)
+		return NULL;
+
+	return b;
+}
+
+static int shm_read_end(struct memdb_shm_buf *b, unsigned int seq)
+{
+	__sync_synchronize();
+
+	return b->seq == seq;
+}
+
+/*
+ * The buffer may be rewritten while it is read, so every offset taken
+ * from it is checked before use; shm_read_end() then rejects the result.
+ */
+static int shm_range_ok(unsigned int off, unsigned int size)
+{
+	return off <= MEMDB_SHM_BUF_SIZE && size <= MEMDB_SHM_BUF_SIZE - off;
+}
+
+static struct memdb_shm_node *shm_find_node(struct memdb_shm_buf *b,
+											unsigned char db_name, memdb_integer node_id)
+{
+	struct memdb_shm_node *table;
+	unsigned int off = b->node_off[db_name];
+	unsigned int num = b->node_num[db_name];
+	unsigned int lo = 0, hi, mid;
+
+	if (num > MEMDB_SHM_BUF_SIZE / sizeof(*table) ||
+		!shm_range_ok(off, num * sizeof(*table)))
+		return NULL;
+
+	table = (struct memdb_shm_node *)(b->data + off);
+	hi = num;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (table[mid].node_id == node_id)
+			return &table[mid];
+		if (table[mid].node_id < node_id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief: Return the attribute at '*off' and advance '*off' past it,
+ *         or NULL if there is no valid one.
+ */
+static struct memdb_shm_attr *shm_next_attr(struct memdb_shm_buf *b, unsigned int *off)
+{
+	struct memdb_shm_attr *a;
+
+	if (!shm_range_ok(*off, sizeof(*a)))
+		return NULL;
+
+	a = (struct memdb_shm_attr *)(b->data + *off);
+	if (a->namelen == 0 || a->datalen == 0 ||
+		a->next_offset < sizeof(*a) + a->namelen + a->datalen ||
+		!shm_range_ok(*off, a->next_offset))
+		return NULL;
+
+	*off += a->next_offset;
+	return a;
+}
+
+static int attr_get(struct memdb_shm_buf *b, unsigned char db_name, memdb_integer node,
+					char *name, char *output, int len, int *copied)
+{
+	struct memdb_shm_node *n;
+	struct memdb_shm_attr *a;
+	unsigned int namelen = strlen(name) + 1;
+	unsigned int datalen;
+	unsigned int off;
+	unsigned int i;
+
+	n = shm_find_node(b, db_name, node);
+	if (n == NULL)
+		return MEMDB_OEM_NODE_NOTFOUND;
+
+	off = n->attr_off;
+	for (i = 0; i < n->attr_num; i++) {
+		a = shm_next_attr(b, &off);
+		if (a == NULL)
+			return -1;
+
+		if (a->namelen != namelen || memcmp(a->elems, name, namelen) != 0)
+			continue;
+
+		/* same as the reply of memdbd handled in get_attr_data() */
+		datalen = strnlen(a->elems + namelen, a->datalen);
+		if (datalen == 0)
+			return MEMDB_HANDLE_SUCCESS;
+		if (datalen >= len)
+			return MEMDB_OEM_STRING_LEN_EXCEED;
+
+		memcpy(output, a->elems + namelen, datalen);
+		output[datalen] = '\0';
+		*copied = datalen + 1;
+		return MEMDB_HANDLE_SUCCESS;
+	}
+
+	return MEMDB_OEM_ATTRI_NOTFOUND;
+}
+
+int memdb_shm_attr_get(unsigned char db_name, memdb_integer node,
+					   char *name, char *output, int len)
+{
+	struct memdb_shm_buf *b;
+	unsigned int seq;
+	int copied;
+	int retry;
+	int rc;
+
+	if (db_name >= DB_MAX || name == NULL || output == NULL || len <= 0)
+		return -1;
+
+	for (retry = 0; retry < SHM_READ_RETRY; retry++) {
+		b = shm_read_begin(&seq);
+		if (b == NULL)
+			return -1;
+
+		copied = 0;
+		rc = attr_get(b, db_name, node, name, output, len, &copied);
+		if (shm_read_end(b, seq))
+			return rc;
+
+		/* do not leave a torn value to the caller */
+		memset(output, 0, copied);
+	}
+
+	return -1;
+}
+
+int memdb_shm_get_node(unsigned char db_name, memdb_integer node,
+					   struct node_info *info)
+{
+	struct memdb_shm_buf *b;
+	struct memdb_shm_node *n;
+	unsigned int seq;
+	int retry;
+	int rc;
+
+	if (db_name >= DB_MAX || info == NULL)
+		return -1;
+
+	for (retry = 0; retry < SHM_READ_RETRY; retry++) {
+		b = shm_read_begin(&seq);
+		if (b == NULL)
+			return -1;
+
+		rc = MEMDB_OEM_NODE_NOTFOUND;
+		n = shm_find_node(b, db_name, node);
+		if (n != NULL) {
+			info->parent = n->parent;
+			info->node_id = n->node_id;
+			info->type = n->type;
+			info->snapshot_flag = n->snapshot_flag;
+			rc = MEMDB_HANDLE_SUCCESS;
+		}
+
+		if (shm_read_end(b, seq))
+			return rc;
+	}
+
+	return -1;
+}
+
+static int list_subnode(struct memdb_shm_buf *b, unsigned char db_name, memdb_integer node,
+						int type_match, memdb_integer type_value,
+						struct node_info *infos, int max, int *nodenum)
+{
+	struct memdb_shm_node *n, *child;
+	memdb_integer *ids;
+	unsigned int i;
+
+	n = shm_find_node(b, db_name, node);
+	if (n == NULL)
+		return MEMDB_OEM_NODE_NOTFOUND;
+
+	if (n->child_num > MEMDB_SHM_BUF_SIZE / sizeof(*ids) ||
+		!shm_range_ok(n->child_off, n->child_num * sizeof(*ids)))
+		return -1;
+
+	ids = (memdb_integer *)(b->data + n->child_off);
+	for (i = 0; i < n->child_num; i++) {
+		child = shm_find_node(b, db_name, ids[i]);
+		if (child == NULL)
+			return -1;
+
+		if (type_match && child->type != type_value)
+			continue;
+
+		/* let memdbd report what does not fit */
+		if (*nodenum >= max)
+			return -1;
+
+		infos[*nodenum].parent = node;
+		infos[*nodenum].node_id = child->node_id;
+		infos[*nodenum].type = child->type;
+		infos[*nodenum].snapshot_flag = child->snapshot_flag;
+		(*nodenum)++;
+	}
+
+	return MEMDB_HANDLE_SUCCESS;
+}
+
+int memdb_shm_list_subnode(unsigned char db_name, memdb_integer node,
+						   int type_match, memdb_integer type_value,
+						   struct node_info *infos, int max, int *nodenum)
+{
+	struct memdb_shm_buf *b;
+	unsigned int seq;
+	int retry;
+	int rc;
+
+	if (db_name >= DB_MAX || infos == NULL || nodenum == NULL)
+		return -1;
+
+	for (retry = 0; retry < SHM_READ_RETRY; retry++) {
+		b = shm_read_begin(&seq);
+		if (b == NULL)
+			return -1;
+
+		*nodenum = 0;
+		rc = list_subnode(b, db_name, node, type_match, type_value, infos, max, nodenum);
+		if (shm_read_end(b, seq))
+			return rc;
+	}
+
+	*nodenum = 0;
+	return -1;
+}
+
+static int list_attrs(struct memdb_shm_buf *b, unsigned char db_name, memdb_integer node,
+					  void *attrs, int max, int *size)
+{
+	struct memdb_shm_node *n;
+	struct memdb_shm_attr *a;
+	struct attr_info *info = attrs;
+	unsigned int next_offset;
+	unsigned int off;
+	unsigned int i;
+
+	n = shm_find_node(b, db_name, node);
+	if (n == NULL)
+		return MEMDB_OEM_NODE_NOTFOUND;
+
+	off = n->attr_off;
+	for (i = 0; i < n->attr_num; i++) {
+		a = shm_next_attr(b, &off);
+		if (a == NULL)
+			return -1;
+
+		next_offset = DB_ALIGN(sizeof(*info) + a->namelen + a->datalen);
+		if (*size + next_offset > max)
+			return -1;
+
+		info->node = node;
+		info->cookie = a->cookie;
+		info->next_offset = next_offset;
+		info->data_offset = a->namelen;
+		info->data_len = a->datalen;
+		memcpy(&info->elems[0], a->elems, a->namelen + a->datalen);
+		info->elems[a->namelen - 1] = '\0';
+		info->elems[a->namelen + a->datalen - 1] = '\0';
+
+		*size += next_offset;
+		info = (void *)info + next_offset;
+	}
+
+	return MEMDB_HANDLE_SUCCESS;
+}
+
+int memdb_shm_list_attrs(unsigned char db_name, memdb_integer node,
+						 void *attrs, int max, int *size)
+{
+	struct memdb_shm_buf *b;
+	unsigned int seq;
+	int retry;
+	int rc;
+
+	if (db_name >= DB_MAX || attrs == NULL || size == NULL)
+		return -1;
+
+	for (retry = 0; retry < SHM_READ_RETRY; retry++) {
+		b = shm_read_begin(&seq);
+		if (b == NULL)
+			return -1;
+
+		*size = 0;
+		rc = list_attrs(b, db_name, node, attrs, max, size);
+		if (shm_read_end(b, seq))
+			return rc;
+	}
+
+	*size = 0;
+	return -1;
+}
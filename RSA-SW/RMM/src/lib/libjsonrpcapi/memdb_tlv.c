@@ -0,0 +1,273 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "libjsonrpc/jsonrpc.h"
+#include "libmemdb/memdb_tlv.h"
+
+/* nesting allowed when decoding, memdb replies use two levels */
+#define TLV_MAX_DEPTH	8
+
+static int put_bytes(struct memdb_tlv_buf *buf, const void *p, int len)
+{
+	if (len < 0 || buf->len + len > buf->size)
+		return -1;
+
+	memcpy(buf->data + buf->len, p, len);
+	buf->len += len;
+
+	return 0;
+}
+
+static int put_head(struct memdb_tlv_buf *buf, json_type type, char *name)
+{
+	uint8 t = type;
+	uint8 namelen = 0;
+	int len = name ? strlen(name) : 0;
+
+	if (len > 255)
+		return -1;
+	namelen = len;
+
+	if (put_bytes(buf, &t, 1) ||
+		put_bytes(buf, &namelen, 1) ||
+		put_bytes(buf, name, namelen))
+		return -1;
+
+	return 0;
+}
+
+int memdb_tlv_put_int(struct memdb_tlv_buf *buf, char *name, int64 value)
+{
+	if (put_head(buf, JSON_INTEGER, name) ||
+		put_bytes(buf, &value, sizeof(value)))
+		return -1;
+
+	return 0;
+}
+
+int memdb_tlv_put_string(struct memdb_tlv_buf *buf, char *name, char *value)
+{
+	uint32 len = strlen(value);
+
+	if (put_head(buf, JSON_STRING, name) ||
+		put_bytes(buf, &len, sizeof(len)) ||
+		put_bytes(buf, value, len))
+		return -1;
+
+	return 0;
+}
+
+int memdb_tlv_put_json(struct memdb_tlv_buf *buf, char *name, json_t *value)
+{
+	json_pair_t *pair;
+	json_t *elem;
+	uint32 count = 0;
+	double real;
+	int i;
+
+	if (value == NULL)
+		return -1;
+
+	switch (value->type) {
+	case JSON_INTEGER:
+		return memdb_tlv_put_int(buf, name, json_integer_value(value));
+	case JSON_STRING:
+		return memdb_tlv_put_string(buf, name, json_string_value(value));
+	case JSON_REAL:
+		real = json_real_value(value);
+		if (put_head(buf, JSON_REAL, name) ||
+			put_bytes(buf, &real, sizeof(real)))
+			return -1;
+		return 0;
+	case JSON_OBJECT:
+		for (pair = json_to_object(value)->next; pair != NULL; pair = pair->next)
+			count++;
+
+		if (put_head(buf, JSON_OBJECT, name) ||
+			put_bytes(buf, &count, sizeof(count)))
+			return -1;
+		return memdb_tlv_put_members(buf, value);
+	case JSON_ARRAY:
+		count = json_to_array(value)->size;
+		if (put_head(buf, JSON_ARRAY, name) ||
+			put_bytes(buf, &count, sizeof(count)))
+			return -1;
+
+		elem = json_to_array(value)->next;
+		for (i = 0; i < count; i++, elem = elem->next) {
+			if (memdb_tlv_put_json(buf, NULL, elem))
+				return -1;
+		}
+		return 0;
+	case JSON_TRUE:
+	case JSON_FALSE:
+	case JSON_NULL:
+		return put_head(buf, value->type, name);
+	default:
+		return -1;
+	}
+}
+
+/**
+ * @brief: Encode the members of @object without a head of their own,
+ *         as the body of a request or reply.
+ */
+int memdb_tlv_put_members(struct memdb_tlv_buf *buf, json_t *object)
+{
+	json_pair_t *pair;
+
+	if (object == NULL || object->type != JSON_OBJECT)
+		return -1;
+
+	for (pair = json_to_object(object)->next; pair != NULL; pair = pair->next) {
+		if (memdb_tlv_put_json(buf, pair->name, pair->value))
+			return -1;
+	}
+
+	return 0;
+}
+
+struct tlv_reader {
+	char *data;
+	int len;
+	int off;
+};
+
+static int get_bytes(struct tlv_reader *r, void *p, int len)
+{
+	if (r->off + len > r->len)
+		return -1;
+
+	memcpy(p, r->data + r->off, len);
+	r->off += len;
+
+	return 0;
+}
+
+static json_t *get_value(struct tlv_reader *r, char *name, int depth);
+
+static int get_members(struct tlv_reader *r, json_t *parent, uint32 count, int depth)
+{
+	char name[256];
+	json_t *value;
+	uint32 i;
+
+	for (i = 0; i < count || count == (uint32)-1; i++) {
+		if (count == (uint32)-1 && r->off == r->len)
+			break;
+
+		value = get_value(r, name, depth);
+		if (value == NULL)
+			return -1;
+
+		if (parent->type == JSON_ARRAY) {
+			if (JSON_SUCCESS != json_array_add(parent, value)) {
+				json_free(value);
+				return -1;
+			}
+		} else if (JSON_SUCCESS != json_object_add(parent, name, value)) {
+			json_free(value);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static json_t *get_value(struct tlv_reader *r, char *name, int depth)
+{
+	uint8 type;
+	uint8 namelen;
+	uint32 len;
+	int64 integer;
+	double real;
+	char *str;
+	json_t *value = NULL;
+
+	if (depth > TLV_MAX_DEPTH ||
+		get_bytes(r, &type, 1) ||
+		get_bytes(r, &namelen, 1) ||
+		get_bytes(r, name, namelen))
+		return NULL;
+	name[namelen] = '\0';
+
+	switch (type) {
+	case JSON_INTEGER:
+		if (get_bytes(r, &integer, sizeof(integer)) == 0)
+			value = json_integer(integer);
+		break;
+	case JSON_REAL:
+		if (get_bytes(r, &real, sizeof(real)) == 0)
+			value = json_real(real);
+		break;
+	case JSON_STRING:
+		if (get_bytes(r, &len, sizeof(len)) || len > r->len - r->off)
+			break;
+		str = malloc(len + 1);
+		if (str == NULL)
+			break;
+		get_bytes(r, str, len);
+		str[len] = '\0';
+		value = json_string(str);
+		free(str);
+		break;
+	case JSON_OBJECT:
+	case JSON_ARRAY:
+		if (get_bytes(r, &len, sizeof(len)))
+			break;
+		value = (type == JSON_OBJECT) ? json_object() : json_array();
+		if (value != NULL && get_members(r, value, len, depth + 1)) {
+			json_free(value);
+			value = NULL;
+		}
+		break;
+	case JSON_TRUE:
+		value = json_true();
+		break;
+	case JSON_FALSE:
+		value = json_false();
+		break;
+	case JSON_NULL:
+		value = json_null();
+		break;
+	default:
+		break;
+	}
+
+	return value;
+}
+
+/**
+ * @brief: Decode a request or reply body into a new JSON object, so the
+ *         existing parameter and result helpers work on it unchanged.
+ */
+json_t *memdb_tlv_get_object(char *data, int len)
+{
+	struct tlv_reader r = {data, len, 0};
+	json_t *object = json_object();
+
+	if (object == NULL)
+		return NULL;
+
+	if (get_members(&r, object, (uint32)-1, 0)) {
+		json_free(object);
+		return NULL;
+	}
+
+	return object;
+}
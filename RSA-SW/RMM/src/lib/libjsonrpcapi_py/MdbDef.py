@@ -20,7 +20,10 @@ class CmdId:
 	CMD_LOCK 						= 14
 	CMD_UNLOCK 						= 15
 
-	CMD_MAX							= 16
+	CMD_ATTRBUTE_GET_MULTI			= 16
+	CMD_ATTRBUTE_SET_MULTI			= 17
+
+	CMD_MAX							= 18
 
 
 memdb_cmds = [(CmdId.CMD_DUMP_NODES, "dump_nodes"), 
@@ -38,7 +41,9 @@ memdb_cmds = [(CmdId.CMD_DUMP_NODES, "dump_nodes"),
 			(CmdId.CMD_NODE_GET_BY_NODE_ID, "node_get_by_node_id"),
 			(CmdId.CMD_NODE_CREATE_WITH_NODE_ID, "node_create_with_node_id"),
 			(CmdId.CMD_LOCK, "lock"),
-			(CmdId.CMD_UNLOCK, "unlock")]
+			(CmdId.CMD_UNLOCK, "unlock"),
+			(CmdId.CMD_ATTRBUTE_GET_MULTI, "attrbute_get_multi"),
+			(CmdId.CMD_ATTRBUTE_SET_MULTI, "attrbute_set_multi")]
 
 
 class MdbJKey(object):
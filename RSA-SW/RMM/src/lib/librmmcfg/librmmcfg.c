@@ -360,6 +360,71 @@ unsigned char rmm_cfg_get_flow_control()
 	return data[0];
 }
 
+int rmm_cfg_get_serial_framing(char *framing, int max_len)
+{
+	return get_str_attr(PROC_IPMI_MODULE, ATTR_IPMID_SERIAL_FRAMING, framing, max_len);
+}
+
+int rmm_cfg_get_serial_window(void)
+{
+	return get_int_attr(PROC_IPMI_MODULE, ATTR_IPMID_SERIAL_WINDOW);
+}
+
+int rmm_cfg_get_ipmb_window(void)
+{
+	return get_int_attr(PROC_IPMI_MODULE, ATTR_IPMID_IPMB_WINDOW);
+}
+
+int rmm_cfg_get_collect_interval(void)
+{
+	return get_int_attr(PROC_ASSETD, ATTR_COLLECT_INTERVAL);
+}
+
+int rmm_cfg_get_cooling_period(void)
+{
+	return get_int_attr(PROC_COOLING_CTRL, ATTR_COOLING_PERIOD);
+}
+
+int rmm_cfg_get_cooling_target(void)
+{
+	return get_int_attr(PROC_COOLING_CTRL, ATTR_COOLING_TARGET);
+}
+
+int rmm_cfg_get_cooling_aggregation(char *agg, int max_len)
+{
+	return get_str_attr(PROC_COOLING_CTRL, ATTR_COOLING_AGGREGATION, agg, max_len);
+}
+
+/* the gains are in thousandths */
+int rmm_cfg_get_cooling_pid(int *kp, int *ki, int *kd)
+{
+	*kp = get_int_attr(PROC_COOLING_CTRL, ATTR_COOLING_KP);
+	*ki = get_int_attr(PROC_COOLING_CTRL, ATTR_COOLING_KI);
+	*kd = get_int_attr(PROC_COOLING_CTRL, ATTR_COOLING_KD);
+
+	return (*kp < 0 || *ki < 0 || *kd < 0) ? -1 : 0;
+}
+
+int rmm_cfg_get_cooling_rate(void)
+{
+	return get_int_attr(PROC_COOLING_CTRL, ATTR_COOLING_RATE);
+}
+
+int rmm_cfg_get_event_queue_len(void)
+{
+	return get_int_attr(PROC_REDFISHD, ATTR_EVENT_QUEUE_LEN);
+}
+
+int rmm_cfg_get_event_batch(void)
+{
+	return get_int_attr(PROC_REDFISHD, ATTR_EVENT_BATCH);
+}
+
+int rmm_cfg_get_event_retry_max(void)
+{
+	return get_int_attr(PROC_REDFISHD, ATTR_EVENT_RETRY_MAX);
+}
+
 int rmm_cfg_get_vm_root_password(char *password, int max_len, int vm_idx)
 {
 	json_t *jvm;
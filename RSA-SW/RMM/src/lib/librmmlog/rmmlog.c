@@ -19,6 +19,7 @@
 #include <sys/socket.h>
 #include <stdarg.h>
 #include <errno.h>
+#include <stddef.h>
 
 #include "libutils/sock.h"
 #include "libutils/string.h"
@@ -42,7 +43,9 @@ static int send_rmm_log(const char *module_name, int level, const char *func, ch
 	strncpy_safe(evt.module_name, module_name, EVT_MODULE_LEN, EVT_MODULE_LEN - 1);
 	strncpy_safe(evt.fn_name, func, EVT_FN_LEN, EVT_FN_LEN - 1);
 	strncpy_safe(evt.msg, msg, EVT_MSG_LEN, EVT_MSG_LEN - 1);
-	return socket_send(rmm_logd_fd, &evt, sizeof(struct log_evt));
+
+	/* the message up to its end, not the whole buffer */
+	return socket_send(rmm_logd_fd, &evt, offsetof(struct log_evt, msg) + strlen(evt.msg) + 1);
 }
 
 int rmm_log_request(int level, const char *func, const char *fmt, ...)
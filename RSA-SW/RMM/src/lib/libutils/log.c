@@ -16,80 +16,163 @@
 #include <limits.h>
 #include <math.h>
 #include <pthread.h>
+#include <sys/mman.h>
 #include "libutils/types.h"
 #include "libutils/log.h"
 #include "libutils/string.h"
 
-static int get_seqid(const char *data, int max_len)
+static char *get_severity_by_level(const int level)
 {
-	int ret = 0;
-	char ch_id[256] = {0};
-	int len = (max_len < 256 ? max_len : 256 - 1);
-	strncpy_safe(ch_id, data, sizeof(ch_id), len);
-	char* temp = strtok(ch_id, " ");
+	if(level < LEVEL_MAX)
+		return log_severity[level];
+	return EVT_SEVERITY_OTHER;
+}
 
-	if (temp)
-		ret = (int)strtol(temp, NULL, 10);
-	else 
-		ret = 0;
+static void get_time_stamp(struct timeval *ts, char* out)
+{
+	struct tm *p;
+	time_t timep = ts->tv_sec;
 
-	return ret;
+	p = localtime(&timep); 
+	snprintf(out, MAX_PATH_SIZE, "%04d/%02d/%02d %02d:%02d:%02d.%06ld ",  p->tm_year + 1900,
+													p->tm_mon + 1,
+													p->tm_mday,
+													p->tm_hour,
+													p->tm_min,
+													p->tm_sec,
+													ts->tv_usec);
+	return;
 }
 
-static int get_last_line(const char *file_path, char *line)
+static size_t ring_size(unsigned int capacity)
 {
-	FILE *fd;
-	int ret;
+	return LOG_RING_HDR_SIZE + (size_t)capacity * LOG_RECORD_SIZE;
+}
 
-	if ((fd = fopen(file_path, "r")) != NULL) // open file
-	{
-		fseek(fd, 0, SEEK_SET); // make sure start from 0
+static struct log_record *record_at(struct log_ring_hdr *ring, unsigned long long seq)
+{
+	return (struct log_record *)((char *)ring + LOG_RING_HDR_SIZE +
+								 (seq % ring->capacity) * LOG_RECORD_SIZE);
+}
 
-		while(!feof(fd))
-		{
-			memset(line, 0x00, 256); // clean buffer
-			ret = fscanf(fd, "%255[^\n]\n", line); // read file *prefer using fscanf
-			if(ret == -1)
-				continue;
-		}
-		printf("Last Line :: %s\n", line);
-	}
-	return 0;
+static unsigned long long ring_first(struct log_ring_hdr *ring)
+{
+	if (ring->next_seq > ring->capacity)
+		return ring->next_seq - ring->capacity;
+	return 1;
 }
 
-static int get_log_last_index(const char *file_path)
+static int ring_valid(struct log_ring_hdr *ring, size_t size)
 {
-	char last_line[256] = {0};
-	/*Get the last index of current log file*/
-	get_last_line(file_path, last_line);
-	return get_seqid(last_line, 256 - 1);
+	return ring->magic == LOG_RING_MAGIC &&
+		   ring->version == LOG_RING_VERSION &&
+		   ring->record_size == LOG_RECORD_SIZE &&
+		   ring->capacity > 0 &&
+		   ring->next_seq > 0 &&
+		   size == ring_size(ring->capacity);
 }
 
-static char *get_severity_by_level(const int level)
+/* the records written after the last update of next_seq are complete */
+static void ring_recover(struct log_ring_hdr *ring)
 {
-	if(level < LEVEL_MAX)
-		return log_severity[level];
-	return EVT_SEVERITY_OTHER;
+	unsigned int i;
+
+	for (i = 0; i < ring->capacity; i++) {
+		if (record_at(ring, ring->next_seq)->seq != ring->next_seq)
+			break;
+		ring->next_seq++;
+	}
 }
 
-static void get_time_stamp(char* out)
+static struct log_ring_hdr *ring_map(const char *path, int flags, size_t size)
 {
-	struct tm *p;
-	struct timeval curr_ts;
+	struct log_ring_hdr *ring;
+	int fd;
 
-	gettimeofday(&curr_ts, NULL);
+	fd = open(path, flags, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH);
+	if (fd < 0)
+		return NULL;
 
-	time_t timep;
-	time(&timep); 
-	p = localtime(&timep); 
-	snprintf(out, MAX_PATH_SIZE, "%04d/%02d/%02d %02d:%02d:%02d.%06ld ",  p->tm_year + 1900,
-													p->tm_mon + 1,
-													p->tm_mday,
-													p->tm_hour,
-													p->tm_min,
-													p->tm_sec,
-													curr_ts.tv_usec);
-	return;
+	if ((flags & O_TRUNC) && ftruncate(fd, size) < 0) {
+		close(fd);
+		return NULL;
+	}
+
+	ring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ring == MAP_FAILED)
+		return NULL;
+
+	return ring;
+}
+
+/**
+ * @brief: Map the ring of the module with 'capacity' records, 0 to keep
+ * the capacity of an existing ring. A ring of another capacity is copied
+ * to a new file, the newest records are kept.
+ */
+static int ring_open(struct loginfo *phandler, unsigned int capacity)
+{
+	char tmp_path[MAX_PATH_SIZE + 8];
+	struct log_ring_hdr *old = NULL;
+	struct log_ring_hdr *ring = NULL;
+	unsigned long long seq;
+	struct stat sb;
+	size_t old_size = 0;
+
+	if (stat(phandler->logfile, &sb) == 0 && sb.st_size >= LOG_RING_HDR_SIZE) {
+		old_size = sb.st_size;
+		old = ring_map(phandler->logfile, O_RDWR, old_size);
+		if (old != NULL && !ring_valid(old, old_size)) {
+			munmap(old, old_size);
+			old = NULL;
+		}
+	}
+
+	if (capacity == 0)
+		capacity = old ? old->capacity : LOG_DFLT_MAX_LINES;
+
+	if (old != NULL && old->capacity == capacity) {
+		ring_recover(old);
+		ring = old;
+		goto mapped;
+	}
+
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", phandler->logfile);
+	ring = ring_map(tmp_path, O_RDWR | O_CREAT | O_TRUNC, ring_size(capacity));
+	if (ring == NULL) {
+		if (old)
+			munmap(old, old_size);
+		return -1;
+	}
+
+	ring->capacity = capacity;
+	ring->next_seq = 1;
+	if (old != NULL) {
+		ring_recover(old);
+		seq = ring_first(old);
+		if (old->next_seq - seq > capacity)
+			seq = old->next_seq - capacity;
+		for (; seq < old->next_seq; seq++)
+			memcpy(record_at(ring, seq), record_at(old, seq), LOG_RECORD_SIZE);
+		ring->next_seq = old->next_seq;
+		munmap(old, old_size);
+	}
+	ring->record_size = LOG_RECORD_SIZE;
+	ring->version = LOG_RING_VERSION;
+	ring->magic = LOG_RING_MAGIC;
+
+	if (rename(tmp_path, phandler->logfile) < 0) {
+		munmap(ring, ring_size(capacity));
+		return -1;
+	}
+
+mapped:
+	if (phandler->ring)
+		munmap(phandler->ring, phandler->ring_size);
+	phandler->ring = ring;
+	phandler->ring_size = ring_size(capacity);
+	return 0;
 }
 
 static void log_init_handler(struct loginfo *phandler)
@@ -105,126 +188,132 @@ static void log_init_handler(struct loginfo *phandler)
 		}
 	}
 
-	phandler->fd = open(phandler->logfile_curr, O_WRONLY | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR
-				  | S_IRGRP | S_IWGRP | S_IROTH);
-	assert(phandler->fd != -1);
-
-	phandler->curr_index = get_log_last_index(phandler->logfile_curr);
+	if (ring_open(phandler, 0) != 0) {
+		fprintf(stderr, "Failed to map %s\n", phandler->logfile);
+		exit(-1);
+	}
 }
 
-static void reversal_file(struct loginfo *phander)
+/* the line ends with a new line, even cut to LOG_LINE_SIZE */
+static void copy_line(char *line, struct log_record *rec)
 {
-	close(phander->fd);
-	
-	if (access(phander->logfile_old,F_OK) != 0) {
-		rename(phander->logfile_curr, phander->logfile_old);
-		phander->fd = open(phander->logfile_curr, O_WRONLY | O_CREAT| O_TRUNC, S_IRUSR | S_IWUSR
-				  | S_IRGRP | S_IWGRP | S_IROTH);
-		assert(phander->fd != -1);
-	}
-	else {
-		rename(phander->logfile_curr, phander->logfile_tmp);
-		rename(phander->logfile_old, phander->logfile_curr);
-		rename(phander->logfile_tmp, phander->logfile_old);
-		phander->fd = open(phander->logfile_curr, O_WRONLY | O_TRUNC, S_IRUSR | S_IWUSR
-				  | S_IRGRP | S_IWGRP | S_IROTH);
-		assert(phander->fd != -1);
-	}
+	int len = rec->len;
+
+	if (len > LOG_LINE_SIZE - 1) {
+		len = LOG_LINE_SIZE - 1;
+		memcpy(line, rec->text, len);
+		line[len - 1] = '\n';
+	} else
+		memcpy(line, rec->text, len);
+	line[len] = '\0';
 }
 
-static int get_log_from_file(int beg_line, char *path, char *data)
+static int copy_lines(struct log_ring_hdr *ring, unsigned long long from,
+					  unsigned long long to, char *data)
 {
-	int read_lines_count = 0;
-	FILE *pfile;
-	char *line = NULL;
-	size_t len = 0;
-	int index = 0;
-	int read = 0;
+	unsigned long long seq;
+	int count = 0;
 
-	pfile = fopen(path, "r");
-	if(!pfile) {
-		read_lines_count = 0;
-		goto expt_end;
-	}
-	while ((read = getline(&line, &len, pfile)) != -1) {
-		if(index >= beg_line)
-			memcpy(data + (index - beg_line) * 256, line, strlen(line));
-		index++;
-	}
-	read_lines_count = index - beg_line;
-	if (read_lines_count <=0)
-		read_lines_count = 0;
+	for (seq = from; seq < to; seq++)
+		copy_line(data + (count++) * LOG_LINE_SIZE, record_at(ring, seq));
 
-expt_end:
-	if(pfile)
-		fclose(pfile);
-	return read_lines_count;
+	return count;
 }
 
 void log_put(long handler, const int level, const char *func, const char *msg)
 {
-	va_list args;
 	char time_stamp[MAX_PATH_SIZE];
 	char *serverity;
-	char buf[MAX_LOG_MSG_SIZE] = {0};
+	struct log_record *rec;
+	struct timeval ts;
+	unsigned long long seq;
 	int len = 0;
 
 	struct loginfo *phandler = (struct loginfo *)handler;
-	if(level > phandler->level)
+	if(level > phandler->level || phandler->ring == NULL)
 		return;
 
-	get_time_stamp(time_stamp);
+	gettimeofday(&ts, NULL);
+	get_time_stamp(&ts, time_stamp);
 	serverity = get_severity_by_level(level);
 
-	phandler->curr_index++;
-	len = snprintf(buf, MAX_LOG_MSG_SIZE, "%010d %s[%s] %s: %s", phandler->curr_index, time_stamp, serverity, func, msg);
-	len = write(phandler->fd, buf, len);
-	if(len == -1)
-		return;
-	if (phandler->curr_index >= phandler->max_lines) {
-		reversal_file(phandler);
-		phandler->curr_index = 0;
-	}
+	seq = phandler->ring->next_seq;
+	rec = record_at(phandler->ring, seq);
+	rec->seq = 0;
+	__sync_synchronize();
+
+	len = snprintf(rec->text, sizeof(rec->text), "%010llu %s[%s] %s: %s", seq, time_stamp, serverity, func, msg);
+	if (len >= (int)sizeof(rec->text))
+		len = sizeof(rec->text) - 1;
+	rec->len = len;
+	rec->level = level;
+	rec->ts_us = ts.tv_sec * 1000000LL + ts.tv_usec;
+
+	/* a reader, or the next start after a crash, sees a complete record */
+	__sync_synchronize();
+	rec->seq = seq;
+	phandler->ring->next_seq = seq + 1;
 }
 
 int log_get(long handler, int last_count, char *data)
 {
-	int beg = 0;
-	int old_beg = 0;
-	int old_end = 0;
-	int is_in_old_file = 0;
-	int read_lines_count = 0;
-	int temp = 0;
 	struct loginfo* phandler = (struct loginfo*)handler;
-	
-	if (phandler->curr_index >= last_count) {
-		beg = phandler->curr_index - last_count;
-	} else {
-		old_end = get_log_last_index(phandler->logfile_old);
-		old_beg = old_end + last_count - phandler->curr_index;
-		if (old_beg < 0)
-			old_beg = 0;
-		is_in_old_file = 1;
-	}
+	struct log_ring_hdr *ring = phandler->ring;
+	unsigned long long first;
+
+	if (ring == NULL || last_count <= 0)
+		return 0;
 
-	if (is_in_old_file) {
-		read_lines_count = get_log_from_file(old_beg, phandler->logfile_old, data);
+	first = ring_first(ring);
+	if (ring->next_seq - first > (unsigned long long)last_count)
+		first = ring->next_seq - last_count;
+
+	return copy_lines(ring, first, ring->next_seq, data);
+}
+
+/* first record logged at or after ts_us, records are in time order */
+static unsigned long long lower_bound(struct log_ring_hdr *ring, long long ts_us)
+{
+	unsigned long long lo = ring_first(ring);
+	unsigned long long hi = ring->next_seq;
+	unsigned long long mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (record_at(ring, mid)->ts_us < ts_us)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
 
-	temp = get_log_from_file(beg, phandler->logfile_curr, data + read_lines_count * 256);
-	return read_lines_count + temp;
+	return lo;
+}
+
+int log_get_range(long handler, time_t from, time_t to, int max_count, char *data)
+{
+	struct loginfo* phandler = (struct loginfo*)handler;
+	struct log_ring_hdr *ring = phandler->ring;
+	unsigned long long first, last;
+
+	if (ring == NULL || max_count <= 0 || from >= to)
+		return 0;
+
+	first = lower_bound(ring, from * 1000000LL);
+	last = lower_bound(ring, to * 1000000LL);
+	if (last - first > (unsigned long long)max_count)
+		last = first + max_count;
+
+	return copy_lines(ring, first, last, data);
 }
 
 static void set_path_by_module_name(struct loginfo *phandler, const char *module_name)
 {
-	snprintf(phandler->logfile_curr, MAX_PATH_SIZE, "/var/log/%s/logfile", module_name);
-	snprintf(phandler->logfile_tmp, MAX_PATH_SIZE, "/var/log/%s/logfile_tmp", module_name);
-	snprintf(phandler->logfile_old, MAX_PATH_SIZE, "/var/log/%s/logfile_old", module_name);
+	snprintf(phandler->logfile, MAX_PATH_SIZE, "/var/log/%s/logring", module_name);
 }
 
 long log_init(const char *module_name)
 {
-	struct loginfo* phandler = (struct loginfo*)malloc(sizeof(struct loginfo));
+	struct loginfo* phandler = (struct loginfo*)calloc(1, sizeof(struct loginfo));
 	set_path_by_module_name(phandler, module_name);
 	strncpy_safe(phandler->module, module_name, MAX_PATH_SIZE, MAX_PATH_SIZE - 1);
 	log_init_handler(phandler);
@@ -242,11 +331,15 @@ void log_set_max_lines(long handler, int max_lines)
 {
 	struct loginfo* phandler = (struct loginfo*)handler;
 	phandler->max_lines= max_lines;
+	if (max_lines > 0 && phandler->ring && phandler->ring->capacity != (unsigned int)max_lines)
+		ring_open(phandler, max_lines);
 	printf("%s[%s]%s:max_num=%d\n", COLOR_LIGHT_CYAN, phandler->module, COLOR_NONE, phandler->max_lines);
 }
 
 void log_close(long handler)
 {
 	struct loginfo* phandler = (struct loginfo*)handler;
+	if (phandler->ring)
+		munmap(phandler->ring, phandler->ring_size);
 	free(phandler);
 }
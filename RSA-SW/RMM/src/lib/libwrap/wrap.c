@@ -69,13 +69,110 @@ static void* wrap_ipmi_thread(void *argv);
 static result_t check_module_capability(char *module, char *cap_name);
 
 #define DEFAULT_MASK 		0xFFFF
+
+#define PREFETCH_NODES		4
+
+/*
+ * Attributes of the last nodes read by this thread inside a
+ * prefetch_begin()/prefetch_end() scope, fetched in one memdb
+ * round trip per node instead of one per attribute. Readers going
+ * back and forth between a node and its parent or its asset node
+ * keep hitting the nodes fetched before.
+ */
+struct prefetch_node {
+	int valid;
+	unsigned char db_name;
+	memdb_integer node_id;
+	int size;
+	memdb_integer attrs[CMDBUFSIZ/sizeof(long)];
+};
+
+struct attr_prefetch {
+	int depth;
+	int used;
+	int next;
+	struct prefetch_node nodes[PREFETCH_NODES];
+};
+
+static __thread struct attr_prefetch *prefetch;
+
+static void prefetch_begin(void)
+{
+	if (prefetch == NULL)
+		prefetch = calloc(1, sizeof(struct attr_prefetch));
+
+	if (prefetch != NULL)
+		prefetch->depth++;
+}
+
+static void prefetch_end(void)
+{
+	if (prefetch != NULL && --prefetch->depth == 0) {
+		free(prefetch);
+		prefetch = NULL;
+	}
+}
+
+static struct prefetch_node *prefetch_get_node(unsigned char db_name, memdb_integer node_id)
+{
+	struct prefetch_node *pn = NULL;
+	int i = 0;
+
+	for (i = 0; i < prefetch->used; i++) {
+		pn = &prefetch->nodes[i];
+		if (pn->db_name == db_name && pn->node_id == node_id)
+			return pn;
+	}
+
+	/* replace the node fetched first once all are used */
+	pn = &prefetch->nodes[prefetch->next];
+	prefetch->next = (prefetch->next + 1) % PREFETCH_NODES;
+	if (prefetch->used < PREFETCH_NODES)
+		prefetch->used++;
+
+	pn->size = sizeof(pn->attrs);
+	pn->valid = (libdb_attr_get_multi(db_name, node_id, NULL, 0, 0,
+							pn->attrs, &pn->size, LOCK_ID_NULL) == 0);
+	pn->db_name = db_name;
+	pn->node_id = node_id;
+
+	return pn;
+}
+
+static int64 read_attr_string(unsigned char db_name, memdb_integer node_id, char *name, char *output, int64 len)
+{
+	struct prefetch_node *pn = NULL;
+	char *data = NULL;
+
+	if (prefetch != NULL) {
+		pn = prefetch_get_node(db_name, node_id);
+
+		/*
+		 * A missing attribute reads as an empty string, as with
+		 * libdb_attr_get_string(); an oversized one goes through it
+		 * below so the error is reported the usual way.
+		 */
+		if (pn->valid) {
+			data = libdb_attr_find(pn->attrs, pn->size, node_id, name);
+			if (data == NULL)
+				return 0;
+			if (strlen(data) < len) {
+				strncpy_safe(output, data, len, len - 1);
+				return 0;
+			}
+		}
+	}
+
+	return libdb_attr_get_string(db_name, node_id, name, output, len, LOCK_ID_NULL);
+}
+
 static int get_db_info_num(unsigned char db_name, memdb_integer node_id, char* name)
 {
 	char result[128] = {0};
 	char* offset;
 	int64 error_code = 0;
 
-	error_code = libdb_attr_get_string(db_name, node_id, name, result, 128, LOCK_ID_NULL);
+	error_code = read_attr_string(db_name, node_id, name, result, 128);
 	if(error_code != 0) {
 		printf("getting %s from memdb error, code is %llu\n", name, error_code);
 	}
@@ -353,7 +450,7 @@ static int get_db_info_string(unsigned char db_name, memdb_integer node_id, char
 	char* offset;
 	int64 error_code = 0;
 
-	error_code = libdb_attr_get_string(db_name, node_id, name, result, 128, LOCK_ID_NULL);
+	error_code = read_attr_string(db_name, node_id, name, result, 128);
 
 	if(error_code != 0) {
 		return (int)error_code;
@@ -508,6 +605,8 @@ static int get_drawer_pres_from_cm(char *pres)
 
 result_t libwrap_get_rack(rack_info_t *rack_info)
 {
+	prefetch_begin();
+
 	get_base_element(&rack_info->be, DB_RMM, MC_TYPE_RMC);
 
 	rack_info->rack_puid = get_db_info_num(DB_RMM, MC_TYPE_RMC,
@@ -543,6 +642,7 @@ result_t libwrap_get_rack(rack_info_t *rack_info)
 	memset(rack_info->pod, 0, REST_RACK_STRING_LEN);
     memcpy(rack_info->pod, "N/A", strlen("N/A"));
 	#endif
+	prefetch_end();
 	return RESULT_OK;
 }
 
@@ -576,53 +676,19 @@ result_t libwrap_pre_put_rack(put_rack_info_t *put_rack_info)
 result_t libwrap_put_rack(const put_rack_info_t put_rack_info)
 {
 	char buff[32] = {0};
-	int rc = 0;
-
-	rc = libdb_attr_set_string(DB_RMM, MC_TYPE_RMC, RACK_DESCRIPT_STR,
-						  0x0, (char*)put_rack_info.descr, SNAPSHOT_NEED, LOCK_ID_NULL);
-	if (rc == -1) {
-		return RESULT_ATTR_ERR;
-	}
-
-	rc = libdb_attr_set_string(DB_RMM, MC_TYPE_RMC, RACK_GEOTAG_STR,
-						  0x0, (char*)put_rack_info.geo_tag, SNAPSHOT_NEED, LOCK_ID_NULL);
-	if (rc == -1) {
-		return RESULT_ATTR_ERR;
-	}
-
-	rc = libdb_attr_set_string(DB_RMM, MC_TYPE_RMC, RACK_PODM_ADDR_STR,
-						  0x0, (char*)put_rack_info.podm_addr, SNAPSHOT_NEED, LOCK_ID_NULL);
-	if (rc == -1) {
-		return RESULT_ATTR_ERR;
-	}
-
-	rc = libdb_attr_set_string(DB_RMM, MC_TYPE_RMC, POD_DCUID_STR,
-						  0x0, (char*)put_rack_info.pod_dcuid, SNAPSHOT_NEED, LOCK_ID_NULL);
-	if (rc == -1) {
-		return RESULT_ATTR_ERR;
-	}
-	rc = libdb_attr_set_string(DB_RMM, MC_TYPE_RMC, RACK_ASSET_TAG_STR,
-						  0x0, (char*)put_rack_info.asset_tag, SNAPSHOT_NEED, LOCK_ID_NULL);
-	if (rc == -1) {
-		return RESULT_ATTR_ERR;
-	}
-
-	rc = libdb_attr_set_string(DB_RMM, MC_TYPE_RMC, RACK_ASSET_TAG_STR,
-						  0x0, (char*)put_rack_info.asset_tag, SNAPSHOT_NEED, LOCK_ID_NULL);
-	if (rc == -1) {
-		return RESULT_ATTR_ERR;
-	}
+	struct attr_set_entry attrs[] = {
+		{RACK_DESCRIPT_STR, (char*)put_rack_info.descr, 0x0},
+		{RACK_GEOTAG_STR, (char*)put_rack_info.geo_tag, 0x0},
+		{RACK_PODM_ADDR_STR, (char*)put_rack_info.podm_addr, 0x0},
+		{POD_DCUID_STR, (char*)put_rack_info.pod_dcuid, 0x0},
+		{RACK_ASSET_TAG_STR, (char*)put_rack_info.asset_tag, 0x0},
+		{RACK_PUID_STR, buff, 0x0},
+		{RACK_LOC_ID_STR, buff, 0x0},
+	};
 
 	snprintf(buff, sizeof(buff), "%d", (int32)put_rack_info.rack_puid);
-	rc = libdb_attr_set_string(DB_RMM, MC_TYPE_RMC, RACK_PUID_STR,
-						  0x0, buff, SNAPSHOT_NEED, LOCK_ID_NULL);
-	if (rc == -1) {
-		return RESULT_ATTR_ERR;
-	}
-
-	rc = libdb_attr_set_string(DB_RMM, MC_TYPE_RMC, RACK_LOC_ID_STR,
-						  0x0, buff, SNAPSHOT_NEED, LOCK_ID_NULL);
-	if (rc == -1) {
+	if (libdb_attr_set_multi(DB_RMM, MC_TYPE_RMC, attrs, sizeof(attrs)/sizeof(attrs[0]),
+							 SNAPSHOT_NEED, LOCK_ID_NULL) == -1) {
 		return RESULT_ATTR_ERR;
 	}
 
@@ -811,7 +877,13 @@ static int get_fan_by_idx(uint32 tzone_idx, uint32 fan_idx, struct fan_member *f
 
 result_t libwrap_get_tzone_fan_by_idx(uint32 tzone_idx, uint32 fan_idx, struct fan_member *fan_member)
 {
-	return get_fan_by_idx(tzone_idx, fan_idx, fan_member);
+	result_t rc;
+
+	prefetch_begin();
+	rc = get_fan_by_idx(tzone_idx, fan_idx, fan_member);
+	prefetch_end();
+
+	return rc;
 }
 
 result_t libwrap_pre_put_fan(uint32 tzone_idx, uint32 fan_idx, put_fan_t *put_fan_info)
@@ -1112,7 +1184,13 @@ static int get_tzone_by_id(uint32 tzone_idx, struct tzone_member *cz_member)
 
 result_t libwrap_get_tzone_by_idx(uint32 tzone_idx, struct tzone_member *tzone_member)
 {
-	return get_tzone_by_id(tzone_idx, tzone_member);
+	result_t rc;
+
+	prefetch_begin();
+	rc = get_tzone_by_id(tzone_idx, tzone_member);
+	prefetch_end();
+
+	return rc;
 }
 
 static result_t get_thermalzone_collection(collections_t* tzone, uint32 *number)
@@ -1168,38 +1246,14 @@ static result_t get_thermalzone_collection(collections_t* tzone, uint32 *number)
 result_t libwrap_get_node_id_by_uuid(unsigned char *uuid,
 									 memdb_integer *node_id)
 {
-	struct node_info *n = NULL;
-	int node_num = 0;
-	int i = 0;
-	void *attr = NULL;
-	struct attr_info *attr_info = NULL;
-	int attr_info_offset = 0;
-	int size = 0;
-	char attr_name[256] = {0};
-	char attr_data[256] = {0};
-
-	n = libdb_list_node_by_type(DB_RMM, MC_TYPE_DRAWER, MC_TYPE_DRAWER, &node_num, NULL, LOCK_ID_NULL);
-	for (i = 0; i < node_num; i++) {
-		attr = libdb_list_attrs_by_node(DB_RMM, n[i].node_id, &size, LOCK_ID_NULL);
-
-		foreach_attr_info(attr_info, attr_info_offset, attr, size) {
-			memset(attr_name, 0, 256);
-			memset(attr_data, 0, 256);
+	struct node_info n;
 
-			memcpy(attr_name, (char *)attr_info->elems, attr_info->data_offset);
-			memcpy(attr_data, (char *)attr_info->elems + attr_info->data_offset,
-				   attr_info->data_len);
-
-			if (strcmp((char *)uuid, attr_data) == 0) {
-				*node_id = n[i].node_id;
-				libdb_free_node(n);
-				return 0;
-			}
-		}
-	}
+	if (libdb_find_node_by_attr(DB_RMM, DRAWER_UUID_STR, (char *)uuid, &n, LOCK_ID_NULL) != 0 ||
+		n.type != MC_TYPE_DRAWER)
+		return -1;
 
-	libdb_free_node(n);
-	return -1;
+	*node_id = n.node_id;
+	return 0;
 }
 
 static int get_dzone_by_id(uint32 rack_dzone_idx, struct dzone_member *dz_number)
@@ -1292,7 +1346,13 @@ static result_t get_drawerzone_collection(collections_t* dzone, uint32 *number)
 
 result_t libwrap_get_dzone_by_idx(uint32 tzone_idx, dzone_member_t *tzone_member)
 {
-	return get_dzone_by_id(tzone_idx, tzone_member);
+	result_t rc;
+
+	prefetch_begin();
+	rc = get_dzone_by_id(tzone_idx, tzone_member);
+	prefetch_end();
+
+	return rc;
 }
 
 
@@ -1542,7 +1602,13 @@ result_t check_asset_module_capability(char *cap_name)
 
 result_t libwrap_get_drawer_by_idx(int32 dzone_idx, int32 drawer_idx, drawer_member_t *drawer_member)
 {
-	return get_drawer_by_idx(dzone_idx, drawer_idx, drawer_member);
+	result_t rc;
+
+	prefetch_begin();
+	rc = get_drawer_by_idx(dzone_idx, drawer_idx, drawer_member);
+	prefetch_end();
+
+	return rc;
 }
 
 result_t cm_hard_reset(int cm_idx, int *result)
@@ -1840,7 +1906,13 @@ static int get_mbp_by_idx(int idx, mbp_member_t *mbp_member)
 
 result_t libwrap_get_mbp_by_idx(int idx, mbp_member_t *mbp_member)
 {
-	return get_mbp_by_idx(idx, mbp_member);
+	result_t rc;
+
+	prefetch_begin();
+	rc = get_mbp_by_idx(idx, mbp_member);
+	prefetch_end();
+
+	return rc;
 }
 
 static result_t get_mbp_coll(collections_t *mbp, uint32 *number)
@@ -1992,7 +2064,13 @@ static int get_pzone_by_idx(uint32 pzone_idx, struct pzone_member *pzone_member)
 
 result_t libwrap_get_pzone_by_idx(uint32 pzone_idx, struct pzone_member *pzone_member)
 {
-	return get_pzone_by_idx(pzone_idx, pzone_member);
+	result_t rc;
+
+	prefetch_begin();
+	rc = get_pzone_by_idx(pzone_idx, pzone_member);
+	prefetch_end();
+
+	return rc;
 }
 
 result_t libwrap_pre_put_pzone_by_idx(int pzone_idx, put_pzone_t *put_pzone_info)
@@ -2354,7 +2432,13 @@ static int get_psu_by_idx(const uint32 pzone_idx, const uint32 psu_idx,  struct
 
 result_t libwrap_get_pzone_psu_by_idx(const uint32 pzone_idx, const uint32 psu_idx,  struct psu_member * psu_member)
 {
-	return get_psu_by_idx(pzone_idx, psu_idx, psu_member);
+	result_t rc;
+
+	prefetch_begin();
+	rc = get_psu_by_idx(pzone_idx, psu_idx, psu_member);
+	prefetch_end();
+
+	return rc;
 }
 
 memdb_integer get_subnode_id_by_lid(unsigned int lid, memdb_integer parent, int type)
@@ -16,6 +16,10 @@
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/un.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <pthread.h>
 #include <unistd.h>
 #include <stdio.h>
@@ -32,6 +36,8 @@
 
 /** application socket fd */
 static struct fd_event      app_fd_event;
+/** unix socket of the binary requests, see libjipmi/jipmi_bin.h */
+static struct fd_event      app_bin_fd_event;
 
 /**
   *  @brief deliver socket msg to applications
@@ -51,6 +57,65 @@ static inline int open_app_interface(void)
 	return create_udp_listen(INADDR_LOOPBACK, port, 0, 0);
 }
 
+/**
+  *  @brief open the unix socket of the binary requests, ipmi_module still
+  *         works on JSON RPC without it
+  *
+  *  @param
+  *  @return socket fd
+  */
+static int open_app_bin_interface(void)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, JIPMI_BIN_SOCK, sizeof(addr.sun_path) - 1);
+	unlink(JIPMI_BIN_SOCK);
+
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		IPMI_LOG_ERR("create %s error: %s\n", JIPMI_BIN_SOCK, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/**
+  *  @brief deliver the response of a binary request, the header and the
+  *         raw data in one datagram
+  *
+  *  @param[in] msg socket msg
+  *  @param[in] header request header
+  *  @return
+  */
+static void deliver_app_bin_msg_to_user(struct app_msg_hdr *msg, ipmi_json_ipc_header_t header)
+{
+	struct jipmi_bin_hdr hdr;
+	struct iovec iov[2];
+	struct sockaddr_un dest;
+	struct msghdr mh;
+	int i;
+
+	memset(&mh, 0, sizeof(mh));
+	if (app_bin_user_addr(header, &dest, &mh.msg_namelen) != 0 ||
+		format_app_bin_to_user(iov, &hdr, header, msg) != 0)
+		return;
+
+	mh.msg_name = &dest;
+	mh.msg_iov = iov;
+	mh.msg_iovlen = 2;
+
+	i = sendmsg(app_bin_fd_event.fd, &mh, 0);
+	rmm_log(DBG, "send to binary user %s: %d\n", header.method + 1, i);
+}
+
 /**
   *  @brief deliver socket msg to applications
   *
@@ -65,6 +130,11 @@ void deliver_app_msg_to_user(struct app_msg_hdr *msg, unsigned short port, ipmi_
 	int len = 0;
 	int i = 0;
 
+	if (header.method[0] == JIPMI_BIN_ADDR_MARK) {
+		deliver_app_bin_msg_to_user(msg, header);
+		return;
+	}
+
 	memset(&dest, 0, sizeof(dest));
 	dest.sin_family = AF_INET;
 	dest.sin_port = htons(port);
@@ -106,7 +176,7 @@ static void handle_app_msg(struct app_recv_msg *msg)
 		if (ipmi->addr.type == IPMI_ADDR_TYPE_IPMB)
 			deliver_ipmi_msg_by_ipmb(ipmi);
 		else if (ipmi->addr.type == IPMI_ADDR_TYPE_RMCP)
-			deliver_ipmi_msg_by_rmcp(ipmi);
+			rmcp_queue_outbound_msg(ipmi);
 		else if (ipmi->addr.type == IPMI_ADDR_TYPE_SERIAL) {
 			if ((ipmi->msg.union_app_req.serial.serial_flag == IPMI_SERIAL_OPEN_DEV)
 				|| (ipmi->msg.union_app_req.serial.serial_flag == IPMI_SERIAL_CLOSE_DEV))
@@ -150,6 +220,39 @@ static void app_recv_inbound_msg(int fd)
 	}
 }
 
+/**
+  *  @brief receive binary requests from applications
+  *
+  *  @param[in] fd socket fd
+  *  @return
+  */
+static void app_bin_recv_inbound_msg(int fd)
+{
+	unsigned char buffer[JIPMI_BIN_MAX_LEN];
+	struct jipmi_bin_hdr *hdr = (struct jipmi_bin_hdr *)buffer;
+	struct sockaddr_un from;
+	socklen_t from_len;
+	int rc;
+
+	for (;;) {
+		from_len = sizeof(from);
+		rc = recvfrom(fd, buffer, sizeof(buffer), 0, (struct sockaddr *)&from, &from_len);
+		if (rc <= 0)
+			return;
+
+		if (rc == sizeof(*hdr) && hdr->type == JIPMI_BIN_HELLO) {
+			/* the client checks the version, and falls back to JSON RPC */
+			hdr->version = JIPMI_BIN_VERSION;
+			sendto(fd, hdr, sizeof(*hdr), 0, (struct sockaddr *)&from, from_len);
+		} else {
+			struct app_recv_msg dest_msg = {0};
+
+			if (app_bin_parse(buffer, rc, &from, from_len, (char *)&dest_msg.appmsg) == 0)
+				handle_app_msg(&dest_msg);
+		}
+	}
+}
+
 /**
   *  @brief start application interface
   *
@@ -165,6 +268,12 @@ void ipmi_init(void)
 	app_fd_event.handle_fd = app_recv_inbound_msg;
 	fd_event_add(&app_fd_event);
 
+	app_bin_fd_event.fd = open_app_bin_interface();
+	if (app_bin_fd_event.fd != -1) {
+		app_bin_fd_event.handle_fd = app_bin_recv_inbound_msg;
+		fd_event_add(&app_bin_fd_event);
+	}
+
 	IPMI_LOG_INFO("APP-Intf is started successfully!\n");
 }
 
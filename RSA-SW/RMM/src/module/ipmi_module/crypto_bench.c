@@ -0,0 +1,196 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+#include "rmcp.h"
+#include "ipmi20_crypto.h"
+
+/*
+ * Packets/sec of the RMCP+ outbound packet path, AES-CBC-128 encryption
+ * of the payload and HMAC-SHA1-96 of the session trailer, with the keyed
+ * contexts of the session against contexts set up for every packet.
+ *
+ *     ipmicryptobench [-n packets] [-s payload size]
+ */
+#define DEFAULT_PACKETS		200000
+#define DEFAULT_SIZE		32
+
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void usage(char *name)
+{
+	printf("usage: %s [-n packets] [-s payload size]\n", name);
+	exit(-1);
+}
+
+/**
+  *  @brief encrypt and sign a packet as done before the contexts were kept
+  *         by the session, the reference of the cached path.
+  */
+static int packet_per_ctx(struct ipmi_session *sess, unsigned char *data, int data_len,
+						  unsigned char *out)
+{
+	EVP_CIPHER_CTX *ctx;
+	unsigned char pad_input[IPMI_MAX_MSG_LENGTH + IPMI20_CRYPT_BLOCK_SIZE];
+	unsigned int auth_len = 0;
+	int pad_len, len = 0, len_tmp = 0, i;
+
+	pad_len = (data_len + 1) % IPMI20_CRYPT_BLOCK_SIZE;
+	if (pad_len != 0)
+		pad_len = IPMI20_CRYPT_BLOCK_SIZE - pad_len;
+	memcpy(pad_input, data, data_len);
+	for (i = 0; i < pad_len; i++)
+		pad_input[data_len + i] = i + 1;
+	pad_input[data_len + pad_len] = pad_len;
+
+	ipmi20_random(out, IPMI20_CRYPT_BLOCK_SIZE);
+
+	ctx = EVP_CIPHER_CTX_new();
+	EVP_EncryptInit_ex(ctx, EVP_aes_128_cbc(), NULL, sess->key_k2, out);
+	EVP_CIPHER_CTX_set_padding(ctx, 0);
+	EVP_EncryptUpdate(ctx, out + IPMI20_CRYPT_BLOCK_SIZE, &len, pad_input, data_len + pad_len + 1);
+	EVP_EncryptFinal_ex(ctx, out + IPMI20_CRYPT_BLOCK_SIZE + len, &len_tmp);
+	EVP_CIPHER_CTX_free(ctx);
+	len += len_tmp + IPMI20_CRYPT_BLOCK_SIZE;
+
+	HMAC(EVP_sha1(), sess->key_k1, 20, out, len, out + len, &auth_len);
+
+	return len + 12;
+}
+
+static int packet_cached(struct ipmi_session *sess, unsigned char *data, int data_len,
+						 unsigned char *out)
+{
+	unsigned char auth_code[EVP_MAX_MD_SIZE];
+	int len;
+
+	len = ipmi20_payload_encrypt(sess, data, data_len, out);
+	if (len < 0 || ipmi20_integrity_code(&sess->crypto, out, len, auth_code) != 20)
+		return -1;
+
+	memcpy(out + len, auth_code, 12);
+	return len + 12;
+}
+
+/**
+  *  @brief check that the cached contexts give what a fresh context gives,
+  *         and that a session buffer re-keyed with other keys works.
+  */
+static int check(struct ipmi_session *sess, unsigned char *data, int data_len)
+{
+	struct rmcp_plus_ipmi_info info;
+	unsigned char out[IPMI20_CRYPT_MAX_LEN(IPMI_MAX_MSG_LENGTH) + EVP_MAX_MD_SIZE];
+	unsigned char plain[IPMI20_CRYPT_MAX_LEN(IPMI_MAX_MSG_LENGTH)];
+	unsigned char auth_code[EVP_MAX_MD_SIZE];
+	unsigned int auth_len = 0;
+	int len, round;
+
+	for (round = 0; round < 2; round++) {
+		memset(sess->key_k1, 0x11 + round, sizeof(sess->key_k1));
+		memset(sess->key_k2, 0x22 + round, sizeof(sess->key_k2));
+		if (ipmi20_crypto_set_keys(&sess->crypto, INTEGRITY_ALG_HMAC_SHA1_96, sess->key_k1,
+								   CRYPT_ALG_AES_CBC_128, sess->key_k2) != 0)
+			return -1;
+
+		len = packet_cached(sess, data, data_len, out);
+		if (len < 0)
+			return -1;
+		len -= 12;
+
+		HMAC(EVP_sha1(), sess->key_k1, 20, out, len, auth_code, &auth_len);
+		if (memcmp(out + len, auth_code, 12) != 0)
+			return -1;
+
+		memset(&info, 0, sizeof(info));
+		info.ipmi_data = out;
+		info.ipmi_data_len = len;
+		if (ipmi20_payload_decrypt(sess, &info, plain) != data_len ||
+			memcmp(plain, data, data_len) != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static struct ipmi_session sess;
+	unsigned char data[IPMI_MAX_MSG_LENGTH];
+	unsigned char out[IPMI20_CRYPT_MAX_LEN(IPMI_MAX_MSG_LENGTH) + EVP_MAX_MD_SIZE];
+	int packets = DEFAULT_PACKETS;
+	int size = DEFAULT_SIZE;
+	double start, per_ctx, cached;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+		switch (opt) {
+		case 'n':
+			packets = atoi(optarg);
+			break;
+		case 's':
+			size = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (packets <= 0 || size <= 0 || size > IPMI_MAX_MSG_LENGTH)
+		usage(argv[0]);
+
+	for (i = 0; i < size; i++)
+		data[i] = i;
+
+	sess.integrity_alg = INTEGRITY_ALG_HMAC_SHA1_96;
+	sess.crypt_alg = CRYPT_ALG_AES_CBC_128;
+	ipmi20_crypto_init(&sess.crypto);
+
+	if (check(&sess, data, size) != 0) {
+		printf("the cached contexts do not match a fresh context\n");
+		return -1;
+	}
+
+	start = now_sec();
+	for (i = 0; i < packets; i++)
+		packet_per_ctx(&sess, data, size, out);
+	per_ctx = now_sec() - start;
+
+	start = now_sec();
+	for (i = 0; i < packets; i++)
+		packet_cached(&sess, data, size, out);
+	cached = now_sec() - start;
+
+	printf("%d packets of %d bytes, AES-CBC-128 + HMAC-SHA1-96\n", packets, size);
+	printf("context per packet  %10.0f packets/s\n", packets / per_ctx);
+	printf("session contexts    %10.0f packets/s\n", packets / cached);
+
+	ipmi20_crypto_free(&sess.crypto);
+
+	return 0;
+}
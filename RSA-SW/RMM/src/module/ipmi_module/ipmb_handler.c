@@ -24,12 +24,16 @@
 #include "libutils/list.h"
 #include "ipmi.h"
 #include "ipmi_log.h"
+#include "ipmi_timer.h"
+#include "ipmi_window.h"
+#include "librmmcfg/rmm_cfg.h"
 #include "rmcp.h"
 
 #define IPMB_REQ_MIN_LEN		7
 #define IPMB_RSP_MIN_LEN		8
 
 #define IPMB_RSPHNDL_QUEUE_SIZE	256
+#define IPMB_SA_NUM				256
 
 /**
   *  @brief IPMB: 2.6.1 The Seq Field and Retries:
@@ -55,7 +59,6 @@ struct rsp_ipmb_hndl {
 
 
 	struct list_head seq_list;	/** link in 'seq_table[i]' list */
-	struct list_head list;		/** all ipmb response handle in 'all_hndls' list */
 
 	struct ipmb_match_info match;
 	unsigned int           msgid;
@@ -64,75 +67,78 @@ struct rsp_ipmb_hndl {
 #ifdef DEBUG_IPMI
 	struct timespec start_time;
 #endif
-	unsigned int   timeout;
+	struct ipmi_timer timer;
 	int            broadcast;
 };
 
 struct rsp_ipmb_table {
-	pthread_mutex_t  lock;
+	struct ipmi_lock lock;
 
 	struct rsp_ipmb_hndl *freelist;
 
 	unsigned int     curr_seq;
-	struct list_head all_hndls;
+	struct ipmi_timer_wheel wheel;
 	struct list_head seq_table[IPMB_SEQ_SIZE];	/** Fast indexed handle by seq */
-
-	pthread_t time_tid;
+	struct ipmi_window window[IPMB_SA_NUM];	/** requests in flight by slave address */
 };
 
 static struct rsp_ipmb_table ipmb_rsp_table;
 
+static int send_ipmb_req(struct appmsg_ipmi_msg *msg);
+
 /**
-  *  @brief IPMB timeout monitor thread
+  *  @brief give back a window slot of a slave, and send the next queued
+  *         request in it
   *
-  *  @param[in] unused
+  *  @param[in] win send window of the slave, the table lock held
   *  @return
   */
-static void *ipmb_time_thread(void *unused)
+static void ipmb_window_next(struct ipmi_window *win)
 {
-	struct timespec expire;
-	struct rsp_ipmb_hndl *hndl, *nxt;
-	struct rsp_ipmb_table *table = &ipmb_rsp_table;
-	pthread_cond_t nul_cond = PTHREAD_COND_INITIALIZER;
+	struct ipmi_window_req *req;
+	int rc;
 
-	prctl(PR_SET_NAME, "ipmb_time_thread");
+	while ((req = ipmi_window_put(win)) != NULL) {
+		rc = send_ipmb_req(&req->msg);
+		free(req);
+		if (rc == 0)
+			break;
+	}
+}
 
-	for (; ipmi_module_exit == false;) {
-		clock_gettime(CLOCK_REALTIME, &expire);
-		expire.tv_sec += IPMI_PERIOD_TIME_MS;
-		expire.tv_nsec += (IPMI_PERIOD_TIME_MS % 1000) * (1000*1000);
-		if (expire.tv_nsec >= BILLION) {
-			expire.tv_sec += expire.tv_nsec / BILLION;
-			expire.tv_nsec %= BILLION;
-		}
+static void free_ipmb_hndl(struct rsp_ipmb_hndl *hndl)
+{
+	struct rsp_ipmb_table *table = &ipmb_rsp_table;
 
-		pthread_mutex_lock(&table->lock);
-		while (pthread_cond_timedwait(&nul_cond, &table->lock, &expire) != ETIMEDOUT)
-			/* Nothing! */;
+	list_del(&hndl->seq_list);
+	ipmi_timer_del(&hndl->timer);
 
-#ifdef DEBUG_IPMI
-		clock_gettime(CLOCK_REALTIME, &expire);
-#endif
-		list_for_each_entry_safe(hndl, nxt, &table->all_hndls, list) {
-			hndl->timeout -= IPMI_PERIOD_TIME_MS;
-			if (hndl->timeout > 0)
-				continue;
+	hndl->next = table->freelist;
+	table->freelist = hndl;
 
-			IPMI_LOG_DEBUG("IPMB(%02X:%02X) Response handle timeout %ld:%ld -> %ld:%ld\n",
-						   hndl->match.netfn, hndl->match.cmd,
-						   hndl->start_time.tv_sec, hndl->start_time.tv_nsec,
-						   expire.tv_sec, expire.tv_nsec);
+	ipmb_window_next(&table->window[hndl->match.sa]);
+}
 
-			list_del(&hndl->list);
-			list_del(&hndl->seq_list);
+/**
+  *  @brief IPMB response handle timeout
+  *
+  *  @param[in] timer handle timer
+  *  @return
+  */
+static void ipmb_hndl_expired(struct ipmi_timer *timer)
+{
+	struct rsp_ipmb_hndl *hndl = container_of(timer, struct rsp_ipmb_hndl, timer);
+#ifdef DEBUG_IPMI
+	struct timespec now;
 
-			hndl->next = table->freelist;
-			table->freelist = hndl;
-		}
-		pthread_mutex_unlock(&table->lock);
-	}
+	clock_gettime(CLOCK_REALTIME, &now);
+	IPMI_LOG_DEBUG("IPMB(%02X:%02X) Response handle timeout %ld:%ld -> %ld:%ld\n",
+				   hndl->match.netfn, hndl->match.cmd,
+				   hndl->start_time.tv_sec, hndl->start_time.tv_nsec,
+				   now.tv_sec, now.tv_nsec);
+#endif
 
-	return NULL;
+	free_ipmb_hndl(hndl);
 }
 
 /**
@@ -154,7 +160,7 @@ static int ipmb_intf_find_seq(struct ipmb_match_info *match,
 	struct rsp_ipmb_table *table = &ipmb_rsp_table;
 	struct list_head *head = &table->seq_table[IPMB_SEQ_HASH(match->seq)];
 
-	pthread_mutex_lock(&table->lock);
+	ipmi_lock(&table->lock);
 	list_for_each_entry(pos, head, seq_list) {
 		if (pos->match.sa == match->sa &&
 		    pos->match.lun == match->lun &&
@@ -172,35 +178,32 @@ static int ipmb_intf_find_seq(struct ipmb_match_info *match,
 	*user_port = hndl->user_port;
 
 	/*copy header*/
-	memset(header->method, 0, sizeof(JRPC_METHOD_MAX));
+	memset(header->method, 0, sizeof(header->method));
 	header->ip = hndl->header.ip;
 	header->port = hndl->header.port;
 	header->json_ipc_id = hndl->header.json_ipc_id;
 	if (strlen((const char *)hndl->header.method) < JRPC_METHOD_MAX)
-		memcpy(header->method, hndl->header.method, strlen((const char *)(hndl->header.method)));
-
-	if (!hndl->broadcast) {
-		list_del(&hndl->seq_list);
-		list_del(&hndl->list);
+		memcpy(header->method, hndl->header.method, strlen((const char *)(hndl->header.method)) + 1);
 
-		hndl->next = table->freelist;
-		table->freelist = hndl;
-	}
+	if (!hndl->broadcast)
+		free_ipmb_hndl(hndl);
 
 	rv = 0;
 
 ret:
-	pthread_mutex_unlock(&table->lock);
+	ipmi_unlock(&table->lock);
 
 	return rv;
 }
 
 /**
-  *  @brief in IPMB interface, find IPMB session by sequence number
+  *  @brief in IPMB interface, take a sequence number for a request, the
+  *         table lock held
   *
   *  @param[in] match match information include session context
-  *  @param[out] msgid if find the session, set the msgid
-  *  @param[out] user_port if find the session, set the socket port
+  *  @param[in] timeo time out
+  *  @param[in] msgid msg id
+  *  @param[in] user_port user application socket port
   *  @return retrun value
   *  @retval -1 failure
   *  @retval 0 sucessful
@@ -209,19 +212,17 @@ static int ipmb_intf_next_seq(struct ipmb_match_info *match,
 			unsigned int timeo,
 			unsigned int msgid, unsigned short user_port, ipmi_json_ipc_header_t header)
 {
-	int rv = -1;
 	unsigned int i;
 	unsigned char netfn = match->netfn & 0x3E;	/* request netfn */
 	unsigned char seq = IPMB_SEQ_SIZE;
 	struct rsp_ipmb_hndl *hndl, *pos;
 	struct rsp_ipmb_table *table = &ipmb_rsp_table;
 
-	pthread_mutex_lock(&table->lock);
 	hndl = table->freelist;
 	if (hndl == NULL) {
 		IPMI_LOG_ERR("NXT SEQ no buff, adjust #IPMB_RSPHNDL_QUEUE_SIZE(%d)!\n",
 					 IPMB_RSPHNDL_QUEUE_SIZE);
-		goto ret;
+		return -1;
 	}
 
 	for (i = table->curr_seq; IPMB_SEQ_HASH(i+1) != table->curr_seq && i < IPMB_SEQ_SIZE; i = IPMB_SEQ_HASH(i+1)) {
@@ -247,14 +248,13 @@ static int ipmb_intf_next_seq(struct ipmb_match_info *match,
 
 	if (seq == IPMB_SEQ_SIZE) {
 		IPMI_LOG_ERR("No avail seq number for IPMI msg in IPMB interface!\n");
-		goto ret;
+		return -1;
 	}
 
 	table->freelist = hndl->next;
 
 	hndl->next = NULL;
 	list_add_tail(&hndl->seq_list, &table->seq_table[seq]);
-	list_add_tail(&hndl->list, &table->all_hndls);
 
 	hndl->match.sa = match->sa;
 	hndl->match.lun = match->lun;
@@ -266,17 +266,18 @@ static int ipmb_intf_next_seq(struct ipmb_match_info *match,
 	hndl->user_port = user_port;
 
 	/*copy header*/
-	memset(hndl->header.method, 0, sizeof(JRPC_METHOD_MAX));
+	memset(hndl->header.method, 0, sizeof(hndl->header.method));
 	hndl->header.ip = header.ip;
 	hndl->header.port = header.port;
 	hndl->header.json_ipc_id = header.json_ipc_id;
 	if (strlen((const char *)header.method) < JRPC_METHOD_MAX)
-		memcpy(hndl->header.method, header.method, strlen((const char *)header.method));
+		memcpy(hndl->header.method, header.method, strlen((const char *)header.method) + 1);
 
 #ifdef DEBUG_IPMI
 	clock_gettime(CLOCK_REALTIME, &hndl->start_time);
 #endif
-	hndl->timeout = timeo;
+	ipmi_timer_init(&hndl->timer, ipmb_hndl_expired);
+	ipmi_timer_add(&table->wheel, &hndl->timer, timeo);
 	hndl->broadcast = is_ipmb_addr_bcast(match->sa);
 
 	/* IPMB: 2.6.1 The Seq Field and Retries
@@ -286,12 +287,7 @@ static int ipmb_intf_next_seq(struct ipmb_match_info *match,
 	match->seq = seq;	/* saved the seq result back */
 	table->curr_seq = IPMB_SEQ_HASH(seq + 1);
 
-	rv = 0;
-
-ret:
-	pthread_mutex_unlock(&table->lock);
-
-	return rv;
+	return 0;
 }
 
 /**
@@ -311,6 +307,7 @@ static void handle_ipmb_msg_rsp(struct ipmb_match_info *match,
 	union app_msg_union msg;
 	ipmi_json_ipc_header_t header;
 
+	memset(&header, 0, sizeof(header));
 	if (ipmb_intf_find_seq(match, &msgid, &user_port, &header) != 0) {
 		IPMI_LOG_DEBUG("IPMB: No match request for this response!\n");
 		return;
@@ -463,6 +460,37 @@ static int format_ipmb_msg(unsigned char *buff, struct ipmi_msg *ipmi,
 	return (7 + ipmi->data_len);
 }
 
+/**
+  *  @brief send a request in a window slot of its slave, the table lock held
+  *
+  *  @param[in] msg IPMI request
+  *  @return
+  *  @retval -1 failure
+  *  @retval 0 successful
+  */
+static int send_ipmb_req(struct appmsg_ipmi_msg *msg)
+{
+	struct ipmb_match_info match;
+	int           ipmb_msg_len;
+	unsigned char ipmb_msg[IPMI_MAX_MSG_LENGTH];
+
+	match.sa  = msg->addr.addr.ipmb.sa;
+	match.lun = msg->addr.addr.ipmb.lun;
+	match.netfn = msg->msg.netfn;
+	match.cmd   = msg->msg.cmd;
+
+	if (ipmb_intf_next_seq(&match, msg->timeo, msg->id, msg->user_port, msg->header) != 0)
+		return -1;
+
+	ipmb_msg_len = format_ipmb_msg(ipmb_msg, &msg->msg,
+						match.sa, match.lun, match.seq,
+						IPMI_IPMB_ADDR, IPMI_IPMB_LUN);
+
+	ipmb_send_outbound_msg(ipmb_msg, ipmb_msg_len);
+
+	return 0;
+}
+
 /**
   *  @brief deliver IPMI msg via IPMB
   *
@@ -472,9 +500,11 @@ static int format_ipmb_msg(unsigned char *buff, struct ipmi_msg *ipmi,
 void deliver_ipmi_msg_by_ipmb(struct appmsg_ipmi_msg *msg)
 {
 	struct ipmi_msg *ipmi_msg;
-	unsigned char seq;
+	struct rsp_ipmb_table *table = &ipmb_rsp_table;
+	struct ipmi_window *win;
 	int           ipmb_msg_len;
 	unsigned char ipmb_msg[IPMI_MAX_MSG_LENGTH];
+	int rc;
 
 	ipmi_msg = &msg->msg;
 	if (ipmi_msg->data_len > IPMI_MAX_DATA_LENGTH) {
@@ -488,33 +518,33 @@ void deliver_ipmi_msg_by_ipmb(struct appmsg_ipmi_msg *msg)
 	}
 
 	if (ipmi_msg->netfn & 0x01) {
-		seq = msg->addr.addr.ipmb.seq;
-	} else {
-		struct ipmb_match_info match;
-
-		match.sa  = msg->addr.addr.ipmb.sa;
-		match.lun = msg->addr.addr.ipmb.lun;
-		match.netfn = ipmi_msg->netfn;
-		match.cmd   = ipmi_msg->cmd;
+		ipmb_msg_len = format_ipmb_msg(ipmb_msg, ipmi_msg,
+							msg->addr.addr.ipmb.sa,
+							msg->addr.addr.ipmb.lun,
+							msg->addr.addr.ipmb.seq,
+							IPMI_IPMB_ADDR, IPMI_IPMB_LUN);
 
-		if (msg->timeo > IPMI_MAX_TIMEOUT_MS)
-			msg->timeo = IPMI_MAX_TIMEOUT_MS;
-		if (msg->timeo == 0)
-			msg->timeo = IPMI_DFLT_TIMEOUT_MS;
+		ipmb_send_outbound_msg(ipmb_msg, ipmb_msg_len);
+		return;
+	}
 
-		if (ipmb_intf_next_seq(&match, msg->timeo, msg->id, msg->user_port, msg->header) != 0)
-			return;
+	if (msg->timeo > IPMI_MAX_TIMEOUT_MS)
+		msg->timeo = IPMI_MAX_TIMEOUT_MS;
+	if (msg->timeo == 0)
+		msg->timeo = IPMI_DFLT_TIMEOUT_MS;
 
-		seq = match.seq;
-	}
+	/* the requests above the window of the slave wait for a response */
+	ipmi_lock(&table->lock);
 
-	ipmb_msg_len = format_ipmb_msg(ipmb_msg, ipmi_msg,
-						msg->addr.addr.ipmb.sa,
-						msg->addr.addr.ipmb.lun,
-						seq,
-						IPMI_IPMB_ADDR, IPMI_IPMB_LUN);
+	win = &table->window[msg->addr.addr.ipmb.sa];
+	rc = ipmi_window_get(win, msg);
+	if (rc == 0 && send_ipmb_req(msg) != 0)
+		ipmb_window_next(win);
+	else if (rc < 0)
+		IPMI_LOG_ERR("IPMB SA:%02X send queue is full, drop NetFn:%02X,Cmd:%02X!\n",
+					 msg->addr.addr.ipmb.sa, ipmi_msg->netfn, ipmi_msg->cmd);
 
-	ipmb_send_outbound_msg(ipmb_msg, ipmb_msg_len);
+	ipmi_unlock(&table->lock);
 }
 
 /**
@@ -526,22 +556,27 @@ void deliver_ipmi_msg_by_ipmb(struct appmsg_ipmi_msg *msg)
 void init_ipmb_msg_handler(void)
 {
 	int i;
+	int window;
 	struct rsp_ipmb_table *table = &ipmb_rsp_table;
 
-	pthread_mutex_init(&table->lock, NULL);
+	ipmi_lock_init(&table->lock, "IPMB response");
 
 	table->freelist = mem_freelist_create(IPMB_RSPHNDL_QUEUE_SIZE,
 									sizeof(struct rsp_ipmb_hndl));
 	if (table->freelist == NULL)
 		FATAL("Failed to alloc ipmb rsp handle queue!\n");
 
-	INIT_LIST_HEAD(&table->all_hndls);
 	for (i = 0; i < IPMB_SEQ_SIZE; i++)
 		INIT_LIST_HEAD(&table->seq_table[i]);
 
 	table->curr_seq = 0;
 
-	if (pthread_create(&table->time_tid, NULL, ipmb_time_thread, NULL) != 0)
-		FATAL("Failed to create IPMB time thread!\n");
+	window = rmm_cfg_get_ipmb_window();
+	if (window <= 0)
+		window = IPMI_WINDOW_DFLT_SIZE;
+	for (i = 0; i < IPMB_SA_NUM; i++)
+		ipmi_window_init(&table->window[i], window);
+
+	ipmi_timer_wheel_init(&table->wheel, &table->lock);
 }
 
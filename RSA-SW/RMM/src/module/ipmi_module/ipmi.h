@@ -18,8 +18,11 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <sys/un.h>
+#include <sys/uio.h>
 
 #include "libjipmi/common.h"
+#include "libjipmi/jipmi_bin.h"
 
 struct app_recv_msg {
 	struct app_recv_msg *next;	/* free buffer link */
@@ -65,6 +68,7 @@ extern void deliver_ipmi_msg_by_ipmb(struct appmsg_ipmi_msg *msg);
 /* rmcp_intf.c */
 extern void register_rmcp_resp(void);
 extern void rmcp_send_outbound_msg(unsigned char *msg, int len, unsigned int host, unsigned int port);
+extern void rmcp_queue_outbound_msg(struct appmsg_ipmi_msg *msg);
 
 
 /* rmcp_handler.c */
@@ -87,7 +91,7 @@ extern void set_serial_port_used(int cur, int fd, char *dev, pthread_t tid, long
 extern int serial_port_is_updated(int cur, long inode);
 extern void serial_port_update(int cur, int fd, long inode);
 extern void set_serial_port_unused(int cur);
-extern void init_serial_msg_handler(int cur);
+extern void init_serial_msg_handler(int cur, unsigned int window);
 extern int check_serial_port_by_dev(char *dev, int *fd);
 extern int set_serial_port_timeout_by_dev(char *dev, unsigned int timeout);
 extern int send_back_result_to_app(int fd, unsigned char netfn, unsigned char cmd,
@@ -98,5 +102,20 @@ extern void deliver_ipmi_msg_by_serial(struct appmsg_ipmi_msg *msg);
 extern int format_app_jrpc_to_user(unsigned char *buffer, ipmi_json_ipc_header_t header, const struct app_msg_hdr *msg/*, unsigned short len*/);
 extern void app_json_rpc_msg(int fd, char *dest_msg);
 extern void app_json_parse(struct app_recv_msg *list, char *dest_msg);
+extern int format_rmcp_cmd(char *dest_msg, struct ipmi_msg *req, ipmi_json_ipc_header_t header,
+			unsigned int host, unsigned int port, const char *uname, const char *passwd);
+extern int format_ipmb_cmd(char *dest_msg, struct ipmi_msg *req, ipmi_json_ipc_header_t header, unsigned char sa);
+extern int format_serial_cmd(char *dest_msg, struct ipmi_msg *req, ipmi_json_ipc_header_t header);
+extern int format_rmcp_br_cmd(char *dest_msg, struct ipmi_msg *request, ipmi_json_ipc_header_t header,
+			unsigned int host, unsigned int port,
+			unsigned long target_addr, unsigned short target_channel, const char *uname, const char *passwd,
+			unsigned long transit_addr, unsigned short transit_channel, int bridge_level);
+
+/* ipmi_bin.c */
+extern int app_bin_parse(unsigned char *data, int len, const struct sockaddr_un *from, socklen_t from_len,
+			char *dest_msg);
+extern int app_bin_user_addr(ipmi_json_ipc_header_t header, struct sockaddr_un *addr, socklen_t *addr_len);
+extern int format_app_bin_to_user(struct iovec *iov, struct jipmi_bin_hdr *hdr, ipmi_json_ipc_header_t header,
+			const struct app_msg_hdr *msg);
 #endif
 
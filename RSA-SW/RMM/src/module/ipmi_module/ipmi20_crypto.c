@@ -19,11 +19,34 @@
 #include <openssl/evp.h>
 #include <openssl/hmac.h>
 #include <openssl/rand.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#endif
 
 #include "rmcp.h"
 #include "ipmi20_crypto.h"
 
 #if IPMI20_SUPPORT == 1
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+static HMAC_CTX *HMAC_CTX_new(void)
+{
+	HMAC_CTX *ctx = malloc(sizeof(*ctx));
+
+	if (ctx != NULL)
+		HMAC_CTX_init(ctx);
+
+	return ctx;
+}
+
+static void HMAC_CTX_free(HMAC_CTX *ctx)
+{
+	if (ctx != NULL) {
+		HMAC_CTX_cleanup(ctx);
+		free(ctx);
+	}
+}
+#endif
+
 /**
   *  @brief This function is used to generate random numbers for RAKP Message 1,
   *         Remote Console Random Number.
@@ -68,6 +91,7 @@ int ipmi20_generate_auth_code(unsigned char alg,
 	case AUTH_ALG_RAKP_HMAC_MD5: /* INTEGRITY_ALG_HMAC_MD5_128 has the same value */
 	case INTEGRITY_ALG_MD5_128:
 		HMAC(EVP_md5(), key, key_len, data, data_len, buf, &len);
+		break;
 	default:
 		break;
 	}
@@ -75,220 +99,324 @@ int ipmi20_generate_auth_code(unsigned char alg,
 	return len;
 }
 
-#define CONFIDENTIALLITY_HEADER_MAX_LEN		(16 + 4)
-#define PAYLOAD_DATA_LEN					16
-#define CONFIDENTIALLITY_TRAILER_MAX_LEN	4
-
-#define IPMI20_CRYPT_AES_CBC_128_BLOCK_SIZE	16
+/**
+  *  @brief init the crypto contexts of a session buffer, none allocated
+  *
+  *  @param[in] crypto session crypto contexts
+  *  @return
+  */
+void ipmi20_crypto_init(struct ipmi20_crypto *crypto)
+{
+	memset(crypto, 0, sizeof(*crypto));
+}
 
 /**
-  *  @brief
+  *  @brief free the crypto contexts of a session buffer
   *
-  *  @param
+  *  @param[in] crypto session crypto contexts
   *  @return
   */
-void ipmi20_encrypt_aes_cbc_128(unsigned char *init_vec,
-								unsigned char *key,
-								unsigned char *data,
-								int data_len,
-								unsigned char *out,
-								int *out_len)
+void ipmi20_crypto_free(struct ipmi20_crypto *crypto)
 {
-	EVP_CIPHER_CTX ctx;
+	EVP_CIPHER_CTX_free(crypto->enc);
+	EVP_CIPHER_CTX_free(crypto->dec);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	EVP_MAC_CTX_free(crypto->integrity);
+#else
+	HMAC_CTX_free(crypto->integrity);
+#endif
+	ipmi20_crypto_init(crypto);
+}
 
-	EVP_CIPHER_CTX_init(&ctx);
-	EVP_EncryptInit_ex(&ctx, EVP_aes_128_cbc(), NULL, key, init_vec);
-	EVP_CIPHER_CTX_set_padding(&ctx, 0);
+/**
+  *  @brief key the HMAC context with K1
+  *
+  *  @param[in] crypto session crypto contexts
+  *  @param[in] key K1
+  *  @return 0 on success, -1 on failure
+  */
+static int set_integrity_key(struct ipmi20_crypto *crypto, unsigned char *key)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	OSSL_PARAM params[2];
+	EVP_MAC *mac;
+
+	if (crypto->integrity == NULL) {
+		mac = EVP_MAC_fetch(NULL, OSSL_MAC_NAME_HMAC, NULL);
+		if (mac == NULL)
+			return -1;
+		crypto->integrity = EVP_MAC_CTX_new(mac);
+		EVP_MAC_free(mac);
+		if (crypto->integrity == NULL)
+			return -1;
+	}
 
-	if (!EVP_EncryptUpdate(&ctx, out, out_len, data, data_len)) {
-		*out_len = 0;
+	params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+				crypto->integrity_alg == INTEGRITY_ALG_HMAC_SHA1_96 ? "SHA1" : "MD5", 0);
+	params[1] = OSSL_PARAM_construct_end();
 
-		return;
-	} else {
-		int len_tmp = 0;
+	return EVP_MAC_init(crypto->integrity, key, 20, params) ? 0 : -1;
+#else
+	if (crypto->integrity == NULL) {
+		crypto->integrity = HMAC_CTX_new();
+		if (crypto->integrity == NULL)
+			return -1;
+	}
 
-		if (!EVP_EncryptFinal_ex(&ctx, out + *out_len, &len_tmp)) {
-			*out_len = 0;
+	return HMAC_Init_ex(crypto->integrity, key, 20,
+				crypto->integrity_alg == INTEGRITY_ALG_HMAC_SHA1_96 ? EVP_sha1() : EVP_md5(),
+				NULL) ? 0 : -1;
+#endif
+}
 
-			return;
-		} else {
-			*out_len += len_tmp;
-			EVP_CIPHER_CTX_cleanup(&ctx);
-		}
-	}
+/**
+  *  @brief key the AES-CBC-128 contexts with K2, the IV is set per packet
+  *
+  *  @param[in] crypto session crypto contexts
+  *  @param[in] key K2
+  *  @return 0 on success, -1 on failure
+  */
+static int set_crypt_key(struct ipmi20_crypto *crypto, unsigned char *key)
+{
+	if (crypto->enc == NULL)
+		crypto->enc = EVP_CIPHER_CTX_new();
+	if (crypto->dec == NULL)
+		crypto->dec = EVP_CIPHER_CTX_new();
+	if (crypto->enc == NULL || crypto->dec == NULL)
+		return -1;
+
+	if (!EVP_EncryptInit_ex(crypto->enc, EVP_aes_128_cbc(), NULL, key, NULL) ||
+		!EVP_DecryptInit_ex(crypto->dec, EVP_aes_128_cbc(), NULL, key, NULL))
+		return -1;
+
+	EVP_CIPHER_CTX_set_padding(crypto->enc, 0);
+	EVP_CIPHER_CTX_set_padding(crypto->dec, 0);
+
+	return 0;
 }
 
 /**
-  *  @brief
+  *  @brief set up the session crypto once RAKP is done, it allocates the
+  *         contexts at the first time and re-keys them afterwards.
   *
-  *  @param
-  *  @return
+  *  @param[in] crypto session crypto contexts
+  *  @param[in] integrity_alg integrity algorithm
+  *  @param[in] key_k1 K1
+  *  @param[in] crypt_alg confidentiality algorithm
+  *  @param[in] key_k2 K2
+  *  @return 0 on success, -1 on failure
   */
-void ipmi20_decrypt_aes_cbc_128(unsigned char *init_vec,
-								unsigned char *key,
-								unsigned char *data,
-								int data_len,
-								unsigned char *out,
-								int *out_len)
+int ipmi20_crypto_set_keys(struct ipmi20_crypto *crypto,
+						   unsigned char integrity_alg, unsigned char *key_k1,
+						   unsigned char crypt_alg, unsigned char *key_k2)
 {
-	EVP_CIPHER_CTX ctx;
-
-	EVP_CIPHER_CTX_init(&ctx);
-	EVP_DecryptInit_ex(&ctx, EVP_aes_128_cbc(), NULL, key, init_vec);
-	EVP_CIPHER_CTX_set_padding(&ctx, 0);
-
-	if (!EVP_DecryptUpdate(&ctx, out, out_len, data, data_len)) {
-		*out_len = 0;
-		return;
-	} else {
-		int len_tmp = 0;
-
-		if (!EVP_DecryptFinal_ex(&ctx, out + *out_len, &len_tmp)) {
-			*out_len = 0;
-			return;
-		} else {
-			*out_len += len_tmp;
-			EVP_CIPHER_CTX_cleanup(&ctx);
-		}
+	crypto->integrity_alg = integrity_alg;
+	crypto->crypt_alg = crypt_alg;
+
+	switch (integrity_alg) {
+	case INTEGRITY_ALG_NONE:
+		break;
+	case INTEGRITY_ALG_HMAC_SHA1_96:
+	case INTEGRITY_ALG_HMAC_MD5_128:
+	case INTEGRITY_ALG_MD5_128:
+		if (set_integrity_key(crypto, key_k1) != 0)
+			return -1;
+		break;
+	default:
+		return -1;
 	}
+
+	switch (crypt_alg) {
+	case CRYPT_ALG_NONE:
+		break;
+	case CRYPT_ALG_AES_CBC_128:
+		if (set_crypt_key(crypto, key_k2) != 0)
+			return -1;
+		break;
+	default:
+		return -1;
+	}
+
+	return 0;
 }
 
 /**
-  *  @brief
+  *  @brief generate the Auth Code of the IPMI session trailer with K1
   *
-  *  @param
-  *  @return
+  *  @param[in] crypto session crypto contexts
+  *  @param[in] data the data to sign
+  *  @param[in] data_len the data length
+  *  @param[out] buf the output buffer, EVP_MAX_MD_SIZE at least
+  *  @return the output data length, 0 on failure
+  */
+int ipmi20_integrity_code(struct ipmi20_crypto *crypto,
+						  unsigned char *data,
+						  int data_len,
+						  unsigned char *buf)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	size_t len = 0;
+
+	if (crypto->integrity == NULL ||
+		!EVP_MAC_init(crypto->integrity, NULL, 0, NULL) ||
+		!EVP_MAC_update(crypto->integrity, data, data_len) ||
+		!EVP_MAC_final(crypto->integrity, buf, &len, EVP_MAX_MD_SIZE))
+		return 0;
+#else
+	unsigned int len = 0;
+
+	if (crypto->integrity == NULL ||
+		!HMAC_Init_ex(crypto->integrity, NULL, 0, NULL, NULL) ||
+		!HMAC_Update(crypto->integrity, data, data_len) ||
+		!HMAC_Final(crypto->integrity, buf, &len))
+		return 0;
+#endif
+
+	return len;
+}
+
+/**
+  *  @brief AES-CBC-128 en/decrypt with the key set by ipmi20_crypto_set_keys()
+  *
+  *  @param[in] ctx the encrypt or decrypt context
+  *  @param[in] enc 1 to encrypt, 0 to decrypt
+  *  @param[in] init_vec IV
+  *  @param[in] data the input data, a multiple of the block size
+  *  @param[in] data_len the input data length
+  *  @param[out] out the output buffer
+  *  @return the output data length, 0 on failure
+  */
+static int ipmi20_aes_cbc_128(EVP_CIPHER_CTX *ctx, int enc,
+							  unsigned char *init_vec,
+							  unsigned char *data,
+							  int data_len,
+							  unsigned char *out)
+{
+	int len = 0;
+	int len_tmp = 0;
+
+	if (ctx == NULL || !EVP_CipherInit_ex(ctx, NULL, NULL, NULL, init_vec, enc))
+		return 0;
+
+	if (!EVP_CipherUpdate(ctx, out, &len, data, data_len) ||
+		!EVP_CipherFinal_ex(ctx, out + len, &len_tmp))
+		return 0;
+
+	return len + len_tmp;
+}
+
+/**
+  *  @brief encrypt the IPMI payload of a session, with the Confidentiality
+  *         Header (IV) and Trailer (pad) for AES-CBC-128.
+  *
+  *  @param[in] sess IPMI session
+  *  @param[in] msg the IPMI payload
+  *  @param[in] msg_len the payload length
+  *  @param[out] out the output buffer of IPMI20_CRYPT_MAX_LEN(msg_len)
+  *  @return the output data length, -1 on failure
   */
-unsigned char *ipmi20_payload_encrypt(struct ipmi_session *sess,
-									  struct rmcp_plus_ipmi_info *ipmi_info,
-									  unsigned char *msg,
-									  int msg_len,
-									  int *len)
+int ipmi20_payload_encrypt(struct ipmi_session *sess,
+						   unsigned char *msg,
+						   int msg_len,
+						   unsigned char *out)
 {
 	int i = 0;
-	int mod = 0;
-	unsigned char *buf = NULL;
-	unsigned char *pad_input = NULL;
 	int pad_len = 0;
-	unsigned char confidentiallity_header[CONFIDENTIALLITY_HEADER_MAX_LEN] = {0};
-
-	buf = (unsigned char *)malloc(CONFIDENTIALLITY_HEADER_MAX_LEN
-								  + PAYLOAD_DATA_LEN
-								  + CONFIDENTIALLITY_TRAILER_MAX_LEN);
-	if (NULL == buf) {
-		IPMI_LOG_DEBUG("malloc failed\n");
-		return NULL;
-	};
+	int len = 0;
+	unsigned char pad_input[IPMI_MAX_MSG_LENGTH + IPMI20_CRYPT_BLOCK_SIZE];
 
 	switch (sess->crypt_alg) {
 	case CRYPT_ALG_NONE:
-		buf = msg;
-		*len = msg_len;
-		break;
+		memcpy(out, msg, msg_len);
+		return msg_len;
 	case CRYPT_ALG_AES_CBC_128:
+		if (msg_len > IPMI_MAX_MSG_LENGTH)
+			return -1;
+
 		/* Confidentiallity Header */
-		ipmi20_random(confidentiallity_header, 16);
-		memcpy(buf, confidentiallity_header, 16);
+		if (ipmi20_random(out, IPMI20_CRYPT_BLOCK_SIZE) != 0)
+			return -1;
 
-		mod = (msg_len + 1) % IPMI20_CRYPT_AES_CBC_128_BLOCK_SIZE;
-		if (mod != 0)
-			pad_len = IPMI20_CRYPT_AES_CBC_128_BLOCK_SIZE - mod;
-
-		pad_input = (unsigned char *)malloc(msg_len + pad_len + 1);
-		if (NULL == pad_input) {
-			free(buf);
-			return NULL;
-		}
+		pad_len = (msg_len + 1) % IPMI20_CRYPT_BLOCK_SIZE;
+		if (pad_len != 0)
+			pad_len = IPMI20_CRYPT_BLOCK_SIZE - pad_len;
 
 		memcpy(pad_input, msg, msg_len);
 
 		/* 0x1, 0x2, 0x3 ... */
-		for (i = 0; i < pad_len; i++) {
+		for (i = 0; i < pad_len; i++)
 			pad_input[msg_len + i] = i + 1;
-		}
 
 		pad_input[msg_len + pad_len] = pad_len;
 
-		ipmi20_encrypt_aes_cbc_128(buf, sess->key_k2, pad_input,
-								   msg_len + pad_len + 1,
-								   buf + 16, len);
-
-		free(pad_input);
-
-		if (*len == 0)
-			return NULL;
-
-		*len += 16;
+		len = ipmi20_aes_cbc_128(sess->crypto.enc, 1, out, pad_input,
+								 msg_len + pad_len + 1,
+								 out + IPMI20_CRYPT_BLOCK_SIZE);
+		if (len == 0)
+			return -1;
 
-		break;
+		return len + IPMI20_CRYPT_BLOCK_SIZE;
 	case CRYPT_ALG_xRC4_128:
 	case CRYPT_ALG_xRC4_40:
-		break;
 	default:
 		break;
 	}
 
-	return buf;
+	return -1;
 }
 
 /**
-  *  @brief
+  *  @brief decrypt the IPMI payload of a session, and strip the
+  *         Confidentiality Header and Trailer.
   *
-  *  @param
-  *  @return
+  *  @param[in] sess IPMI session
+  *  @param[in] ipmi_info include the IPMI msg context
+  *  @param[out] out the output buffer of ipmi_info->ipmi_data_len
+  *  @return the payload length, -1 on failure
   */
-unsigned char *ipmi20_payload_decrypt(struct ipmi_session *sess,
-									  unsigned char *key,
-									  struct rmcp_plus_ipmi_info *ipmi_info,
-									  int *len)
+int ipmi20_payload_decrypt(struct ipmi_session *sess,
+						   struct rmcp_plus_ipmi_info *ipmi_info,
+						   unsigned char *out)
 {
-	unsigned char *out = NULL;
+	int i = 0;
+	int len = 0;
 	int pad_len = 0;
 	int payload_len = 0;
 
-	out = (unsigned char *)malloc(CONFIDENTIALLITY_HEADER_MAX_LEN
-								  + PAYLOAD_DATA_LEN
-								  + CONFIDENTIALLITY_TRAILER_MAX_LEN);
-	if (NULL == out) {
-		IPMI_LOG_DEBUG("malloc failed\n");
-		return NULL;
-	};
-
 	switch (sess->crypt_alg) {
 	case CRYPT_ALG_NONE:
-		*len = ipmi_info->ipmi_data_len;
 		memcpy(out, ipmi_info->ipmi_data, ipmi_info->ipmi_data_len);
-		break;
+		return ipmi_info->ipmi_data_len;
 	case CRYPT_ALG_AES_CBC_128:
-		ipmi20_decrypt_aes_cbc_128(ipmi_info->ipmi_data, key,
-								   ipmi_info->ipmi_data + 16,
-								   ipmi_info->ipmi_data_len - 16,
-								   out, len);
-		if (*len > 0) {
-			int i = 0;
-
-			pad_len = out[*len - 1];
+		if (ipmi_info->ipmi_data_len <= IPMI20_CRYPT_BLOCK_SIZE ||
+			(ipmi_info->ipmi_data_len % IPMI20_CRYPT_BLOCK_SIZE) != 0)
+			return -1;
+
+		len = ipmi20_aes_cbc_128(sess->crypto.dec, 0, ipmi_info->ipmi_data,
+								 ipmi_info->ipmi_data + IPMI20_CRYPT_BLOCK_SIZE,
+								 ipmi_info->ipmi_data_len - IPMI20_CRYPT_BLOCK_SIZE,
+								 out);
+		if (len == 0)
+			return -1;
+
+		pad_len = out[len - 1];
+		payload_len = len - pad_len - 1;
+		if (payload_len < 0)
+			return -1;
 
-			payload_len = *len - pad_len - 1;
-
-			for (i = 0; i < pad_len; i++) {
-				if (out[payload_len + i] != (i + 1))
-					return NULL;
-			}
-
-			*len -= (pad_len + 1);
-		} else {
-			return NULL;
+		for (i = 0; i < pad_len; i++) {
+			if (out[payload_len + i] != (i + 1))
+				return -1;
 		}
-		break;
+
+		return payload_len;
 	case CRYPT_ALG_xRC4_128:
 	case CRYPT_ALG_xRC4_40:
-		break;
 	default:
 		break;
 	}
 
-	return out;
+	return -1;
 }
 
 #endif
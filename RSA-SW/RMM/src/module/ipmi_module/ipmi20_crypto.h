@@ -17,6 +17,35 @@
 #define _IPMI20_CRYPTO_H_
 
 #if IPMI20_SUPPORT == 1
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+/*
+ * The K1/K2 keys of a RMCP+ session are fixed once RAKP is done, so the
+ * AES key schedule and the HMAC key are set up then, in contexts kept by
+ * the session, and every packet only resets the IV or the HMAC state.
+ * The contexts stay allocated with the session buffer and are re-keyed
+ * by the next session using it.
+ */
+#define IPMI20_CRYPT_BLOCK_SIZE		16	/* AES-CBC-128 block and IV */
+#define IPMI20_CRYPT_MAX_LEN(len)	(IPMI20_CRYPT_BLOCK_SIZE + (len) + IPMI20_CRYPT_BLOCK_SIZE)
+
+struct ipmi20_crypto {
+	unsigned char integrity_alg;
+	unsigned char crypt_alg;
+
+	EVP_CIPHER_CTX *enc;
+	EVP_CIPHER_CTX *dec;
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	EVP_MAC_CTX *integrity;
+#else
+	HMAC_CTX *integrity;
+#endif
+};
+
+struct ipmi_session;
+struct rmcp_plus_ipmi_info;
+
 int ipmi20_generate_auth_code(unsigned char alg,
 							  void *key,
 							  int key_len,
@@ -26,17 +55,25 @@ int ipmi20_generate_auth_code(unsigned char alg,
 
 int ipmi20_random(unsigned char *buf, int num);
 
-unsigned char *ipmi20_payload_encrypt(struct ipmi_session *sess,
-									  struct rmcp_plus_ipmi_info *ipmi_info,
-									  unsigned char *data,
-									  int data_len,
-									  int *len);
+void ipmi20_crypto_init(struct ipmi20_crypto *crypto);
+void ipmi20_crypto_free(struct ipmi20_crypto *crypto);
+int ipmi20_crypto_set_keys(struct ipmi20_crypto *crypto,
+						   unsigned char integrity_alg, unsigned char *key_k1,
+						   unsigned char crypt_alg, unsigned char *key_k2);
+
+int ipmi20_integrity_code(struct ipmi20_crypto *crypto,
+						  unsigned char *data,
+						  int data_len,
+						  unsigned char *buf);
 
+int ipmi20_payload_encrypt(struct ipmi_session *sess,
+						   unsigned char *data,
+						   int data_len,
+						   unsigned char *out);
 
-unsigned char *ipmi20_payload_decrypt(struct ipmi_session *sess,
-									  unsigned char *key,
-									  struct rmcp_plus_ipmi_info *ipmi_info,
-									  int *len);
+int ipmi20_payload_decrypt(struct ipmi_session *sess,
+						   struct rmcp_plus_ipmi_info *ipmi_info,
+						   unsigned char *out);
 #endif
 
 #endif
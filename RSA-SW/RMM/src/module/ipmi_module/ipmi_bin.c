@@ -0,0 +1,188 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stddef.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/uio.h>
+
+#include "ipmi.h"
+#include "ipmi_log.h"
+#include "libjipmi/jipmi_bin.h"
+#include "librmmlog/rmmlog.h"
+
+/**
+  *  @brief keep the abstract address of the client as the method of the
+  *         request header, the response is sent there
+  *
+  *  @param[out] header request header
+  *  @param[in] from client address
+  *  @param[in] from_len client address length
+  *  @return
+  *  @retval -1 the client address is not an abstract one
+  *  @retval 0 sucessful
+  */
+static int set_user_addr(ipmi_json_ipc_header_t *header, const struct sockaddr_un *from, socklen_t from_len)
+{
+	int name_len = from_len - offsetof(struct sockaddr_un, sun_path) - 1;
+
+	if (from->sun_family != AF_UNIX || name_len <= 0 || name_len > JIPMI_BIN_ADDR_MAX ||
+		from->sun_path[0] != '\0' || memchr(from->sun_path + 1, '\0', name_len) != NULL)
+		return -1;
+
+	memset(header, 0, sizeof(*header));
+	header->method[0] = JIPMI_BIN_ADDR_MARK;
+	memcpy(header->method + 1, from->sun_path + 1, name_len);
+
+	return 0;
+}
+
+/**
+  *  @brief decode a binary request of libjipmi, as app_json_parse() does
+  *         for a JSON RPC one
+  *
+  *  @param[in] data request datagram
+  *  @param[in] len request datagram length
+  *  @param[in] from client address
+  *  @param[in] from_len client address length
+  *  @param[out] dest_msg the raw ipmi data
+  *  @return
+  *  @retval -1 failure
+  *  @retval 0 sucessful
+  */
+int app_bin_parse(unsigned char *data, int len, const struct sockaddr_un *from, socklen_t from_len,
+			char *dest_msg)
+{
+	struct jipmi_bin_hdr *hdr = (struct jipmi_bin_hdr *)data;
+	struct jipmi_bin_target *target = (struct jipmi_bin_target *)(hdr + 1);
+	ipmi_json_ipc_header_t header;
+	struct ipmi_msg req;
+	char uname[RMCP_USERNAME_LEN + 1] = {0};
+	char passwd[RMCP_PASSWORD_LEN + 1] = {0};
+
+	if (len < (int)(sizeof(*hdr) + sizeof(*target)) || hdr->version != JIPMI_BIN_VERSION ||
+		hdr->type != JIPMI_BIN_REQ || hdr->data_len > IPMI_MAX_DATA_LENGTH ||
+		len != (int)(sizeof(*hdr) + sizeof(*target) + hdr->data_len)) {
+		rmm_log(ERROR, "Invalid binary request of %d bytes!\n", len);
+		return -1;
+	}
+
+	if (set_user_addr(&header, from, from_len) != 0) {
+		rmm_log(ERROR, "Invalid binary client address!\n");
+		return -1;
+	}
+	header.json_ipc_id = hdr->id;
+
+	memset(&req, 0, sizeof(req));
+	req.netfn = hdr->netfn;
+	req.cmd   = hdr->cmd;
+	req.data_len = hdr->data_len;
+	memcpy(req.data, target + 1, hdr->data_len);
+
+	memcpy(uname, target->name, RMCP_USERNAME_LEN);
+	memcpy(passwd, target->password, RMCP_PASSWORD_LEN);
+
+	rmm_log(DBG, "id[%lld] method[%d] netfn[%d] cmd[%d] len[%d]\n",
+			hdr->id, hdr->method, hdr->netfn, hdr->cmd, hdr->data_len);
+
+	switch (hdr->method) {
+	case JIPMI_BIN_IPMB:
+		return format_ipmb_cmd(dest_msg, &req, header, target->ipmb_sa);
+	case JIPMI_BIN_RMCP:
+		return format_rmcp_cmd(dest_msg, &req, header, target->host, htons(target->port),
+							   uname, passwd);
+	case JIPMI_BIN_SERIAL_OP:
+		req.union_app_req.serial.serial_flag = target->serial_flag;
+		return format_serial_cmd(dest_msg, &req, header);
+	case JIPMI_BIN_SERIAL_CMD:
+		req.union_app_req.serial.serial_flag = target->serial_flag;
+		req.union_app_req.serial.serial_fd = (unsigned char)target->serial_fd;
+		return format_serial_cmd(dest_msg, &req, header);
+	case JIPMI_BIN_RMCP_BR:
+		return format_rmcp_br_cmd(dest_msg, &req, header, target->host, htons(target->port),
+								  target->target_addr, target->target_ch, uname, passwd,
+								  target->transit_addr, target->transit_ch, target->bridge_level);
+	default:
+		rmm_log(ERROR, "Not support binary method %d!\n", hdr->method);
+		return -1;
+	}
+}
+
+/**
+  *  @brief get the client address of a response, if it is for a binary request
+  *
+  *  @param[in] header request header
+  *  @param[out] addr client address
+  *  @param[out] addr_len client address length
+  *  @return
+  *  @retval -1 the request was a JSON RPC one
+  *  @retval 0 sucessful
+  */
+int app_bin_user_addr(ipmi_json_ipc_header_t header, struct sockaddr_un *addr, socklen_t *addr_len)
+{
+	int name_len;
+
+	if (header.method[0] != JIPMI_BIN_ADDR_MARK)
+		return -1;
+
+	name_len = strnlen((const char *)header.method + 1, JIPMI_BIN_ADDR_MAX);
+
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	memcpy(addr->sun_path + 1, header.method + 1, name_len);
+	*addr_len = offsetof(struct sockaddr_un, sun_path) + 1 + name_len;
+
+	return 0;
+}
+
+/**
+  *  @brief format the IPMI response as a binary header and the raw data,
+  *         sent without copy
+  *
+  *  @param[out] iov the header and the data to send
+  *  @param[out] hdr binary header
+  *  @param[in] header request header
+  *  @param[in] msg ipmi msg
+  *  @return
+  *  @retval -1 failure
+  *  @retval 0 sucessful
+  */
+int format_app_bin_to_user(struct iovec *iov, struct jipmi_bin_hdr *hdr, ipmi_json_ipc_header_t header,
+			const struct app_msg_hdr *msg)
+{
+	struct appmsg_ipmi_msg *ipmi_info;
+
+	ipmi_info = (struct appmsg_ipmi_msg *)msg->data;
+	if (msg->datalen != APPMSG_IPMI_MSG_LEN(ipmi_info->msg.data_len)) {
+		rmm_log(ERROR, "Invalid IPMI appmsg!\n");
+		return -1;
+	}
+
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->version = JIPMI_BIN_VERSION;
+	hdr->type = JIPMI_BIN_RSP;
+	hdr->netfn = ipmi_info->msg.netfn;
+	hdr->cmd = ipmi_info->msg.cmd;
+	hdr->data_len = ipmi_info->msg.data_len;
+	hdr->id = header.json_ipc_id;
+
+	iov[0].iov_base = hdr;
+	iov[0].iov_len = sizeof(*hdr);
+	iov[1].iov_base = ipmi_info->msg.data;
+	iov[1].iov_len = ipmi_info->msg.data_len;
+
+	return 0;
+}
@@ -62,16 +62,6 @@ struct jrpc_ipmi_cmd_handle_fn_table {
 	jrpc_ipmi_cmd_handle_fn handle;
 };
 
-static int format_rmcp_cmd(char *dest_msg, struct ipmi_msg *req, ipmi_json_ipc_header_t header,
-		unsigned int host, unsigned int port, const char *uname, const char *passwd);
-static int format_ipmb_cmd(char *dest_msg, struct ipmi_msg *req, ipmi_json_ipc_header_t header, unsigned char sa);
-static int format_serial_cmd(char *dest_msg, struct ipmi_msg *req, ipmi_json_ipc_header_t header);
-static int format_rmcp_br_cmd(char *dest_msg, struct ipmi_msg *request, ipmi_json_ipc_header_t header,
-		unsigned int host, unsigned int port,
-		unsigned long target_addr, unsigned short target_channel, const char *uname, const char *passwd,
-		unsigned long transit_addr, unsigned short transit_channel, int bridge_level);
-
-
 
 static void rmcp_handle_common(char *dest_msg, struct ipmi_msg *req, ipmi_json_ipc_header_t header,
 		va_list *valist
@@ -417,13 +407,13 @@ static int convert_ipmi_appmsg(char *dest_msg, struct ipmi_addr *addr, const str
 	ipmi->id = gen_req_msgid();
 	ipmi->timeo = new_timeo;
 	ipmi->user_port = header.port;
-	memset(ipmi->header.method, 0, sizeof(JRPC_METHOD_MAX));
+	memset(ipmi->header.method, 0, sizeof(ipmi->header.method));
 	ipmi->header.ip = header.ip;
 	ipmi->header.port = header.port;
 	ipmi->header.json_ipc_id = header.json_ipc_id;
 
 	if (strlen((const char *)header.method) < JRPC_METHOD_MAX)
-		memcpy(ipmi->header.method, header.method, strlen((const char *)header.method));
+		memcpy(ipmi->header.method, header.method, strlen((const char *)header.method) + 1);
 
 	memcpy(&ipmi->addr, addr, sizeof(struct ipmi_addr));
 	ipmi->msg.netfn = req->netfn;
@@ -497,7 +487,7 @@ static int format_ipmb_cmd_timeout(char *dest_msg, struct ipmi_msg *req, ipmi_js
   *  @retval -1 failure
   *  @retval 0 sucessful
   */
-static int format_ipmb_cmd(char *dest_msg, struct ipmi_msg *req, ipmi_json_ipc_header_t header, unsigned char sa)
+int format_ipmb_cmd(char *dest_msg, struct ipmi_msg *req, ipmi_json_ipc_header_t header, unsigned char sa)
 {
 	return format_ipmb_cmd_timeout(dest_msg, req, header, sa, IPMI_DFLT_TIMEOUT_MS);
 }
@@ -555,7 +545,7 @@ static int format_serial_cmd_timeout(char *dest_msg, struct ipmi_msg *req,
   *  @retval -1 failure
   *  @retval 0 sucessful
   */
-static int format_serial_cmd(char *dest_msg, struct ipmi_msg *req, ipmi_json_ipc_header_t header)
+int format_serial_cmd(char *dest_msg, struct ipmi_msg *req, ipmi_json_ipc_header_t header)
 {
 	return format_serial_cmd_timeout(dest_msg, req, header, IPMI_DFLT_TIMEOUT_MS);
 }
@@ -611,7 +601,7 @@ static int format_rmcp_cmd_timeout(char *dest_msg, unsigned int host, unsigned i
   *  @retval -1 failure
   *  @retval 0 sucessful
   */
-static int format_rmcp_cmd(char *dest_msg, struct ipmi_msg *req, ipmi_json_ipc_header_t header,
+int format_rmcp_cmd(char *dest_msg, struct ipmi_msg *req, ipmi_json_ipc_header_t header,
 		unsigned int host, unsigned int port, const char *uname, const char *passwd)
 {
 	return format_rmcp_cmd_timeout(dest_msg, host, port, req, header, IPMI_DFLT_TIMEOUT_MS, uname, passwd);
@@ -629,39 +619,33 @@ static int format_rmcp_cmd(char *dest_msg, struct ipmi_msg *req, ipmi_json_ipc_h
   *  @retval -1 failure
   *  @retval 0 sucessful
   */
-static int format_rmcp_br_cmd(char *dest_msg, struct ipmi_msg *request, ipmi_json_ipc_header_t header,
+int format_rmcp_br_cmd(char *dest_msg, struct ipmi_msg *request, ipmi_json_ipc_header_t header,
 			unsigned int host, unsigned int port,
 			unsigned long target_addr, unsigned short target_channel, const char *uname, const char *passwd,
 			unsigned long transit_addr, unsigned short transit_channel, int bridge_level)
 {
-	struct ipmi_msg *req;
-
-	req = malloc(sizeof(*req));
-	if (req == NULL) {
-		rmm_log(ERROR, "%s: failed for no memory!\n", __func__);
-		return -1;
-	}
+	struct ipmi_msg req;
 
-	memset(req, 0, sizeof(*req));
+	memset(&req, 0, sizeof(req));
 
-	req->netfn = IPMI_BRIDGE_NETFN_APP;
-	req->cmd   = IPMI_BRIDGE_IPMI_CMD;
-	req->union_app_req.bridge.bridge_level = bridge_level;
-	req->union_app_req.bridge.my_addr = IPMI_BMC_SLAVE_ADDR;
+	req.netfn = IPMI_BRIDGE_NETFN_APP;
+	req.cmd   = IPMI_BRIDGE_IPMI_CMD;
+	req.union_app_req.bridge.bridge_level = bridge_level;
+	req.union_app_req.bridge.my_addr = IPMI_BMC_SLAVE_ADDR;
 
-	req->union_app_req.bridge.transit_addr = transit_addr;
-	req->union_app_req.bridge.transit_channel = transit_channel;
-	req->union_app_req.bridge.target_addr = target_addr;
-	req->union_app_req.bridge.target_channel = target_channel;
-	req->union_app_req.bridge.br_netfn = request->netfn;
-	req->union_app_req.bridge.br_cmd = request->cmd;
-	req->data_len = request->data_len;
+	req.union_app_req.bridge.transit_addr = transit_addr;
+	req.union_app_req.bridge.transit_channel = transit_channel;
+	req.union_app_req.bridge.target_addr = target_addr;
+	req.union_app_req.bridge.target_channel = target_channel;
+	req.union_app_req.bridge.br_netfn = request->netfn;
+	req.union_app_req.bridge.br_cmd = request->cmd;
+	req.data_len = request->data_len;
 
 	if (0 != request->data_len) {
-		memcpy(req->data, request->data, request->data_len);
+		memcpy(req.data, request->data, request->data_len);
 	}
 
-	return format_rmcp_cmd_timeout(dest_msg, host, port, req, header, IPMI_DFLT_TIMEOUT_MS, uname, passwd);
+	return format_rmcp_cmd_timeout(dest_msg, host, port, &req, header, IPMI_DFLT_TIMEOUT_MS, uname, passwd);
 }
 
 /**
@@ -0,0 +1,274 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <sys/prctl.h>
+#include <pthread.h>
+#include <errno.h>
+#include <time.h>
+#include <string.h>
+
+#include "ipmi.h"
+#include "ipmi_log.h"
+#include "ipmi_timer.h"
+
+#define IPMI_TIMER_WHEEL_MASK	(IPMI_TIMER_WHEEL_SIZE - 1)
+
+static pthread_once_t timer_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t wheels_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct list_head wheels = LIST_HEAD_INIT(wheels);
+
+
+static unsigned long current_ticks(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec * 1000UL + now.tv_nsec / 1000000) / IPMI_TIMER_TICK_MS;
+}
+
+/**
+  *  @brief log how long the lock of 'wheel' was held since the last report
+  *
+  *  @param[in] wheel timer wheel, its lock held
+  *  @return
+  */
+static void report_lock(struct ipmi_timer_wheel *wheel)
+{
+	struct ipmi_lock *lock = wheel->lock;
+
+	if (lock->count == 0)
+		return;
+
+	IPMI_LOG_INFO("%s lock held %lu times, avg %llu us, max %llu us\n",
+				  lock->name, lock->count,
+				  lock->held_ns / lock->count / 1000, lock->max_ns / 1000);
+
+	lock->held_ns = 0;
+	lock->max_ns = 0;
+	lock->count = 0;
+}
+
+/**
+  *  @brief run the timers of 'wheel' up to tick 'ticks'
+  *
+  *  @param[in] wheel timer wheel, its lock held
+  *  @param[in] ticks current tick
+  *  @return
+  */
+static void run_wheel(struct ipmi_timer_wheel *wheel, unsigned long ticks)
+{
+	struct list_head *slot;
+	struct ipmi_timer *timer, *expired;
+
+	while ((long)(ticks - wheel->now) > 0) {
+		wheel->now++;
+		slot = &wheel->slots[wheel->now & IPMI_TIMER_WHEEL_MASK];
+
+		/* a handler may delete any other timer of the slot, rescan it */
+		for (;;) {
+			expired = NULL;
+			list_for_each_entry(timer, slot, list) {
+				if ((long)(wheel->now - timer->expire) >= 0) {
+					expired = timer;
+					break;
+				}
+			}
+
+			if (expired == NULL)
+				break;
+
+			ipmi_timer_del(expired);
+			expired->fn(expired);
+		}
+	}
+}
+
+/**
+  *  @brief tick all the timer wheels
+  *
+  *  @param
+  *  @return
+  */
+static void *ipmi_timer_thread(void *unused)
+{
+	struct timespec expire;
+	struct ipmi_timer_wheel *wheel;
+	unsigned long report = current_ticks() + IPMI_LOCK_REPORT_MS / IPMI_TIMER_TICK_MS;
+	unsigned long ticks;
+
+	prctl(PR_SET_NAME, "ipmi_timer_thread");
+
+	clock_gettime(CLOCK_MONOTONIC, &expire);
+
+	while (ipmi_module_exit == false) {
+		expire.tv_nsec += IPMI_TIMER_TICK_MS * 1000 * 1000;
+		if (expire.tv_nsec >= BILLION) {
+			expire.tv_sec += expire.tv_nsec / BILLION;
+			expire.tv_nsec %= BILLION;
+		}
+
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &expire, NULL) == EINTR)
+			/* Nothing! */;
+
+		/* catch up if we were late, not to shorten the timeouts */
+		ticks = current_ticks();
+
+		pthread_mutex_lock(&wheels_mutex);
+		list_for_each_entry(wheel, &wheels, link) {
+			ipmi_lock(wheel->lock);
+			run_wheel(wheel, ticks);
+			if ((long)(ticks - report) >= 0)
+				report_lock(wheel);
+			ipmi_unlock(wheel->lock);
+		}
+
+		if ((long)(ticks - report) >= 0)
+			report = ticks + IPMI_LOCK_REPORT_MS / IPMI_TIMER_TICK_MS;
+		pthread_mutex_unlock(&wheels_mutex);
+	}
+
+	return NULL;
+}
+
+static void start_timer_thread(void)
+{
+	pthread_t tid;
+
+	if (pthread_create(&tid, NULL, ipmi_timer_thread, NULL) != 0)
+		FATAL("Failed to create IPMI timer thread!\n");
+}
+
+/**
+  *  @brief init a table lock
+  *
+  *  @param[in] lock table lock
+  *  @param[in] name name of the table in the hold time report
+  *  @return
+  */
+void ipmi_lock_init(struct ipmi_lock *lock, const char *name)
+{
+	memset(lock, 0, sizeof(*lock));
+	pthread_mutex_init(&lock->mutex, NULL);
+	lock->name = name;
+}
+
+/**
+  *  @brief init the timer wheel of a table, and have it ticked
+  *
+  *  @param[in] wheel timer wheel
+  *  @param[in] lock table lock, held when the timers run
+  *  @return
+  */
+void ipmi_timer_wheel_init(struct ipmi_timer_wheel *wheel, struct ipmi_lock *lock)
+{
+	pthread_once(&timer_once, start_timer_thread);
+
+	/* a table may be set up again */
+	if (wheel->lock != NULL)
+		ipmi_timer_wheel_destroy(wheel);
+
+	pthread_mutex_lock(&wheels_mutex);
+	ipmi_timer_wheel_setup(wheel);
+	wheel->lock = lock;
+	list_add_tail(&wheel->link, &wheels);
+	pthread_mutex_unlock(&wheels_mutex);
+}
+
+/**
+  *  @brief init a timer wheel that its owner thread runs by itself
+  *
+  *  @param[in] wheel timer wheel
+  *  @return
+  */
+void ipmi_timer_wheel_setup(struct ipmi_timer_wheel *wheel)
+{
+	int i;
+
+	for (i = 0; i < IPMI_TIMER_WHEEL_SIZE; i++)
+		INIT_LIST_HEAD(&wheel->slots[i]);
+
+	wheel->lock = NULL;
+	wheel->now = current_ticks();
+}
+
+/**
+  *  @brief run the expired timers of a wheel set up by ipmi_timer_wheel_setup()
+  *
+  *  @param[in] wheel timer wheel
+  *  @return
+  */
+void ipmi_timer_wheel_run(struct ipmi_timer_wheel *wheel)
+{
+	run_wheel(wheel, current_ticks());
+}
+
+/**
+  *  @brief stop ticking a timer wheel, its timers never run then
+  *
+  *  @param[in] wheel timer wheel
+  *  @return
+  */
+void ipmi_timer_wheel_destroy(struct ipmi_timer_wheel *wheel)
+{
+	pthread_mutex_lock(&wheels_mutex);
+	list_del(&wheel->link);
+	wheel->lock = NULL;
+	pthread_mutex_unlock(&wheels_mutex);
+}
+
+/**
+  *  @brief init a timer
+  *
+  *  @param[in] timer timer
+  *  @param[in] fn called when it expires
+  *  @return
+  */
+void ipmi_timer_init(struct ipmi_timer *timer, void (*fn)(struct ipmi_timer *timer))
+{
+	INIT_LIST_HEAD(&timer->list);
+	timer->fn = fn;
+}
+
+/**
+  *  @brief start a timer, or restart it if pending
+  *
+  *  @param[in] wheel timer wheel
+  *  @param[in] timer timer
+  *  @param[in] timeout_ms time out
+  *  @return
+  */
+void ipmi_timer_add(struct ipmi_timer_wheel *wheel, struct ipmi_timer *timer, unsigned int timeout_ms)
+{
+	unsigned long ticks = (timeout_ms + IPMI_TIMER_TICK_MS - 1) / IPMI_TIMER_TICK_MS;
+
+	if (ticks == 0)
+		ticks = 1;
+
+	list_del(&timer->list);
+	timer->expire = wheel->now + ticks;
+	list_add_tail(&timer->list, &wheel->slots[timer->expire & IPMI_TIMER_WHEEL_MASK]);
+}
+
+/**
+  *  @brief stop a timer, it may be not pending
+  *
+  *  @param[in] timer timer
+  *  @return
+  */
+void ipmi_timer_del(struct ipmi_timer *timer)
+{
+	list_del(&timer->list);
+	INIT_LIST_HEAD(&timer->list);
+}
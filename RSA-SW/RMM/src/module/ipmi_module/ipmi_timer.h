@@ -0,0 +1,99 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __IPMI_TIMER_H__
+#define __IPMI_TIMER_H__
+
+#include <pthread.h>
+#include <time.h>
+
+#include "libutils/list.h"
+
+/*
+ * Timeouts of the RMCP sessions and of the requests waiting for a response
+ * on RMCP, IPMB and serial. Each table has a hashed timing wheel guarded
+ * by the table lock, one thread ticks all of them: adding, re-arming and
+ * deleting a timer is O(1), and a tick only looks at the timers of its
+ * slot instead of every session and request. A table owned by a single
+ * thread may rather run its wheel itself, without a lock.
+ */
+#define IPMI_TIMER_TICK_MS		100
+#define IPMI_TIMER_WHEEL_SIZE	1024	/* power of 2, one turn is ~100s */
+#define IPMI_LOCK_REPORT_MS		60000	/* log the lock hold times that often */
+
+/* a table lock that keeps how long it is held */
+struct ipmi_lock {
+	pthread_mutex_t mutex;
+	const char *name;
+
+	struct timespec since;
+	unsigned long long held_ns;
+	unsigned long long max_ns;
+	unsigned long count;
+};
+
+struct ipmi_timer {
+	struct list_head list;	/* in the wheel slot, empty if not pending */
+	unsigned long expire;	/* wheel tick */
+	void (*fn)(struct ipmi_timer *timer);	/* called with the table lock held */
+};
+
+struct ipmi_timer_wheel {
+	struct list_head link;	/* in the list of the timer thread */
+	struct ipmi_lock *lock;
+	unsigned long now;
+	struct list_head slots[IPMI_TIMER_WHEEL_SIZE];
+};
+
+static inline void ipmi_lock(struct ipmi_lock *lock)
+{
+	pthread_mutex_lock(&lock->mutex);
+	clock_gettime(CLOCK_MONOTONIC, &lock->since);
+}
+
+static inline void ipmi_unlock(struct ipmi_lock *lock)
+{
+	struct timespec now;
+	unsigned long long ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ns = (now.tv_sec - lock->since.tv_sec) * 1000000000ULL + now.tv_nsec - lock->since.tv_nsec;
+
+	lock->held_ns += ns;
+	if (ns > lock->max_ns)
+		lock->max_ns = ns;
+	lock->count++;
+
+	pthread_mutex_unlock(&lock->mutex);
+}
+
+static inline int ipmi_timer_pending(struct ipmi_timer *timer)
+{
+	return !list_empty(&timer->list);
+}
+
+extern void ipmi_lock_init(struct ipmi_lock *lock, const char *name);
+
+extern void ipmi_timer_wheel_init(struct ipmi_timer_wheel *wheel, struct ipmi_lock *lock);
+extern void ipmi_timer_wheel_destroy(struct ipmi_timer_wheel *wheel);
+extern void ipmi_timer_wheel_setup(struct ipmi_timer_wheel *wheel);
+extern void ipmi_timer_wheel_run(struct ipmi_timer_wheel *wheel);
+
+/* the timer functions below are called with the table lock held, if any */
+extern void ipmi_timer_init(struct ipmi_timer *timer, void (*fn)(struct ipmi_timer *timer));
+extern void ipmi_timer_add(struct ipmi_timer_wheel *wheel, struct ipmi_timer *timer, unsigned int timeout_ms);
+extern void ipmi_timer_del(struct ipmi_timer *timer);
+
+#endif
@@ -0,0 +1,130 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ipmi.h"
+#include "ipmi_log.h"
+#include "ipmi_window.h"
+
+/**
+  *  @brief init the send window of a target
+  *
+  *  @param[in] win send window
+  *  @param[in] size requests in flight at most
+  *  @return
+  */
+void ipmi_window_init(struct ipmi_window *win, unsigned int size)
+{
+	win->size = size > 0 ? size : 1;
+	win->inflight = 0;
+	win->queued = 0;
+	INIT_LIST_HEAD(&win->queue);
+}
+
+/**
+  *  @brief take a slot of the window for a request, or queue it
+  *
+  *  @param[in] win send window
+  *  @param[in] msg request, copied if queued
+  *  @return
+  *  @retval 0 the request takes a slot, send it now
+  *  @retval 1 the request is queued
+  *  @retval -1 the queue is full, the request is dropped
+  */
+int ipmi_window_get(struct ipmi_window *win, const struct appmsg_ipmi_msg *msg)
+{
+	struct ipmi_window_req *req;
+
+	if (win->inflight < win->size && list_empty(&win->queue)) {
+		win->inflight++;
+		return 0;
+	}
+
+	if (win->queued >= IPMI_WINDOW_QUEUE_MAX)
+		return -1;
+
+	req = malloc(sizeof(*req));
+	if (req == NULL)
+		return -1;
+
+	clock_gettime(CLOCK_MONOTONIC, &req->queued);
+	memcpy(&req->msg, msg, sizeof(req->msg));
+	list_add_tail(&req->list, &win->queue);
+	win->queued++;
+
+	return 1;
+}
+
+/**
+  *  @brief give back the slot of a request done or timed out, and take it
+  *         for the next queued request still in time
+  *
+  *  @param[in] win send window
+  *  @return the request to send and free, NULL if none
+  */
+struct ipmi_window_req *ipmi_window_put(struct ipmi_window *win)
+{
+	struct ipmi_window_req *req;
+	struct timespec now;
+	unsigned int waited;
+
+	if (win->inflight > 0)
+		win->inflight--;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	while (!list_empty(&win->queue)) {
+		req = list_entry(win->queue.next, struct ipmi_window_req, list);
+		list_del(&req->list);
+		win->queued--;
+
+		/* the user does not wait for it any more */
+		waited = (now.tv_sec - req->queued.tv_sec) * 1000 +
+				 (now.tv_nsec - req->queued.tv_nsec) / 1000000;
+		if (waited >= req->msg.timeo) {
+			IPMI_LOG_DEBUG("NetFn:%02X,Cmd:%02X timed out in the send queue\n",
+						   req->msg.msg.netfn, req->msg.msg.cmd);
+			free(req);
+			continue;
+		}
+
+		req->msg.timeo -= waited;
+		win->inflight++;
+		return req;
+	}
+
+	return NULL;
+}
+
+/**
+  *  @brief drop the queued requests, e.g. when the target is closed
+  *
+  *  @param[in] win send window
+  *  @return
+  */
+void ipmi_window_flush(struct ipmi_window *win)
+{
+	struct ipmi_window_req *req, *nxt;
+
+	list_for_each_entry_safe(req, nxt, &win->queue, list) {
+		list_del(&req->list);
+		free(req);
+	}
+
+	win->queued = 0;
+}
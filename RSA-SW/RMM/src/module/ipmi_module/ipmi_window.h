@@ -0,0 +1,53 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __IPMI_WINDOW_H__
+#define __IPMI_WINDOW_H__
+
+#include <time.h>
+
+#include "libutils/list.h"
+#include "libjipmi/common.h"
+
+/*
+ * Send window of a target, an IPMB slave address or a serial port: at most
+ * 'size' requests wait for their response at once, the next ones are
+ * queued and sent as the responses come or time out. The requests in flight
+ * are told apart by their Seq, so a target works on several commands at
+ * once without being flooded. The window is guarded by the table lock of
+ * the target's response handles.
+ */
+#define IPMI_WINDOW_DFLT_SIZE	4
+#define IPMI_WINDOW_QUEUE_MAX	256	/* requests queued by a target at most */
+
+struct ipmi_window_req {
+	struct list_head list;
+	struct timespec queued;
+	struct appmsg_ipmi_msg msg;
+};
+
+struct ipmi_window {
+	unsigned int size;
+	unsigned int inflight;
+	unsigned int queued;
+	struct list_head queue;
+};
+
+extern void ipmi_window_init(struct ipmi_window *win, unsigned int size);
+extern int ipmi_window_get(struct ipmi_window *win, const struct appmsg_ipmi_msg *msg);
+extern struct ipmi_window_req *ipmi_window_put(struct ipmi_window *win);
+extern void ipmi_window_flush(struct ipmi_window *win);
+
+#endif
@@ -14,9 +14,11 @@
 
 
 #ifndef _RMCP_PLUS_H_
-#define _RMCP_PLUS__H_
+#define _RMCP_PLUS_H_
 
+#ifndef IPMI20_SUPPORT
 #define IPMI20_SUPPORT    0
+#endif
 
 
 #if IPMI20_SUPPORT == 1
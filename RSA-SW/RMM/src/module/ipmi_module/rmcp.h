@@ -17,7 +17,9 @@
 #define __IPMI_RMCP_H__
 
 #include "ipmi.h"
+#include "ipmi_timer.h"
 #include "rmcp+.h"
+#include "ipmi20_crypto.h"
 /* IPMI v1.5 on LAN */
 
 /* Display an IP address in readable format */
@@ -180,14 +182,13 @@ struct ipmi_session {
 
 
 	struct list_head hash;	/* hashed by IP */
-	struct list_head list;	/* added in single list for time thread scanning */
 
 	int state;
 
 #ifdef DEBUG_IPMI
 	struct timespec start_time;
 #endif
-	unsigned int timeout;
+	struct ipmi_timer timer;	/* setup or idle time out */
 
 	struct list_head msg_list;	/* user ipmi msg waiting for sending before session up */
 	struct list_head req_list;
@@ -227,6 +228,7 @@ struct ipmi_session {
 	unsigned char key_k1[20];
 	unsigned char key_k2[20];
 	unsigned char key_k3[20];
+	struct ipmi20_crypto crypto;	/* contexts keyed by K1/K2 */
 
 	unsigned int session_seq;
 
@@ -260,6 +262,7 @@ struct ipmi_session {
 };
 
 extern void init_rmcp_session(void);
+extern void rmcp_session_tick(void);
 extern int format_rmcp_ipmi_msg(unsigned char *buff, struct ipmi_msg *ipmi,
 			unsigned int msgid, unsigned int timeo,
 			struct ipmi_addr *addr, char *username, char *password,
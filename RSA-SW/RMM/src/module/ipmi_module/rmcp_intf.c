@@ -16,6 +16,10 @@
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/prctl.h>
 #include <pthread.h>
 #include <unistd.h>
 #include <stdio.h>
@@ -24,13 +28,25 @@
 
 #include "ipmi.h"
 #include "rmcp.h"
-#include "event.h"
+#include "rmcp_sock.h"
 #include "ipmi_log.h"
-#include "libutils/sock.h"
+#include "ipmi_timer.h"
 #include "librmmcfg/rmm_cfg.h"
 
 #define RMCP_MSG_QUEUE_NUM		512
 
+/*
+ * The BMCs are spread over up to one shard per CPU by their address. A
+ * shard thread has its own UDP socket, RMCP session table and timers,
+ * and waits for them and for the messages queued by the applications
+ * with epoll. So the sessions of different BMCs are set up and used in
+ * parallel, and a session is only touched by its shard, without a lock.
+ * The sockets share the RmcpClientPort, see rmcp_sock.h. How throughput
+ * scales with the number of shards has not been measured yet.
+ */
+#define RMCP_SHARD_MAX			8
+#define RMCP_SHARD_HASH(host)	RMCP_SHARD_OF(host, rmcp_shard_num)
+
 struct rmcp_recv_msg {
 	struct rmcp_recv_msg *next;		/* free buffer link */
 
@@ -41,22 +57,43 @@ struct rmcp_recv_msg {
 	unsigned char msg[IPMI_MAX_MSG_LENGTH];
 };
 
+struct rmcp_send_msg {
+	struct rmcp_send_msg *next;		/* free buffer link */
+
+	struct appmsg_ipmi_msg ipmi;
+};
+
 struct rmcp_msg_head {
-	struct rmcp_recv_msg  *head;
-	struct rmcp_recv_msg **tail;
+	struct rmcp_send_msg  *head;
+	struct rmcp_send_msg **tail;
 };
 
-static struct fd_event       rmcp_fd_event;
+struct rmcp_shard {
+	int id;
+	int fd;				/* UDP socket to the BMCs */
+	int event_fd;		/* messages queued */
+	int timer_fd;
+
+	pthread_mutex_t       mutex;
+	struct rmcp_msg_head  queue;
+	struct rmcp_send_msg *freelist;
+};
+
+static struct rmcp_shard rmcp_shards[RMCP_SHARD_MAX];
+static int rmcp_shard_num;
+
+/* socket of the shard of the calling thread */
+static __thread int rmcp_fd = -1;
 
 /**
-  *  @brief open RMCP interface, create the socket
+  *  @brief open RMCP interface, create the sockets of all the shards
   *
   *  @param
-  *  @return RMCP socket
+  *  @return
   */
-static inline int open_rmcp_interface(void)
+static void open_rmcp_interface(void)
 {
-	int port;
+	int port, shared, i;
 
 	port = rmm_cfg_get_port(IPMIRMCPCLIENT_PORT);
 	if (port == 0) {
@@ -64,7 +101,27 @@ static inline int open_rmcp_interface(void)
 		exit(-1);
 	}
 
-	return create_udp_listen(INADDR_ANY, port, 0, 0);
+	/* all of them before any shard sends, for the steering */
+	for (i = 0; i < rmcp_shard_num; i++) {
+		rmcp_shards[i].fd = rmcp_sock_open(port, i, rmcp_shard_num, &shared);
+		if (rmcp_shards[i].fd == -1)
+			FATAL("Failed to open RMCP interface!\n");
+		if (!shared && i == 1)
+			IPMI_LOG_ERR("RMCP shards cannot share port %d, the others use ephemeral ports\n",
+						 port);
+	}
+}
+
+static int get_shard_num(void)
+{
+	long num = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (num < 1)
+		return 1;
+	if (num > RMCP_SHARD_MAX)
+		return RMCP_SHARD_MAX;
+
+	return num;
 }
 
 /**
@@ -109,7 +166,7 @@ void rmcp_send_outbound_msg(unsigned char *msg, int len, unsigned int host, unsi
 		dest.sin_port = htons(IPMI_RMCP_PORT);
 	dest.sin_addr.s_addr = host;
 
-	sendto(rmcp_fd_event.fd, msg, len, 0, (struct sockaddr *)&dest, sizeof(dest));
+	sendto(rmcp_fd, msg, len, 0, (struct sockaddr *)&dest, sizeof(dest));
 }
 
 /**
@@ -147,19 +204,171 @@ static void rmcp_recv_inbound_msg(int fd)
 }
 
 /**
-  *  @brief start RMCP interface, create the new thread
+  *  @brief queue an application IPMI msg to the shard of its BMC
+  *
+  *  @param[in] msg IPMI msg
+  *  @return
+  */
+void rmcp_queue_outbound_msg(struct appmsg_ipmi_msg *msg)
+{
+	struct rmcp_shard *shard = &rmcp_shards[RMCP_SHARD_HASH(msg->addr.addr.rmcp.host)];
+	struct rmcp_send_msg *send;
+	uint64_t one = 1;
+
+	pthread_mutex_lock(&shard->mutex);
+	send = shard->freelist;
+	if (send != NULL) {
+		shard->freelist = send->next;
+
+		memcpy(&send->ipmi, msg, sizeof(*msg));
+		send->next = NULL;
+		*shard->queue.tail = send;
+		shard->queue.tail = &send->next;
+	}
+	pthread_mutex_unlock(&shard->mutex);
+
+	if (send == NULL) {
+		IPMI_LOG_ERR("RMCP-Intf: No Msg Buff, adjust #RMCP_MSG_QUEUE_NUM(%d)!\n",
+					 RMCP_MSG_QUEUE_NUM);
+		return;
+	}
+
+	if (write(shard->event_fd, &one, sizeof(one)) != sizeof(one))
+		IPMI_LOG_ERR("Failed to wake up RMCP shard %d\n", shard->id);
+}
+
+/**
+  *  @brief send the application msgs queued to a shard
+  *
+  *  @param[in] shard RMCP shard
+  *  @return
+  */
+static void rmcp_send_queued_msg(struct rmcp_shard *shard)
+{
+	struct rmcp_send_msg *head, *send, **tail;
+	uint64_t count;
+
+	if (read(shard->event_fd, &count, sizeof(count)) != sizeof(count))
+		return;
+
+	pthread_mutex_lock(&shard->mutex);
+	head = shard->queue.head;
+	shard->queue.head = NULL;
+	shard->queue.tail = &shard->queue.head;
+	pthread_mutex_unlock(&shard->mutex);
+
+	if (head == NULL)
+		return;
+
+	for (send = head; send != NULL; send = send->next) {
+		deliver_ipmi_msg_by_rmcp(&send->ipmi);
+		tail = &send->next;
+	}
+
+	pthread_mutex_lock(&shard->mutex);
+	*tail = shard->freelist;
+	shard->freelist = head;
+	pthread_mutex_unlock(&shard->mutex);
+}
+
+/**
+  *  @brief RMCP shard thread, handle the sessions of its BMCs
+  *
+  *  @param[in] argv RMCP shard
+  *  @return
+  */
+static void *rmcp_shard_thread(void *argv)
+{
+	struct rmcp_shard *shard = (struct rmcp_shard *)argv;
+	struct epoll_event ev, events[3];
+	char name[16];
+	uint64_t ticks;
+	int epfd;
+	int fds[3] = { shard->fd, shard->event_fd, shard->timer_fd };
+	int i, n;
+
+	snprintf(name, sizeof(name), "rmcp_shard_%d", shard->id);
+	prctl(PR_SET_NAME, name);
+
+	rmcp_fd = shard->fd;
+	init_rmcp_msg_handler();
+
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd < 0)
+		FATAL("Failed to create RMCP shard epoll!\n");
+
+	for (i = 0; i < 3; i++) {
+		ev.events = EPOLLIN;
+		ev.data.fd = fds[i];
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, fds[i], &ev) < 0)
+			FATAL("Failed to add RMCP shard fd to epoll!\n");
+	}
+
+	while (ipmi_module_exit == false) {
+		n = epoll_wait(epfd, events, 3, -1);
+
+		for (i = 0; i < n; i++) {
+			if (events[i].data.fd == shard->fd)
+				rmcp_recv_inbound_msg(shard->fd);
+			else if (events[i].data.fd == shard->event_fd)
+				rmcp_send_queued_msg(shard);
+			else if (read(shard->timer_fd, &ticks, sizeof(ticks)) == sizeof(ticks))
+				rmcp_session_tick();
+		}
+	}
+
+	close(epfd);
+	return NULL;
+}
+
+/**
+  *  @brief start a RMCP shard, its socket is open
+  *
+  *  @param[in] shard RMCP shard
+  *  @return
+  */
+static void start_rmcp_shard(struct rmcp_shard *shard)
+{
+	struct itimerspec tick = {
+		.it_interval = { 0, IPMI_TIMER_TICK_MS * 1000 * 1000 },
+		.it_value    = { 0, IPMI_TIMER_TICK_MS * 1000 * 1000 },
+	};
+	pthread_t tid;
+
+	shard->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	shard->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (shard->event_fd < 0 || shard->timer_fd < 0 ||
+		timerfd_settime(shard->timer_fd, 0, &tick, NULL) < 0)
+		FATAL("Failed to create RMCP shard events!\n");
+
+	pthread_mutex_init(&shard->mutex, NULL);
+	shard->queue.head = NULL;
+	shard->queue.tail = &shard->queue.head;
+	shard->freelist = mem_freelist_create(RMCP_MSG_QUEUE_NUM, sizeof(struct rmcp_send_msg));
+	if (shard->freelist == NULL)
+		FATAL("Failed to alloc RMCP msg queue!\n");
+
+	if (pthread_create(&tid, NULL, rmcp_shard_thread, shard) != 0)
+		FATAL("Failed to create RMCP shard thread!\n");
+}
+
+/**
+  *  @brief start RMCP interface, create the shard threads
   *
   *  @param
   *  @return
   */
 void register_rmcp_resp(void)
 {
-	init_rmcp_msg_handler();
-	rmcp_fd_event.fd = open_rmcp_interface();
-	if (rmcp_fd_event.fd == -1)
-		FATAL("Failed to open RMCP interface!\n");
-	rmcp_fd_event.handle_fd = rmcp_recv_inbound_msg;
-	fd_event_add(&rmcp_fd_event);
+	int i;
+
+	rmcp_shard_num = get_shard_num();
+	open_rmcp_interface();
+	for (i = 0; i < rmcp_shard_num; i++) {
+		rmcp_shards[i].id = i;
+		start_rmcp_shard(&rmcp_shards[i]);
+	}
 
-	IPMI_LOG_INFO("RMCP-Intf (Client IPMI-v1.5) is started successfully!\n");
+	IPMI_LOG_INFO("RMCP-Intf (Client IPMI-v1.5) is started successfully with %d shards!\n",
+				  rmcp_shard_num);
 }
@@ -20,7 +20,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
-#include <openssl/md5.h>
+#include <openssl/evp.h>
 
 #include "ipmi.h"
 #include "rmcp.h"
@@ -37,6 +37,9 @@
 #define IPMI_SESSION_TABLE_HASH(host)	\
 		((ntohl(host)) & IPMI_SESSION_TABLE_MASK)
 
+#define IPMI_REQUEST_HASH_SIZE		(1024)
+#define IPMI_REQUEST_HASH_MASK		(IPMI_REQUEST_HASH_SIZE - 1)
+
 enum ipmi_session_state {
 	IPMI_SESS_STATE_AUTH_CAP_REQ_SENT = 1,
 	IPMI_SESS_STATE_SESSION_CHALLENGE_SENT,
@@ -69,8 +72,9 @@ struct ipmi_req_entry {
 
 
 	struct list_head link;	/* Link to "struct ipmi_session" */
-	struct list_head list;	/* ALL the IPMI Req we have sent */
+	struct list_head hash;	/* hashed by session, seq, netfn and cmd */
 
+	struct ipmi_session *sess;
 	unsigned int msgid;
 	unsigned short user_port;
 	ipmi_json_ipc_header_t header;
@@ -80,26 +84,26 @@ struct ipmi_req_entry {
 #ifdef DEBUG_IPMI
 	struct timespec start_time;
 #endif
-	unsigned int timeout;
+	struct ipmi_timer timer;
 };
 
+/*
+ * The sessions are sharded by BMC address, each shard thread of
+ * rmcp_intf.c owns a table and it is the only one to use it.
+ */
 struct ipmi_session_table {
-	pthread_mutex_t  lock;
-
 	struct ipmi_session   *ses_freelist;
 	struct ipmi_msg_sent  *msg_freelist;
 	struct ipmi_req_entry *req_freelist;
 
-	/* Scaned by time thread */
-	struct list_head request_list;
-	struct list_head session_list;
+	/* Session and request time out */
+	struct ipmi_timer_wheel wheel;
 
 	struct list_head session_table[IPMI_SESSION_TABLE_SIZE];
-
-	pthread_t time_tid;
+	struct list_head request_table[IPMI_REQUEST_HASH_SIZE];
 };
 
-static struct ipmi_session_table session_table;
+static __thread struct ipmi_session_table *session_table;
 
 /**
   *  @brief convert to little-endian 32bits
@@ -125,21 +129,95 @@ static void cpu_to_le32(unsigned int *p)
 void ipmi_auth_md5(struct ipmi_session *s, unsigned char *authcode,
 			unsigned char *data, unsigned int data_len)
 {
+	static __thread EVP_MD_CTX *ctx;
 	unsigned int seq;
-	MD5_CTX ctx;
 
 	seq = s->inbound_seq;
 	cpu_to_le32(&seq);
 
-	MD5_Init(&ctx);
+	if (ctx == NULL && (ctx = EVP_MD_CTX_create()) == NULL)
+		FATAL("Failed to alloc the MD5 context!\n");
+
+	EVP_DigestInit_ex(ctx, EVP_md5(), NULL);
+
+	EVP_DigestUpdate(ctx, (unsigned char *)s->password, 16);
+	EVP_DigestUpdate(ctx, (unsigned char *)&s->session_id, 4);
+	EVP_DigestUpdate(ctx, (unsigned char *)data, data_len);
+	EVP_DigestUpdate(ctx, (unsigned char *)&seq, 4);
+	EVP_DigestUpdate(ctx, (unsigned char *)s->password, 16);
 
-	MD5_Update(&ctx, (unsigned char *)s->password, 16);
-	MD5_Update(&ctx, (unsigned char *)&s->session_id, 4);
-	MD5_Update(&ctx, (unsigned char *)data, data_len);
-	MD5_Update(&ctx, (unsigned char *)&seq, 4);
-	MD5_Update(&ctx, (unsigned char *)s->password, 16);
+	EVP_DigestFinal_ex(ctx, authcode, NULL);
+}
+
+static struct list_head *request_hash(struct ipmi_session *sess, unsigned char seq,
+			unsigned char netfn, unsigned char cmd)
+{
+	unsigned int hash = (unsigned long)sess / sizeof(*sess);
+
+	hash = hash * 31 + seq;
+	hash = hash * 31 + netfn;
+	hash = hash * 31 + cmd;
 
-	MD5_Final(authcode, &ctx);
+	return &session_table->request_table[hash & IPMI_REQUEST_HASH_MASK];
+}
+
+/**
+  *  @brief find the request of a session waiting for the response
+  *
+  *  @param[in] sess IPMI session
+  *  @param[in] seq IPMI sequence number
+  *  @param[in] netfn request netfn
+  *  @param[in] cmd IPMI command
+  *  @return the request, NULL if not found
+  */
+static struct ipmi_req_entry *find_request(struct ipmi_session *sess, unsigned char seq,
+			unsigned char netfn, unsigned char cmd)
+{
+	struct ipmi_req_entry *req;
+
+	list_for_each_entry(req, request_hash(sess, seq, netfn, cmd), hash) {
+		if (req->sess == sess &&
+		    req->match.seq == seq &&
+		    req->match.netfn == netfn &&
+		    req->match.cmd == cmd)
+			return req;
+	}
+
+	return NULL;
+}
+
+static void free_request(struct ipmi_req_entry *req)
+{
+	struct ipmi_session_table *table = session_table;
+
+	list_del(&req->link);
+	list_del(&req->hash);
+	ipmi_timer_del(&req->timer);
+
+	req->next = table->req_freelist;
+	table->req_freelist = req;
+}
+
+/**
+  *  @brief a request got no response in time
+  *
+  *  @param[in] timer request timer
+  *  @return
+  */
+static void request_expired(struct ipmi_timer *timer)
+{
+	struct ipmi_req_entry *req = container_of(timer, struct ipmi_req_entry, timer);
+#ifdef DEBUG_IPMI
+	struct timespec now;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	IPMI_LOG_INFO("RMCP request (%02X:%02X) expired %ld:%ld -> %ld:%ld\n",
+				  req->match.netfn, req->match.cmd,
+				  req->start_time.tv_sec, req->start_time.tv_nsec,
+				  now.tv_sec, now.tv_nsec);
+#endif
+
+	free_request(req);
 }
 
 /**
@@ -162,18 +240,9 @@ static int rmcp_intf_find_seq(struct ipmi_session *sess,
 {
 	int rv = -1;
 	unsigned char netfn = match->netfn & 0x3E;	/* request netfn */
-	struct ipmi_req_entry *req = NULL, *pos;
-	struct ipmi_session_table *table = &session_table;
-
-	list_for_each_entry(pos, &sess->req_list, link) {
-		if (pos->match.seq == match->seq &&
-		    pos->match.netfn == netfn &&
-		    pos->match.cmd == match->cmd) {
-			req = pos;
-			break;
-		}
-	}
+	struct ipmi_req_entry *req;
 
+	req = find_request(sess, match->seq, netfn, match->cmd);
 	if (req == NULL) {
 		IPMI_LOG_ERR("Req found is NULL...\n");
 		goto ret;
@@ -183,17 +252,14 @@ static int rmcp_intf_find_seq(struct ipmi_session *sess,
 	*user_port = req->user_port;
 
 	/*copy header*/
-	memset(header->method, 0, sizeof(JRPC_METHOD_MAX));
+	memset(header->method, 0, sizeof(header->method));
 	header->ip = req->header.ip;
 	header->port = req->header.port;
 	header->json_ipc_id = req->header.json_ipc_id;
 	if (strlen((const char *)(req->header.method)) < JRPC_METHOD_MAX)
-		memcpy(header->method, req->header.method, strlen((const char *)(req->header.method)));
+		memcpy(header->method, req->header.method, strlen((const char *)(req->header.method)) + 1);
 
-	list_del(&req->link);
-	list_del(&req->list);
-	req->next = table->req_freelist;
-	table->req_freelist = req;
+	free_request(req);
 
 	rv = 0;
 
@@ -223,8 +289,8 @@ static int rmcp_intf_next_seq(struct ipmi_session *sess,
 	unsigned int i;
 	unsigned char netfn = match->netfn & 0x3E;	/* request netfn */
 	unsigned char seq = IPMB_SEQ_SIZE;
-	struct ipmi_req_entry *req, *pos;
-	struct ipmi_session_table *table = &session_table;
+	struct ipmi_req_entry *req;
+	struct ipmi_session_table *table = session_table;
 
 	req = table->req_freelist;
 	if (req == NULL) {
@@ -234,18 +300,7 @@ static int rmcp_intf_next_seq(struct ipmi_session *sess,
 	}
 
 	for (i = sess->curr_seq; IPMB_SEQ_HASH(i+1) != sess->curr_seq; i = IPMB_SEQ_HASH(i+1)) {
-		int conflict = 0;
-
-		list_for_each_entry(pos, &sess->req_list, link) {
-			if (pos->match.seq == i &&
-			    pos->match.netfn == netfn &&
-			    pos->match.cmd == match->cmd) {
-				conflict = 1;
-				break;
-			}
-		}
-
-		if (!conflict) {
+		if (find_request(sess, i, netfn, match->cmd) == NULL) {
 			IPMI_LOG_DEBUG("RMCP IPMI to "NIPQUAD_FMT" NetFn:%02X,Cmd:%02X uses Seq:%02X\n",
 						   NIPQUAD(sess->host),
 						   netfn, match->cmd, i);
@@ -262,27 +317,29 @@ static int rmcp_intf_next_seq(struct ipmi_session *sess,
 	table->req_freelist = req->next;
 	req->next = NULL;
 
-	list_add_tail(&req->link, &sess->req_list);
-	list_add_tail(&req->list, &table->request_list);
-
+	req->sess = sess;
 	req->msgid = msgid;
 	req->user_port = user_port;
 	req->match.seq = seq;
 	req->match.netfn = netfn;
 	req->match.cmd = match->cmd;
 
+	list_add_tail(&req->link, &sess->req_list);
+	list_add_tail(&req->hash, request_hash(sess, seq, netfn, match->cmd));
+
 	/*copy header*/
-	memset(req->header.method, 0, sizeof(JRPC_METHOD_MAX));
+	memset(req->header.method, 0, sizeof(req->header.method));
 	req->header.ip = header.ip;
 	req->header.port = header.port;
 	req->header.json_ipc_id = header.json_ipc_id;
 	if (strlen((const char *)header.method) < JRPC_METHOD_MAX)
-		memcpy(req->header.method, header.method, strlen((const char *)header.method));
+		memcpy(req->header.method, header.method, strlen((const char *)header.method) + 1);
 
 #ifdef DEBUG_IPMI
 	clock_gettime(CLOCK_REALTIME, &req->start_time);
 #endif
-	req->timeout = timeo;
+	ipmi_timer_init(&req->timer, request_expired);
+	ipmi_timer_add(&table->wheel, &req->timer, timeo);
 
 	match->seq = seq;
 	sess->curr_seq = IPMB_SEQ_HASH(seq + 1);
@@ -303,10 +360,10 @@ static void relase_ipmi_session(struct ipmi_session *sess)
 {
 	struct ipmi_msg_sent  *msg, *msg_next;
 	struct ipmi_req_entry *req, *req_next;
-	struct ipmi_session_table *table = &session_table;
+	struct ipmi_session_table *table = session_table;
 
-	list_del(&sess->list);
 	list_del(&sess->hash);
+	ipmi_timer_del(&sess->timer);
 
 	list_for_each_entry_safe(msg, msg_next, &sess->msg_list, list) {
 		list_del(&msg->list);
@@ -315,86 +372,33 @@ static void relase_ipmi_session(struct ipmi_session *sess)
 		table->msg_freelist = msg;
 	}
 
-	list_for_each_entry_safe(req, req_next, &sess->req_list, link) {
-		list_del(&req->link);
-		list_del(&req->list);
-
-		req->next = table->req_freelist;
-		table->req_freelist = req;
-	}
+	list_for_each_entry_safe(req, req_next, &sess->req_list, link)
+		free_request(req);
 
 	sess->next = table->ses_freelist;
 	table->ses_freelist = sess;
 }
 
 /**
-  *  @brief
+  *  @brief the session was not set up or used in time
   *
-  *  @param
+  *  @param[in] timer session timer
   *  @return
   */
-static void *rmcp_time_thread(void *unused)
+static void session_expired(struct ipmi_timer *timer)
 {
-	struct timespec expire;
-	struct ipmi_session *sess, *sess_next;
-	struct ipmi_req_entry *req, *req_next;
-	struct ipmi_session_table *table = &session_table;
-	pthread_cond_t nul_cond = PTHREAD_COND_INITIALIZER;
-
-	prctl(PR_SET_NAME, "rmcp_time_thread");
-
-	for (;;) {
-		clock_gettime(CLOCK_REALTIME, &expire);
-		expire.tv_sec += (IPMI_PERIOD_TIME_MS/1000);
-		expire.tv_nsec += (IPMI_PERIOD_TIME_MS % 1000) * (1000*1000);
-		if (expire.tv_nsec >= BILLION) {
-			expire.tv_sec += expire.tv_nsec / BILLION;
-			expire.tv_nsec %= BILLION;
-		}
-
-		pthread_mutex_lock(&table->lock);
-
-		while (pthread_cond_timedwait(&nul_cond, &table->lock, &expire) != ETIMEDOUT)
-			/* Nothing! */;
-
+	struct ipmi_session *sess = container_of(timer, struct ipmi_session, timer);
 #ifdef DEBUG_IPMI
-		clock_gettime(CLOCK_REALTIME, &expire);
-#endif
+	struct timespec now;
 
-		list_for_each_entry_safe(sess, sess_next, &table->session_list, list) {
-			sess->timeout -= IPMI_PERIOD_TIME_MS;
-			if (sess->timeout > 0)
-				continue;
-
-			IPMI_LOG_INFO("RMCP session to "NIPQUAD_FMT" expired %ld:%ld -> %ld:%ld\n",
-						  NIPQUAD(sess->host),
-						  sess->start_time.tv_sec, sess->start_time.tv_nsec,
-						  expire.tv_sec, expire.tv_nsec);
-
-			relase_ipmi_session(sess);
-		}
-
-		list_for_each_entry_safe(req, req_next, &table->request_list, list) {
-			req->timeout -= IPMI_PERIOD_TIME_MS;
-			if (req->timeout > 0)
-				continue;
-
-			IPMI_LOG_INFO("RMCP request (%02X:%02X) expired %ld:%ld -> %ld:%ld\n",
-						  req->match.netfn, req->match.cmd,
-						  req->start_time.tv_sec, req->start_time.tv_nsec,
-						  expire.tv_sec, expire.tv_nsec);
-
-			list_del(&req->list);
-			list_del(&req->link);
-
-			req->next = table->req_freelist;
-			table->req_freelist = req;
-		}
-
-		pthread_mutex_unlock(&table->lock);
-	}
+	clock_gettime(CLOCK_REALTIME, &now);
+	IPMI_LOG_INFO("RMCP session to "NIPQUAD_FMT" expired %ld:%ld -> %ld:%ld\n",
+				  NIPQUAD(sess->host),
+				  sess->start_time.tv_sec, sess->start_time.tv_nsec,
+				  now.tv_sec, now.tv_nsec);
+#endif
 
-	return NULL;
+	relase_ipmi_session(sess);
 }
 
 
@@ -656,11 +660,11 @@ static void flush_ipmi_user_msg(struct ipmi_session *sess)
 	int msglen;
 	struct rmcp_match_info match;
 	struct ipmi_msg_sent *msg, *msg_next;
-	struct ipmi_session_table *table = &session_table;
+	struct ipmi_session_table *table = session_table;
 	unsigned char buff[IPMI_MAX_MSG_LENGTH];
 
 	memset(buff, 0, IPMI_MAX_MSG_LENGTH);
-	sess->timeout = RMCP_IPMI_SESSION_IDLE_TIMEOUT_MS;
+	ipmi_timer_add(&table->wheel, &sess->timer, RMCP_IPMI_SESSION_IDLE_TIMEOUT_MS);
 
 	list_for_each_entry_safe(msg, msg_next, &sess->msg_list, list) {
 		list_del(&msg->list);
@@ -1009,8 +1013,8 @@ enum ipmi20_session_state {
 };
 
 /* Now, we support 0, 1, 2, 3, 6, 7, 11 */
-static unsigned int cipher_suite_id_flag = 0x08cf;
-static unsigned int bmc_cipher_suite_id_flag = 0x00;
+static __thread unsigned int cipher_suite_id_flag = 0x08cf;
+static __thread unsigned int bmc_cipher_suite_id_flag = 0x00;
 
 
 /**
@@ -1032,7 +1036,7 @@ static unsigned char *ipmi20_lan_plus_build_cmd(struct ipmi_session *sess,
 	unsigned char *buf = NULL;
 	unsigned char data[IPMI_MAX_MSG_LENGTH];
 	int data_len = 0;
-	unsigned char *data_crypt = NULL;
+	unsigned char data_crypt[IPMI20_CRYPT_MAX_LEN(IPMI_MAX_MSG_LENGTH)];
 	int data_crypt_len = 0;
 
 	static struct rmcp_hdr rmcp = {
@@ -1077,7 +1081,7 @@ static unsigned char *ipmi20_lan_plus_build_cmd(struct ipmi_session *sess,
 		int i = 0;
 		int pad_len = 0;
 		unsigned char *ipmi_data_len_pos = buf + buf_len;
-		unsigned char auth_code[16] = {0};
+		unsigned char auth_code[EVP_MAX_MD_SIZE] = {0};
 
 		data[IPMI_RSADDR_OFFSET] = IPMI_BMC_SLAVE_ADDR;
 		data[IPMI_NETFN_OFFSET] = (req->netfn << 2) | (IPMI_BMC_CMD_LUN);
@@ -1094,9 +1098,9 @@ static unsigned char *ipmi20_lan_plus_build_cmd(struct ipmi_session *sess,
 
 		data[data_len++] = ipmi_csum(&data[3], req->data_len + 3);
 
-		data_crypt = ipmi20_payload_encrypt(sess, ipmi_info, data,
-											data_len, &data_crypt_len);
-		if (NULL == data_crypt) {
+		data_crypt_len = ipmi20_payload_encrypt(sess, data, data_len, data_crypt);
+		if (data_crypt_len < 0 ||
+			buf_len + IPMI20_MSG_PAYLOAD_LEN_LEN + data_crypt_len + 4 + 2 + 12 > IPMI_MAX_MSG_LENGTH) {
 			free(buf);
 			return NULL;
 		}
@@ -1121,13 +1125,14 @@ static unsigned char *ipmi20_lan_plus_build_cmd(struct ipmi_session *sess,
 
 			int auth_code_len = 0;
 
-			auth_code_len = ipmi20_generate_auth_code(sess->integrity_alg,
-													  sess->key_k1, 20,
-													  buf + sizeof(rmcp),
-													  buf_len - sizeof(rmcp),
-													  auth_code);
-			if (20 != auth_code_len)
+			auth_code_len = ipmi20_integrity_code(&sess->crypto,
+												  buf + sizeof(rmcp),
+												  buf_len - sizeof(rmcp),
+												  auth_code);
+			if (20 != auth_code_len) {
+				free(buf);
 				return NULL;
+			}
 
 			memcpy(buf + buf_len, auth_code, 12);
 			buf_len += 12;
@@ -1148,7 +1153,7 @@ static unsigned char *ipmi20_lan_plus_build_cmd(struct ipmi_session *sess,
 #define IPMI20_CIPHER_SUITE_ID_MIN	0
 #define IPMI20_CIPHER_SUITE_ID_MAX	14
 
-static unsigned char list_index;
+static __thread unsigned char list_index;
 
 /**
   *  @brief This function is used to get the request authentication algorithm,
@@ -1433,8 +1438,8 @@ static void handle_ipmi20_auth_cap_resp(struct ipmi_session *sess,
 	}
 }
 
-static unsigned char cipher_suite_data[0x10 * 0x40] = {0}; /* at least, 16 * (0x00 ... 0x3f) */
-static int cipher_suite_data_len;
+static __thread unsigned char cipher_suite_data[0x10 * 0x40] = {0}; /* at least, 16 * (0x00 ... 0x3f) */
+static __thread int cipher_suite_data_len;
 
 /**
   *  @brief handle IPMIv2 get channal cipher suite response
@@ -1895,6 +1900,12 @@ static void handle_rakp_message_4(struct ipmi_session *sess,
 	ipmi20_generate_auth_code(sess->auth_alg, sess->key_sik, 20,
 							  data_verify, 20, sess->key_k3);
 
+	if (ipmi20_crypto_set_keys(&sess->crypto, sess->integrity_alg, sess->key_k1,
+							   sess->crypt_alg, sess->key_k2) != 0) {
+		IPMI_LOG_ERR("IPMI v2.0: Failed to set up the session crypto!\n");
+		return;
+	}
+
 	send_session_v2_privlvl_cmd(sess);
 }
 
@@ -1909,11 +1920,11 @@ static void flush_ipmi20_user_msg(struct ipmi_session *sess)
 	int msglen;
 	struct rmcp_match_info match;
 	struct ipmi_msg_sent *msg, *msg_next;
-	struct ipmi_session_table *table = &session_table;
+	struct ipmi_session_table *table = session_table;
 	struct rmcp_plus_ipmi_info ipmi_info = {0};
 	unsigned char *msg_to_send = NULL;
 
-	sess->timeout = RMCP_IPMI_SESSION_IDLE_TIMEOUT_MS;
+	ipmi_timer_add(&table->wheel, &sess->timer, RMCP_IPMI_SESSION_IDLE_TIMEOUT_MS);
 
 	if (sess->crypt_alg != CRYPT_ALG_NONE)
 		ipmi_info.payload_type |= IPMI20_PAYLOAD_ENCRYPTED_MASK;
@@ -1932,7 +1943,7 @@ static void flush_ipmi20_user_msg(struct ipmi_session *sess)
 
 		match.netfn = msg->msg.netfn;
 		match.cmd   = msg->msg.cmd;
-		if (rmcp_intf_next_seq(sess, &match, msg->timeo, msg->msgid, msg->user_port) != 0)
+		if (rmcp_intf_next_seq(sess, &match, msg->timeo, msg->msgid, msg->user_port, msg->header) != 0)
 			continue;
 
 		msg_to_send = ipmi20_lan_plus_build_cmd(sess, &ipmi_info, &msg->msg,
@@ -2027,7 +2038,7 @@ static void handle_ipmi20_user_msg(struct ipmi_session *sess,
 	union app_msg_union msg;
 	int len = 0;
 	int data_len = 0;
-	unsigned char *payload = NULL;
+	unsigned char payload[IPMI_MAX_MSG_LENGTH];
 	ipmi_json_ipc_header_t header;
 
 	if (ipmi_info->session_id != sess->session_id ||
@@ -2040,13 +2051,17 @@ static void handle_ipmi20_user_msg(struct ipmi_session *sess,
 		return;
 	}
 
-	payload = ipmi20_payload_decrypt(sess, sess->key_k2, ipmi_info, &len);
-	if (NULL == payload)
+	if (ipmi_info->ipmi_data_len < 0 || ipmi_info->ipmi_data_len > sizeof(payload))
+		return;
+
+	len = ipmi20_payload_decrypt(sess, ipmi_info, payload);
+	if (len < 7)
 		return;
 
 	match.netfn = payload[IPMI_NETFN_OFFSET] >> 2;
 	match.seq = payload[IPMI_RQSEQ_OFFSET] >> 2;
 	match.cmd = payload[IPMI_CMD_OFFSET];
+	memset(&header, 0, sizeof(header));
 	if (rmcp_intf_find_seq(sess, &match, &msgid, &user_port, &header) != 0) {
 		IPMI_LOG_DEBUG("No match request for this RCMP IPMI response!\n");
 		return;
@@ -2084,13 +2099,11 @@ void handle_rmcp_plus_get_auth_cap_msg(struct rmcp_ipmi_info *ipmi_info)
 	unsigned int host;
 	unsigned int port;
 	struct ipmi_session *sess;
-	struct ipmi_session_table *table = &session_table;
+	struct ipmi_session_table *table = session_table;
 
 	host = ipmi_info->host;
 	port = ipmi_info->port;
 
-	pthread_mutex_lock(&table->lock);
-
 	list_for_each_entry(sess, &table->session_table[IPMI_SESSION_TABLE_HASH(host)], hash) {
 		if ((sess->host == host) && (sess->port == port)) {
 			handle_ipmi20_auth_cap_resp(sess, ipmi_info);
@@ -2098,8 +2111,6 @@ void handle_rmcp_plus_get_auth_cap_msg(struct rmcp_ipmi_info *ipmi_info)
 			break;
 		}
 	}
-
-	pthread_mutex_unlock(&table->lock);
 }
 
 /**
@@ -2113,13 +2124,11 @@ void handle_rmcp_plus_get_channel_cipher_suite_msg(struct rmcp_ipmi_info *ipmi_i
 	unsigned int host;
 	unsigned int port;
 	struct ipmi_session *sess;
-	struct ipmi_session_table *table = &session_table;
+	struct ipmi_session_table *table = session_table;
 
 	host = ipmi_info->host;
 	port = ipmi_info->port;
 
-	pthread_mutex_lock(&table->lock);
-
 	list_for_each_entry(sess, &table->session_table[IPMI_SESSION_TABLE_HASH(host)], hash) {
 		if ((sess->host == host) && (sess->port == port)) {
 			handle_ipmi20_get_channel_cipher_suites_resp(sess, ipmi_info);
@@ -2127,8 +2136,6 @@ void handle_rmcp_plus_get_channel_cipher_suite_msg(struct rmcp_ipmi_info *ipmi_i
 			break;
 		}
 	}
-
-	pthread_mutex_unlock(&table->lock);
 }
 
 /**
@@ -2142,13 +2149,11 @@ void handle_rmcp_plus_ipmi_msg(struct rmcp_plus_ipmi_info *ipmi_info)
 	unsigned int host;
 	unsigned int port;
 	struct ipmi_session *sess;
-	struct ipmi_session_table *table = &session_table;
+	struct ipmi_session_table *table = session_table;
 
 	host = ipmi_info->host;
 	port = ipmi_info->port;
 
-	pthread_mutex_lock(&table->lock);
-
 	list_for_each_entry(sess, &table->session_table[IPMI_SESSION_TABLE_HASH(host)], hash) {
 		if ((sess->host == host) && (sess->port == port)) {
 			if (sess->state != IPMI20_SESS_STATE_ACTIVE)
@@ -2159,8 +2164,6 @@ void handle_rmcp_plus_ipmi_msg(struct rmcp_plus_ipmi_info *ipmi_info)
 			break;
 		}
 	}
-
-	pthread_mutex_unlock(&table->lock);
 }
 #endif /* End of #if IPMI20_SUPPORT == 1 */
 
@@ -2179,17 +2182,17 @@ void handle_rmcp_plus_ipmi_msg(struct rmcp_plus_ipmi_info *ipmi_info)
   */
 static void setup_ipmi_session(struct ipmi_session *sess, struct ipmi_addr *addr, char *username, char *password)
 {
-	struct ipmi_session_table *table = &session_table;
+	struct ipmi_session_table *table = session_table;
 
 	list_add_tail(&sess->hash, &table->session_table[IPMI_SESSION_TABLE_HASH(addr->addr.rmcp.host)]);
-	list_add_tail(&sess->list, &table->session_list);
 	INIT_LIST_HEAD(&sess->msg_list);
 	INIT_LIST_HEAD(&sess->req_list);
 
 #ifdef DEBUG_IPMI
 	clock_gettime(CLOCK_REALTIME, &sess->start_time);
 #endif
-	sess->timeout = RMCP_IPMI_SESSION_SETUP_TIMEOUT_MS;
+	ipmi_timer_init(&sess->timer, session_expired);
+	ipmi_timer_add(&table->wheel, &sess->timer, RMCP_IPMI_SESSION_SETUP_TIMEOUT_MS);
 	sess->host = addr->addr.rmcp.host;
 	sess->port = addr->addr.rmcp.port;
 	sess->session_id  = 0;
@@ -2230,15 +2233,13 @@ int format_rmcp_ipmi_msg(unsigned char *buff, struct ipmi_msg *ipmi,
 	unsigned int host = addr->addr.rmcp.host;
 	unsigned int port = addr->addr.rmcp.port;
 	struct ipmi_session *sess, *pos;
-	struct ipmi_session_table *table = &session_table;
+	struct ipmi_session_table *table = session_table;
 
 	if (timeo > IPMI_MAX_TIMEOUT_MS)
 		timeo = IPMI_MAX_TIMEOUT_MS;
 	if (timeo == 0)
 		timeo = IPMI_DFLT_TIMEOUT_MS;
 
-	pthread_mutex_lock(&table->lock);
-
 	sess = NULL;
 	list_for_each_entry(pos, &table->session_table[IPMI_SESSION_TABLE_HASH(host)], hash) {
 		if ((pos->host == host) && (pos->port == port)) {
@@ -2277,12 +2278,12 @@ int format_rmcp_ipmi_msg(unsigned char *buff, struct ipmi_msg *ipmi,
 		msgsent->user_port = user_port;
 
 		/*copy header*/
-		memset(msgsent->header.method, 0, sizeof(JRPC_METHOD_MAX));
+		memset(msgsent->header.method, 0, sizeof(msgsent->header.method));
 		msgsent->header.ip = header.ip;
 		msgsent->header.port = header.port;
 		msgsent->header.json_ipc_id = header.json_ipc_id;
 		if (strlen((const char *)header.method) < JRPC_METHOD_MAX)
-			memcpy(msgsent->header.method, header.method, strlen((const char *)header.method));
+			memcpy(msgsent->header.method, header.method, strlen((const char *)header.method) + 1);
 
 		memcpy(&msgsent->msg, ipmi, offset_of(struct ipmi_msg, data) + ipmi->data_len);
 
@@ -2347,12 +2348,10 @@ int format_rmcp_ipmi_msg(unsigned char *buff, struct ipmi_msg *ipmi,
 		}
 #endif
 
-		/*sess->timeout = RMCP_IPMI_SESSION_IDLE_TIMEOUT_MS;*/	/* update the session time */
+		/*ipmi_timer_add(&table->wheel, &sess->timer, RMCP_IPMI_SESSION_IDLE_TIMEOUT_MS);*/	/* update the session time */
 	}
 
 ret:
-	pthread_mutex_unlock(&table->lock);
-
 	return len;
 }
 
@@ -2430,6 +2429,7 @@ static void handle_ipmi_user_msg(struct ipmi_session *sess,
 	match.netfn = ipmi_info->netfn;
 	match.cmd   = ipmi_info->cmd;
 
+	memset(&header, 0, sizeof(header));
 	if (rmcp_intf_find_seq(sess, &match, &msgid, &user_port, &header) != 0) {
 		/* the bridged msg has two response msg with the same id
 		  * need to reduce to find the first match */
@@ -2479,7 +2479,7 @@ void handle_rmcp_ipmi_msg(struct rmcp_ipmi_info *ipmi_info)
 	unsigned int host;
 	unsigned int port;
 	struct ipmi_session *sess;
-	struct ipmi_session_table *table = &session_table;
+	struct ipmi_session_table *table = session_table;
 
 	if ((ipmi_info->netfn & 0x01) == 0 || ipmi_info->data_len == 0) {
 		IPMI_LOG_DEBUG("This is NOT a RMCP IPMI response message, Ignore ...\n");
@@ -2489,26 +2489,23 @@ void handle_rmcp_ipmi_msg(struct rmcp_ipmi_info *ipmi_info)
 	host = ipmi_info->host;
 	port = ipmi_info->port;
 
-	pthread_mutex_lock(&table->lock);
-
 	list_for_each_entry(sess, &table->session_table[IPMI_SESSION_TABLE_HASH(host)], hash) {
 		if ((sess->host == host) && (sess->port == port)) {
 			if (sess->state != IPMI_SESS_STATE_ACTIVE)
 				handle_ipmi_sess_msg(sess, ipmi_info);
 			else {
-				sess->timeout = RMCP_IPMI_SESSION_IDLE_TIMEOUT_MS;	/* update the session time */
+				/* update the session time */
+				ipmi_timer_add(&table->wheel, &sess->timer, RMCP_IPMI_SESSION_IDLE_TIMEOUT_MS);
 				handle_ipmi_user_msg(sess, ipmi_info);
 			}
 
 			break;
 		}
 	}
-
-	pthread_mutex_unlock(&table->lock);
 }
 
 /**
-  *  @brief init RMCP session
+  *  @brief init the RMCP session table of the calling shard thread
   *
   *  @param
   *  @return
@@ -2516,9 +2513,15 @@ void handle_rmcp_ipmi_msg(struct rmcp_ipmi_info *ipmi_info)
 void init_rmcp_session(void)
 {
 	int i;
-	struct ipmi_session_table *table = &session_table;
+	struct ipmi_session_table *table;
+#if IPMI20_SUPPORT == 1
+	struct ipmi_session *sess;
+#endif
 
-	pthread_mutex_init(&table->lock, NULL);
+	table = malloc(sizeof(*table));
+	if (table == NULL)
+		FATAL("Failed to alloc the RMCP session table!\n");
+	session_table = table;
 
 	table->ses_freelist = mem_freelist_create(IPMI_SESSION_QUEUE_SIZE,
 										sizeof(struct ipmi_session));
@@ -2537,13 +2540,27 @@ void init_rmcp_session(void)
 		FATAL("Failed to create the RMCP session freelist!\n");
 	}
 
-	INIT_LIST_HEAD(&table->request_list);
-	INIT_LIST_HEAD(&table->session_list);
+#if IPMI20_SUPPORT == 1
+	for (sess = table->ses_freelist; sess != NULL; sess = sess->next)
+		ipmi20_crypto_init(&sess->crypto);
+#endif
 
 	for (i = 0; i < IPMI_SESSION_TABLE_SIZE; i++)
 		INIT_LIST_HEAD(&table->session_table[i]);
+	for (i = 0; i < IPMI_REQUEST_HASH_SIZE; i++)
+		INIT_LIST_HEAD(&table->request_table[i]);
+
+	ipmi_timer_wheel_setup(&table->wheel);
+}
 
-	if (pthread_create(&table->time_tid, NULL, rmcp_time_thread, NULL) != 0)
-		FATAL("Failed to create RMCP time thread!\n");
+/**
+  *  @brief expire the sessions and requests of the calling shard thread
+  *
+  *  @param
+  *  @return
+  */
+void rmcp_session_tick(void)
+{
+	ipmi_timer_wheel_run(&session_table->wheel);
 }
 
@@ -0,0 +1,399 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "rmcp_sock.h"
+
+/*
+ * BMCs on loopback addresses for the RMCP shards. Each simulated BMC,
+ * 127.0.1.x, answers the sessionless Get Channel Authentication
+ * Capabilities sent to it. The client opens the shard sockets as
+ * ipmi_module does, on one port, and one thread per shard keeps 'window'
+ * requests in flight to each BMC of its shard. The responses must come to
+ * the socket of the shard of the BMC: the ones read by another shard are
+ * counted as misrouted. It runs with 1, 2, 4 ... shards up to the CPUs,
+ * or up to 'shards'. The BMCs listen on port + 1, not to need root.
+ * It fails on misrouted or lost responses only; the request rates it
+ * prints tell about scaling only on a host with as many CPUs as shards.
+ *
+ *     ipmirmcpsim [-b bmcs] [-n requests] [-w window] [-p port] [-s shards]
+ */
+#define DEFAULT_BMCS		32
+#define DEFAULT_REQUESTS	200000
+#define DEFAULT_WINDOW		4
+#define DEFAULT_PORT		26011
+#define SIM_BMC_MAX			250
+#define SIM_SHARD_MAX		8
+#define SIM_LOST_MS			200		/* resend what is in flight after that */
+#define SIM_STALL_MAX		10		/* give up after that many resends in a row */
+
+#define RMCP_HDR_LEN		4
+#define SESS_HDR_LEN		10		/* auth type none, no auth code */
+#define MSG_OFFSET			(RMCP_HDR_LEN + SESS_HDR_LEN)
+#define REQ_LEN				(MSG_OFFSET + 9)
+#define RSP_LEN				(MSG_OFFSET + 15)
+
+#define BMC_ADDR			0x20
+#define SW_ADDR				0x81
+#define NETFN_APP			0x06
+#define GET_CHAN_AUTH_CAP	0x38
+
+struct sim_bmc {
+	int fd;
+	unsigned int host;		/* network order */
+	int shard;
+	int inflight;
+	int done;
+	unsigned char seq;
+};
+
+struct sim_shard {
+	int id;
+	int fd;
+	pthread_t tid;
+	unsigned long done;
+	unsigned long misrouted;
+	unsigned long lost;
+};
+
+static struct sim_bmc bmcs[SIM_BMC_MAX];
+static struct sim_shard shards[SIM_SHARD_MAX];
+static int bmc_num = DEFAULT_BMCS;
+static int per_bmc;
+static int window = DEFAULT_WINDOW;
+static int bmc_port;
+static volatile int stop;
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void usage(char *name)
+{
+	printf("usage: %s [-b bmcs] [-n requests] [-w window] [-p port] [-s shards]\n", name);
+	exit(-1);
+}
+
+static unsigned char csum(unsigned char *data, int len)
+{
+	unsigned char sum = 0;
+
+	while (len-- > 0)
+		sum += *data++;
+
+	return -sum;
+}
+
+static void put_headers(unsigned char *pkt, int msg_len)
+{
+	memset(pkt, 0, MSG_OFFSET);
+	pkt[0] = 0x06;			/* RMCP version 1 */
+	pkt[2] = 0xFF;			/* no RMCP ACK */
+	pkt[3] = 0x07;			/* class IPMI */
+	pkt[MSG_OFFSET - 1] = msg_len;
+}
+
+static int find_bmc(unsigned int host)
+{
+	int i;
+
+	for (i = 0; i < bmc_num; i++) {
+		if (bmcs[i].host == host)
+			return i;
+	}
+
+	return -1;
+}
+
+/**
+  *  @brief the BMCs, answer every request on their sockets
+  */
+static void *bmc_thread(void *unused)
+{
+	struct pollfd pfd[SIM_BMC_MAX];
+	struct sockaddr_in from;
+	socklen_t from_len;
+	unsigned char req[64], rsp[RSP_LEN];
+	unsigned char *msg = rsp + MSG_OFFSET;
+	int i, rc;
+
+	for (i = 0; i < bmc_num; i++) {
+		pfd[i].fd = bmcs[i].fd;
+		pfd[i].events = POLLIN;
+	}
+
+	while (!stop) {
+		if (poll(pfd, bmc_num, 100) <= 0)
+			continue;
+
+		for (i = 0; i < bmc_num; i++) {
+			if (!(pfd[i].revents & POLLIN))
+				continue;
+
+			for (;;) {
+				from_len = sizeof(from);
+				rc = recvfrom(bmcs[i].fd, req, sizeof(req), 0, (struct sockaddr *)&from, &from_len);
+				if (rc < 0)
+					break;
+				if (rc != REQ_LEN || req[MSG_OFFSET + 5] != GET_CHAN_AUTH_CAP)
+					continue;
+
+				put_headers(rsp, RSP_LEN - MSG_OFFSET);
+				msg[0] = SW_ADDR;
+				msg[1] = (NETFN_APP + 1) << 2;
+				msg[2] = csum(msg, 2);
+				msg[3] = BMC_ADDR;
+				msg[4] = req[MSG_OFFSET + 4];	/* rqSeq */
+				msg[5] = GET_CHAN_AUTH_CAP;
+				msg[6] = 0;						/* completion code */
+				msg[7] = req[MSG_OFFSET + 6] & 0x0F;
+				msg[8] = 0x15;					/* none, MD5 */
+				memset(&msg[9], 0, 5);
+				msg[14] = csum(&msg[3], 11);
+				sendto(bmcs[i].fd, rsp, RSP_LEN, 0, (struct sockaddr *)&from, from_len);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static void send_req(struct sim_shard *shard, struct sim_bmc *bmc)
+{
+	struct sockaddr_in dest;
+	unsigned char req[REQ_LEN];
+	unsigned char *msg = req + MSG_OFFSET;
+
+	put_headers(req, REQ_LEN - MSG_OFFSET);
+	msg[0] = BMC_ADDR;
+	msg[1] = NETFN_APP << 2;
+	msg[2] = csum(msg, 2);
+	msg[3] = SW_ADDR;
+	msg[4] = (bmc->seq++ & 0x3F) << 2;
+	msg[5] = GET_CHAN_AUTH_CAP;
+	msg[6] = 0x0E;			/* this channel */
+	msg[7] = 0x04;			/* administrator */
+	msg[8] = csum(&msg[3], 5);
+
+	memset(&dest, 0, sizeof(dest));
+	dest.sin_family = AF_INET;
+	dest.sin_port = htons(bmc_port);
+	dest.sin_addr.s_addr = bmc->host;
+	if (sendto(shard->fd, req, REQ_LEN, 0, (struct sockaddr *)&dest, sizeof(dest)) == REQ_LEN)
+		bmc->inflight++;
+}
+
+/* fill the window of each BMC of the shard, return 1 if all are done */
+static int fill(struct sim_shard *shard)
+{
+	struct sim_bmc *bmc;
+	int i, all = 1;
+
+	for (i = 0; i < bmc_num; i++) {
+		bmc = &bmcs[i];
+		if (bmc->shard != shard->id || bmc->done >= per_bmc)
+			continue;
+
+		all = 0;
+		while (bmc->inflight < window && bmc->done + bmc->inflight < per_bmc)
+			send_req(shard, bmc);
+	}
+
+	return all;
+}
+
+/**
+  *  @brief a shard, keep 'window' requests in flight to each of its BMCs
+  */
+static void *shard_thread(void *arg)
+{
+	struct sim_shard *shard = (struct sim_shard *)arg;
+	struct sockaddr_in from;
+	socklen_t from_len;
+	struct pollfd pfd;
+	unsigned char rsp[64];
+	int i, rc, stalls = 0;
+
+	pfd.fd = shard->fd;
+	pfd.events = POLLIN;
+
+	while (!fill(shard)) {
+		rc = poll(&pfd, 1, SIM_LOST_MS);
+		if (rc == 0) {
+			if (++stalls == SIM_STALL_MAX)
+				break;
+
+			/* lost, or read by another shard */
+			for (i = 0; i < bmc_num; i++) {
+				if (bmcs[i].shard == shard->id) {
+					shard->lost += bmcs[i].inflight;
+					bmcs[i].inflight = 0;
+				}
+			}
+			continue;
+		}
+
+		for (;;) {
+			from_len = sizeof(from);
+			rc = recvfrom(shard->fd, rsp, sizeof(rsp), 0, (struct sockaddr *)&from, &from_len);
+			if (rc < 0)
+				break;
+
+			i = find_bmc(from.sin_addr.s_addr);
+			if (rc != RSP_LEN || i < 0)
+				continue;
+			if (bmcs[i].shard != shard->id) {
+				shard->misrouted++;
+				continue;
+			}
+
+			stalls = 0;
+			if (bmcs[i].inflight > 0)
+				bmcs[i].inflight--;
+			bmcs[i].done++;
+			shard->done++;
+		}
+	}
+
+	return NULL;
+}
+
+static int run(int port, int shard_num, int total)
+{
+	unsigned long done = 0, misrouted = 0, lost = 0;
+	double start, sec;
+	int i, shared = 0, all_shared = 1;
+
+	for (i = 0; i < shard_num; i++) {
+		memset(&shards[i], 0, sizeof(shards[i]));
+		shards[i].id = i;
+		shards[i].fd = rmcp_sock_open(port, i, shard_num, &shared);
+		if (shards[i].fd < 0) {
+			perror("rmcp_sock_open");
+			return -1;
+		}
+		all_shared &= shared;
+	}
+
+	for (i = 0; i < bmc_num; i++) {
+		bmcs[i].shard = RMCP_SHARD_OF(bmcs[i].host, shard_num);
+		bmcs[i].inflight = 0;
+		bmcs[i].done = 0;
+	}
+
+	start = now_sec();
+	for (i = 0; i < shard_num; i++)
+		pthread_create(&shards[i].tid, NULL, shard_thread, &shards[i]);
+	for (i = 0; i < shard_num; i++) {
+		pthread_join(shards[i].tid, NULL);
+		done += shards[i].done;
+		misrouted += shards[i].misrouted;
+		lost += shards[i].lost;
+		close(shards[i].fd);
+	}
+	sec = now_sec() - start;
+
+	printf("%6d %6s %8lu %10.0f %9lu %6lu\n", shard_num, all_shared ? "yes" : "no",
+		   done, done / sec, misrouted, lost);
+	fflush(stdout);
+
+	return (done == total && misrouted == 0) ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+	struct sockaddr_in addr;
+	pthread_t tid;
+	int total = DEFAULT_REQUESTS;
+	int port = DEFAULT_PORT;
+	int max = 0;
+	int opt, i, shard_num, rc = 0;
+
+	while ((opt = getopt(argc, argv, "b:n:w:p:s:")) != -1) {
+		switch (opt) {
+		case 'b':
+			bmc_num = atoi(optarg);
+			break;
+		case 'n':
+			total = atoi(optarg);
+			break;
+		case 'w':
+			window = atoi(optarg);
+			break;
+		case 'p':
+			port = atoi(optarg);
+			break;
+		case 's':
+			max = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (bmc_num <= 0 || bmc_num > SIM_BMC_MAX || total < bmc_num ||
+		window <= 0 || window > 64 || port <= 0 || port >= 65535 ||
+		max < 0 || max > SIM_SHARD_MAX)
+		usage(argv[0]);
+	per_bmc = total / bmc_num;
+	total = per_bmc * bmc_num;
+	bmc_port = port + 1;
+
+	for (i = 0; i < bmc_num; i++) {
+		bmcs[i].host = htonl(0x7F000100 + i + 1);	/* 127.0.1.x */
+		bmcs[i].fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(bmc_port);
+		addr.sin_addr.s_addr = bmcs[i].host;
+		if (bmcs[i].fd < 0 || bind(bmcs[i].fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+			perror("BMC socket");
+			return -1;
+		}
+	}
+	pthread_create(&tid, NULL, bmc_thread, NULL);
+
+	if (max == 0) {
+		max = sysconf(_SC_NPROCESSORS_ONLN);
+		if (max < 1)
+			max = 1;
+		if (max > SIM_SHARD_MAX)
+			max = SIM_SHARD_MAX;
+	}
+
+	printf("# %d BMCs, window %d\n", bmc_num, window);
+	printf("# shards shared     done  requests/s misrouted   lost\n");
+	for (shard_num = 1; shard_num <= max; shard_num *= 2)
+		rc |= run(port, shard_num, total);
+
+	stop = 1;
+	pthread_join(tid, NULL);
+
+	return rc;
+}
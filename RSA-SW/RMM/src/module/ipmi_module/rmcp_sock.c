@@ -0,0 +1,91 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <sys/socket.h>
+#include <linux/filter.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+
+#include "rmcp_sock.h"
+
+#ifndef SO_REUSEPORT
+#define SO_REUSEPORT				15
+#endif
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF	51
+#endif
+
+/* the shards share the port, set by the first one */
+static int rmcp_steered;
+
+/**
+  *  @brief steer the datagrams of the port group to the sockets by
+  *         RMCP_SHARD_OF their source address
+  *
+  *  @param[in] fd socket of the first shard
+  *  @param[in] shard_num number of shards
+  *  @return 0 on success
+  */
+static int rmcp_sock_steer(int fd, int shard_num)
+{
+	struct sock_filter code[] = {
+		/* A = ntohl(source address), the data starts at the UDP payload */
+		{ BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_NET_OFF + (int)offsetof(struct iphdr, saddr) },
+		{ BPF_ALU | BPF_MOD | BPF_K, 0, 0, shard_num },
+		{ BPF_RET | BPF_A, 0, 0, 0 },
+	};
+	struct sock_fprog prog = {
+		.len = sizeof(code) / sizeof(code[0]),
+		.filter = code,
+	};
+
+	return setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog));
+}
+
+int rmcp_sock_open(int port, int shard, int shard_num, int *shared)
+{
+	struct sockaddr_in addr;
+	int fd, val = 1;
+
+	*shared = (shard == 0 || rmcp_steered);
+
+	fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+	if (fd < 0)
+		return -1;
+
+	if (shard_num > 1 && *shared &&
+		setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &val, sizeof(val)) < 0)
+		goto err;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = *shared ? htons(port) : 0;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+		goto err;
+
+	if (shard == 0)
+		rmcp_steered = (shard_num > 1 && rmcp_sock_steer(fd, shard_num) == 0);
+
+	return fd;
+
+err:
+	close(fd);
+	return -1;
+}
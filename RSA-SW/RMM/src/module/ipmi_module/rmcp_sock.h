@@ -0,0 +1,42 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __IPMI_RMCP_SOCK_H__
+#define __IPMI_RMCP_SOCK_H__
+
+#include <arpa/inet.h>
+
+/*
+ * The UDP sockets of the RMCP shards all bind the RmcpClientPort, so the
+ * BMCs see one source port whatever the shard. The sockets are opened in
+ * shard order, and a reuseport BPF program of the first one steers each
+ * datagram to the socket of the shard of its source address. Without it,
+ * on kernels before 4.5, the shards but the first use ephemeral ports.
+ */
+#define RMCP_SHARD_OF(host, num)	(ntohl(host) % (num))
+
+/**
+  *  @brief open the UDP socket of a RMCP shard, in shard order
+  *
+  *  @param[in] port RmcpClientPort
+  *  @param[in] shard shard id
+  *  @param[in] shard_num number of shards
+  *  @param[out] shared 1 if the socket is on 'port', 0 if it fell back to
+  *              an ephemeral port
+  *  @return socket, -1 on failure
+  */
+extern int rmcp_sock_open(int port, int shard, int shard_num, int *shared);
+
+#endif
@@ -0,0 +1,152 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <string.h>
+
+#include "serial_frame.h"
+
+static unsigned char frame_csum(const unsigned char *data, int len)
+{
+	unsigned char csum = 0;
+
+	while (len-- > 0)
+		csum += *data++;
+
+	return -csum;
+}
+
+static int frame_put(unsigned char *out, unsigned char c)
+{
+	switch (c) {
+	case SERIAL_FRAME_START:
+	case SERIAL_FRAME_STOP:
+	case SERIAL_FRAME_HANDSHAKE:
+	case SERIAL_FRAME_ESCAPE:
+		out[0] = SERIAL_FRAME_ESCAPE;
+		out[1] = c + 0x10;
+		return 2;
+	case SERIAL_FRAME_ESC:
+		out[0] = SERIAL_FRAME_ESCAPE;
+		out[1] = c + 0x20;
+		return 2;
+	default:
+		out[0] = c;
+		return 1;
+	}
+}
+
+static int frame_unescape(unsigned char c)
+{
+	switch (c) {
+	case SERIAL_FRAME_START + 0x10:
+	case SERIAL_FRAME_STOP + 0x10:
+	case SERIAL_FRAME_HANDSHAKE + 0x10:
+	case SERIAL_FRAME_ESCAPE + 0x10:
+		return c - 0x10;
+	case SERIAL_FRAME_ESC + 0x20:
+		return c - 0x20;
+	default:
+		return -1;
+	}
+}
+
+/**
+  *  @brief frame a message to send on a serial port
+  *
+  *  @param[out] out frame, SERIAL_FRAME_MAX_LEN(len) bytes at most
+  *  @param[in] msg message
+  *  @param[in] len message length
+  *  @return frame length
+  */
+int serial_frame_encode(unsigned char *out, const unsigned char *msg, int len)
+{
+	int i, n = 0;
+
+	out[n++] = SERIAL_FRAME_START;
+	for (i = 0; i < len; i++)
+		n += frame_put(out + n, msg[i]);
+	n += frame_put(out + n, frame_csum(msg, len));
+	out[n++] = SERIAL_FRAME_STOP;
+
+	return n;
+}
+
+/**
+  *  @brief reset the parser, e.g. when the serial port is opened
+  *
+  *  @param[in] parser frame parser
+  *  @return
+  */
+void serial_frame_reset(struct serial_frame_parser *parser)
+{
+	parser->in_frame = 0;
+	parser->escape = 0;
+	parser->len = 0;
+}
+
+/**
+  *  @brief parse a byte read from a serial port
+  *
+  *  @param[in] parser frame parser
+  *  @param[in] c byte read
+  *  @return the length of the message in parser->frame if the byte ends a
+  *          good frame, 0 else
+  */
+int serial_frame_input(struct serial_frame_parser *parser, unsigned char c)
+{
+	int len;
+
+	if (c == SERIAL_FRAME_START) {
+		/* a new frame, resync on it if the last one is cut */
+		parser->in_frame = 1;
+		parser->escape = 0;
+		parser->len = 0;
+		return 0;
+	}
+
+	if (!parser->in_frame || c == SERIAL_FRAME_HANDSHAKE)
+		return 0;
+
+	if (c == SERIAL_FRAME_STOP) {
+		len = parser->len;
+		serial_frame_reset(parser);
+
+		if (len < 1 || frame_csum(parser->frame, len) != 0)
+			return 0;
+		return len - 1;
+	}
+
+	if (parser->escape) {
+		int unescaped = frame_unescape(c);
+
+		parser->escape = 0;
+		if (unescaped < 0) {
+			serial_frame_reset(parser);
+			return 0;
+		}
+		c = unescaped;
+	} else if (c == SERIAL_FRAME_ESCAPE) {
+		parser->escape = 1;
+		return 0;
+	}
+
+	if (parser->len >= (int)sizeof(parser->frame)) {
+		serial_frame_reset(parser);
+		return 0;
+	}
+
+	parser->frame[parser->len++] = c;
+	return 0;
+}
@@ -0,0 +1,52 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __SERIAL_FRAME_H__
+#define __SERIAL_FRAME_H__
+
+#include "libjipmi/common.h"
+
+/*
+ * Framing of the IPMI messages on a serial port, after the IPMI Basic Mode:
+ *
+ *     START | message | checksum | STOP
+ *
+ * with the START, STOP, HANDSHAKE, ESCAPE and ESC bytes of the message and
+ * of the checksum escaped. A frame tells where a message ends, so a read
+ * may give a part of a frame or several frames, and several requests may
+ * be on the line at once. The parser drops the bytes out of a frame and
+ * the frames with a bad checksum or escape.
+ */
+#define SERIAL_FRAME_START		0xA0
+#define SERIAL_FRAME_STOP		0xA5
+#define SERIAL_FRAME_HANDSHAKE	0xA6
+#define SERIAL_FRAME_ESCAPE		0xAA
+#define SERIAL_FRAME_ESC		0x1B
+
+/* size of the frame of a 'len' bytes message at most */
+#define SERIAL_FRAME_MAX_LEN(len)	(2 * ((len) + 1) + 2)
+
+struct serial_frame_parser {
+	int in_frame;
+	int escape;
+	int len;
+	unsigned char frame[IPMI_MAX_MSG_LENGTH + 1];	/* + checksum */
+};
+
+extern int serial_frame_encode(unsigned char *out, const unsigned char *msg, int len);
+extern void serial_frame_reset(struct serial_frame_parser *parser);
+extern int serial_frame_input(struct serial_frame_parser *parser, unsigned char c);
+
+#endif
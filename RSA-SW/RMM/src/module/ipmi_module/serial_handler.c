@@ -23,6 +23,8 @@
 
 #include "ipmi.h"
 #include "ipmi_log.h"
+#include "ipmi_timer.h"
+#include "ipmi_window.h"
 
 #define SERIAL_RSPHNDL_QUEUE_SIZE	256
 
@@ -44,29 +46,29 @@ struct rsp_serial_hndl {
 	struct rsp_serial_hndl *next;	/* free buffer link */
 
 	struct list_head seq_list;	/* link in 'seq_table[i]' list */
-	struct list_head list;		/* all serial response handle in 'all_hndls' list */
 
 	struct serial_match_info match;
+	int port;
 	unsigned int msgid;
 	unsigned short user_port;
 	ipmi_json_ipc_header_t header;
 #ifdef DEBUG_IPMI
 	struct timespec start_time;
 #endif
-	unsigned int timeout;
+	struct ipmi_timer timer;
 	int broadcast;
 };
 
 struct rsp_serial_table {
-	pthread_mutex_t lock;
+	struct ipmi_lock lock;
 
 	struct rsp_serial_hndl *freelist;
 
 	unsigned int curr_seq;
-	struct list_head all_hndls;
+	struct ipmi_timer_wheel wheel;
 	struct list_head seq_table[SERIAL_SEQ_SIZE];	/* Fast indexed handle by seq */
-
-	pthread_t time_tid;
+	struct ipmi_window window;	/* requests in flight on the port */
+	char lock_name[32];
 };
 
 static struct rsp_serial_table serial_rsp_table[MAX_SERIAL_PORT];
@@ -164,8 +166,16 @@ void serial_port_update(int cur, int fd, long inode)
   */
 void set_serial_port_unused(int cur)
 {
+	struct rsp_serial_table *table = &(serial_rsp_table[cur]);
+
 	global_serial_port[cur].is_opened = 0;
 	global_serial_port[cur].fd = -1;
+
+	if (table->freelist != NULL) {
+		ipmi_lock(&table->lock);
+		ipmi_window_flush(&table->window);
+		ipmi_unlock(&table->lock);
+	}
 }
 
 /**
@@ -280,101 +290,89 @@ int set_serial_port_timeout_by_dev(char *dev, unsigned int timeout)
 	return -1;
 }
 
+static int send_serial_req(int cur, struct appmsg_ipmi_msg *msg);
+
 /**
-  *  @brief serial timeout thread
+  *  @brief give back a window slot of the port, and send the next queued
+  *         request in it
   *
-  *  @param
+  *  @param[in] table response table of the port, its lock held
+  *  @param[in] cur serial port
   *  @return
   */
-static void *serial_time_thread(void *argv)
+static void serial_window_next(struct rsp_serial_table *table, int cur)
 {
-	struct timespec expire;
-	struct rsp_serial_hndl *hndl, *nxt;
-	int cur_serial_port = 0;
-
-	prctl(PR_SET_NAME, "serial_time_thread");
+	struct ipmi_window_req *req;
+	int rc;
 
-	memcpy(&cur_serial_port, (char *)argv, sizeof(int));
+	while ((req = ipmi_window_put(&table->window)) != NULL) {
+		rc = send_serial_req(cur, &req->msg);
+		free(req);
+		if (rc == 0)
+			break;
+	}
+}
 
-	/* Don't forget free it. */
-	free(argv);
-	argv = NULL;
+static void free_serial_hndl(struct rsp_serial_table *table, struct rsp_serial_hndl *hndl)
+{
+	list_del(&hndl->seq_list);
+	ipmi_timer_del(&hndl->timer);
 
-	struct rsp_serial_table *table = &(serial_rsp_table[cur_serial_port]);
-	pthread_cond_t nul_cond = PTHREAD_COND_INITIALIZER;
-
-	while (1) {
-		clock_gettime(CLOCK_REALTIME, &expire);
-		expire.tv_sec += (IPMI_PERIOD_TIME_MS/1000);
-		expire.tv_nsec += (IPMI_PERIOD_TIME_MS % 1000) * (1000*1000);
-		if (expire.tv_nsec >= BILLION) {
-			expire.tv_sec += expire.tv_nsec / BILLION;
-			expire.tv_nsec %= BILLION;
-		}
+	hndl->next = table->freelist;
+	table->freelist = hndl;
 
-		pthread_mutex_lock(&table->lock);
-		while (pthread_cond_timedwait(&nul_cond, &table->lock, &expire) != ETIMEDOUT)
-			/* Nothing! */;
+	serial_window_next(table, hndl->port);
+}
 
+/**
+  *  @brief serial response handle timeout
+  *
+  *  @param[in] timer handle timer
+  *  @return
+  */
+static void serial_hndl_expired(struct ipmi_timer *timer)
+{
+	struct rsp_serial_hndl *hndl = container_of(timer, struct rsp_serial_hndl, timer);
 #ifdef DEBUG_IPMI
-		clock_gettime(CLOCK_REALTIME, &expire);
-#endif
+	struct timespec now;
 
-		list_for_each_entry_safe(hndl, nxt, &table->all_hndls, list) {
-			hndl->timeout -= IPMI_PERIOD_TIME_MS;
-			if (hndl->timeout > 0)
-				continue;
-
-			IPMI_LOG_DEBUG("SERIAL(%02X:%02X) Response handle timeout %ld:%ld -> %ld:%ld\n",
-						   hndl->match.netfn, hndl->match.cmd,
-						   hndl->start_time.tv_sec, hndl->start_time.tv_nsec,
-						   expire.tv_sec, expire.tv_nsec);
-
-			list_del(&hndl->list);
-			list_del(&hndl->seq_list);
-
-			hndl->next = table->freelist;
-			table->freelist = hndl;
-		}
-		pthread_mutex_unlock(&table->lock);
-	}
+	clock_gettime(CLOCK_REALTIME, &now);
+	IPMI_LOG_DEBUG("SERIAL(%02X:%02X) Response handle timeout %ld:%ld -> %ld:%ld\n",
+				   hndl->match.netfn, hndl->match.cmd,
+				   hndl->start_time.tv_sec, hndl->start_time.tv_nsec,
+				   now.tv_sec, now.tv_nsec);
+#endif
 
-	return NULL;
+	free_serial_hndl(&serial_rsp_table[hndl->port], hndl);
 }
 
 /**
   *  @brief init IPMI over serial message handle
   *
   *  @param[in] cur serial port
+  *  @param[in] window requests in flight on the port at most
   *  @return
   */
-void init_serial_msg_handler(int cur)
+void init_serial_msg_handler(int cur, unsigned int window)
 {
 	int i = 0;
 	struct rsp_serial_table *table = &(serial_rsp_table[cur]);
-	int *cur_port = NULL;
-
-	cur_port = (int *)malloc(sizeof(int));
-	if (NULL == cur_port)
-		return;
 
-	*cur_port = cur;
-
-	pthread_mutex_init(&table->lock, NULL);
+	snprintf(table->lock_name, sizeof(table->lock_name), "SERIAL %d response", cur);
+	ipmi_lock_init(&table->lock, table->lock_name);
 
 	table->freelist = mem_freelist_create(SERIAL_RSPHNDL_QUEUE_SIZE,
 										  sizeof(struct rsp_serial_hndl));
 	if (table->freelist == NULL)
 		FATAL("Failed to alloc serial rsp handle queue!\n");
 
-	INIT_LIST_HEAD(&table->all_hndls);
 	for (i = 0; i < SERIAL_SEQ_SIZE; i++)
 		INIT_LIST_HEAD(&table->seq_table[i]);
 
 	table->curr_seq = 0;
+	ipmi_window_init(&table->window, window);
 
-	if (pthread_create(&table->time_tid, NULL, serial_time_thread, cur_port) != 0)
-		FATAL("Failed to create SERIAL time thread!\n");
+	ipmi_timer_wheel_init(&table->wheel, &table->lock);
 }
 
 /**
@@ -387,12 +385,12 @@ void destroy_serial_msg_handler(int cur)
 {
 	struct rsp_serial_table *table = &(serial_rsp_table[cur]);
 
-	pthread_mutex_destroy(&table->lock);
+	ipmi_timer_wheel_destroy(&table->wheel);
+	ipmi_window_flush(&table->window);
+	pthread_mutex_destroy(&table->lock.mutex);
 
 	free(table->freelist);
 	table->freelist = NULL;
-
-	pthread_cancel(table->time_tid);
 }
 
 /**
@@ -420,7 +418,7 @@ static int serial_intf_find_seq(int cur_serial_port,
 	struct rsp_serial_table *table = &(serial_rsp_table[cur_serial_port]);
 	struct list_head *head = &table->seq_table[SERIAL_SEQ_HASH(match->seq)];
 
-	pthread_mutex_lock(&table->lock);
+	ipmi_lock(&table->lock);
 
 	list_for_each_entry(pos, head, seq_list) {
 		if ((pos->match.netfn == netfn) && (pos->match.cmd == match->cmd)) {
@@ -436,32 +434,29 @@ static int serial_intf_find_seq(int cur_serial_port,
 	*user_port = hndl->user_port;
 
 	/*copy header*/
-	memset(header->method, 0, sizeof(JRPC_METHOD_MAX));
+	memset(header->method, 0, sizeof(header->method));
 	header->ip = hndl->header.ip;
 	header->port = hndl->header.port;
 	header->json_ipc_id = hndl->header.json_ipc_id;
 	if (strlen((const char *)hndl->header.method) < JRPC_METHOD_MAX)
-		memcpy(header->method, hndl->header.method, strlen((const char *)(hndl->header.method)));
+		memcpy(header->method, hndl->header.method, strlen((const char *)(hndl->header.method)) + 1);
 
 	/* Add by Peifeng: remove from list after processing */
-	list_del(&hndl->seq_list);
-	list_del(&hndl->list);
-	hndl->next = table->freelist;
-	table->freelist = hndl;
+	free_serial_hndl(table, hndl);
 
 	rv = 0;
 
 ret:
-	pthread_mutex_unlock(&table->lock);
+	ipmi_unlock(&table->lock);
 
 	return rv;
 }
 
 
 /**
-  *  @brief process next IPMI message over serial interface
+  *  @brief process next IPMI message over serial interface, the table lock held
   *
-  *  @param[in] fd serial device file fd
+  *  @param[in] cur_serial_port serial port
   *  @param[in] match
   *  @param[in] timeo time out
   *  @param[in] msgid msg id
@@ -470,34 +465,22 @@ ret:
   *  @retval -1 failure
   *  @retval 0 successful
   */
-static int serial_intf_next_seq(int fd, struct serial_match_info *match,
+static int serial_intf_next_seq(int cur_serial_port, struct serial_match_info *match,
 								unsigned int timeo, unsigned int msgid,
 								unsigned short user_port, ipmi_json_ipc_header_t header)
 {
-	int rv = -1;
 	unsigned int i = 0;
 	unsigned char netfn = ((match->netfn) & 0x3E);	/* request netfn */
 	unsigned char seq = SERIAL_SEQ_SIZE;
 	struct rsp_serial_hndl *hndl = NULL;
 	struct rsp_serial_hndl *pos = NULL;
-	int cur_serial_port = 0;
-
-	cur_serial_port = get_spec_serial_port_by_fd(fd);
-	if (cur_serial_port < 0) {
-		IPMI_LOG_DEBUG("Can't find the matched fd\n");
-		send_back_result_to_app(-1, netfn, match->cmd, msgid, user_port, header);
-		return rv;
-	}
-
 	struct rsp_serial_table *table = &(serial_rsp_table[cur_serial_port]);
 
-	pthread_mutex_lock(&table->lock);
-
 	hndl = table->freelist;
 	if (hndl == NULL) {
 		IPMI_LOG_ERR("NXT SEQ no buff, adjust #SERIAL_RSPHNDL_QUEUE_SIZE(%d)!\n",
 					 SERIAL_RSPHNDL_QUEUE_SIZE);
-		goto ret;
+		return -1;
 	}
 
 	for (i = table->curr_seq;
@@ -524,15 +507,15 @@ static int serial_intf_next_seq(int fd, struct serial_match_info *match,
 
 	if (seq >= SERIAL_SEQ_SIZE) {
 		IPMI_LOG_ERR("No avail seq number for IPMI msg in SERIAL interface!\n");
-		goto ret;
+		return -1;
 	}
 
 	table->freelist = hndl->next;
 
 	hndl->next = NULL;
 	list_add_tail(&hndl->seq_list, &table->seq_table[seq]);
-	list_add_tail(&hndl->list, &table->all_hndls);
 
+	hndl->port = cur_serial_port;
 	hndl->match.seq = seq;
 	hndl->match.netfn = netfn;
 	hndl->match.cmd = match->cmd;
@@ -541,31 +524,27 @@ static int serial_intf_next_seq(int fd, struct serial_match_info *match,
 	hndl->user_port = user_port;
 
 	/*copy header*/
-	memset(hndl->header.method, 0, sizeof(JRPC_METHOD_MAX));
+	memset(hndl->header.method, 0, sizeof(hndl->header.method));
 	hndl->header.ip = header.ip;
 	hndl->header.port = header.port;
 	hndl->header.json_ipc_id = header.json_ipc_id;
 	if (strlen((const char *)header.method) < JRPC_METHOD_MAX)
-		memcpy(hndl->header.method, header.method, strlen((const char *)header.method));
+		memcpy(hndl->header.method, header.method, strlen((const char *)header.method) + 1);
 
 
 #ifdef DEBUG_IPMI
 	clock_gettime(CLOCK_REALTIME, &hndl->start_time);
 #endif
 
-	hndl->timeout = timeo;
+	ipmi_timer_init(&hndl->timer, serial_hndl_expired);
+	ipmi_timer_add(&table->wheel, &hndl->timer, timeo);
 	/* SERIAL: The Requester changes the Seq field whenever it issues a new instance
 	 * of a command (request).
 	 */
 	match->seq = seq;	/* saved the seq result back */
 	table->curr_seq = SERIAL_SEQ_HASH(seq + 1);
 
-	rv = 0;
-
-ret:
-	pthread_mutex_unlock(&table->lock);
-
-	return rv;
+	return 0;
 }
 
 
@@ -671,6 +650,35 @@ void process_serial_cmd(struct appmsg_ipmi_msg *msg)
 	}
 }
 
+/**
+  *  @brief send a request in a window slot of the port, the table lock held
+  *
+  *  @param[in] cur serial port
+  *  @param[in] msg IPMI request
+  *  @return
+  *  @retval -1 failure
+  *  @retval 0 successful
+  */
+static int send_serial_req(int cur, struct appmsg_ipmi_msg *msg)
+{
+	struct serial_match_info match = {0};
+	int serial_msg_len = 0;
+	unsigned char serial_msg[IPMI_MAX_MSG_LENGTH] = {0};
+
+	match.netfn = msg->msg.netfn;
+	match.cmd   = msg->msg.cmd;
+
+	if (serial_intf_next_seq(cur, &match, msg->timeo, msg->id,
+							 msg->user_port, msg->header) != 0)
+		return -1;
+
+	serial_msg_len = format_serial_msg(serial_msg, &msg->msg, match.seq);
+
+	serial_send_outbound_msg(global_serial_port[cur].fd, serial_msg, serial_msg_len);
+
+	return 0;
+}
+
 /**
   *  @brief deliver IPMI msg by serial
   *
@@ -680,9 +688,11 @@ void process_serial_cmd(struct appmsg_ipmi_msg *msg)
 void deliver_ipmi_msg_by_serial(struct appmsg_ipmi_msg *msg)
 {
 	struct ipmi_msg *ipmi_msg = NULL;
-	unsigned char seq = 0;
+	struct rsp_serial_table *table = NULL;
 	int serial_msg_len = 0;
 	unsigned char serial_msg[IPMI_MAX_MSG_LENGTH] = {0};
+	int cur = 0;
+	int rc = 0;
 
 	ipmi_msg = &msg->msg;
 	if (ipmi_msg->data_len > IPMI_MAX_DATA_LENGTH) {
@@ -696,28 +706,38 @@ void deliver_ipmi_msg_by_serial(struct appmsg_ipmi_msg *msg)
 	}
 
 	if (ipmi_msg->netfn & 0x01) {
-		seq = msg->addr.addr.serial.seq;
-	} else {
-		struct serial_match_info match = {0};
+		serial_msg_len = format_serial_msg(serial_msg, ipmi_msg, msg->addr.addr.serial.seq);
+		serial_send_outbound_msg(ipmi_msg->union_app_req.serial.serial_fd,
+								 serial_msg, serial_msg_len);
+		return;
+	}
 
-		match.netfn = ipmi_msg->netfn;
-		match.cmd   = ipmi_msg->cmd;
+	cur = get_spec_serial_port_by_fd(ipmi_msg->union_app_req.serial.serial_fd);
+	if (cur < 0) {
+		IPMI_LOG_DEBUG("Can't find the matched fd\n");
+		send_back_result_to_app(-1, ipmi_msg->netfn & 0x3E, ipmi_msg->cmd,
+								msg->id, msg->user_port, msg->header);
+		return;
+	}
 
-		if (msg->timeo > IPMI_MAX_TIMEOUT_MS)
-			msg->timeo = IPMI_MAX_TIMEOUT_MS;
-		if (msg->timeo == 0)
-			msg->timeo = IPMI_DFLT_TIMEOUT_MS;
+	if (msg->timeo > IPMI_MAX_TIMEOUT_MS)
+		msg->timeo = IPMI_MAX_TIMEOUT_MS;
+	if (msg->timeo == 0)
+		msg->timeo = IPMI_DFLT_TIMEOUT_MS;
 
-		if (serial_intf_next_seq(ipmi_msg->union_app_req.serial.serial_fd, &match,
-								 msg->timeo, msg->id, msg->user_port, msg->header) != 0)
-			return;
+	table = &(serial_rsp_table[cur]);
 
-		seq = match.seq;
-	}
+	/* the requests above the window wait for a response to be sent */
+	ipmi_lock(&table->lock);
 
-	serial_msg_len = format_serial_msg(serial_msg, ipmi_msg, seq);
+	rc = ipmi_window_get(&table->window, msg);
+	if (rc == 0 && send_serial_req(cur, msg) != 0)
+		serial_window_next(table, cur);
+	else if (rc < 0)
+		IPMI_LOG_ERR("SERIAL %d send queue is full, drop NetFn:%02X,Cmd:%02X!\n",
+					 cur, ipmi_msg->netfn, ipmi_msg->cmd);
 
-	serial_send_outbound_msg(ipmi_msg->union_app_req.serial.serial_fd, serial_msg, serial_msg_len);
+	ipmi_unlock(&table->lock);
 }
 
 /**
@@ -745,6 +765,7 @@ static void handle_serial_msg_rsp(int cur, struct serial_match_info *match,
 	msg.hdr.type    = APPMSG_IPMI_MSG;
 	msg.hdr.datalen = APPMSG_IPMI_MSG_LEN(rsp_len);
 
+	memset(&header, 0, sizeof(header));
 	if (serial_intf_find_seq(cur, match, &msgid, &user_port, &header) != 0) {
 		IPMI_LOG_DEBUG("SERIAL: No match request for this response!\n");
 		return;
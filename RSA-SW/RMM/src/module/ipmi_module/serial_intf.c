@@ -23,11 +23,14 @@
 #include <sys/types.h>
 #include <pthread.h>
 #include <termios.h>
+#include <poll.h>
 
 #include "librmmcfg/rmm_cfg.h"
 #include "event.h"
 #include "ipmi.h"
 #include "ipmi_log.h"
+#include "ipmi_window.h"
+#include "serial_frame.h"
 
 
 /**
@@ -56,26 +59,18 @@
 #define DEFAULT_STOPBITS		STOPBITS_1
 #define DEFAULT_FLOW_CONTROL	FLOW_CONTROL_NONE
 
-#define SERIAL_MSG_QUEUE_NUM		256
+/* SerialFraming in rmm.cfg */
+#define SERIAL_FRAMING_BASIC		"basic"
 
-struct serial_recv_msg {
-	struct serial_recv_msg *next;	/* free buffer link */
-
-	int len;
-	unsigned char msg[IPMI_MAX_MSG_LENGTH];
-};
-
-struct serial_msg_head {
-	struct serial_recv_msg  *head;
-	struct serial_recv_msg **tail;
-};
+#define SERIAL_WRITE_TIMEOUT_MS	100
 
 static struct fd_event serial_fd_event[MAX_SERIAL_PORT];
 
-static struct serial_msg_head  serialmsg_head[MAX_SERIAL_PORT];
-static struct serial_recv_msg *serialmsg_freelist[MAX_SERIAL_PORT];
-static pthread_mutex_t serialmsg_mutex[MAX_SERIAL_PORT];
-static pthread_cond_t  serialmsg_cond[MAX_SERIAL_PORT];
+/* framed messages, several requests in flight by port; else one message
+ * per read burst, and a request at once */
+static int serial_framing;
+static unsigned int serial_window = 1;
+static struct serial_frame_parser serial_parser[MAX_SERIAL_PORT];
 
 static struct _rates {
 	int speed;
@@ -234,6 +229,28 @@ static int serial_close(int fd)
 }
 
 
+/**
+  *  @brief read the framing of the serial ports from the config file "rmm.cfg"
+  *
+  *  @param
+  *  @return
+  */
+static void load_serial_framing(void)
+{
+	char framing[16] = {0};
+	int window;
+
+	if (rmm_cfg_get_serial_framing(framing, sizeof(framing)) == 0 &&
+		strcmp(framing, SERIAL_FRAMING_BASIC) == 0) {
+		serial_framing = 1;
+		window = rmm_cfg_get_serial_window();
+		serial_window = window > 0 ? window : IPMI_WINDOW_DFLT_SIZE;
+	} else {
+		serial_framing = 0;
+		serial_window = 1;
+	}
+}
+
 /**
   *  @brief open the serial port, and read the configuration from the config file "rmm.cfg"
   *
@@ -261,6 +278,7 @@ static int open_serial_interface(char *dev_name)
 	stopbits = rmm_cfg_get_stopbits();
 	parity = rmm_cfg_get_parity();
 	flow_control = rmm_cfg_get_flow_control();
+	load_serial_framing();
 
 	fd = serial_open(dev_name);
 	if (fd < 0) {
@@ -312,14 +330,43 @@ void serial_send_outbound_msg(int fd, unsigned char *msg, int len)
 		IPMI_LOG_DEBUG("%s\n", __buff);
 	}
 #endif
+	unsigned char frame[SERIAL_FRAME_MAX_LEN(IPMI_MAX_MSG_LENGTH)];
+	struct pollfd pfd;
 	int cur_serial_port = 0;
+	int rc;
 
 	cur_serial_port = get_spec_serial_port_by_fd(fd);
 	if (-1 == cur_serial_port)
 		return;
 
-	if (write(fd, msg, len) < 0)
-		printf("%s: write fail\n", __func__);
+	if (serial_framing) {
+		len = serial_frame_encode(frame, msg, len);
+		msg = frame;
+	}
+
+	/* the port is non blocking, wait a bit if its output buffer is full */
+	while (len > 0) {
+		rc = write(fd, msg, len);
+		if (rc > 0) {
+			msg += rc;
+			len -= rc;
+			continue;
+		}
+
+		if (rc < 0 && errno == EINTR)
+			continue;
+
+		pfd.fd = fd;
+		pfd.events = POLLOUT;
+		if (rc < 0 && errno != EAGAIN) {
+			printf("%s: write fail\n", __func__);
+			return;
+		}
+		if (poll(&pfd, 1, SERIAL_WRITE_TIMEOUT_MS) <= 0) {
+			printf("%s: write timeout\n", __func__);
+			return;
+		}
+	}
 }
 
 /**
@@ -332,27 +379,19 @@ static void serial_recv_inbound_msg(int fd)
 {
 	int rc = -1;
 	int offset = 0;
-	struct serial_recv_msg *msg = NULL;
+	int i, len;
+	unsigned char buff[IPMI_MAX_MSG_LENGTH];
+	struct serial_frame_parser *parser;
 	int cur_serial_port = 0;
 
 	cur_serial_port = get_spec_serial_port_by_fd(fd);
 	if (-1 == cur_serial_port)
 		return;
 
-	pthread_mutex_lock(&(serialmsg_mutex[cur_serial_port]));
-
-	while (1) {
-		msg = serialmsg_freelist[cur_serial_port];
-		if (msg == NULL) {
-			IPMI_LOG_ERR("SERIAL-Intf: No Recv Buff, adjust #SERIAL_MSG_QUEUE_NUM(%d)!\n",
-						 SERIAL_MSG_QUEUE_NUM);
-			break;
-		}
-
+	if (!serial_framing) {
 		/* Be careful here, we need to read several times to get the complete data. */
-		offset = 0;
 		while (1) {
-			rc = read(fd, msg->msg + offset, sizeof(msg->msg) - offset);
+			rc = read(fd, buff + offset, sizeof(buff) - offset);
 			if (rc > 0) {
 				offset += rc;
 				usleep(1000);
@@ -360,78 +399,20 @@ static void serial_recv_inbound_msg(int fd)
 				break;
 		}
 
-		if (0 == offset)
-			break;
-
-		msg->len = offset;
-		serialmsg_freelist[cur_serial_port] = msg->next;
-		msg->next = NULL;
-		*(serialmsg_head[cur_serial_port].tail) = msg;
-		serialmsg_head[cur_serial_port].tail = &(msg->next);
+		if (offset > 0)
+			handle_serial_msg(cur_serial_port, buff, offset);
+		return;
 	}
 
-	if (serialmsg_head[cur_serial_port].head != NULL)
-		pthread_cond_signal(&(serialmsg_cond[cur_serial_port]));
-
-	pthread_mutex_unlock(&(serialmsg_mutex[cur_serial_port]));
-}
-
-
-/**
-  *  @brief The thread for receiving the message from the serial port sent by BMC
-  *
-  *  @param
-  *  @return
-  */
-static void *serial_intf_thread(void *argv)
-{
-	struct serial_recv_msg *list;
-	struct serial_msg_head freelist;
-	int cur_serial_port = 0;
-
-	prctl(PR_SET_NAME, "serial_intf_thread");
-
-	memcpy(&cur_serial_port, (char *)argv, sizeof(int));
-
-	/* Don't forget free it. */
-	free(argv);
-	argv = NULL;
-
-	freelist.head = NULL;
-
-	while (1) {
-		pthread_mutex_lock(&(serialmsg_mutex[cur_serial_port]));
-
-		if (freelist.head != NULL) {
-			*(freelist.tail) = serialmsg_freelist[cur_serial_port];
-			serialmsg_freelist[cur_serial_port] = freelist.head;
-
-			freelist.head = NULL;
-		}
-
-		while (serialmsg_head[cur_serial_port].head == NULL) {
-			pthread_cond_wait(&(serialmsg_cond[cur_serial_port]), &(serialmsg_mutex[cur_serial_port]));
+	/* a read may end in a frame, or hold several ones */
+	parser = &serial_parser[cur_serial_port];
+	while ((rc = read(fd, buff, sizeof(buff))) > 0) {
+		for (i = 0; i < rc; i++) {
+			len = serial_frame_input(parser, buff[i]);
+			if (len > 0)
+				handle_serial_msg(cur_serial_port, parser->frame, len);
 		}
-
-		freelist.head = serialmsg_head[cur_serial_port].head;
-		freelist.tail = serialmsg_head[cur_serial_port].tail;
-		serialmsg_head[cur_serial_port].head = NULL;
-		serialmsg_head[cur_serial_port].tail = &(serialmsg_head[cur_serial_port].head);
-
-		pthread_mutex_unlock(&(serialmsg_mutex[cur_serial_port]));
-
-		list = freelist.head;
-		while (list != NULL) {
-			if (IPMI_MAX_MSG_LENGTH >= list->len)
-				handle_serial_msg(cur_serial_port, list->msg, list->len);
-
-			list = list->next;
-		}
-	} /* End of while (1) */
-
-	serial_close(serial_fd_event[cur_serial_port].fd);
-
-	return NULL;
+	}
 }
 
 /**
@@ -447,9 +428,8 @@ static void *serial_intf_thread(void *argv)
 void start_serial_intf(char *dev, unsigned char netfn, unsigned char cmd,
 					   int msgid, unsigned short user_port, ipmi_json_ipc_header_t header)
 {
-	pthread_t tid;
+	pthread_t tid = 0;
 	int cur_serial_port;
-	int *tmp_cur = NULL;
 	int rc = -1;
 	int fd = -1;
 	struct stat sb;
@@ -470,6 +450,7 @@ void start_serial_intf(char *dev, unsigned char netfn, unsigned char cmd,
 		if (serial_port_is_updated(cur_serial_port, (long)sb.st_ino)) {
 			serial_close(serial_fd_event[cur_serial_port].fd);
 			serial_fd_event[cur_serial_port].fd = open_serial_interface(dev);
+			serial_frame_reset(&serial_parser[cur_serial_port]);
 			serial_port_update(cur_serial_port,
 							   serial_fd_event[cur_serial_port].fd,
 							   (long)sb.st_ino);
@@ -484,6 +465,7 @@ void start_serial_intf(char *dev, unsigned char netfn, unsigned char cmd,
 		if (serial_fd_event[cur_serial_port].fd == -1) {
 			IPMI_LOG_ERR("Failed to open %s\n", dev);
 		}
+		serial_frame_reset(&serial_parser[cur_serial_port]);
 
 		set_serial_port_used(cur_serial_port,
 							 serial_fd_event[cur_serial_port].fd,
@@ -508,54 +490,21 @@ void start_serial_intf(char *dev, unsigned char netfn, unsigned char cmd,
 		return;
 	}
 
-	pthread_mutex_init(&(serialmsg_mutex[cur_serial_port]), NULL);
-	pthread_cond_init(&(serialmsg_cond[cur_serial_port]), NULL);
-
-	init_serial_msg_handler(cur_serial_port);
-
-	serialmsg_head[cur_serial_port].head = NULL;
-	serialmsg_head[cur_serial_port].tail = &(serialmsg_head[cur_serial_port].head);
-
-	serialmsg_freelist[cur_serial_port] = mem_freelist_create(SERIAL_MSG_QUEUE_NUM,
-															  sizeof(struct serial_recv_msg));
-	if (serialmsg_freelist[cur_serial_port] == NULL) {
-		send_back_result_to_app(fd, netfn, cmd, msgid, user_port, header);
-		return;
-	}
-
 	IPMI_LOG_DEBUG("Dev Name: %s\n", dev);
 	serial_fd_event[cur_serial_port].fd = open_serial_interface(dev);
 	if (serial_fd_event[cur_serial_port].fd == -1) {
-		free(serialmsg_freelist[cur_serial_port]);
 		rmm_log(ERROR, "open serial interface failed\n");
 		send_back_result_to_app(fd, netfn, cmd, msgid, user_port, header);
 		return;
 	}
 
+	/* the responses are parsed and handled by the event loop */
+	init_serial_msg_handler(cur_serial_port, serial_window);
+	serial_frame_reset(&serial_parser[cur_serial_port]);
+
 	serial_fd_event[cur_serial_port].handle_fd = serial_recv_inbound_msg;
 	fd_event_add(&(serial_fd_event[cur_serial_port]));
 
-	tmp_cur = (int *)malloc(sizeof(int));
-	if (NULL == tmp_cur)
-		return;
-
-	*tmp_cur = cur_serial_port;
-
-	if (pthread_create(&tid, NULL, serial_intf_thread, tmp_cur) != 0) {
-		if (NULL != tmp_cur) {
-			free(tmp_cur);
-			tmp_cur = NULL;
-		}
-
-		serial_close(serial_fd_event[cur_serial_port].fd);
-		serial_fd_event[cur_serial_port].fd = -1;
-		free(serialmsg_freelist[cur_serial_port]);
-		send_back_result_to_app(fd, netfn, cmd, msgid, user_port, header);
-
-		IPMI_LOG_ERR("Failed to create serial_intf_thread.\n");
-		return;
-	}
-
 	set_serial_port_used(cur_serial_port,
 						 serial_fd_event[cur_serial_port].fd,
 						 dev, tid, (long)sb.st_ino);
@@ -0,0 +1,371 @@
+/**
+ * Copyright (c)  2015, Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <termios.h>
+
+#include "serial_frame.h"
+
+/*
+ * A CM on a pty for the framed serial transport (SerialFraming "basic"):
+ * it answers each request with its data echoed, and writes the responses
+ * in random chunks, several frames in a write, and out of order, as a
+ * busy CM may do.
+ *
+ *     ipmiserialloop [-s]                    serve, give its pty to ipmi_module
+ *     ipmiserialloop [-n requests] [-w window]
+ *                                            send pipelined requests itself
+ *                                            and check the responses
+ */
+#define DEFAULT_REQUESTS	10000
+#define DEFAULT_WINDOW		4
+#define SEQ_NUM				64
+#define BATCH_MAX			8
+
+#define NETFN_OFFSET		0
+#define SEQ_OFFSET			1
+#define CMD_OFFSET			2
+#define DATA_OFFSET			3
+
+struct loop_port {
+	int fd;
+	struct serial_frame_parser parser;
+	unsigned char out[BATCH_MAX * SERIAL_FRAME_MAX_LEN(IPMI_MAX_MSG_LENGTH)];
+	int out_len;
+};
+
+struct loop_rsp {
+	unsigned char msg[IPMI_MAX_MSG_LENGTH];
+	int len;
+};
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void usage(char *name)
+{
+	printf("usage: %s [-s] [-n requests] [-w window]\n", name);
+	exit(-1);
+}
+
+static int set_raw(int fd)
+{
+	struct termios tio;
+
+	if (tcgetattr(fd, &tio) != 0)
+		return -1;
+
+	cfmakeraw(&tio);
+	return tcsetattr(fd, TCSANOW, &tio);
+}
+
+/**
+  *  @brief open a pty, the master is the CM end
+  *
+  *  @param[out] slave name of the slave end
+  *  @param[in] len size of 'slave'
+  *  @return master fd, -1 on failure
+  */
+static int open_loop_pty(char *slave, int len)
+{
+	int fd;
+
+	fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if (fd < 0)
+		return -1;
+
+	if (grantpt(fd) != 0 || unlockpt(fd) != 0 || set_raw(fd) != 0 ||
+		ptsname_r(fd, slave, len) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	return fd;
+}
+
+/**
+  *  @brief write what is pending in random chunks
+  *
+  *  @param[in] port port
+  *  @return
+  */
+static void flush_port(struct loop_port *port)
+{
+	int chunk, rc;
+
+	while (port->out_len > 0) {
+		chunk = 1 + rand() % port->out_len;
+		rc = write(port->fd, port->out, chunk);
+		if (rc <= 0)
+			return;
+
+		port->out_len -= rc;
+		memmove(port->out, port->out + rc, port->out_len);
+	}
+}
+
+/**
+  *  @brief frame the responses of a batch into the output of the CM end,
+  *         in the reverse order half of the time
+  *
+  *  @param[in] port CM end
+  *  @param[in] rsp responses
+  *  @param[in] num number of responses
+  *  @return
+  */
+static void queue_batch(struct loop_port *port, struct loop_rsp *rsp, int num)
+{
+	int reverse = rand() & 1;
+	int i, j;
+
+	for (i = 0; i < num; i++) {
+		j = reverse ? num - 1 - i : i;
+		port->out_len += serial_frame_encode(port->out + port->out_len,
+											 rsp[j].msg, rsp[j].len);
+	}
+}
+
+/**
+  *  @brief read the requests on the CM end, and queue their responses
+  *
+  *  @param[in] port CM end
+  *  @param[in] batch responses not written yet
+  *  @param[in] num number of responses in 'batch'
+  *  @return number of responses in 'batch'
+  */
+static int serve_port(struct loop_port *port, struct loop_rsp *batch, int num)
+{
+	unsigned char buff[256];
+	unsigned char *req;
+	struct loop_rsp *rsp;
+	int rc, i, len;
+
+	while ((rc = read(port->fd, buff, sizeof(buff))) > 0) {
+		for (i = 0; i < rc; i++) {
+			len = serial_frame_input(&port->parser, buff[i]);
+			if (len < DATA_OFFSET || len + 1 > IPMI_MAX_MSG_LENGTH)
+				continue;
+
+			req = port->parser.frame;
+			rsp = &batch[num++];
+			rsp->msg[NETFN_OFFSET] = req[NETFN_OFFSET] | (1 << 2);
+			rsp->msg[SEQ_OFFSET] = req[SEQ_OFFSET];
+			rsp->msg[CMD_OFFSET] = req[CMD_OFFSET];
+			rsp->msg[DATA_OFFSET] = 0;	/* ccode */
+			memcpy(&rsp->msg[DATA_OFFSET + 1], &req[DATA_OFFSET], len - DATA_OFFSET);
+			rsp->len = len + 1;
+
+			/* let several responses pile up before writing them */
+			if (num == BATCH_MAX || (rand() % 4) == 0) {
+				queue_batch(port, batch, num);
+				num = 0;
+			}
+		}
+	}
+
+	return num;
+}
+
+static int serve(void)
+{
+	struct loop_port cm;
+	struct loop_rsp batch[BATCH_MAX];
+	struct pollfd pfd;
+	char slave[64];
+	int num = 0;
+
+	memset(&cm, 0, sizeof(cm));
+	cm.fd = open_loop_pty(slave, sizeof(slave));
+	if (cm.fd < 0) {
+		perror("pty");
+		return -1;
+	}
+
+	printf("CM loopback on %s\n", slave);
+	fflush(stdout);
+
+	/* keep the slave open, not to get EIO between two users */
+	close(open(slave, O_RDWR | O_NOCTTY));
+
+	for (;;) {
+		pfd.fd = cm.fd;
+		pfd.events = POLLIN | (cm.out_len > 0 ? POLLOUT : 0);
+		if (poll(&pfd, 1, 1) < 0 && errno != EINTR)
+			return -1;
+
+		num = serve_port(&cm, batch, num);
+		if (pfd.revents == 0 && num > 0) {
+			queue_batch(&cm, batch, num);
+			num = 0;
+		}
+		flush_port(&cm);
+	}
+
+	return 0;
+}
+
+/**
+  *  @brief send 'total' requests 'window' at a time on one end of the pty,
+  *         answer them on the other end, and check each response matches
+  *         its request by Seq
+  */
+static int self_test(int total, int window)
+{
+	struct loop_port cm, user;
+	struct loop_rsp batch[BATCH_MAX];
+	struct pollfd pfd[2];
+	unsigned char msg[IPMI_MAX_MSG_LENGTH];
+	unsigned char frame[SERIAL_FRAME_MAX_LEN(IPMI_MAX_MSG_LENGTH)];
+	unsigned char buff[256];
+	int inflight[SEQ_NUM] = {0};
+	int sent = 0, done = 0, outstanding = 0, max_outstanding = 0;
+	int num = 0, rc, i, len, seq;
+	char slave[64];
+	double start;
+
+	memset(&cm, 0, sizeof(cm));
+	memset(&user, 0, sizeof(user));
+	cm.fd = open_loop_pty(slave, sizeof(slave));
+	if (cm.fd < 0) {
+		perror("pty");
+		return -1;
+	}
+
+	user.fd = open(slave, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (user.fd < 0 || set_raw(user.fd) != 0) {
+		perror(slave);
+		return -1;
+	}
+
+	start = now_sec();
+
+	while (done < total) {
+		/* fill the window, Seq tells the requests in flight apart */
+		while (outstanding < window && sent < total) {
+			seq = sent % SEQ_NUM;
+			if (inflight[seq])
+				break;
+
+			len = DATA_OFFSET + 1 + sent % 16;
+			msg[NETFN_OFFSET] = 0x30 << 2;
+			msg[SEQ_OFFSET] = seq;
+			msg[CMD_OFFSET] = sent & 0xFF;
+			for (i = DATA_OFFSET; i < len; i++)
+				msg[i] = sent + i;
+
+			len = serial_frame_encode(frame, msg, len);
+			if (write(user.fd, frame, len) != len) {
+				printf("short write of request %d\n", sent);
+				return -1;
+			}
+
+			inflight[seq] = sent + 1;
+			sent++;
+			outstanding++;
+		}
+		if (outstanding > max_outstanding)
+			max_outstanding = outstanding;
+
+		pfd[0].fd = cm.fd;
+		pfd[0].events = POLLIN | (cm.out_len > 0 ? POLLOUT : 0);
+		pfd[1].fd = user.fd;
+		pfd[1].events = POLLIN;
+		if (poll(pfd, 2, 1000) <= 0) {
+			printf("stalled: %d sent, %d answered\n", sent, done);
+			return -1;
+		}
+
+		num = serve_port(&cm, batch, num);
+		if (num > 0 && (outstanding == window || sent == total)) {
+			queue_batch(&cm, batch, num);
+			num = 0;
+		}
+		flush_port(&cm);
+
+		while ((rc = read(user.fd, buff, sizeof(buff))) > 0) {
+			for (i = 0; i < rc; i++) {
+				len = serial_frame_input(&user.parser, buff[i]);
+				if (len <= 0)
+					continue;
+
+				seq = user.parser.frame[SEQ_OFFSET];
+				if (seq >= SEQ_NUM || !inflight[seq] ||
+					user.parser.frame[CMD_OFFSET] != ((inflight[seq] - 1) & 0xFF) ||
+					len != DATA_OFFSET + 2 + (inflight[seq] - 1) % 16) {
+					printf("unexpected response, Seq %d\n", seq);
+					return -1;
+				}
+
+				inflight[seq] = 0;
+				outstanding--;
+				done++;
+			}
+		}
+	}
+
+	printf("%d requests, window %d (%d in flight at most), %.0f requests/s\n",
+		   total, window, max_outstanding, total / (now_sec() - start));
+
+	close(user.fd);
+	close(cm.fd);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int total = DEFAULT_REQUESTS;
+	int window = DEFAULT_WINDOW;
+	int opt, serve_only = 0;
+
+	while ((opt = getopt(argc, argv, "sn:w:")) != -1) {
+		switch (opt) {
+		case 's':
+			serve_only = 1;
+			break;
+		case 'n':
+			total = atoi(optarg);
+			break;
+		case 'w':
+			window = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (total <= 0 || window <= 0 || window > SEQ_NUM)
+		usage(argv[0]);
+
+	srand(time(NULL));
+
+	if (serve_only)
+		return serve();
+
+	return self_test(total, window);
+}